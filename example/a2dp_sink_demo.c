@@ -68,7 +68,7 @@
 #include <string.h>
 
 #include "btstack.h"
-#include "btstack_resample.h"
+#include "classic/a2dp_sink_jitter_buffer.h"
 
 //#define AVRCP_BROWSING_ENABLED
 
@@ -76,12 +76,6 @@
 #include "btstack_stdin.h"
 #endif
 
-#ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
-#include "btstack_sample_rate_compensation.h"
-#endif
-
-#include "btstack_ring_buffer.h"
-
 #ifdef HAVE_POSIX_FILE_IO
 #include "wav_util.h"
 #define STORE_TO_WAV_FILE
@@ -96,10 +90,6 @@ static const char * device_addr_string = "00:1B:DC:08:E2:72"; // pts v5.0
 static bd_addr_t device_addr;
 #endif
 
-#ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
-static btstack_sample_rate_compensation_t sample_rate_compensation;
-#endif
-
 static btstack_packet_callback_registration_t hci_event_callback_registration;
 
 static uint8_t  sdp_avdtp_sink_service_buffer[150];
@@ -124,29 +114,20 @@ static char * wav_filename = "a2dp_sink_demo.wav";
 static btstack_sbc_decoder_state_t state;
 static btstack_sbc_mode_t mode = SBC_MODE_STANDARD;
 
-// ring buffer for SBC Frames
-// below 30: add samples, 30-40: fine, above 40: drop samples
+// jitter buffer for SBC Frames
+// below 60: add samples, 60-80: fine, above 80: drop samples
 #define OPTIMAL_FRAMES_MIN 60
 #define OPTIMAL_FRAMES_MAX 80
 #define ADDITIONAL_FRAMES  30
-static uint8_t sbc_frame_storage[(OPTIMAL_FRAMES_MAX + ADDITIONAL_FRAMES) * MAX_SBC_FRAME_SIZE];
-static btstack_ring_buffer_t sbc_frame_ring_buffer;
-static unsigned int sbc_frame_size;
-
-// overflow buffer for not fully used sbc frames, with additional frames for resampling
-static uint8_t decoded_audio_storage[(128+16) * BYTES_PER_FRAME];
-static btstack_ring_buffer_t decoded_audio_ring_buffer;
+static uint8_t sbc_frame_storage[(OPTIMAL_FRAMES_MAX + ADDITIONAL_FRAMES) * (MAX_SBC_FRAME_SIZE + 2)];
+static a2dp_sink_jitter_buffer_t jitter_buffer;
 
 static int media_initialized = 0;
 static int audio_stream_started;
-#ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
-static int l2cap_stream_started;
-#endif
-static btstack_resample_t resample_instance;
 
-// temp storage of lower-layer request for audio samples
-static int16_t * request_buffer;
-static int       request_frames;
+// temp storage of jitter buffer request for a single decoded SBC frame
+static int16_t * decode_buffer;
+static uint16_t  decode_num_frames;
 
 // sink state
 static int volume_percentage = 0;
@@ -375,26 +356,8 @@ static void playback_handler(int16_t * buffer, uint16_t num_audio_frames){
 #endif
     
     // called from lower-layer but guaranteed to be on main thread
-    if (sbc_frame_size == 0){
-        memset(buffer, 0, num_audio_frames * BYTES_PER_FRAME);
-        return;
-    }
-
-    // first fill from resampled audio
-    uint32_t bytes_read;
-    btstack_ring_buffer_read(&decoded_audio_ring_buffer, (uint8_t *) buffer, num_audio_frames * BYTES_PER_FRAME, &bytes_read);
-    buffer          += bytes_read / NUM_CHANNELS;
-    num_audio_frames   -= bytes_read / BYTES_PER_FRAME;
-
-    // then start decoding sbc frames using request_* globals
-    request_buffer = buffer;
-    request_frames = num_audio_frames;
-    while (request_frames && btstack_ring_buffer_bytes_available(&sbc_frame_ring_buffer) >= sbc_frame_size){
-        // decode frame
-        uint8_t sbc_frame[MAX_SBC_FRAME_SIZE];
-        btstack_ring_buffer_read(&sbc_frame_ring_buffer, sbc_frame, sbc_frame_size, &bytes_read);
-        btstack_sbc_decoder_process_data(&state, 0, sbc_frame, sbc_frame_size);
-    }
+    // jitter buffer decodes SBC frames on demand and plays silence until enough frames are buffered
+    a2dp_sink_jitter_buffer_read_audio(&jitter_buffer, buffer, num_audio_frames);
 
 #ifdef STORE_TO_WAV_FILE
     audio_frame_count += num_audio_frames;
@@ -407,35 +370,44 @@ static void handle_pcm_data(int16_t * data, int num_audio_frames, int num_channe
     UNUSED(context);
     UNUSED(num_channels);   // must be stereo == 2
 
-    const btstack_audio_sink_t * audio_sink = btstack_audio_sink_get_instance();
-    if (!audio_sink){
-#ifdef STORE_TO_WAV_FILE
-        audio_frame_count += num_audio_frames;
-        wav_writer_write_int16(num_audio_frames * NUM_CHANNELS, data);
-#endif
+    // decoding for jitter buffer: store in its buffer
+    if (decode_buffer != NULL){
+        uint16_t frames_to_copy = btstack_min(num_audio_frames, A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME);
+        memcpy(decode_buffer, data, frames_to_copy * BYTES_PER_FRAME);
+        decode_num_frames = frames_to_copy;
         return;
     }
 
-    // resample into request buffer - add some additional space for resampling
-    int16_t  output_buffer[(128+16) * NUM_CHANNELS]; // 16 * 8 * 2
-    uint32_t resampled_frames = btstack_resample_block(&resample_instance, data, num_audio_frames, output_buffer);
-
-    // store data in btstack_audio buffer first
-    int frames_to_copy = btstack_min(resampled_frames, request_frames);
-    memcpy(request_buffer, output_buffer, frames_to_copy * BYTES_PER_FRAME);
-    request_frames  -= frames_to_copy;
-    request_buffer  += frames_to_copy * NUM_CHANNELS;
-
-    // and rest in ring buffer
-    int frames_to_store = resampled_frames - frames_to_copy;
-    if (frames_to_store){
-        int status = btstack_ring_buffer_write(&decoded_audio_ring_buffer, (uint8_t *)&output_buffer[frames_to_copy * NUM_CHANNELS], frames_to_store * BYTES_PER_FRAME);
-        if (status){
-            printf("Error storing samples in PCM ring buffer!!!\n");
-        }
-    }
+#ifdef STORE_TO_WAV_FILE
+    // no audio implementation active, e.g. on posix systems to store as .wav
+    audio_frame_count += num_audio_frames;
+    wav_writer_write_int16(num_audio_frames * NUM_CHANNELS, data);
+#else
+    UNUSED(data);
+    UNUSED(num_audio_frames);
+#endif
+}
+
+static uint16_t decode_sbc_frame(void * context, const uint8_t * frame, uint16_t frame_len, int16_t * pcm_buffer){
+    UNUSED(context);
+    // SBC decoder does not provide packet loss concealment for A2DP, use jitter buffer instead
+    if (frame == NULL) return 0;
+    decode_buffer = pcm_buffer;
+    decode_num_frames = 0;
+    btstack_sbc_decoder_process_data(&state, 0, frame, frame_len);
+    decode_buffer = NULL;
+    return decode_num_frames;
 }
 
+#ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
+static uint32_t get_playback_sample_rate(void * context){
+    UNUSED(context);
+    const btstack_audio_sink_t * audio = btstack_audio_sink_get_instance();
+    if (audio == NULL) return 0;
+    return audio->get_samplerate();
+}
+#endif
+
 static int media_processing_init(media_codec_configuration_sbc_t * configuration){
     if (media_initialized) return 0;
     btstack_sbc_decoder_init(&state, mode, handle_pcm_data, NULL);
@@ -444,9 +416,16 @@ static int media_processing_init(media_codec_configuration_sbc_t * configuration
     wav_writer_open(wav_filename, configuration->num_channels, configuration->sampling_frequency);
 #endif
 
-    btstack_ring_buffer_init(&sbc_frame_ring_buffer, sbc_frame_storage, sizeof(sbc_frame_storage));
-    btstack_ring_buffer_init(&decoded_audio_ring_buffer, decoded_audio_storage, sizeof(decoded_audio_storage));
-    btstack_resample_init(&resample_instance, configuration->num_channels);
+    // setup jitter buffer with latency targets given in SBC frames
+    uint16_t samples_per_frame = configuration->block_length * configuration->subbands;
+    a2dp_sink_jitter_buffer_init(&jitter_buffer, sbc_frame_storage, sizeof(sbc_frame_storage),
+                                 configuration->sampling_frequency, NUM_CHANNELS, samples_per_frame, &decode_sbc_frame, NULL);
+    a2dp_sink_jitter_buffer_set_latency(&jitter_buffer,
+                                        (OPTIMAL_FRAMES_MIN * samples_per_frame * 1000) / configuration->sampling_frequency,
+                                        (OPTIMAL_FRAMES_MAX * samples_per_frame * 1000) / configuration->sampling_frequency);
+#ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
+    a2dp_sink_jitter_buffer_set_playback_sample_rate_callback(&jitter_buffer, &get_playback_sample_rate);
+#endif
 
     // setup audio playback
     const btstack_audio_sink_t * audio = btstack_audio_sink_get_instance();
@@ -462,9 +441,6 @@ static int media_processing_init(media_codec_configuration_sbc_t * configuration
 static void media_processing_start(void){
     if (!media_initialized) return;
 
-#ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
-    btstack_sample_rate_compensation_reset( &sample_rate_compensation, btstack_run_loop_get_time_ms() );
-#endif
     // setup audio playback
     const btstack_audio_sink_t * audio = btstack_audio_sink_get_instance();
     if (audio){
@@ -478,17 +454,13 @@ static void media_processing_pause(void){
 
     // stop audio playback
     audio_stream_started = 0;
-#ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
-    l2cap_stream_started = 0;
-#endif
 
     const btstack_audio_sink_t * audio = btstack_audio_sink_get_instance();
     if (audio){
         audio->stop_stream();
     }
     // discard pending data
-    btstack_ring_buffer_reset(&decoded_audio_ring_buffer);
-    btstack_ring_buffer_reset(&sbc_frame_ring_buffer);
+    a2dp_sink_jitter_buffer_reset(&jitter_buffer);
 }
 
 static void media_processing_close(void){
@@ -496,10 +468,6 @@ static void media_processing_close(void){
 
     media_initialized = 0;
     audio_stream_started = 0;
-    sbc_frame_size = 0;
-#ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
-    l2cap_stream_started = 0;
-#endif
 
 #ifdef STORE_TO_WAV_FILE                 
     wav_writer_close();
@@ -521,8 +489,9 @@ static void media_processing_close(void){
  *
  * @text Here the audio data, are received through the handle_l2cap_media_data_packet callback.
  * Currently, only the SBC media codec is supported. Hence, the media data consists of the media packet header and the SBC packet.
- * The SBC frame will be stored in a ring buffer for later processing (instead of decoding it to PCM right away which would require a much larger buffer).
- * If the audio stream wasn't started already and there are enough SBC frames in the ring buffer, start playback.
+ * The SBC frames will be stored in the A2DP Sink Jitter Buffer for later processing (instead of decoding it to PCM right away which would require a much larger buffer).
+ * The jitter buffer decodes the frames on demand from the playback callback and compensates clock drift between A2DP Source and audio playback.
+ * If the audio stream wasn't started already and there are enough SBC frames in the jitter buffer, start playback.
  */ 
 
 static int read_media_data_header(uint8_t * packet, int size, int * offset, avdtp_media_packet_header_t * media_header);
@@ -548,46 +517,15 @@ static void handle_l2cap_media_data_packet(uint8_t seid, uint8_t *packet, uint16
         return;
     }
 
-
-    // store sbc frame size for buffer management
-    sbc_frame_size = packet_length / sbc_header.num_frames;
-    int status = btstack_ring_buffer_write(&sbc_frame_ring_buffer, packet_begin, packet_length);
+    // store sbc frames in jitter buffer, which also detects lost packets and compensates clock drift
+    uint8_t status = a2dp_sink_jitter_buffer_write_frames(&jitter_buffer, btstack_run_loop_get_time_ms(), media_header.sequence_number,
+                                                          packet_begin, packet_length, sbc_header.num_frames);
     if (status != ERROR_CODE_SUCCESS){
-        printf("Error storing samples in SBC ring buffer!!!\n");
-    }
-
-    // decide on audio sync drift based on number of sbc frames in queue
-    int sbc_frames_in_buffer = btstack_ring_buffer_bytes_available(&sbc_frame_ring_buffer) / sbc_frame_size;
-#ifdef HAVE_BTSTACK_AUDIO_EFFECTIVE_SAMPLERATE
-    if( !l2cap_stream_started && audio_stream_started ) {
-        l2cap_stream_started = 1;
-        btstack_sample_rate_compensation_init( &sample_rate_compensation, btstack_run_loop_get_time_ms(), a2dp_sink_demo_a2dp_connection.sbc_configuration.sampling_frequency, FLOAT_TO_Q15(1.f) );
-    }
-    // update sample rate compensation
-    if( audio_stream_started && (audio != NULL)) {
-        uint32_t resampling_factor = btstack_sample_rate_compensation_update( &sample_rate_compensation, btstack_run_loop_get_time_ms(), sbc_header.num_frames*128, audio->get_samplerate() );
-        btstack_resample_set_factor(&resample_instance, resampling_factor);
-//        printf("sbc buffer level :            %"PRIu32"\n", btstack_ring_buffer_bytes_available(&sbc_frame_ring_buffer));
-    }
-#else
-    uint32_t resampling_factor;
-
-    // nominal factor (fixed-point 2^16) and compensation offset
-    uint32_t nominal_factor = 0x10000;
-    uint32_t compensation   = 0x00100;
-
-    if (sbc_frames_in_buffer < OPTIMAL_FRAMES_MIN){
-    	resampling_factor = nominal_factor - compensation;    // stretch samples
-    } else if (sbc_frames_in_buffer <= OPTIMAL_FRAMES_MAX){
-    	resampling_factor = nominal_factor;                   // nothing to do
-    } else {
-    	resampling_factor = nominal_factor + compensation;    // compress samples
+        printf("Error storing samples in SBC jitter buffer!!!\n");
     }
 
-    btstack_resample_set_factor(&resample_instance, resampling_factor);
-#endif
     // start stream if enough frames buffered
-    if (!audio_stream_started && sbc_frames_in_buffer >= OPTIMAL_FRAMES_MIN){
+    if (!audio_stream_started && a2dp_sink_jitter_buffer_is_playing(&jitter_buffer)){
         media_processing_start();
     }
 }
@@ -117,6 +117,13 @@ static const uint8_t keytable_us_shift[] = {
 // SDP
 static uint8_t hid_descriptor_storage[MAX_ATTRIBUTE_VALUE_SIZE];
 
+// HID Report Layout, compiled once when HID Descriptor becomes available
+#define MAX_NR_HID_REPORTS  8
+#define MAX_NR_HID_FIELDS  64
+static btstack_hid_report_layout_t hid_report_layout;
+static btstack_hid_report_info_t   hid_report_layout_reports[MAX_NR_HID_REPORTS];
+static btstack_hid_report_field_t  hid_report_layout_fields[MAX_NR_HID_FIELDS];
+
 // App
 static enum {
     APP_IDLE,
@@ -169,6 +176,7 @@ static void hid_host_setup(void){
  * @section HID Report Handler
  * 
  * @text Use BTstack's compact HID Parser to process incoming HID Report in Report protocol mode. 
+ * The HID Descriptor has been compiled into a HID Report Layout, so fields are decoded by table lookup.
  * Iterate over all fields and process fields with usage page = 0x07 / Keyboard
  * Check if SHIFT is down and process first character (don't handle multiple key presses)
  * 
@@ -184,21 +192,18 @@ static void hid_host_handle_interrupt_report(const uint8_t * report, uint16_t re
     report++;
     report_len--;
     
-    btstack_hid_parser_t parser;
-    btstack_hid_parser_init(&parser, 
-        hid_descriptor_storage_get_descriptor_data(hid_host_cid), 
-        hid_descriptor_storage_get_descriptor_len(hid_host_cid), 
-        HID_REPORT_TYPE_INPUT, report, report_len);
+    btstack_hid_report_iterator_t iterator;
+    btstack_hid_report_iterator_init(&iterator, &hid_report_layout, HID_REPORT_TYPE_INPUT, report, report_len);
 
     int shift = 0;
     uint8_t new_keys[NUM_KEYS];
     memset(new_keys, 0, sizeof(new_keys));
     int     new_keys_count = 0;
-    while (btstack_hid_parser_has_more(&parser)){
+    while (btstack_hid_report_iterator_has_more(&iterator)){
         uint16_t usage_page;
         uint16_t usage;
         int32_t  value;
-        btstack_hid_parser_get_field(&parser, &usage_page, &usage, &value);
+        btstack_hid_report_iterator_get_field(&iterator, &usage_page, &usage, &value);
         if (usage_page != 0x07) continue;   
         switch (usage){
             case 0xe1:
@@ -328,6 +333,11 @@ static void packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *pack
                             // the application if these reports should be buffered or ignored until 
                             // the HID descriptor is available.
                             status = hid_subevent_descriptor_available_get_status(packet);
+                            if (status == ERROR_CODE_SUCCESS){
+                                btstack_hid_report_layout_init(&hid_report_layout, hid_report_layout_reports, MAX_NR_HID_REPORTS,
+                                                               hid_report_layout_fields, MAX_NR_HID_FIELDS);
+                                status = hid_host_compile_report_layout(hid_host_cid, &hid_report_layout);
+                            }
                             if (status == ERROR_CODE_SUCCESS){
                                 hid_host_descriptor_available = true;
                                 printf("HID Descriptor available, please start typing.\n");
@@ -82,6 +82,19 @@ static hid_protocol_mode_t protocol_mode = HID_PROTOCOL_MODE_REPORT;
 // SDP
 static uint8_t hid_descriptor_storage[500];
 
+// HID Report Layouts, compiled once for Boot Protocol and for each HID Service when connected
+#define MAX_NR_HID_SERVICES  2
+#define MAX_NR_HID_REPORTS   8
+#define MAX_NR_HID_FIELDS   64
+typedef struct {
+    btstack_hid_report_layout_t layout;
+    btstack_hid_report_info_t   reports[MAX_NR_HID_REPORTS];
+    btstack_hid_report_field_t  fields[MAX_NR_HID_FIELDS];
+    bool                        available;
+} hid_report_layout_storage_t;
+static hid_report_layout_storage_t hid_boot_report_layout;
+static hid_report_layout_storage_t hid_service_report_layouts[MAX_NR_HID_SERVICES];
+
 // used to implement connection timeout and reconnect timer
 static btstack_timer_source_t connection_timer;
 
@@ -151,34 +164,32 @@ static void hid_handle_input_report(uint8_t service_index, const uint8_t * repor
     
     if (report_len < 1) return;
     
-    btstack_hid_parser_t parser;
-    
+    const hid_report_layout_storage_t * layout_storage;
     switch (protocol_mode){
         case HID_PROTOCOL_MODE_BOOT:
-            btstack_hid_parser_init(&parser,
-                                    btstack_hid_get_boot_descriptor_data(),
-                                    btstack_hid_get_boot_descriptor_len(),
-                                    HID_REPORT_TYPE_INPUT, report, report_len);
+            layout_storage = &hid_boot_report_layout;
             break;
 
         default:
-            btstack_hid_parser_init(&parser, 
-                hids_client_descriptor_storage_get_descriptor_data(hids_cid, service_index), 
-                hids_client_descriptor_storage_get_descriptor_len(hids_cid, service_index), 
-                HID_REPORT_TYPE_INPUT, report, report_len);
+            if (service_index >= MAX_NR_HID_SERVICES) return;
+            layout_storage = &hid_service_report_layouts[service_index];
             break;
 
     }
-    
+    if (layout_storage->available == false) return;
+
+    btstack_hid_report_iterator_t iterator;
+    btstack_hid_report_iterator_init(&iterator, &layout_storage->layout, HID_REPORT_TYPE_INPUT, report, report_len);
+
     int shift = 0;
     uint8_t new_keys[NUM_KEYS];
     memset(new_keys, 0, sizeof(new_keys));
     int     new_keys_count = 0;
-    while (btstack_hid_parser_has_more(&parser)){
+    while (btstack_hid_report_iterator_has_more(&iterator)){
         uint16_t usage_page;
         uint16_t usage;
         int32_t  value;
-        btstack_hid_parser_get_field(&parser, &usage_page, &usage, &value);
+        btstack_hid_report_iterator_get_field(&iterator, &usage_page, &usage, &value);
         if (usage_page != 0x07) continue;   
         switch (usage){
             case 0xe1:
@@ -322,12 +333,19 @@ static void handle_outgoing_connection_error(void){
  * @param packet
  * @param size
  */
+static void hid_compile_service_report_layout(uint8_t service_index){
+    hid_report_layout_storage_t * storage = &hid_service_report_layouts[service_index];
+    btstack_hid_report_layout_init(&storage->layout, storage->reports, MAX_NR_HID_REPORTS, storage->fields, MAX_NR_HID_FIELDS);
+    storage->available = hids_client_compile_report_layout(hids_cid, service_index, &storage->layout) == ERROR_CODE_SUCCESS;
+}
+
 static void handle_gatt_client_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size) {
     UNUSED(packet_type);
     UNUSED(channel);
     UNUSED(size);
 
     uint8_t status;
+    uint8_t service_index;
 
     if (hci_event_packet_get_type(packet) != HCI_EVENT_GATTSERVICE_META){
         return;
@@ -340,6 +358,11 @@ static void handle_gatt_client_event(uint8_t packet_type, uint16_t channel, uint
                 case ERROR_CODE_SUCCESS:
                     printf("HID service client connected, found %d services\n", 
                         gattservice_subevent_hid_service_connected_get_num_instances(packet));
+
+                    // compile HID Descriptors of services for report decoding
+                    for (service_index = 0; service_index < MAX_NR_HID_SERVICES; service_index++){
+                        hid_compile_service_report_layout(service_index);
+                    }
         
                                         // store device as bonded
                     if (btstack_tlv_singleton_impl){
@@ -514,6 +537,12 @@ int btstack_main(int argc, const char * argv[]){
 
     hids_client_init(hid_descriptor_storage, sizeof(hid_descriptor_storage));
 
+    // compile Boot Protocol HID Descriptor once
+    btstack_hid_report_layout_init(&hid_boot_report_layout.layout, hid_boot_report_layout.reports, MAX_NR_HID_REPORTS,
+                                   hid_boot_report_layout.fields, MAX_NR_HID_FIELDS);
+    hid_boot_report_layout.available = btstack_hid_report_layout_compile(&hid_boot_report_layout.layout,
+        btstack_hid_get_boot_descriptor_len(), btstack_hid_get_boot_descriptor_data()) == ERROR_CODE_SUCCESS;
+
     /* LISTING_END */
 
     // Disable stdout buffering
@@ -86,6 +86,7 @@ typedef struct {
     char test_data[TEST_PACKET_SIZE];
     int  test_data_len;
     uint32_t test_data_sent;
+    uint32_t test_data_received;
     uint32_t test_data_start;
 } le_cbm_connection_t;
 
@@ -97,8 +98,8 @@ static uint8_t data_channel_buffer[TEST_PACKET_SIZE];
 /*
  * @section Track throughput
  * @text We calculate the throughput by setting a start time and measuring the amount of 
- * data sent. After a configurable REPORT_INTERVAL_MS, we print the throughput in kB/s
- * and reset the counter and start time.
+ * data sent and received. After a configurable REPORT_INTERVAL_MS, we print the throughput in kB/s
+ * and reset the counters and start time.
  */
 
 /* LISTING_START(tracking): Tracking throughput */
@@ -106,21 +107,40 @@ static uint8_t data_channel_buffer[TEST_PACKET_SIZE];
 static void test_reset(le_cbm_connection_t * context){
     context->test_data_start = btstack_run_loop_get_time_ms();
     context->test_data_sent = 0;
+    context->test_data_received = 0;
 }
 
-static void test_track_data(le_cbm_connection_t * context, int bytes_transferred){
-    context->test_data_sent += bytes_transferred;
+static void test_report(le_cbm_connection_t * context){
     // evaluate
     uint32_t now = btstack_run_loop_get_time_ms();
     uint32_t time_passed = now - context->test_data_start;
     if (time_passed < REPORT_INTERVAL_MS) return;
     // print speed
-    int bytes_per_second = context->test_data_sent * 1000 / time_passed;
-    printf("%c: %"PRIu32" bytes sent-> %u.%03u kB/s\n", context->name, context->test_data_sent, bytes_per_second / 1000, bytes_per_second % 1000);
+    if (context->test_data_sent > 0){
+        int bytes_per_second = context->test_data_sent * 1000 / time_passed;
+        printf("%c: %"PRIu32" bytes sent -> %u.%03u kB/s\n", context->name, context->test_data_sent, bytes_per_second / 1000, bytes_per_second % 1000);
+    }
+    if (context->test_data_received > 0){
+        int bytes_per_second = context->test_data_received * 1000 / time_passed;
+        printf("%c: %"PRIu32" bytes received -> %u.%03u kB/s\n", context->name, context->test_data_received, bytes_per_second / 1000, bytes_per_second % 1000);
+    }
 
     // restart
-    context->test_data_start = now;
-    context->test_data_sent  = 0;
+    context->test_data_start    = now;
+    context->test_data_sent     = 0;
+    context->test_data_received = 0;
+}
+
+#ifdef TEST_STREAM_DATA
+static void test_track_data_sent(le_cbm_connection_t * context, int bytes_transferred){
+    context->test_data_sent += bytes_transferred;
+    test_report(context);
+}
+#endif
+
+static void test_track_data_received(le_cbm_connection_t * context, int bytes_transferred){
+    context->test_data_received += bytes_transferred;
+    test_report(context);
 }
 /* LISTING_END(tracking): Tracking throughput */
 
@@ -136,21 +156,21 @@ static void test_track_data(le_cbm_connection_t * context, int bytes_transferred
  /* LISTING_START(streamer): Streaming code */
 static void streamer(void){
 
-    if (le_data_channel_connection.cid == 0) return;
+    if (le_cbm_connection.cid == 0) return;
 
     // create test data
-    le_data_channel_connection.counter++;
-    if (le_data_channel_connection.counter > 'Z') le_data_channel_connection.counter = 'A';
-    memset(le_data_channel_connection.test_data, le_data_channel_connection.counter, le_data_channel_connection.test_data_len);
+    le_cbm_connection.counter++;
+    if (le_cbm_connection.counter > 'Z') le_cbm_connection.counter = 'A';
+    memset(le_cbm_connection.test_data, le_cbm_connection.counter, le_cbm_connection.test_data_len);
 
     // send
-    l2cap_cbm_send_data(le_data_channel_connection.cid, (uint8_t *) le_data_channel_connection.test_data, le_data_channel_connection.test_data_len);
+    l2cap_send(le_cbm_connection.cid, (uint8_t *) le_cbm_connection.test_data, le_cbm_connection.test_data_len);
 
     // track
-    test_track_data(&le_data_channel_connection, le_data_channel_connection.test_data_len);
+    test_track_data_sent(&le_cbm_connection, le_cbm_connection.test_data_len);
 
     // request another packet
-    l2cap_cbm_request_can_send_now_event(le_data_channel_connection.cid);
+    l2cap_request_can_send_now_event(le_cbm_connection.cid);
 } 
 /* LISTING_END */
 #endif
@@ -245,9 +265,11 @@ static void packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *pack
                         le_cbm_connection.connection_handle = handle;
                         le_cbm_connection.test_data_len = btstack_min(l2cap_event_cbm_channel_opened_get_remote_mtu(packet), sizeof(le_cbm_connection.test_data));
                         printf("Test packet size: %u\n", le_cbm_connection.test_data_len);
+                        // send all K-frames of a test packet in one go
+                        l2cap_cbm_set_throughput_mode(cid, true);
                         test_reset(&le_cbm_connection);
 #ifdef TEST_STREAM_DATA
-                        l2cap_cbm_request_can_send_now_event(le_data_channel_connection.cid);
+                        l2cap_request_can_send_now_event(le_cbm_connection.cid);
 #endif
                     } else {
                         printf("L2CAP: Connection to device %s failed, status 0x%02x\n", bd_addr_to_str(event_address), status);
@@ -260,7 +282,7 @@ static void packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *pack
                     break;
 
 #ifdef TEST_STREAM_DATA
-                case L2CAP_EVENT_CBM_CAN_SEND_NOW:
+                case L2CAP_EVENT_CAN_SEND_NOW:
                     streamer();
                     break;
 #endif
@@ -271,7 +293,7 @@ static void packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *pack
             break;
 
         case L2CAP_DATA_PACKET:
-            test_track_data(&le_cbm_connection, size);
+            test_track_data_received(&le_cbm_connection, size);
             break;
 
         default:
@@ -391,7 +391,7 @@ static void packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *pack
                     break;
 
                 /* @text BNEP_EVENT_CAN_SEND_NOW indicates that a new packet can be send. This triggers the send of a 
-                 * stored network packet. The tap datas source can be enabled again
+                 * stored network packet. Afterwards, the network interface delivers the next queued packet
                  */
                 case BNEP_EVENT_CAN_SEND_NOW:
                     if (network_buffer_len > 0) {
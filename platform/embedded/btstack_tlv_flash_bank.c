@@ -192,6 +192,83 @@ static void tlv_iterator_fetch_next(btstack_tlv_flash_bank_t * self, tlv_iterato
 	btstack_tlv_flash_bank_iterator_fetch_tag_len(self, it);
 }
 
+// tag index, sorted by tag
+
+// @returns position of tag in index or position where it should be inserted
+static uint16_t btstack_tlv_flash_bank_index_find(btstack_tlv_flash_bank_t * self, uint32_t tag, bool * found){
+	uint16_t low  = 0;
+	uint16_t high = self->index_count;
+	while (low < high){
+		uint16_t mid = (low + high) / 2;
+		uint32_t mid_tag = self->index[mid].tag;
+		if (mid_tag == tag){
+			*found = true;
+			return mid;
+		}
+		if (mid_tag < tag){
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	*found = false;
+	return low;
+}
+
+// @returns offset of latest entry for tag or 0 if not found
+static uint32_t btstack_tlv_flash_bank_index_get(btstack_tlv_flash_bank_t * self, uint32_t tag){
+	bool found;
+	uint16_t pos = btstack_tlv_flash_bank_index_find(self, tag, &found);
+	return found ? self->index[pos].offset : 0;
+}
+
+static void btstack_tlv_flash_bank_index_set(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset){
+	if (!self->index_valid) return;
+	bool found;
+	uint16_t pos = btstack_tlv_flash_bank_index_find(self, tag, &found);
+	if (found){
+		self->index[pos].offset = offset;
+		return;
+	}
+	if (self->index_count >= BTSTACK_TLV_FLASH_BANK_INDEX_SIZE){
+		log_info("tag index full, scan bank for lookups");
+		self->index_valid = false;
+		return;
+	}
+	memmove(&self->index[pos + 1], &self->index[pos], (self->index_count - pos) * sizeof(btstack_tlv_flash_bank_index_entry_t));
+	self->index[pos].tag    = tag;
+	self->index[pos].offset = offset;
+	self->index_count++;
+}
+
+#ifndef ENABLE_TLV_FLASH_WRITE_ONCE
+static void btstack_tlv_flash_bank_index_remove(btstack_tlv_flash_bank_t * self, uint32_t tag){
+	if (!self->index_valid) return;
+	bool found;
+	uint16_t pos = btstack_tlv_flash_bank_index_find(self, tag, &found);
+	if (!found) return;
+	self->index_count--;
+	memmove(&self->index[pos], &self->index[pos + 1], (self->index_count - pos) * sizeof(btstack_tlv_flash_bank_index_entry_t));
+}
+#endif
+
+static void btstack_tlv_flash_bank_index_reset(btstack_tlv_flash_bank_t * self){
+	self->index_valid = true;
+	self->index_count = 0;
+}
+
+static void btstack_tlv_flash_bank_index_build(btstack_tlv_flash_bank_t * self){
+	btstack_tlv_flash_bank_index_reset(self);
+	tlv_iterator_t it;
+	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
+	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
+		if (it.tag){
+			btstack_tlv_flash_bank_index_set(self, it.tag, it.offset);
+		}
+		tlv_iterator_fetch_next(self, &it);
+	}
+}
+
 //
 
 // check both banks for headers and pick the one with the higher epoch % 4
@@ -260,6 +337,7 @@ static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
 	// erase bank (if needed)
 	btstack_tlv_flash_bank_erase_bank(self, next_bank);
 	int next_write_pos = 8;
+	bool index_valid = self->index_valid;
 
 	tlv_iterator_t it;
 	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
@@ -272,19 +350,29 @@ static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
             bool tag_valid = true;
 
 #ifdef ENABLE_TLV_FLASH_WRITE_ONCE
-            // search until end for newer entry of same tag
-            tlv_iterator_t it2;
-            memcpy(&it2, &it, sizeof(tlv_iterator_t));
-            while (btstack_tlv_flash_bank_iterator_has_next(self, &it2)){
-                if ((it2.offset != it.offset) && (it2.tag == it.tag)){
+            if (index_valid){
+                // index points to newest entry of tag
+                uint32_t newest_offset = btstack_tlv_flash_bank_index_get(self, it.tag);
+                if (newest_offset != it.offset){
                     tag_valid = false;
-                    break;
+                    log_info("skip pos %u, tag '%x' as newer entry found at %u", (unsigned int) tag_index, (unsigned int) it.tag,
+                        (unsigned int) newest_offset);
+                }
+            } else {
+                // search until end for newer entry of same tag
+                tlv_iterator_t it2;
+                memcpy(&it2, &it, sizeof(tlv_iterator_t));
+                while (btstack_tlv_flash_bank_iterator_has_next(self, &it2)){
+                    if ((it2.offset != it.offset) && (it2.tag == it.tag)){
+                        tag_valid = false;
+                        break;
+                    }
+                    tlv_iterator_fetch_next(self, &it2);
+                }
+                if (tag_valid == false){
+                    log_info("skip pos %u, tag '%x' as newer entry found at %u", (unsigned int) tag_index, (unsigned int) it.tag,
+                        (unsigned int) it2.offset);
                 }
-                tlv_iterator_fetch_next(self, &it2);
-            }
-            if (tag_valid == false){
-			    log_info("skip pos %u, tag '%x' as newer entry found at %u", (unsigned int) tag_index, (unsigned int) it.tag,
-                    (unsigned int) it2.offset);
             }
 #endif
 
@@ -293,6 +381,11 @@ static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
                 log_info("migrate pos %u, tag '%x' len %u -> new pos %u",
                          (unsigned int) tag_index, (unsigned int) it.tag, (unsigned int) tag_len, next_write_pos);
 
+                // only newest entry gets copied, so index can be updated in place
+                if (index_valid){
+                    btstack_tlv_flash_bank_index_set(self, it.tag, next_write_pos);
+                }
+
                 // copy header
                 uint8_t header_buffer[8];
                 btstack_tlv_flash_bank_read(self, self->current_bank, tag_index, header_buffer, 8);
@@ -327,26 +420,35 @@ static void btstack_tlv_flash_bank_migrate(btstack_tlv_flash_bank_t * self){
 	btstack_tlv_flash_bank_write_header(self, next_bank, (epoch_buffer + 1) & 3);
 	self->current_bank = next_bank;
 	self->write_offset = next_write_pos;
+
+	// index overflowed before, retry with compacted bank
+	if (!index_valid){
+		btstack_tlv_flash_bank_index_build(self);
+	}
 }
 
 #ifndef ENABLE_TLV_FLASH_WRITE_ONCE
-static void btstack_tlv_flash_bank_delete_tag_until_offset(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset){
-	tlv_iterator_t it;
-	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
-	while (btstack_tlv_flash_bank_iterator_has_next(self, &it) && it.offset < offset){
-		if (it.tag == tag){
-			log_info("Erase tag '%x' at position %u", (unsigned int) tag, (unsigned int) it.offset);
+static void btstack_tlv_flash_bank_delete_entry(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset){
+	UNUSED(tag);
+	log_info("Erase tag '%x' at position %u", (unsigned int) tag, (unsigned int) offset);
 
-			// mark entry as invalid
-			uint32_t zero_value = 0;
+	// mark entry as invalid
+	uint32_t zero_value = 0;
 #ifdef ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD
-			// write delete field at offset 8
-			btstack_tlv_flash_bank_write(self, self->current_bank, it.offset+8, (uint8_t*) &zero_value, sizeof(zero_value));
+	// write delete field at offset 8
+	btstack_tlv_flash_bank_write(self, self->current_bank, offset+8, (uint8_t*) &zero_value, sizeof(zero_value));
 #else
-			// overwrite tag with zero value
-			btstack_tlv_flash_bank_write(self, self->current_bank, it.offset, (uint8_t*) &zero_value, sizeof(zero_value));
+	// overwrite tag with zero value
+	btstack_tlv_flash_bank_write(self, self->current_bank, offset, (uint8_t*) &zero_value, sizeof(zero_value));
 #endif
+}
 
+static void btstack_tlv_flash_bank_delete_tag_until_offset(btstack_tlv_flash_bank_t * self, uint32_t tag, uint32_t offset){
+	tlv_iterator_t it;
+	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
+	while (btstack_tlv_flash_bank_iterator_has_next(self, &it) && it.offset < offset){
+		if (it.tag == tag){
+			btstack_tlv_flash_bank_delete_entry(self, tag, it.offset);
 		}
 		tlv_iterator_fetch_next(self, &it);
 	}
@@ -366,18 +468,26 @@ static int btstack_tlv_flash_bank_get_tag(void * context, uint32_t tag, uint8_t
 
 	uint32_t tag_index = 0;
 	uint32_t tag_len   = 0;
-	tlv_iterator_t it;
-	btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
-	while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
-		if (it.tag == tag){
-			log_info("Found tag '%x' at position %u", (unsigned int) tag, (unsigned int) it.offset);
-			tag_index = it.offset;
-			tag_len   = it.len;
+	if (self->index_valid){
+		tag_index = btstack_tlv_flash_bank_index_get(self, tag);
+		if (tag_index == 0) return 0;
+		uint8_t entry[8];
+		btstack_tlv_flash_bank_read(self, self->current_bank, tag_index, entry, 8);
+		tag_len = big_endian_read_32(entry, 4);
+	} else {
+		tlv_iterator_t it;
+		btstack_tlv_flash_bank_iterator_init(self, &it, self->current_bank);
+		while (btstack_tlv_flash_bank_iterator_has_next(self, &it)){
+			if (it.tag == tag){
+				log_info("Found tag '%x' at position %u", (unsigned int) tag, (unsigned int) it.offset);
+				tag_index = it.offset;
+				tag_len   = it.len;
 #ifndef ENABLE_TLV_FLASH_WRITE_ONCE
-			break;
+				break;
 #endif
+			}
+			tlv_iterator_fetch_next(self, &it);
 		}
-		tlv_iterator_fetch_next(self, &it);
 	}
 	if (tag_index == 0) return 0;
 	if (!buffer) return tag_len;
@@ -433,9 +543,18 @@ static int btstack_tlv_flash_bank_store_tag(void * context, uint32_t tag, const
 
 #ifndef ENABLE_TLV_FLASH_WRITE_ONCE
 	// overwrite old entries (if exists)
-	btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
+	if (self->index_valid){
+		uint32_t old_offset = btstack_tlv_flash_bank_index_get(self, tag);
+		if (old_offset != 0){
+			btstack_tlv_flash_bank_delete_entry(self, tag, old_offset);
+		}
+	} else {
+		btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
+	}
 #endif
 
+	btstack_tlv_flash_bank_index_set(self, tag, self->write_offset);
+
 	// done
 	self->write_offset += sizeof(entry) + btstack_tlv_flash_bank_align_size(self, data_size);
 
@@ -456,7 +575,15 @@ static void btstack_tlv_flash_bank_delete_tag(void * context, uint32_t tag){
     btstack_tlv_flash_bank_store_tag(context, tag, NULL, 0);
 #else
     btstack_tlv_flash_bank_t * self = (btstack_tlv_flash_bank_t *) context;
-	btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
+	if (self->index_valid){
+		uint32_t offset = btstack_tlv_flash_bank_index_get(self, tag);
+		if (offset != 0){
+			btstack_tlv_flash_bank_delete_entry(self, tag, offset);
+			btstack_tlv_flash_bank_index_remove(self, tag);
+		}
+	} else {
+		btstack_tlv_flash_bank_delete_tag_until_offset(self, tag, self->write_offset);
+	}
 #endif
 }
 
@@ -474,6 +601,7 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 	self->hal_flash_bank_impl    = hal_flash_bank_impl;
 	self->hal_flash_bank_context = hal_flash_bank_context;
 	self->delete_tag_len = 0;
+	btstack_tlv_flash_bank_index_reset(self);
 
 #ifdef ENABLE_TLV_FLASH_EXPLICIT_DELETE_FIELD
 	if (hal_flash_bank_impl->get_alignment(hal_flash_bank_context) > 8){
@@ -491,7 +619,7 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 	log_info("found bank %d", self->current_bank);
 	if (self->current_bank >= 0){
 
-		// find last entry and write offset
+		// find last entry and write offset, collect tag index
 		tlv_iterator_t it;
 #ifndef ENABLE_TLV_FLASH_WRITE_ONCE
 		uint32_t last_tag = 0;
@@ -503,6 +631,9 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 			last_tag = it.tag;
 			last_offset = it.offset;
 #endif
+			if (it.tag){
+				btstack_tlv_flash_bank_index_set(self, it.tag, it.offset);
+			}
 			tlv_iterator_fetch_next(self, &it);
 		}
 		self->write_offset = it.offset;
@@ -533,6 +664,7 @@ const btstack_tlv_t * btstack_tlv_flash_bank_init_instance(btstack_tlv_flash_ban
 
 	if (self->current_bank < 0) {
 		btstack_tlv_flash_bank_erase_bank(self, 0);
+		btstack_tlv_flash_bank_index_reset(self);
 		self->current_bank = 0;
 		btstack_tlv_flash_bank_write_header(self, self->current_bank, 0);	// epoch = 0;
 		self->write_offset = 8;
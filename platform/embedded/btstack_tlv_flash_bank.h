@@ -39,7 +39,10 @@
 #ifndef BTSTACK_TLV_FLASH_BANK_H
 #define BTSTACK_TLV_FLASH_BANK_H
 
+#include "btstack_config.h"
+
 #include <stdint.h>
+#include "btstack_bool.h"
 #include "btstack_tlv.h"
 #include "hal_flash_bank.h"
 
@@ -47,12 +50,26 @@
 extern "C" {
 #endif
 
+// max number of tags tracked by the in-RAM tag index, lookup falls back to scanning the bank if exceeded
+#ifndef BTSTACK_TLV_FLASH_BANK_INDEX_SIZE
+#define BTSTACK_TLV_FLASH_BANK_INDEX_SIZE 32
+#endif
+
+typedef struct {
+    uint32_t tag;
+    uint32_t offset;
+} btstack_tlv_flash_bank_index_entry_t;
+
 typedef struct {
 	const    hal_flash_bank_t * hal_flash_bank_impl;
 	void *   hal_flash_bank_context;
     uint32_t write_offset;
 	int8_t   current_bank;
     uint8_t  delete_tag_len;
+    // tag -> offset of latest entry in current bank, sorted by tag
+    bool     index_valid;
+    uint16_t index_count;
+    btstack_tlv_flash_bank_index_entry_t index[BTSTACK_TLV_FLASH_BANK_INDEX_SIZE];
 } btstack_tlv_flash_bank_t;
 
 /**
@@ -43,6 +43,7 @@
 #include "btstack_debug.h"
 #include "btstack_audio.h"
 #include "btstack_run_loop.h"
+#include "btstack_spsc_ring_buffer.h"
 
 #ifdef HAVE_PORTAUDIO
 
@@ -50,6 +51,8 @@
 #define NUM_FRAMES_PER_PA_BUFFER       512
 #define NUM_OUTPUT_BUFFERS               5
 #define NUM_INPUT_BUFFERS                2
+// ring buffer storage in PortAudio buffers, power of two >= NUM_OUTPUT_BUFFERS
+#define NUM_OUTPUT_BUFFERS_STORAGE       8
 #define DRIVER_POLL_INTERVAL_MS          5
 
 #include <portaudio.h>
@@ -78,18 +81,13 @@ static PaStream * stream_sink;
 static void (*playback_callback)(int16_t * buffer, uint16_t num_samples);
 static void (*recording_callback)(const int16_t * buffer, uint16_t num_samples);
 
-// output buffer
-static int16_t               output_buffer_storage[NUM_OUTPUT_BUFFERS * NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
-static int16_t             * output_buffers[NUM_OUTPUT_BUFFERS];
-static int                   output_buffer_to_play;
-static int                   output_buffer_to_fill;
+// output buffer: filled by run loop, drained by PortAudio thread
+static int16_t                    output_buffer_storage[NUM_OUTPUT_BUFFERS_STORAGE * NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
+static btstack_spsc_ring_buffer_t output_ring_buffer;
 
-// input buffer
-static int16_t               input_buffer_a[NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
-static int16_t               input_buffer_b[NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
-static int16_t             * input_buffers[NUM_INPUT_BUFFERS] = { input_buffer_a, input_buffer_b};
-static int                   input_buffer_to_record;
-static int                   input_buffer_to_fill;
+// input buffer: filled by PortAudio thread, drained by run loop
+static int16_t                    input_buffer_storage[NUM_INPUT_BUFFERS * NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
+static btstack_spsc_ring_buffer_t input_ring_buffer;
 
 
 // timer to fill output ring buffer
@@ -113,10 +111,18 @@ static int portaudio_callback_sink( const void *                     inputBuffer
 
     // simplified volume control
     uint16_t index;
-    int16_t * from_buffer = output_buffers[output_buffer_to_play];
     int16_t * to_buffer = (int16_t *) outputBuffer;
     btstack_assert(frames_per_buffer == NUM_FRAMES_PER_PA_BUFFER);
 
+    // play silence on underrun
+    uint32_t num_bytes_per_buffer = NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_sink;
+    uint32_t span_length;
+    const int16_t * from_buffer = (const int16_t *) btstack_spsc_ring_buffer_peek(&output_ring_buffer, &span_length);
+    if (span_length < num_bytes_per_buffer){
+        memset(to_buffer, 0, num_bytes_per_buffer);
+        return 0;
+    }
+
 #if 0
     // up to 8 right shifts
     int right_shift = 8 - btstack_min(8, ((sink_volume + 15) / 16));
@@ -133,7 +139,7 @@ static int portaudio_callback_sink( const void *                     inputBuffer
 #endif
 
     // next
-    output_buffer_to_play = (output_buffer_to_play + 1 ) % NUM_OUTPUT_BUFFERS;
+    btstack_spsc_ring_buffer_consume(&output_ring_buffer, num_bytes_per_buffer);
 
     return 0;
 }
@@ -153,23 +159,30 @@ static int portaudio_callback_source( const void *                     inputBuff
     (void) samples_per_buffer;
     (void) outputBuffer;
 
-    // store in one of our buffers
-    memcpy(input_buffers[input_buffer_to_fill], inputBuffer, NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_source);
-
-    // next
-    input_buffer_to_fill = (input_buffer_to_fill + 1 ) % NUM_INPUT_BUFFERS;
+    // store in ring buffer, drop samples on overrun
+    uint32_t num_bytes_per_buffer = NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_source;
+    uint32_t span_length;
+    uint8_t * to_buffer = btstack_spsc_ring_buffer_reserve(&input_ring_buffer, &span_length);
+    if (span_length >= num_bytes_per_buffer){
+        memcpy(to_buffer, inputBuffer, num_bytes_per_buffer);
+        btstack_spsc_ring_buffer_commit(&input_ring_buffer, num_bytes_per_buffer);
+    }
 
     return 0;
 }
 
 static void driver_timer_handler_sink(btstack_timer_source_t * ts){
 
-    // playback buffer ready to fill
-    while (output_buffer_to_play != output_buffer_to_fill){
-        (*playback_callback)(output_buffers[output_buffer_to_fill], NUM_FRAMES_PER_PA_BUFFER);
+    // playback buffer ready to fill: keep up to NUM_OUTPUT_BUFFERS - 1 buffers queued
+    uint32_t num_bytes_per_buffer = NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_sink;
+    while (btstack_spsc_ring_buffer_bytes_available(&output_ring_buffer) < ((NUM_OUTPUT_BUFFERS - 1) * num_bytes_per_buffer)){
+        uint32_t span_length;
+        int16_t * buffer = (int16_t *) btstack_spsc_ring_buffer_reserve(&output_ring_buffer, &span_length);
+        btstack_assert(span_length >= num_bytes_per_buffer);
+        (*playback_callback)(buffer, NUM_FRAMES_PER_PA_BUFFER);
 
         // next
-        output_buffer_to_fill = (output_buffer_to_fill + 1 ) % NUM_OUTPUT_BUFFERS;
+        btstack_spsc_ring_buffer_commit(&output_ring_buffer, num_bytes_per_buffer);
     }
 
     // re-set timer
@@ -179,14 +192,17 @@ static void driver_timer_handler_sink(btstack_timer_source_t * ts){
 
 static void driver_timer_handler_source(btstack_timer_source_t * ts){
 
-    // recording buffer ready to process
-    if (input_buffer_to_record != input_buffer_to_fill){
-
-        (*recording_callback)(input_buffers[input_buffer_to_record], NUM_FRAMES_PER_PA_BUFFER);
+    // recording buffers ready to process
+    uint32_t num_bytes_per_buffer = NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_source;
+    while (btstack_spsc_ring_buffer_bytes_available(&input_ring_buffer) >= num_bytes_per_buffer){
+        uint32_t span_length;
+        const int16_t * buffer = (const int16_t *) btstack_spsc_ring_buffer_peek(&input_ring_buffer, &span_length);
+        btstack_assert(span_length >= num_bytes_per_buffer);
+        (*recording_callback)(buffer, NUM_FRAMES_PER_PA_BUFFER);
 
         // next
-        input_buffer_to_record = (input_buffer_to_record + 1 ) % NUM_INPUT_BUFFERS;
-    }    
+        btstack_spsc_ring_buffer_consume(&input_ring_buffer, num_bytes_per_buffer);
+    }
 
     // re-set timer
     btstack_run_loop_set_timer(ts, DRIVER_POLL_INTERVAL_MS);
@@ -203,10 +219,7 @@ static int btstack_audio_portaudio_sink_init(
     num_channels_sink = channels;
     num_bytes_per_sample_sink = 2 * channels;
 
-    uint8_t i;
-    for (i=0;i<NUM_OUTPUT_BUFFERS;i++){
-        output_buffers[i] = &output_buffer_storage[i * NUM_FRAMES_PER_PA_BUFFER * 2];
-    }
+    btstack_spsc_ring_buffer_init(&output_ring_buffer, (uint8_t *) output_buffer_storage, sizeof(output_buffer_storage));
 
     if (!playback){
         log_error("No playback callback");
@@ -275,6 +288,8 @@ static int btstack_audio_portaudio_source_init(
     num_channels_source = channels;
     num_bytes_per_sample_source = 2 * channels;
 
+    btstack_spsc_ring_buffer_init(&input_ring_buffer, (uint8_t *) input_buffer_storage, sizeof(input_buffer_storage));
+
     if (!recording){
         log_error("No recording callback");
         return 1;
@@ -354,12 +369,15 @@ static void btstack_audio_portaudio_sink_start_stream(void){
     if (!playback_callback) return;
 
     // fill buffers once
+    uint32_t num_bytes_per_buffer = NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_sink;
+    btstack_spsc_ring_buffer_reset(&output_ring_buffer);
     uint8_t i;
     for (i=0;i<NUM_OUTPUT_BUFFERS-1;i++){
-        (*playback_callback)(&output_buffer_storage[i*NUM_FRAMES_PER_PA_BUFFER*2], NUM_FRAMES_PER_PA_BUFFER);
+        uint32_t span_length;
+        int16_t * buffer = (int16_t *) btstack_spsc_ring_buffer_reserve(&output_ring_buffer, &span_length);
+        (*playback_callback)(buffer, NUM_FRAMES_PER_PA_BUFFER);
+        btstack_spsc_ring_buffer_commit(&output_ring_buffer, num_bytes_per_buffer);
     }
-    output_buffer_to_play = 0;
-    output_buffer_to_fill = NUM_OUTPUT_BUFFERS-1;
 
     /* -- start stream -- */
     PaError err = Pa_StartStream(stream_sink);
@@ -380,6 +398,8 @@ static void btstack_audio_portaudio_source_start_stream(void){
 
     if (!recording_callback) return;
 
+    btstack_spsc_ring_buffer_reset(&input_ring_buffer);
+
     /* -- start stream -- */
     PaError err = Pa_StartStream(stream_source);
     if (err != paNoError){
@@ -44,6 +44,7 @@
 
 
 #include "btstack_network.h"
+#include "btstack_network_posix.h"
 
 #include "btstack_config.h"
 
@@ -78,11 +79,25 @@
 
 #include "btstack.h"
 
+// number of Ethernet frames read from the TAP interface that can be queued for BNEP
+#ifndef BTSTACK_NETWORK_POSIX_QUEUE_SIZE
+#define BTSTACK_NETWORK_POSIX_QUEUE_SIZE 8
+#endif
+
+#if BTSTACK_NETWORK_POSIX_QUEUE_SIZE < 1
+#error "BTSTACK_NETWORK_POSIX_QUEUE_SIZE must be at least 1"
+#endif
+
 static int  tap_fd = -1;
-static uint8_t network_buffer[BNEP_MTU_MIN];
-static size_t  network_buffer_len = 0;
 static char tap_dev_name[16];
 
+// ring of received frames, frame at head is delivered to client until btstack_network_packet_sent is called
+static uint8_t  network_queue_frames[BTSTACK_NETWORK_POSIX_QUEUE_SIZE][BNEP_MTU_MIN];
+static uint16_t network_queue_lengths[BTSTACK_NETWORK_POSIX_QUEUE_SIZE];
+static uint16_t network_queue_head;
+static uint16_t network_queue_count;
+static bool     network_queue_head_delivered;
+
 #if defined(__APPLE__) || defined(__FreeBSD__)
 // tuntaposx provides fixed set of tapX devices
 static const char * tap_dev = "/dev/tap0";
@@ -99,38 +114,79 @@ static btstack_data_source_t tap_dev_ds;
 
 static void (*btstack_network_send_packet_callback)(const uint8_t * packet, uint16_t size);
 
+static void btstack_network_queue_reset(void){
+    network_queue_head = 0;
+    network_queue_count = 0;
+    network_queue_head_delivered = false;
+}
+
+static void btstack_network_deliver_next_packet(void){
+    if (network_queue_head_delivered) return;
+    if (network_queue_count == 0) return;
+    network_queue_head_delivered = true;
+    (*btstack_network_send_packet_callback)(network_queue_frames[network_queue_head], network_queue_lengths[network_queue_head]);
+}
+
 /*
- * @text Listing processTapData shows how a packet is received from the TAP network interface
+ * @text Listing processTapData shows how packets are received from the TAP network interface
  * and forwarded over the BNEP connection.
  * 
- * After successfully reading a network packet, the call to
- * the *bnep_can_send_packet_now* function checks, if BTstack can forward
- * a network packet now. If that's not possible, the received data stays
- * in the network buffer and the data source elements is removed from the
- * run loop. The *process_tap_dev_data* function will not be called until
- * the data source is registered again. This provides a basic flow control.
+ * All available network packets are read into a queue of BTSTACK_NETWORK_POSIX_QUEUE_SIZE
+ * frames, and the oldest one is passed to the client. As soon as the client reports that
+ * it has been sent, the next queued packet is delivered without waiting for the TAP
+ * interface. If the queue is full, the data source is disabled and the TAP interface
+ * has to buffer further packets. The *process_tap_dev_data* function will not be called
+ * until a queued packet was sent. This provides a basic flow control.
  */
 
 /* LISTING_START(processTapData): Process incoming network packets */
 static void process_tap_dev_data(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type) 
 {
-    UNUSED(ds);
     UNUSED(callback_type);
 
-    ssize_t len;
-    len = read(ds->source.fd, network_buffer, sizeof(network_buffer));
-    if (len <= 0){
-        fprintf(stderr, "TAP: Error while reading: %s\n", strerror(errno));
-        return;
+    while (network_queue_count < BTSTACK_NETWORK_POSIX_QUEUE_SIZE){
+        uint16_t index = (network_queue_head + network_queue_count) % BTSTACK_NETWORK_POSIX_QUEUE_SIZE;
+        ssize_t len = read(ds->source.fd, network_queue_frames[index], BNEP_MTU_MIN);
+        if (len < 0){
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)){
+                fprintf(stderr, "TAP: Error while reading: %s\n", strerror(errno));
+            }
+            break;
+        }
+        if (len == 0) break;
+        network_queue_lengths[index] = (uint16_t) len;
+        network_queue_count++;
     }
 
-    network_buffer_len = len;
-
-    // disable reading from netif
-    btstack_run_loop_disable_data_source_callbacks(&tap_dev_ds, DATA_SOURCE_CALLBACK_READ);
+    // disable reading from netif if queue is full
+    if (network_queue_count == BTSTACK_NETWORK_POSIX_QUEUE_SIZE){
+        btstack_run_loop_disable_data_source_callbacks(&tap_dev_ds, DATA_SOURCE_CALLBACK_READ);
+    }
 
     // let client now
-    (*btstack_network_send_packet_callback)(network_buffer, network_buffer_len);
+    btstack_network_deliver_next_packet();
+}
+/* LISTING_END */
+
+static int btstack_network_start(int fd){
+    // read all available packets without blocking
+    int flags = fcntl(fd, F_GETFL, 0);
+    if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)){
+        fprintf(stderr, "TAP: Error setting non-blocking mode: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    tap_fd = fd;
+    btstack_network_queue_reset();
+
+    /* Create and register a new runloop data source */
+    btstack_run_loop_set_data_source_fd(&tap_dev_ds, tap_fd);
+    btstack_run_loop_set_data_source_handler(&tap_dev_ds, &process_tap_dev_data);
+    btstack_run_loop_add_data_source(&tap_dev_ds);
+    btstack_run_loop_enable_data_source_callbacks(&tap_dev_ds, DATA_SOURCE_CALLBACK_READ);
+
+    return 0;
 }
 
 /**
@@ -240,16 +296,19 @@ int btstack_network_up(bd_addr_t network_address){
 
     close(fd_socket);
 
-    tap_fd = fd_dev;
     log_info("BNEP device \"%s\" allocated", tap_dev_name);
 
-    /* Create and register a new runloop data source */
-    btstack_run_loop_set_data_source_fd(&tap_dev_ds, tap_fd);
-    btstack_run_loop_set_data_source_handler(&tap_dev_ds, &process_tap_dev_data);
-    btstack_run_loop_add_data_source(&tap_dev_ds);
-    btstack_run_loop_enable_data_source_callbacks(&tap_dev_ds, DATA_SOURCE_CALLBACK_READ);
+    return btstack_network_start(fd_dev);
+}
 
-    return 0;
+/**
+ * @brief Bring up network interface on already opened TAP device
+ * @param fd
+ * @return 0 if ok
+ */
+int btstack_network_posix_up_with_fd(int fd){
+    tap_dev_name[0] = 0;
+    return btstack_network_start(fd);
 }
 
 /**
@@ -273,6 +332,7 @@ int btstack_network_down(void){
         close(tap_fd);
     }
     tap_fd = -1;
+    btstack_network_queue_reset();
     return 0;
 }
 
@@ -300,8 +360,18 @@ void btstack_network_process_packet(const uint8_t * packet, uint16_t size){
  */
 void btstack_network_packet_sent(void){
 
-    network_buffer_len = 0;
+    if (!network_queue_head_delivered) return;
+
+    // release delivered packet
+    network_queue_head_delivered = false;
+    network_queue_head = (network_queue_head + 1) % BTSTACK_NETWORK_POSIX_QUEUE_SIZE;
+    network_queue_count--;
 
     // Re-enable the tap device data source
-    btstack_run_loop_enable_data_source_callbacks(&tap_dev_ds, DATA_SOURCE_CALLBACK_READ);
+    if (tap_fd >= 0){
+        btstack_run_loop_enable_data_source_callbacks(&tap_dev_ds, DATA_SOURCE_CALLBACK_READ);
+    }
+
+    // deliver next queued packet
+    btstack_network_deliver_next_packet();
 }
@@ -236,6 +236,9 @@ static void btstack_run_loop_posix_execute(void) {
         now_ms = btstack_run_loop_posix_get_time_ms();
         btstack_run_loop_base_process_timers(now_ms);
     }
+
+    // allow to execute run loop again
+    btstack_run_loop_posix_exit_requested = false;
 }
 
 static void btstack_run_loop_posix_trigger_exit(void){
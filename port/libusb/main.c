@@ -59,6 +59,7 @@
 #include "btstack_audio.h"
 #include "btstack_chipset_realtek.h"
 #include "btstack_chipset_zephyr.h"
+#include "btstack_crypto_worker_posix.h"
 #include "btstack_debug.h"
 #include "btstack_event.h"
 #include "btstack_memory.h"
@@ -337,6 +338,9 @@ int main(int argc, const char * argv[]){
     // init HCI
 	hci_init(hci_transport_usb_instance(), NULL);
 
+    // calculate ECC P-256 key pairs and DHKey on worker thread
+    btstack_crypto_ecc_p256_set_worker(btstack_crypto_worker_posix_get_instance());
+
 #ifdef HAVE_PORTAUDIO
     btstack_audio_sink_set_instance(btstack_audio_portaudio_sink_get_instance());
     btstack_audio_source_set_instance(btstack_audio_portaudio_source_get_instance());
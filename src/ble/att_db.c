@@ -851,10 +851,11 @@ static uint16_t handle_read_blob_request(att_connection_t * att_connection, uint
 
 //
 // MARK: ATT_READ_MULTIPLE_REQUEST 0x0e
+// MARK: ATT_READ_MULTIPLE_VARIABLE_REQ 0x20
 //
-static uint16_t handle_read_multiple_request2(att_connection_t * att_connection, uint8_t * response_buffer, uint16_t response_buffer_size, uint16_t num_handles, uint8_t * handles){
-    log_info("ATT_READ_MULTIPLE_REQUEST: num handles %u", num_handles);
-    uint8_t request_type = ATT_READ_MULTIPLE_REQUEST;
+static uint16_t handle_read_multiple_request2(att_connection_t * att_connection, uint8_t * response_buffer, uint16_t response_buffer_size, uint16_t num_handles, uint8_t * handles, bool store_length){
+    log_info("ATT_READ_MULTIPLE_(VARIABLE_)REQUEST: num handles %u", num_handles);
+    uint8_t request_type = store_length ? ATT_READ_MULTIPLE_VARIABLE_REQ : ATT_READ_MULTIPLE_REQUEST;
     
     uint16_t offset   = 1;
 
@@ -909,6 +910,15 @@ static uint16_t handle_read_multiple_request2(att_connection_t * att_connection,
             break;
         }
 
+        // store length of complete value for Read Multiple Variable, even if truncated
+        if (store_length){
+            if ((offset + 2u) > response_buffer_size){
+                break;
+            }
+            little_endian_store_16(response_buffer, offset, it.value_len);
+            offset += 2u;
+        }
+
         // store
         uint16_t bytes_copied = att_copy_value(&it, 0, response_buffer + offset, response_buffer_size - offset, att_connection->con_handle);
         offset += bytes_copied;
@@ -918,19 +928,22 @@ static uint16_t handle_read_multiple_request2(att_connection_t * att_connection,
         return setup_error(response_buffer, request_type, handle, error_code);
     }
     
-    response_buffer[0] = (uint8_t)ATT_READ_MULTIPLE_RESPONSE;
+    response_buffer[0] = store_length ? (uint8_t)ATT_READ_MULTIPLE_VARIABLE_RSP : (uint8_t)ATT_READ_MULTIPLE_RESPONSE;
     return offset;
 }
 static uint16_t handle_read_multiple_request(att_connection_t * att_connection, uint8_t * request_buffer,  uint16_t request_len,
                                       uint8_t * response_buffer, uint16_t response_buffer_size){
 
+    const uint8_t request_type = request_buffer[0];
+    const bool store_length = request_type == ATT_READ_MULTIPLE_VARIABLE_REQ;
+
     // 1 byte opcode + two or more attribute handles (2 bytes each)
     if ( (request_len < 5u) || ((request_len & 1u) == 0u) ){
-        return setup_error_invalid_pdu(response_buffer, ATT_READ_MULTIPLE_REQUEST);
+        return setup_error_invalid_pdu(response_buffer, request_type);
     }
 
     int num_handles = (request_len - 1u) >> 1u;
-    return handle_read_multiple_request2(att_connection, response_buffer, response_buffer_size, num_handles, &request_buffer[1]);
+    return handle_read_multiple_request2(att_connection, response_buffer, response_buffer_size, num_handles, &request_buffer[1], store_length);
 }
 
 //
@@ -1277,6 +1290,31 @@ uint16_t att_prepare_handle_value_notification(att_connection_t * att_connection
     return prepare_handle_value(att_connection, attribute_handle, value, value_len, response_buffer);
 }
 
+// MARK: ATT_MULTIPLE_HANDLE_VALUE_NTF 0x23
+uint16_t att_prepare_handle_value_multiple_notification(att_connection_t * att_connection,
+                                                        uint8_t num_attributes,
+                                                        const uint16_t * attribute_handles,
+                                                        const uint8_t ** values_data,
+                                                        const uint16_t * values_len,
+                                                        uint8_t * response_buffer){
+
+    response_buffer[0] = ATT_MULTIPLE_HANDLE_VALUE_NTF;
+    uint16_t offset = 1;
+    uint8_t i;
+    for (i = 0; i < num_attributes; i++){
+        // only add complete Handle Length Value Tuples
+        uint16_t tuple_len = 4u + values_len[i];
+        if ((offset + tuple_len) > att_connection->mtu){
+            break;
+        }
+        little_endian_store_16(response_buffer, offset, attribute_handles[i]);
+        little_endian_store_16(response_buffer, offset + 2u, values_len[i]);
+        (void)memcpy(&response_buffer[offset + 4u], values_data[i], values_len[i]);
+        offset += tuple_len;
+    }
+    return offset;
+}
+
 // MARK: ATT_HANDLE_VALUE_INDICATION 0x1d
 uint16_t att_prepare_handle_value_indication(att_connection_t * att_connection,
                                              uint16_t attribute_handle,
@@ -1317,6 +1355,7 @@ uint16_t att_handle_request(att_connection_t * att_connection,
             response_len = handle_read_blob_request(att_connection, request_buffer, request_len, response_buffer, response_buffer_size);
             break;
         case ATT_READ_MULTIPLE_REQUEST:  
+        case ATT_READ_MULTIPLE_VARIABLE_REQ:
             response_len = handle_read_multiple_request(att_connection, request_buffer, request_len, response_buffer, response_buffer_size);
             break;
         case ATT_READ_BY_GROUP_TYPE_REQUEST:  
@@ -225,6 +225,24 @@ uint16_t att_prepare_handle_value_notification(att_connection_t * att_connection
                                                uint16_t value_len, 
                                                uint8_t * response_buffer);
 
+/**
+ * @brief setup multiple handle value notification in response buffer for a list of handles and values
+ * @note only complete Handle Length Value tuples that fit into the ATT MTU are added
+ * @param att_connection
+ * @param num_attributes
+ * @param attribute_handles
+ * @param values_data
+ * @param values_len
+ * @param response_buffer for notification
+ * @return len of data in response buffer
+ */
+uint16_t att_prepare_handle_value_multiple_notification(att_connection_t * att_connection,
+                                                        uint8_t num_attributes,
+                                                        const uint16_t * attribute_handles,
+                                                        const uint8_t ** values_data,
+                                                        const uint16_t * values_len,
+                                                        uint8_t * response_buffer);
+
 /**
  * @brief setup value indication in response buffer for a given handle and value
  * @param att_connection
@@ -54,6 +54,8 @@
 #include "ble/core.h"
 #include "ble/le_device_db.h"
 #include "ble/sm.h"
+#include "bluetooth_gatt.h"
+#include "bluetooth_psm.h"
 #include "btstack_debug.h"
 #include "btstack_event.h"
 #include "btstack_memory.h"
@@ -71,17 +73,24 @@
 #include <stdio.h>
 #endif
 
+#if defined(ENABLE_GATT_OVER_EATT) && !defined(ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE)
+#error "GATT Over EATT requires support for L2CAP Enhanced CoC. Please enable ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE"
+#endif
+
 #ifndef NVN_NUM_GATT_SERVER_CCC
 #define NVN_NUM_GATT_SERVER_CCC 20
 #endif
 
-static void att_run_for_context(hci_connection_t * hci_connection);
+static void att_run_for_context(att_server_bearer_t * att_bearer, att_connection_t * att_connection);
 static att_write_callback_t att_server_write_callback_for_handle(uint16_t handle);
 static btstack_packet_handler_t att_server_packet_handler_for_handle(uint16_t handle);
 static void att_server_handle_can_send_now(void);
 static void att_server_persistent_ccc_restore(hci_connection_t * hci_connection);
 static void att_server_persistent_ccc_clear(hci_connection_t * hci_connection);
-static void att_server_handle_att_pdu(hci_connection_t * hci_connection, uint8_t * packet, uint16_t size);
+static void att_server_handle_att_pdu(att_server_bearer_t * att_bearer, att_connection_t * att_connection, uint8_t * packet, uint16_t size);
+#ifdef ENABLE_GATT_OVER_EATT
+static void att_server_eatt_update_security(hci_connection_t * hci_connection);
+#endif
 
 typedef enum {
     ATT_SERVER_RUN_PHASE_1_REQUESTS = 0,
@@ -110,6 +119,19 @@ static att_write_callback_t                   att_server_client_write_callback;
 // round robin
 static hci_con_handle_t att_server_last_can_send_now = HCI_CON_HANDLE_INVALID;
 
+#ifdef ENABLE_GATT_OVER_EATT
+// connection state like peer address and security is kept in the att_server_t of the HCI connection
+typedef struct {
+    btstack_linked_item_t item;
+    att_server_bearer_t   att_bearer;
+    att_connection_t      att_connection;
+    uint8_t *             receive_buffer;
+} att_server_eatt_bearer_t;
+
+static btstack_linked_list_t att_server_eatt_bearer_pool;
+static btstack_linked_list_t att_server_eatt_bearer_active;
+#endif
+
 #ifdef ENABLE_LE_SIGNED_WRITE
 static hci_connection_t * hci_connection_for_state(att_server_state_t state){
     btstack_linked_list_iterator_t it;
@@ -117,35 +139,75 @@ static hci_connection_t * hci_connection_for_state(att_server_state_t state){
     while(btstack_linked_list_iterator_has_next(&it)){
         hci_connection_t * connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
         att_server_t * att_server = &connection->att_server;
-        if (att_server->state == state) return connection;
+        if (att_server->bearer.state == state) return connection;
     }
     return NULL;
 }
 #endif
 
-static void att_server_request_can_send_now(hci_connection_t * hci_connection){
-#ifdef ENABLE_GATT_OVER_CLASSIC
-    att_server_t * att_server = &hci_connection->att_server;
-    if (att_server->l2cap_cid != 0){
-        l2cap_request_can_send_now_event(att_server->l2cap_cid);
+static void att_server_request_can_send_now(att_server_bearer_t * att_bearer, att_connection_t * att_connection){
+#if defined(ENABLE_GATT_OVER_CLASSIC) || defined(ENABLE_GATT_OVER_EATT)
+    if (att_bearer->l2cap_cid != 0){
+        l2cap_request_can_send_now_event(att_bearer->l2cap_cid);
         return;
     }
+#else
+    UNUSED(att_bearer);
 #endif
-    att_connection_t * att_connection = &hci_connection->att_connection;
     att_dispatch_server_request_can_send_now_event(att_connection->con_handle);
 }
 
-static bool att_server_can_send_packet(hci_connection_t * hci_connection){
-#ifdef ENABLE_GATT_OVER_CLASSIC
-    att_server_t * att_server = &hci_connection->att_server;
-    if (att_server->l2cap_cid != 0){
-        return l2cap_can_send_packet_now(att_server->l2cap_cid) != 0;
+static bool att_server_can_send_packet(att_server_bearer_t * att_bearer, att_connection_t * att_connection){
+#if defined(ENABLE_GATT_OVER_CLASSIC) || defined(ENABLE_GATT_OVER_EATT)
+    if (att_bearer->l2cap_cid != 0){
+        return l2cap_can_send_packet_now(att_bearer->l2cap_cid) != 0;
     }
+#else
+    UNUSED(att_bearer);
 #endif
-    att_connection_t * att_connection = &hci_connection->att_connection;
     return att_dispatch_server_can_send_now(att_connection->con_handle) != 0;
 }
 
+// reserve buffer for outgoing ATT PDU, Enhanced ATT bearers use their own send buffer
+static uint8_t * att_server_reserve_send_buffer(att_server_bearer_t * att_bearer){
+#ifdef ENABLE_GATT_OVER_EATT
+    if (att_bearer->eatt_send_buffer != NULL){
+        return att_bearer->eatt_send_buffer;
+    }
+#else
+    UNUSED(att_bearer);
+#endif
+    l2cap_reserve_packet_buffer();
+    return l2cap_get_outgoing_buffer();
+}
+
+static void att_server_release_send_buffer(att_server_bearer_t * att_bearer){
+#ifdef ENABLE_GATT_OVER_EATT
+    if (att_bearer->eatt_send_buffer != NULL){
+        return;
+    }
+#else
+    UNUSED(att_bearer);
+#endif
+    l2cap_release_packet_buffer();
+}
+
+static uint8_t att_server_send_prepared(att_server_bearer_t * att_bearer, att_connection_t * att_connection, uint16_t size){
+#ifdef ENABLE_GATT_OVER_EATT
+    if (att_bearer->eatt_send_buffer != NULL){
+        return l2cap_send(att_bearer->l2cap_cid, att_bearer->eatt_send_buffer, size);
+    }
+#endif
+#ifdef ENABLE_GATT_OVER_CLASSIC
+    if (att_bearer->l2cap_cid != 0u){
+        return l2cap_send_prepared(att_bearer->l2cap_cid, size);
+    }
+#else
+    UNUSED(att_bearer);
+#endif
+    return l2cap_send_prepared_connectionless(att_connection->con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, size);
+}
+
 static void att_handle_value_indication_notify_client(uint8_t status, uint16_t client_handle, uint16_t attribute_handle){
     btstack_packet_handler_t packet_handler = att_server_packet_handler_for_handle(attribute_handle);
     if (!packet_handler) return;
@@ -279,16 +341,16 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
                     l2cap_event_channel_opened_get_address(packet, att_server->peer_address);
                     att_connection = &hci_connection->att_connection;
                     att_connection->con_handle = con_handle;
-                    att_server->l2cap_cid = l2cap_event_channel_opened_get_local_cid(packet);
+                    att_server->bearer.l2cap_cid = l2cap_event_channel_opened_get_local_cid(packet);
                     // reset connection properties
-                    att_server->state = ATT_SERVER_IDLE;
+                    att_server->bearer.state = ATT_SERVER_IDLE;
                     att_connection->mtu = l2cap_event_channel_opened_get_remote_mtu(packet);
                     att_connection->max_mtu = l2cap_max_mtu();
                     if (att_connection->max_mtu > ATT_REQUEST_BUFFER_SIZE){
                         att_connection->max_mtu = ATT_REQUEST_BUFFER_SIZE;
                     }
 
-                    log_info("Connection opened %s, l2cap cid %04x, mtu %u", bd_addr_to_str(address), att_server->l2cap_cid, att_connection->mtu);
+                    log_info("Connection opened %s, l2cap cid %04x, mtu %u", bd_addr_to_str(address), att_server->bearer.l2cap_cid, att_connection->mtu);
 
                     // update security params
                     att_connection->encryption_key_size = gap_encryption_key_size(con_handle);
@@ -325,7 +387,7 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
                             att_connection = &hci_connection->att_connection;
                             att_connection->con_handle = con_handle;
                             // reset connection properties
-                            att_server->state = ATT_SERVER_IDLE;
+                            att_server->bearer.state = ATT_SERVER_IDLE;
                             att_connection->mtu = ATT_DEFAULT_MTU;
                             att_connection->max_mtu = l2cap_max_le_mtu();
                             if (att_connection->max_mtu > ATT_REQUEST_BUFFER_SIZE){
@@ -371,7 +433,10 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
                             att_server_persistent_ccc_restore(hci_connection);
                         } 
                     }
-                    att_run_for_context(hci_connection);
+                    att_run_for_context(&hci_connection->att_server.bearer, &hci_connection->att_connection);
+#ifdef ENABLE_GATT_OVER_EATT
+                    att_server_eatt_update_security(hci_connection);
+#endif
                     break;
 
                 case HCI_EVENT_DISCONNECTION_COMPLETE:
@@ -384,7 +449,10 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
                     att_clear_transaction_queue(att_connection);
                     att_connection->con_handle = 0;
                     att_server->pairing_active = 0;
-                    att_server->state = ATT_SERVER_IDLE;
+                    att_server->bearer.state = ATT_SERVER_IDLE;
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+                    att_server->coalesced_notifications_len = 0;
+#endif
                     if (att_server->value_indication_handle != 0u){
                         btstack_run_loop_remove_timer(&att_server->value_indication_timer);
                         uint16_t att_handle = att_server->value_indication_handle;
@@ -415,7 +483,7 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
                     att_server->ir_lookup_active = 0;
                     att_server->ir_le_device_db_index = sm_event_identity_resolving_succeeded_get_index(packet);
                     log_info("SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED");
-                    att_run_for_context(hci_connection);
+                    att_run_for_context(&hci_connection->att_server.bearer, &hci_connection->att_connection);
                     break;
                 case SM_EVENT_IDENTITY_RESOLVING_FAILED:
                     con_handle = sm_event_identity_resolving_failed_get_handle(packet);
@@ -426,7 +494,7 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
                     log_info("SM_EVENT_IDENTITY_RESOLVING_FAILED");
                     att_server->ir_lookup_active = 0;
                     att_server->ir_le_device_db_index = -1;
-                    att_run_for_context(hci_connection);
+                    att_run_for_context(&hci_connection->att_server.bearer, &hci_connection->att_connection);
                     break;
 
                 // Pairing started - delete stored CCC values
@@ -458,7 +526,7 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
                     att_server = &hci_connection->att_server;
                     att_server->pairing_active = 0;
                     att_server->ir_le_device_db_index = sm_event_identity_created_get_index(packet);
-                    att_run_for_context(hci_connection);
+                    att_run_for_context(&hci_connection->att_server.bearer, &hci_connection->att_connection);
                     break;
 
                 // Pairing complete (with/without bonding=storing of pairing information)
@@ -469,7 +537,7 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
                     att_connection = &hci_connection->att_connection;
                     att_server = &hci_connection->att_server;
                     att_server->pairing_active = 0;
-                    att_run_for_context(hci_connection);
+                    att_run_for_context(&hci_connection->att_server.bearer, &hci_connection->att_connection);
                     break;
 
                 // Authorization
@@ -480,7 +548,10 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
                     att_connection = &hci_connection->att_connection;
                     att_server = &hci_connection->att_server;
                     att_connection->authorized = sm_event_authorization_result_get_authorization_result(packet);
-                    att_server_request_can_send_now(hci_connection);
+                    att_server_request_can_send_now(&hci_connection->att_server.bearer, &hci_connection->att_connection);
+#ifdef ENABLE_GATT_OVER_EATT
+                    att_server_eatt_update_security(hci_connection);
+#endif
                 	break;
                 }
                 default:
@@ -493,8 +564,8 @@ static void att_event_packet_handler (uint8_t packet_type, uint16_t channel, uin
             while(btstack_linked_list_iterator_has_next(&it)){
                 hci_connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
                 att_server = &hci_connection->att_server;
-                if (att_server->l2cap_cid == channel) {
-                    att_server_handle_att_pdu(hci_connection, packet, size);
+                if (att_server->bearer.l2cap_cid == channel) {
+                    att_server_handle_att_pdu(&att_server->bearer, &hci_connection->att_connection, packet, size);
                     break;
                 }
             }
@@ -512,15 +583,16 @@ static void att_signed_write_handle_cmac_result(uint8_t hash[8]){
     hci_connection_t * hci_connection = hci_connection_for_state(ATT_SERVER_W4_SIGNED_WRITE_VALIDATION);
     if (!hci_connection) return;
     att_server_t * att_server = &hci_connection->att_server;
+    att_server_bearer_t * att_bearer = &att_server->bearer;
 
     uint8_t hash_flipped[8];
     reverse_64(hash, hash_flipped);
-    if (memcmp(hash_flipped, &att_server->request_buffer[att_server->request_size-8], 8)){
+    if (memcmp(hash_flipped, &att_bearer->request_buffer[att_bearer->request_size-8], 8)){
         log_info("ATT Signed Write, invalid signature");
 #ifdef ENABLE_TESTING_SUPPORT
         printf("ATT Signed Write, invalid signature\n");
 #endif
-        att_server->state = ATT_SERVER_IDLE;
+        att_bearer->state = ATT_SERVER_IDLE;
         return;
     }
     log_info("ATT Signed Write, valid signature");
@@ -529,28 +601,37 @@ static void att_signed_write_handle_cmac_result(uint8_t hash[8]){
 #endif
 
     // update sequence number
-    uint32_t counter_packet = little_endian_read_32(att_server->request_buffer, att_server->request_size-12);
+    uint32_t counter_packet = little_endian_read_32(att_bearer->request_buffer, att_bearer->request_size-12);
     le_device_db_remote_counter_set(att_server->ir_le_device_db_index, counter_packet+1);
-    att_server->state = ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED;
-    att_server_request_can_send_now(hci_connection);
+    att_bearer->state = ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED;
+    att_server_request_can_send_now(att_bearer, &hci_connection->att_connection);
 }
 #endif
 
-// pre: att_server->state == ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED
+// pre: write request was accepted
+static void att_server_handle_client_supported_features_write(hci_con_handle_t con_handle, const uint8_t * request, uint16_t request_len){
+    if (request[0] != ATT_WRITE_REQUEST) return;
+    if (request_len < 4u) return;
+    if (att_uuid_for_handle(little_endian_read_16(request, 1)) != ORG_BLUETOOTH_CHARACTERISTIC_CLIENT_SUPPORTED_FEATURES) return;
+    hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
+    if (hci_connection == NULL) return;
+    // bit 2: Multiple Handle Value Notifications, client cannot clear it
+    if ((request[3] & 0x04u) != 0u){
+        hci_connection->att_server.multiple_notifications_supported = true;
+    }
+}
+
+// pre: att_bearer->state == ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED
 // pre: can send now
 // returns: 1 if packet was sent
-static int att_server_process_validated_request(hci_connection_t * hci_connection){
-    att_server_t * att_server = & hci_connection->att_server;
-    att_connection_t * att_connection = &hci_connection->att_connection;
-
-    l2cap_reserve_packet_buffer();
-    uint8_t * att_response_buffer = l2cap_get_outgoing_buffer();
-    uint16_t  att_response_size   = att_handle_request(att_connection, att_server->request_buffer, att_server->request_size, att_response_buffer);
+static int att_server_process_validated_request(att_server_bearer_t * att_bearer, att_connection_t * att_connection){
+    uint8_t * att_response_buffer = att_server_reserve_send_buffer(att_bearer);
+    uint16_t  att_response_size   = att_handle_request(att_connection, att_bearer->request_buffer, att_bearer->request_size, att_response_buffer);
 
 #ifdef ENABLE_ATT_DELAYED_RESPONSE
     if ((att_response_size == ATT_READ_RESPONSE_PENDING) || (att_response_size == ATT_INTERNAL_WRITE_RESPONSE_PENDING)){
         // update state
-        att_server->state = ATT_SERVER_RESPONSE_PENDING;
+        att_bearer->state = ATT_SERVER_RESPONSE_PENDING;
 
         // callback with handle ATT_READ_RESPONSE_PENDING for reads
         if (att_response_size == ATT_READ_RESPONSE_PENDING){
@@ -558,7 +639,7 @@ static int att_server_process_validated_request(hci_connection_t * hci_connectio
         }
 
         // free reserved buffer
-        l2cap_release_packet_buffer();
+        att_server_release_send_buffer(att_bearer);
         return 0;
     }
 #endif
@@ -571,32 +652,29 @@ static int att_server_process_validated_request(hci_connection_t * hci_connectio
 
         switch (gap_authorization_state(att_connection->con_handle)){
             case AUTHORIZATION_UNKNOWN:
-                l2cap_release_packet_buffer();
+                att_server_release_send_buffer(att_bearer);
                 sm_request_pairing(att_connection->con_handle);
                 return 0;
             case AUTHORIZATION_PENDING:
-                l2cap_release_packet_buffer();
+                att_server_release_send_buffer(att_bearer);
                 return 0;
             default:
                 break;
         }
     }
 
-    att_server->state = ATT_SERVER_IDLE;
+    att_bearer->state = ATT_SERVER_IDLE;
     if (att_response_size == 0u) {
-        l2cap_release_packet_buffer();
+        att_server_release_send_buffer(att_bearer);
         return 0;
     }
 
-#ifdef ENABLE_GATT_OVER_CLASSIC
-    if (att_server->l2cap_cid != 0u){
-        l2cap_send_prepared(att_server->l2cap_cid, att_response_size);
-    } else
-#endif
-    {
-        l2cap_send_prepared_connectionless(att_connection->con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, att_response_size);
+    if (att_response_buffer[0] == ATT_WRITE_RESPONSE){
+        att_server_handle_client_supported_features_write(att_connection->con_handle, att_bearer->request_buffer, att_bearer->request_size);
     }
 
+    (void) att_server_send_prepared(att_bearer, att_connection, att_response_size);
+
     // notify client about MTU exchange result
     if (att_response_buffer[0] == ATT_EXCHANGE_MTU_RESPONSE){
         att_emit_mtu_event(att_connection->con_handle, att_connection->mtu);
@@ -610,22 +688,41 @@ uint8_t att_server_response_ready(hci_con_handle_t con_handle){
     if (!hci_connection) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
     att_server_t * att_server = &hci_connection->att_server;
 
-    if (att_server->state != ATT_SERVER_RESPONSE_PENDING)   return ERROR_CODE_COMMAND_DISALLOWED;
+    uint8_t status = ERROR_CODE_COMMAND_DISALLOWED;
+    if (att_server->bearer.state == ATT_SERVER_RESPONSE_PENDING){
+        att_server->bearer.state = ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED;
+        att_server_request_can_send_now(&att_server->bearer, &hci_connection->att_connection);
+        status = ERROR_CODE_SUCCESS;
+    }
 
-    att_server->state = ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED;
-    att_server_request_can_send_now(hci_connection);
-    return ERROR_CODE_SUCCESS;
+#ifdef ENABLE_GATT_OVER_EATT
+    // retry all pending requests on Enhanced ATT bearers, the ones still not ready will be pending again
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &att_server_eatt_bearer_active);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        att_server_eatt_bearer_t * eatt_bearer = (att_server_eatt_bearer_t *) btstack_linked_list_iterator_next(&it);
+        if (eatt_bearer->att_connection.con_handle != con_handle) continue;
+        if (eatt_bearer->att_bearer.state != ATT_SERVER_RESPONSE_PENDING) continue;
+        eatt_bearer->att_bearer.state = ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED;
+        att_server_request_can_send_now(&eatt_bearer->att_bearer, &eatt_bearer->att_connection);
+        status = ERROR_CODE_SUCCESS;
+    }
+#endif
+    return status;
 }
 #endif
 
-static void att_run_for_context(hci_connection_t * hci_connection){
-    att_server_t * att_server = &hci_connection->att_server;
-    att_connection_t * att_connection = &hci_connection->att_connection;
-    switch (att_server->state){
+static void att_run_for_context(att_server_bearer_t * att_bearer, att_connection_t * att_connection){
+    hci_connection_t * hci_connection;
+    att_server_t * att_server;
+    switch (att_bearer->state){
         case ATT_SERVER_REQUEST_RECEIVED:
+            hci_connection = hci_connection_for_handle(att_connection->con_handle);
+            if (hci_connection == NULL) break;
+            att_server = &hci_connection->att_server;
 
-#ifdef ENABLE_GATT_OVER_CLASSIC
-            if (att_server->l2cap_cid != 0){
+#if defined(ENABLE_GATT_OVER_CLASSIC) || defined(ENABLE_GATT_OVER_EATT)
+            if (att_bearer->l2cap_cid != 0){
                 // ok
             } else
 #endif
@@ -638,16 +735,24 @@ static void att_run_for_context(hci_connection_t * hci_connection){
             if (att_server->pairing_active) break;
 
 #ifdef ENABLE_LE_SIGNED_WRITE
-            if (att_server->request_buffer[0] == ATT_SIGNED_WRITE_COMMAND){
+            if (att_bearer->request_buffer[0] == ATT_SIGNED_WRITE_COMMAND){
                 log_info("ATT Signed Write!");
+#ifdef ENABLE_GATT_OVER_EATT
+                // Enhanced ATT bearers are encrypted, Signed Write Command is only used on unencrypted links
+                if (att_bearer != &att_server->bearer){
+                    log_info("ATT Signed Write, not supported on Enhanced ATT bearer. Abort");
+                    att_bearer->state = ATT_SERVER_IDLE;
+                    return;
+                }
+#endif
                 if (!sm_cmac_ready()) {
                     log_info("ATT Signed Write, sm_cmac engine not ready. Abort");
-                    att_server->state = ATT_SERVER_IDLE;
+                    att_bearer->state = ATT_SERVER_IDLE;
                     return;
                 }  
-                if (att_server->request_size < (3 + 12)) {
+                if (att_bearer->request_size < (3 + 12)) {
                     log_info("ATT Signed Write, request to short. Abort.");
-                    att_server->state = ATT_SERVER_IDLE;
+                    att_bearer->state = ATT_SERVER_IDLE;
                     return;
                 }
                 if (att_server->ir_lookup_active){
@@ -655,34 +760,34 @@ static void att_run_for_context(hci_connection_t * hci_connection){
                 }
                 if (att_server->ir_le_device_db_index < 0){
                     log_info("ATT Signed Write, CSRK not available");
-                    att_server->state = ATT_SERVER_IDLE;
+                    att_bearer->state = ATT_SERVER_IDLE;
                     return;
                 }
 
                 // check counter
-                uint32_t counter_packet = little_endian_read_32(att_server->request_buffer, att_server->request_size-12);
+                uint32_t counter_packet = little_endian_read_32(att_bearer->request_buffer, att_bearer->request_size-12);
                 uint32_t counter_db     = le_device_db_remote_counter_get(att_server->ir_le_device_db_index);
                 log_info("ATT Signed Write, DB counter %"PRIu32", packet counter %"PRIu32, counter_db, counter_packet);
                 if (counter_packet < counter_db){
                     log_info("ATT Signed Write, db reports higher counter, abort");
-                    att_server->state = ATT_SERVER_IDLE;
+                    att_bearer->state = ATT_SERVER_IDLE;
                     return;
                 }
 
                 // signature is { sequence counter, secure hash }
                 sm_key_t csrk;
                 le_device_db_remote_csrk_get(att_server->ir_le_device_db_index, csrk);
-                att_server->state = ATT_SERVER_W4_SIGNED_WRITE_VALIDATION;
+                att_bearer->state = ATT_SERVER_W4_SIGNED_WRITE_VALIDATION;
                 log_info("Orig Signature: ");
-                log_info_hexdump( &att_server->request_buffer[att_server->request_size-8], 8);
-                uint16_t attribute_handle = little_endian_read_16(att_server->request_buffer, 1);
-                sm_cmac_signed_write_start(csrk, att_server->request_buffer[0], attribute_handle, att_server->request_size - 15, &att_server->request_buffer[3], counter_packet, att_signed_write_handle_cmac_result);
+                log_info_hexdump( &att_bearer->request_buffer[att_bearer->request_size-8], 8);
+                uint16_t attribute_handle = little_endian_read_16(att_bearer->request_buffer, 1);
+                sm_cmac_signed_write_start(csrk, att_bearer->request_buffer[0], attribute_handle, att_bearer->request_size - 15, &att_bearer->request_buffer[3], counter_packet, att_signed_write_handle_cmac_result);
                 return;
             } 
 #endif
             // move on
-            att_server->state = ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED;
-            att_server_request_can_send_now(hci_connection);
+            att_bearer->state = ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED;
+            att_server_request_can_send_now(att_bearer, att_connection);
             break;
 
         default:
@@ -690,13 +795,92 @@ static void att_run_for_context(hci_connection_t * hci_connection){
     }   
 }
 
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+// pre: can send now
+static void att_server_send_coalesced_notifications(att_server_t * att_server, att_server_bearer_t * att_bearer, att_connection_t * att_connection){
+    uint8_t * tuples = att_server->coalesced_notifications;
+
+    // collect complete Handle Length Value tuples that fit into a single PDU
+    uint16_t tuples_len = 0;
+    uint8_t num_tuples = 0;
+    while (tuples_len < att_server->coalesced_notifications_len){
+        uint16_t tuple_len = 4u + little_endian_read_16(tuples, tuples_len + 2u);
+        if ((1u + tuples_len + tuple_len) > att_connection->mtu) break;
+        tuples_len += tuple_len;
+        num_tuples++;
+    }
+
+    uint8_t * packet_buffer = att_server_reserve_send_buffer(att_bearer);
+    uint16_t size;
+    if (att_server->multiple_notifications_supported && (num_tuples > 1u)){
+        packet_buffer[0] = ATT_MULTIPLE_HANDLE_VALUE_NTF;
+        (void)memcpy(&packet_buffer[1], tuples, tuples_len);
+        size = 1u + tuples_len;
+    } else {
+        // send first value with regular Handle Value Notification, truncated if queued for a bearer with larger MTU
+        tuples_len = 4u + little_endian_read_16(tuples, 2);
+        uint16_t value_len = btstack_min(tuples_len - 4u, att_connection->mtu - 3u);
+        size = att_prepare_handle_value_notification(att_connection, little_endian_read_16(tuples, 0), &tuples[4], value_len, packet_buffer);
+    }
+
+    // drop sent tuples
+    att_server->coalesced_notifications_len -= tuples_len;
+    (void)memmove(tuples, &tuples[tuples_len], att_server->coalesced_notifications_len);
+
+    (void) att_server_send_prepared(att_bearer, att_connection, size);
+}
+
+#ifdef ENABLE_GATT_OVER_EATT
+// open Enhanced ATT bearer with largest MTU, NULL if none
+static att_server_eatt_bearer_t * att_server_eatt_bearer_for_notifications(hci_con_handle_t con_handle){
+    att_server_eatt_bearer_t * notification_bearer = NULL;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &att_server_eatt_bearer_active);
+    while(btstack_linked_list_iterator_has_next(&it)){
+        att_server_eatt_bearer_t * eatt_bearer = (att_server_eatt_bearer_t *) btstack_linked_list_iterator_next(&it);
+        if (eatt_bearer->att_connection.con_handle != con_handle) continue;
+        if (eatt_bearer->att_connection.mtu_exchanged == false) continue;
+        if ((notification_bearer == NULL) || (eatt_bearer->att_connection.mtu > notification_bearer->att_connection.mtu)){
+            notification_bearer = eatt_bearer;
+        }
+    }
+    return notification_bearer;
+}
+#endif
+
+// coalesced notifications are sent over the Enhanced ATT bearer with the largest MTU, if available
+static void att_server_coalesced_notifications_request_can_send_now(hci_connection_t * hci_connection){
+#ifdef ENABLE_GATT_OVER_EATT
+    att_server_eatt_bearer_t * eatt_bearer = att_server_eatt_bearer_for_notifications(hci_connection->con_handle);
+    if (eatt_bearer != NULL){
+        att_server_request_can_send_now(&eatt_bearer->att_bearer, &eatt_bearer->att_connection);
+        return;
+    }
+#endif
+    att_server_request_can_send_now(&hci_connection->att_server.bearer, &hci_connection->att_connection);
+}
+
+static uint16_t att_server_coalesced_notifications_mtu(hci_connection_t * hci_connection){
+#ifdef ENABLE_GATT_OVER_EATT
+    att_server_eatt_bearer_t * eatt_bearer = att_server_eatt_bearer_for_notifications(hci_connection->con_handle);
+    if (eatt_bearer != NULL){
+        return eatt_bearer->att_connection.mtu;
+    }
+#endif
+    return hci_connection->att_connection.mtu;
+}
+#endif
+
 static bool att_server_data_ready_for_phase(att_server_t * att_server,  att_server_run_phase_t phase){
     switch (phase){
         case ATT_SERVER_RUN_PHASE_1_REQUESTS:
-            return att_server->state == ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED;
+            return att_server->bearer.state == ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED;
         case ATT_SERVER_RUN_PHASE_2_INDICATIONS:
              return (!btstack_linked_list_empty(&att_server->indication_requests) && (att_server->value_indication_handle == 0u));
         case ATT_SERVER_RUN_PHASE_3_NOTIFICATIONS:
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+            if (att_server->coalesced_notifications_len > 0u) return true;
+#endif
             return (!btstack_linked_list_empty(&att_server->notification_requests));
         default:
             btstack_assert(false);
@@ -709,7 +893,7 @@ static void att_server_trigger_send_for_phase(hci_connection_t * hci_connection,
     att_server_t * att_server = &hci_connection->att_server;
     switch (phase){
         case ATT_SERVER_RUN_PHASE_1_REQUESTS:
-            att_server_process_validated_request(hci_connection);
+            att_server_process_validated_request(&att_server->bearer, &hci_connection->att_connection);
             break;
         case ATT_SERVER_RUN_PHASE_2_INDICATIONS:
             client = (btstack_context_callback_registration_t*) att_server->indication_requests;
@@ -717,6 +901,12 @@ static void att_server_trigger_send_for_phase(hci_connection_t * hci_connection,
             client->callback(client->context);
             break;
        case ATT_SERVER_RUN_PHASE_3_NOTIFICATIONS:
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+            if (att_server->coalesced_notifications_len > 0u){
+                att_server_send_coalesced_notifications(att_server, &att_server->bearer, &hci_connection->att_connection);
+                break;
+            }
+#endif
             client = (btstack_context_callback_registration_t*) att_server->notification_requests;
             btstack_linked_list_remove(&att_server->notification_requests, (btstack_linked_item_t *) client);
             client->callback(client->context);
@@ -764,7 +954,7 @@ static void att_server_handle_can_send_now(void){
                     if (can_send_now){
                         att_server_trigger_send_for_phase(connection, phase);
                         last_send_con_handle = att_connection->con_handle;
-                        can_send_now = att_server_can_send_packet(connection);
+                        can_send_now = att_server_can_send_packet(&att_server->bearer, att_connection);
                         data_ready = att_server_data_ready_for_phase(att_server, phase);
                         if (data_ready && (request_hci_connection == NULL)){
                             request_hci_connection = connection;
@@ -795,12 +985,10 @@ static void att_server_handle_can_send_now(void){
     }
 
     if (request_hci_connection == NULL) return;
-    att_server_request_can_send_now(request_hci_connection);
+    att_server_request_can_send_now(&request_hci_connection->att_server.bearer, &request_hci_connection->att_connection);
 }
 
-static void att_server_handle_att_pdu(hci_connection_t * hci_connection, uint8_t * packet, uint16_t size){
-    att_server_t * att_server = &hci_connection->att_server;
-    att_connection_t * att_connection = &hci_connection->att_connection;
+static void att_server_handle_att_pdu(att_server_bearer_t * att_bearer, att_connection_t * att_connection, uint8_t * packet, uint16_t size){
 
     uint8_t opcode  = packet[0u];
     uint8_t method  = opcode & 0x03fu;
@@ -812,14 +1000,18 @@ static void att_server_handle_att_pdu(hci_connection_t * hci_connection, uint8_t
         return;
     }
 
-    // handle value indication confirms
-    if ((opcode == ATT_HANDLE_VALUE_CONFIRMATION) && (att_server->value_indication_handle != 0u)){
-        btstack_run_loop_remove_timer(&att_server->value_indication_timer);
-        uint16_t att_handle = att_server->value_indication_handle;
-        att_server->value_indication_handle = 0u;    
-        att_handle_value_indication_notify_client(0u, att_connection->con_handle, att_handle);
-        att_server_request_can_send_now(hci_connection);
-        return;
+    // handle value indication confirms, indications are only sent over the unenhanced bearer
+    if (opcode == ATT_HANDLE_VALUE_CONFIRMATION){
+        hci_connection_t * hci_connection = hci_connection_for_handle(att_connection->con_handle);
+        att_server_t * att_server = (hci_connection != NULL) ? &hci_connection->att_server : NULL;
+        if ((att_server != NULL) && (&att_server->bearer == att_bearer) && (att_server->value_indication_handle != 0u)){
+            btstack_run_loop_remove_timer(&att_server->value_indication_timer);
+            uint16_t att_handle = att_server->value_indication_handle;
+            att_server->value_indication_handle = 0u;
+            att_handle_value_indication_notify_client(0u, att_connection->con_handle, att_handle);
+            att_server_request_can_send_now(att_bearer, att_connection);
+            return;
+        }
     }
 
     // directly process command
@@ -830,35 +1022,35 @@ static void att_server_handle_att_pdu(hci_connection_t * hci_connection, uint8_t
     }
 
     // check size
-    if (size > sizeof(att_server->request_buffer)) {
-        log_info("drop att pdu 0x%02x as size %u > att_server->request_buffer %u", packet[0], size, (int) sizeof(att_server->request_buffer));
+    if (size > sizeof(att_bearer->request_buffer)) {
+        log_info("drop att pdu 0x%02x as size %u > att_server->request_buffer %u", packet[0], size, (int) sizeof(att_bearer->request_buffer));
         return;
     }
 
 #ifdef ENABLE_LE_SIGNED_WRITE
     // abort signed write validation if a new request comes in (but finish previous signed write if possible)
-    if (att_server->state == ATT_SERVER_W4_SIGNED_WRITE_VALIDATION){
+    if (att_bearer->state == ATT_SERVER_W4_SIGNED_WRITE_VALIDATION){
         if (packet[0] == ATT_SIGNED_WRITE_COMMAND){
             log_info("skip new signed write request as previous is in validation");
             return;
         } else {
             log_info("abort signed write validation to process new request");
-            att_server->state = ATT_SERVER_IDLE;
+            att_bearer->state = ATT_SERVER_IDLE;
         }
     }
 #endif
     // last request still in processing?
-    if (att_server->state != ATT_SERVER_IDLE){
-        log_info("skip att pdu 0x%02x as server not idle (state %u)", packet[0], att_server->state);
+    if (att_bearer->state != ATT_SERVER_IDLE){
+        log_info("skip att pdu 0x%02x as server not idle (state %u)", packet[0], att_bearer->state);
         return;
     }
 
     // store request
-    att_server->state = ATT_SERVER_REQUEST_RECEIVED;
-    att_server->request_size = size;
-    (void)memcpy(att_server->request_buffer, packet, size);
+    att_bearer->state = ATT_SERVER_REQUEST_RECEIVED;
+    att_bearer->request_size = size;
+    (void)memcpy(att_bearer->request_buffer, packet, size);
 
-    att_run_for_context(hci_connection);
+    att_run_for_context(att_bearer, att_connection);
 }
 
 static void att_packet_handler(uint8_t packet_type, uint16_t handle, uint8_t *packet, uint16_t size){
@@ -888,7 +1080,7 @@ static void att_packet_handler(uint8_t packet_type, uint16_t handle, uint8_t *pa
             hci_connection = hci_connection_for_handle(handle);
             if (!hci_connection) break;
 
-            att_server_handle_att_pdu(hci_connection, packet, size);
+            att_server_handle_att_pdu(&hci_connection->att_server.bearer, &hci_connection->att_connection, packet, size);
             break;
             
         default:
@@ -1166,6 +1358,243 @@ void att_server_register_service_handler(att_service_handler_t * handler){
     btstack_linked_list_add(&service_handlers, (btstack_linked_item_t*) handler);
 }
 
+#ifdef ENABLE_GATT_OVER_EATT
+
+// Enhanced ATT bearers: requests received on each bearer are processed independently from the unenhanced bearer
+// notifications and indications are sent over the unenhanced bearer
+
+static att_server_eatt_bearer_t * att_server_eatt_bearer_for_cid(uint16_t l2cap_cid){
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &att_server_eatt_bearer_active);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        att_server_eatt_bearer_t * eatt_bearer = (att_server_eatt_bearer_t *) btstack_linked_list_iterator_next(&it);
+        if (eatt_bearer->att_bearer.l2cap_cid == l2cap_cid){
+            return eatt_bearer;
+        }
+    }
+    return NULL;
+}
+
+static void att_server_eatt_bearer_free(att_server_eatt_bearer_t * eatt_bearer){
+    btstack_linked_list_remove(&att_server_eatt_bearer_active, (btstack_linked_item_t *) eatt_bearer);
+    eatt_bearer->att_bearer.state = ATT_SERVER_IDLE;
+    eatt_bearer->att_bearer.l2cap_cid = 0;
+    eatt_bearer->att_connection.con_handle = HCI_CON_HANDLE_INVALID;
+    eatt_bearer->att_connection.mtu_exchanged = false;
+    btstack_linked_list_add(&att_server_eatt_bearer_pool, (btstack_linked_item_t *) eatt_bearer);
+}
+
+static void att_server_eatt_update_security(hci_connection_t * hci_connection){
+    att_connection_t * att_connection = &hci_connection->att_connection;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &att_server_eatt_bearer_active);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        att_server_eatt_bearer_t * eatt_bearer = (att_server_eatt_bearer_t *) btstack_linked_list_iterator_next(&it);
+        if (eatt_bearer->att_connection.con_handle != att_connection->con_handle) continue;
+        eatt_bearer->att_connection.encryption_key_size = att_connection->encryption_key_size;
+        eatt_bearer->att_connection.authenticated       = att_connection->authenticated;
+        eatt_bearer->att_connection.secure_connection   = att_connection->secure_connection;
+        eatt_bearer->att_connection.authorized          = att_connection->authorized;
+        if (eatt_bearer->att_bearer.state == ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED){
+            att_server_request_can_send_now(&eatt_bearer->att_bearer, &eatt_bearer->att_connection);
+        }
+    }
+}
+
+static void att_server_eatt_handle_incoming_connection(uint8_t * packet){
+    hci_con_handle_t con_handle = l2cap_event_ecbm_incoming_connection_get_handle(packet);
+    uint16_t local_cid = l2cap_event_ecbm_incoming_connection_get_local_cid(packet);
+    uint8_t num_requested = l2cap_event_ecbm_incoming_connection_get_num_channels(packet);
+    if (num_requested > L2CAP_ECBM_MAX_CID_ARRAY_SIZE){
+        num_requested = L2CAP_ECBM_MAX_CID_ARRAY_SIZE;
+    }
+
+    // get bearers from pool
+    att_server_eatt_bearer_t * eatt_bearers[L2CAP_ECBM_MAX_CID_ARRAY_SIZE];
+    uint8_t * receive_buffers[L2CAP_ECBM_MAX_CID_ARRAY_SIZE];
+    uint16_t local_cids[L2CAP_ECBM_MAX_CID_ARRAY_SIZE];
+    uint8_t num_channels = 0;
+    while (num_channels < num_requested){
+        att_server_eatt_bearer_t * eatt_bearer = (att_server_eatt_bearer_t *) btstack_linked_list_pop(&att_server_eatt_bearer_pool);
+        if (eatt_bearer == NULL) break;
+        eatt_bearers[num_channels]    = eatt_bearer;
+        receive_buffers[num_channels] = eatt_bearer->receive_buffer;
+        num_channels++;
+    }
+
+    log_info("EATT: %u bearers requested by 0x%04x, %u available", num_requested, con_handle, num_channels);
+
+    if (num_channels == 0u){
+        l2cap_ecbm_decline_channels(local_cid, L2CAP_ECBM_CONNECTION_RESULT_SOME_REFUSED_INSUFFICIENT_RESOURCES_AVAILABLE);
+        return;
+    }
+
+    // bearers are active before accepting, as L2CAP emits the channel opened events right away
+    uint8_t i;
+    for (i=0;i<num_channels;i++){
+        att_server_eatt_bearer_t * eatt_bearer = eatt_bearers[i];
+        eatt_bearer->att_bearer.l2cap_cid = 0;
+        eatt_bearer->att_connection.con_handle = con_handle;
+        btstack_linked_list_add_tail(&att_server_eatt_bearer_active, (btstack_linked_item_t *) eatt_bearer);
+    }
+
+    uint8_t status = l2cap_ecbm_accept_channels(local_cid, num_channels, L2CAP_LE_AUTOMATIC_CREDITS,
+                                                ATT_REQUEST_BUFFER_SIZE, receive_buffers, local_cids);
+    for (i=0;i<num_channels;i++){
+        att_server_eatt_bearer_t * eatt_bearer = eatt_bearers[i];
+        if (status == ERROR_CODE_SUCCESS){
+            // skip bearers already released by a failed channel opened event
+            if (eatt_bearer->att_connection.con_handle != con_handle) continue;
+            eatt_bearer->att_bearer.l2cap_cid = local_cids[i];
+        } else {
+            btstack_linked_list_remove(&att_server_eatt_bearer_active, (btstack_linked_item_t *) eatt_bearer);
+            btstack_linked_list_add(&att_server_eatt_bearer_pool, (btstack_linked_item_t *) eatt_bearer);
+        }
+    }
+}
+
+static att_server_eatt_bearer_t * att_server_eatt_bearer_for_opened_channel(hci_con_handle_t con_handle, uint16_t local_cid){
+    att_server_eatt_bearer_t * eatt_bearer = att_server_eatt_bearer_for_cid(local_cid);
+    if (eatt_bearer != NULL) return eatt_bearer;
+    // channel opened while accepting, assign first bearer without cid
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &att_server_eatt_bearer_active);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        eatt_bearer = (att_server_eatt_bearer_t *) btstack_linked_list_iterator_next(&it);
+        if (eatt_bearer->att_connection.con_handle != con_handle) continue;
+        if (eatt_bearer->att_bearer.l2cap_cid != 0u) continue;
+        eatt_bearer->att_bearer.l2cap_cid = local_cid;
+        return eatt_bearer;
+    }
+    return NULL;
+}
+
+static void att_server_eatt_handle_channel_opened(uint8_t * packet){
+    hci_con_handle_t con_handle = l2cap_event_ecbm_channel_opened_get_handle(packet);
+    att_server_eatt_bearer_t * eatt_bearer = att_server_eatt_bearer_for_opened_channel(con_handle, l2cap_event_ecbm_channel_opened_get_local_cid(packet));
+    if (eatt_bearer == NULL) return;
+
+    hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
+    uint8_t status = l2cap_event_ecbm_channel_opened_get_status(packet);
+    if ((status != ERROR_CODE_SUCCESS) || (hci_connection == NULL)){
+        log_info("EATT: bearer 0x%04x failed, status 0x%02x", eatt_bearer->att_bearer.l2cap_cid, status);
+        att_server_eatt_bearer_free(eatt_bearer);
+        return;
+    }
+
+    att_server_bearer_t * att_bearer = &eatt_bearer->att_bearer;
+    att_connection_t * att_connection = &eatt_bearer->att_connection;
+    att_bearer->state = ATT_SERVER_IDLE;
+
+    // MTU is negotiated during channel setup and limited by our buffers
+    uint16_t remote_mtu = l2cap_event_ecbm_channel_opened_get_remote_mtu(packet);
+    att_connection->con_handle = con_handle;
+    att_connection->max_mtu = ATT_REQUEST_BUFFER_SIZE;
+    att_connection->mtu = btstack_min(remote_mtu, ATT_REQUEST_BUFFER_SIZE);
+    att_connection->mtu_exchanged = true;
+
+    log_info("EATT: bearer 0x%04x opened for 0x%04x, mtu %u", att_bearer->l2cap_cid, con_handle, att_connection->mtu);
+    att_server_eatt_update_security(hci_connection);
+}
+
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+static void att_server_eatt_send_coalesced_notifications(att_server_eatt_bearer_t * eatt_bearer){
+    hci_connection_t * hci_connection = hci_connection_for_handle(eatt_bearer->att_connection.con_handle);
+    if (hci_connection == NULL) return;
+    att_server_t * att_server = &hci_connection->att_server;
+    if (att_server->coalesced_notifications_len == 0u) return;
+    att_server_send_coalesced_notifications(att_server, &eatt_bearer->att_bearer, &eatt_bearer->att_connection);
+    if (att_server->coalesced_notifications_len > 0u){
+        att_server_request_can_send_now(&eatt_bearer->att_bearer, &eatt_bearer->att_connection);
+    }
+}
+#endif
+
+static void att_server_eatt_handler(uint8_t packet_type, uint16_t channel, uint8_t * packet, uint16_t size){
+    att_server_eatt_bearer_t * eatt_bearer;
+    switch (packet_type){
+        case HCI_EVENT_PACKET:
+            switch (hci_event_packet_get_type(packet)){
+                case L2CAP_EVENT_ECBM_INCOMING_CONNECTION:
+                    att_server_eatt_handle_incoming_connection(packet);
+                    break;
+                case L2CAP_EVENT_ECBM_CHANNEL_OPENED:
+                    att_server_eatt_handle_channel_opened(packet);
+                    break;
+                case L2CAP_EVENT_CAN_SEND_NOW:
+                    eatt_bearer = att_server_eatt_bearer_for_cid(l2cap_event_can_send_now_get_local_cid(packet));
+                    if (eatt_bearer == NULL) break;
+                    if (eatt_bearer->att_bearer.state == ATT_SERVER_REQUEST_RECEIVED_AND_VALIDATED){
+                        att_server_process_validated_request(&eatt_bearer->att_bearer, &eatt_bearer->att_connection);
+                        break;
+                    }
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+                    att_server_eatt_send_coalesced_notifications(eatt_bearer);
+#endif
+                    break;
+                case L2CAP_EVENT_ECBM_RECONFIGURED:
+                    // remote increased its MTU, event contains our local cid
+                    eatt_bearer = att_server_eatt_bearer_for_cid(l2cap_event_ecbm_reconfigured_get_remote_cid(packet));
+                    if (eatt_bearer == NULL) break;
+                    eatt_bearer->att_connection.mtu = btstack_min(l2cap_event_ecbm_reconfigured_get_mtu(packet), ATT_REQUEST_BUFFER_SIZE);
+                    log_info("EATT: bearer 0x%04x reconfigured, mtu %u", eatt_bearer->att_bearer.l2cap_cid, eatt_bearer->att_connection.mtu);
+                    break;
+                case L2CAP_EVENT_CHANNEL_CLOSED:
+                    eatt_bearer = att_server_eatt_bearer_for_cid(l2cap_event_channel_closed_get_local_cid(packet));
+                    if (eatt_bearer == NULL) break;
+                    log_info("EATT: bearer 0x%04x closed", eatt_bearer->att_bearer.l2cap_cid);
+                    att_server_eatt_bearer_free(eatt_bearer);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case L2CAP_DATA_PACKET:
+            eatt_bearer = att_server_eatt_bearer_for_cid(channel);
+            if (eatt_bearer == NULL) break;
+            if (size == 0u) break;
+            att_server_handle_att_pdu(&eatt_bearer->att_bearer, &eatt_bearer->att_connection, packet, size);
+            break;
+        default:
+            break;
+    }
+}
+
+uint8_t att_server_eatt_init(uint8_t num_eatt_bearers, uint8_t * storage_buffer, uint16_t storage_size){
+    if (ATT_REQUEST_BUFFER_SIZE < ATT_EATT_MIN_MTU){
+        log_error("EATT requires ATT_REQUEST_BUFFER_SIZE >= %u", ATT_EATT_MIN_MTU);
+        return ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE;
+    }
+
+    // align buffer to 16-byte boundary for bearer structs
+    uint16_t bytes_till_alignment = (16u - (((uintptr_t) storage_buffer) & 0x0fu)) & 0x0fu;
+    uint32_t size_for_bearers = num_eatt_bearers * (sizeof(att_server_eatt_bearer_t) + 2u * ATT_REQUEST_BUFFER_SIZE);
+    if (storage_size < (bytes_till_alignment + size_for_bearers)){
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+
+    // setup bearers - use void cast to avoid -Wcast-align warning
+    storage_buffer += bytes_till_alignment;
+    att_server_eatt_bearer_t * eatt_bearers = (att_server_eatt_bearer_t *) (void *) storage_buffer;
+    uint8_t * eatt_buffers = &storage_buffer[num_eatt_bearers * sizeof(att_server_eatt_bearer_t)];
+    memset(storage_buffer, 0, size_for_bearers);
+
+    att_server_eatt_bearer_pool   = NULL;
+    att_server_eatt_bearer_active = NULL;
+    uint8_t i;
+    for (i=0;i<num_eatt_bearers;i++){
+        att_server_eatt_bearer_t * eatt_bearer = &eatt_bearers[i];
+        eatt_bearer->receive_buffer = &eatt_buffers[(2u * i)      * ATT_REQUEST_BUFFER_SIZE];
+        eatt_bearer->att_bearer.eatt_send_buffer = &eatt_buffers[(2u * i + 1u) * ATT_REQUEST_BUFFER_SIZE];
+        eatt_bearer->att_connection.con_handle = HCI_CON_HANDLE_INVALID;
+        btstack_linked_list_add(&att_server_eatt_bearer_pool, (btstack_linked_item_t *) eatt_bearer);
+    }
+
+    // EATT requires encryption
+    return l2cap_ecbm_register_service(&att_server_eatt_handler, BLUETOOTH_PSM_EATT, ATT_EATT_MIN_MTU, LEVEL_2);
+}
+#endif
+
 void att_server_init(uint8_t const * db, att_read_callback_t read_callback, att_write_callback_t write_callback){
 
     // store callbacks
@@ -1202,7 +1631,7 @@ void att_server_register_packet_handler(btstack_packet_handler_t handler){
 int  att_server_can_send_packet_now(hci_con_handle_t con_handle){
     hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
     if (!hci_connection) return 0;
-    return att_server_can_send_packet(hci_connection);
+    return att_server_can_send_packet(&hci_connection->att_server.bearer, &hci_connection->att_connection);
 }
 
 uint8_t att_server_register_can_send_now_callback(btstack_context_callback_registration_t * callback_registration, hci_con_handle_t con_handle){
@@ -1220,7 +1649,7 @@ uint8_t att_server_request_to_send_notification(btstack_context_callback_registr
     if (!hci_connection) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
     att_server_t * att_server = &hci_connection->att_server;
     bool added = btstack_linked_list_add_tail(&att_server->notification_requests, (btstack_linked_item_t*) callback_registration);
-    att_server_request_can_send_now(hci_connection);
+    att_server_request_can_send_now(&hci_connection->att_server.bearer, &hci_connection->att_connection);
     if (added){
         return ERROR_CODE_SUCCESS;
     } else {
@@ -1233,7 +1662,7 @@ uint8_t att_server_request_to_send_indication(btstack_context_callback_registrat
     if (!hci_connection) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
     att_server_t * att_server = &hci_connection->att_server;
     bool added = btstack_linked_list_add_tail(&att_server->indication_requests, (btstack_linked_item_t*) callback_registration);
-    att_server_request_can_send_now(hci_connection);
+    att_server_request_can_send_now(&hci_connection->att_server.bearer, &hci_connection->att_connection);
     if (added){
         return ERROR_CODE_SUCCESS;
     } else {
@@ -1246,20 +1675,107 @@ uint8_t att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle
     if (!hci_connection) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
     att_connection_t * att_connection = &hci_connection->att_connection;
 
-    if (!att_server_can_send_packet(hci_connection)) return BTSTACK_ACL_BUFFERS_FULL;
+    if (!att_server_can_send_packet(&hci_connection->att_server.bearer, &hci_connection->att_connection)) return BTSTACK_ACL_BUFFERS_FULL;
 
     l2cap_reserve_packet_buffer();
     uint8_t * packet_buffer = l2cap_get_outgoing_buffer();
     uint16_t size = att_prepare_handle_value_notification(att_connection, attribute_handle, value, value_len, packet_buffer);
 #ifdef ENABLE_GATT_OVER_CLASSIC
     att_server_t * att_server = &hci_connection->att_server;
-    if (att_server->l2cap_cid != 0){
-        return  l2cap_send_prepared(att_server->l2cap_cid, size);;
+    if (att_server->bearer.l2cap_cid != 0){
+        return  l2cap_send_prepared(att_server->bearer.l2cap_cid, size);;
     }
 #endif
 	return l2cap_send_prepared_connectionless(att_connection->con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, size);
 }
 
+uint8_t att_server_multiple_notify(hci_con_handle_t con_handle, uint8_t num_attributes,
+                                   const uint16_t * attribute_handles, const uint8_t ** values_data, const uint16_t * values_len){
+    hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
+    if (!hci_connection) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    att_connection_t * att_connection = &hci_connection->att_connection;
+
+    if (num_attributes < 2u) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    uint8_t i;
+
+    // client does not support Multiple Handle Value Notifications
+    if (hci_connection->att_server.multiple_notifications_supported == false){
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+        // queue values to get them sent with regular Handle Value Notifications
+        for (i = 0; i < num_attributes; i++){
+            uint8_t status = att_server_notify_coalesced(con_handle, attribute_handles[i], values_data[i], values_len[i]);
+            if (status != ERROR_CODE_SUCCESS) return status;
+        }
+        return ERROR_CODE_SUCCESS;
+#else
+        return ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE;
+#endif
+    }
+
+    // all Handle Length Value tuples have to fit into a single PDU
+    uint32_t pdu_len = 1u;
+    for (i = 0; i < num_attributes; i++){
+        pdu_len += 4u + values_len[i];
+    }
+    if (pdu_len > att_connection->mtu) return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+
+    if (!att_server_can_send_packet(&hci_connection->att_server.bearer, &hci_connection->att_connection)) return BTSTACK_ACL_BUFFERS_FULL;
+
+    l2cap_reserve_packet_buffer();
+    uint8_t * packet_buffer = l2cap_get_outgoing_buffer();
+    uint16_t size = att_prepare_handle_value_multiple_notification(att_connection, num_attributes, attribute_handles, values_data, values_len, packet_buffer);
+#ifdef ENABLE_GATT_OVER_CLASSIC
+    att_server_t * att_server = &hci_connection->att_server;
+    if (att_server->bearer.l2cap_cid != 0){
+        return l2cap_send_prepared(att_server->bearer.l2cap_cid, size);
+    }
+#endif
+    return l2cap_send_prepared_connectionless(att_connection->con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, size);
+}
+
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+uint8_t att_server_notify_coalesced(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value, uint16_t value_len){
+    hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
+    if (!hci_connection) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    att_server_t * att_server = &hci_connection->att_server;
+    uint8_t * tuples = att_server->coalesced_notifications;
+
+    // value has to fit into a single Handle Value Notification
+    value_len = btstack_min(value_len, att_server_coalesced_notifications_mtu(hci_connection) - 3u);
+
+    // find pending value for attribute handle
+    uint16_t offset = 0;
+    uint16_t pending_tuple_len = 0;
+    while (offset < att_server->coalesced_notifications_len){
+        uint16_t tuple_len = 4u + little_endian_read_16(tuples, offset + 2u);
+        if (little_endian_read_16(tuples, offset) == attribute_handle){
+            pending_tuple_len = tuple_len;
+            break;
+        }
+        offset += tuple_len;
+    }
+
+    uint16_t free_space = ATT_SERVER_NOTIFICATION_COALESCING_BUFFER_SIZE - att_server->coalesced_notifications_len + pending_tuple_len;
+    if ((4u + value_len) > free_space) return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+
+    // replace pending value
+    if (pending_tuple_len > 0u){
+        att_server->coalesced_notifications_len -= pending_tuple_len;
+        (void)memmove(&tuples[offset], &tuples[offset + pending_tuple_len], att_server->coalesced_notifications_len - offset);
+    }
+
+    // append Handle Length Value tuple
+    offset = att_server->coalesced_notifications_len;
+    little_endian_store_16(tuples, offset, attribute_handle);
+    little_endian_store_16(tuples, offset + 2u, value_len);
+    (void)memcpy(&tuples[offset + 4u], value, value_len);
+    att_server->coalesced_notifications_len += 4u + value_len;
+
+    att_server_coalesced_notifications_request_can_send_now(hci_connection);
+    return ERROR_CODE_SUCCESS;
+}
+#endif
+
 uint8_t att_server_indicate(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value, uint16_t value_len){
     hci_connection_t * hci_connection = hci_connection_for_handle(con_handle);
     if (!hci_connection) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
@@ -1267,7 +1783,7 @@ uint8_t att_server_indicate(hci_con_handle_t con_handle, uint16_t attribute_hand
     att_connection_t * att_connection = &hci_connection->att_connection;
 
     if (att_server->value_indication_handle != 0u) return ATT_HANDLE_VALUE_INDICATION_IN_PROGRESS;
-    if (!att_server_can_send_packet(hci_connection)) return BTSTACK_ACL_BUFFERS_FULL;
+    if (!att_server_can_send_packet(&hci_connection->att_server.bearer, &hci_connection->att_connection)) return BTSTACK_ACL_BUFFERS_FULL;
 
     // track indication
     att_server->value_indication_handle = attribute_handle;
@@ -1279,8 +1795,8 @@ uint8_t att_server_indicate(hci_con_handle_t con_handle, uint16_t attribute_hand
     uint8_t * packet_buffer = l2cap_get_outgoing_buffer();
     uint16_t size = att_prepare_handle_value_indication(att_connection, attribute_handle, value, value_len, packet_buffer);
 #ifdef ENABLE_GATT_OVER_CLASSIC
-    if (att_server->l2cap_cid != 0){
-        return  l2cap_send_prepared(att_server->l2cap_cid, size);;
+    if (att_server->bearer.l2cap_cid != 0){
+        return  l2cap_send_prepared(att_server->bearer.l2cap_cid, size);;
     }
 #endif
 	l2cap_send_prepared_connectionless(att_connection->con_handle, L2CAP_CID_ATTRIBUTE_PROTOCOL, size);
@@ -1299,4 +1815,8 @@ void att_server_deinit(void){
     att_server_client_write_callback = NULL;
     att_client_packet_handler = NULL;
     service_handlers = NULL;
+#ifdef ENABLE_GATT_OVER_EATT
+    att_server_eatt_bearer_pool   = NULL;
+    att_server_eatt_bearer_active = NULL;
+#endif
 }
@@ -120,6 +120,35 @@ uint8_t att_server_request_to_send_indication(btstack_context_callback_registrat
  */
 uint8_t att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value, uint16_t value_len);
 
+/**
+ * @brief notify client about multiple attribute value changes with a single Multiple Handle Value Notification
+ * @note if the client did not set the Multiple Handle Value Notifications bit in its Client Supported Features,
+ *       the values are queued for regular Handle Value Notifications with ENABLE_ATT_SERVER_NOTIFICATION_COALESCING,
+ *       or ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE is returned otherwise
+ * @param con_handle
+ * @param num_attributes (at least 2)
+ * @param attribute_handles
+ * @param values_data
+ * @param values_len
+ * @return 0 if ok, ERROR_CODE_MEMORY_CAPACITY_EXCEEDED if values don't fit into ATT MTU, error otherwise
+ */
+uint8_t att_server_multiple_notify(hci_con_handle_t con_handle, uint8_t num_attributes,
+                                   const uint16_t * attribute_handles, const uint8_t ** values_data, const uint16_t * values_len);
+
+/**
+ * @brief queue value change notification for client. Values queued for a connection are coalesced into
+ *        Multiple Handle Value Notifications, if the client has set the Multiple Handle Value Notifications
+ *        bit in its Client Supported Features, and sent as individual notifications otherwise. A queued
+ *        value that has not been sent yet is replaced by a new value for the same attribute handle.
+ * @note requires ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+ * @param con_handle
+ * @param attribute_handle
+ * @param value is copied
+ * @param value_len
+ * @return 0 if ok, ERROR_CODE_MEMORY_CAPACITY_EXCEEDED if ATT_SERVER_NOTIFICATION_COALESCING_BUFFER_SIZE is exceeded, error otherwise
+ */
+uint8_t att_server_notify_coalesced(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value, uint16_t value_len);
+
 /**
  * @brief indicate value change to client. client is supposed to reply with an indication_response
  * @param con_handle
@@ -141,6 +170,18 @@ uint8_t att_server_indicate(hci_con_handle_t con_handle, uint16_t attribute_hand
 uint8_t att_server_response_ready(hci_con_handle_t con_handle);
 #endif
 
+/**
+ * @brief Enable support for Enhanced ATT bearers on PSM 0x0027. Requests received on each bearer are processed
+ *        concurrently to the unenhanced bearer. Notifications and indications are sent over the unenhanced bearer.
+ * @note requires ENABLE_GATT_OVER_EATT and ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+ * @note the GATT database should indicate EATT support in the Server Supported Features characteristic
+ * @param num_eatt_bearers total number of Enhanced ATT bearers for all connections
+ * @param storage_buffer for bearer state and receive/send buffers
+ * @param storage_size for each bearer, the bearer state and two buffers of ATT_REQUEST_BUFFER_SIZE are needed
+ * @return status ERROR_CODE_SUCCESS, ERROR_CODE_MEMORY_CAPACITY_EXCEEDED if storage is too small
+ */
+uint8_t att_server_eatt_init(uint8_t num_eatt_bearers, uint8_t * storage_buffer, uint16_t storage_size);
+
 /**
  * De-Init ATT Server 
  */
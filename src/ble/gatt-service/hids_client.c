@@ -208,6 +208,21 @@ uint16_t hids_client_descriptor_storage_get_descriptor_len(uint16_t hids_cid, ui
     return client->services[service_index].hid_descriptor_len;
 }
 
+uint8_t hids_client_compile_report_layout(uint16_t hids_cid, uint8_t service_index, btstack_hid_report_layout_t * layout){
+    hids_client_t * client = hids_get_client_for_cid(hids_cid);
+    if (client == NULL){
+        return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    }
+    if (service_index >= client->num_instances){
+        return ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE;
+    }
+    if (client->services[service_index].hid_descriptor_status != ERROR_CODE_SUCCESS){
+        return ERROR_CODE_COMMAND_DISALLOWED;
+    }
+    return btstack_hid_report_layout_compile(layout, client->services[service_index].hid_descriptor_len,
+                                             &hids_client_descriptor_storage[client->services[service_index].hid_descriptor_offset]);
+}
+
 // END Descriptor Storage Util
 
 static uint16_t hids_get_next_cid(void){
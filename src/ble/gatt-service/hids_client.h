@@ -46,6 +46,7 @@
 #include <stdint.h>
 #include "btstack_defines.h"
 #include "btstack_hid.h"
+#include "btstack_hid_parser.h"
 #include "bluetooth.h"
 #include "btstack_linked_list.h"
 #include "ble/gatt_client.h"
@@ -360,6 +361,19 @@ const uint8_t * hids_client_descriptor_storage_get_descriptor_data(uint16_t hids
  */
 uint16_t hids_client_descriptor_storage_get_descriptor_len(uint16_t hids_cid, uint8_t service_index);
 
+/*
+ * @brief Compile HID Descriptor of service into report layout for table-based report decoding.
+ * Call once after descriptor is available, then use btstack_hid_report_iterator_* on each report.
+ *
+ * @param hids_cid
+ * @param service_index
+ * @param layout initialized with btstack_hid_report_layout_init
+ * @return status ERROR_CODE_SUCCESS on success, otherwise ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER,
+ *         ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE for invalid service index,
+ *         ERROR_CODE_COMMAND_DISALLOWED if descriptor not available, ERROR_CODE_MEMORY_CAPACITY_EXCEEDED
+ */
+uint8_t hids_client_compile_report_layout(uint16_t hids_cid, uint8_t service_index, btstack_hid_report_layout_t * layout);
+
 /**
  * @brief De-initialize HID Service Client. 
  *
@@ -55,13 +55,23 @@
 #include "btstack_util.h"
 #include "hci.h"
 #include "hci_dump.h"
+#include "hci_event.h"
 #include "l2cap.h"
 #include "classic/sdp_client.h"
 #include "bluetooth_gatt.h"
+#include "bluetooth_psm.h"
 #include "bluetooth_sdp.h"
 #include "classic/sdp_util.h"
 
+// nr of buckets for client lookup by con handle and value listener lookup by con handle + value handle, power of two recommended
+#ifndef GATT_CLIENT_LOOKUP_TABLE_SIZE
+#define GATT_CLIENT_LOOKUP_TABLE_SIZE 16
+#endif
+
 static btstack_linked_list_t gatt_client_connections;
+static gatt_client_t *       gatt_client_connections_by_con_handle[GATT_CLIENT_LOOKUP_TABLE_SIZE];
+// listeners for a specific con handle and value handle are hashed, listeners with wildcards are kept in a list
+static btstack_linked_list_t gatt_client_value_listeners_by_handle[GATT_CLIENT_LOOKUP_TABLE_SIZE];
 static btstack_linked_list_t gatt_client_value_listeners;
 static btstack_packet_callback_registration_t hci_event_callback_registration;
 static btstack_packet_callback_registration_t sm_event_callback_registration;
@@ -74,12 +84,18 @@ static void gatt_client_att_packet_handler(uint8_t packet_type, uint16_t handle,
 static void gatt_client_event_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
 static void gatt_client_report_error_if_pending(gatt_client_t *gatt_client, uint8_t att_error_code);
 
+#ifdef ENABLE_GATT_OVER_EATT
+static void gatt_client_le_enhanced_run(gatt_client_t * gatt_client);
+static void gatt_client_le_enhanced_handle_disconnect(gatt_client_t * gatt_client, uint8_t reason);
+#endif
+
 #ifdef ENABLE_LE_SIGNED_WRITE
 static void att_signed_write_handle_cmac_result(uint8_t hash[8]);
 #endif
 
 void gatt_client_init(void){
     gatt_client_connections = NULL;
+    memset(gatt_client_connections_by_con_handle, 0, sizeof(gatt_client_connections_by_con_handle));
 
     // default configuration
     gatt_client_mtu_exchange_enabled    = true;
@@ -109,6 +125,16 @@ static gatt_client_t * gatt_client_for_timer(btstack_timer_source_t * ts){
         if (&gatt_client->gc_timeout == ts) {
             return gatt_client;
         }
+#ifdef ENABLE_GATT_OVER_EATT
+        btstack_linked_list_iterator_t it_eatt;
+        btstack_linked_list_iterator_init(&it_eatt, &gatt_client->eatt_clients);
+        while (btstack_linked_list_iterator_has_next(&it_eatt)){
+            gatt_client_t * eatt_client = (gatt_client_t *) btstack_linked_list_iterator_next(&it_eatt);
+            if (&eatt_client->gc_timeout == ts) {
+                return eatt_client;
+            }
+        }
+#endif
     }
     return NULL;
 }
@@ -144,16 +170,34 @@ static gap_security_level_t gatt_client_le_security_level_for_connection(hci_con
 }
 
 static gatt_client_t * gatt_client_get_context_for_handle(uint16_t handle){
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) gatt_client_connections; it != NULL; it = it->next){
-        gatt_client_t * gatt_client = (gatt_client_t *) it;
+    gatt_client_t * gatt_client = gatt_client_connections_by_con_handle[handle % GATT_CLIENT_LOOKUP_TABLE_SIZE];
+    while (gatt_client != NULL){
         if (gatt_client->con_handle == handle){
             return gatt_client;
         }
+        gatt_client = gatt_client->next_for_con_handle;
     }
     return NULL;
 }
 
+static void gatt_client_lookup_add_con_handle(gatt_client_t * gatt_client){
+    gatt_client_t ** bucket = &gatt_client_connections_by_con_handle[gatt_client->con_handle % GATT_CLIENT_LOOKUP_TABLE_SIZE];
+    gatt_client->next_for_con_handle = *bucket;
+    *bucket = gatt_client;
+}
+
+static void gatt_client_lookup_remove_con_handle(gatt_client_t * gatt_client){
+    gatt_client_t ** it = &gatt_client_connections_by_con_handle[gatt_client->con_handle % GATT_CLIENT_LOOKUP_TABLE_SIZE];
+    while (*it != NULL){
+        if (*it == gatt_client){
+            *it = gatt_client->next_for_con_handle;
+            gatt_client->next_for_con_handle = NULL;
+            return;
+        }
+        it = &(*it)->next_for_con_handle;
+    }
+}
+
 
 // @return gatt_client context
 // returns existing one, or tries to setup new one
@@ -189,6 +233,7 @@ static uint8_t gatt_client_provide_context_for_handle(hci_con_handle_t con_handl
     }
     gatt_client->gatt_client_state = P_READY;
     btstack_linked_list_add(&gatt_client_connections, (btstack_linked_item_t*)gatt_client);
+    gatt_client_lookup_add_con_handle(gatt_client);
 
     // get unenhanced att bearer state
     if (hci_connection->att_connection.mtu_exchanged){
@@ -199,26 +244,45 @@ static uint8_t gatt_client_provide_context_for_handle(hci_con_handle_t con_handl
     return ERROR_CODE_SUCCESS;
 }
 
+static bool is_ready(gatt_client_t * gatt_client){
+    return gatt_client->gatt_client_state == P_READY;
+}
+
+// @return idle Enhanced ATT bearer if available, unenhanced client otherwise
+static gatt_client_t * gatt_client_select_bearer(gatt_client_t * gatt_client){
+#ifdef ENABLE_GATT_OVER_EATT
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &gatt_client->eatt_clients);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        gatt_client_t * eatt_client = (gatt_client_t *) btstack_linked_list_iterator_next(&it);
+        if ((eatt_client->eatt_state == GATT_CLIENT_EATT_READY) && is_ready(eatt_client)){
+            return eatt_client;
+        }
+    }
+#endif
+    return gatt_client;
+}
+
 static uint8_t gatt_client_provide_context_for_handle_and_start_timer(hci_con_handle_t con_handle, gatt_client_t ** out_gatt_client){
-    uint8_t status = gatt_client_provide_context_for_handle(con_handle, out_gatt_client);
+    gatt_client_t * gatt_client;
+    uint8_t status = gatt_client_provide_context_for_handle(con_handle, &gatt_client);
     if (status != ERROR_CODE_SUCCESS){
+        *out_gatt_client = gatt_client;
         return status;
     }
-    gatt_client_timeout_start(*out_gatt_client);
+    gatt_client = gatt_client_select_bearer(gatt_client);
+    gatt_client_timeout_start(gatt_client);
+    *out_gatt_client = gatt_client;
     return status;
 }
 
-static bool is_ready(gatt_client_t * gatt_client){
-    return gatt_client->gatt_client_state == P_READY;
-}
-
 int gatt_client_is_ready(hci_con_handle_t con_handle){
     gatt_client_t * gatt_client;
     uint8_t status = gatt_client_provide_context_for_handle(con_handle, &gatt_client);
     if (status != ERROR_CODE_SUCCESS){
         return 0;
     }
-    return is_ready(gatt_client) ? 1 : 0;
+    return is_ready(gatt_client_select_bearer(gatt_client)) ? 1 : 0;
 }
 
 void gatt_client_mtu_enable_auto_negotiation(uint8_t enabled){
@@ -240,8 +304,25 @@ uint8_t gatt_client_get_mtu(hci_con_handle_t con_handle, uint16_t * mtu){
     return GATT_CLIENT_IN_WRONG_STATE;
 }
 
+static uint8_t * gatt_client_reserve_request_buffer(gatt_client_t * gatt_client){
+#ifdef ENABLE_GATT_OVER_EATT
+    if (gatt_client->eatt_cid != 0){
+        return gatt_client->eatt_send_buffer;
+    }
+#else
+    UNUSED(gatt_client);
+#endif
+    l2cap_reserve_packet_buffer();
+    return l2cap_get_outgoing_buffer();
+}
+
 // precondition: can_send_packet_now == TRUE
 static uint8_t gatt_client_send(gatt_client_t * gatt_client, uint16_t len){
+#ifdef ENABLE_GATT_OVER_EATT
+    if (gatt_client->eatt_cid != 0){
+        return l2cap_send(gatt_client->eatt_cid, gatt_client->eatt_send_buffer, len);
+    }
+#endif
 #ifdef ENABLE_GATT_OVER_CLASSIC
     if (gatt_client->l2cap_psm){
         return l2cap_send_prepared(gatt_client->l2cap_cid, len);
@@ -252,9 +333,7 @@ static uint8_t gatt_client_send(gatt_client_t * gatt_client, uint16_t len){
 
 // precondition: can_send_packet_now == TRUE
 static uint8_t att_confirmation(gatt_client_t * gatt_client) {
-    l2cap_reserve_packet_buffer();
-
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
     request[0] = ATT_HANDLE_VALUE_CONFIRMATION;
 
     return gatt_client_send(gatt_client, 1);
@@ -263,8 +342,7 @@ static uint8_t att_confirmation(gatt_client_t * gatt_client) {
 // precondition: can_send_packet_now == TRUE
 static uint8_t att_find_information_request(gatt_client_t *gatt_client, uint8_t request_type, uint16_t start_handle,
                                             uint16_t end_handle) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
 
     request[0] = request_type;
     little_endian_store_16(request, 1, start_handle);
@@ -277,8 +355,7 @@ static uint8_t att_find_information_request(gatt_client_t *gatt_client, uint8_t
 static uint8_t
 att_find_by_type_value_request(gatt_client_t *gatt_client, uint8_t request_type, uint16_t attribute_group_type,
                                uint16_t start_handle, uint16_t end_handle, uint8_t *value, uint16_t value_size) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
     
     request[0] = request_type;
     little_endian_store_16(request, 1, start_handle);
@@ -293,8 +370,7 @@ att_find_by_type_value_request(gatt_client_t *gatt_client, uint8_t request_type,
 static uint8_t
 att_read_by_type_or_group_request_for_uuid16(gatt_client_t *gatt_client, uint8_t request_type, uint16_t uuid16,
                                              uint16_t start_handle, uint16_t end_handle) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
 
     request[0] = request_type;
     little_endian_store_16(request, 1, start_handle);
@@ -308,8 +384,7 @@ att_read_by_type_or_group_request_for_uuid16(gatt_client_t *gatt_client, uint8_t
 static uint8_t
 att_read_by_type_or_group_request_for_uuid128(gatt_client_t *gatt_client, uint8_t request_type, const uint8_t *uuid128,
                                               uint16_t start_handle, uint16_t end_handle) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
 
     request[0] = request_type;
     little_endian_store_16(request, 1, start_handle);
@@ -321,8 +396,7 @@ att_read_by_type_or_group_request_for_uuid128(gatt_client_t *gatt_client, uint8_
 
 // precondition: can_send_packet_now == TRUE
 static uint8_t att_read_request(gatt_client_t *gatt_client, uint8_t request_type, uint16_t attribute_handle) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
 
     request[0] = request_type;
     little_endian_store_16(request, 1, attribute_handle);
@@ -333,8 +407,7 @@ static uint8_t att_read_request(gatt_client_t *gatt_client, uint8_t request_type
 // precondition: can_send_packet_now == TRUE
 static uint8_t att_read_blob_request(gatt_client_t *gatt_client, uint8_t request_type, uint16_t attribute_handle,
                                      uint16_t value_offset) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
     request[0] = request_type;
     little_endian_store_16(request, 1, attribute_handle);
     little_endian_store_16(request, 3, value_offset);
@@ -343,10 +416,9 @@ static uint8_t att_read_blob_request(gatt_client_t *gatt_client, uint8_t request
 }
 
 static uint8_t
-att_read_multiple_request(gatt_client_t *gatt_client, uint16_t num_value_handles, uint16_t *value_handles) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
-    request[0] = ATT_READ_MULTIPLE_REQUEST;
+att_read_multiple_request(gatt_client_t *gatt_client, uint8_t request_type, uint16_t num_value_handles, uint16_t *value_handles) {
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
+    request[0] = request_type;
     int i;
     int offset = 1;
     for (i=0;i<num_value_handles;i++){
@@ -361,8 +433,7 @@ att_read_multiple_request(gatt_client_t *gatt_client, uint16_t num_value_handles
 // precondition: can_send_packet_now == TRUE
 static uint8_t att_signed_write_request(gatt_client_t *gatt_client, uint16_t request_type, uint16_t attribute_handle,
                                         uint16_t value_length, uint8_t *value, uint32_t sign_counter, uint8_t sgn[8]) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
     request[0] = request_type;
     little_endian_store_16(request, 1, attribute_handle);
     (void)memcpy(&request[3], value, value_length);
@@ -377,8 +448,7 @@ static uint8_t att_signed_write_request(gatt_client_t *gatt_client, uint16_t req
 static uint8_t
 att_write_request(gatt_client_t *gatt_client, uint8_t request_type, uint16_t attribute_handle, uint16_t value_length,
                   uint8_t *value) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
     request[0] = request_type;
     little_endian_store_16(request, 1, attribute_handle);
     (void)memcpy(&request[3], value, value_length);
@@ -388,8 +458,7 @@ att_write_request(gatt_client_t *gatt_client, uint8_t request_type, uint16_t att
 
 // precondition: can_send_packet_now == TRUE
 static uint8_t att_execute_write_request(gatt_client_t *gatt_client, uint8_t request_type, uint8_t execute_write) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
     request[0] = request_type;
     request[1] = execute_write;
     
@@ -399,8 +468,7 @@ static uint8_t att_execute_write_request(gatt_client_t *gatt_client, uint8_t req
 // precondition: can_send_packet_now == TRUE
 static uint8_t att_prepare_write_request(gatt_client_t *gatt_client, uint8_t request_type, uint16_t attribute_handle,
                                          uint16_t value_offset, uint16_t blob_length, uint8_t *value) {
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
     request[0] = request_type;
     little_endian_store_16(request, 1, attribute_handle);
     little_endian_store_16(request, 3, value_offset);
@@ -411,8 +479,7 @@ static uint8_t att_prepare_write_request(gatt_client_t *gatt_client, uint8_t req
 
 static uint8_t att_exchange_mtu_request(gatt_client_t *gatt_client) {
     uint16_t mtu = l2cap_max_le_mtu();
-    l2cap_reserve_packet_buffer();
-    uint8_t * request = l2cap_get_outgoing_buffer();
+    uint8_t * request = gatt_client_reserve_request_buffer(gatt_client);
     request[0] = ATT_EXCHANGE_MTU_REQUEST;
     little_endian_store_16(request, 1, mtu);
     
@@ -502,7 +569,11 @@ static void send_gatt_read_blob_request(gatt_client_t *gatt_client){
 }
 
 static void send_gatt_read_multiple_request(gatt_client_t * gatt_client){
-    att_read_multiple_request(gatt_client, gatt_client->read_multiple_handle_count, gatt_client->read_multiple_handles);
+    att_read_multiple_request(gatt_client, ATT_READ_MULTIPLE_REQUEST, gatt_client->read_multiple_handle_count, gatt_client->read_multiple_handles);
+}
+
+static void send_gatt_read_multiple_variable_request(gatt_client_t * gatt_client){
+    att_read_multiple_request(gatt_client, ATT_READ_MULTIPLE_VARIABLE_REQ, gatt_client->read_multiple_handle_count, gatt_client->read_multiple_handles);
 }
 
 static void send_gatt_write_attribute_value_request(gatt_client_t * gatt_client){
@@ -571,7 +642,7 @@ static uint16_t get_last_result_handle_from_included_services_list(uint8_t * pac
 }
 
 static void gatt_client_notify_can_send_query(gatt_client_t * gatt_client){
-    while (gatt_client->gatt_client_state == P_READY){
+    while (is_ready(gatt_client_select_bearer(gatt_client))){
         btstack_context_callback_registration_t * callback = (btstack_context_callback_registration_t *) btstack_linked_list_pop(&gatt_client->query_requests);
         if (callback == NULL) {
             return;
@@ -583,6 +654,13 @@ static void gatt_client_notify_can_send_query(gatt_client_t * gatt_client){
 static void gatt_client_handle_transaction_complete(gatt_client_t * gatt_client){
     gatt_client->gatt_client_state = P_READY;
     gatt_client_timeout_stop(gatt_client);
+#ifdef ENABLE_GATT_OVER_EATT
+    // queued query requests are stored in the unenhanced client
+    if (gatt_client->eatt_cid != 0){
+        gatt_client = gatt_client_get_context_for_handle(gatt_client->con_handle);
+        if (gatt_client == NULL) return;
+    }
+#endif
     gatt_client_notify_can_send_query(gatt_client);
 }
 
@@ -592,6 +670,17 @@ static void emit_event_new(btstack_packet_handler_t callback, uint8_t * packet,
     (*callback)(HCI_EVENT_PACKET, 0, packet, size);
 }
 
+static btstack_linked_list_t * gatt_client_value_listeners_for_handle(hci_con_handle_t con_handle, uint16_t attribute_handle){
+    uint32_t hash = ((uint32_t) con_handle * 31u) + attribute_handle;
+    return &gatt_client_value_listeners_by_handle[hash % GATT_CLIENT_LOOKUP_TABLE_SIZE];
+}
+
+static btstack_linked_list_t * gatt_client_value_listeners_for_notification(gatt_client_notification_t * notification){
+    if (notification->con_handle       == GATT_CLIENT_ANY_CONNECTION)   return &gatt_client_value_listeners;
+    if (notification->attribute_handle == GATT_CLIENT_ANY_VALUE_HANDLE) return &gatt_client_value_listeners;
+    return gatt_client_value_listeners_for_handle(notification->con_handle, notification->attribute_handle);
+}
+
 void gatt_client_listen_for_characteristic_value_updates(gatt_client_notification_t * notification, btstack_packet_handler_t callback, hci_con_handle_t con_handle, gatt_client_characteristic_t * characteristic){
     notification->callback = callback;
     notification->con_handle = con_handle;
@@ -600,15 +689,24 @@ void gatt_client_listen_for_characteristic_value_updates(gatt_client_notificatio
     } else {
         notification->attribute_handle = characteristic->value_handle;
     }
-    btstack_linked_list_add(&gatt_client_value_listeners, (btstack_linked_item_t*) notification);
+    btstack_linked_list_add(gatt_client_value_listeners_for_notification(notification), (btstack_linked_item_t*) notification);
 }
 
 void gatt_client_stop_listening_for_characteristic_value_updates(gatt_client_notification_t * notification){
-    btstack_linked_list_remove(&gatt_client_value_listeners, (btstack_linked_item_t*) notification);
+    btstack_linked_list_remove(gatt_client_value_listeners_for_notification(notification), (btstack_linked_item_t*) notification);
 }
 
 static void emit_event_to_registered_listeners(hci_con_handle_t con_handle, uint16_t attribute_handle, uint8_t * packet, uint16_t size){
-    btstack_linked_list_iterator_t it;    
+    btstack_linked_list_iterator_t it;
+    // listeners for con handle and value handle
+    btstack_linked_list_iterator_init(&it, gatt_client_value_listeners_for_handle(con_handle, attribute_handle));
+    while (btstack_linked_list_iterator_has_next(&it)){
+        gatt_client_notification_t * notification = (gatt_client_notification_t*) btstack_linked_list_iterator_next(&it);
+        if (notification->con_handle       != con_handle)       continue;
+        if (notification->attribute_handle != attribute_handle) continue;
+        (*notification->callback)(HCI_EVENT_PACKET, 0, packet, size);
+    }
+    // listeners with wildcards
     btstack_linked_list_iterator_init(&it, &gatt_client_value_listeners);
     while (btstack_linked_list_iterator_has_next(&it)){
         gatt_client_notification_t * notification = (gatt_client_notification_t*) btstack_linked_list_iterator_next(&it);
@@ -862,6 +960,34 @@ static void report_gatt_characteristic_value(gatt_client_t * gatt_client, uint16
     emit_event_new(gatt_client->callback, packet, characteristic_value_event_header_size + length);
 }
 
+// @note event for each Handle Length Value tuple overwrites the previous tuple, which has already been reported
+static void report_gatt_multiple_notification(gatt_client_t * gatt_client, uint8_t * packet, uint16_t size){
+    uint16_t offset = 1;
+    while ((offset + 4u) <= size){
+        uint16_t value_handle = little_endian_read_16(packet, offset);
+        uint16_t value_length = little_endian_read_16(packet, offset + 2u);
+        offset += 4u;
+        if ((offset + value_length) > size) break;
+        report_gatt_notification(gatt_client, value_handle, &packet[offset], value_length);
+        offset += value_length;
+    }
+}
+
+// @note event for each Length Value tuple overwrites the previous tuple, which has already been reported
+static void report_gatt_multiple_variable_characteristic_values(gatt_client_t * gatt_client, uint8_t * packet, uint16_t size){
+    uint16_t offset = 1;
+    uint16_t i;
+    for (i = 0; i < gatt_client->read_multiple_handle_count; i++){
+        if ((offset + 2u) > size) break;
+        uint16_t value_length = little_endian_read_16(packet, offset);
+        offset += 2u;
+        // last value might be truncated
+        value_length = btstack_min(value_length, size - offset);
+        report_gatt_characteristic_value(gatt_client, gatt_client->read_multiple_handles[i], &packet[offset], value_length);
+        offset += value_length;
+    }
+}
+
 // @note assume that value is part of an l2cap buffer - overwrite parts of the HCI/L2CAP/ATT packet (4/4/3) bytes 
 static void report_gatt_long_characteristic_value_blob(gatt_client_t * gatt_client, uint16_t attribute_handle, uint8_t * blob, uint16_t blob_length, int value_offset){
     uint8_t * packet = setup_long_characteristic_value_packet(GATT_EVENT_LONG_CHARACTERISTIC_VALUE_QUERY_RESULT, gatt_client->con_handle, attribute_handle, value_offset, blob, blob_length);
@@ -1005,6 +1131,12 @@ static bool gatt_client_run_for_gatt_client(gatt_client_t * gatt_client){
     if (gatt_client->l2cap_psm != 0){
         check_security = false;
     }
+#endif
+#ifdef ENABLE_GATT_OVER_EATT
+    // Enhanced ATT bearers are encrypted, pairing is handled by the unenhanced client
+    if (gatt_client->eatt_cid != 0){
+        check_security = false;
+    }
 #endif
     if (client_request_pending && (gatt_client_required_security_level > gatt_client->security_level) && check_security){
         log_info("Trigger pairing, current security level %u, required %u\n", gatt_client->security_level, gatt_client_required_security_level);
@@ -1112,6 +1244,11 @@ static bool gatt_client_run_for_gatt_client(gatt_client_t * gatt_client){
             send_gatt_read_multiple_request(gatt_client);
             break;
 
+        case P_W2_SEND_READ_MULTIPLE_VARIABLE_REQUEST:
+            gatt_client->gatt_client_state = P_W4_READ_MULTIPLE_VARIABLE_RESPONSE;
+            send_gatt_read_multiple_variable_request(gatt_client);
+            break;
+
         case P_W2_SEND_WRITE_CHARACTERISTIC_VALUE:
             gatt_client->gatt_client_state = P_W4_WRITE_CHARACTERISTIC_VALUE_RESULT;
             send_gatt_write_attribute_value_request(gatt_client);
@@ -1265,6 +1402,12 @@ static bool gatt_client_run_for_gatt_client(gatt_client_t * gatt_client){
 
 static void gatt_client_run(void){
     btstack_linked_item_t *it;
+#ifdef ENABLE_GATT_OVER_EATT
+    // Enhanced ATT bearers have their own L2CAP channel and don't block other clients
+    for (it = (btstack_linked_item_t *) gatt_client_connections; it != NULL; it = it->next){
+        gatt_client_le_enhanced_run((gatt_client_t *) it);
+    }
+#endif
     for (it = (btstack_linked_item_t *) gatt_client_connections; it != NULL; it = it->next){
         gatt_client_t * gatt_client = (gatt_client_t *) it;
 #ifdef ENABLE_GATT_OVER_CLASSIC
@@ -1369,9 +1512,13 @@ static void gatt_client_handle_disconnection_complete(const uint8_t * packet){
     gatt_client_t * gatt_client = gatt_client_get_context_for_handle(con_handle);
     if (gatt_client == NULL) return;
 
+#ifdef ENABLE_GATT_OVER_EATT
+    gatt_client_le_enhanced_handle_disconnect(gatt_client, hci_event_disconnection_complete_get_reason(packet));
+#endif
     gatt_client_report_error_if_pending(gatt_client, ATT_ERROR_HCI_DISCONNECT_RECEIVED);
     gatt_client_timeout_stop(gatt_client);
     btstack_linked_list_remove(&gatt_client_connections, (btstack_linked_item_t *) gatt_client);
+    gatt_client_lookup_remove_con_handle(gatt_client);
     btstack_memory_gatt_client_free(gatt_client);
 }
 
@@ -1621,6 +1768,9 @@ static void gatt_client_handle_att_response(gatt_client_t * gatt_client, uint8_t
             if (size < 3u) return;
             report_gatt_notification(gatt_client, little_endian_read_16(packet, 1u), &packet[3], size - 3u);
             return;
+        case ATT_MULTIPLE_HANDLE_VALUE_NTF:
+            report_gatt_multiple_notification(gatt_client, packet, size);
+            return;
         case ATT_HANDLE_VALUE_INDICATION:
             if (size < 3u) break;
             report_gatt_indication(gatt_client, little_endian_read_16(packet, 1u), &packet[3], size - 3u);
@@ -1793,6 +1943,18 @@ static void gatt_client_handle_att_response(gatt_client_t * gatt_client, uint8_t
             }
             break;
 
+        case ATT_READ_MULTIPLE_VARIABLE_RSP:
+            switch (gatt_client->gatt_client_state) {
+                case P_W4_READ_MULTIPLE_VARIABLE_RESPONSE:
+                    report_gatt_multiple_variable_characteristic_values(gatt_client, packet, size);
+                    gatt_client_handle_transaction_complete(gatt_client);
+                    emit_gatt_complete_event(gatt_client, ATT_ERROR_SUCCESS);
+                    break;
+                default:
+                    break;
+            }
+            break;
+
         case ATT_ERROR_RESPONSE:
             if (size < 5u) return;
             error_code = packet[4];
@@ -1856,6 +2018,9 @@ static void gatt_client_handle_att_response(gatt_client_t * gatt_client, uint8_t
                             case P_W4_READ_MULTIPLE_RESPONSE:
                                 gatt_client->gatt_client_state = P_W2_SEND_READ_MULTIPLE_REQUEST;
                                 break;
+                            case P_W4_READ_MULTIPLE_VARIABLE_RESPONSE:
+                                gatt_client->gatt_client_state = P_W2_SEND_READ_MULTIPLE_VARIABLE_REQUEST;
+                                break;
                             case P_W4_WRITE_CHARACTERISTIC_VALUE_RESULT:
                                 gatt_client->gatt_client_state = P_W2_SEND_WRITE_CHARACTERISTIC_VALUE;
                                 break;
@@ -1963,6 +2128,7 @@ static void gatt_client_att_packet_handler(uint8_t packet_type, uint16_t handle,
     switch (packet[0]) {
         case ATT_HANDLE_VALUE_NOTIFICATION:
         case ATT_HANDLE_VALUE_INDICATION:
+        case ATT_MULTIPLE_HANDLE_VALUE_NTF:
             gatt_client_provide_context_for_handle(handle, &gatt_client);
             break;
         default:
@@ -2315,6 +2481,24 @@ uint8_t gatt_client_read_multiple_characteristic_values(btstack_packet_handler_t
     return ERROR_CODE_SUCCESS;
 }
 
+uint8_t gatt_client_read_multiple_variable_characteristic_values(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint8_t num_value_handles, uint16_t * value_handles){
+    gatt_client_t * gatt_client;
+    uint8_t status = gatt_client_provide_context_for_handle_and_start_timer(con_handle, &gatt_client);
+    if (status != ERROR_CODE_SUCCESS){
+        return status;
+    }
+    if (is_ready(gatt_client) == 0){
+        return GATT_CLIENT_IN_WRONG_STATE;
+    }
+
+    gatt_client->callback = callback;
+    gatt_client->read_multiple_handle_count = num_value_handles;
+    gatt_client->read_multiple_handles = value_handles;
+    gatt_client->gatt_client_state = P_W2_SEND_READ_MULTIPLE_VARIABLE_REQUEST;
+    gatt_client_run();
+    return ERROR_CODE_SUCCESS;
+}
+
 uint8_t gatt_client_write_value_of_characteristic_without_response(hci_con_handle_t con_handle, uint16_t value_handle, uint16_t value_length, uint8_t * value){
     gatt_client_t * gatt_client;
     uint8_t status = gatt_client_provide_context_for_handle(con_handle, &gatt_client);
@@ -2679,8 +2863,6 @@ uint8_t gatt_client_request_can_write_without_response_event(btstack_packet_hand
 
 #ifdef ENABLE_GATT_OVER_CLASSIC
 
-#include "hci_event.h"
-
 // single active SDP query
 static gatt_client_t * gatt_client_classic_active_sdp_query;
 
@@ -2726,6 +2908,8 @@ static void gatt_client_classic_handle_connected(gatt_client_t * gatt_client, ui
     if (status != ERROR_CODE_SUCCESS){
         btstack_linked_list_remove(&gatt_client_connections, (btstack_linked_item_t *) gatt_client);
         btstack_memory_gatt_client_free(gatt_client);
+    } else {
+        gatt_client_lookup_add_con_handle(gatt_client);
     }
     uint8_t buffer[20];
     uint16_t len = hci_event_create_from_template_and_arguments(buffer, sizeof(buffer), &gatt_client_connected, status, addr,
@@ -2741,6 +2925,7 @@ static void gatt_client_classic_handle_disconnected(gatt_client_t * gatt_client)
     hci_con_handle_t con_handle = gatt_client->con_handle;
     btstack_packet_handler_t callback = gatt_client->callback;
     btstack_linked_list_remove(&gatt_client_connections, (btstack_linked_item_t *) gatt_client);
+    gatt_client_lookup_remove_con_handle(gatt_client);
     btstack_memory_gatt_client_free(gatt_client);
 
     uint8_t buffer[20];
@@ -2787,10 +2972,12 @@ static void gatt_client_handle_sdp_client_query_attribute_value(gatt_client_t *
     des_iterator_t des_list_it;
     des_iterator_t prot_it;
 
-    if (sdp_event_query_attribute_byte_get_attribute_length(packet) <= sizeof(gatt_client_classic_sdp_buffer)) {
-        gatt_client_classic_sdp_buffer[sdp_event_query_attribute_byte_get_data_offset(packet)] = sdp_event_query_attribute_byte_get_data(packet);
-        if ((uint16_t)(sdp_event_query_attribute_byte_get_data_offset(packet)+1) == sdp_event_query_attribute_byte_get_attribute_length(packet)) {
-            switch(sdp_event_query_attribute_byte_get_attribute_id(packet)) {
+    if (sdp_event_query_attribute_value_chunk_get_attribute_length(packet) <= sizeof(gatt_client_classic_sdp_buffer)) {
+        uint16_t data_offset = sdp_event_query_attribute_value_chunk_get_data_offset(packet);
+        uint8_t  data_len    = sdp_event_query_attribute_value_chunk_get_data_len(packet);
+        (void)memcpy(&gatt_client_classic_sdp_buffer[data_offset], sdp_event_query_attribute_value_chunk_get_data(packet), data_len);
+        if ((uint16_t)(data_offset + data_len) == sdp_event_query_attribute_value_chunk_get_attribute_length(packet)) {
+            switch(sdp_event_query_attribute_value_chunk_get_attribute_id(packet)) {
                 case BLUETOOTH_ATTRIBUTE_PROTOCOL_DESCRIPTOR_LIST:
                     for (des_iterator_init(&des_list_it, gatt_client_classic_sdp_buffer); des_iterator_has_more(&des_list_it); des_iterator_next(&des_list_it)) {
                         uint8_t       *des_element;
@@ -2833,7 +3020,7 @@ static void gatt_client_classic_sdp_handler(uint8_t packet_type, uint16_t handle
 
     // TODO: handle sdp events, get l2cap psm
     switch (hci_event_packet_get_type(packet)){
-        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE:
+        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK:
             gatt_client_handle_sdp_client_query_attribute_value(gatt_client, packet);
             // TODO:
             return;
@@ -2866,7 +3053,7 @@ static void gatt_client_classic_sdp_handler(uint8_t packet_type, uint16_t handle
 static void gatt_client_classic_sdp_start(void * context){
     gatt_client_classic_active_sdp_query = (gatt_client_t *) context;
     gatt_client_classic_active_sdp_query->gatt_client_state = P_W4_SDP_QUERY;
-    sdp_client_query_uuid16(gatt_client_classic_sdp_handler, gatt_client_classic_active_sdp_query->addr, ORG_BLUETOOTH_SERVICE_GENERIC_ATTRIBUTE);
+    sdp_client_query_uuid16_chunked(gatt_client_classic_sdp_handler, gatt_client_classic_active_sdp_query->addr, ORG_BLUETOOTH_SERVICE_GENERIC_ATTRIBUTE);
 }
 
 uint8_t gatt_client_classic_connect(btstack_packet_handler_t callback, bd_addr_t addr){
@@ -2903,6 +3090,309 @@ uint8_t gatt_client_classic_disconnect(btstack_packet_handler_t callback, hci_co
 }
 #endif
 
+#ifdef ENABLE_GATT_OVER_EATT
+
+// GATT events are created in-place in front of the received ATT PDU, which is stored at the start of the SDU buffer
+#define GATT_CLIENT_EATT_RECEIVE_BUFFER_HEADROOM 12u
+
+static void gatt_client_le_enhanced_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
+
+static const hci_event_t gatt_client_eatt_connected = {
+        GATT_EVENT_EATT_CONNECTED, 0, "1H1"
+};
+
+static gatt_client_t * gatt_client_le_enhanced_get_context_for_l2cap_cid(uint16_t l2cap_cid, gatt_client_t ** out_eatt_client){
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) gatt_client_connections; it != NULL; it = it->next){
+        gatt_client_t * gatt_client = (gatt_client_t *) it;
+        btstack_linked_item_t *it_eatt;
+        for (it_eatt = gatt_client->eatt_clients; it_eatt != NULL; it_eatt = it_eatt->next){
+            gatt_client_t * eatt_client = (gatt_client_t *) it_eatt;
+            if (eatt_client->eatt_cid == l2cap_cid){
+                *out_eatt_client = eatt_client;
+                return gatt_client;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void gatt_client_le_enhanced_setup_complete(gatt_client_t * gatt_client, uint8_t status){
+    gatt_client->eatt_state = (status == ERROR_CODE_SUCCESS) ? GATT_CLIENT_EATT_READY : GATT_CLIENT_EATT_IDLE;
+    uint8_t num_bearers = (uint8_t) btstack_linked_list_count(&gatt_client->eatt_clients);
+    uint8_t buffer[8];
+    uint16_t len = hci_event_create_from_template_and_arguments(buffer, sizeof(buffer), &gatt_client_eatt_connected, status,
+                                                                gatt_client->con_handle, num_bearers);
+    (*gatt_client->eatt_callback)(HCI_EVENT_PACKET, 0, buffer, len);
+}
+
+static void gatt_client_le_enhanced_check_setup_complete(gatt_client_t * gatt_client, uint8_t status);
+
+static void gatt_client_le_enhanced_handle_channel_opened(gatt_client_t * gatt_client, gatt_client_t * eatt_client, const uint8_t * packet){
+    uint8_t status = l2cap_event_ecbm_channel_opened_get_status(packet);
+    if (status == ERROR_CODE_SUCCESS){
+        uint16_t remote_mtu = l2cap_event_ecbm_channel_opened_get_remote_mtu(packet);
+        eatt_client->eatt_local_mtu = l2cap_event_ecbm_channel_opened_get_local_mtu(packet);
+        eatt_client->mtu = btstack_min(eatt_client->eatt_local_mtu, remote_mtu);
+        eatt_client->security_level = gatt_client_le_security_level_for_connection(eatt_client->con_handle);
+        eatt_client->eatt_state = GATT_CLIENT_EATT_READY;
+    } else {
+        log_info("EATT bearer 0x%04x failed, status 0x%02x", eatt_client->eatt_cid, status);
+        btstack_linked_list_remove(&gatt_client->eatt_clients, (btstack_linked_item_t *) eatt_client);
+    }
+    gatt_client_le_enhanced_check_setup_complete(gatt_client, status);
+}
+
+static void gatt_client_le_enhanced_check_setup_complete(gatt_client_t * gatt_client, uint8_t status){
+    if (gatt_client->eatt_state != GATT_CLIENT_EATT_L2CAP_SETUP) return;
+
+    // wait for remaining bearers
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &gatt_client->eatt_clients);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        gatt_client_t * pending_client = (gatt_client_t *) btstack_linked_list_iterator_next(&it);
+        if (pending_client->eatt_state == GATT_CLIENT_EATT_L2CAP_SETUP) return;
+    }
+
+    if (btstack_linked_list_empty(&gatt_client->eatt_clients) == false){
+        status = ERROR_CODE_SUCCESS;
+    }
+    gatt_client_le_enhanced_setup_complete(gatt_client, status);
+    gatt_client_notify_can_send_query(gatt_client);
+}
+
+static void gatt_client_le_enhanced_handle_channel_closed(gatt_client_t * gatt_client, gatt_client_t * eatt_client){
+    // mark as unusable before reporting the error, as queued queries get dispatched to idle bearers
+    eatt_client->eatt_state = GATT_CLIENT_EATT_IDLE;
+    gatt_client_report_error_if_pending(eatt_client, ATT_ERROR_HCI_DISCONNECT_RECEIVED);
+    gatt_client_timeout_stop(eatt_client);
+    btstack_linked_list_remove(&gatt_client->eatt_clients, (btstack_linked_item_t *) eatt_client);
+    if (gatt_client->eatt_state == GATT_CLIENT_EATT_L2CAP_SETUP){
+        gatt_client_le_enhanced_check_setup_complete(gatt_client, L2CAP_CONNECTION_RESPONSE_RESULT_REFUSED_RESOURCES);
+        return;
+    }
+    if (btstack_linked_list_empty(&gatt_client->eatt_clients)){
+        gatt_client->eatt_state = GATT_CLIENT_EATT_IDLE;
+    }
+}
+
+static void gatt_client_le_enhanced_handle_disconnect(gatt_client_t * gatt_client, uint8_t reason){
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &gatt_client->eatt_clients);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        gatt_client_t * eatt_client = (gatt_client_t *) btstack_linked_list_iterator_next(&it);
+        eatt_client->eatt_state = GATT_CLIENT_EATT_IDLE;
+        gatt_client_report_error_if_pending(eatt_client, ATT_ERROR_HCI_DISCONNECT_RECEIVED);
+        gatt_client_timeout_stop(eatt_client);
+    }
+    gatt_client->eatt_clients = NULL;
+    if (gatt_client->eatt_state == GATT_CLIENT_EATT_L2CAP_SETUP){
+        gatt_client_le_enhanced_setup_complete(gatt_client, reason);
+    }
+    gatt_client->eatt_state = GATT_CLIENT_EATT_IDLE;
+}
+
+static void gatt_client_le_enhanced_run(gatt_client_t * gatt_client){
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &gatt_client->eatt_clients);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        gatt_client_t * eatt_client = (gatt_client_t *) btstack_linked_list_iterator_next(&it);
+        if (eatt_client->eatt_state != GATT_CLIENT_EATT_READY) continue;
+        if (is_ready(eatt_client) && (eatt_client->send_confirmation == 0u)) continue;
+        if (l2cap_can_send_packet_now(eatt_client->eatt_cid) == false){
+            l2cap_request_can_send_now_event(eatt_client->eatt_cid);
+            continue;
+        }
+        (void) gatt_client_run_for_gatt_client(eatt_client);
+    }
+}
+
+static uint8_t gatt_client_le_enhanced_setup_l2cap(gatt_client_t * gatt_client){
+    uint8_t num_channels = gatt_client->eatt_num_clients;
+
+    // align buffer to 16-byte boundary for client structs
+    uint8_t * storage_buffer = gatt_client->eatt_storage_buffer;
+    uint16_t bytes_till_alignment = (16u - (((uintptr_t) storage_buffer) & 0x0fu)) & 0x0fu;
+    uint32_t size_for_structs = num_channels * sizeof(gatt_client_t);
+    uint32_t size_per_bearer = (gatt_client->eatt_storage_size - bytes_till_alignment - size_for_structs) / num_channels;
+    uint16_t buffer_size = (uint16_t) ((size_per_bearer - GATT_CLIENT_EATT_RECEIVE_BUFFER_HEADROOM) / 2u);
+
+    // setup clients - use void cast to avoid -Wcast-align warning
+    storage_buffer += bytes_till_alignment;
+    gatt_client_t * eatt_clients = (gatt_client_t *) (void *) storage_buffer;
+    uint8_t * eatt_buffers = &storage_buffer[size_for_structs];
+    memset(storage_buffer, 0, size_for_structs);
+
+    uint8_t * receive_buffers[L2CAP_ECBM_MAX_CID_ARRAY_SIZE];
+    uint16_t new_cids[L2CAP_ECBM_MAX_CID_ARRAY_SIZE];
+    uint8_t i;
+    for (i=0;i<num_channels;i++){
+        gatt_client_t * eatt_client = &eatt_clients[i];
+        eatt_client->con_handle = gatt_client->con_handle;
+        eatt_client->mtu = ATT_EATT_MIN_MTU;
+        eatt_client->mtu_state = MTU_EXCHANGED;
+        eatt_client->security_level = gatt_client->security_level;
+        eatt_client->gatt_client_state = P_READY;
+        eatt_client->eatt_state = GATT_CLIENT_EATT_L2CAP_SETUP;
+        uint8_t * bearer_buffers = &eatt_buffers[i * size_per_bearer];
+        eatt_client->eatt_receive_buffer = &bearer_buffers[GATT_CLIENT_EATT_RECEIVE_BUFFER_HEADROOM];
+        eatt_client->eatt_send_buffer    = &bearer_buffers[GATT_CLIENT_EATT_RECEIVE_BUFFER_HEADROOM + buffer_size];
+        receive_buffers[i] = eatt_client->eatt_receive_buffer;
+    }
+
+    gatt_client->eatt_state = GATT_CLIENT_EATT_L2CAP_SETUP;
+    uint8_t status = l2cap_ecbm_create_channels(&gatt_client_le_enhanced_packet_handler, gatt_client->con_handle, LEVEL_2,
+                                                BLUETOOTH_PSM_EATT, num_channels, L2CAP_LE_AUTOMATIC_CREDITS,
+                                                buffer_size, receive_buffers, new_cids);
+    if (status != ERROR_CODE_SUCCESS){
+        return status;
+    }
+
+    for (i=0;i<num_channels;i++){
+        eatt_clients[i].eatt_cid = new_cids[i];
+        btstack_linked_list_add_tail(&gatt_client->eatt_clients, (btstack_linked_item_t *) &eatt_clients[i]);
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+static void gatt_client_le_enhanced_handle_query_complete(gatt_client_t * gatt_client, uint8_t att_status){
+    uint8_t status;
+    switch (gatt_client->eatt_state){
+        case GATT_CLIENT_EATT_READ_SERVER_SUPPORTED_FEATURES:
+            if ((att_status != ATT_ERROR_SUCCESS) || ((gatt_client->eatt_server_supported_features & 1u) == 0u)){
+                gatt_client_le_enhanced_setup_complete(gatt_client, ERROR_CODE_UNSUPPORTED_REMOTE_FEATURE_UNSUPPORTED_LMP_FEATURE);
+                return;
+            }
+            gatt_client->eatt_client_supported_features_handle = 0;
+            gatt_client->eatt_state = GATT_CLIENT_EATT_FIND_CLIENT_SUPPORTED_FEATURES;
+            status = gatt_client_discover_characteristics_for_handle_range_by_uuid16(&gatt_client_le_enhanced_packet_handler,
+                                                                                     gatt_client->con_handle, 0x0001, 0xffff,
+                                                                                     ORG_BLUETOOTH_CHARACTERISTIC_CLIENT_SUPPORTED_FEATURES);
+            break;
+        case GATT_CLIENT_EATT_FIND_CLIENT_SUPPORTED_FEATURES:
+            if (gatt_client->eatt_client_supported_features_handle != 0){
+                // announce Enhanced ATT and Multiple Handle Value Notifications support
+                gatt_client->eatt_client_supported_features = 0x06;
+                gatt_client->eatt_state = GATT_CLIENT_EATT_WRITE_CLIENT_SUPPORTED_FEATURES;
+                status = gatt_client_write_value_of_characteristic(&gatt_client_le_enhanced_packet_handler, gatt_client->con_handle,
+                                                                   gatt_client->eatt_client_supported_features_handle, 1,
+                                                                   &gatt_client->eatt_client_supported_features);
+                break;
+            }
+            status = gatt_client_le_enhanced_setup_l2cap(gatt_client);
+            break;
+        case GATT_CLIENT_EATT_WRITE_CLIENT_SUPPORTED_FEATURES:
+            // server may reject the write if features were set before, try to open bearers anyway
+            status = gatt_client_le_enhanced_setup_l2cap(gatt_client);
+            break;
+        default:
+            return;
+    }
+    if (status != ERROR_CODE_SUCCESS){
+        gatt_client_le_enhanced_setup_complete(gatt_client, status);
+    }
+}
+
+static void gatt_client_le_enhanced_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    gatt_client_t * gatt_client;
+    gatt_client_t * eatt_client;
+    gatt_client_characteristic_t characteristic;
+    switch (packet_type){
+        case HCI_EVENT_PACKET:
+            switch (hci_event_packet_get_type(packet)){
+                // setup: GATT queries on unenhanced bearer
+                case GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT:
+                    gatt_client = gatt_client_get_context_for_handle(gatt_event_characteristic_value_query_result_get_handle(packet));
+                    if (gatt_client == NULL) break;
+                    if (gatt_client->eatt_state != GATT_CLIENT_EATT_READ_SERVER_SUPPORTED_FEATURES) break;
+                    if (gatt_event_characteristic_value_query_result_get_value_length(packet) == 0u) break;
+                    gatt_client->eatt_server_supported_features = gatt_event_characteristic_value_query_result_get_value(packet)[0];
+                    break;
+                case GATT_EVENT_CHARACTERISTIC_QUERY_RESULT:
+                    gatt_client = gatt_client_get_context_for_handle(gatt_event_characteristic_query_result_get_handle(packet));
+                    if (gatt_client == NULL) break;
+                    if (gatt_client->eatt_state != GATT_CLIENT_EATT_FIND_CLIENT_SUPPORTED_FEATURES) break;
+                    gatt_event_characteristic_query_result_get_characteristic(packet, &characteristic);
+                    gatt_client->eatt_client_supported_features_handle = characteristic.value_handle;
+                    break;
+                case GATT_EVENT_QUERY_COMPLETE:
+                    gatt_client = gatt_client_get_context_for_handle(gatt_event_query_complete_get_handle(packet));
+                    if (gatt_client == NULL) break;
+                    gatt_client_le_enhanced_handle_query_complete(gatt_client, gatt_event_query_complete_get_att_status(packet));
+                    break;
+                // L2CAP events for Enhanced ATT bearers
+                case L2CAP_EVENT_ECBM_CHANNEL_OPENED:
+                    gatt_client = gatt_client_le_enhanced_get_context_for_l2cap_cid(l2cap_event_ecbm_channel_opened_get_local_cid(packet), &eatt_client);
+                    if (gatt_client == NULL) break;
+                    gatt_client_le_enhanced_handle_channel_opened(gatt_client, eatt_client, packet);
+                    break;
+                case L2CAP_EVENT_ECBM_RECONFIGURED:
+                    // remote increased its MTU, event contains our local cid
+                    gatt_client = gatt_client_le_enhanced_get_context_for_l2cap_cid(l2cap_event_ecbm_reconfigured_get_remote_cid(packet), &eatt_client);
+                    if (gatt_client == NULL) break;
+                    eatt_client->mtu = btstack_min(eatt_client->eatt_local_mtu, l2cap_event_ecbm_reconfigured_get_mtu(packet));
+                    log_info("EATT bearer 0x%04x reconfigured, mtu %u", eatt_client->eatt_cid, eatt_client->mtu);
+                    break;
+                case L2CAP_EVENT_CHANNEL_CLOSED:
+                    gatt_client = gatt_client_le_enhanced_get_context_for_l2cap_cid(l2cap_event_channel_closed_get_local_cid(packet), &eatt_client);
+                    if (gatt_client == NULL) break;
+                    gatt_client_le_enhanced_handle_channel_closed(gatt_client, eatt_client);
+                    break;
+                case L2CAP_EVENT_CAN_SEND_NOW:
+                    gatt_client_run();
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case L2CAP_DATA_PACKET:
+            gatt_client = gatt_client_le_enhanced_get_context_for_l2cap_cid(channel, &eatt_client);
+            if (gatt_client == NULL) break;
+            gatt_client_handle_att_response(eatt_client, packet, size);
+            gatt_client_run();
+            break;
+        default:
+            break;
+    }
+}
+
+uint8_t gatt_client_le_enhanced_connect(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint8_t num_channels, uint8_t * storage_buffer, uint16_t storage_size){
+    gatt_client_t * gatt_client;
+    uint8_t status = gatt_client_provide_context_for_handle(con_handle, &gatt_client);
+    if (status != ERROR_CODE_SUCCESS){
+        return status;
+    }
+    if (gatt_client->eatt_state != GATT_CLIENT_EATT_IDLE){
+        return ERROR_CODE_COMMAND_DISALLOWED;
+    }
+    if ((num_channels == 0u) || (num_channels > L2CAP_ECBM_MAX_CID_ARRAY_SIZE)){
+        return ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE;
+    }
+
+    // check that storage provides client structs and send + receive buffer for each bearer
+    uint16_t bytes_till_alignment = (16u - (((uintptr_t) storage_buffer) & 0x0fu)) & 0x0fu;
+    uint32_t size_for_bearers = num_channels * (sizeof(gatt_client_t) + GATT_CLIENT_EATT_RECEIVE_BUFFER_HEADROOM + 2u * ATT_EATT_MIN_MTU);
+    if (storage_size < (bytes_till_alignment + size_for_bearers)){
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+
+    gatt_client->eatt_callback = callback;
+    gatt_client->eatt_storage_buffer = storage_buffer;
+    gatt_client->eatt_storage_size = storage_size;
+    gatt_client->eatt_num_clients = num_channels;
+    gatt_client->eatt_server_supported_features = 0;
+
+    // check if server supports Enhanced ATT
+    gatt_client->eatt_state = GATT_CLIENT_EATT_READ_SERVER_SUPPORTED_FEATURES;
+    status = gatt_client_read_value_of_characteristics_by_uuid16(&gatt_client_le_enhanced_packet_handler, con_handle, 0x0001, 0xffff,
+                                                                 ORG_BLUETOOTH_CHARACTERISTIC_SERVER_SUPPORTED_FEATURES);
+    if (status != ERROR_CODE_SUCCESS){
+        gatt_client->eatt_state = GATT_CLIENT_EATT_IDLE;
+    }
+    return status;
+}
+#endif
+
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 void gatt_client_att_packet_handler_fuzz(uint8_t packet_type, uint16_t handle, uint8_t *packet, uint16_t size){
     gatt_client_att_packet_handler(packet_type, handle, packet, size);
@@ -81,6 +81,9 @@ typedef enum {
     P_W2_SEND_READ_MULTIPLE_REQUEST,
     P_W4_READ_MULTIPLE_RESPONSE,
 
+    P_W2_SEND_READ_MULTIPLE_VARIABLE_REQUEST,
+    P_W4_READ_MULTIPLE_VARIABLE_RESPONSE,
+
     P_W2_SEND_WRITE_CHARACTERISTIC_VALUE,
     P_W4_WRITE_CHARACTERISTIC_VALUE_RESULT,
     
@@ -144,8 +147,21 @@ typedef enum{
     MTU_AUTO_EXCHANGE_DISABLED
 } gatt_client_mtu_t;
 
+#ifdef ENABLE_GATT_OVER_EATT
+typedef enum {
+    GATT_CLIENT_EATT_IDLE,
+    GATT_CLIENT_EATT_READ_SERVER_SUPPORTED_FEATURES,
+    GATT_CLIENT_EATT_FIND_CLIENT_SUPPORTED_FEATURES,
+    GATT_CLIENT_EATT_WRITE_CLIENT_SUPPORTED_FEATURES,
+    GATT_CLIENT_EATT_L2CAP_SETUP,
+    GATT_CLIENT_EATT_READY,
+} gatt_client_eatt_state_t;
+#endif
+
 typedef struct gatt_client{
     btstack_linked_item_t    item;
+    // next context in lookup table bucket for con handle
+    struct gatt_client *     next_for_con_handle;
     // TODO: rename gatt_client_state -> state
     gatt_client_state_t gatt_client_state;
 
@@ -170,6 +186,26 @@ typedef struct gatt_client{
     btstack_context_callback_registration_t sdp_query_request;
 #endif
 
+#ifdef ENABLE_GATT_OVER_EATT
+    gatt_client_eatt_state_t eatt_state;
+
+    // unenhanced bearer: setup and list of Enhanced ATT bearers
+    btstack_packet_handler_t eatt_callback;
+    btstack_linked_list_t    eatt_clients;
+    uint8_t *                eatt_storage_buffer;
+    uint16_t                 eatt_storage_size;
+    uint8_t                  eatt_num_clients;
+    uint8_t                  eatt_server_supported_features;
+    uint8_t                  eatt_client_supported_features;
+    uint16_t                 eatt_client_supported_features_handle;
+
+    // Enhanced ATT bearer
+    uint16_t                 eatt_cid;
+    uint16_t                 eatt_local_mtu;
+    uint8_t *                eatt_send_buffer;
+    uint8_t *                eatt_receive_buffer;
+#endif
+
     uint16_t          mtu;
     gatt_client_mtu_t mtu_state;
     
@@ -284,6 +320,22 @@ uint8_t gatt_client_classic_connect(btstack_packet_handler_t callback, bd_addr_t
  */
 uint8_t gatt_client_classic_disconnect(btstack_packet_handler_t callback, hci_con_handle_t con_handle);
 
+/**
+ * @brief Setup Enhanced ATT (EATT) bearers for an existing LE connection. The GATT Client checks the
+ *        Server Supported Features, sets the EATT bit in the Client Supported Features and opens
+ *        L2CAP Enhanced Credit-Based channels. GATT_EVENT_EATT_CONNECTED with status and number of
+ *        bearers is emitted on completion. Afterwards, GATT queries for con_handle are dispatched to
+ *        an idle Enhanced ATT bearer, allowing for multiple outstanding requests.
+ * @note requires ENABLE_GATT_OVER_EATT, the GATT Client must be idle
+ * @param callback
+ * @param con_handle
+ * @param num_channels (max L2CAP_ECBM_MAX_CID_ARRAY_SIZE)
+ * @param storage_buffer for bearer contexts and their send and receive buffers
+ * @param storage_size determines MTU, must provide at least ATT_EATT_MIN_MTU bytes per buffer
+ * @return status
+ */
+uint8_t gatt_client_le_enhanced_connect(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint8_t num_channels, uint8_t * storage_buffer, uint16_t storage_size);
+
 /**
  * @brief MTU is available after the first query has completed. If status is equal to ERROR_CODE_SUCCESS, it returns the real value, 
  * otherwise the default value ATT_DEFAULT_MTU (see bluetooth.h). 
@@ -588,6 +640,21 @@ uint8_t gatt_client_read_long_value_of_characteristic_using_value_handle_with_of
  */
 uint8_t gatt_client_read_multiple_characteristic_values(btstack_packet_handler_t callback, hci_con_handle_t con_handle, int num_value_handles, uint16_t * value_handles);
 
+/*
+ * @brief Read multiple variable-length characteristic values with a single Read Multiple Variable Length Request.
+ * For each value handle, the value is emitted via GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT event,
+ * followed by the GATT_EVENT_QUERY_COMPLETE event, which marks the end of read.
+ * @note values are truncated if the response exceeds the ATT MTU
+ * @param  callback
+ * @param  con_handle
+ * @param  num_value_handles
+ * @param  value_handles list of handles, needs to stay valid until query is complete
+ * @return status BTSTACK_MEMORY_ALLOC_FAILED, if no GATT client for con_handle is found
+ *                GATT_CLIENT_IN_WRONG_STATE , if GATT client is not ready
+ *                ERROR_CODE_SUCCESS         , if query is successfully registered
+ */
+uint8_t gatt_client_read_multiple_variable_characteristic_values(btstack_packet_handler_t callback, hci_con_handle_t con_handle, uint8_t num_value_handles, uint16_t * value_handles);
+
 /** 
  * @brief Writes the characteristic value using the characteristic's value handle without 
  * an acknowledgment that the write was successfully performed.
@@ -93,10 +93,47 @@ typedef struct le_device_db_entry_t {
 #error "NVM_NUM_DEVICE_DB_ENTRIES must not be 0, please update in btstack_config.h"
 #endif
 
+// number of entries kept in RAM
+#ifndef LE_DEVICE_DB_TLV_CACHE_SIZE
+#define LE_DEVICE_DB_TLV_CACHE_SIZE 4
+#endif
+
+// signing counters are written to TLV only every N updates, set to 1 for immediate write
+#ifndef LE_DEVICE_DB_TLV_COUNTER_WRITE_BACK_INTERVAL
+#define LE_DEVICE_DB_TLV_COUNTER_WRITE_BACK_INTERVAL 16
+#endif
+
+#if LE_DEVICE_DB_TLV_CACHE_SIZE == 0
+#error "LE_DEVICE_DB_TLV_CACHE_SIZE must not be 0"
+#endif
+
+#if LE_DEVICE_DB_TLV_COUNTER_WRITE_BACK_INTERVAL == 0
+#error "LE_DEVICE_DB_TLV_COUNTER_WRITE_BACK_INTERVAL must not be 0"
+#endif
+
+// Cached entry, writes of signing counters are deferred
+typedef struct {
+    le_device_db_entry_t entry;
+    int      index;     // -1 if unused
+    uint32_t last_used;
+    bool     dirty;
+#ifdef ENABLE_LE_SIGNED_WRITE
+    // counter values stored in TLV
+    uint32_t remote_counter_stored;
+    uint32_t local_counter_stored;
+#endif
+} le_device_db_tlv_cache_entry_t;
+
 // only stores if entry present
 static uint8_t  entry_map[NVM_NUM_DEVICE_DB_ENTRIES];
 static uint32_t num_valid_entries;
 
+static le_device_db_tlv_cache_entry_t le_device_db_tlv_cache[LE_DEVICE_DB_TLV_CACHE_SIZE];
+static uint32_t le_device_db_tlv_cache_time;
+
+static uint32_t le_device_db_tlv_num_writes;
+static uint32_t le_device_db_tlv_num_writes_saved;
+
 static const btstack_tlv_t * le_device_db_tlv_btstack_tlv_impl;
 static       void *          le_device_db_tlv_btstack_tlv_context;
 
@@ -130,6 +167,7 @@ static bool le_device_db_tlv_store(int index, le_device_db_entry_t * entry){
 
     uint32_t tag = le_device_db_tlv_tag_for_index(index);
     int result = le_device_db_tlv_btstack_tlv_impl->store_tag(le_device_db_tlv_btstack_tlv_context, tag, (uint8_t*) entry, sizeof(le_device_db_entry_t));
+    le_device_db_tlv_num_writes++;
     return result == 0;
 }
 
@@ -144,6 +182,89 @@ static bool le_device_db_tlv_delete(int index){
 	return true;
 }
 
+static void le_device_db_tlv_cache_reset(void){
+    int i;
+    memset(le_device_db_tlv_cache, 0, sizeof(le_device_db_tlv_cache));
+    for (i=0;i<LE_DEVICE_DB_TLV_CACHE_SIZE;i++){
+        le_device_db_tlv_cache[i].index = -1;
+    }
+    le_device_db_tlv_cache_time = 0;
+}
+
+static le_device_db_tlv_cache_entry_t * le_device_db_tlv_cache_lookup(int index){
+    int i;
+    for (i=0;i<LE_DEVICE_DB_TLV_CACHE_SIZE;i++){
+        if (le_device_db_tlv_cache[i].index == index){
+            return &le_device_db_tlv_cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void le_device_db_tlv_cache_mark_stored(le_device_db_tlv_cache_entry_t * cache_entry){
+    cache_entry->dirty = false;
+#ifdef ENABLE_LE_SIGNED_WRITE
+    cache_entry->remote_counter_stored = cache_entry->entry.remote_counter;
+    cache_entry->local_counter_stored  = cache_entry->entry.local_counter;
+#endif
+}
+
+// write entry incl. pending counter updates
+static bool le_device_db_tlv_cache_write(le_device_db_tlv_cache_entry_t * cache_entry){
+#ifdef ENABLE_LE_SIGNED_WRITE
+    // don't lower local counter stored ahead of time, see le_device_db_local_counter_set
+    uint32_t local_counter_stored = btstack_max(cache_entry->entry.local_counter, cache_entry->local_counter_stored);
+    le_device_db_entry_t entry;
+    (void)memcpy(&entry, &cache_entry->entry, sizeof(le_device_db_entry_t));
+    entry.local_counter = local_counter_stored;
+    bool ok = le_device_db_tlv_store(cache_entry->index, &entry);
+    le_device_db_tlv_cache_mark_stored(cache_entry);
+    cache_entry->local_counter_stored = local_counter_stored;
+    return ok;
+#else
+    le_device_db_tlv_cache_mark_stored(cache_entry);
+    return le_device_db_tlv_store(cache_entry->index, &cache_entry->entry);
+#endif
+}
+
+// @return cached entry, loaded from TLV if needed, or NULL if entry does not exist
+static le_device_db_tlv_cache_entry_t * le_device_db_tlv_cache_get(int index){
+    le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_lookup(index);
+    if (cache_entry == NULL){
+        // evict least recently used entry
+        int i;
+        cache_entry = &le_device_db_tlv_cache[0];
+        for (i=0;i<LE_DEVICE_DB_TLV_CACHE_SIZE;i++){
+            if (le_device_db_tlv_cache[i].index < 0){
+                cache_entry = &le_device_db_tlv_cache[i];
+                break;
+            }
+            if (le_device_db_tlv_cache[i].last_used < cache_entry->last_used){
+                cache_entry = &le_device_db_tlv_cache[i];
+            }
+        }
+        if (cache_entry->dirty){
+            le_device_db_tlv_cache_write(cache_entry);
+        }
+        cache_entry->index = -1;
+        if (!le_device_db_tlv_fetch(index, &cache_entry->entry)) return NULL;
+        cache_entry->index = index;
+        le_device_db_tlv_cache_mark_stored(cache_entry);
+    }
+    cache_entry->last_used = ++le_device_db_tlv_cache_time;
+    return cache_entry;
+}
+
+// get entry from cache or TLV without adding it to the cache
+static bool le_device_db_tlv_fetch_cached(int index, le_device_db_entry_t * entry){
+    le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_lookup(index);
+    if (cache_entry != NULL){
+        (void)memcpy(entry, &cache_entry->entry, sizeof(le_device_db_entry_t));
+        return true;
+    }
+    return le_device_db_tlv_fetch(index, entry);
+}
+
 static void le_device_db_tlv_scan(void){
     int i;
     num_valid_entries = 0;
@@ -186,8 +307,13 @@ void le_device_db_remove(int index){
     // check if entry exists
     if (entry_map[index] == 0u) return; 
 
-	// delete entry in TLV
+	// delete entry in TLV, drop pending updates
 	le_device_db_tlv_delete(index);
+    le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_lookup(index);
+    if (cache_entry != NULL){
+        cache_entry->index = -1;
+        cache_entry->dirty = false;
+    }
 
 	// mark as unused
     entry_map[index] = 0;
@@ -210,7 +336,7 @@ int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
     for (i=0;i<NVM_NUM_DEVICE_DB_ENTRIES;i++){
          if (entry_map[i]) {
             le_device_db_entry_t entry;
-            le_device_db_tlv_fetch(i, &entry);
+            le_device_db_tlv_fetch_cached(i, &entry);
             // found addr?
             if ((memcmp(addr, entry.addr, 6) == 0) && (addr_type == entry.addr_type)){
                 index_for_addr = i;
@@ -267,6 +393,13 @@ int le_device_db_add(int addr_type, bd_addr_t addr, sm_key_t irk){
         log_error("tag store failed");
         return -1;
     }
+
+    // update cached entry
+    le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_lookup(index_to_use);
+    if (cache_entry != NULL){
+        (void)memcpy(&cache_entry->entry, &entry, sizeof(le_device_db_entry_t));
+        le_device_db_tlv_cache_mark_stored(cache_entry);
+    }
     // set in entry_mape
     entry_map[index_to_use] = 1;
 
@@ -284,7 +417,7 @@ void le_device_db_info(int index, int * addr_type, bd_addr_t addr, sm_key_t irk)
 
 	// fetch entry
     le_device_db_entry_t entry;
-    int ok = le_device_db_tlv_fetch(index, &entry);
+    int ok = le_device_db_tlv_fetch_cached(index, &entry);
 
     // set defaults if not found
     if (!ok) {
@@ -301,23 +434,23 @@ void le_device_db_info(int index, int * addr_type, bd_addr_t addr, sm_key_t irk)
 void le_device_db_encryption_set(int index, uint16_t ediv, uint8_t rand[8], sm_key_t ltk, int key_size, int authenticated, int authorized, int secure_connection){
 
 	// fetch entry
-	le_device_db_entry_t entry;
-	int ok = le_device_db_tlv_fetch(index, &entry);
-	if (!ok) return;
+	le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_get(index);
+	if (cache_entry == NULL) return;
+	le_device_db_entry_t * entry = &cache_entry->entry;
 
 	// update
     log_info("LE Device DB set encryption for %u, ediv x%04x, key size %u, authenticated %u, authorized %u, secure connection %u",
         index, ediv, key_size, authenticated, authorized, secure_connection);
-    entry.ediv = ediv;
-    if (rand != 0) (void)memcpy(entry.rand, rand, 8);
-    if (ltk != 0) (void)memcpy(entry.ltk, ltk, 16);
-    entry.key_size = key_size;
-    entry.authenticated = authenticated;
-    entry.authorized = authorized;
-    entry.secure_connection = secure_connection;
+    entry->ediv = ediv;
+    if (rand != 0) (void)memcpy(entry->rand, rand, 8);
+    if (ltk != 0) (void)memcpy(entry->ltk, ltk, 16);
+    entry->key_size = key_size;
+    entry->authenticated = authenticated;
+    entry->authorized = authorized;
+    entry->secure_connection = secure_connection;
 
     // store
-    ok = le_device_db_tlv_store(index, &entry);
+    bool ok = le_device_db_tlv_cache_write(cache_entry);
     if (!ok){
         log_error("Set encryption data failed");
     }
@@ -326,20 +459,20 @@ void le_device_db_encryption_set(int index, uint16_t ediv, uint8_t rand[8], sm_k
 void le_device_db_encryption_get(int index, uint16_t * ediv, uint8_t rand[8], sm_key_t ltk, int * key_size, int * authenticated, int * authorized, int * secure_connection){
 
 	// fetch entry
-	le_device_db_entry_t entry;
-	int ok = le_device_db_tlv_fetch(index, &entry);
-	if (!ok) return;
+	le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_get(index);
+	if (cache_entry == NULL) return;
+	const le_device_db_entry_t * entry = &cache_entry->entry;
 
 	// update user fields
     log_info("LE Device DB encryption for %u, ediv x%04x, keysize %u, authenticated %u, authorized %u, secure connection %u",
-        index, entry.ediv, entry.key_size, entry.authenticated, entry.authorized, entry.secure_connection);
-    if (ediv != NULL) *ediv = entry.ediv;
-    if (rand != NULL) (void)memcpy(rand, entry.rand, 8);
-    if (ltk != NULL)  (void)memcpy(ltk, entry.ltk, 16);
-    if (key_size != NULL) *key_size = entry.key_size;
-    if (authenticated != NULL) *authenticated = entry.authenticated;
-    if (authorized != NULL) *authorized = entry.authorized;
-    if (secure_connection != NULL) *secure_connection = entry.secure_connection;
+        index, entry->ediv, entry->key_size, entry->authenticated, entry->authorized, entry->secure_connection);
+    if (ediv != NULL) *ediv = entry->ediv;
+    if (rand != NULL) (void)memcpy(rand, entry->rand, 8);
+    if (ltk != NULL)  (void)memcpy(ltk, entry->ltk, 16);
+    if (key_size != NULL) *key_size = entry->key_size;
+    if (authenticated != NULL) *authenticated = entry->authenticated;
+    if (authorized != NULL) *authorized = entry->authorized;
+    if (secure_connection != NULL) *secure_connection = entry->secure_connection;
 }
 
 #ifdef ENABLE_LE_SIGNED_WRITE
@@ -348,111 +481,131 @@ void le_device_db_encryption_get(int index, uint16_t * ediv, uint8_t rand[8], sm
 void le_device_db_remote_csrk_get(int index, sm_key_t csrk){
 
 	// fetch entry
-	le_device_db_entry_t entry;
-	int ok = le_device_db_tlv_fetch(index, &entry);
-	if (!ok) return;
+	le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_get(index);
+	if (cache_entry == NULL) return;
 
-    if (csrk) (void)memcpy(csrk, entry.remote_csrk, 16);
+    if (csrk) (void)memcpy(csrk, cache_entry->entry.remote_csrk, 16);
 }
 
 void le_device_db_remote_csrk_set(int index, sm_key_t csrk){
 
 	// fetch entry
-	le_device_db_entry_t entry;
-	int ok = le_device_db_tlv_fetch(index, &entry);
-	if (!ok) return;
+	le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_get(index);
+	if (cache_entry == NULL) return;
 
     if (!csrk) return;
 
     // update
-    (void)memcpy(entry.remote_csrk, csrk, 16);
+    (void)memcpy(cache_entry->entry.remote_csrk, csrk, 16);
 
     // store
-    le_device_db_tlv_store(index, &entry);
+    le_device_db_tlv_cache_write(cache_entry);
 }
 
 void le_device_db_local_csrk_get(int index, sm_key_t csrk){
 
 	// fetch entry
-	le_device_db_entry_t entry;
-	int ok = le_device_db_tlv_fetch(index, &entry);
-	if (!ok) return;
+	le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_get(index);
+	if (cache_entry == NULL) return;
 
     if (!csrk) return;
 
     // fill
-    (void)memcpy(csrk, entry.local_csrk, 16);
+    (void)memcpy(csrk, cache_entry->entry.local_csrk, 16);
 }
 
 void le_device_db_local_csrk_set(int index, sm_key_t csrk){
 
 	// fetch entry
-	le_device_db_entry_t entry;
-	int ok = le_device_db_tlv_fetch(index, &entry);
-	if (!ok) return;
+	le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_get(index);
+	if (cache_entry == NULL) return;
 
     if (!csrk) return;
 
     // update
-    (void)memcpy(entry.local_csrk, csrk, 16);
+    (void)memcpy(cache_entry->entry.local_csrk, csrk, 16);
 
     // store
-    le_device_db_tlv_store(index, &entry);
+    le_device_db_tlv_cache_write(cache_entry);
 }
 
 // query last used/seen signing counter
 uint32_t le_device_db_remote_counter_get(int index){
 
 	// fetch entry
-	le_device_db_entry_t entry;
-	int ok = le_device_db_tlv_fetch(index, &entry);
-	if (!ok) return 0;
+	le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_get(index);
+	if (cache_entry == NULL) return 0;
 
-    return entry.remote_counter;
+    return cache_entry->entry.remote_counter;
 }
 
 // update signing counter
 void le_device_db_remote_counter_set(int index, uint32_t counter){
 
 	// fetch entry
-	le_device_db_entry_t entry;
-	int ok = le_device_db_tlv_fetch(index, &entry);
-	if (!ok) return;
+	le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_get(index);
+	if (cache_entry == NULL) return;
 
-    entry.remote_counter = counter;
+    cache_entry->entry.remote_counter = counter;
 
-    // store
-    le_device_db_tlv_store(index, &entry);
+    // store if counter was reset or if stored counter lags behind by a full interval
+    // after a reset, up to LE_DEVICE_DB_TLV_COUNTER_WRITE_BACK_INTERVAL - 1 old signed writes might get accepted
+    if ((counter < cache_entry->remote_counter_stored) ||
+        ((counter - cache_entry->remote_counter_stored) >= LE_DEVICE_DB_TLV_COUNTER_WRITE_BACK_INTERVAL)){
+        le_device_db_tlv_cache_write(cache_entry);
+    } else {
+        cache_entry->dirty = true;
+        le_device_db_tlv_num_writes_saved++;
+    }
 }
 
 // query last used/seen signing counter
 uint32_t le_device_db_local_counter_get(int index){
 
 	// fetch entry
-	le_device_db_entry_t entry;
-	int ok = le_device_db_tlv_fetch(index, &entry);
-	if (!ok) return 0;
+	le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_get(index);
+	if (cache_entry == NULL) return 0;
 
-    return entry.local_counter;
+    return cache_entry->entry.local_counter;
 }
 
 // update signing counter
 void le_device_db_local_counter_set(int index, uint32_t counter){
 
 	// fetch entry
-	le_device_db_entry_t entry;
-	int ok = le_device_db_tlv_fetch(index, &entry);
-	if (!ok) return;
+	le_device_db_tlv_cache_entry_t * cache_entry = le_device_db_tlv_cache_get(index);
+	if (cache_entry == NULL) return;
 
 	// update
-    entry.local_counter = counter;
+    cache_entry->entry.local_counter = counter;
 
-    // store
-    le_device_db_tlv_store(index, &entry);
+    // stored counter is an upper bound for used counters, so they don't get re-used after a reset
+    // if exceeded, store counter + LE_DEVICE_DB_TLV_COUNTER_WRITE_BACK_INTERVAL - 1
+    if (counter > cache_entry->local_counter_stored){
+        cache_entry->local_counter_stored = counter + LE_DEVICE_DB_TLV_COUNTER_WRITE_BACK_INTERVAL - 1u;
+        le_device_db_tlv_cache_write(cache_entry);
+    } else {
+        cache_entry->dirty = true;
+        le_device_db_tlv_num_writes_saved++;
+    }
 }
 
 #endif
 
+void le_device_db_tlv_flush(void){
+    int i;
+    for (i=0;i<LE_DEVICE_DB_TLV_CACHE_SIZE;i++){
+        if (le_device_db_tlv_cache[i].dirty){
+            le_device_db_tlv_cache_write(&le_device_db_tlv_cache[i]);
+        }
+    }
+}
+
+void le_device_db_tlv_get_write_statistics(uint32_t * num_tlv_writes, uint32_t * num_tlv_writes_saved){
+    *num_tlv_writes       = le_device_db_tlv_num_writes;
+    *num_tlv_writes_saved = le_device_db_tlv_num_writes_saved;
+}
+
 void le_device_db_dump(void){
     log_info("LE Device DB dump, devices: %d", le_device_db_count());
     uint32_t i;
@@ -461,7 +614,7 @@ void le_device_db_dump(void){
         if (!entry_map[i]) continue;
 		// fetch entry
 		le_device_db_entry_t entry;
-		le_device_db_tlv_fetch(i, &entry);
+		le_device_db_tlv_fetch_cached(i, &entry);
         log_info("%u: %u %s", (unsigned int) i, entry.addr_type, bd_addr_to_str(entry.addr));
         log_info_key("irk", entry.irk);
 #ifdef ENABLE_LE_SIGNED_WRITE
@@ -474,5 +627,8 @@ void le_device_db_dump(void){
 void le_device_db_tlv_configure(const btstack_tlv_t * btstack_tlv_impl, void * btstack_tlv_context){
 	le_device_db_tlv_btstack_tlv_impl = btstack_tlv_impl;
 	le_device_db_tlv_btstack_tlv_context = btstack_tlv_context;
+    le_device_db_tlv_cache_reset();
+    le_device_db_tlv_num_writes = 0;
+    le_device_db_tlv_num_writes_saved = 0;
     le_device_db_tlv_scan();
 }
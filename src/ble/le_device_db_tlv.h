@@ -60,6 +60,19 @@ extern "C" {
 
 void le_device_db_tlv_configure(const btstack_tlv_t * btstack_tlv_impl, void * btstack_tlv_context);
 
+/**
+ * @brief write pending updates of cached entries to TLV, e.g. before power down
+ * @note Updates of signing counters are written only every LE_DEVICE_DB_TLV_COUNTER_WRITE_BACK_INTERVAL updates
+ */
+void le_device_db_tlv_flush(void);
+
+/**
+ * @brief get number of entries written to TLV and number of writes deferred or avoided by cache
+ * @param num_tlv_writes
+ * @param num_tlv_writes_saved
+ */
+void le_device_db_tlv_get_write_statistics(uint32_t * num_tlv_writes, uint32_t * num_tlv_writes_saved);
+
 /* API_END */
 
 #if defined __cplusplus
@@ -87,6 +87,11 @@
 #define USE_CMAC_ENGINE
 #endif
 
+// number of connections that can run a security procedure (pairing, re-encryption) at the same time
+#ifndef MAX_NR_SM_SETUP_CONTEXTS
+#define MAX_NR_SM_SETUP_CONTEXTS 1
+#endif
+
 
 #define BTSTACK_TAG32(A,B,C,D) (((A) << 24) | ((B) << 16) | ((C) << 8) | (D))
 
@@ -248,7 +253,6 @@ static uint8_t         sm_cmac_signed_write_sign_counter[4];
 // CMAC for Secure Connection functions
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
 static sm_connection_t * sm_cmac_connection;
-static uint8_t           sm_cmac_sc_buffer[80];
 #endif
 
 // resolvable private address lookup / CSRK calculation
@@ -259,18 +263,17 @@ static void *    sm_address_resolution_context;
 static address_resolution_mode_t sm_address_resolution_mode;
 static btstack_linked_list_t sm_address_resolution_general_queue;
 
-// aes128 crypto engine.
+// aes128 crypto engine. used for address resolution, key derivation and random address updates
 static sm_aes128_state_t  sm_aes128_state;
 
-// crypto 
+// crypto, connection specific requests are part of the setup context
 static btstack_crypto_random_t   sm_crypto_random_request;
 static btstack_crypto_aes128_t   sm_crypto_aes128_request;
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
 static btstack_crypto_ecc_p256_t sm_crypto_ecc_p256_request;
 #endif
 
-// temp storage for random data
-static uint8_t sm_random_data[8];
+// temp storage for aes128 operations
 static uint8_t sm_aes128_key[16];
 static uint8_t sm_aes128_plaintext[16];
 static uint8_t sm_aes128_ciphertext[16];
@@ -303,8 +306,25 @@ static uint8_t ec_q[64];
 // data needed for security setup
 typedef struct sm_setup_context {
 
+    // connection that uses this context, HCI_CON_HANDLE_INVALID if free
+    hci_con_handle_t sm_con_handle;
+
     btstack_timer_source_t sm_timeout;
 
+    // crypto requests for this connection, interleaved with other connections by btstack_crypto
+    sm_aes128_state_t         sm_aes128_state;
+    btstack_crypto_random_t   sm_crypto_random_request;
+    bool                      sm_crypto_random_active;
+    btstack_crypto_aes128_t   sm_crypto_aes128_request;
+    uint8_t                   sm_random_data[8];
+    uint8_t                   sm_aes128_plaintext[16];
+    uint8_t                   sm_aes128_ciphertext[16];
+#ifdef ENABLE_LE_SECURE_CONNECTIONS
+    btstack_crypto_ecc_p256_t sm_crypto_ecc_p256_request;
+    bool                      sm_crypto_ecc_p256_active;
+    uint8_t                   sm_cmac_sc_buffer[80];
+#endif
+
     // user response, (Phase 1 and/or 2)
     uint8_t   sm_user_response;
     uint8_t   sm_keypress_notification; // bitmap: passkey started, digit entered, digit erased, passkey cleared, passkey complete, 3 bit count
@@ -380,12 +400,20 @@ typedef struct sm_setup_context {
 #endif
 } sm_setup_context_t;
 
-//
-static sm_setup_context_t the_setup;
-static sm_setup_context_t * setup = &the_setup;
+// setup contexts - each is used by one connection at a time
+static sm_setup_context_t sm_setup_contexts[MAX_NR_SM_SETUP_CONTEXTS];
+
+// selected context - the one of the connection that is currently handled
+static sm_setup_context_t * setup = &sm_setup_contexts[0];
+
+// round robin over contexts in sm_run and count of released contexts to detect changes
+static uint8_t  sm_setup_context_next;
+static uint16_t sm_setup_contexts_released;
 
-// active connection - the one for which the_setup is used for
-static uint16_t sm_active_connection_handle = HCI_CON_HANDLE_INVALID;
+#ifdef ENABLE_LE_SECURE_CONNECTIONS
+// new ec key gets generated after pairing as soon as no other setup context uses it
+static bool sm_ec_key_renewal_pending;
+#endif
 
 // @return 1 if oob data is available
 // stores oob data in provided 16 byte buffer if not null
@@ -498,6 +526,60 @@ static void sm_trigger_run(void){
 	btstack_run_loop_add_timer(&sm_run_timer);
 }
 
+// Setup contexts
+static sm_setup_context_t * sm_setup_context_for_handle(hci_con_handle_t con_handle){
+    if (con_handle == HCI_CON_HANDLE_INVALID) return NULL;
+    uint8_t i;
+    for (i = 0; i < MAX_NR_SM_SETUP_CONTEXTS; i++){
+        if (sm_setup_contexts[i].sm_con_handle == con_handle){
+            return &sm_setup_contexts[i];
+        }
+    }
+    return NULL;
+}
+
+static sm_setup_context_t * sm_setup_context_get_free(void){
+    uint8_t i;
+    for (i = 0; i < MAX_NR_SM_SETUP_CONTEXTS; i++){
+        sm_setup_context_t * context = &sm_setup_contexts[i];
+        // context can only be re-used after outstanding crypto operations completed
+        if (context->sm_con_handle != HCI_CON_HANDLE_INVALID) continue;
+        if (context->sm_aes128_state != SM_AES128_IDLE) continue;
+        if (context->sm_crypto_random_active) continue;
+#ifdef ENABLE_LE_SECURE_CONNECTIONS
+        if (context->sm_crypto_ecc_p256_active) continue;
+#endif
+        return context;
+    }
+    return NULL;
+}
+
+// select setup context of given connection, returns false if it does not use one
+static bool sm_setup_select(hci_con_handle_t con_handle){
+    sm_setup_context_t * context = sm_setup_context_for_handle(con_handle);
+    if (context == NULL) return false;
+    setup = context;
+    return true;
+}
+
+// random request of current setup context, context cannot be re-used until callback was called
+static void sm_setup_random_generate(uint8_t * buffer, uint16_t size, void (* callback)(void * arg)){
+    setup->sm_crypto_random_active = true;
+    btstack_crypto_random_generate(&setup->sm_crypto_random_request, buffer, size, callback, setup);
+}
+
+#ifdef ENABLE_LE_SECURE_CONNECTIONS
+static bool sm_setup_contexts_use_secure_connections(void){
+    uint8_t i;
+    for (i = 0; i < MAX_NR_SM_SETUP_CONTEXTS; i++){
+        if ((sm_setup_contexts[i].sm_con_handle != HCI_CON_HANDLE_INVALID) && sm_setup_contexts[i].sm_use_secure_connections){
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
 // Key utils
 static void sm_reset_tk(void){
     int i;
@@ -671,6 +753,7 @@ static void sm_pairing_complete(sm_connection_t * sm_conn, uint8_t status, uint8
 static void sm_timeout_handler(btstack_timer_source_t * timer){
     log_info("SM timeout");
     sm_connection_t * sm_conn = (sm_connection_t*) btstack_run_loop_get_timer_context(timer);
+    (void) sm_setup_select(sm_conn->sm_handle);
     sm_conn->sm_engine_state = SM_GENERAL_TIMEOUT;
     sm_reencryption_complete(sm_conn, ERROR_CODE_CONNECTION_TIMEOUT);
     sm_pairing_complete(sm_conn, ERROR_CODE_CONNECTION_TIMEOUT, 0);
@@ -971,6 +1054,13 @@ static void sm_cmac_done_trampoline(void * arg){
 int sm_cmac_ready(void){
     return sm_cmac_active == 0u;
 }
+
+// cmac calculation with message provided by callback
+static void sm_cmac_generator_start(const sm_key_t key, uint16_t message_len, uint8_t (*get_byte_callback)(uint16_t offset), void (*done_callback)(uint8_t * hash)){
+    sm_cmac_active = 1;
+    sm_cmac_done_callback = done_callback;
+    btstack_crypto_aes128_cmac_generator(&sm_cmac_request, key, message_len, get_byte_callback, sm_cmac_hash, sm_cmac_done_trampoline, NULL);
+}
 #endif
 
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
@@ -985,12 +1075,6 @@ static void sm_cmac_message_start(const sm_key_t key, uint16_t message_len, cons
 // cmac for ATT Message signing
 #ifdef ENABLE_LE_SIGNED_WRITE
 
-static void sm_cmac_generator_start(const sm_key_t key, uint16_t message_len, uint8_t (*get_byte_callback)(uint16_t offset), void (*done_callback)(uint8_t * hash)){
-    sm_cmac_active = 1;
-    sm_cmac_done_callback = done_callback;
-    btstack_crypto_aes128_cmac_generator(&sm_cmac_request, key, message_len, get_byte_callback, sm_cmac_hash, sm_cmac_done_trampoline, NULL);
-}
-
 static uint8_t sm_cmac_signed_write_message_get_byte(uint16_t offset){
     if (offset >= sm_cmac_signed_write_message_len) {
         log_error("sm_cmac_signed_write_message_get_byte. out of bounds, access %u, len %u", offset, sm_cmac_signed_write_message_len);
@@ -1083,18 +1167,23 @@ static bool sm_key_distribution_all_received(void) {
 }
 
 static void sm_done_for_handle(hci_con_handle_t con_handle){
-    if (sm_active_connection_handle == con_handle){
-        sm_timeout_stop();
-        sm_active_connection_handle = HCI_CON_HANDLE_INVALID;
-        log_info("sm: connection 0x%x released setup context", con_handle);
+    if (sm_setup_select(con_handle) == false) return;
+
+    sm_timeout_stop();
+    setup->sm_con_handle = HCI_CON_HANDLE_INVALID;
+    sm_setup_contexts_released++;
+    log_info("sm: connection 0x%x released setup context", con_handle);
 
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
-        // generate new ec key after each pairing (that used it)
-        if (setup->sm_use_secure_connections){
-            sm_ec_generate_new_key();
-        }
-#endif
+    // generate new ec key after each pairing (that used it), but only if no other pairing still uses it
+    if (setup->sm_use_secure_connections){
+        sm_ec_key_renewal_pending = true;
     }
+    if (sm_ec_key_renewal_pending && (sm_setup_contexts_use_secure_connections() == false)){
+        sm_ec_key_renewal_pending = false;
+        sm_ec_generate_new_key();
+    }
+#endif
 }
 
 static void sm_master_pairing_success(sm_connection_t *connection) {// master -> all done
@@ -1606,7 +1695,7 @@ static void sm_sc_start_calculating_local_confirm(sm_connection_t * sm_conn){
     if (setup->sm_stk_generation_method == OOB){
         sm_conn->sm_engine_state = SM_SC_W2_CMAC_FOR_CONFIRMATION;
     } else {
-        btstack_crypto_random_generate(&sm_crypto_random_request, setup->sm_local_nonce, 16, &sm_handle_random_result_sc_next_w2_cmac_for_confirmation, (void *)(uintptr_t) sm_conn->sm_handle);
+        sm_setup_random_generate(setup->sm_local_nonce, 16, &sm_handle_random_result_sc_next_w2_cmac_for_confirmation);
     }
 }
 
@@ -1616,7 +1705,7 @@ static void sm_sc_state_after_receiving_random(sm_connection_t * sm_conn){
         if (setup->sm_stk_generation_method == OOB){
             // generate Nb
             log_info("Generate Nb");
-            btstack_crypto_random_generate(&sm_crypto_random_request, setup->sm_local_nonce, 16, &sm_handle_random_result_sc_next_send_pairing_random, (void *)(uintptr_t) sm_conn->sm_handle);
+            sm_setup_random_generate(setup->sm_local_nonce, 16, &sm_handle_random_result_sc_next_send_pairing_random);
         } else {
             sm_conn->sm_engine_state = SM_SC_SEND_PAIRING_RANDOM;
         }
@@ -1661,6 +1750,7 @@ static void sm_sc_cmac_done(uint8_t * hash){
 
     sm_connection_t * sm_conn = sm_cmac_connection;
     sm_cmac_connection = NULL;
+    (void) sm_setup_select(sm_conn->sm_handle);
 #ifdef ENABLE_CROSS_TRANSPORT_KEY_DERIVATION
     link_key_type_t link_key_type;
 #endif
@@ -1772,14 +1862,14 @@ static void sm_sc_cmac_done(uint8_t * hash){
 static void f4_engine(sm_connection_t * sm_conn, const sm_key256_t u, const sm_key256_t v, const sm_key_t x, uint8_t z){
     const uint16_t message_len = 65;
     sm_cmac_connection = sm_conn;
-    (void)memcpy(sm_cmac_sc_buffer, u, 32);
-    (void)memcpy(sm_cmac_sc_buffer + 32, v, 32);
-    sm_cmac_sc_buffer[64] = z;
+    (void)memcpy(setup->sm_cmac_sc_buffer, u, 32);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 32, v, 32);
+    setup->sm_cmac_sc_buffer[64] = z;
     log_info("f4 key");
     log_info_hexdump(x, 16);
     log_info("f4 message");
-    log_info_hexdump(sm_cmac_sc_buffer, message_len);
-    sm_cmac_message_start(x, message_len, sm_cmac_sc_buffer, &sm_sc_cmac_done);
+    log_info_hexdump(setup->sm_cmac_sc_buffer, message_len);
+    sm_cmac_message_start(x, message_len, setup->sm_cmac_sc_buffer, &sm_sc_cmac_done);
 }
 
 static const uint8_t f5_key_id[] = { 0x62, 0x74, 0x6c, 0x65 };
@@ -1793,8 +1883,8 @@ static void f5_calculate_salt(sm_connection_t * sm_conn){
     // calculate salt for f5
     const uint16_t message_len = 32;
     sm_cmac_connection = sm_conn;
-    (void)memcpy(sm_cmac_sc_buffer, setup->sm_dhkey, message_len);
-    sm_cmac_message_start(f5_salt, message_len, sm_cmac_sc_buffer, &sm_sc_cmac_done);
+    (void)memcpy(setup->sm_cmac_sc_buffer, setup->sm_dhkey, message_len);
+    sm_cmac_message_start(f5_salt, message_len, setup->sm_cmac_sc_buffer, &sm_sc_cmac_done);
 }
 
 static inline void f5_mackkey(sm_connection_t * sm_conn, sm_key_t t, const sm_key_t n1, const sm_key_t n2, const sm_key56_t a1, const sm_key56_t a2){
@@ -1802,18 +1892,18 @@ static inline void f5_mackkey(sm_connection_t * sm_conn, sm_key_t t, const sm_ke
     sm_cmac_connection = sm_conn;
 
     // f5(W, N1, N2, A1, A2) = AES-CMACT (Counter = 0 || keyID || N1 || N2|| A1|| A2 || Length = 256) -- this is the MacKey
-    sm_cmac_sc_buffer[0] = 0;
-    (void)memcpy(sm_cmac_sc_buffer + 01, f5_key_id, 4);
-    (void)memcpy(sm_cmac_sc_buffer + 05, n1, 16);
-    (void)memcpy(sm_cmac_sc_buffer + 21, n2, 16);
-    (void)memcpy(sm_cmac_sc_buffer + 37, a1, 7);
-    (void)memcpy(sm_cmac_sc_buffer + 44, a2, 7);
-    (void)memcpy(sm_cmac_sc_buffer + 51, f5_length, 2);
+    setup->sm_cmac_sc_buffer[0] = 0;
+    (void)memcpy(setup->sm_cmac_sc_buffer + 01, f5_key_id, 4);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 05, n1, 16);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 21, n2, 16);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 37, a1, 7);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 44, a2, 7);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 51, f5_length, 2);
     log_info("f5 key");
     log_info_hexdump(t, 16);
     log_info("f5 message for MacKey");
-    log_info_hexdump(sm_cmac_sc_buffer, message_len);
-    sm_cmac_message_start(t, message_len, sm_cmac_sc_buffer, &sm_sc_cmac_done);
+    log_info_hexdump(setup->sm_cmac_sc_buffer, message_len);
+    sm_cmac_message_start(t, message_len, setup->sm_cmac_sc_buffer, &sm_sc_cmac_done);
 }
 
 static void f5_calculate_mackey(sm_connection_t * sm_conn){
@@ -1835,13 +1925,13 @@ static void f5_calculate_mackey(sm_connection_t * sm_conn){
 static inline void f5_ltk(sm_connection_t * sm_conn, sm_key_t t){
     const uint16_t message_len = 53;
     sm_cmac_connection = sm_conn;
-    sm_cmac_sc_buffer[0] = 1;
+    setup->sm_cmac_sc_buffer[0] = 1;
     // 1..52 setup before
     log_info("f5 key");
     log_info_hexdump(t, 16);
     log_info("f5 message for LTK");
-    log_info_hexdump(sm_cmac_sc_buffer, message_len);
-    sm_cmac_message_start(t, message_len, sm_cmac_sc_buffer, &sm_sc_cmac_done);
+    log_info_hexdump(setup->sm_cmac_sc_buffer, message_len);
+    sm_cmac_message_start(t, message_len, setup->sm_cmac_sc_buffer, &sm_sc_cmac_done);
 }
 
 static void f5_calculate_ltk(sm_connection_t * sm_conn){
@@ -1849,12 +1939,12 @@ static void f5_calculate_ltk(sm_connection_t * sm_conn){
 }
 
 static void f6_setup(const sm_key_t n1, const sm_key_t n2, const sm_key_t r, const sm_key24_t io_cap, const sm_key56_t a1, const sm_key56_t a2){
-    (void)memcpy(sm_cmac_sc_buffer, n1, 16);
-    (void)memcpy(sm_cmac_sc_buffer + 16, n2, 16);
-    (void)memcpy(sm_cmac_sc_buffer + 32, r, 16);
-    (void)memcpy(sm_cmac_sc_buffer + 48, io_cap, 3);
-    (void)memcpy(sm_cmac_sc_buffer + 51, a1, 7);
-    (void)memcpy(sm_cmac_sc_buffer + 58, a2, 7);
+    (void)memcpy(setup->sm_cmac_sc_buffer, n1, 16);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 16, n2, 16);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 32, r, 16);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 48, io_cap, 3);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 51, a1, 7);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 58, a2, 7);
 }
 
 static void f6_engine(sm_connection_t * sm_conn, const sm_key_t w){
@@ -1863,8 +1953,8 @@ static void f6_engine(sm_connection_t * sm_conn, const sm_key_t w){
     log_info("f6 key");
     log_info_hexdump(w, 16);
     log_info("f6 message");
-    log_info_hexdump(sm_cmac_sc_buffer, message_len);
-    sm_cmac_message_start(w, 65, sm_cmac_sc_buffer, &sm_sc_cmac_done);
+    log_info_hexdump(setup->sm_cmac_sc_buffer, message_len);
+    sm_cmac_message_start(w, 65, setup->sm_cmac_sc_buffer, &sm_sc_cmac_done);
 }
 
 // g2(U, V, X, Y) = AES-CMACX(U || V || Y) mod 2^32
@@ -1875,14 +1965,14 @@ static void f6_engine(sm_connection_t * sm_conn, const sm_key_t w){
 static void g2_engine(sm_connection_t * sm_conn, const sm_key256_t u, const sm_key256_t v, const sm_key_t x, const sm_key_t y){
     const uint16_t message_len = 80;
     sm_cmac_connection = sm_conn;
-    (void)memcpy(sm_cmac_sc_buffer, u, 32);
-    (void)memcpy(sm_cmac_sc_buffer + 32, v, 32);
-    (void)memcpy(sm_cmac_sc_buffer + 64, y, 16);
+    (void)memcpy(setup->sm_cmac_sc_buffer, u, 32);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 32, v, 32);
+    (void)memcpy(setup->sm_cmac_sc_buffer + 64, y, 16);
     log_info("g2 key");
     log_info_hexdump(x, 16);
     log_info("g2 message");
-    log_info_hexdump(sm_cmac_sc_buffer, message_len);
-    sm_cmac_message_start(x, message_len, sm_cmac_sc_buffer, &sm_sc_cmac_done);
+    log_info_hexdump(setup->sm_cmac_sc_buffer, message_len);
+    sm_cmac_message_start(x, message_len, setup->sm_cmac_sc_buffer, &sm_sc_cmac_done);
 }
 
 static void g2_calculate(sm_connection_t * sm_conn) {
@@ -1940,8 +2030,9 @@ static void sm_sc_prepare_dhkey_check(sm_connection_t * sm_conn){
 }
 
 static void sm_sc_dhkey_calculated(void * arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_crypto_ecc_p256_active = false;
+    sm_connection_t * sm_conn = sm_get_connection_for_handle(setup->sm_con_handle);
     if (sm_conn == NULL) return;
 
     log_info("dhkey");
@@ -2018,12 +2109,12 @@ static void sm_sc_calculate_f6_to_verify_dhkey_check(sm_connection_t * sm_conn){
 static void h6_engine(sm_connection_t * sm_conn, const sm_key_t w, const uint32_t key_id){
     const uint16_t message_len = 4;
     sm_cmac_connection = sm_conn;
-    big_endian_store_32(sm_cmac_sc_buffer, 0, key_id);
+    big_endian_store_32(setup->sm_cmac_sc_buffer, 0, key_id);
     log_info("h6 key");
     log_info_hexdump(w, 16);
     log_info("h6 message");
-    log_info_hexdump(sm_cmac_sc_buffer, message_len);
-    sm_cmac_message_start(w, message_len, sm_cmac_sc_buffer, &sm_sc_cmac_done);
+    log_info_hexdump(setup->sm_cmac_sc_buffer, message_len);
+    sm_cmac_message_start(w, message_len, setup->sm_cmac_sc_buffer, &sm_sc_cmac_done);
 }
 //
 // Link Key Conversion Function h7
@@ -2268,13 +2359,21 @@ static bool sm_run_csrk(void){
 }
 
 // SC OOB
+#ifdef ENABLE_LE_SECURE_CONNECTIONS
+// f4(PKx, PKx, r, 0) message for OOB confirm, generated on the fly as the cmac buffers belong to the setup contexts
+static uint8_t sm_sc_oob_confirm_get_byte(uint16_t offset){
+    if (offset >= 64u) return 0;
+    return ec_q[offset & 0x1fu];
+}
+#endif
+
 static bool sm_run_oob(void){
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
     switch (sm_sc_oob_state){
         case SM_SC_OOB_W2_CALC_CONFIRM:
             if (!sm_cmac_ready()) break;
             sm_sc_oob_state = SM_SC_OOB_W4_CONFIRM;
-            f4_engine(NULL, ec_q, ec_q, sm_sc_oob_random, 0);
+            sm_cmac_generator_start(sm_sc_oob_random, 65, &sm_sc_oob_confirm_get_byte, &sm_sc_cmac_done);
             return true;
         default:
             break;
@@ -2298,6 +2397,7 @@ static bool sm_run_basic(void){
 
             // general
             case SM_GENERAL_SEND_PAIRING_FAILED: {
+                (void) sm_setup_select(sm_connection->sm_handle);
                 uint8_t buffer[2];
                 buffer[0] = SM_CODE_PAIRING_FAILED;
                 buffer[1] = sm_connection->sm_pairing_failed_reason;
@@ -2335,13 +2435,16 @@ static bool sm_run_basic(void){
 }
 
 static void sm_run_activate_connection(void){
-    // Find connections that requires setup context and make active if no other is locked
+    // Find connections that requires setup context and lock a free one for them
     btstack_linked_list_iterator_t it;
     hci_connections_get_iterator(&it);
-    while((sm_active_connection_handle == HCI_CON_HANDLE_INVALID) && btstack_linked_list_iterator_has_next(&it)){
+    while(btstack_linked_list_iterator_has_next(&it)){
+        sm_setup_context_t * context = sm_setup_context_get_free();
+        if (context == NULL) return;
+
         hci_connection_t * hci_connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
         sm_connection_t  * sm_connection = &hci_connection->sm_connection;
-        // - if no connection locked and we're ready/waiting for setup context, fetch it and start
+        // - if setup context is available and we're ready/waiting for setup context, fetch it and start
         bool done = true;
         int err;
         UNUSED(err);
@@ -2383,9 +2486,12 @@ static void sm_run_activate_connection(void){
                 done = false;
                 break;
         }
-        if (done){
-            sm_active_connection_handle = sm_connection->sm_handle;
-            log_info("sm: connection 0x%04x locked setup context as %s, state %u", sm_active_connection_handle, sm_connection->sm_role ? "responder" : "initiator", sm_connection->sm_engine_state);
+        // skip connections that already use a setup context
+        if (done && (sm_setup_context_for_handle(sm_connection->sm_handle) == NULL)){
+            context->sm_con_handle = sm_connection->sm_handle;
+            context->sm_use_secure_connections = 0;
+            log_info("sm: connection 0x%04x locked setup context %u as %s, state %u", sm_connection->sm_handle, (unsigned int) (context - sm_setup_contexts),
+                     sm_connection->sm_role ? "responder" : "initiator", sm_connection->sm_engine_state);
         }
     }
 }
@@ -2426,7 +2532,7 @@ static void sm_run_send_keypress_notification(sm_connection_t * connection){
     sm_send_connectionless(connection, (uint8_t*) buffer, sizeof(buffer));
 
     // try
-    l2cap_request_can_send_fix_channel_now_event(sm_active_connection_handle, connection->sm_cid);
+    l2cap_request_can_send_fix_channel_now_event(connection->sm_handle, connection->sm_cid);
 }
 
 static void sm_run_distribute_keys(sm_connection_t * connection){
@@ -2721,65 +2827,67 @@ static bool sm_run_non_connection_logic(void){
     return done;
 }
 
-static void sm_run(void){
-
-    // assert that stack has already bootet
-    if (hci_get_state() != HCI_STATE_WORKING) return;
-
-    // assert that we can send at least commands
-    if (!hci_can_send_command_packet_now()) return;
-
-    // pause until IR/ER are ready
-    if (sm_persistent_keys_random_active) return;
-
-    // non-connection related behaviour
-    bool done = sm_run_non_connection_logic();
-    if (done) return;
+#ifdef ENABLE_LE_SECURE_CONNECTIONS
+static bool sm_run_state_requires_cmac(security_manager_state_t state){
+    switch (state){
+        case SM_SC_W2_CMAC_FOR_CONFIRMATION:
+        case SM_SC_W2_CMAC_FOR_CHECK_CONFIRMATION:
+        case SM_SC_W2_CALCULATE_F6_FOR_DHKEY_CHECK:
+        case SM_SC_W2_CALCULATE_F6_TO_VERIFY_DHKEY_CHECK:
+        case SM_SC_W2_CALCULATE_F5_SALT:
+        case SM_SC_W2_CALCULATE_F5_MACKEY:
+        case SM_SC_W2_CALCULATE_F5_LTK:
+        case SM_SC_W2_CALCULATE_G2:
+#ifdef ENABLE_CROSS_TRANSPORT_KEY_DERIVATION
+        case SM_SC_W2_CALCULATE_ILK_USING_H6:
+        case SM_SC_W2_CALCULATE_BR_EDR_LINK_KEY:
+        case SM_SC_W2_CALCULATE_ILK_USING_H7:
+        case SM_BR_EDR_W2_CALCULATE_ILK_USING_H6:
+        case SM_BR_EDR_W2_CALCULATE_LE_LTK:
+        case SM_BR_EDR_W2_CALCULATE_ILK_USING_H7:
+#endif
+            return true;
+        default:
+            return false;
+    }
+}
+#endif
 
-    // assert that we can send at least commands - cmd might have been sent by crypto engine
-    if (!hci_can_send_command_packet_now()) return;
+// handle connection that uses given setup context
+// @return true if sm_run should stop, e.g. as HCI Command or SM PDU was sent
+static bool sm_run_connection(sm_setup_context_t * context){
 
-    // handle basic actions that don't requires the full context
-    done = sm_run_basic();
-    if (done) return;
+    sm_connection_t * connection = sm_get_connection_for_handle(context->sm_con_handle);
+    if (!connection) {
+        log_info("no connection for handle 0x%04x", context->sm_con_handle);
+        return false;
+    }
 
-    //
-    // active connection handling
-    // -- use loop to handle next connection if lock on setup context is released
+    // -- use loop to handle connection again if next step can be started right away
 
     while (true) {
 
-        sm_run_activate_connection();
-
-        if (sm_active_connection_handle == HCI_CON_HANDLE_INVALID) return;
-
-        //
-        // active connection handling
-        //
-
-        sm_connection_t * connection = sm_get_connection_for_handle(sm_active_connection_handle);
-        if (!connection) {
-            log_info("no connection for handle 0x%04x", sm_active_connection_handle);
-            return;
-        }
+        // stop if lock on setup context was released
+        if (context->sm_con_handle != connection->sm_handle) return false;
+        setup = context;
 
         // assert that we could send a SM PDU - not needed for all of the following
-        if (!l2cap_can_send_fixed_channel_packet_now(sm_active_connection_handle, connection->sm_cid)) {
+        if (!l2cap_can_send_fixed_channel_packet_now(connection->sm_handle, connection->sm_cid)) {
             log_info("cannot send now, requesting can send now event");
-            l2cap_request_can_send_fix_channel_now_event(sm_active_connection_handle, connection->sm_cid);
-            return;
+            l2cap_request_can_send_fix_channel_now_event(connection->sm_handle, connection->sm_cid);
+            return false;
         }
 
         // send keypress notifications
         if (setup->sm_keypress_notification){
             sm_run_send_keypress_notification(connection);
-            return;
+            return true;
         }
 
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
-        // assert that sm cmac engine is ready
-        if (sm_cmac_ready() == false){
-            break;
+        // assert that sm cmac engine is ready, connections that don't need it can continue
+        if (sm_run_state_requires_cmac(connection->sm_engine_state) && (sm_cmac_ready() == false)){
+            return false;
         }
 #endif
 
@@ -2847,7 +2955,7 @@ static void sm_run(void){
 
                 // notify after sending
                 sm_reencryption_started(connection);
-                return;
+                return true;
             }
 
 			case SM_INITIATOR_PH1_W2_SEND_PAIRING_REQUEST:
@@ -2907,7 +3015,7 @@ static void sm_run(void){
 						log_info("LTK Request: ediv & random are empty, but no stored LTK (IRK Lookup Succeeded)");
 						connection->sm_engine_state = SM_RESPONDER_IDLE;
 						hci_send_cmd(&hci_le_long_term_key_negative_reply, connection->sm_handle);
-						return;
+						return true;
 					default:
 						// just wait until IRK lookup is completed
 						break;
@@ -2958,7 +3066,7 @@ static void sm_run(void){
 
 				// generate random number first, if we need to show passkey, otherwise send response
 				if (setup->sm_stk_generation_method == PK_INIT_INPUT){
-					btstack_crypto_random_generate(&sm_crypto_random_request, sm_random_data, 8, &sm_handle_random_result_ph2_tk, (void *)(uintptr_t) connection->sm_handle);
+					sm_setup_random_generate(setup->sm_random_data, 8, &sm_handle_random_result_ph2_tk);
 					break;
 				}
 
@@ -2999,7 +3107,7 @@ static void sm_run(void){
                 if (!setup->sm_use_secure_connections || (setup->sm_stk_generation_method == JUST_WORKS)){
                     sm_trigger_user_response(connection);
                 }
-                return;
+                return true;
 #endif
 
             case SM_PH2_SEND_PAIRING_RANDOM: {
@@ -3018,53 +3126,53 @@ static void sm_run(void){
 
             case SM_PH2_C1_GET_ENC_A:
                 // already busy?
-                if (sm_aes128_state == SM_AES128_ACTIVE) break;
+                if (setup->sm_aes128_state == SM_AES128_ACTIVE) break;
                 // calculate confirm using aes128 engine - step 1
-                sm_c1_t1(setup->sm_local_random, (uint8_t*) &setup->sm_m_preq, (uint8_t*) &setup->sm_s_pres, setup->sm_m_addr_type, setup->sm_s_addr_type, sm_aes128_plaintext);
+                sm_c1_t1(setup->sm_local_random, (uint8_t*) &setup->sm_m_preq, (uint8_t*) &setup->sm_s_pres, setup->sm_m_addr_type, setup->sm_s_addr_type, setup->sm_aes128_plaintext);
                 connection->sm_engine_state = SM_PH2_C1_W4_ENC_A;
-                sm_aes128_state = SM_AES128_ACTIVE;
-                btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, setup->sm_tk, sm_aes128_plaintext, sm_aes128_ciphertext, sm_handle_encryption_result_enc_a, (void *)(uintptr_t) connection->sm_handle);
+                setup->sm_aes128_state = SM_AES128_ACTIVE;
+                btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, setup->sm_tk, setup->sm_aes128_plaintext, setup->sm_aes128_ciphertext, sm_handle_encryption_result_enc_a, setup);
                 break;
 
             case SM_PH2_C1_GET_ENC_C:
                 // already busy?
-                if (sm_aes128_state == SM_AES128_ACTIVE) break;
+                if (setup->sm_aes128_state == SM_AES128_ACTIVE) break;
                 // calculate m_confirm using aes128 engine - step 1
-                sm_c1_t1(setup->sm_peer_random, (uint8_t*) &setup->sm_m_preq, (uint8_t*) &setup->sm_s_pres, setup->sm_m_addr_type, setup->sm_s_addr_type, sm_aes128_plaintext);
+                sm_c1_t1(setup->sm_peer_random, (uint8_t*) &setup->sm_m_preq, (uint8_t*) &setup->sm_s_pres, setup->sm_m_addr_type, setup->sm_s_addr_type, setup->sm_aes128_plaintext);
                 connection->sm_engine_state = SM_PH2_C1_W4_ENC_C;
-                sm_aes128_state = SM_AES128_ACTIVE;
-                btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, setup->sm_tk, sm_aes128_plaintext, sm_aes128_ciphertext, sm_handle_encryption_result_enc_c, (void *)(uintptr_t) connection->sm_handle);
+                setup->sm_aes128_state = SM_AES128_ACTIVE;
+                btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, setup->sm_tk, setup->sm_aes128_plaintext, setup->sm_aes128_ciphertext, sm_handle_encryption_result_enc_c, setup);
                 break;
 
             case SM_PH2_CALC_STK:
                 // already busy?
-                if (sm_aes128_state == SM_AES128_ACTIVE) break;
+                if (setup->sm_aes128_state == SM_AES128_ACTIVE) break;
                 // calculate STK
                 if (IS_RESPONDER(connection->sm_role)){
-                    sm_s1_r_prime(setup->sm_local_random, setup->sm_peer_random, sm_aes128_plaintext);
+                    sm_s1_r_prime(setup->sm_local_random, setup->sm_peer_random, setup->sm_aes128_plaintext);
                 } else {
-                    sm_s1_r_prime(setup->sm_peer_random, setup->sm_local_random, sm_aes128_plaintext);
+                    sm_s1_r_prime(setup->sm_peer_random, setup->sm_local_random, setup->sm_aes128_plaintext);
                 }
                 connection->sm_engine_state = SM_PH2_W4_STK;
-                sm_aes128_state = SM_AES128_ACTIVE;
-                btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, setup->sm_tk, sm_aes128_plaintext, setup->sm_ltk, sm_handle_encryption_result_enc_stk, (void *)(uintptr_t) connection->sm_handle);
+                setup->sm_aes128_state = SM_AES128_ACTIVE;
+                btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, setup->sm_tk, setup->sm_aes128_plaintext, setup->sm_ltk, sm_handle_encryption_result_enc_stk, setup);
                 break;
 
             case SM_PH3_Y_GET_ENC:
                 // already busy?
-                if (sm_aes128_state == SM_AES128_ACTIVE) break;
+                if (setup->sm_aes128_state == SM_AES128_ACTIVE) break;
                 // PH3B2 - calculate Y from      - enc
 
                 // dm helper (was sm_dm_r_prime)
                 // r' = padding || r
                 // r - 64 bit value
-                memset(&sm_aes128_plaintext[0], 0, 8);
-                (void)memcpy(&sm_aes128_plaintext[8], setup->sm_local_rand, 8);
+                memset(&setup->sm_aes128_plaintext[0], 0, 8);
+                (void)memcpy(&setup->sm_aes128_plaintext[8], setup->sm_local_rand, 8);
 
                 // Y = dm(DHK, Rand)
                 connection->sm_engine_state = SM_PH3_Y_W4_ENC;
-                sm_aes128_state = SM_AES128_ACTIVE;
-                btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, sm_persistent_dhk, sm_aes128_plaintext, sm_aes128_ciphertext, sm_handle_encryption_result_enc_ph3_y, (void *)(uintptr_t) connection->sm_handle);
+                setup->sm_aes128_state = SM_AES128_ACTIVE;
+                btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, sm_persistent_dhk, setup->sm_aes128_plaintext, setup->sm_aes128_ciphertext, sm_handle_encryption_result_enc_ph3_y, setup);
                 break;
 
             case SM_PH2_C1_SEND_PAIRING_CONFIRM: {
@@ -3078,7 +3186,7 @@ static void sm_run(void){
                 }
                 sm_send_connectionless(connection, (uint8_t*) buffer, sizeof(buffer));
                 sm_timeout_reset(connection);
-                return;
+                return true;
             }
 #ifdef ENABLE_LE_PERIPHERAL
             case SM_RESPONDER_PH2_SEND_LTK_REPLY: {
@@ -3088,7 +3196,7 @@ static void sm_run(void){
                 reverse_128(setup->sm_ltk, stk_flipped);
                 connection->sm_engine_state = SM_PH2_W4_CONNECTION_ENCRYPTED;
                 hci_send_cmd(&hci_le_long_term_key_request_reply, connection->sm_handle, stk_flipped);
-                return;
+                return true;
             }
             case SM_RESPONDER_PH4_SEND_LTK_REPLY: {
                 // allow to override LTK
@@ -3101,12 +3209,12 @@ static void sm_run(void){
                 reverse_128(setup->sm_ltk, ltk_flipped);
                 connection->sm_engine_state = SM_PH4_W4_CONNECTION_ENCRYPTED;
                 hci_send_cmd(&hci_le_long_term_key_request_reply, connection->sm_handle, ltk_flipped);
-                return;
+                return true;
             }
 
 			case SM_RESPONDER_PH0_RECEIVED_LTK_REQUEST:
                 // already busy?
-                if (sm_aes128_state == SM_AES128_ACTIVE) break;
+                if (setup->sm_aes128_state == SM_AES128_ACTIVE) break;
                 log_info("LTK Request: recalculating with ediv 0x%04x", setup->sm_local_ediv);
 
 				sm_reset_setup();
@@ -3117,14 +3225,14 @@ static void sm_run(void){
                 // dm helper (was sm_dm_r_prime)
                 // r' = padding || r
                 // r - 64 bit value
-                memset(&sm_aes128_plaintext[0], 0, 8);
-                (void)memcpy(&sm_aes128_plaintext[8], setup->sm_local_rand, 8);
+                memset(&setup->sm_aes128_plaintext[0], 0, 8);
+                (void)memcpy(&setup->sm_aes128_plaintext[8], setup->sm_local_rand, 8);
 
                 // Y = dm(DHK, Rand)
                 connection->sm_engine_state = SM_RESPONDER_PH4_Y_W4_ENC;
-                sm_aes128_state = SM_AES128_ACTIVE;
-                btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, sm_persistent_dhk, sm_aes128_plaintext, sm_aes128_ciphertext, sm_handle_encryption_result_enc_ph4_y, (void *)(uintptr_t) connection->sm_handle);
-                return;
+                setup->sm_aes128_state = SM_AES128_ACTIVE;
+                btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, sm_persistent_dhk, setup->sm_aes128_plaintext, setup->sm_aes128_ciphertext, sm_handle_encryption_result_enc_ph4_y, setup);
+                return true;
 #endif
 #ifdef ENABLE_LE_CENTRAL
             case SM_INITIATOR_PH3_SEND_START_ENCRYPTION: {
@@ -3132,7 +3240,7 @@ static void sm_run(void){
                 reverse_128(setup->sm_ltk, stk_flipped);
                 connection->sm_engine_state = SM_PH2_W4_CONNECTION_ENCRYPTED;
                 hci_send_cmd(&hci_le_start_encryption, connection->sm_handle, 0, 0, 0, stk_flipped);
-                return;
+                return true;
             }
 #endif
 
@@ -3144,7 +3252,7 @@ static void sm_run(void){
 
                 // more to send?
                 if (setup->sm_key_distribution_send_set != 0){
-                    return;
+                    return true;
                 }
 
                 // keys are sent
@@ -3242,7 +3350,7 @@ static void sm_run(void){
             case SM_BR_EDR_DISTRIBUTE_KEYS:
                 if (setup->sm_key_distribution_send_set != 0) {
                     sm_run_distribute_keys(connection);
-                    return;
+                    return true;
                 }
                 // keys are sent
                 if (IS_RESPONDER(connection->sm_role)) {
@@ -3285,29 +3393,85 @@ static void sm_run(void){
                 break;
         }
 
-        // check again if active connection was released
-        if (sm_active_connection_handle != HCI_CON_HANDLE_INVALID) break;
+        return false;
+    }
+}
+
+static void sm_run(void){
+
+    // assert that stack has already bootet
+    if (hci_get_state() != HCI_STATE_WORKING) return;
+
+    // assert that we can send at least commands
+    if (!hci_can_send_command_packet_now()) return;
+
+    // pause until IR/ER are ready
+    if (sm_persistent_keys_random_active) return;
+
+    // non-connection related behaviour
+    bool done = sm_run_non_connection_logic();
+    if (done) return;
+
+    // assert that we can send at least commands - cmd might have been sent by crypto engine
+    if (!hci_can_send_command_packet_now()) return;
+
+    // handle basic actions that don't requires the full context
+    done = sm_run_basic();
+    if (done) return;
+
+    //
+    // connection handling
+    // -- use loop to handle next connection if lock on a setup context is released
+
+    while (true) {
+
+        sm_run_activate_connection();
+
+        uint16_t contexts_released = sm_setup_contexts_released;
+
+        // handle connections with setup context round robin, starting after the one that stopped the last run
+        uint8_t i;
+        for (i = 0; i < MAX_NR_SM_SETUP_CONTEXTS; i++){
+            uint8_t index = (uint8_t) ((sm_setup_context_next + i) % MAX_NR_SM_SETUP_CONTEXTS);
+            sm_setup_context_t * context = &sm_setup_contexts[index];
+            if (context->sm_con_handle == HCI_CON_HANDLE_INVALID) continue;
+
+            // assert that we can send at least commands - cmd might have been sent for other connection
+            if (!hci_can_send_command_packet_now()) {
+                sm_setup_context_next = index;
+                return;
+            }
+
+            done = sm_run_connection(context);
+            if (done) {
+                sm_setup_context_next = (uint8_t) ((index + 1u) % MAX_NR_SM_SETUP_CONTEXTS);
+                return;
+            }
+        }
+
+        // check again if a setup context was released
+        if (contexts_released == sm_setup_contexts_released) break;
     }
 }
 
 // sm_aes128_state stays active
 static void sm_handle_encryption_result_enc_a(void *arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_aes128_state = SM_AES128_IDLE;
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_aes128_state = SM_AES128_IDLE;
 
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
-    sm_c1_t3(sm_aes128_ciphertext, setup->sm_m_address, setup->sm_s_address, setup->sm_c1_t3_value);
-    sm_aes128_state = SM_AES128_ACTIVE;
-    btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, setup->sm_tk, setup->sm_c1_t3_value, setup->sm_local_confirm, sm_handle_encryption_result_enc_b, (void *)(uintptr_t) connection->sm_handle);
+    sm_c1_t3(setup->sm_aes128_ciphertext, setup->sm_m_address, setup->sm_s_address, setup->sm_c1_t3_value);
+    setup->sm_aes128_state = SM_AES128_ACTIVE;
+    btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, setup->sm_tk, setup->sm_c1_t3_value, setup->sm_local_confirm, sm_handle_encryption_result_enc_b, setup);
 }
 
 static void sm_handle_encryption_result_enc_b(void *arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_aes128_state = SM_AES128_IDLE;
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_aes128_state = SM_AES128_IDLE;
 
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
     log_info_key("c1!", setup->sm_local_confirm);
@@ -3317,26 +3481,26 @@ static void sm_handle_encryption_result_enc_b(void *arg){
 
 // sm_aes128_state stays active
 static void sm_handle_encryption_result_enc_c(void *arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_aes128_state = SM_AES128_IDLE;
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_aes128_state = SM_AES128_IDLE;
 
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
-    sm_c1_t3(sm_aes128_ciphertext, setup->sm_m_address, setup->sm_s_address, setup->sm_c1_t3_value);
-    sm_aes128_state = SM_AES128_ACTIVE;
-    btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, setup->sm_tk, setup->sm_c1_t3_value, sm_aes128_ciphertext, sm_handle_encryption_result_enc_d, (void *)(uintptr_t) connection->sm_handle);
+    sm_c1_t3(setup->sm_aes128_ciphertext, setup->sm_m_address, setup->sm_s_address, setup->sm_c1_t3_value);
+    setup->sm_aes128_state = SM_AES128_ACTIVE;
+    btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, setup->sm_tk, setup->sm_c1_t3_value, setup->sm_aes128_ciphertext, sm_handle_encryption_result_enc_d, setup);
 }
 
 static void sm_handle_encryption_result_enc_d(void * arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_aes128_state = SM_AES128_IDLE;
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_aes128_state = SM_AES128_IDLE;
 
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
-    log_info_key("c1!", sm_aes128_ciphertext);
-    if (memcmp(setup->sm_peer_confirm, sm_aes128_ciphertext, 16) != 0){
+    log_info_key("c1!", setup->sm_aes128_ciphertext);
+    if (memcmp(setup->sm_peer_confirm, setup->sm_aes128_ciphertext, 16) != 0){
         sm_pairing_error(connection, SM_REASON_CONFIRM_VALUE_FAILED);
         sm_trigger_run();
         return;
@@ -3345,17 +3509,17 @@ static void sm_handle_encryption_result_enc_d(void * arg){
         connection->sm_engine_state = SM_PH2_SEND_PAIRING_RANDOM;
         sm_trigger_run();
     } else {
-        sm_s1_r_prime(setup->sm_peer_random, setup->sm_local_random, sm_aes128_plaintext);
-        sm_aes128_state = SM_AES128_ACTIVE;
-        btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, setup->sm_tk, sm_aes128_plaintext, setup->sm_ltk, sm_handle_encryption_result_enc_stk, (void *)(uintptr_t) connection->sm_handle);
+        sm_s1_r_prime(setup->sm_peer_random, setup->sm_local_random, setup->sm_aes128_plaintext);
+        setup->sm_aes128_state = SM_AES128_ACTIVE;
+        btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, setup->sm_tk, setup->sm_aes128_plaintext, setup->sm_ltk, sm_handle_encryption_result_enc_stk, setup);
     }
 }
 
 static void sm_handle_encryption_result_enc_stk(void *arg){
-    sm_aes128_state = SM_AES128_IDLE;
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_aes128_state = SM_AES128_IDLE;
 
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
     sm_truncate_key(setup->sm_ltk, connection->sm_actual_encryption_key_size);
@@ -3370,34 +3534,34 @@ static void sm_handle_encryption_result_enc_stk(void *arg){
 
 // sm_aes128_state stays active
 static void sm_handle_encryption_result_enc_ph3_y(void *arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_aes128_state = SM_AES128_IDLE;
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_aes128_state = SM_AES128_IDLE;
 
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
-    setup->sm_local_y = big_endian_read_16(sm_aes128_ciphertext, 14);
+    setup->sm_local_y = big_endian_read_16(setup->sm_aes128_ciphertext, 14);
     log_info_hex16("y", setup->sm_local_y);
     // PH3B3 - calculate EDIV
     setup->sm_local_ediv = setup->sm_local_y ^ setup->sm_local_div;
     log_info_hex16("ediv", setup->sm_local_ediv);
     // PH3B4 - calculate LTK         - enc
     // LTK = d1(ER, DIV, 0))
-    sm_d1_d_prime(setup->sm_local_div, 0, sm_aes128_plaintext);
-    sm_aes128_state = SM_AES128_ACTIVE;
-    btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, sm_persistent_er, sm_aes128_plaintext, setup->sm_ltk, sm_handle_encryption_result_enc_ph3_ltk, (void *)(uintptr_t) connection->sm_handle);
+    sm_d1_d_prime(setup->sm_local_div, 0, setup->sm_aes128_plaintext);
+    setup->sm_aes128_state = SM_AES128_ACTIVE;
+    btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, sm_persistent_er, setup->sm_aes128_plaintext, setup->sm_ltk, sm_handle_encryption_result_enc_ph3_ltk, setup);
 }
 
 #ifdef ENABLE_LE_PERIPHERAL
 // sm_aes128_state stays active
 static void sm_handle_encryption_result_enc_ph4_y(void *arg){
-    sm_aes128_state = SM_AES128_IDLE;
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_aes128_state = SM_AES128_IDLE;
 
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
-    setup->sm_local_y = big_endian_read_16(sm_aes128_ciphertext, 14);
+    setup->sm_local_y = big_endian_read_16(setup->sm_aes128_ciphertext, 14);
     log_info_hex16("y", setup->sm_local_y);
 
     // PH3B3 - calculate DIV
@@ -3405,35 +3569,35 @@ static void sm_handle_encryption_result_enc_ph4_y(void *arg){
     log_info_hex16("ediv", setup->sm_local_ediv);
     // PH3B4 - calculate LTK         - enc
     // LTK = d1(ER, DIV, 0))
-    sm_d1_d_prime(setup->sm_local_div, 0, sm_aes128_plaintext);
-    sm_aes128_state = SM_AES128_ACTIVE;
-    btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, sm_persistent_er, sm_aes128_plaintext, setup->sm_ltk, sm_handle_encryption_result_enc_ph4_ltk, (void *)(uintptr_t) connection->sm_handle);
+    sm_d1_d_prime(setup->sm_local_div, 0, setup->sm_aes128_plaintext);
+    setup->sm_aes128_state = SM_AES128_ACTIVE;
+    btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, sm_persistent_er, setup->sm_aes128_plaintext, setup->sm_ltk, sm_handle_encryption_result_enc_ph4_ltk, setup);
 }
 #endif
 
 // sm_aes128_state stays active
 static void sm_handle_encryption_result_enc_ph3_ltk(void *arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_aes128_state = SM_AES128_IDLE;
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_aes128_state = SM_AES128_IDLE;
 
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
     log_info_key("ltk", setup->sm_ltk);
     // calc CSRK next
-    sm_d1_d_prime(setup->sm_local_div, 1, sm_aes128_plaintext);
-    sm_aes128_state = SM_AES128_ACTIVE;
-    btstack_crypto_aes128_encrypt(&sm_crypto_aes128_request, sm_persistent_er, sm_aes128_plaintext, setup->sm_local_csrk, sm_handle_encryption_result_enc_csrk, (void *)(uintptr_t) connection->sm_handle);
+    sm_d1_d_prime(setup->sm_local_div, 1, setup->sm_aes128_plaintext);
+    setup->sm_aes128_state = SM_AES128_ACTIVE;
+    btstack_crypto_aes128_encrypt(&setup->sm_crypto_aes128_request, sm_persistent_er, setup->sm_aes128_plaintext, setup->sm_local_csrk, sm_handle_encryption_result_enc_csrk, setup);
 }
 
 static void sm_handle_encryption_result_enc_csrk(void *arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_aes128_state = SM_AES128_IDLE;
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_aes128_state = SM_AES128_IDLE;
 
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
-    sm_aes128_state = SM_AES128_IDLE;
+    setup->sm_aes128_state = SM_AES128_IDLE;
     log_info_key("csrk", setup->sm_local_csrk);
     if (setup->sm_key_distribution_send_set){
         connection->sm_engine_state = SM_PH3_DISTRIBUTE_KEYS;
@@ -3456,10 +3620,10 @@ static void sm_handle_encryption_result_enc_csrk(void *arg){
 
 #ifdef ENABLE_LE_PERIPHERAL
 static void sm_handle_encryption_result_enc_ph4_ltk(void *arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_aes128_state = SM_AES128_IDLE;
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_aes128_state = SM_AES128_IDLE;
 
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
     sm_truncate_key(setup->sm_ltk, connection->sm_actual_encryption_key_size);
@@ -3539,8 +3703,9 @@ static void sm_handle_random_result_rau(void * arg){
 
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
 static void sm_handle_random_result_sc_next_send_pairing_random(void * arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_crypto_random_active = false;
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
     connection->sm_engine_state = SM_SC_SEND_PAIRING_RANDOM;
@@ -3548,8 +3713,9 @@ static void sm_handle_random_result_sc_next_send_pairing_random(void * arg){
 }
 
 static void sm_handle_random_result_sc_next_w2_cmac_for_confirmation(void * arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_crypto_random_active = false;
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
     connection->sm_engine_state = SM_SC_W2_CMAC_FOR_CONFIRMATION;
@@ -3558,8 +3724,9 @@ static void sm_handle_random_result_sc_next_w2_cmac_for_confirmation(void * arg)
 #endif
 
 static void sm_handle_random_result_ph2_random(void * arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_crypto_random_active = false;
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
     connection->sm_engine_state = SM_PH2_C1_GET_ENC_A;
@@ -3567,15 +3734,16 @@ static void sm_handle_random_result_ph2_random(void * arg){
 }
 
 static void sm_handle_random_result_ph2_tk(void * arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_crypto_random_active = false;
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
     sm_reset_tk();
     uint32_t tk;
     if (sm_fixed_passkey_in_display_role == 0xffffffffU){
         // map random to 0-999999 without speding much cycles on a modulus operation
-        tk = little_endian_read_32(sm_random_data,0);
+        tk = little_endian_read_32(setup->sm_random_data,0);
         tk = tk & 0xfffff;  // 1048575
         if (tk >= 999999u){
             tk = tk - 999999u;
@@ -3595,7 +3763,7 @@ static void sm_handle_random_result_ph2_tk(void * arg){
             sm_trigger_user_response(connection);
             // response_idle == nothing <--> sm_trigger_user_response() did not require response
             if (setup->sm_user_response == SM_USER_RESPONSE_IDLE){
-                btstack_crypto_random_generate(&sm_crypto_random_request, setup->sm_local_random, 16, &sm_handle_random_result_ph2_random, (void *)(uintptr_t) connection->sm_handle);
+                sm_setup_random_generate(setup->sm_local_random, 16, &sm_handle_random_result_ph2_random);
             }
         }
     }   
@@ -3603,28 +3771,30 @@ static void sm_handle_random_result_ph2_tk(void * arg){
 }
 
 static void sm_handle_random_result_ph3_div(void * arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_crypto_random_active = false;
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
     // use 16 bit from random value as div
-    setup->sm_local_div = big_endian_read_16(sm_random_data, 0);
+    setup->sm_local_div = big_endian_read_16(setup->sm_random_data, 0);
     log_info_hex16("div", setup->sm_local_div);
     connection->sm_engine_state = SM_PH3_Y_GET_ENC;
     sm_trigger_run();
 }
 
 static void sm_handle_random_result_ph3_random(void * arg){
-    hci_con_handle_t con_handle = (hci_con_handle_t) (uintptr_t) arg;
-    sm_connection_t * connection = sm_get_connection_for_handle(con_handle);
+    setup = (sm_setup_context_t *) arg;
+    setup->sm_crypto_random_active = false;
+    sm_connection_t * connection = sm_get_connection_for_handle(setup->sm_con_handle);
     if (connection == NULL) return;
 
-    reverse_64(sm_random_data, setup->sm_local_rand);
+    reverse_64(setup->sm_random_data, setup->sm_local_rand);
     // no db for encryption size hack: encryption size is stored in lowest nibble of setup->sm_local_rand
     setup->sm_local_rand[7u] = (setup->sm_local_rand[7u] & 0xf0u) + (connection->sm_actual_encryption_key_size - 1u);
     // no db for authenticated flag hack: store flag in bit 4 of LSB
     setup->sm_local_rand[7u] = (setup->sm_local_rand[7u] & 0xefu) + (connection->sm_connection_authenticated << 4u);
-    btstack_crypto_random_generate(&sm_crypto_random_request, sm_random_data, 2, &sm_handle_random_result_ph3_div, (void *)(uintptr_t) connection->sm_handle);
+    sm_setup_random_generate(setup->sm_random_data, 2, &sm_handle_random_result_ph3_div);
 }
 static void sm_validate_er_ir(void){
     // warn about default ER/IR
@@ -3906,6 +4076,7 @@ static void sm_event_packet_handler (uint8_t packet_type, uint16_t channel, uint
                 	con_handle = hci_event_encryption_change_get_connection_handle(packet);
                     sm_conn = sm_get_connection_for_handle(con_handle);
                     if (!sm_conn) break;
+                    (void) sm_setup_select(con_handle);
 
                     sm_conn->sm_connection_encrypted = hci_event_encryption_change_get_encryption_enabled(packet);
                     log_info("Encryption state change: %u, key size %u", sm_conn->sm_connection_encrypted,
@@ -3950,14 +4121,14 @@ static void sm_event_packet_handler (uint8_t packet_type, uint16_t channel, uint
                                 if (setup->sm_use_secure_connections){
                                     sm_conn->sm_engine_state = SM_PH3_DISTRIBUTE_KEYS;
                                 } else {
-                                    btstack_crypto_random_generate(&sm_crypto_random_request, sm_random_data, 8, &sm_handle_random_result_ph3_random, (void *)(uintptr_t) sm_conn->sm_handle);
+                                    sm_setup_random_generate(setup->sm_random_data, 8, &sm_handle_random_result_ph3_random);
                                 }
                             } else {
                                 // master
                                 if (sm_key_distribution_all_received()){
                                     // skip receiving keys as there are none
                                     sm_key_distribution_handle_all_received(sm_conn);
-                                    btstack_crypto_random_generate(&sm_crypto_random_request, sm_random_data, 8, &sm_handle_random_result_ph3_random, (void *)(uintptr_t) sm_conn->sm_handle);
+                                    sm_setup_random_generate(setup->sm_random_data, 8, &sm_handle_random_result_ph3_random);
                                 } else {
                                     sm_conn->sm_engine_state = SM_PH3_RECEIVE_KEYS;
                                 }
@@ -4001,6 +4172,7 @@ static void sm_event_packet_handler (uint8_t packet_type, uint16_t channel, uint
                     con_handle = little_endian_read_16(packet, 3);
                     sm_conn = sm_get_connection_for_handle(con_handle);
                     if (!sm_conn) break;
+                    (void) sm_setup_select(con_handle);
 
                     log_info("Encryption key refresh complete, key size %u", sm_conn->sm_actual_encryption_key_size);
                     log_info("event handler, state %u", sm_conn->sm_engine_state);
@@ -4017,7 +4189,7 @@ static void sm_event_packet_handler (uint8_t packet_type, uint16_t channel, uint
                         case SM_PH2_W4_CONNECTION_ENCRYPTED:
                             if (IS_RESPONDER(sm_conn->sm_role)){
                                 // slave
-                                btstack_crypto_random_generate(&sm_crypto_random_request, sm_random_data, 8, &sm_handle_random_result_ph3_random, (void *)(uintptr_t) sm_conn->sm_handle);
+                                sm_setup_random_generate(setup->sm_random_data, 8, &sm_handle_random_result_ph3_random);
                             } else {
                                 // master
                                 sm_conn->sm_engine_state = SM_PH3_RECEIVE_KEYS;
@@ -4236,6 +4408,9 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
     sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
     if (!sm_conn) return;
 
+    // use setup context of this connection
+    bool setup_selected = sm_setup_select(con_handle);
+
     if (sm_pdu_code == SM_CODE_PAIRING_FAILED){
         sm_reencryption_complete(sm_conn, ERROR_CODE_AUTHENTICATION_FAILURE);
         sm_pairing_complete(sm_conn, ERROR_CODE_AUTHENTICATION_FAILURE, packet[1]);
@@ -4258,7 +4433,22 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
         sm_dispatch_event(HCI_EVENT_PACKET, 0, buffer, sizeof(buffer));
         return;
     }
-    
+
+    // only idle states can handle pdus without setup context, drop pdu otherwise
+    if (setup_selected == false){
+        switch (sm_conn->sm_engine_state){
+            case SM_GENERAL_TIMEOUT:
+            case SM_INITIATOR_CONNECTED:
+            case SM_RESPONDER_IDLE:
+            case SM_RESPONDER_SEND_SECURITY_REQUEST:
+            case SM_RESPONDER_PH1_W4_PAIRING_REQUEST:
+                break;
+            default:
+                log_error("sm_pdu_handler: no setup context for state %u, drop pdu 0x%02x", sm_conn->sm_engine_state, sm_pdu_code);
+                return;
+        }
+    }
+
     switch (sm_conn->sm_engine_state){
 
         // a sm timeout requires a new physical connection
@@ -4310,7 +4500,7 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
 
             // generate random number first, if we need to show passkey
             if (setup->sm_stk_generation_method == PK_RESP_INPUT){
-                btstack_crypto_random_generate(&sm_crypto_random_request, sm_random_data, 8, &sm_handle_random_result_ph2_tk,  (void *)(uintptr_t) sm_conn->sm_handle);
+                sm_setup_random_generate(setup->sm_random_data, 8, &sm_handle_random_result_ph2_tk);
                 break;
             }
 
@@ -4333,7 +4523,7 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
             sm_trigger_user_response(sm_conn);
             // response_idle == nothing <--> sm_trigger_user_response() did not require response
             if (setup->sm_user_response == SM_USER_RESPONSE_IDLE){
-                btstack_crypto_random_generate(&sm_crypto_random_request, setup->sm_local_random, 16, &sm_handle_random_result_ph2_random, (void *)(uintptr_t) sm_conn->sm_handle);
+                sm_setup_random_generate(setup->sm_local_random, 16, &sm_handle_random_result_ph2_random);
             }
             break;
 
@@ -4433,7 +4623,8 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
             }
 
             // start calculating dhkey
-            btstack_crypto_ecc_p256_calculate_dhkey(&sm_crypto_ecc_p256_request, setup->sm_peer_q, setup->sm_dhkey, sm_sc_dhkey_calculated, (void*)(uintptr_t) sm_conn->sm_handle);
+            setup->sm_crypto_ecc_p256_active = true;
+            btstack_crypto_ecc_p256_calculate_dhkey(&setup->sm_crypto_ecc_p256_request, setup->sm_peer_q, setup->sm_dhkey, sm_sc_dhkey_calculated, setup);
 
 
             log_info("public key received, generation method %u", setup->sm_stk_generation_method);
@@ -4463,7 +4654,7 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
                     case OOB:
                         // generate Nx
                         log_info("Generate Na");
-                        btstack_crypto_random_generate(&sm_crypto_random_request, setup->sm_local_nonce, 16, &sm_handle_random_result_sc_next_send_pairing_random, (void*)(uintptr_t) sm_conn->sm_handle);
+                        sm_setup_random_generate(setup->sm_local_nonce, 16, &sm_handle_random_result_sc_next_send_pairing_random);
                         break;
                     default:
                         btstack_assert(false);
@@ -4499,7 +4690,7 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
             } else {
                 // initiator
                 if (sm_just_works_or_numeric_comparison(setup->sm_stk_generation_method)){
-                    btstack_crypto_random_generate(&sm_crypto_random_request, setup->sm_local_nonce, 16, &sm_handle_random_result_sc_next_send_pairing_random, (void*)(uintptr_t) sm_conn->sm_handle);
+                    sm_setup_random_generate(setup->sm_local_nonce, 16, &sm_handle_random_result_sc_next_send_pairing_random);
                 } else {
                     sm_conn->sm_engine_state = SM_SC_SEND_PAIRING_RANDOM;
                 }
@@ -4624,7 +4815,7 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
             }
 
             // calculate and send local_confirm
-            btstack_crypto_random_generate(&sm_crypto_random_request, setup->sm_local_random, 16, &sm_handle_random_result_ph2_random, (void *)(uintptr_t) sm_conn->sm_handle);
+            sm_setup_random_generate(setup->sm_local_random, 16, &sm_handle_random_result_ph2_random);
             break;
 
         case SM_RESPONDER_PH2_W4_PAIRING_RANDOM:
@@ -4684,7 +4875,7 @@ static void sm_pdu_handler(uint8_t packet_type, hci_con_handle_t con_handle, uin
                     if (setup->sm_use_secure_connections){
                         sm_conn->sm_engine_state = SM_PH3_DISTRIBUTE_KEYS;
                     } else {
-                        btstack_crypto_random_generate(&sm_crypto_random_request, sm_random_data, 8, &sm_handle_random_result_ph3_random, (void *)(uintptr_t) sm_conn->sm_handle);
+                        sm_setup_random_generate(setup->sm_random_data, 8, &sm_handle_random_result_ph3_random);
                     }
                 }
             }
@@ -4892,10 +5083,20 @@ static void sm_state_reset(void) {
     sm_address_resolution_test = -1;    // no private address to resolve yet
     sm_address_resolution_mode = ADDRESS_RESOLUTION_IDLE;
     sm_address_resolution_general_queue = NULL;
-    sm_active_connection_handle = HCI_CON_HANDLE_INVALID;
     sm_persistent_keys_random_active = false;
+    uint8_t i;
+    for (i = 0; i < MAX_NR_SM_SETUP_CONTEXTS; i++){
+        sm_setup_contexts[i].sm_con_handle = HCI_CON_HANDLE_INVALID;
+        sm_setup_contexts[i].sm_aes128_state = SM_AES128_IDLE;
+        sm_setup_contexts[i].sm_crypto_random_active = false;
+#ifdef ENABLE_LE_SECURE_CONNECTIONS
+        sm_setup_contexts[i].sm_crypto_ecc_p256_active = false;
+#endif
+    }
+    sm_setup_context_next = 0;
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
     ec_key_generation_state = EC_KEY_GENERATION_IDLE;
+    sm_ec_key_renewal_pending = false;
 #endif
 }
 
@@ -5092,6 +5293,7 @@ void sm_authorization_grant(hci_con_handle_t con_handle){
 void sm_bonding_decline(hci_con_handle_t con_handle){
     sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
     if (!sm_conn) return;     // wrong connection
+    if (sm_setup_select(con_handle) == false) return;     // no security procedure active
     setup->sm_user_response = SM_USER_RESPONSE_DECLINE;
     log_info("decline, state %u", sm_conn->sm_engine_state);
     switch(sm_conn->sm_engine_state){
@@ -5128,12 +5330,13 @@ void sm_bonding_decline(hci_con_handle_t con_handle){
 void sm_just_works_confirm(hci_con_handle_t con_handle){
     sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
     if (!sm_conn) return;     // wrong connection
+    if (sm_setup_select(con_handle) == false) return;     // no security procedure active
     setup->sm_user_response = SM_USER_RESPONSE_CONFIRM;
     if (sm_conn->sm_engine_state == SM_PH1_W4_USER_RESPONSE){
         if (setup->sm_use_secure_connections){
             sm_conn->sm_engine_state = SM_SC_SEND_PUBLIC_KEY_COMMAND;
         } else {
-            btstack_crypto_random_generate(&sm_crypto_random_request, setup->sm_local_random, 16, &sm_handle_random_result_ph2_random, (void *)(uintptr_t) sm_conn->sm_handle);
+            sm_setup_random_generate(setup->sm_local_random, 16, &sm_handle_random_result_ph2_random);
         }
     }
 
@@ -5154,11 +5357,12 @@ void sm_numeric_comparison_confirm(hci_con_handle_t con_handle){
 void sm_passkey_input(hci_con_handle_t con_handle, uint32_t passkey){
     sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
     if (!sm_conn) return;     // wrong connection
+    if (sm_setup_select(con_handle) == false) return;     // no security procedure active
     sm_reset_tk();
     big_endian_store_32(setup->sm_tk, 12, passkey);
     setup->sm_user_response = SM_USER_RESPONSE_PASSKEY;
     if (sm_conn->sm_engine_state == SM_PH1_W4_USER_RESPONSE){
-        btstack_crypto_random_generate(&sm_crypto_random_request, setup->sm_local_random, 16, &sm_handle_random_result_ph2_random, (void *)(uintptr_t) sm_conn->sm_handle);
+        sm_setup_random_generate(setup->sm_local_random, 16, &sm_handle_random_result_ph2_random);
     }
 #ifdef ENABLE_LE_SECURE_CONNECTIONS
     (void)memcpy(setup->sm_ra, setup->sm_tk, 16);
@@ -5173,6 +5377,7 @@ void sm_passkey_input(hci_con_handle_t con_handle, uint32_t passkey){
 void sm_keypress_notification(hci_con_handle_t con_handle, uint8_t action){
     sm_connection_t * sm_conn = sm_get_connection_for_handle(con_handle);
     if (!sm_conn) return;     // wrong connection
+    if (sm_setup_select(con_handle) == false) return;     // no security procedure active
     if (action > SM_KEYPRESS_PASSKEY_ENTRY_COMPLETED) return;
     uint8_t num_actions = setup->sm_keypress_notification >> 5;
     uint8_t flags = setup->sm_keypress_notification & 0x1fu;
@@ -26,5 +26,6 @@
 #define BLUETOOTH_PSM_3DSP                                                               0x0021
 #define BLUETOOTH_PSM_LE_PSM_IPSP                                                        0x0023
 #define BLUETOOTH_PSM_OTS                                                                0x0025
+#define BLUETOOTH_PSM_EATT                                                               0x0027
 
 #endif
@@ -67,6 +67,7 @@
 #include "btstack_network.h"
 #include "btstack_ring_buffer.h"
 #include "btstack_run_loop.h"
+#include "btstack_spsc_ring_buffer.h"
 #include "btstack_stdin.h"
 #include "btstack_util.h"
 #include "gap.h"
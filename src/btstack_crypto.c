@@ -124,6 +124,14 @@ typedef enum {
     ECC_P256_KEY_GENERATION_DONE,
 } btstack_crypto_ecc_p256_key_generation_state_t;
 
+typedef enum {
+    ECC_P256_NEXT_KEY_IDLE,
+    ECC_P256_NEXT_KEY_W4_RANDOM,
+    ECC_P256_NEXT_KEY_W4_WORKER,
+    ECC_P256_NEXT_KEY_ACTIVE,
+    ECC_P256_NEXT_KEY_READY,
+} btstack_crypto_ecc_p256_next_key_state_t;
+
 static void btstack_crypto_run(void);
 static void btstack_crypto_state_reset(void);
 
@@ -157,6 +165,20 @@ static btstack_crypto_ecc_p256_key_generation_state_t btstack_crypto_ecc_p256_ke
 
 #ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
 static uint8_t btstack_crypto_ecc_p256_d[32];
+static bool    btstack_crypto_ecc_p256_random_active;
+
+// worker for key generation and dhkey calculation, single work item at a time
+static const btstack_crypto_worker_t * btstack_crypto_worker;
+static bool btstack_crypto_worker_active;
+static bool btstack_crypto_worker_discard_result;
+static btstack_context_callback_registration_t btstack_crypto_worker_work;
+static btstack_context_callback_registration_t btstack_crypto_worker_done;
+
+// next key pair, generated on worker after a key pair was provided
+static btstack_crypto_ecc_p256_next_key_state_t btstack_crypto_ecc_p256_next_key_state;
+static btstack_crypto_random_t btstack_crypto_ecc_p256_next_key_random_request;
+static uint8_t btstack_crypto_ecc_p256_next_public_key[64];
+static uint8_t btstack_crypto_ecc_p256_next_d[32];
 #endif
 
 // Software ECDH implementation provided by mbedtls
@@ -494,8 +516,7 @@ static void btstack_crypto_log_ec_publickey(const uint8_t * ec_q){
 #if (defined(USE_MICRO_ECC_P256) && !defined(WICED_VERSION)) || defined(USE_MBEDTLS_ECC_P256)
 // @return OK
 static int sm_generate_f_rng(unsigned char * buffer, unsigned size){
-    if (btstack_crypto_ecc_p256_key_generation_state != ECC_P256_KEY_GENERATION_ACTIVE) return 0;
-    log_info("sm_generate_f_rng: size %u - offset %u", (int) size, btstack_crypto_ecc_p256_random_offset);
+    if (btstack_crypto_ecc_p256_random_active == false) return 0;
     btstack_assert((btstack_crypto_ecc_p256_random_offset + size) <= btstack_crypto_ecc_p256_random_len);
     uint16_t remaining_size = size;
     uint8_t * buffer_ptr = buffer;
@@ -514,29 +535,29 @@ static int sm_generate_f_rng_mbedtls(void * context, unsigned char * buffer, siz
 }
 #endif /* USE_MBEDTLS_ECC_P256 */
 
-static void btstack_crypto_ecc_p256_generate_key_software(void){
+// generate key pair from 64 bytes in btstack_crypto_ecc_p256_random, might run on worker - no logging
+static void btstack_crypto_ecc_p256_generate_key_software(uint8_t * public_key, uint8_t * private_key){
 
     btstack_crypto_ecc_p256_random_offset = 0;
-    
+    btstack_crypto_ecc_p256_random_active = true;
+
     // generate EC key
 #ifdef USE_MICRO_ECC_P256
 
 #ifndef WICED_VERSION
-    log_info("set uECC RNG for initial key generation with 64 random bytes");
     // micro-ecc from WICED SDK uses its wiced_crypto_get_random by default - no need to set it
     uECC_set_rng(&sm_generate_f_rng);
 #endif /* WICED_VERSION */
 
 #if uECC_SUPPORTS_secp256r1
     // standard version
-    uECC_make_key(btstack_crypto_ecc_p256_public_key, btstack_crypto_ecc_p256_d, uECC_secp256r1());
+    uECC_make_key(public_key, private_key, uECC_secp256r1());
 
     // disable RNG again, as returning no randmon data lets shared key generation fail
-    log_info("disable uECC RNG in standard version after key generation");
     uECC_set_rng(NULL);
 #else
     // static version
-    uECC_make_key(btstack_crypto_ecc_p256_public_key, btstack_crypto_ecc_p256_d);
+    uECC_make_key(public_key, private_key);
 #endif
 #endif /* USE_MICRO_ECC_P256 */
 
@@ -545,17 +566,19 @@ static void btstack_crypto_ecc_p256_generate_key_software(void){
     mbedtls_ecp_point P;
     mbedtls_mpi_init(&d);
     mbedtls_ecp_point_init(&P);
-    int res = mbedtls_ecp_gen_keypair(&mbedtls_ec_group, &d, &P, &sm_generate_f_rng_mbedtls, NULL);
-    log_info("gen keypair %x", res);
-    mbedtls_mpi_write_binary(&P.X, &btstack_crypto_ecc_p256_public_key[0],  32);
-    mbedtls_mpi_write_binary(&P.Y, &btstack_crypto_ecc_p256_public_key[32], 32);
-    mbedtls_mpi_write_binary(&d, btstack_crypto_ecc_p256_d, 32);
+    (void) mbedtls_ecp_gen_keypair(&mbedtls_ec_group, &d, &P, &sm_generate_f_rng_mbedtls, NULL);
+    mbedtls_mpi_write_binary(&P.X, &public_key[0],  32);
+    mbedtls_mpi_write_binary(&P.Y, &public_key[32], 32);
+    mbedtls_mpi_write_binary(&d, private_key, 32);
     mbedtls_ecp_point_free(&P);
     mbedtls_mpi_free(&d);
 #endif  /* USE_MBEDTLS_ECC_P256 */
+
+    btstack_crypto_ecc_p256_random_active = false;
 }
 
 #ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
+// might run on worker - no logging
 static void btstack_crypto_ecc_p256_calculate_dhkey_software(btstack_crypto_ecc_p256_t * btstack_crypto_ec_p192){
     memset(btstack_crypto_ec_p192->dhkey, 0, 32);
 
@@ -587,9 +610,126 @@ static void btstack_crypto_ecc_p256_calculate_dhkey_software(btstack_crypto_ecc_
     mbedtls_mpi_free(&d);
     mbedtls_ecp_point_free(&Q);
 #endif
+}
 
+static void btstack_crypto_ecc_p256_dhkey_calculated(btstack_crypto_ecc_p256_t * btstack_crypto_ec_p192){
     log_info("dhkey");
     log_info_hexdump(btstack_crypto_ec_p192->dhkey, 32);
+    (*btstack_crypto_ec_p192->btstack_crypto.context_callback.callback)(btstack_crypto_ec_p192->btstack_crypto.context_callback.context);
+}
+
+static void btstack_crypto_worker_execute(void (*work)(void * context), void (*done)(void * context), void * context){
+    btstack_crypto_worker_active = true;
+    btstack_crypto_worker_work.callback = work;
+    btstack_crypto_worker_work.context  = context;
+    btstack_crypto_worker_done.callback = done;
+    btstack_crypto_worker_done.context  = context;
+    btstack_crypto_worker->execute(&btstack_crypto_worker_work, &btstack_crypto_worker_done);
+}
+
+// @return false if result has to be ignored as state was reset while work item was active
+static bool btstack_crypto_worker_finished(void){
+    btstack_crypto_worker_active = false;
+    if (btstack_crypto_worker_discard_result){
+        btstack_crypto_worker_discard_result = false;
+        log_info("discard worker result after reset");
+        btstack_crypto_run();
+        return false;
+    }
+    return true;
+}
+
+static void btstack_crypto_ecc_p256_pregenerate_key_start(void);
+static void btstack_crypto_ecc_p256_pregenerate_key_run(void);
+
+static void btstack_crypto_ecc_p256_generate_key_work(void * context){
+    UNUSED(context);
+    btstack_crypto_ecc_p256_generate_key_software(btstack_crypto_ecc_p256_public_key, btstack_crypto_ecc_p256_d);
+}
+
+static void btstack_crypto_ecc_p256_generate_key_done(void * context){
+    UNUSED(context);
+    if (btstack_crypto_worker_finished() == false) return;
+    btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_DONE;
+    btstack_crypto_run();
+}
+
+static void btstack_crypto_ecc_p256_calculate_dhkey_work(void * context){
+    btstack_crypto_ecc_p256_calculate_dhkey_software((btstack_crypto_ecc_p256_t *) context);
+}
+
+static void btstack_crypto_ecc_p256_calculate_dhkey_done(void * context){
+    if (btstack_crypto_worker_finished() == false) return;
+    btstack_crypto_ecc_p256_dhkey_calculated((btstack_crypto_ecc_p256_t *) context);
+    // worker is free now, key pair is usually not needed before the next pairing
+    btstack_crypto_ecc_p256_pregenerate_key_start();
+    btstack_crypto_ecc_p256_pregenerate_key_run();
+    btstack_crypto_run();
+}
+
+static void btstack_crypto_ecc_p256_pregenerate_key_work(void * context){
+    UNUSED(context);
+    btstack_crypto_ecc_p256_generate_key_software(btstack_crypto_ecc_p256_next_public_key, btstack_crypto_ecc_p256_next_d);
+}
+
+static void btstack_crypto_ecc_p256_pregenerate_key_done(void * context){
+    UNUSED(context);
+    if (btstack_crypto_worker_finished() == false) return;
+    log_info("next key pair ready");
+    btstack_crypto_ecc_p256_next_key_state = ECC_P256_NEXT_KEY_READY;
+    btstack_crypto_run();
+}
+
+static void btstack_crypto_ecc_p256_pregenerate_key_random_done(void * context){
+    UNUSED(context);
+    btstack_crypto_ecc_p256_random_len = 64;
+    btstack_crypto_ecc_p256_next_key_state = ECC_P256_NEXT_KEY_W4_WORKER;
+    btstack_crypto_ecc_p256_pregenerate_key_run();
+}
+
+static void btstack_crypto_ecc_p256_pregenerate_key_run(void){
+    if (btstack_crypto_ecc_p256_next_key_state != ECC_P256_NEXT_KEY_W4_WORKER) return;
+    if (btstack_crypto_worker_active) return;
+    btstack_crypto_ecc_p256_next_key_state = ECC_P256_NEXT_KEY_ACTIVE;
+    btstack_crypto_worker_execute(&btstack_crypto_ecc_p256_pregenerate_key_work, &btstack_crypto_ecc_p256_pregenerate_key_done, NULL);
+}
+
+// start generating the next key pair in the background after the DHKey for the current one was calculated,
+// random data is fetched via regular random request
+static void btstack_crypto_ecc_p256_pregenerate_key_start(void){
+    if (btstack_crypto_worker == NULL) return;
+    if (btstack_crypto_ecc_p256_next_key_state != ECC_P256_NEXT_KEY_IDLE) return;
+    btstack_crypto_ecc_p256_next_key_state = ECC_P256_NEXT_KEY_W4_RANDOM;
+    btstack_crypto_ecc_p256_random_len = 0;
+    btstack_crypto_ecc_p256_next_key_random_request.btstack_crypto.context_callback.callback = &btstack_crypto_ecc_p256_pregenerate_key_random_done;
+    btstack_crypto_ecc_p256_next_key_random_request.btstack_crypto.context_callback.context  = NULL;
+    btstack_crypto_ecc_p256_next_key_random_request.btstack_crypto.operation = BTSTACK_CRYPTO_RANDOM;
+    btstack_crypto_ecc_p256_next_key_random_request.buffer = btstack_crypto_ecc_p256_random;
+    btstack_crypto_ecc_p256_next_key_random_request.size   = 64;
+    btstack_linked_list_add_tail(&btstack_crypto_operations, (btstack_linked_item_t*) &btstack_crypto_ecc_p256_next_key_random_request);
+}
+
+// use pre-generated key pair if available, @return true if key generation is complete
+static bool btstack_crypto_ecc_p256_use_next_key(void){
+    switch (btstack_crypto_ecc_p256_next_key_state){
+        case ECC_P256_NEXT_KEY_READY:
+            log_info("use pre-generated key pair");
+            (void)memcpy(btstack_crypto_ecc_p256_public_key, btstack_crypto_ecc_p256_next_public_key, 64);
+            (void)memcpy(btstack_crypto_ecc_p256_d, btstack_crypto_ecc_p256_next_d, 32);
+            btstack_crypto_ecc_p256_next_key_state = ECC_P256_NEXT_KEY_IDLE;
+            return true;
+        case ECC_P256_NEXT_KEY_W4_RANDOM:
+            // random request is queued after key generation, drop it and generate key right away
+            btstack_linked_list_remove(&btstack_crypto_operations, (btstack_linked_item_t*) &btstack_crypto_ecc_p256_next_key_random_request);
+            btstack_crypto_ecc_p256_next_key_state = ECC_P256_NEXT_KEY_IDLE;
+            return false;
+        case ECC_P256_NEXT_KEY_W4_WORKER:
+            // random data gets overwritten, generate key right away
+            btstack_crypto_ecc_p256_next_key_state = ECC_P256_NEXT_KEY_IDLE;
+            return false;
+        default:
+            return false;
+    }
 }
 #endif
 
@@ -929,6 +1069,10 @@ static void btstack_crypto_run(void){
 #ifdef ENABLE_ECC_P256
             case BTSTACK_CRYPTO_ECC_P256_GENERATE_KEY:
                 btstack_crypto_ec_p192 = (btstack_crypto_ecc_p256_t *) btstack_crypto;
+#ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
+                // key pair must not change while worker uses it
+                if (btstack_crypto_worker_active) return;
+#endif
                 switch (btstack_crypto_ecc_p256_key_generation_state){
                     case ECC_P256_KEY_GENERATION_DONE:
                         // done
@@ -940,6 +1084,10 @@ static void btstack_crypto_run(void){
                         break;
                     case ECC_P256_KEY_GENERATION_IDLE:
 #ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
+                        if (btstack_crypto_ecc_p256_use_next_key()){
+                            btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_DONE;
+                            break;
+                        }
                         log_info("start ecc random");
                         btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_GENERATING_RANDOM;
                         btstack_crypto_ecc_p256_random_len = 0;
@@ -965,10 +1113,17 @@ static void btstack_crypto_run(void){
             case BTSTACK_CRYPTO_ECC_P256_CALCULATE_DHKEY:
                 btstack_crypto_ec_p192 = (btstack_crypto_ecc_p256_t *) btstack_crypto;
 #ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
+                if (btstack_crypto_worker != NULL){
+                    if (btstack_crypto_worker_active) return;
+                    // calculate on worker, following operations can continue meanwhile
+                    btstack_linked_list_pop(&btstack_crypto_operations);
+                    btstack_crypto_worker_execute(&btstack_crypto_ecc_p256_calculate_dhkey_work, &btstack_crypto_ecc_p256_calculate_dhkey_done, btstack_crypto_ec_p192);
+                    break;
+                }
                 btstack_crypto_ecc_p256_calculate_dhkey_software(btstack_crypto_ec_p192);
                 // done
                 btstack_linked_list_pop(&btstack_crypto_operations);
-                (*btstack_crypto_ec_p192->btstack_crypto.context_callback.callback)(btstack_crypto_ec_p192->btstack_crypto.context_callback.context);
+                btstack_crypto_ecc_p256_dhkey_calculated(btstack_crypto_ec_p192);
 #else
                 btstack_crypto_wait_for_hci_result = 1;
                 hci_send_cmd(&hci_le_generate_dhkey, &btstack_crypto_ec_p192->public_key[0], &btstack_crypto_ec_p192->public_key[32]);
@@ -1009,7 +1164,11 @@ static void btstack_crypto_handle_random_data(const uint8_t * data, uint16_t len
             btstack_crypto_ecc_p256_random_len += 8u;
             if (btstack_crypto_ecc_p256_random_len >= 64u) {
                 btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_ACTIVE;
-                btstack_crypto_ecc_p256_generate_key_software();
+                if (btstack_crypto_worker != NULL){
+                    btstack_crypto_worker_execute(&btstack_crypto_ecc_p256_generate_key_work, &btstack_crypto_ecc_p256_generate_key_done, NULL);
+                    break;
+                }
+                btstack_crypto_ecc_p256_generate_key_software(btstack_crypto_ecc_p256_public_key, btstack_crypto_ecc_p256_d);
                 btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_DONE;
             }
             break;
@@ -1358,6 +1517,11 @@ static void btstack_crypto_state_reset(void) {
 #endif
 #ifdef ENABLE_ECC_P256
     btstack_crypto_ecc_p256_key_generation_state = ECC_P256_KEY_GENERATION_IDLE;
+#endif
+#ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
+    // an active work item cannot be cancelled, btstack_crypto_worker_active is cleared and its result ignored when it's done
+    btstack_crypto_worker_discard_result = btstack_crypto_worker_active;
+    btstack_crypto_ecc_p256_next_key_state = ECC_P256_NEXT_KEY_IDLE;
 #endif
     btstack_crypto_wait_for_hci_result = false;
     btstack_crypto_operations = NULL;
@@ -1385,6 +1549,14 @@ void btstack_crypto_deinit(void) {
     btstack_crypto_initialized = false;
 }
 
+void btstack_crypto_ecc_p256_set_worker(const btstack_crypto_worker_t * worker){
+#ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
+    btstack_crypto_worker = worker;
+#else
+    UNUSED(worker);
+#endif
+}
+
 // PTS only
 void btstack_crypto_ecc_p256_set_key(const uint8_t * public_key, const uint8_t * private_key){
 #ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
@@ -1399,6 +1571,9 @@ void btstack_crypto_ecc_p256_set_key(const uint8_t * public_key, const uint8_t *
 
 // Unit testing
 int btstack_crypto_idle(void){
+#ifdef USE_SOFTWARE_ECC_P256_IMPLEMENTATION
+    if (btstack_crypto_worker_active) return 0;
+#endif
     return btstack_linked_list_empty(&btstack_crypto_operations);
 }
 void btstack_crypto_reset(void){
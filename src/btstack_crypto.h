@@ -101,6 +101,19 @@ typedef struct {
     uint8_t * dhkey;
 } btstack_crypto_ecc_p256_t;
 
+/**
+ * Worker to run long running operations, e.g. ECC P-256 key generation and DHKey calculation, outside of the run loop
+ */
+typedef struct {
+	/**
+	 * Execute work on worker and call done on main thread afterwards, e.g. via btstack_run_loop_execute_on_main_thread
+	 * @note BTstack Crypto only has a single work item active at a time
+	 * @param work callback with context executed on worker
+	 * @param done callback with context executed on main thread
+	 */
+	void (*execute)(btstack_context_callback_registration_t * work, btstack_context_callback_registration_t * done);
+} btstack_crypto_worker_t;
+
 typedef enum {
     CCM_CALCULATE_X1,
     CCM_W4_X1,
@@ -214,6 +227,14 @@ void btstack_crypto_ecc_p256_generate_key(btstack_crypto_ecc_p256_t * request, u
  */
 void btstack_crypto_ecc_p256_calculate_dhkey(btstack_crypto_ecc_p256_t * request, const uint8_t * public_key, uint8_t * dhkey, void (* callback)(void * arg), void * callback_arg);
 
+/**
+ * Calculate ECC P-256 key pairs and DHKey on worker instead of the run loop. After a key pair has been provided,
+ * the next one is generated in the background and used for the following btstack_crypto_ecc_p256_generate_key call
+ * @note Only used with software ECC implementation (micro-ecc, mbedTLS)
+ * @param worker or NULL to calculate on run loop
+ */
+void btstack_crypto_ecc_p256_set_worker(const btstack_crypto_worker_t * worker);
+
 /*
  * Validate public key (not implemented for LE Controller ECC)
  * @param public_key (64 bytes)
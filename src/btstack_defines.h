@@ -1419,6 +1419,17 @@ typedef uint8_t sm_key_t[16];
  */
 #define SDP_EVENT_QUERY_SERVICE_RECORD_HANDLE                    0x95u
 
+/**
+ * @format 2222JV
+ * @param record_id
+ * @param attribute_id
+ * @param attribute_length
+ * @param data_offset
+ * @param data_len
+ * @param data
+ */
+#define SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK                    0x96u
+
 /**
  * @format H1
  * @param handle
@@ -1537,6 +1548,14 @@ typedef uint8_t sm_key_t[16];
  */
 #define GATT_EVENT_DISCONNECTED                                  0xAEu
 
+/**
+ * @format 1H1
+ * @param status
+ * @param handle
+ * @param num_bearers
+ */
+#define GATT_EVENT_EATT_CONNECTED                                0xAFu
+
 
 /** 
  * @format 1BH
@@ -2507,6 +2507,61 @@ static inline uint32_t sdp_event_query_service_record_handle_get_record_handle(c
     return little_endian_read_32(event, 6);
 }
 
+/**
+ * @brief Get field record_id from event SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK
+ * @param event packet
+ * @return record_id
+ * @note: btstack_type 2
+ */
+static inline uint16_t sdp_event_query_attribute_value_chunk_get_record_id(const uint8_t * event){
+    return little_endian_read_16(event, 2);
+}
+/**
+ * @brief Get field attribute_id from event SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK
+ * @param event packet
+ * @return attribute_id
+ * @note: btstack_type 2
+ */
+static inline uint16_t sdp_event_query_attribute_value_chunk_get_attribute_id(const uint8_t * event){
+    return little_endian_read_16(event, 4);
+}
+/**
+ * @brief Get field attribute_length from event SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK
+ * @param event packet
+ * @return attribute_length
+ * @note: btstack_type 2
+ */
+static inline uint16_t sdp_event_query_attribute_value_chunk_get_attribute_length(const uint8_t * event){
+    return little_endian_read_16(event, 6);
+}
+/**
+ * @brief Get field data_offset from event SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK
+ * @param event packet
+ * @return data_offset
+ * @note: btstack_type 2
+ */
+static inline uint16_t sdp_event_query_attribute_value_chunk_get_data_offset(const uint8_t * event){
+    return little_endian_read_16(event, 8);
+}
+/**
+ * @brief Get field data_len from event SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK
+ * @param event packet
+ * @return data_len
+ * @note: btstack_type J
+ */
+static inline uint8_t sdp_event_query_attribute_value_chunk_get_data_len(const uint8_t * event){
+    return event[10];
+}
+/**
+ * @brief Get field data from event SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK
+ * @param event packet
+ * @return data
+ * @note: btstack_type V
+ */
+static inline const uint8_t * sdp_event_query_attribute_value_chunk_get_data(const uint8_t * event){
+    return &event[11];
+}
+
 #ifdef ENABLE_BLE
 /**
  * @brief Get field handle from event GATT_EVENT_QUERY_COMPLETE
@@ -2939,6 +2994,36 @@ static inline hci_con_handle_t gatt_event_disconnected_get_handle(const uint8_t
 }
 #endif
 
+#ifdef ENABLE_BLE
+/**
+ * @brief Get field status from event GATT_EVENT_EATT_CONNECTED
+ * @param event packet
+ * @return status
+ * @note: btstack_type 1
+ */
+static inline uint8_t gatt_event_eatt_connected_get_status(const uint8_t * event){
+    return event[2];
+}
+/**
+ * @brief Get field handle from event GATT_EVENT_EATT_CONNECTED
+ * @param event packet
+ * @return handle
+ * @note: btstack_type H
+ */
+static inline hci_con_handle_t gatt_event_eatt_connected_get_handle(const uint8_t * event){
+    return little_endian_read_16(event, 3);
+}
+/**
+ * @brief Get field num_bearers from event GATT_EVENT_EATT_CONNECTED
+ * @param event packet
+ * @return num_bearers
+ * @note: btstack_type 1
+ */
+static inline uint8_t gatt_event_eatt_connected_get_num_bearers(const uint8_t * event){
+    return event[5];
+}
+#endif
+
 /**
  * @brief Get field address_type from event ATT_EVENT_CONNECTED
  * @param event packet
@@ -40,6 +40,7 @@
 #include <string.h>
 
 #include "btstack_hid_parser.h"
+#include "bluetooth.h"
 #include "btstack_util.h"
 #include "btstack_debug.h"
 
@@ -531,3 +532,290 @@ int btstack_hid_report_id_declared(uint16_t hid_descriptor_len, const uint8_t *
     }
     return 0;
 }
+
+// Compiled HID Report Layout
+
+static hid_report_type_t btstack_hid_report_type_for_main_item(uint8_t item_tag){
+    switch ((MainItemTag)item_tag){
+        case Input:
+            return HID_REPORT_TYPE_INPUT;
+        case Output:
+            return HID_REPORT_TYPE_OUTPUT;
+        case Feature:
+            return HID_REPORT_TYPE_FEATURE;
+        default:
+            return HID_REPORT_TYPE_RESERVED;
+    }
+}
+
+static btstack_hid_report_info_t * btstack_hid_report_layout_find_report(const btstack_hid_report_layout_t * layout, uint8_t report_id, hid_report_type_t report_type){
+    uint8_t i;
+    for (i=0;i<layout->reports_count;i++){
+        btstack_hid_report_info_t * report = &layout->reports[i];
+        if ((report->report_id == report_id) && (report->report_type == report_type)){
+            return report;
+        }
+    }
+    return NULL;
+}
+
+static uint8_t btstack_hid_report_layout_add_fields(btstack_hid_report_layout_t * layout, btstack_hid_parser_t * parser, hid_report_type_t report_type, bool store_fields){
+    btstack_hid_report_info_t * report = btstack_hid_report_layout_find_report(layout, parser->global_report_id, report_type);
+    if (report == NULL){
+        if (layout->reports_count >= layout->reports_max) {
+            return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+        }
+        report = &layout->reports[layout->reports_count++];
+        memset(report, 0, sizeof(btstack_hid_report_info_t));
+        report->report_id   = parser->global_report_id;
+        report->report_type = report_type;
+    }
+
+    uint16_t report_count = parser->global_report_count;
+    uint8_t  report_size  = parser->global_report_size;
+
+    // report size and number of fields must not wrap
+    uint32_t size_in_bits = (uint32_t) report->size_in_bits + ((uint32_t) report_count * report_size);
+    if (size_in_bits > 0xffffu){
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+
+    // constant fields used for padding
+    bool is_constant = (parser->descriptor_item.item_value & 1) != 0;
+    if (is_constant || (report_count == 0u) || (report_size == 0u)){
+        report->size_in_bits = (uint16_t) size_in_bits;
+        return ERROR_CODE_SUCCESS;
+    }
+
+    if (((uint32_t) report->fields_count + report_count) > 0xffffu){
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+
+    bool is_variable = (parser->descriptor_item.item_value & 2) != 0;
+    uint8_t flags = 0;
+    if (is_variable){
+        flags |= BTSTACK_HID_REPORT_FIELD_FLAGS_VARIABLE;
+        if (parser->global_logical_minimum < 0){
+            flags |= BTSTACK_HID_REPORT_FIELD_FLAGS_SIGNED;
+        }
+    }
+
+    // find first usage after last main item, fall back to global usage page
+    parser->available_usages = 0;
+    parser->have_usage_min = 0;
+    parser->have_usage_max = 0;
+    hid_find_next_usage(parser);
+    uint32_t usage = parser->available_usages ? parser->usage_minimum : ((uint32_t) parser->global_usage_page << 16u);
+
+    uint16_t i;
+    for (i=0;i<report_count;i++){
+        if (store_fields){
+            uint32_t field_index = (uint32_t) report->fields_offset + report->fields_count;
+            if (field_index >= layout->fields_max){
+                return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+            }
+            btstack_hid_report_field_t * field = &layout->fields[field_index];
+            field->usage_page      = usage >> 16u;
+            field->usage           = usage & 0xffffu;
+            field->bit_offset      = report->size_in_bits;
+            field->bit_size        = report_size;
+            field->flags           = flags;
+            field->logical_minimum = parser->global_logical_minimum;
+            field->logical_maximum = parser->global_logical_maximum;
+        }
+        report->fields_count++;
+        report->size_in_bits += report_size;
+
+        // array fields provide usage in report
+        if (!is_variable) continue;
+
+        // next usage, last usage is used for remaining fields if no more usages are available
+        if (parser->available_usages > 0u){
+            parser->available_usages--;
+        }
+        if (parser->available_usages > 0u){
+            parser->usage_minimum++;
+        } else {
+            hid_find_next_usage(parser);
+        }
+        if (parser->available_usages > 0u){
+            usage = parser->usage_minimum;
+        }
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+static uint8_t btstack_hid_report_layout_process(btstack_hid_report_layout_t * layout, uint16_t hid_descriptor_len, const uint8_t * hid_descriptor, bool store_fields){
+    btstack_hid_parser_t parser;
+    memset(&parser, 0, sizeof(btstack_hid_parser_t));
+    parser.descriptor     = hid_descriptor;
+    parser.descriptor_len = hid_descriptor_len;
+
+    while (parser.descriptor_pos < parser.descriptor_len){
+        hid_descriptor_item_t * item = &parser.descriptor_item;
+        btstack_hid_parse_descriptor_item(item, &hid_descriptor[parser.descriptor_pos], parser.descriptor_len - parser.descriptor_pos);
+        switch ((TagType)item->item_type){
+            case Global:
+                btstack_hid_handle_global_item(&parser, item);
+                if ((GlobalItemTag)item->item_tag == ReportID){
+                    layout->report_id_declared = true;
+                }
+                break;
+            case Main: {
+                hid_report_type_t report_type = btstack_hid_report_type_for_main_item(item->item_tag);
+                if (report_type != HID_REPORT_TYPE_RESERVED){
+                    uint8_t status = btstack_hid_report_layout_add_fields(layout, &parser, report_type, store_fields);
+                    if (status != ERROR_CODE_SUCCESS){
+                        return status;
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        hid_post_process_item(&parser, item);
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+void btstack_hid_report_layout_init(btstack_hid_report_layout_t * layout, btstack_hid_report_info_t * reports, uint8_t reports_max,
+                                    btstack_hid_report_field_t * fields, uint16_t fields_max){
+    memset(layout, 0, sizeof(btstack_hid_report_layout_t));
+    layout->reports     = reports;
+    layout->reports_max = reports_max;
+    layout->fields      = fields;
+    layout->fields_max  = (fields != NULL) ? fields_max : 0;
+}
+
+uint8_t btstack_hid_report_layout_compile(btstack_hid_report_layout_t * layout, uint16_t hid_descriptor_len, const uint8_t * hid_descriptor){
+    layout->reports_count = 0;
+    layout->fields_count  = 0;
+    layout->report_id_declared = false;
+
+    // first pass: collect reports, their sizes and number of fields
+    uint8_t status = btstack_hid_report_layout_process(layout, hid_descriptor_len, hid_descriptor, false);
+    if (status != ERROR_CODE_SUCCESS){
+        return status;
+    }
+
+    // assign consecutive ranges in field table to reports
+    uint32_t fields_total = 0;
+    uint8_t i;
+    for (i=0;i<layout->reports_count;i++){
+        if (fields_total > 0xffffu){
+            return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+        }
+        layout->reports[i].fields_offset = (uint16_t) fields_total;
+        fields_total += layout->reports[i].fields_count;
+    }
+    if (fields_total > 0xffffu){
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+    layout->fields_count = (uint16_t) fields_total;
+
+    // report sizes only
+    if (layout->fields == NULL){
+        return ERROR_CODE_SUCCESS;
+    }
+
+    if (fields_total > layout->fields_max){
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+
+    // second pass: store fields
+    for (i=0;i<layout->reports_count;i++){
+        layout->reports[i].fields_count = 0;
+        layout->reports[i].size_in_bits = 0;
+    }
+    return btstack_hid_report_layout_process(layout, hid_descriptor_len, hid_descriptor, true);
+}
+
+const btstack_hid_report_info_t * btstack_hid_report_layout_get_report(const btstack_hid_report_layout_t * layout, uint8_t report_id, hid_report_type_t report_type){
+    return btstack_hid_report_layout_find_report(layout, report_id, report_type);
+}
+
+int btstack_hid_report_layout_get_report_size(const btstack_hid_report_layout_t * layout, int report_id, hid_report_type_t report_type){
+    if ((report_id < 0) || (report_id > 255)) return 0;
+    const btstack_hid_report_info_t * report = btstack_hid_report_layout_find_report(layout, (uint8_t) report_id, report_type);
+    if (report == NULL) return 0;
+    return (report->size_in_bits + 7u) / 8u;
+}
+
+hid_report_id_status_t btstack_hid_report_layout_id_valid(const btstack_hid_report_layout_t * layout, int report_id){
+    if (layout->report_id_declared == false) return HID_REPORT_ID_UNDECLARED;
+    uint8_t i;
+    for (i=0;i<layout->reports_count;i++){
+        if (layout->reports[i].report_id == report_id) return HID_REPORT_ID_VALID;
+    }
+    return HID_REPORT_ID_INVALID;
+}
+
+int32_t btstack_hid_report_field_get_value(const btstack_hid_report_field_t * field, const uint8_t * report_data, uint16_t report_data_len){
+    if (field->bit_size == 0u) return 0;
+    uint16_t pos_start = field->bit_offset >> 3u;
+    uint16_t pos_end   = (field->bit_offset + field->bit_size - 1u) >> 3u;
+    if (pos_end >= report_data_len) return 0;
+
+    // read up to 32 bit field at arbitrary bit offset, only lower 32 bits of larger fields are returned
+    uint16_t num_bytes = btstack_min(pos_end - pos_start + 1u, 5u);
+    uint64_t multi_byte_value = 0;
+    uint16_t i;
+    for (i=0; i < num_bytes; i++){
+        multi_byte_value |= ((uint64_t) report_data[pos_start + i]) << (i * 8u);
+    }
+    uint32_t mask = (field->bit_size >= 32u) ? 0xffffffffu : ((1u << field->bit_size) - 1u);
+    uint32_t unsigned_value = ((uint32_t) (multi_byte_value >> (field->bit_offset & 0x07u))) & mask;
+
+    // sign extend
+    if (((field->flags & BTSTACK_HID_REPORT_FIELD_FLAGS_SIGNED) != 0u) && (field->bit_size < 32u)){
+        if ((unsigned_value & (1u << (field->bit_size - 1u))) != 0u){
+            unsigned_value |= ~mask;
+        }
+    }
+    return (int32_t) unsigned_value;
+}
+
+void btstack_hid_report_iterator_init(btstack_hid_report_iterator_t * iterator, const btstack_hid_report_layout_t * layout,
+                                      hid_report_type_t hid_report_type, const uint8_t * hid_report, uint16_t hid_report_len){
+    memset(iterator, 0, sizeof(btstack_hid_report_iterator_t));
+    if (layout->fields == NULL) return;
+
+    uint8_t report_id = 0;
+    if (layout->report_id_declared){
+        if (hid_report_len == 0u) return;
+        report_id = hid_report[0];
+        hid_report++;
+        hid_report_len--;
+    }
+
+    const btstack_hid_report_info_t * report = btstack_hid_report_layout_find_report(layout, report_id, hid_report_type);
+    if (report == NULL) return;
+
+    iterator->field            = &layout->fields[report->fields_offset];
+    iterator->fields_remaining = report->fields_count;
+    iterator->report_data      = hid_report;
+    iterator->report_data_len  = hid_report_len;
+}
+
+bool btstack_hid_report_iterator_has_more(const btstack_hid_report_iterator_t * iterator){
+    if (iterator->fields_remaining == 0u) return false;
+    // field has to be contained in report
+    uint32_t bits_required = iterator->field->bit_offset + iterator->field->bit_size;
+    return bits_required <= (((uint32_t) iterator->report_data_len) * 8u);
+}
+
+void btstack_hid_report_iterator_get_field(btstack_hid_report_iterator_t * iterator, uint16_t * usage_page, uint16_t * usage, int32_t * value){
+    const btstack_hid_report_field_t * field = iterator->field;
+    int32_t field_value = btstack_hid_report_field_get_value(field, iterator->report_data, iterator->report_data_len);
+    *usage_page = field->usage_page;
+    if ((field->flags & BTSTACK_HID_REPORT_FIELD_FLAGS_VARIABLE) != 0u){
+        *usage = field->usage;
+        *value = field_value;
+    } else {
+        *usage = (uint16_t) field_value;
+        *value = 1;
+    }
+    iterator->field++;
+    iterator->fields_remaining--;
+}
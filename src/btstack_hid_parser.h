@@ -40,12 +40,16 @@
  *
  * Single-pass HID Report Parser: HID Report is directly parsed without preprocessing HID Descriptor to minimize memory.
  *
+ * Compiled HID Report Layout: HID Descriptor is compiled once into a table of report fields per Report ID and type,
+ * which allows to decode HID Reports without parsing the HID Descriptor again.
+ *
  */
 
 #ifndef BTSTACK_HID_PARSER_H
 #define BTSTACK_HID_PARSER_H
 
 #include <stdint.h>
+#include "btstack_bool.h"
 #include "btstack_hid.h"
 
 #if defined __cplusplus
@@ -151,6 +155,49 @@ typedef struct {
     uint8_t         global_report_id;
 } btstack_hid_parser_t;
 
+// report field flags
+#define BTSTACK_HID_REPORT_FIELD_FLAGS_VARIABLE 0x01u
+#define BTSTACK_HID_REPORT_FIELD_FLAGS_SIGNED   0x02u
+
+typedef struct {
+    uint16_t usage_page;
+    uint16_t usage;             // only used for variable fields, array fields report usage in report
+    uint16_t bit_offset;        // bit position in report data without Report ID
+    uint8_t  bit_size;
+    uint8_t  flags;
+    int32_t  logical_minimum;
+    int32_t  logical_maximum;
+} btstack_hid_report_field_t;
+
+typedef struct {
+    hid_report_type_t report_type;
+    uint8_t  report_id;
+    uint16_t size_in_bits;      // without Report ID
+    uint16_t fields_offset;
+    uint16_t fields_count;
+} btstack_hid_report_info_t;
+
+typedef struct {
+    // report table
+    btstack_hid_report_info_t  * reports;
+    uint8_t                      reports_max;
+    uint8_t                      reports_count;
+
+    // field table, optional
+    btstack_hid_report_field_t * fields;
+    uint16_t                     fields_max;
+    uint16_t                     fields_count;
+
+    bool                         report_id_declared;
+} btstack_hid_report_layout_t;
+
+typedef struct {
+    const btstack_hid_report_field_t * field;
+    uint16_t        fields_remaining;
+    const uint8_t * report_data;
+    uint16_t        report_data_len;
+} btstack_hid_report_iterator_t;
+
 /* API_START */
 
 /**
@@ -210,6 +257,86 @@ hid_report_id_status_t btstack_hid_id_valid(int report_id, uint16_t hid_descript
  * @param hid_descriptor
  */
 int btstack_hid_report_id_declared(uint16_t hid_descriptor_len, const uint8_t * hid_descriptor);
+
+/**
+ * @brief Initialize HID Report Layout with storage for report and field tables
+ * @param layout
+ * @param reports table
+ * @param reports_max number of entries in report table
+ * @param fields table, can be NULL if only report sizes are needed
+ * @param fields_max number of entries in field table
+ */
+void btstack_hid_report_layout_init(btstack_hid_report_layout_t * layout, btstack_hid_report_info_t * reports, uint8_t reports_max,
+                                    btstack_hid_report_field_t * fields, uint16_t fields_max);
+
+/**
+ * @brief Compile HID Descriptor into report and field tables
+ * @param layout
+ * @param hid_descriptor_len
+ * @param hid_descriptor
+ * @return status ERROR_CODE_SUCCESS, or ERROR_CODE_MEMORY_CAPACITY_EXCEEDED if tables are too small or a report exceeds 0xffff bits
+ */
+uint8_t btstack_hid_report_layout_compile(btstack_hid_report_layout_t * layout, uint16_t hid_descriptor_len, const uint8_t * hid_descriptor);
+
+/**
+ * @brief Get report info for given report ID and report type
+ * @param layout
+ * @param report_id
+ * @param report_type
+ * @return report info or NULL if not found
+ */
+const btstack_hid_report_info_t * btstack_hid_report_layout_get_report(const btstack_hid_report_layout_t * layout, uint8_t report_id, hid_report_type_t report_type);
+
+/**
+ * @brief Get report size for given report ID and report type, see btstack_hid_get_report_size_for_id
+ * @param layout
+ * @param report_id
+ * @param report_type
+ * @return report size in bytes without Report ID
+ */
+int btstack_hid_report_layout_get_report_size(const btstack_hid_report_layout_t * layout, int report_id, hid_report_type_t report_type);
+
+/**
+ * @brief Check if report ID is valid, see btstack_hid_id_valid
+ * @param layout
+ * @param report_id
+ */
+hid_report_id_status_t btstack_hid_report_layout_id_valid(const btstack_hid_report_layout_t * layout, int report_id);
+
+/**
+ * @brief Get value of report field, only the lower 32 bits of larger fields are returned
+ * @param field
+ * @param report_data without Report ID
+ * @param report_data_len
+ * @return value, or usage for array fields
+ */
+int32_t btstack_hid_report_field_get_value(const btstack_hid_report_field_t * field, const uint8_t * report_data, uint16_t report_data_len);
+
+/**
+ * @brief Initialize iterator over fields of a HID Report using compiled HID Report Layout
+ * @param iterator
+ * @param layout with field table
+ * @param hid_report_type
+ * @param hid_report including Report ID if declared
+ * @param hid_report_len
+ */
+void btstack_hid_report_iterator_init(btstack_hid_report_iterator_t * iterator, const btstack_hid_report_layout_t * layout,
+                                      hid_report_type_t hid_report_type, const uint8_t * hid_report, uint16_t hid_report_len);
+
+/**
+ * @brief Checks if more fields are available
+ * @param iterator
+ */
+bool btstack_hid_report_iterator_has_more(const btstack_hid_report_iterator_t * iterator);
+
+/**
+ * @brief Get next field, same semantics as btstack_hid_parser_get_field
+ * @param iterator
+ * @param usage_page
+ * @param usage
+ * @param value provided in HID report
+ */
+void btstack_hid_report_iterator_get_field(btstack_hid_report_iterator_t * iterator, uint16_t * usage_page, uint16_t * usage, int32_t * value);
 /* API_END */
 
 #if defined __cplusplus
@@ -75,7 +75,8 @@ uint16_t btstack_resample_block(btstack_resample_t * context, const int16_t * in
         int index = src_pos * context->num_channels;
         int i;
         if (src_pos >= (num_frames - 1u)){
-            // store last sample
+            // store last sample, src_pos might be past last frame when compressing
+            index = (num_frames - 1u) * context->num_channels;
             for (i=0;i<context->num_channels;i++){
                 context->last_sample[i] = input_buffer[index++];
             }
@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "btstack_resample_polyphase.c"
+
+#include <string.h>
+
+#include "btstack_resample_polyphase.h"
+
+#include "bluetooth.h"
+#include "btstack_util.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BTSTACK_RESAMPLE_POLYPHASE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BTSTACK_RESAMPLE_POLYPHASE_NEON
+#endif
+
+#define BTSTACK_RESAMPLE_POLYPHASE_HISTORY_SIZE (BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS + BTSTACK_RESAMPLE_POLYPHASE_CHUNK_SIZE)
+
+// coefficients are stored as Q15, largest coefficient is below 1.0 as cutoff is below Nyquist
+#define BTSTACK_RESAMPLE_POLYPHASE_COEFFICIENT_SHIFT 15
+// weight for interpolation between phases is Q15
+#define BTSTACK_RESAMPLE_POLYPHASE_WEIGHT_SHIFT      15
+
+#define BTSTACK_RESAMPLE_POLYPHASE_PI 3.14159265358979323846
+
+#if (BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS % 8) != 0
+#error "BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS must be a multiple of 8"
+#endif
+
+// sum of absolute coefficients times full-scale input has to fit into 32-bit accumulator
+#if BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS > 64
+#error "BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS must not exceed 64"
+#endif
+
+// sine without libm: reduce to [-pi/2, pi/2] and use Taylor series
+static double btstack_resample_polyphase_sin(double x){
+    const double two_pi = 2.0 * BTSTACK_RESAMPLE_POLYPHASE_PI;
+    x -= two_pi * (double)(int32_t)(x / two_pi);
+    if (x > BTSTACK_RESAMPLE_POLYPHASE_PI){
+        x -= two_pi;
+    } else if (x < -BTSTACK_RESAMPLE_POLYPHASE_PI){
+        x += two_pi;
+    }
+    if (x > (BTSTACK_RESAMPLE_POLYPHASE_PI / 2.0)){
+        x = BTSTACK_RESAMPLE_POLYPHASE_PI - x;
+    } else if (x < (-BTSTACK_RESAMPLE_POLYPHASE_PI / 2.0)){
+        x = -BTSTACK_RESAMPLE_POLYPHASE_PI - x;
+    }
+    double x2   = x * x;
+    double term = x;
+    double sum  = x;
+    int i;
+    for (i = 1; i < 10; i++){
+        term = -term * x2 / (double)((2 * i) * (2 * i + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+static double btstack_resample_polyphase_cos(double x){
+    return btstack_resample_polyphase_sin(x + (BTSTACK_RESAMPLE_POLYPHASE_PI / 2.0));
+}
+
+// low-pass with cutoff relative to Nyquist, windowed by 4-term Blackman-Harris over num_taps
+static double btstack_resample_polyphase_kernel_value(double x, double cutoff, uint8_t num_taps){
+    double u = (x + (num_taps / 2.0)) / num_taps;
+    if ((u <= 0.0) || (u >= 1.0)) return 0.0;
+    const double two_pi = 2.0 * BTSTACK_RESAMPLE_POLYPHASE_PI;
+    double window = 0.35875 - (0.48829 * btstack_resample_polyphase_cos(two_pi * u))
+                            + (0.14128 * btstack_resample_polyphase_cos(2.0 * two_pi * u))
+                            - (0.01168 * btstack_resample_polyphase_cos(3.0 * two_pi * u));
+    double t = BTSTACK_RESAMPLE_POLYPHASE_PI * cutoff * x;
+    double sinc = (t == 0.0) ? 1.0 : (btstack_resample_polyphase_sin(t) / t);
+    return cutoff * sinc * window;
+}
+
+uint8_t btstack_resample_polyphase_filter_init(btstack_resample_polyphase_filter_t * filter, uint8_t num_taps,
+                                               uint32_t input_sample_rate, uint32_t output_sample_rate){
+    if ((num_taps == 0u) || ((num_taps % 8u) != 0u) || (num_taps > BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+    if ((input_sample_rate == 0u) || (output_sample_rate == 0u)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+
+    // keep transition band of the window mostly below Nyquist, scale for downsampling
+    double cutoff = 1.0 - (3.0 / num_taps);
+    if (output_sample_rate < input_sample_rate){
+        cutoff = cutoff * output_sample_rate / input_sample_rate;
+    }
+
+    memset(filter, 0, sizeof(btstack_resample_polyphase_filter_t));
+    filter->num_taps = num_taps;
+    uint16_t phase;
+    for (phase = 0; phase <= BTSTACK_RESAMPLE_POLYPHASE_NUM_PHASES; phase++){
+        // tap j is applied to input at distance (num_taps / 2 - 1 + phase / num_phases - j)
+        double values[BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS];
+        double sum = 0.0;
+        uint8_t j;
+        for (j = 0; j < num_taps; j++){
+            double x = ((num_taps / 2) - 1) + ((double) phase / BTSTACK_RESAMPLE_POLYPHASE_NUM_PHASES) - j;
+            values[j] = btstack_resample_polyphase_kernel_value(x, cutoff, num_taps);
+            sum += values[j];
+        }
+        // normalize for unity gain at DC
+        int32_t quantized_sum = 0;
+        uint8_t max_tap = 0;
+        for (j = 0; j < num_taps; j++){
+            double scaled = values[j] * (1 << BTSTACK_RESAMPLE_POLYPHASE_COEFFICIENT_SHIFT) / sum;
+            int32_t coefficient = (int32_t)((scaled >= 0.0) ? (scaled + 0.5) : (scaled - 0.5));
+            if (coefficient > INT16_MAX){
+                coefficient = INT16_MAX;
+            } else if (coefficient < -INT16_MAX){
+                coefficient = -INT16_MAX;
+            }
+            filter->coefficients[phase][j] = (int16_t) coefficient;
+            quantized_sum += coefficient;
+            if (coefficient > filter->coefficients[phase][max_tap]){
+                max_tap = j;
+            }
+        }
+        filter->coefficients[phase][max_tap] += (int16_t)((1 << BTSTACK_RESAMPLE_POLYPHASE_COEFFICIENT_SHIFT) - quantized_sum);
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t btstack_resample_polyphase_init(btstack_resample_polyphase_t * context, const btstack_resample_polyphase_filter_t * filter,
+                                        uint8_t num_channels, uint32_t input_sample_rate, uint32_t output_sample_rate){
+    if ((num_channels == 0u) || (num_channels > BTSTACK_RESAMPLE_MAX_CHANNELS)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+    if ((input_sample_rate == 0u) || (output_sample_rate == 0u) || (input_sample_rate > (4u * output_sample_rate))){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+    memset(context, 0, sizeof(btstack_resample_polyphase_t));
+    context->filter = filter;
+    context->num_channels = num_channels;
+    context->nominal_step = (((uint64_t) input_sample_rate) << 32) / output_sample_rate;
+    context->step = context->nominal_step;
+    // first output sample is centered on first input sample
+    context->history_len = (filter->num_taps / 2u) - 1u;
+    return ERROR_CODE_SUCCESS;
+}
+
+void btstack_resample_polyphase_set_factor(btstack_resample_polyphase_t * context, uint32_t factor){
+    // factor 0 would stop consuming input
+    factor = btstack_max(BTSTACK_RESAMPLE_POLYPHASE_FACTOR_MIN, btstack_min(factor, BTSTACK_RESAMPLE_POLYPHASE_FACTOR_MAX));
+    context->step = (context->nominal_step * factor) >> 16;
+    if (context->step == 0u){
+        context->step = 1u;
+    }
+}
+
+uint32_t btstack_resample_polyphase_get_max_output_frames(const btstack_resample_polyphase_t * context, uint32_t num_frames){
+    return (uint32_t)((((uint64_t) num_frames) << 32) / context->step) + 1u;
+}
+
+// multiply-accumulate input with two adjacent phases, acc: channel 0 phase 0/1, channel 1 phase 0/1
+
+#ifdef BTSTACK_RESAMPLE_POLYPHASE_SSE2
+
+static int32_t btstack_resample_polyphase_sum_sse2(__m128i v){
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+static void btstack_resample_polyphase_kernel_mono(const int16_t * x0, const int16_t * c0, const int16_t * c1, uint8_t num_taps, int32_t * acc){
+    __m128i acc_0_0 = _mm_setzero_si128();
+    __m128i acc_0_1 = _mm_setzero_si128();
+    uint8_t j;
+    for (j = 0; j < num_taps; j += 8u){
+        __m128i coefficients_0 = _mm_loadu_si128((const __m128i *) &c0[j]);
+        __m128i coefficients_1 = _mm_loadu_si128((const __m128i *) &c1[j]);
+        __m128i samples_0      = _mm_loadu_si128((const __m128i *) &x0[j]);
+        acc_0_0 = _mm_add_epi32(acc_0_0, _mm_madd_epi16(samples_0, coefficients_0));
+        acc_0_1 = _mm_add_epi32(acc_0_1, _mm_madd_epi16(samples_0, coefficients_1));
+    }
+    acc[0] = btstack_resample_polyphase_sum_sse2(acc_0_0);
+    acc[1] = btstack_resample_polyphase_sum_sse2(acc_0_1);
+}
+
+static void btstack_resample_polyphase_kernel_stereo(const int16_t * x0, const int16_t * x1, const int16_t * c0, const int16_t * c1, uint8_t num_taps, int32_t * acc){
+    __m128i acc_0_0 = _mm_setzero_si128();
+    __m128i acc_0_1 = _mm_setzero_si128();
+    __m128i acc_1_0 = _mm_setzero_si128();
+    __m128i acc_1_1 = _mm_setzero_si128();
+    uint8_t j;
+    for (j = 0; j < num_taps; j += 8u){
+        __m128i coefficients_0 = _mm_loadu_si128((const __m128i *) &c0[j]);
+        __m128i coefficients_1 = _mm_loadu_si128((const __m128i *) &c1[j]);
+        __m128i samples_0      = _mm_loadu_si128((const __m128i *) &x0[j]);
+        __m128i samples_1      = _mm_loadu_si128((const __m128i *) &x1[j]);
+        acc_0_0 = _mm_add_epi32(acc_0_0, _mm_madd_epi16(samples_0, coefficients_0));
+        acc_0_1 = _mm_add_epi32(acc_0_1, _mm_madd_epi16(samples_0, coefficients_1));
+        acc_1_0 = _mm_add_epi32(acc_1_0, _mm_madd_epi16(samples_1, coefficients_0));
+        acc_1_1 = _mm_add_epi32(acc_1_1, _mm_madd_epi16(samples_1, coefficients_1));
+    }
+    acc[0] = btstack_resample_polyphase_sum_sse2(acc_0_0);
+    acc[1] = btstack_resample_polyphase_sum_sse2(acc_0_1);
+    acc[2] = btstack_resample_polyphase_sum_sse2(acc_1_0);
+    acc[3] = btstack_resample_polyphase_sum_sse2(acc_1_1);
+}
+
+#elif defined(BTSTACK_RESAMPLE_POLYPHASE_NEON)
+
+static int32_t btstack_resample_polyphase_sum_neon(int32x4_t v){
+#if defined(__aarch64__)
+    return vaddvq_s32(v);
+#else
+    int32x2_t sum = vadd_s32(vget_low_s32(v), vget_high_s32(v));
+    sum = vpadd_s32(sum, sum);
+    return vget_lane_s32(sum, 0);
+#endif
+}
+
+static void btstack_resample_polyphase_kernel_mono(const int16_t * x0, const int16_t * c0, const int16_t * c1, uint8_t num_taps, int32_t * acc){
+    int32x4_t acc_0_0 = vdupq_n_s32(0);
+    int32x4_t acc_0_1 = vdupq_n_s32(0);
+    uint8_t j;
+    for (j = 0; j < num_taps; j += 4u){
+        int16x4_t coefficients_0 = vld1_s16(&c0[j]);
+        int16x4_t coefficients_1 = vld1_s16(&c1[j]);
+        int16x4_t samples_0      = vld1_s16(&x0[j]);
+        acc_0_0 = vmlal_s16(acc_0_0, samples_0, coefficients_0);
+        acc_0_1 = vmlal_s16(acc_0_1, samples_0, coefficients_1);
+    }
+    acc[0] = btstack_resample_polyphase_sum_neon(acc_0_0);
+    acc[1] = btstack_resample_polyphase_sum_neon(acc_0_1);
+}
+
+static void btstack_resample_polyphase_kernel_stereo(const int16_t * x0, const int16_t * x1, const int16_t * c0, const int16_t * c1, uint8_t num_taps, int32_t * acc){
+    int32x4_t acc_0_0 = vdupq_n_s32(0);
+    int32x4_t acc_0_1 = vdupq_n_s32(0);
+    int32x4_t acc_1_0 = vdupq_n_s32(0);
+    int32x4_t acc_1_1 = vdupq_n_s32(0);
+    uint8_t j;
+    for (j = 0; j < num_taps; j += 4u){
+        int16x4_t coefficients_0 = vld1_s16(&c0[j]);
+        int16x4_t coefficients_1 = vld1_s16(&c1[j]);
+        int16x4_t samples_0      = vld1_s16(&x0[j]);
+        int16x4_t samples_1      = vld1_s16(&x1[j]);
+        acc_0_0 = vmlal_s16(acc_0_0, samples_0, coefficients_0);
+        acc_0_1 = vmlal_s16(acc_0_1, samples_0, coefficients_1);
+        acc_1_0 = vmlal_s16(acc_1_0, samples_1, coefficients_0);
+        acc_1_1 = vmlal_s16(acc_1_1, samples_1, coefficients_1);
+    }
+    acc[0] = btstack_resample_polyphase_sum_neon(acc_0_0);
+    acc[1] = btstack_resample_polyphase_sum_neon(acc_0_1);
+    acc[2] = btstack_resample_polyphase_sum_neon(acc_1_0);
+    acc[3] = btstack_resample_polyphase_sum_neon(acc_1_1);
+}
+
+#else
+
+static void btstack_resample_polyphase_kernel_mono(const int16_t * x0, const int16_t * c0, const int16_t * c1, uint8_t num_taps, int32_t * acc){
+    int32_t acc_0_0 = 0;
+    int32_t acc_0_1 = 0;
+    uint8_t j;
+    for (j = 0; j < num_taps; j++){
+        acc_0_0 += x0[j] * c0[j];
+        acc_0_1 += x0[j] * c1[j];
+    }
+    acc[0] = acc_0_0;
+    acc[1] = acc_0_1;
+}
+
+static void btstack_resample_polyphase_kernel_stereo(const int16_t * x0, const int16_t * x1, const int16_t * c0, const int16_t * c1, uint8_t num_taps, int32_t * acc){
+    int32_t acc_0_0 = 0;
+    int32_t acc_0_1 = 0;
+    int32_t acc_1_0 = 0;
+    int32_t acc_1_1 = 0;
+    uint8_t j;
+    for (j = 0; j < num_taps; j++){
+        acc_0_0 += x0[j] * c0[j];
+        acc_0_1 += x0[j] * c1[j];
+        acc_1_0 += x1[j] * c0[j];
+        acc_1_1 += x1[j] * c1[j];
+    }
+    acc[0] = acc_0_0;
+    acc[1] = acc_0_1;
+    acc[2] = acc_1_0;
+    acc[3] = acc_1_1;
+}
+
+#endif
+
+static int16_t btstack_resample_polyphase_interpolate(int32_t acc_0, int32_t acc_1, int32_t weight){
+    const uint8_t shift = BTSTACK_RESAMPLE_POLYPHASE_COEFFICIENT_SHIFT + BTSTACK_RESAMPLE_POLYPHASE_WEIGHT_SHIFT;
+    int64_t value = ((int64_t) acc_0 * ((1 << BTSTACK_RESAMPLE_POLYPHASE_WEIGHT_SHIFT) - weight)) + ((int64_t) acc_1 * weight);
+    value = (value + (1LL << (shift - 1u))) >> shift;
+    if (value > INT16_MAX) return INT16_MAX;
+    if (value < INT16_MIN) return INT16_MIN;
+    return (int16_t) value;
+}
+
+uint32_t btstack_resample_polyphase_block(btstack_resample_polyphase_t * context, const int16_t * input_buffer, uint32_t num_frames, int16_t * output_buffer){
+    const btstack_resample_polyphase_filter_t * filter = context->filter;
+    const uint8_t num_taps     = filter->num_taps;
+    const uint8_t num_channels = context->num_channels;
+    uint32_t num_output_frames = 0;
+
+    while (num_frames > 0u){
+        // append chunk of input to non-interleaved history
+        uint16_t num_frames_to_copy = (uint16_t) btstack_min(num_frames, BTSTACK_RESAMPLE_POLYPHASE_HISTORY_SIZE - context->history_len);
+        uint16_t i;
+        uint8_t  channel;
+        for (i = 0; i < num_frames_to_copy; i++){
+            for (channel = 0; channel < num_channels; channel++){
+                context->history[channel][context->history_len + i] = *input_buffer++;
+            }
+        }
+        context->history_len += num_frames_to_copy;
+        num_frames -= num_frames_to_copy;
+
+        // generate output samples while all taps are available
+        while ((context->position_index + num_taps) <= context->history_len){
+            uint64_t phase_position = ((uint64_t) context->position_fraction) * BTSTACK_RESAMPLE_POLYPHASE_NUM_PHASES;
+            uint16_t phase  = (uint16_t)(phase_position >> 32);
+            int32_t  weight = (int32_t)((phase_position >> (32 - BTSTACK_RESAMPLE_POLYPHASE_WEIGHT_SHIFT)) & ((1u << BTSTACK_RESAMPLE_POLYPHASE_WEIGHT_SHIFT) - 1u));
+            const int16_t * coefficients_0 = filter->coefficients[phase];
+            const int16_t * coefficients_1 = filter->coefficients[phase + 1u];
+            int32_t acc[2 * BTSTACK_RESAMPLE_MAX_CHANNELS];
+            if (num_channels == 2u){
+                btstack_resample_polyphase_kernel_stereo(&context->history[0][context->position_index], &context->history[1][context->position_index],
+                                                         coefficients_0, coefficients_1, num_taps, acc);
+            } else {
+                btstack_resample_polyphase_kernel_mono(&context->history[0][context->position_index],
+                                                       coefficients_0, coefficients_1, num_taps, acc);
+            }
+            for (channel = 0; channel < num_channels; channel++){
+                *output_buffer++ = btstack_resample_polyphase_interpolate(acc[2u * channel], acc[(2u * channel) + 1u], weight);
+            }
+            num_output_frames++;
+
+            uint64_t position = ((uint64_t) context->position_fraction) + context->step;
+            context->position_fraction = (uint32_t) position;
+            context->position_index   += (uint32_t)(position >> 32);
+        }
+
+        // drop consumed input
+        uint16_t num_consumed = (uint16_t) btstack_min(context->position_index, context->history_len);
+        if (num_consumed > 0u){
+            for (channel = 0; channel < num_channels; channel++){
+                memmove(&context->history[channel][0], &context->history[channel][num_consumed], (context->history_len - num_consumed) * sizeof(int16_t));
+            }
+            context->history_len    -= num_consumed;
+            context->position_index -= num_consumed;
+        }
+    }
+    return num_output_frames;
+}
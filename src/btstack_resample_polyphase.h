@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/**
+ * @title Polyphase Resampling
+ *
+ * Band-limited resampling for 16-bit audio samples using a windowed-sinc polyphase filter.
+ *
+ * Supports arbitrary ratios between input and output sample rate, e.g. 44100 <-> 48000 Hz, with an
+ * additional 16.16 fixed point factor for clock drift compensation as provided by btstack_sample_rate_compensation.
+ * The position is tracked with 32-bit fractional precision, output samples are interpolated between adjacent
+ * filter phases. The filter table can be shared by multiple resampler instances.
+ *
+ * The filter kernel uses SSE2 or NEON if available and processes all channels of a block at once.
+ *
+ */
+
+#ifndef BTSTACK_RESAMPLE_POLYPHASE_H
+#define BTSTACK_RESAMPLE_POLYPHASE_H
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+
+#include "btstack_resample.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+// max number of filter taps, multiple of 8, max 64
+#ifndef BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS
+#define BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS 32
+#endif
+
+// number of filter phases, power of two
+#ifndef BTSTACK_RESAMPLE_POLYPHASE_NUM_PHASES
+#define BTSTACK_RESAMPLE_POLYPHASE_NUM_PHASES 128
+#endif
+
+// number of input frames copied into history buffer at once
+#define BTSTACK_RESAMPLE_POLYPHASE_CHUNK_SIZE 64
+
+// range of drift compensation factor, 0.5 - 2.0
+#define BTSTACK_RESAMPLE_POLYPHASE_FACTOR_MIN 0x08000u
+#define BTSTACK_RESAMPLE_POLYPHASE_FACTOR_MAX 0x20000u
+
+typedef struct {
+    uint8_t  num_taps;
+    // Q15 coefficients, one row per phase plus one for interpolation of last phase
+    int16_t  coefficients[BTSTACK_RESAMPLE_POLYPHASE_NUM_PHASES + 1][BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS];
+} btstack_resample_polyphase_filter_t;
+
+typedef struct {
+    const btstack_resample_polyphase_filter_t * filter;
+    uint8_t  num_channels;
+    // input samples per output sample as 32.32 fixed point value
+    uint64_t nominal_step;
+    uint64_t step;
+    // position of next output sample in history buffer
+    uint32_t position_index;
+    uint32_t position_fraction;
+    // non-interleaved input history
+    uint16_t history_len;
+    int16_t  history[BTSTACK_RESAMPLE_MAX_CHANNELS][BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS + BTSTACK_RESAMPLE_POLYPHASE_CHUNK_SIZE];
+} btstack_resample_polyphase_t;
+
+/* API_START */
+
+/**
+ * @brief Calculate windowed-sinc filter for given number of taps and sample rates
+ * @note more taps give better stop band attenuation and a wider pass band at the cost of CPU and latency
+ * @param filter
+ * @param num_taps multiple of 8, max BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS
+ * @param input_sample_rate
+ * @param output_sample_rate
+ * @return status ERROR_CODE_SUCCESS or ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS
+ */
+uint8_t btstack_resample_polyphase_filter_init(btstack_resample_polyphase_filter_t * filter, uint8_t num_taps,
+                                               uint32_t input_sample_rate, uint32_t output_sample_rate);
+
+/**
+ * @brief Init resample context
+ * @param context
+ * @param filter initialized with btstack_resample_polyphase_filter_init, must stay valid
+ * @param num_channels max BTSTACK_RESAMPLE_MAX_CHANNELS
+ * @param input_sample_rate
+ * @param output_sample_rate at most 4 times lower than input sample rate
+ * @return status ERROR_CODE_SUCCESS or ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS
+ */
+uint8_t btstack_resample_polyphase_init(btstack_resample_polyphase_t * context, const btstack_resample_polyphase_filter_t * filter,
+                                        uint8_t num_channels, uint32_t input_sample_rate, uint32_t output_sample_rate);
+
+/**
+ * @brief Set drift compensation factor, applied on top of the sample rate ratio
+ * @param context
+ * @param factor as 16.16 fixed point value, identity is 0x10000, > 0x10000 consumes input faster,
+ *        clamped to BTSTACK_RESAMPLE_POLYPHASE_FACTOR_MIN..BTSTACK_RESAMPLE_POLYPHASE_FACTOR_MAX
+ */
+void btstack_resample_polyphase_set_factor(btstack_resample_polyphase_t * context, uint32_t factor);
+
+/**
+ * @brief Get max number of output frames for given number of input frames with current factor
+ * @param context
+ * @param num_frames
+ * @return num output frames
+ */
+uint32_t btstack_resample_polyphase_get_max_output_frames(const btstack_resample_polyphase_t * context, uint32_t num_frames);
+
+/**
+ * @brief Process block of interleaved input samples
+ * @note output is delayed by num_taps / 2 input frames
+ * @param context
+ * @param input_buffer
+ * @param num_frames
+ * @param output_buffer for btstack_resample_polyphase_get_max_output_frames frames
+ * @return number of output frames
+ */
+uint32_t btstack_resample_polyphase_block(btstack_resample_polyphase_t * context, const int16_t * input_buffer, uint32_t num_frames, int16_t * output_buffer);
+
+/* API_END */
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // BTSTACK_RESAMPLE_POLYPHASE_H
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "btstack_spsc_ring_buffer.c"
+
+/*
+ *  btstack_spsc_ring_buffer.c
+ *
+ */
+
+#include <string.h>
+
+#include "btstack_config.h"
+#include "btstack_spsc_ring_buffer.h"
+#include "btstack_util.h"
+#include "bluetooth.h"
+
+// producer and consumer publish their own position with release and read the other one with acquire semantics
+#if defined(__GNUC__) || defined(__clang__)
+#define SPSC_LOAD_ACQUIRE(position)           __atomic_load_n(position, __ATOMIC_ACQUIRE)
+#define SPSC_STORE_RELEASE(position, value)   __atomic_store_n(position, value, __ATOMIC_RELEASE)
+#else
+#if !defined(BTSTACK_MEMORY_BARRIER) && defined(_MSC_VER)
+#include <windows.h>
+#define BTSTACK_MEMORY_BARRIER()              MemoryBarrier()
+#endif
+#if !defined(BTSTACK_MEMORY_BARRIER) && defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define BTSTACK_MEMORY_BARRIER()              atomic_thread_fence(memory_order_seq_cst)
+#endif
+#ifndef BTSTACK_MEMORY_BARRIER
+#error "btstack_spsc_ring_buffer requires GCC-style or C11 atomics, MSVC, or BTSTACK_MEMORY_BARRIER() in btstack_config.h"
+#endif
+// volatile access prevents caching of positions, barrier orders data access and position update
+static inline uint32_t spsc_load_acquire(const uint32_t * position){
+    uint32_t value = *(volatile const uint32_t *) position;
+    BTSTACK_MEMORY_BARRIER();
+    return value;
+}
+static inline void spsc_store_release(uint32_t * position, uint32_t value){
+    BTSTACK_MEMORY_BARRIER();
+    *(volatile uint32_t *) position = value;
+}
+#define SPSC_LOAD_ACQUIRE(position)           spsc_load_acquire(position)
+#define SPSC_STORE_RELEASE(position, value)   spsc_store_release(position, value)
+#endif
+
+void btstack_spsc_ring_buffer_init(btstack_spsc_ring_buffer_t * ring_buffer, uint8_t * storage, uint32_t storage_size){
+    // use largest power of two that fits into storage
+    uint32_t size = 1;
+    while (((size << 1) != 0u) && ((size << 1) <= storage_size)){
+        size <<= 1;
+    }
+    ring_buffer->storage = (storage_size == 0u) ? NULL : storage;
+    ring_buffer->mask = size - 1u;
+    btstack_spsc_ring_buffer_reset(ring_buffer);
+}
+
+void btstack_spsc_ring_buffer_reset(btstack_spsc_ring_buffer_t * ring_buffer){
+    ring_buffer->write_position = 0;
+    ring_buffer->read_position  = 0;
+}
+
+uint32_t btstack_spsc_ring_buffer_size(const btstack_spsc_ring_buffer_t * ring_buffer){
+    if (ring_buffer->storage == NULL) return 0;
+    return ring_buffer->mask + 1u;
+}
+
+uint32_t btstack_spsc_ring_buffer_bytes_available(const btstack_spsc_ring_buffer_t * ring_buffer){
+    // positions are free-running, unsigned difference handles wrap-around
+    uint32_t write_position = SPSC_LOAD_ACQUIRE(&ring_buffer->write_position);
+    return write_position - ring_buffer->read_position;
+}
+
+uint32_t btstack_spsc_ring_buffer_bytes_free(const btstack_spsc_ring_buffer_t * ring_buffer){
+    uint32_t read_position = SPSC_LOAD_ACQUIRE(&ring_buffer->read_position);
+    return btstack_spsc_ring_buffer_size(ring_buffer) - (ring_buffer->write_position - read_position);
+}
+
+uint8_t * btstack_spsc_ring_buffer_reserve(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t * span_length){
+    uint32_t offset = ring_buffer->write_position & ring_buffer->mask;
+    uint32_t bytes_until_end = btstack_spsc_ring_buffer_size(ring_buffer) - offset;
+    *span_length = btstack_min(bytes_until_end, btstack_spsc_ring_buffer_bytes_free(ring_buffer));
+    return &ring_buffer->storage[offset];
+}
+
+void btstack_spsc_ring_buffer_commit(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t length){
+    SPSC_STORE_RELEASE(&ring_buffer->write_position, ring_buffer->write_position + length);
+}
+
+const uint8_t * btstack_spsc_ring_buffer_peek(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t * span_length){
+    uint32_t offset = ring_buffer->read_position & ring_buffer->mask;
+    uint32_t bytes_until_end = btstack_spsc_ring_buffer_size(ring_buffer) - offset;
+    *span_length = btstack_min(bytes_until_end, btstack_spsc_ring_buffer_bytes_available(ring_buffer));
+    return &ring_buffer->storage[offset];
+}
+
+void btstack_spsc_ring_buffer_consume(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t length){
+    SPSC_STORE_RELEASE(&ring_buffer->read_position, ring_buffer->read_position + length);
+}
+
+int btstack_spsc_ring_buffer_write(btstack_spsc_ring_buffer_t * ring_buffer, const uint8_t * data, uint32_t data_length){
+    if (btstack_spsc_ring_buffer_bytes_free(ring_buffer) < data_length){
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+
+    // copy up to two chunks, publish once
+    uint32_t bytes_written = 0;
+    while (bytes_written < data_length){
+        uint32_t offset = (ring_buffer->write_position + bytes_written) & ring_buffer->mask;
+        uint32_t bytes_to_copy = btstack_min(btstack_spsc_ring_buffer_size(ring_buffer) - offset, data_length - bytes_written);
+        (void)memcpy(&ring_buffer->storage[offset], &data[bytes_written], bytes_to_copy);
+        bytes_written += bytes_to_copy;
+    }
+    btstack_spsc_ring_buffer_commit(ring_buffer, data_length);
+    return ERROR_CODE_SUCCESS;
+}
+
+void btstack_spsc_ring_buffer_read(btstack_spsc_ring_buffer_t * ring_buffer, uint8_t * data, uint32_t data_length, uint32_t * number_of_bytes_read){
+    // limit data to get and report
+    uint32_t length = btstack_min(data_length, btstack_spsc_ring_buffer_bytes_available(ring_buffer));
+    *number_of_bytes_read = length;
+
+    // copy up to two chunks, release once
+    uint32_t bytes_read = 0;
+    while (bytes_read < length){
+        uint32_t offset = (ring_buffer->read_position + bytes_read) & ring_buffer->mask;
+        uint32_t bytes_to_copy = btstack_min(btstack_spsc_ring_buffer_size(ring_buffer) - offset, length - bytes_read);
+        (void)memcpy(&data[bytes_read], &ring_buffer->storage[offset], bytes_to_copy);
+        bytes_read += bytes_to_copy;
+    }
+    btstack_spsc_ring_buffer_consume(ring_buffer, length);
+}
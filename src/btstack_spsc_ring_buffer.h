@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/**
+ * @title SPSC Ring Buffer
+ *
+ * Lock-free ring buffer for a single producer and a single consumer running in different
+ * execution contexts, e.g. run loop and audio callback thread or interrupt handler.
+ *
+ * Read and write positions are free-running counters owned by consumer and producer respectively.
+ * Each side publishes its position with release semantics and reads the other one with acquire
+ * semantics, so neither side ever blocks or retries. Storage size has to be a power of two.
+ *
+ * Besides copying read and write functions, reserve/commit and peek/consume provide direct access
+ * to the contiguous part of the storage to avoid an additional copy.
+ */
+
+#ifndef BTSTACK_SPSC_RING_BUFFER_H
+#define BTSTACK_SPSC_RING_BUFFER_H
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef struct btstack_spsc_ring_buffer {
+    uint8_t  * storage;
+    uint32_t   mask;
+    // written by producer only
+    uint32_t   write_position;
+    // written by consumer only
+    uint32_t   read_position;
+} btstack_spsc_ring_buffer_t;
+
+/* API_START */
+
+/**
+ * Init ring buffer
+ * @note if storage_size is not a power of two, only the largest power of two below storage_size is used
+ * @param ring_buffer object
+ * @param storage
+ * @param storage_size in bytes
+ */
+void btstack_spsc_ring_buffer_init(btstack_spsc_ring_buffer_t * ring_buffer, uint8_t * storage, uint32_t storage_size);
+
+/**
+ * Reset ring buffer to initial state (empty)
+ * @note must not be called while producer or consumer are active
+ * @param ring_buffer object
+ */
+void btstack_spsc_ring_buffer_reset(btstack_spsc_ring_buffer_t * ring_buffer);
+
+/**
+ * Get usable storage size
+ * @param ring_buffer object
+ * @return size in bytes
+ */
+uint32_t btstack_spsc_ring_buffer_size(const btstack_spsc_ring_buffer_t * ring_buffer);
+
+/**
+ * Get number of bytes available for read
+ * @note consumer side, snapshot that can only grow until consumer reads
+ * @param ring_buffer object
+ * @return number of bytes available for read
+ */
+uint32_t btstack_spsc_ring_buffer_bytes_available(const btstack_spsc_ring_buffer_t * ring_buffer);
+
+/**
+ * Get free space available for write
+ * @note producer side, snapshot that can only grow until producer writes
+ * @param ring_buffer object
+ * @return number of bytes available for write
+ */
+uint32_t btstack_spsc_ring_buffer_bytes_free(const btstack_spsc_ring_buffer_t * ring_buffer);
+
+/**
+ * Get contiguous free space for zero-copy write, producer side
+ * @param ring_buffer object
+ * @param span_length number of bytes that can be written at returned address
+ * @return start of free space
+ */
+uint8_t * btstack_spsc_ring_buffer_reserve(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t * span_length);
+
+/**
+ * Make data written into reserved span available to consumer, producer side
+ * @param ring_buffer object
+ * @param length has to be less or equal to span_length returned by btstack_spsc_ring_buffer_reserve
+ */
+void btstack_spsc_ring_buffer_commit(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t length);
+
+/**
+ * Get contiguous data for zero-copy read, consumer side
+ * @param ring_buffer object
+ * @param span_length number of bytes that can be read at returned address
+ * @return start of available data
+ */
+const uint8_t * btstack_spsc_ring_buffer_peek(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t * span_length);
+
+/**
+ * Release data read from peeked span to producer, consumer side
+ * @param ring_buffer object
+ * @param length has to be less or equal to span_length returned by btstack_spsc_ring_buffer_peek
+ */
+void btstack_spsc_ring_buffer_consume(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t length);
+
+/**
+ * Write bytes into ring buffer, producer side
+ * @param ring_buffer object
+ * @param data to store
+ * @param data_length
+ * @return 0 if ok, ERROR_CODE_MEMORY_CAPACITY_EXCEEDED if not enough space in buffer
+ */
+int btstack_spsc_ring_buffer_write(btstack_spsc_ring_buffer_t * ring_buffer, const uint8_t * data, uint32_t data_length);
+
+/**
+ * Read from ring buffer, consumer side
+ * @param ring_buffer object
+ * @param buffer to store read data
+ * @param length to read
+ * @param number_of_bytes_read
+ */
+void btstack_spsc_ring_buffer_read(btstack_spsc_ring_buffer_t * ring_buffer, uint8_t * buffer, uint32_t length, uint32_t * number_of_bytes_read);
+
+/* API_END */
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // BTSTACK_SPSC_RING_BUFFER_H
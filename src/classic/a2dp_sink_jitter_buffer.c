@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "a2dp_sink_jitter_buffer.c"
+
+#include <string.h>
+
+#include "classic/a2dp_sink_jitter_buffer.h"
+
+#include "bluetooth.h"
+#include "btstack_debug.h"
+#include "btstack_util.h"
+
+// default latency targets, as used by a2dp_sink_demo for SBC @ 44.1 kHz: 60 - 80 frames
+#define A2DP_SINK_JITTER_BUFFER_DEFAULT_LATENCY_MIN_MS 170
+#define A2DP_SINK_JITTER_BUFFER_DEFAULT_LATENCY_MAX_MS 230
+
+// max number of lost frames that are concealed for a single gap in the RTP sequence
+#define A2DP_SINK_JITTER_BUFFER_MAX_CONCEALED_FRAMES   16
+
+// buffer level based drift compensation: nominal factor (fixed-point 2^16) and compensation offset
+#define A2DP_SINK_JITTER_BUFFER_RESAMPLE_NOMINAL       0x10000
+#define A2DP_SINK_JITTER_BUFFER_RESAMPLE_COMPENSATION  0x00100
+
+// header of stored frame
+#define A2DP_SINK_JITTER_BUFFER_FRAME_HEADER_SIZE      2
+
+static uint16_t a2dp_sink_jitter_buffer_frames_for_ms(const a2dp_sink_jitter_buffer_t * jitter_buffer, uint16_t latency_ms){
+    uint32_t num_frames = (((uint32_t) latency_ms * jitter_buffer->sample_rate) / 1000u) / jitter_buffer->samples_per_frame;
+    return (uint16_t) btstack_min(num_frames, 0xffffu);
+}
+
+uint8_t a2dp_sink_jitter_buffer_init(a2dp_sink_jitter_buffer_t * jitter_buffer, uint8_t * frame_storage, uint32_t frame_storage_size,
+                                     uint32_t sample_rate, uint8_t num_channels, uint16_t samples_per_frame,
+                                     a2dp_sink_jitter_buffer_decode_t decode, void * context){
+    if ((num_channels == 0u) || (num_channels > BTSTACK_RESAMPLE_MAX_CHANNELS)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+    if ((samples_per_frame == 0u) || (samples_per_frame > A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+    if ((sample_rate == 0u) || (decode == NULL)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+
+    memset(jitter_buffer, 0, sizeof(a2dp_sink_jitter_buffer_t));
+    jitter_buffer->sample_rate = sample_rate;
+    jitter_buffer->num_channels = num_channels;
+    jitter_buffer->samples_per_frame = samples_per_frame;
+    jitter_buffer->decode = decode;
+    jitter_buffer->context = context;
+    btstack_ring_buffer_init(&jitter_buffer->frame_buffer, frame_storage, frame_storage_size);
+    btstack_ring_buffer_init(&jitter_buffer->pcm_buffer, jitter_buffer->pcm_storage, sizeof(jitter_buffer->pcm_storage));
+    a2dp_sink_jitter_buffer_set_latency(jitter_buffer, A2DP_SINK_JITTER_BUFFER_DEFAULT_LATENCY_MIN_MS, A2DP_SINK_JITTER_BUFFER_DEFAULT_LATENCY_MAX_MS);
+    a2dp_sink_jitter_buffer_reset(jitter_buffer);
+    return ERROR_CODE_SUCCESS;
+}
+
+void a2dp_sink_jitter_buffer_set_latency(a2dp_sink_jitter_buffer_t * jitter_buffer, uint16_t latency_min_ms, uint16_t latency_max_ms){
+    jitter_buffer->frames_min = btstack_max(1, a2dp_sink_jitter_buffer_frames_for_ms(jitter_buffer, latency_min_ms));
+    jitter_buffer->frames_max = btstack_max(jitter_buffer->frames_min, a2dp_sink_jitter_buffer_frames_for_ms(jitter_buffer, latency_max_ms));
+    log_info("jitter buffer %p: target %u - %u frames", jitter_buffer, jitter_buffer->frames_min, jitter_buffer->frames_max);
+}
+
+void a2dp_sink_jitter_buffer_set_playback_sample_rate_callback(a2dp_sink_jitter_buffer_t * jitter_buffer, a2dp_sink_jitter_buffer_playback_sample_rate_t callback){
+    jitter_buffer->playback_sample_rate = callback;
+}
+
+void a2dp_sink_jitter_buffer_reset(a2dp_sink_jitter_buffer_t * jitter_buffer){
+    btstack_ring_buffer_reset(&jitter_buffer->frame_buffer);
+    btstack_ring_buffer_reset(&jitter_buffer->pcm_buffer);
+    btstack_resample_init(&jitter_buffer->resample, jitter_buffer->num_channels);
+    jitter_buffer->num_frames_buffered = 0;
+    jitter_buffer->plc_num_samples = 0;
+    jitter_buffer->plc_attenuation = 0;
+    jitter_buffer->sample_rate_compensation_active = false;
+    jitter_buffer->playing = false;
+    jitter_buffer->sequence_number_valid = false;
+}
+
+static void a2dp_sink_jitter_buffer_drop_oldest_frame(a2dp_sink_jitter_buffer_t * jitter_buffer){
+    uint8_t  buffer[A2DP_SINK_JITTER_BUFFER_MAX_FRAME_SIZE];
+    uint32_t bytes_read;
+    btstack_ring_buffer_read(&jitter_buffer->frame_buffer, buffer, A2DP_SINK_JITTER_BUFFER_FRAME_HEADER_SIZE, &bytes_read);
+    uint16_t frame_len = little_endian_read_16(buffer, 0);
+    btstack_ring_buffer_read(&jitter_buffer->frame_buffer, buffer, frame_len, &bytes_read);
+    jitter_buffer->num_frames_buffered--;
+    jitter_buffer->statistics.frames_dropped++;
+}
+
+static void a2dp_sink_jitter_buffer_store_frame(a2dp_sink_jitter_buffer_t * jitter_buffer, const uint8_t * frame, uint16_t frame_len){
+    uint32_t bytes_needed = A2DP_SINK_JITTER_BUFFER_FRAME_HEADER_SIZE + frame_len;
+    if (bytes_needed > jitter_buffer->frame_buffer.size) return;
+
+    // drop oldest frames on overrun to keep latency bounded
+    if (btstack_ring_buffer_bytes_free(&jitter_buffer->frame_buffer) < bytes_needed){
+        jitter_buffer->statistics.overruns++;
+        while (btstack_ring_buffer_bytes_free(&jitter_buffer->frame_buffer) < bytes_needed){
+            a2dp_sink_jitter_buffer_drop_oldest_frame(jitter_buffer);
+        }
+    }
+
+    uint8_t header[A2DP_SINK_JITTER_BUFFER_FRAME_HEADER_SIZE];
+    little_endian_store_16(header, 0, frame_len);
+    btstack_ring_buffer_write(&jitter_buffer->frame_buffer, header, sizeof(header));
+    if (frame_len > 0u){
+        btstack_ring_buffer_write(&jitter_buffer->frame_buffer, (uint8_t *) frame, frame_len);
+    }
+    jitter_buffer->num_frames_buffered++;
+}
+
+static void a2dp_sink_jitter_buffer_update_resampling_factor(a2dp_sink_jitter_buffer_t * jitter_buffer, uint32_t timestamp_ms, uint8_t num_frames){
+    uint32_t resampling_factor;
+
+    // use measured playback sample rate if available
+    uint32_t playback_sample_rate = 0;
+    if (jitter_buffer->playback_sample_rate != NULL){
+        playback_sample_rate = (*jitter_buffer->playback_sample_rate)(jitter_buffer->context);
+    }
+    if (playback_sample_rate != 0u){
+        if (jitter_buffer->sample_rate_compensation_active == false){
+            jitter_buffer->sample_rate_compensation_active = true;
+            btstack_sample_rate_compensation_init(&jitter_buffer->sample_rate_compensation, timestamp_ms, jitter_buffer->sample_rate, FLOAT_TO_Q15(1.f));
+        }
+        resampling_factor = btstack_sample_rate_compensation_update(&jitter_buffer->sample_rate_compensation, timestamp_ms,
+                                                                    num_frames * jitter_buffer->samples_per_frame, playback_sample_rate);
+    } else {
+        // otherwise, decide on drift based on number of frames in queue
+        if (jitter_buffer->num_frames_buffered < jitter_buffer->frames_min){
+            resampling_factor = A2DP_SINK_JITTER_BUFFER_RESAMPLE_NOMINAL - A2DP_SINK_JITTER_BUFFER_RESAMPLE_COMPENSATION;  // stretch samples
+        } else if (jitter_buffer->num_frames_buffered <= jitter_buffer->frames_max){
+            resampling_factor = A2DP_SINK_JITTER_BUFFER_RESAMPLE_NOMINAL;                                                  // nothing to do
+        } else {
+            resampling_factor = A2DP_SINK_JITTER_BUFFER_RESAMPLE_NOMINAL + A2DP_SINK_JITTER_BUFFER_RESAMPLE_COMPENSATION;  // compress samples
+        }
+    }
+    btstack_resample_set_factor(&jitter_buffer->resample, resampling_factor);
+}
+
+uint8_t a2dp_sink_jitter_buffer_write_frames(a2dp_sink_jitter_buffer_t * jitter_buffer, uint32_t timestamp_ms, uint16_t sequence_number,
+                                             const uint8_t * frames, uint16_t frames_len, uint8_t num_frames){
+    if ((num_frames == 0u) || ((frames_len % num_frames) != 0u)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+    uint16_t frame_len = frames_len / num_frames;
+    if ((frame_len == 0u) || (frame_len > A2DP_SINK_JITTER_BUFFER_MAX_FRAME_SIZE)){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+
+    // detect lost media packets and queue lost frames for concealment
+    if (jitter_buffer->sequence_number_valid){
+        uint16_t num_packets_lost = sequence_number - jitter_buffer->sequence_number - 1u;
+        // ignore reordered or duplicate packets
+        if (num_packets_lost >= 0x8000u){
+            return ERROR_CODE_SUCCESS;
+        }
+        if (num_packets_lost > 0u){
+            uint32_t num_frames_lost = (uint32_t) num_packets_lost * num_frames;
+            log_info("jitter buffer %p: %u packets lost", jitter_buffer, num_packets_lost);
+            jitter_buffer->statistics.frames_lost += num_frames_lost;
+            if (jitter_buffer->playing){
+                uint32_t i;
+                for (i = 0; i < btstack_min(num_frames_lost, A2DP_SINK_JITTER_BUFFER_MAX_CONCEALED_FRAMES); i++){
+                    a2dp_sink_jitter_buffer_store_frame(jitter_buffer, NULL, 0);
+                }
+            }
+        }
+    }
+    jitter_buffer->sequence_number_valid = true;
+    jitter_buffer->sequence_number = sequence_number;
+
+    // store frames
+    uint8_t i;
+    for (i = 0; i < num_frames; i++){
+        a2dp_sink_jitter_buffer_store_frame(jitter_buffer, &frames[i * frame_len], frame_len);
+    }
+    jitter_buffer->statistics.frames_received += num_frames;
+
+    if (jitter_buffer->playing){
+        a2dp_sink_jitter_buffer_update_resampling_factor(jitter_buffer, timestamp_ms, num_frames);
+    } else if (jitter_buffer->num_frames_buffered >= jitter_buffer->frames_min){
+        // start playback if enough frames buffered
+        log_info("jitter buffer %p: start playback with %u frames", jitter_buffer, jitter_buffer->num_frames_buffered);
+        jitter_buffer->playing = true;
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+bool a2dp_sink_jitter_buffer_is_playing(const a2dp_sink_jitter_buffer_t * jitter_buffer){
+    return jitter_buffer->playing;
+}
+
+// decode next frame or conceal lost one, returns number of audio frames
+static uint16_t a2dp_sink_jitter_buffer_decode_next_frame(a2dp_sink_jitter_buffer_t * jitter_buffer, int16_t * pcm_buffer){
+    uint8_t  frame[A2DP_SINK_JITTER_BUFFER_MAX_FRAME_SIZE];
+    uint32_t bytes_read;
+    btstack_ring_buffer_read(&jitter_buffer->frame_buffer, frame, A2DP_SINK_JITTER_BUFFER_FRAME_HEADER_SIZE, &bytes_read);
+    uint16_t frame_len = little_endian_read_16(frame, 0);
+    btstack_ring_buffer_read(&jitter_buffer->frame_buffer, frame, frame_len, &bytes_read);
+    jitter_buffer->num_frames_buffered--;
+
+    uint16_t num_samples;
+    if (frame_len > 0u){
+        num_samples = (*jitter_buffer->decode)(jitter_buffer->context, frame, frame_len, pcm_buffer);
+        if (num_samples > 0u){
+            jitter_buffer->statistics.frames_decoded++;
+            // keep copy for concealment
+            uint16_t num_values = num_samples * jitter_buffer->num_channels;
+            (void)memcpy(jitter_buffer->plc_buffer, pcm_buffer, num_values * sizeof(int16_t));
+            jitter_buffer->plc_num_samples = num_samples;
+            jitter_buffer->plc_attenuation = 0;
+            return num_samples;
+        }
+    }
+
+    // lost or corrupt frame: ask codec first
+    jitter_buffer->statistics.frames_concealed++;
+    num_samples = (*jitter_buffer->decode)(jitter_buffer->context, NULL, 0, pcm_buffer);
+    if (num_samples > 0u){
+        return num_samples;
+    }
+
+    // repeat last decoded frame with 6 dB attenuation per concealed frame
+    num_samples = jitter_buffer->plc_num_samples;
+    if (num_samples == 0u){
+        num_samples = jitter_buffer->samples_per_frame;
+    }
+    if (jitter_buffer->plc_attenuation < 15u){
+        jitter_buffer->plc_attenuation++;
+    }
+    uint16_t num_values = num_samples * jitter_buffer->num_channels;
+    uint16_t i;
+    for (i = 0; i < num_values; i++){
+        if (jitter_buffer->plc_num_samples == 0u){
+            pcm_buffer[i] = 0;
+        } else {
+            pcm_buffer[i] = jitter_buffer->plc_buffer[i] >> jitter_buffer->plc_attenuation;
+        }
+    }
+    return num_samples;
+}
+
+void a2dp_sink_jitter_buffer_read_audio(a2dp_sink_jitter_buffer_t * jitter_buffer, int16_t * buffer, uint16_t num_audio_frames){
+    const uint16_t bytes_per_audio_frame = 2u * jitter_buffer->num_channels;
+
+    if (jitter_buffer->playing == false){
+        memset(buffer, 0, num_audio_frames * bytes_per_audio_frame);
+        return;
+    }
+
+    // first fill from resampled audio
+    uint32_t bytes_read;
+    btstack_ring_buffer_read(&jitter_buffer->pcm_buffer, (uint8_t *) buffer, num_audio_frames * bytes_per_audio_frame, &bytes_read);
+    buffer           += bytes_read / 2u;
+    num_audio_frames -= bytes_read / bytes_per_audio_frame;
+
+    // then decode frames on demand
+    while (num_audio_frames > 0u){
+        if (jitter_buffer->num_frames_buffered == 0u){
+            // underrun: play silence and re-buffer
+            log_info("jitter buffer %p: underrun", jitter_buffer);
+            jitter_buffer->statistics.underruns++;
+            jitter_buffer->playing = false;
+            jitter_buffer->sample_rate_compensation_active = false;
+            memset(buffer, 0, num_audio_frames * bytes_per_audio_frame);
+            return;
+        }
+
+        int16_t  decoded_buffer[A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME * BTSTACK_RESAMPLE_MAX_CHANNELS];
+        uint16_t decoded_frames = a2dp_sink_jitter_buffer_decode_next_frame(jitter_buffer, decoded_buffer);
+        if (decoded_frames == 0u) continue;
+
+        // resample, keep some additional space for stretching
+        int16_t  resampled_buffer[(A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME + A2DP_SINK_JITTER_BUFFER_RESAMPLE_HEADROOM) * BTSTACK_RESAMPLE_MAX_CHANNELS];
+        uint16_t resampled_frames = btstack_resample_block(&jitter_buffer->resample, decoded_buffer, decoded_frames, resampled_buffer);
+
+        // store data in playback buffer first
+        uint16_t frames_to_copy = btstack_min(resampled_frames, num_audio_frames);
+        (void)memcpy(buffer, resampled_buffer, frames_to_copy * bytes_per_audio_frame);
+        buffer           += frames_to_copy * jitter_buffer->num_channels;
+        num_audio_frames -= frames_to_copy;
+
+        // and rest in ring buffer
+        uint16_t frames_to_store = resampled_frames - frames_to_copy;
+        if (frames_to_store > 0u){
+            int status = btstack_ring_buffer_write(&jitter_buffer->pcm_buffer,
+                                                   (uint8_t *) &resampled_buffer[frames_to_copy * jitter_buffer->num_channels],
+                                                   frames_to_store * bytes_per_audio_frame);
+            if (status != ERROR_CODE_SUCCESS){
+                log_error("jitter buffer %p: PCM buffer full", jitter_buffer);
+            }
+        }
+    }
+}
+
+uint16_t a2dp_sink_jitter_buffer_get_num_frames_buffered(const a2dp_sink_jitter_buffer_t * jitter_buffer){
+    return jitter_buffer->num_frames_buffered;
+}
+
+const a2dp_sink_jitter_buffer_statistics_t * a2dp_sink_jitter_buffer_get_statistics(const a2dp_sink_jitter_buffer_t * jitter_buffer){
+    return &jitter_buffer->statistics;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+/**
+ * @title A2DP Sink Jitter Buffer
+ *
+ * Buffers received media frames of an A2DP Sink stream, decodes them on demand from the audio playback
+ * callback and compensates clock drift between A2DP Source and local audio playback by resampling.
+ *
+ * Each stream uses its own a2dp_sink_jitter_buffer_t context. The codec is provided by the application
+ * via a decode callback, which is also asked to conceal lost frames. If the codec does not provide
+ * packet loss concealment, the last decoded frame is repeated with decreasing volume.
+ *
+ * Playback starts when latency_min_ms of audio is buffered. While playing, the buffer level is kept
+ * between latency_min_ms and latency_max_ms by slightly stretching or compressing the decoded audio.
+ * If the audio driver reports the effective playback sample rate, btstack_sample_rate_compensation
+ * is used instead.
+ */
+
+#ifndef A2DP_SINK_JITTER_BUFFER_H
+#define A2DP_SINK_JITTER_BUFFER_H
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+
+#include "btstack_bool.h"
+#include "btstack_resample.h"
+#include "btstack_ring_buffer.h"
+#include "btstack_sample_rate_compensation.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+// max size of a single encoded media frame
+#ifndef A2DP_SINK_JITTER_BUFFER_MAX_FRAME_SIZE
+#define A2DP_SINK_JITTER_BUFFER_MAX_FRAME_SIZE 128
+#endif
+
+// max number of audio frames (samples per channel) decoded from a single media frame, 128 for SBC
+#ifndef A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME
+#define A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME 128
+#endif
+
+// additional audio frames produced by resampler
+#define A2DP_SINK_JITTER_BUFFER_RESAMPLE_HEADROOM (A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME / 8)
+
+/**
+ * @brief Decode single media frame into interleaved PCM samples in host endianess
+ * @param context provided in a2dp_sink_jitter_buffer_init
+ * @param frame media frame or NULL if frame was lost and should be concealed
+ * @param frame_len
+ * @param pcm_buffer for A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME audio frames
+ * @return number of decoded audio frames, or 0 if frame could not be decoded/concealed
+ */
+typedef uint16_t (*a2dp_sink_jitter_buffer_decode_t)(void * context, const uint8_t * frame, uint16_t frame_len, int16_t * pcm_buffer);
+
+/**
+ * @brief Get effective sample rate of audio playback
+ * @param context provided in a2dp_sink_jitter_buffer_init
+ * @return sample rate in Hz or 0 if not known
+ */
+typedef uint32_t (*a2dp_sink_jitter_buffer_playback_sample_rate_t)(void * context);
+
+typedef struct {
+    uint32_t frames_received;
+    uint32_t frames_decoded;
+    // frames missing in RTP sequence
+    uint32_t frames_lost;
+    // frames generated by packet loss concealment
+    uint32_t frames_concealed;
+    // playback requested more audio than buffered, stream is re-buffered
+    uint32_t underruns;
+    // oldest frames dropped as buffer was full
+    uint32_t overruns;
+    uint32_t frames_dropped;
+} a2dp_sink_jitter_buffer_statistics_t;
+
+typedef struct {
+    // configuration
+    uint32_t sample_rate;
+    uint8_t  num_channels;
+    uint16_t samples_per_frame;
+    uint16_t frames_min;
+    uint16_t frames_max;
+    a2dp_sink_jitter_buffer_decode_t decode;
+    a2dp_sink_jitter_buffer_playback_sample_rate_t playback_sample_rate;
+    void * context;
+
+    // encoded frames, each prefixed by little-endian 16-bit length, 0 = lost frame
+    btstack_ring_buffer_t frame_buffer;
+    uint16_t num_frames_buffered;
+
+    // decoded audio not consumed by last playback request
+    btstack_ring_buffer_t pcm_buffer;
+    uint8_t  pcm_storage[(A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME + A2DP_SINK_JITTER_BUFFER_RESAMPLE_HEADROOM) * BTSTACK_RESAMPLE_MAX_CHANNELS * 2];
+
+    // last decoded audio for packet loss concealment
+    int16_t  plc_buffer[A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME * BTSTACK_RESAMPLE_MAX_CHANNELS];
+    uint16_t plc_num_samples;
+    uint8_t  plc_attenuation;
+
+    // drift compensation
+    btstack_resample_t resample;
+    btstack_sample_rate_compensation_t sample_rate_compensation;
+    bool     sample_rate_compensation_active;
+
+    // state
+    bool     playing;
+    bool     sequence_number_valid;
+    uint16_t sequence_number;
+
+    a2dp_sink_jitter_buffer_statistics_t statistics;
+} a2dp_sink_jitter_buffer_t;
+
+/* API_START */
+
+/**
+ * @brief Init jitter buffer for a single A2DP Sink stream
+ * @param jitter_buffer
+ * @param frame_storage for encoded media frames, each frame uses 2 additional bytes
+ * @param frame_storage_size
+ * @param sample_rate of stream
+ * @param num_channels of stream, 1 or 2
+ * @param samples_per_frame number of audio frames in media frame, max A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME
+ * @param decode callback
+ * @param context for callbacks
+ * @return status ERROR_CODE_SUCCESS or ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS
+ */
+uint8_t a2dp_sink_jitter_buffer_init(a2dp_sink_jitter_buffer_t * jitter_buffer, uint8_t * frame_storage, uint32_t frame_storage_size,
+                                     uint32_t sample_rate, uint8_t num_channels, uint16_t samples_per_frame,
+                                     a2dp_sink_jitter_buffer_decode_t decode, void * context);
+
+/**
+ * @brief Set latency targets. Playback starts at latency_min_ms, buffer level is kept between both values
+ * @note default: 170 - 230 ms
+ * @param jitter_buffer
+ * @param latency_min_ms
+ * @param latency_max_ms
+ */
+void a2dp_sink_jitter_buffer_set_latency(a2dp_sink_jitter_buffer_t * jitter_buffer, uint16_t latency_min_ms, uint16_t latency_max_ms);
+
+/**
+ * @brief Use effective playback sample rate for drift compensation instead of buffer level
+ * @param jitter_buffer
+ * @param callback
+ */
+void a2dp_sink_jitter_buffer_set_playback_sample_rate_callback(a2dp_sink_jitter_buffer_t * jitter_buffer, a2dp_sink_jitter_buffer_playback_sample_rate_t callback);
+
+/**
+ * @brief Discard buffered audio and stop playback until enough frames have been received
+ * @param jitter_buffer
+ */
+void a2dp_sink_jitter_buffer_reset(a2dp_sink_jitter_buffer_t * jitter_buffer);
+
+/**
+ * @brief Store media frames from a single media packet
+ * @param jitter_buffer
+ * @param timestamp_ms of reception
+ * @param sequence_number from RTP header, used to detect lost packets
+ * @param frames with num_frames media frames of equal size, e.g. SBC frames of a media packet
+ * @param frames_len
+ * @param num_frames
+ * @return status ERROR_CODE_SUCCESS or ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS
+ */
+uint8_t a2dp_sink_jitter_buffer_write_frames(a2dp_sink_jitter_buffer_t * jitter_buffer, uint32_t timestamp_ms, uint16_t sequence_number,
+                                             const uint8_t * frames, uint16_t frames_len, uint8_t num_frames);
+
+/**
+ * @brief Check if enough audio is buffered to start or continue playback
+ * @param jitter_buffer
+ * @return true if playing
+ */
+bool a2dp_sink_jitter_buffer_is_playing(const a2dp_sink_jitter_buffer_t * jitter_buffer);
+
+/**
+ * @brief Fill buffer with decoded audio, to be called from btstack_audio playback callback
+ * @note fills with silence while not playing
+ * @param jitter_buffer
+ * @param buffer for interleaved samples
+ * @param num_audio_frames
+ */
+void a2dp_sink_jitter_buffer_read_audio(a2dp_sink_jitter_buffer_t * jitter_buffer, int16_t * buffer, uint16_t num_audio_frames);
+
+/**
+ * @brief Get number of buffered media frames
+ * @param jitter_buffer
+ * @return num frames
+ */
+uint16_t a2dp_sink_jitter_buffer_get_num_frames_buffered(const a2dp_sink_jitter_buffer_t * jitter_buffer);
+
+/**
+ * @brief Get statistics
+ * @param jitter_buffer
+ * @return statistics
+ */
+const a2dp_sink_jitter_buffer_statistics_t * a2dp_sink_jitter_buffer_get_statistics(const a2dp_sink_jitter_buffer_t * jitter_buffer);
+
+/* API_END */
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // A2DP_SINK_JITTER_BUFFER_H
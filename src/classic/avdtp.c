@@ -54,6 +54,11 @@
 #include "classic/sdp_client.h"
 #include "classic/sdp_util.h"
 
+// SDP query state is kept in globals, parallel queries would overwrite it
+#if MAX_NR_SDP_CLIENT_CONTEXTS > 1
+#error "AVDTP does not support MAX_NR_SDP_CLIENT_CONTEXTS > 1"
+#endif
+
 // higher layer callbacks
 static btstack_packet_handler_t avdtp_source_callback;
 static btstack_packet_handler_t avdtp_sink_callback;
@@ -308,7 +313,7 @@ static void avdtp_handle_start_sdp_client_query(void * context){
         }
         avdtp_sdp_query_context_avdtp_cid = connection->avdtp_cid;
         avdtp_record_id = -1;
-        sdp_client_query_uuid16(&avdtp_handle_sdp_client_query_result, (uint8_t *) connection->remote_addr, uuid);
+        sdp_client_query_uuid16_chunked(&avdtp_handle_sdp_client_query_result, (uint8_t *) connection->remote_addr, uuid);
         return;
     }
 }
@@ -563,17 +568,20 @@ static void avdtp_handle_sdp_client_query_attribute_value(avdtp_connection_t * c
     des_iterator_t prot_it;
 
     // Handle new SDP record
-    if (sdp_event_query_attribute_byte_get_record_id(packet) != avdtp_record_id) {
-        avdtp_record_id = sdp_event_query_attribute_byte_get_record_id(packet);
+    if (sdp_event_query_attribute_value_chunk_get_record_id(packet) != avdtp_record_id) {
+        avdtp_record_id = sdp_event_query_attribute_value_chunk_get_record_id(packet);
         // log_info("SDP Record: Nr: %d", record_id);
     }
 
-    if (sdp_event_query_attribute_byte_get_attribute_length(packet) <= avdtp_attribute_value_buffer_size) {
-        avdtp_attribute_value[sdp_event_query_attribute_byte_get_data_offset(packet)] = sdp_event_query_attribute_byte_get_data(packet);
+    if (sdp_event_query_attribute_value_chunk_get_attribute_length(packet) <= avdtp_attribute_value_buffer_size) {
+        uint16_t data_offset = sdp_event_query_attribute_value_chunk_get_data_offset(packet);
+        uint8_t  data_len    = sdp_event_query_attribute_value_chunk_get_data_len(packet);
+        if (((uint32_t) data_offset + data_len) > avdtp_attribute_value_buffer_size) return;
+        (void)memcpy(&avdtp_attribute_value[data_offset], sdp_event_query_attribute_value_chunk_get_data(packet), data_len);
 
-        if ((uint16_t)(sdp_event_query_attribute_byte_get_data_offset(packet)+1) == sdp_event_query_attribute_byte_get_attribute_length(packet)) {
+        if ((uint16_t)(data_offset + data_len) == sdp_event_query_attribute_value_chunk_get_attribute_length(packet)) {
 
-            switch(sdp_event_query_attribute_byte_get_attribute_id(packet)) {
+            switch(sdp_event_query_attribute_value_chunk_get_attribute_id(packet)) {
 
                 case BLUETOOTH_ATTRIBUTE_SERVICE_CLASS_ID_LIST:
                     if (de_get_element_type(avdtp_attribute_value) != DE_DES) break;
@@ -597,7 +605,7 @@ static void avdtp_handle_sdp_client_query_attribute_value(avdtp_connection_t * c
                     break;
 
                 case BLUETOOTH_ATTRIBUTE_PROTOCOL_DESCRIPTOR_LIST: 
-                    // log_info("SDP Attribute: 0x%04x", sdp_event_query_attribute_byte_get_attribute_id(packet));
+                    // log_info("SDP Attribute: 0x%04x", sdp_event_query_attribute_value_chunk_get_attribute_id(packet));
                     for (des_iterator_init(&des_list_it, avdtp_attribute_value); des_iterator_has_more(&des_list_it); des_iterator_next(&des_list_it)) {
                         uint8_t       *des_element;
                         uint8_t       *element;
@@ -635,7 +643,7 @@ static void avdtp_handle_sdp_client_query_attribute_value(avdtp_connection_t * c
             }
         }
     } else {
-        log_error("SDP attribute value buffer size exceeded: available %d, required %d", avdtp_attribute_value_buffer_size, sdp_event_query_attribute_byte_get_attribute_length(packet));
+        log_error("SDP attribute value buffer size exceeded: available %d, required %d", avdtp_attribute_value_buffer_size, sdp_event_query_attribute_value_chunk_get_attribute_length(packet));
     }
 
 }
@@ -650,6 +658,10 @@ static void avdtp_handle_sdp_query_failed(avdtp_connection_t * connection, uint8
     switch (connection->state){
         case AVDTP_SIGNALING_W4_SDP_QUERY_FOR_REMOTE_SINK_COMPLETE:
         case AVDTP_SIGNALING_W4_SDP_QUERY_FOR_REMOTE_SOURCE_COMPLETE:
+#ifdef ENABLE_SDP_CLIENT_CACHE
+            // don't keep result without service, remote might add it later
+            sdp_client_cache_remove(connection->remote_addr);
+#endif
             avdtp_signaling_emit_connection_established(connection->avdtp_cid, connection->remote_addr, connection->con_handle, status);
             break;
 
@@ -702,7 +714,7 @@ static void avdtp_handle_sdp_client_query_result(uint8_t packet_type, uint16_t c
     switch (connection->state){
         case AVDTP_SIGNALING_W4_SDP_QUERY_FOR_REMOTE_SINK_COMPLETE:
             switch (hci_event_packet_get_type(packet)){
-                case SDP_EVENT_QUERY_ATTRIBUTE_VALUE:
+                case SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK:
                     avdtp_handle_sdp_client_query_attribute_value(connection, packet);
                     return;        
                 case SDP_EVENT_QUERY_COMPLETE:
@@ -720,7 +732,7 @@ static void avdtp_handle_sdp_client_query_result(uint8_t packet_type, uint16_t c
             break;
         case AVDTP_SIGNALING_W4_SDP_QUERY_FOR_REMOTE_SOURCE_COMPLETE:
             switch (hci_event_packet_get_type(packet)){
-                case SDP_EVENT_QUERY_ATTRIBUTE_VALUE:
+                case SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK:
                     avdtp_handle_sdp_client_query_attribute_value(connection, packet);
                     return;              
                 case SDP_EVENT_QUERY_COMPLETE:
@@ -739,7 +751,7 @@ static void avdtp_handle_sdp_client_query_result(uint8_t packet_type, uint16_t c
 
         case AVDTP_SIGNALING_CONNECTION_OPENED:
             switch (hci_event_packet_get_type(packet)){
-                case SDP_EVENT_QUERY_ATTRIBUTE_VALUE:
+                case SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK:
                     avdtp_handle_sdp_client_query_attribute_value(connection, packet);
                     return;        
                 case SDP_EVENT_QUERY_COMPLETE:
@@ -979,6 +991,10 @@ void avdtp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet
                                     log_info("Connection to %s failed. status code 0x%02x", bd_addr_to_str(event_addr), status);
                                     break;
                             }
+#ifdef ENABLE_SDP_CLIENT_CACHE
+                            // AVDTP PSM might have been taken from outdated SDP record
+                            sdp_client_cache_remove(event_addr);
+#endif
                             avdtp_signaling_emit_connection_established(connection->avdtp_cid, event_addr, con_handle, status);
                             avdtp_finalize_connection(connection);
                             break;
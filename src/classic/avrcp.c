@@ -640,17 +640,20 @@ void avrcp_handle_sdp_client_query_attribute_value(uint8_t *packet){
     uint8_t protocol_descriptor_id;
 
     // Handle new SDP record
-    if (sdp_event_query_attribute_byte_get_record_id(packet) != avrcp_sdp_query_context.record_id) {
-        avrcp_sdp_query_context.record_id = sdp_event_query_attribute_byte_get_record_id(packet);
+    if (sdp_event_query_attribute_value_chunk_get_record_id(packet) != avrcp_sdp_query_context.record_id) {
+        avrcp_sdp_query_context.record_id = sdp_event_query_attribute_value_chunk_get_record_id(packet);
         avrcp_sdp_query_context.parse_sdp_record = 0;
         // log_info("SDP Record: Nr: %d", record_id);
     }
 
-    if (sdp_event_query_attribute_byte_get_attribute_length(packet) <= avrcp_sdp_query_attribute_value_buffer_size) {
-        avrcp_sdp_query_attribute_value[sdp_event_query_attribute_byte_get_data_offset(packet)] = sdp_event_query_attribute_byte_get_data(packet);
+    if (sdp_event_query_attribute_value_chunk_get_attribute_length(packet) <= avrcp_sdp_query_attribute_value_buffer_size) {
+        uint16_t data_offset = sdp_event_query_attribute_value_chunk_get_data_offset(packet);
+        uint8_t  data_len    = sdp_event_query_attribute_value_chunk_get_data_len(packet);
+        if (((uint32_t) data_offset + data_len) > avrcp_sdp_query_attribute_value_buffer_size) return;
+        (void)memcpy(&avrcp_sdp_query_attribute_value[data_offset], sdp_event_query_attribute_value_chunk_get_data(packet), data_len);
 
-        if ((uint16_t)(sdp_event_query_attribute_byte_get_data_offset(packet)+1) == sdp_event_query_attribute_byte_get_attribute_length(packet)) {
-            switch(sdp_event_query_attribute_byte_get_attribute_id(packet)) {
+        if ((uint16_t)(data_offset + data_len) == sdp_event_query_attribute_value_chunk_get_attribute_length(packet)) {
+            switch(sdp_event_query_attribute_value_chunk_get_attribute_id(packet)) {
                 case BLUETOOTH_ATTRIBUTE_SERVICE_CLASS_ID_LIST:
                     if (de_get_element_type(avrcp_sdp_query_attribute_value) != DE_DES) break;
                     for (des_iterator_init(&des_list_it, avrcp_sdp_query_attribute_value); des_iterator_has_more(&des_list_it); des_iterator_next(&des_list_it)) {
@@ -760,7 +763,7 @@ void avrcp_handle_sdp_client_query_attribute_value(uint8_t *packet){
             }
         }
     } else {
-        log_error("SDP attribute value buffer size exceeded: available %d, required %d", avrcp_sdp_query_attribute_value_buffer_size, sdp_event_query_attribute_byte_get_attribute_length(packet));
+        log_error("SDP attribute value buffer size exceeded: available %d, required %d", avrcp_sdp_query_attribute_value_buffer_size, sdp_event_query_attribute_value_chunk_get_attribute_length(packet));
     }
 }
 
@@ -853,7 +856,7 @@ static void avrcp_handle_sdp_client_query_result(uint8_t packet_type, uint16_t c
     uint8_t status;
 
     switch (hci_event_packet_get_type(packet)){
-        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE:
+        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK:
             avrcp_handle_sdp_client_query_attribute_value(packet);
             return;
             
@@ -890,7 +893,7 @@ static void avrcp_handle_start_sdp_client_query(void * context){
     avrcp_target_connection->trigger_sdp_query = false;
     avrcp_controller_connection->trigger_sdp_query = false;
 
-    sdp_client_query_uuid16(&avrcp_handle_sdp_client_query_result, avrcp_target_connection->remote_addr, BLUETOOTH_PROTOCOL_AVCTP);
+    sdp_client_query_uuid16_chunked(&avrcp_handle_sdp_client_query_result, avrcp_target_connection->remote_addr, BLUETOOTH_PROTOCOL_AVCTP);
 }
 
 static void avrcp_start_next_sdp_query(void) {
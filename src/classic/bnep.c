@@ -477,6 +477,46 @@ static int bnep_filter_multicast(bnep_channel_t *channel, bd_addr_t addr_dest)
 }
 
 
+/* Store BNEP header for ethernet packet, use compressed format if source and/or destination match the channel */
+static uint16_t bnep_store_ethernet_header(bnep_channel_t *channel, uint8_t *buffer, bd_addr_t addr_dest, bd_addr_t addr_source, uint16_t network_protocol_type)
+{
+    uint16_t pos = 0;
+    int has_source = (memcmp(addr_source, channel->local_addr, ETHER_ADDR_LEN) != 0);
+    int has_dest   = (memcmp(addr_dest, channel->remote_addr, ETHER_ADDR_LEN) != 0);
+
+    /* Fill in the package type depending on the given source and destination address */
+    if (has_source && has_dest) {
+        buffer[pos++] = BNEP_PKT_TYPE_GENERAL_ETHERNET;
+    } else
+    if (has_source && !has_dest) {
+        buffer[pos++] = BNEP_PKT_TYPE_COMPRESSED_ETHERNET_SOURCE_ONLY;
+    } else
+    if (!has_source && has_dest) {
+        buffer[pos++] = BNEP_PKT_TYPE_COMPRESSED_ETHERNET_DEST_ONLY;
+    } else {
+        buffer[pos++] = BNEP_PKT_TYPE_COMPRESSED_ETHERNET;
+    }
+
+    /* Add the destination address if needed */
+    if (has_dest) {
+        bd_addr_copy(buffer + pos, addr_dest);
+        pos += sizeof(bd_addr_t);
+    }
+
+    /* Add the source address if needed */
+    if (has_source) {
+        bd_addr_copy(buffer + pos, addr_source);
+        pos += sizeof(bd_addr_t);
+    }
+
+    /* Add protocol type */
+    big_endian_store_16(buffer, pos, network_protocol_type);
+    pos += 2;
+
+    /* TODO: Add extension headers, if we may support them at a later stage */
+    return pos;
+}
+
 /* Send BNEP ethernet packet */
 int bnep_send(uint16_t bnep_cid, uint8_t *packet, uint16_t len)
 {
@@ -486,8 +526,6 @@ int bnep_send(uint16_t bnep_cid, uint8_t *packet, uint16_t len)
     uint16_t        pos_out = 0;
     uint16_t        payload_len;
     int             err = 0;
-    int             has_source;
-    int             has_dest;
 
     bd_addr_t       addr_dest;
     bd_addr_t       addr_source;
@@ -508,6 +546,11 @@ int bnep_send(uint16_t bnep_cid, uint8_t *packet, uint16_t len)
         return BTSTACK_ACL_BUFFERS_FULL;
     }
 
+    /* Sort out packets without complete ethernet header */
+    if (len < ((2 * sizeof(bd_addr_t)) + sizeof(uint16_t))) {
+        return 0;
+    }
+
     /* Extract destination and source address from the ethernet packet */
     pos = 0;
     bd_addr_copy(addr_dest, &packet[pos]);
@@ -545,54 +588,16 @@ int bnep_send(uint16_t bnep_cid, uint8_t *packet, uint16_t len)
         }
     }
 
-    /* Reserve l2cap packet buffer */    
-    l2cap_reserve_packet_buffer();
-    bnep_out_buffer = l2cap_get_outgoing_buffer();
-
-    /* Check if source address is the same as our local address and if the 
-       destination address is the same as the remote addr. Maybe we can use
-       the compressed data format
-     */ 
-    has_source = (memcmp(addr_source, channel->local_addr, ETHER_ADDR_LEN) != 0);
-    has_dest = (memcmp(addr_dest, channel->remote_addr, ETHER_ADDR_LEN) != 0);
-
-    /* Check for MTU limits */
+    /* Check for MTU limits before the outgoing buffer gets reserved */
     if (payload_len > channel->max_frame_size) {
         log_error("bnep_send: Max frame size (%d) exceeded: %d", channel->max_frame_size, payload_len);
         return BNEP_DATA_LEN_EXCEEDS_MTU;
     }
-    
-    /* Fill in the package type depending on the given source and destination address */
-    if (has_source && has_dest) {
-        bnep_out_buffer[pos_out++] = BNEP_PKT_TYPE_GENERAL_ETHERNET;
-    } else 
-    if (has_source && !has_dest) {
-        bnep_out_buffer[pos_out++] = BNEP_PKT_TYPE_COMPRESSED_ETHERNET_SOURCE_ONLY;
-    } else 
-    if (!has_source && has_dest) {
-        bnep_out_buffer[pos_out++] = BNEP_PKT_TYPE_COMPRESSED_ETHERNET_DEST_ONLY;
-    } else {
-        bnep_out_buffer[pos_out++] = BNEP_PKT_TYPE_COMPRESSED_ETHERNET;
-    }
 
-    /* Add the destination address if needed */
-    if (has_dest) {
-        bd_addr_copy(bnep_out_buffer + pos_out, addr_dest);
-        pos_out += sizeof(bd_addr_t);
-    }
-
-    /* Add the source address if needed */
-    if (has_source) {
-        bd_addr_copy(bnep_out_buffer + pos_out, addr_source);
-        pos_out += sizeof(bd_addr_t);
-    }
-
-    /* Add protocol type */
-    big_endian_store_16(bnep_out_buffer, pos_out, network_protocol_type);
-    pos_out += 2;
-    
-    /* TODO: Add extension headers, if we may support them at a later stage */
-    /* Add the payload and then send out the package */
+    /* Reserve l2cap packet buffer, build BNEP header in front of the payload and copy the payload once */
+    l2cap_reserve_packet_buffer();
+    bnep_out_buffer = l2cap_get_outgoing_buffer();
+    pos_out = bnep_store_ethernet_header(channel, bnep_out_buffer, addr_dest, addr_source, network_protocol_type);
     (void)memcpy(bnep_out_buffer + pos_out, packet + pos, payload_len);
     pos_out += payload_len;
 
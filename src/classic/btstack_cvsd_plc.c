@@ -53,6 +53,12 @@
 #include "btstack_cvsd_plc.h"
 #include "btstack_debug.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 // static float rcos[CVSD_OLAL] = {
 //     0.99148655f,0.96623611f,0.92510857f,0.86950446f,
 //     0.80131732f,0.72286918f,0.63683150f,0.54613418f, 
@@ -94,32 +100,56 @@ static float btstack_cvsd_plc_absolute(float x){
      return x;
 }
 
-static float btstack_cvsd_plc_cross_correlation(BTSTACK_CVSD_PLC_SAMPLE_FORMAT *x, BTSTACK_CVSD_PLC_SAMPLE_FORMAT *y){
+// dot product of template and candidate window, products are accumulated as float
+static float btstack_cvsd_plc_dot_product(const BTSTACK_CVSD_PLC_SAMPLE_FORMAT *x, const BTSTACK_CVSD_PLC_SAMPLE_FORMAT *y){
+    int m;
+#if defined(__SSE2__)
+    __m128 acc = _mm_setzero_ps();
+    for (m=0;m<CVSD_M;m+=8){
+        __m128i a  = _mm_loadu_si128((const __m128i *) &x[m]);
+        __m128i b  = _mm_loadu_si128((const __m128i *) &y[m]);
+        __m128i lo = _mm_mullo_epi16(a, b);
+        __m128i hi = _mm_mulhi_epi16(a, b);
+        acc = _mm_add_ps(acc, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, hi)));
+        acc = _mm_add_ps(acc, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, hi)));
+    }
+    float sums[4];
+    _mm_storeu_ps(sums, acc);
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (m=0;m<CVSD_M;m+=4){
+        acc = vaddq_f32(acc, vcvtq_f32_s32(vmull_s16(vld1_s16(&x[m]), vld1_s16(&y[m]))));
+    }
+    return (vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1)) + (vgetq_lane_f32(acc, 2) + vgetq_lane_f32(acc, 3));
+#else
     float num = 0;
-    float den = 0;
-    float x2 = 0;
-    float y2 = 0;
-    int   m;
     for (m=0;m<CVSD_M;m++){
         num+=((float)x[m])*y[m];
-        x2+=((float)x[m])*x[m];
-        y2+=((float)y[m])*y[m];
     }
-    den = (float)sqrt3(x2*y2);
-    return num/den;
+    return num;
+#endif
 }
 
+// find window with highest normalized correlation to the last CVSD_M samples, window energy is updated incrementally
 int btstack_cvsd_plc_pattern_match(BTSTACK_CVSD_PLC_SAMPLE_FORMAT *y){
-    float maxCn = -999999.0;  // large negative number
-    int   bestmatch = 0;
-    float Cn;
-    int   n;
+    const BTSTACK_CVSD_PLC_SAMPLE_FORMAT *x = &y[CVSD_LHIST-CVSD_M];
+    float   maxCn = -999999.0;  // large negative number
+    int     bestmatch = 0;
+    float   x2 = btstack_cvsd_plc_dot_product(x, x);
+    int64_t y2 = 0;
+    float   Cn;
+    int     n;
+    for (n=0;n<CVSD_M;n++){
+        y2 += (int32_t)y[n]*y[n];
+    }
     for (n=0;n<CVSD_N;n++){
-        Cn = btstack_cvsd_plc_cross_correlation(&y[CVSD_LHIST-CVSD_M], &y[n]); 
+        Cn = btstack_cvsd_plc_dot_product(x, &y[n]) / sqrt3(x2*(float)y2);
         if (Cn>maxCn){
             bestmatch=n;
             maxCn = Cn; 
         }
+        y2 += ((int32_t)y[n+CVSD_M]*y[n+CVSD_M]) - ((int32_t)y[n]*y[n]);
     }
     return bestmatch;
 }
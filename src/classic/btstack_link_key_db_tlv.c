@@ -51,11 +51,6 @@
 #error "Please set NVM_NUM_LINK_KEYS in btstack_config.h - number of link keys that can be stored in TLV"
 #endif
 
-typedef struct {
-    const btstack_tlv_t * btstack_tlv_impl;
-    void * btstack_tlv_context;
-} btstack_link_key_db_tlv_h;
-
 typedef struct link_key_nvm {
     uint32_t seq_nr;    // used for "least recently stored" eviction strategy
     bd_addr_t bd_addr;
@@ -63,6 +58,21 @@ typedef struct link_key_nvm {
     link_key_type_t link_key_type;
 } link_key_nvm_t;   // sizeof(link_key_nvm_t) = 27 bytes
 
+// RAM copy of address and seq nr, avoids reading all entries on each access
+typedef struct {
+    bd_addr_t bd_addr;
+    uint32_t  seq_nr;
+    bool      valid;
+} link_key_cache_t;
+
+typedef struct {
+    const btstack_tlv_t * btstack_tlv_impl;
+    void * btstack_tlv_context;
+    link_key_cache_t cache[NVM_NUM_LINK_KEYS];
+    uint32_t num_writes;
+    uint32_t num_writes_saved;
+} btstack_link_key_db_tlv_h;
+
 static btstack_link_key_db_tlv_h singleton;
 static btstack_link_key_db_tlv_h * self = &singleton;
 
@@ -74,6 +84,30 @@ static uint32_t btstack_link_key_db_tag_for_index(uint8_t index){
     return (tag_0 << 24) | (tag_1 << 16) | (tag_2 << 8) | index;
 }
 
+static void btstack_link_key_db_tlv_scan(void){
+    int i;
+    for (i=0;i<NVM_NUM_LINK_KEYS;i++){
+        link_key_nvm_t entry;
+        uint32_t tag = btstack_link_key_db_tag_for_index(i);
+        int size = self->btstack_tlv_impl->get_tag(self->btstack_tlv_context, tag, (uint8_t*) &entry, sizeof(entry));
+        self->cache[i].valid = size != 0;
+        if (self->cache[i].valid == false) continue;
+        (void)memcpy(self->cache[i].bd_addr, entry.bd_addr, 6);
+        self->cache[i].seq_nr = entry.seq_nr;
+    }
+}
+
+// @return index or -1 if not found
+static int btstack_link_key_db_tlv_find(bd_addr_t bd_addr){
+    int i;
+    for (i=0;i<NVM_NUM_LINK_KEYS;i++){
+        if (self->cache[i].valid == false) continue;
+        if (memcmp(bd_addr, self->cache[i].bd_addr, 6) != 0) continue;
+        return i;
+    }
+    return -1;
+}
+
 // Device info
 static void btstack_link_key_db_tlv_open(void){
 }
@@ -86,96 +120,107 @@ static void btstack_link_key_db_tlv_close(void){
 }
 
 static int btstack_link_key_db_tlv_get_link_key(bd_addr_t bd_addr, link_key_t link_key, link_key_type_t * link_key_type) {
-    int i;
-    for (i=0;i<NVM_NUM_LINK_KEYS;i++){
-        link_key_nvm_t entry;
-        uint32_t tag = btstack_link_key_db_tag_for_index(i);
-        int size = self->btstack_tlv_impl->get_tag(self->btstack_tlv_context, tag, (uint8_t*) &entry, sizeof(entry));
-        if (size == 0) continue;
-        log_info("tag %x, addr %s", (unsigned int) tag, bd_addr_to_str(entry.bd_addr));
-        if (memcmp(bd_addr, entry.bd_addr, 6)) continue;
-        // found, pass back
-        (void)memcpy(link_key, entry.link_key, 16);
-        *link_key_type = entry.link_key_type;
-        return 1;
+    int index = btstack_link_key_db_tlv_find(bd_addr);
+    if (index < 0) return 0;
+    link_key_nvm_t entry;
+    uint32_t tag = btstack_link_key_db_tag_for_index(index);
+    int size = self->btstack_tlv_impl->get_tag(self->btstack_tlv_context, tag, (uint8_t*) &entry, sizeof(entry));
+    if (size == 0) {
+        self->cache[index].valid = false;
+        return 0;
     }
-	return 0;
+    log_info("tag %x, addr %s", (unsigned int) tag, bd_addr_to_str(entry.bd_addr));
+    // found, pass back
+    (void)memcpy(link_key, entry.link_key, 16);
+    *link_key_type = entry.link_key_type;
+    return 1;
 }
 
 static void btstack_link_key_db_tlv_delete_link_key(bd_addr_t bd_addr){
-    int i;
-    for (i=0;i<NVM_NUM_LINK_KEYS;i++){
-        link_key_nvm_t entry;
-        uint32_t tag = btstack_link_key_db_tag_for_index(i);
-        int size = self->btstack_tlv_impl->get_tag(self->btstack_tlv_context, tag, (uint8_t*) &entry, sizeof(entry));
-        if (size == 0) continue;
-        if (memcmp(bd_addr, entry.bd_addr, 6)) continue;
-        // found, delete tag
-        self->btstack_tlv_impl->delete_tag(self->btstack_tlv_context, tag);
-        break;
-    }
+    int index = btstack_link_key_db_tlv_find(bd_addr);
+    if (index < 0) return;
+    // found, delete tag
+    uint32_t tag = btstack_link_key_db_tag_for_index(index);
+    self->btstack_tlv_impl->delete_tag(self->btstack_tlv_context, tag);
+    self->cache[index].valid = false;
 }
 
 static void btstack_link_key_db_tlv_put_link_key(bd_addr_t bd_addr, link_key_t link_key, link_key_type_t link_key_type){
     int i;
     uint32_t highest_seq_nr = 0;
     uint32_t lowest_seq_nr = 0;
-    uint32_t tag_for_lowest_seq_nr = 0;
-    uint32_t tag_for_addr = 0;
-    uint32_t tag_for_empty = 0;
+    int index_for_lowest_seq_nr = -1;
+    int index_for_addr = -1;
+    int index_for_empty = -1;
 
     for (i=0;i<NVM_NUM_LINK_KEYS;i++){
-        link_key_nvm_t entry;
-        uint32_t tag = btstack_link_key_db_tag_for_index(i);
-        int size = self->btstack_tlv_impl->get_tag(self->btstack_tlv_context, tag, (uint8_t*) &entry, sizeof(entry));
+        const link_key_cache_t * entry = &self->cache[i];
         // empty/deleted tag
-        if (size == 0) {
-            tag_for_empty = tag;
+        if (entry->valid == false) {
+            index_for_empty = i;
             continue;
         }
         // found addr?
-        if (memcmp(bd_addr, entry.bd_addr, 6) == 0){
-            tag_for_addr = tag;
+        if (memcmp(bd_addr, entry->bd_addr, 6) == 0){
+            index_for_addr = i;
         }
         // update highest seq nr
-        if (entry.seq_nr > highest_seq_nr){
-            highest_seq_nr = entry.seq_nr;
+        if (entry->seq_nr > highest_seq_nr){
+            highest_seq_nr = entry->seq_nr;
         }
         // find entry with lowest seq nr
-        if ((tag_for_lowest_seq_nr == 0) || (entry.seq_nr < lowest_seq_nr)){
-            tag_for_lowest_seq_nr = tag;
-            lowest_seq_nr = entry.seq_nr;
+        if ((index_for_lowest_seq_nr < 0) || (entry->seq_nr < lowest_seq_nr)){
+            index_for_lowest_seq_nr = i;
+            lowest_seq_nr = entry->seq_nr;
         }
     }
 
-    log_info("tag_for_addr %x, tag_for_empy %x, tag_for_lowest_seq_nr %x",
-             (unsigned int) tag_for_addr, (unsigned int) tag_for_empty, (unsigned int) tag_for_lowest_seq_nr);
+    log_info("index_for_addr %d, index_for_empty %d, index_for_lowest_seq_nr %d",
+             index_for_addr, index_for_empty, index_for_lowest_seq_nr);
 
-    uint32_t tag_to_use = 0;
-    if (tag_for_addr){
-        tag_to_use = tag_for_addr;
-    } else if (tag_for_empty){
-        tag_to_use = tag_for_empty;
-    } else if (tag_for_lowest_seq_nr){
-        tag_to_use = tag_for_lowest_seq_nr;
+    int index_to_use;
+    if (index_for_addr >= 0){
+        index_to_use = index_for_addr;
+    } else if (index_for_empty >= 0){
+        index_to_use = index_for_empty;
+    } else if (index_for_lowest_seq_nr >= 0){
+        index_to_use = index_for_lowest_seq_nr;
     } else {
         // should not happen
         return;
     }
 
+    uint32_t tag_to_use = btstack_link_key_db_tag_for_index(index_to_use);
+    link_key_nvm_t entry;
+
+    // skip write if same link key is already stored
+    if (index_for_addr >= 0){
+        int size = self->btstack_tlv_impl->get_tag(self->btstack_tlv_context, tag_to_use, (uint8_t*) &entry, sizeof(entry));
+        if ((size == sizeof(entry)) && (memcmp(entry.link_key, link_key, 16) == 0) && (entry.link_key_type == link_key_type)){
+            log_info("link key for tag %x unchanged", (unsigned int) tag_to_use);
+            self->num_writes_saved++;
+            return;
+        }
+    }
+
     log_info("store with tag %x", (unsigned int) tag_to_use);
 
-    link_key_nvm_t entry;
-    
     (void)memcpy(entry.bd_addr, bd_addr, 6);
     (void)memcpy(entry.link_key, link_key, 16);
     entry.link_key_type = link_key_type;
     entry.seq_nr = highest_seq_nr + 1;
 
     int result = self->btstack_tlv_impl->store_tag(self->btstack_tlv_context, tag_to_use, (uint8_t*) &entry, sizeof(entry));
+    self->num_writes++;
     if (result != 0){
         log_error("store link key failed");
+        self->cache[index_to_use].valid = false;
+        return;
     }
+
+    (void)memcpy(self->cache[index_to_use].bd_addr, bd_addr, 6);
+    self->cache[index_to_use].seq_nr = entry.seq_nr;
+    self->cache[index_to_use].valid = true;
 }
 
 static int btstack_link_key_db_tlv_iterator_init(btstack_link_key_iterator_t * it){
@@ -187,6 +232,10 @@ static int  btstack_link_key_db_tlv_iterator_get_next(btstack_link_key_iterator_
     uint8_t i = (uint8_t)(uintptr_t) it->context;
     int found = 0;
     while (i<NVM_NUM_LINK_KEYS){
+        if (self->cache[i].valid == false) {
+            i++;
+            continue;
+        }
         link_key_nvm_t entry;
         uint32_t tag = btstack_link_key_db_tag_for_index(i++);
         int size = self->btstack_tlv_impl->get_tag(self->btstack_tlv_context, tag, (uint8_t*) &entry, sizeof(entry));
@@ -220,7 +269,15 @@ static const btstack_link_key_db_t btstack_link_key_db_tlv = {
 const btstack_link_key_db_t * btstack_link_key_db_tlv_get_instance(const btstack_tlv_t * btstack_tlv_impl, void * btstack_tlv_context){
     self->btstack_tlv_impl = btstack_tlv_impl;
     self->btstack_tlv_context = btstack_tlv_context;
+    self->num_writes = 0;
+    self->num_writes_saved = 0;
+    btstack_link_key_db_tlv_scan();
     return &btstack_link_key_db_tlv;
 }
 
+void btstack_link_key_db_tlv_get_write_statistics(uint32_t * num_tlv_writes, uint32_t * num_tlv_writes_saved){
+    *num_tlv_writes       = self->num_writes;
+    *num_tlv_writes_saved = self->num_writes_saved;
+}
+
 
@@ -61,6 +61,13 @@ extern "C" {
  */
 const btstack_link_key_db_t * btstack_link_key_db_tlv_get_instance(const btstack_tlv_t * btstack_tlv_impl, void * btstack_tlv_context);
 
+/**
+ * Get number of link keys written to TLV and number of writes skipped as the same link key was already stored
+ * @param num_tlv_writes
+ * @param num_tlv_writes_saved
+ */
+void btstack_link_key_db_tlv_get_write_statistics(uint32_t * num_tlv_writes, uint32_t * num_tlv_writes_saved);
+
 /* API_END */
 
 #if defined __cplusplus
@@ -53,6 +53,12 @@
 #include "btstack_sbc_plc.h"
 #include "btstack_debug.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #define SAMPLE_FORMAT int16_t
 
 // Zero Frame (57 bytes) with padding zeros to avoid out of bound reads
@@ -98,32 +104,59 @@ static float absolute(float x){
      return x;
 }
 
-static float CrossCorrelation(SAMPLE_FORMAT *x, SAMPLE_FORMAT *y){
+// dot product of template and candidate window, products are accumulated as float
+static float DotProduct(const SAMPLE_FORMAT *x, const SAMPLE_FORMAT *y){
+    int m;
+#if defined(__SSE2__)
+    __m128 acc = _mm_setzero_ps();
+    for (m=0;m<SBC_M;m+=8){
+        __m128i a  = _mm_loadu_si128((const __m128i *) &x[m]);
+        __m128i b  = _mm_loadu_si128((const __m128i *) &y[m]);
+        __m128i lo = _mm_mullo_epi16(a, b);
+        __m128i hi = _mm_mulhi_epi16(a, b);
+        acc = _mm_add_ps(acc, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, hi)));
+        acc = _mm_add_ps(acc, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, hi)));
+    }
+    float sums[4];
+    _mm_storeu_ps(sums, acc);
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (m=0;m<SBC_M;m+=4){
+        acc = vaddq_f32(acc, vcvtq_f32_s32(vmull_s16(vld1_s16(&x[m]), vld1_s16(&y[m]))));
+    }
+    return (vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1)) + (vgetq_lane_f32(acc, 2) + vgetq_lane_f32(acc, 3));
+#else
     float num = 0;
-    float den = 0;
-    float x2 = 0;
-    float y2 = 0;
-    int   m;
     for (m=0;m<SBC_M;m++){
         num+=((float)x[m])*y[m];
-        x2+=((float)x[m])*x[m];
-        y2+=((float)y[m])*y[m];
     }
-    den = (float)sqrt3(x2*y2);
-    return num/den;
+    return num;
+#endif
 }
 
-static int PatternMatch(SAMPLE_FORMAT *y){
-    float maxCn = -999999.0;  // large negative number
-    int   bestmatch = 0;
-    float Cn;
-    int   n;
+// best match for the last SBC_M samples by normalized cross-correlation, used by plc benchmark in unit tests
+#ifndef UNIT_TEST
+static
+#endif
+int btstack_sbc_plc_pattern_match(SAMPLE_FORMAT *y){
+    const SAMPLE_FORMAT *x = &y[SBC_LHIST-SBC_M];
+    float   maxCn = -999999.0;  // large negative number
+    int     bestmatch = 0;
+    float   x2 = DotProduct(x, x);
+    int64_t y2 = 0;
+    float   Cn;
+    int     n;
+    for (n=0;n<SBC_M;n++){
+        y2 += (int32_t)y[n]*y[n];
+    }
     for (n=0;n<SBC_N;n++){
-        Cn = CrossCorrelation(&y[SBC_LHIST-SBC_M], &y[n]); 
+        Cn = DotProduct(x, &y[n]) / sqrt3(x2*(float)y2);
         if (Cn>maxCn){
             bestmatch=n;
             maxCn = Cn; 
         }
+        y2 += ((int32_t)y[n+SBC_M]*y[n+SBC_M]) - ((int32_t)y[n]*y[n]);
     }
     return bestmatch;
 }
@@ -338,7 +371,7 @@ void btstack_sbc_plc_bad_frame(btstack_sbc_plc_state_t *plc_state, SAMPLE_FORMAT
     if (plc_state->nbf==1){
         // printf("first bad frame\n");
         // Perform pattern matching to find where to replicate
-        plc_state->bestlag = PatternMatch(plc_state->hist);
+        plc_state->bestlag = btstack_sbc_plc_pattern_match(plc_state->hist);
     }
 
 #ifdef OCTAVE_OUTPUT
@@ -76,6 +76,10 @@ void btstack_sbc_plc_good_frame(btstack_sbc_plc_state_t *plc_state, int16_t *in,
 uint8_t * btstack_sbc_plc_zero_signal_frame(void);
 void btstack_sbc_dump_statistics(btstack_sbc_plc_state_t * state);
 
+#ifdef UNIT_TEST
+int btstack_sbc_plc_pattern_match(int16_t *y);
+#endif
+
 #ifdef OCTAVE_OUTPUT
 void btstack_sbc_plc_octave_set_base_name(const char * name);
 #endif
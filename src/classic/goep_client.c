@@ -55,6 +55,11 @@
 #include "classic/sdp_util.h"
 #include "l2cap.h"
 
+// SDP query state is kept in globals, parallel queries would overwrite it
+#if MAX_NR_SDP_CLIENT_CONTEXTS > 1
+#error "GOEP Client does not support MAX_NR_SDP_CLIENT_CONTEXTS > 1"
+#endif
+
 //------------------------------------------------------------------------------------------------------------
 // goep_client.c
 //
@@ -78,8 +83,8 @@ static goep_client_t   goep_client_singleton;
 
 #ifdef ENABLE_GOEP_L2CAP
 // singleton instance
-static uint8_t goep_client_singleton_ertm_buffer[1000];
-static l2cap_ertm_config_t goep_client_singleton_ertm_config = {
+static uint8_t goep_client_singleton_ertm_buffer[GOEP_CLIENT_ERTM_BUFFER];
+static const l2cap_ertm_config_t goep_client_singleton_ertm_config = {
     1,  // ertm mandatory
     2,  // max transmit, some tests require > 1
     2000,
@@ -140,6 +145,10 @@ static void goep_client_handle_connection_opened(goep_client_t * goep_client, ui
     if (status) {
         goep_client->state = GOEP_CLIENT_INIT;
         log_info("goep_client: open failed, status %u", status);
+#ifdef ENABLE_SDP_CLIENT_CACHE
+        // RFCOMM channel or L2CAP PSM might have been taken from outdated SDP record
+        sdp_client_cache_remove(goep_client->bd_addr);
+#endif
     } else {
         goep_client->bearer_mtu = mtu;
         goep_client->state = GOEP_CLIENT_CONNECTED;
@@ -276,13 +285,15 @@ static void goep_client_handle_sdp_query_event(uint8_t packet_type, uint16_t cha
     des_iterator_t prot_it;
     uint8_t status;
     uint16_t record_index;
+    uint16_t data_offset;
+    uint8_t  data_len;
     bool goep_server_found;
 
     switch (hci_event_packet_get_type(packet)){
-        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE:
+        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK:
 
             // detect new record
-            record_index = sdp_event_query_attribute_byte_get_record_id(packet);
+            record_index = sdp_event_query_attribute_value_chunk_get_record_id(packet);
             if (record_index != goep_client->record_index){
                 goep_client->record_index = record_index;
                 goep_client_handle_sdp_query_end_of_record(goep_client);
@@ -290,7 +301,7 @@ static void goep_client_handle_sdp_query_event(uint8_t packet_type, uint16_t cha
             }
 
             // check if relevant attribute
-            switch(sdp_event_query_attribute_byte_get_attribute_id(packet)){
+            switch(sdp_event_query_attribute_value_chunk_get_attribute_id(packet)){
                 case BLUETOOTH_ATTRIBUTE_PROTOCOL_DESCRIPTOR_LIST:
                 case BLUETOOTH_ATTRIBUTE_PBAP_SUPPORTED_FEATURES:
                 case BLUETOOTH_ATTRIBUTE_MAS_INSTANCE_ID:
@@ -304,19 +315,22 @@ static void goep_client_handle_sdp_query_event(uint8_t packet_type, uint16_t cha
             }
 
             // warn if attribute too large to fit in our buffer
-            if (sdp_event_query_attribute_byte_get_attribute_length(packet) > goep_client_sdp_query_attribute_value_buffer_size) {
-                log_error("SDP attribute value size exceeded for attribute %x: available %d, required %d", sdp_event_query_attribute_byte_get_attribute_id(packet), goep_client_sdp_query_attribute_value_buffer_size, sdp_event_query_attribute_byte_get_attribute_length(packet));
+            if (sdp_event_query_attribute_value_chunk_get_attribute_length(packet) > goep_client_sdp_query_attribute_value_buffer_size) {
+                log_error("SDP attribute value size exceeded for attribute %x: available %d, required %d", sdp_event_query_attribute_value_chunk_get_attribute_id(packet), goep_client_sdp_query_attribute_value_buffer_size, sdp_event_query_attribute_value_chunk_get_attribute_length(packet));
                 break;
             }
 
-            // store single byte
-            goep_client_sdp_query_attribute_value[sdp_event_query_attribute_byte_get_data_offset(packet)] = sdp_event_query_attribute_byte_get_data(packet);
+            // store chunk
+            data_offset = sdp_event_query_attribute_value_chunk_get_data_offset(packet);
+            data_len    = sdp_event_query_attribute_value_chunk_get_data_len(packet);
+            if (((uint32_t) data_offset + data_len) > goep_client_sdp_query_attribute_value_buffer_size) break;
+            (void)memcpy(&goep_client_sdp_query_attribute_value[data_offset], sdp_event_query_attribute_value_chunk_get_data(packet), data_len);
 
             // wait until value fully received
-            if ((uint16_t)(sdp_event_query_attribute_byte_get_data_offset(packet)+1) != sdp_event_query_attribute_byte_get_attribute_length(packet)) break;
+            if ((uint16_t)(data_offset + data_len) != sdp_event_query_attribute_value_chunk_get_attribute_length(packet)) break;
 
             // process attributes
-            switch(sdp_event_query_attribute_byte_get_attribute_id(packet)) {
+            switch(sdp_event_query_attribute_value_chunk_get_attribute_id(packet)) {
                 case BLUETOOTH_ATTRIBUTE_PROTOCOL_DESCRIPTOR_LIST:
                     for (des_iterator_init(&des_list_it, goep_client_sdp_query_attribute_value); des_iterator_has_more(&des_list_it); des_iterator_next(&des_list_it)) {
                         uint8_t       *des_element;
@@ -405,6 +419,9 @@ static void goep_client_handle_sdp_query_event(uint8_t packet_type, uint16_t cha
 #endif
             if (goep_server_found == false){
                 log_info("No GOEP RFCOMM or L2CAP server found");
+#ifdef ENABLE_SDP_CLIENT_CACHE
+                sdp_client_cache_remove(goep_client->bd_addr);
+#endif
                 goep_client->state = GOEP_CLIENT_INIT;
                 goep_client_emit_connected_event(goep_client, SDP_SERVICE_NOT_FOUND);
                 break;
@@ -459,8 +476,8 @@ static void geop_client_sdp_query_start(void * context){
     goep_client_t * goep_client = goep_client_for_cid(goep_cid);
     if (context != NULL){
         goep_client_sdp_active = goep_client;
-        sdp_client_query_uuid16(&goep_client_handle_sdp_query_event, goep_client->bd_addr,
-                                goep_client->uuid);
+        sdp_client_query_uuid16_chunked(&goep_client_handle_sdp_query_event, goep_client->bd_addr,
+                                        goep_client->uuid);
     }
 }
 
@@ -545,7 +562,11 @@ uint8_t goep_client_create_connection(btstack_packet_handler_t handler, bd_addr_
         return BTSTACK_MEMORY_ALLOC_FAILED;
     }
 #ifdef ENABLE_GOEP_L2CAP
-    return goep_client_connect(goep_client, &goep_client_singleton_ertm_config, goep_client_singleton_ertm_buffer,
+    // use MPS and TxWindow that fit the Controller buffers, keep default config if buffer is too small
+    l2cap_ertm_config_t ertm_config = goep_client_singleton_ertm_config;
+    uint16_t local_mtu = (uint16_t) btstack_max(512, GOEP_CLIENT_ERTM_BUFFER / 2);
+    (void) l2cap_ertm_config_for_throughput(&ertm_config, local_mtu, sizeof(goep_client_singleton_ertm_buffer));
+    return goep_client_connect(goep_client, &ertm_config, goep_client_singleton_ertm_buffer,
                                sizeof(goep_client_singleton_ertm_buffer), handler, addr, uuid, 0, out_cid);
 #else
     return goep_client_connect(goep_client,NULL, NULL, 0, handler, addr, uuid, 0, out_cid);
@@ -744,6 +765,16 @@ void goep_client_header_add_srm_enable(uint16_t goep_cid){
     obex_message_builder_header_add_srm_enable(buffer, buffer_len);
 }
 
+void goep_client_header_add_srmp_wait(uint16_t goep_cid){
+    goep_client_t * goep_client = goep_client_for_cid(goep_cid);
+    if (goep_client == NULL){
+        return;
+    }
+    uint8_t * buffer = goep_client_get_outgoing_buffer(goep_client);
+    uint16_t buffer_len = goep_client_get_outgoing_buffer_len(goep_client);
+    obex_message_builder_header_add_srmp_wait(buffer, buffer_len);
+}
+
 void goep_client_header_add_target(uint16_t goep_cid, const uint8_t * target, uint16_t length){
     goep_client_t * goep_client = goep_client_for_cid(goep_cid);
     if (goep_client == NULL){
@@ -52,9 +52,17 @@ extern "C" {
 #include <stdlib.h>
 #include <string.h>
 
+#include "btstack_config.h"
 #include "btstack_defines.h"
 #include "l2cap.h"
 
+#ifdef ENABLE_GOEP_L2CAP
+// ERTM buffer of singleton instance used by goep_client_create_connection, max 65535 bytes
+#ifndef GOEP_CLIENT_ERTM_BUFFER
+#define GOEP_CLIENT_ERTM_BUFFER 1000
+#endif
+#endif
+
 typedef enum {
     GOEP_CLIENT_INIT,
     GOEP_CLIENT_W4_SDP,
@@ -279,6 +287,12 @@ uint16_t goep_client_request_get_max_body_size(uint16_t goep_cid);
  */
 void goep_client_header_add_srm_enable(uint16_t goep_cid);
 
+/**
+ * @brief Add SRMP Wait to ask the server to wait for the next request before sending further responses
+ * @param goep_cid
+ */
+void goep_client_header_add_srmp_wait(uint16_t goep_cid);
+
 /**
  * @brief Add header with single byte value (8 bit)
  * @param goep_cid
@@ -496,6 +496,8 @@ uint8_t goep_server_accept_connection(uint16_t goep_cid){
     connection->state = GOEP_SERVER_W4_CONNECTED;
 #ifdef ENABLE_GOEP_L2CAP
     if (connection->type == GOEP_CONNECTION_L2CAP){
+        // use MPS and TxWindow that fit the Controller buffers, keep previous config if buffer is too small
+        (void) l2cap_ertm_config_for_throughput(&ertm_config, GOEP_SERVER_ERTM_BUFFER / 2, GOEP_SERVER_ERTM_BUFFER);
         return l2cap_ertm_accept_connection(connection->bearer_cid, &ertm_config, connection->ertm_buffer, GOEP_SERVER_ERTM_BUFFER);
     }
 #endif
@@ -66,6 +66,11 @@
 #error "WBS for PCM is only possible over PCM/I2S. Please add define: ENABLE_SCO_OVER_PCM"
 #endif
 
+// SDP query state is kept in globals, parallel queries would overwrite it
+#if MAX_NR_SDP_CLIENT_CONTEXTS > 1
+#error "HFP does not support MAX_NR_SDP_CLIENT_CONTEXTS > 1"
+#endif
+
 #define HFP_HF_FEATURES_SIZE 10
 #define HFP_AG_FEATURES_SIZE 12
 
@@ -784,6 +789,10 @@ static void handle_query_rfcomm_event(uint8_t packet_type, uint16_t channel, uin
                 if (status == ERROR_CODE_SUCCESS){
                     // report service not found
                     status = SDP_SERVICE_NOT_FOUND;
+#ifdef ENABLE_SDP_CLIENT_CACHE
+                    // don't keep result without service, remote might add it later
+                    sdp_client_cache_remove(hfp_connection->remote_addr);
+#endif
                 }
                 hfp_handle_slc_setup_error(hfp_connection, status);
                 log_info("rfcomm service not found, status 0x%02x", status);
@@ -1068,6 +1077,10 @@ void hfp_handle_rfcomm_event(uint8_t packet_type, uint16_t channel, uint8_t *pac
 
             status = rfcomm_event_channel_opened_get_status(packet);          
             if (status != ERROR_CODE_SUCCESS) {
+#ifdef ENABLE_SDP_CLIENT_CACHE
+                // RFCOMM channel might have been taken from outdated SDP record
+                sdp_client_cache_remove(event_addr);
+#endif
                 hfp_handle_slc_setup_error(hfp_connection, status);
                 break;
             } 
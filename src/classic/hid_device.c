@@ -49,6 +49,10 @@
 #include "classic/sdp_util.h"
 #include "l2cap.h"
 
+#ifndef MAX_NR_HID_DEVICE_REPORTS
+#define MAX_NR_HID_DEVICE_REPORTS 16
+#endif
+
 // prototypes
 static int dummy_write_report(uint16_t hid_cid, hid_report_type_t report_type, uint16_t report_id, int * out_report_size, uint8_t * out_report);
 static void dummy_set_report(uint16_t hid_cid, hid_report_type_t report_type, int report_size, uint8_t * report);
@@ -97,6 +101,11 @@ static bool            hid_device_boot_protocol_mode_supported;
 static const uint8_t * hid_device_descriptor;
 static uint16_t        hid_device_descriptor_len;
 
+// report sizes compiled from descriptor, descriptor is parsed for each request if compile fails
+static btstack_hid_report_layout_t hid_device_report_layout;
+static btstack_hid_report_info_t   hid_device_report_layout_reports[MAX_NR_HID_DEVICE_REPORTS];
+static bool                        hid_device_report_layout_valid;
+
 
 static uint16_t hid_device_cid = 0;
 
@@ -338,6 +347,36 @@ static inline void hid_device_emit_event(hid_device_t * context, uint8_t subeven
     hid_device_callback(HCI_EVENT_PACKET, context->cid, &event[0], pos);
 }
 
+static void hid_device_report_layout_compile(void){
+    btstack_hid_report_layout_init(&hid_device_report_layout, hid_device_report_layout_reports, MAX_NR_HID_DEVICE_REPORTS, NULL, 0);
+    uint8_t status = btstack_hid_report_layout_compile(&hid_device_report_layout, hid_device_descriptor_len, hid_device_descriptor);
+    hid_device_report_layout_valid = status == ERROR_CODE_SUCCESS;
+    if (!hid_device_report_layout_valid){
+        log_info("HID Descriptor not compiled, status 0x%02x", status);
+    }
+}
+
+static int hid_device_get_report_size_for_id(int report_id, hid_report_type_t report_type){
+    if (hid_device_report_layout_valid){
+        return btstack_hid_report_layout_get_report_size(&hid_device_report_layout, report_id, report_type);
+    }
+    return btstack_hid_get_report_size_for_id(report_id, report_type, hid_device_descriptor_len, hid_device_descriptor);
+}
+
+static hid_report_id_status_t hid_device_report_id_valid(int report_id){
+    if (hid_device_report_layout_valid){
+        return btstack_hid_report_layout_id_valid(&hid_device_report_layout, report_id);
+    }
+    return btstack_hid_id_valid(report_id, hid_device_descriptor_len, hid_device_descriptor);
+}
+
+static bool hid_device_report_id_declared(void){
+    if (hid_device_report_layout_valid){
+        return hid_device_report_layout.report_id_declared;
+    }
+    return btstack_hid_report_id_declared(hid_device_descriptor_len, hid_device_descriptor) != 0;
+}
+
 static int hid_report_size_valid(uint16_t cid, int report_id, hid_report_type_t report_type, int report_size){
     if (!report_size) return 0;
     if (hid_device_in_boot_protocol_mode(cid)){
@@ -352,13 +391,13 @@ static int hid_report_size_valid(uint16_t cid, int report_id, hid_report_type_t
                 return 0;
         }
     } else {
-        int size =  btstack_hid_get_report_size_for_id(report_id, report_type, hid_device_descriptor_len, hid_device_descriptor);
+        int size =  hid_device_get_report_size_for_id(report_id, report_type);
         if ((size == 0) || (size != report_size)) return 0;
     }
     return 1;
 }
 
-static int hid_get_report_size_for_id(uint16_t cid, int report_id, hid_report_type_t report_type, uint16_t descriptor_len, const uint8_t * descriptor){
+static int hid_get_report_size_for_id(uint16_t cid, int report_id, hid_report_type_t report_type){
     if (hid_device_in_boot_protocol_mode(cid)){
         switch (report_id){
             case HID_BOOT_MODE_KEYBOARD_ID:
@@ -369,7 +408,7 @@ static int hid_get_report_size_for_id(uint16_t cid, int report_id, hid_report_ty
                 return 0;
         }
     } else {
-        return btstack_hid_get_report_size_for_id(report_id, report_type, descriptor_len, descriptor);
+        return hid_device_get_report_size_for_id(report_id, report_type);
     }
 }
 
@@ -383,7 +422,7 @@ static hid_report_id_status_t hid_report_id_status(uint16_t cid, uint16_t report
                 return HID_REPORT_ID_INVALID;
         }
     } else {
-        return btstack_hid_id_valid(report_id, hid_device_descriptor_len, hid_device_descriptor);
+        return hid_device_report_id_valid(report_id);
     }
 }
 
@@ -391,7 +430,7 @@ static hid_handshake_param_type_t hid_device_set_report_cmd_is_valid(uint16_t ci
     int pos = 0;
     int report_id = 0;
 
-    if (btstack_hid_report_id_declared(hid_device_descriptor_len, hid_device_descriptor)){
+    if (hid_device_report_id_declared()){
         report_id = report[pos++];
         hid_report_id_status_t report_id_status = hid_report_id_status(cid, report_id);
         switch (report_id_status){
@@ -450,7 +489,7 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t * pack
                             device->report_id = packet[pos++];
                             break;
                         case HID_PROTOCOL_MODE_REPORT:
-                            if (!btstack_hid_report_id_declared(hid_device_descriptor_len, hid_device_descriptor)) {
+                            if (!hid_device_report_id_declared()) {
                                 if (packet_size < 2) break;
                                 if (packet[0] & 0x08){ 
                                     if (packet_size > 2) {
@@ -485,7 +524,7 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t * pack
                             break;
                     }
                     
-                    device->expected_report_size = hid_get_report_size_for_id(device->cid, device->report_id, device->report_type, hid_device_descriptor_len, hid_device_descriptor);
+                    device->expected_report_size = hid_get_report_size_for_id(device->cid, device->report_id, device->report_type);
                     report_size =  device->expected_report_size + pos; // add 1 for header size and report id
                     
                     if ((packet[0] & 0x08) && (packet_size >= (pos + 1))){
@@ -598,7 +637,7 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t * pack
                     pos = 0;
                     device->report_type = (hid_report_type_t)(packet[pos++] & 0x03);
                     device->report_id = 0;
-                    if (btstack_hid_report_id_declared(hid_device_descriptor_len, hid_device_descriptor)){
+                    if (hid_device_report_id_declared()){
                         device->report_id = packet[pos++];
                     }
                     
@@ -828,6 +867,7 @@ void hid_device_init(bool boot_protocol_mode_supported, uint16_t descriptor_len,
     hid_device_boot_protocol_mode_supported = boot_protocol_mode_supported;
     hid_device_descriptor =  descriptor;
     hid_device_descriptor_len = descriptor_len;
+    hid_device_report_layout_compile();
     hci_device_get_report = dummy_write_report;
     hci_device_set_report = dummy_set_report;
     hci_device_report_data = dummy_report_data;
@@ -847,6 +887,7 @@ void hid_device_deinit(void){
     hid_device_boot_protocol_mode_supported = false;
     hid_device_descriptor = NULL;
     hid_device_descriptor_len = 0;
+    hid_device_report_layout_valid = false;
     hid_device_cid = 0;
 }
 
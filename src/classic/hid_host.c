@@ -53,6 +53,11 @@
 #include "classic/sdp_util.h"
 #include "classic/sdp_client.h"
 
+// SDP query state is kept in globals, parallel queries would overwrite it
+#if MAX_NR_SDP_CLIENT_CONTEXTS > 1
+#error "HID Host does not support MAX_NR_SDP_CLIENT_CONTEXTS > 1"
+#endif
+
 #define MAX_ATTRIBUTE_VALUE_SIZE 300
 
 #define CONTROL_MESSAGE_BITMASK_SUSPEND             1
@@ -171,6 +176,17 @@ uint16_t hid_descriptor_storage_get_descriptor_len(uint16_t hid_cid){
     return connection->hid_descriptor_len;
 }
 
+uint8_t hid_host_compile_report_layout(uint16_t hid_cid, btstack_hid_report_layout_t * layout){
+    hid_host_connection_t * connection = hid_host_get_connection_for_hid_cid(hid_cid);
+    if (!connection){
+        return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    }
+    if (connection->hid_descriptor_status != ERROR_CODE_SUCCESS){
+        return ERROR_CODE_COMMAND_DISALLOWED;
+    }
+    return btstack_hid_report_layout_compile(layout, connection->hid_descriptor_len,
+                                             &hid_host_descriptor_storage[connection->hid_descriptor_offset]);
+}
 
 // HID Util
 static void hid_emit_connected_event(hid_host_connection_t * connection, uint8_t status){
@@ -402,14 +418,17 @@ static void hid_host_handle_sdp_client_query_result(uint8_t packet_type, uint16_
     btstack_assert(connection->state == HID_HOST_W4_SDP_QUERY_RESULT);
     
     switch (hci_event_packet_get_type(packet)){
-        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE:
+        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK:
 
-            if (sdp_event_query_attribute_byte_get_attribute_length(packet) <= hid_host_sdp_attribute_value_buffer_size) {
+            if (sdp_event_query_attribute_value_chunk_get_attribute_length(packet) <= hid_host_sdp_attribute_value_buffer_size) {
 
-                hid_host_sdp_attribute_value[sdp_event_query_attribute_byte_get_data_offset(packet)] = sdp_event_query_attribute_byte_get_data(packet);
+                uint16_t data_offset = sdp_event_query_attribute_value_chunk_get_data_offset(packet);
+                uint8_t  data_len    = sdp_event_query_attribute_value_chunk_get_data_len(packet);
+                if (((uint32_t) data_offset + data_len) > hid_host_sdp_attribute_value_buffer_size) break;
+                (void)memcpy(&hid_host_sdp_attribute_value[data_offset], sdp_event_query_attribute_value_chunk_get_data(packet), data_len);
 
-                if ((uint16_t)(sdp_event_query_attribute_byte_get_data_offset(packet)+1) == sdp_event_query_attribute_byte_get_attribute_length(packet)) {
-                    switch(sdp_event_query_attribute_byte_get_attribute_id(packet)) {
+                if ((uint16_t)(data_offset + data_len) == sdp_event_query_attribute_value_chunk_get_attribute_length(packet)) {
+                    switch(sdp_event_query_attribute_value_chunk_get_attribute_id(packet)) {
                         
                         case BLUETOOTH_ATTRIBUTE_PROTOCOL_DESCRIPTOR_LIST:
                             for (des_iterator_init(&attribute_list_it, hid_host_sdp_attribute_value); des_iterator_has_more(&attribute_list_it); des_iterator_next(&attribute_list_it)) {
@@ -509,7 +528,7 @@ static void hid_host_handle_sdp_client_query_result(uint8_t packet_type, uint16_
                     }
                 }
             } else {
-                log_error("SDP attribute value buffer size exceeded: available %d, required %d", hid_host_sdp_attribute_value_buffer_size, sdp_event_query_attribute_byte_get_attribute_length(packet));
+                log_error("SDP attribute value buffer size exceeded: available %d, required %d", hid_host_sdp_attribute_value_buffer_size, sdp_event_query_attribute_value_chunk_get_attribute_length(packet));
             }
             break;
             
@@ -1073,7 +1092,7 @@ static void hid_host_handle_start_sdp_client_query(void * context){
 
         hid_descriptor_storage_init(connection);
         hid_host_sdp_context_control_cid = connection->hid_cid;
-        sdp_client_query_uuid16(&hid_host_handle_sdp_client_query_result, (uint8_t *) connection->remote_addr, BLUETOOTH_SERVICE_CLASS_HUMAN_INTERFACE_DEVICE_SERVICE);
+        sdp_client_query_uuid16_chunked(&hid_host_handle_sdp_client_query_result, (uint8_t *) connection->remote_addr, BLUETOOTH_SERVICE_CLASS_HUMAN_INTERFACE_DEVICE_SERVICE);
         return;
     }
 }
@@ -276,6 +276,16 @@ const uint8_t * hid_descriptor_storage_get_descriptor_data(uint16_t hid_cid);
  */
 uint16_t hid_descriptor_storage_get_descriptor_len(uint16_t hid_cid);
 
+/*
+ * @brief Compile HID Descriptor of connection into report layout for table-based report decoding.
+ * Call once after HID_SUBEVENT_DESCRIPTOR_AVAILABLE, then use btstack_hid_report_iterator_* on each report.
+ * @param hid_cid
+ * @param layout initialized with btstack_hid_report_layout_init
+ * @result status ERROR_CODE_SUCCESS on success, otherwise ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER,
+ *         ERROR_CODE_COMMAND_DISALLOWED if descriptor not available, ERROR_CODE_MEMORY_CAPACITY_EXCEEDED
+ */
+uint8_t hid_host_compile_report_layout(uint16_t hid_cid, btstack_hid_report_layout_t * layout);
+
 /**
  * @brief De-Init HID Device
  */
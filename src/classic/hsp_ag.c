@@ -670,6 +670,11 @@ static void packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *pack
             status = rfcomm_event_channel_opened_get_status(packet);
             if (status != ERROR_CODE_SUCCESS){
                 log_info("RFCOMM channel open failed, status %u", status);
+#ifdef ENABLE_SDP_CLIENT_CACHE
+                // RFCOMM channel might have been taken from outdated SDP record
+                rfcomm_event_channel_opened_get_bd_addr(packet, event_addr);
+                sdp_client_cache_remove(event_addr);
+#endif
                 hsp_ag_reset_state();
                 hsp_ag_state = HSP_IDLE;
                 memset(hsp_ag_remote, 0, 6);
@@ -650,6 +650,11 @@ static void packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *pack
             status = rfcomm_event_channel_opened_get_status(packet);
             if (status != ERROR_CODE_SUCCESS) {
                 log_info("RFCOMM channel open failed, status %u", status);
+#ifdef ENABLE_SDP_CLIENT_CACHE
+                // RFCOMM channel might have been taken from outdated SDP record
+                rfcomm_event_channel_opened_get_bd_addr(packet, event_addr);
+                sdp_client_cache_remove(event_addr);
+#endif
                 hsp_state = HSP_IDLE;
                 hsp_hs_reset_state();
             } else {
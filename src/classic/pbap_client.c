@@ -656,10 +656,34 @@ static void pbap_client_add_application_parameters(const pbap_client_t * client,
     }
 }
 
-static void pbap_client_prepare_srm_header(const pbap_client_t * client){
-    if (!client->flow_control_enabled && goep_client_version_20_or_higher(client->goep_cid)){
+static void pbap_client_prepare_srm_header(pbap_client_t * client){
+    client->srm_state = SRM_DISABLED;
+    if (goep_client_version_20_or_higher(client->goep_cid)){
         goep_client_header_add_srm_enable(client->goep_cid);
-        pbap_client->srm_state = SRM_W4_CONFIRM;
+        client->srm_state = SRM_W4_CONFIRM;
+    }
+}
+
+static void pbap_client_prepare_srmp_header(const pbap_client_t * client){
+    // in flow control mode, ask PSE to wait for next GET request after each response
+    if (client->flow_control_enabled && (client->srm_state != SRM_DISABLED)){
+        goep_client_header_add_srmp_wait(client->goep_cid);
+    }
+}
+
+// PSE sends all responses of current GET operation without further requests
+static bool pbap_client_srm_streaming(const pbap_client_t * client){
+    if (client->srm_state != SRM_ENABLED){
+        return false;
+    }
+    switch (client->state){
+        case PBAP_W4_PHONEBOOK:
+            return client->flow_control_enabled == 0;
+        case PBAP_W4_GET_CARD_LIST_COMPLETE:
+        case PBAP_W4_GET_CARD_ENTRY_COMPLETE:
+            return true;
+        default:
+            return false;
     }
 }
 
@@ -788,6 +812,7 @@ static void pbap_handle_can_send_now(void){
                 pos += pbap_client_application_params_add_vcard_selector(pbap_client, &application_parameters[pos]);
                 pbap_client_add_application_parameters(pbap_client, application_parameters, pos);
             }
+            pbap_client_prepare_srmp_header(pbap_client);
             // state
             pbap_client->state = PBAP_W4_PHONEBOOK;
             pbap_client->flow_next_triggered = 0;
@@ -921,6 +946,21 @@ static void pbap_client_handle_srm_headers(pbap_client_t *context) {
     log_info("SRM state %u", context->srm_state);
 }
 
+// returns true if PSE sends next response without further GET request
+static bool pbap_client_continue_with_srm(pbap_client_t * client){
+    pbap_client_handle_srm_headers(client);
+    if (pbap_client_srm_streaming(client) == false){
+        return false;
+    }
+    // prepare response
+    pbap_client_prepare_get_operation(client);
+    // abort requested before SRM was confirmed
+    if (client->abort_operation){
+        goep_client_request_can_send_now(client->goep_cid);
+    }
+    return true;
+}
+
 static void pbap_packet_handler_hci(uint8_t *packet, uint16_t size){
     UNUSED(size);
     uint8_t status;
@@ -1020,10 +1060,7 @@ static void pbap_packet_handler_goep(uint8_t *packet, uint16_t size){
             case PBAP_W4_PHONEBOOK:
                 switch (op_info.response_code) {
                     case OBEX_RESP_CONTINUE:
-                        pbap_client_handle_srm_headers(pbap_client);
-                        if (pbap_client->srm_state == SRM_ENABLED) {
-                            // prepare response
-                            pbap_client_prepare_get_operation(pbap_client);
+                        if (pbap_client_continue_with_srm(pbap_client)) {
                             break;
                         }
                         pbap_client->state = PBAP_W2_PULL_PHONEBOOK;
@@ -1063,10 +1100,7 @@ static void pbap_packet_handler_goep(uint8_t *packet, uint16_t size){
                 switch (op_info.response_code) {
                     case OBEX_RESP_CONTINUE:
                         // handle continue
-                        pbap_client_handle_srm_headers(pbap_client);
-                        if (pbap_client->srm_state == SRM_ENABLED) {
-                            // prepare response
-                            pbap_client_prepare_get_operation(pbap_client);
+                        if (pbap_client_continue_with_srm(pbap_client)) {
                             break;
                         }
                         pbap_client->state = PBAP_W2_GET_CARD_LIST;
@@ -1091,10 +1125,7 @@ static void pbap_packet_handler_goep(uint8_t *packet, uint16_t size){
             case PBAP_W4_GET_CARD_ENTRY_COMPLETE:
                 switch (op_info.response_code) {
                     case OBEX_RESP_CONTINUE:
-                        pbap_client_handle_srm_headers(pbap_client);
-                        if (pbap_client->srm_state == SRM_ENABLED) {
-                            // prepare response
-                            pbap_client_prepare_get_operation(pbap_client);
+                        if (pbap_client_continue_with_srm(pbap_client)) {
                             break;
                         }
                         pbap_client->state = PBAP_W2_GET_CARD_ENTRY;
@@ -1116,6 +1147,12 @@ static void pbap_packet_handler_goep(uint8_t *packet, uint16_t size){
                 }
                 break;
             case PBAP_W4_ABORT_COMPLETE:
+                if (op_info.response_code == OBEX_RESP_CONTINUE){
+                    // response to GET request sent before the abort, e.g. with SRM
+                    obex_parser_init_for_response(&pbap_client->obex_parser, OBEX_OPCODE_ABORT, NULL, pbap_client);
+                    pbap_client->obex_parser_waiting_for_response = true;
+                    break;
+                }
                 pbap_client->state = PBAP_CONNECTED;
                 pbap_client_emit_operation_complete_event(pbap_client, OBEX_ABORTED);
                 break;
@@ -1290,6 +1327,10 @@ uint8_t pbap_abort(uint16_t pbap_cid){
     }
     log_info("abort current operation, state 0x%02x", pbap_client->state);
     pbap_client->abort_operation = 1;
+    // no GET request will be sent while the PSE streams responses or the application did not request the next packet
+    if (pbap_client_srm_streaming(pbap_client) || (pbap_client->state == PBAP_W2_PULL_PHONEBOOK)){
+        goep_client_request_can_send_now(pbap_client->goep_cid);
+    }
     return ERROR_CODE_SUCCESS;
 }
 
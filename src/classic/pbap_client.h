@@ -146,6 +146,9 @@ uint8_t pbap_get_phonebook_size(uint16_t pbap_cid, const char * path);
 /**
  * @brief Pull phone book from PSE. The result is reported via registered packet handler (see pbap_connect function),
  * with packet type set to PBAP_DATA_PACKET. Event PBAP_SUBEVENT_OPERATION_COMPLETED marks the end of the phone book. 
+ * If the PSE supports GOEP 2.0, Single Response Mode (SRM) is used and the PSE sends the phone book without waiting
+ * for further requests.
+ * @note The PBAP_DATA_PACKET points into the receive buffer of the L2CAP or RFCOMM channel and is only valid during the callback
  * 
  * @param pbap_cid
  * @param path - note: path is not copied, common path 'telecom/pb.vcf'
@@ -195,7 +198,8 @@ uint8_t pbap_abort(uint16_t pbap_cid);
 
 /**
  * @brief Set flow control mode - default is off. No event is emitted.
- * @note When enabled, pbap_next_packet needs to be called after a packet was processed to receive the next one
+ * @note When enabled, pbap_next_packet needs to be called after a packet was processed to receive the next one.
+ *       With SRM, the PSE is asked to wait for the next request via SRMP header.
  *
  * @param pbap_cid
  * @return status ERROR_CODE_SUCCESS on success, otherwise BTSTACK_BUSY if in a wrong state.
@@ -46,10 +46,12 @@
 #include "bluetooth_sdp.h"
 #include "btstack_debug.h"
 #include "btstack_event.h"
+#include "btstack_run_loop.h"
 #include "classic/core.h"
 #include "classic/sdp_client.h"
 #include "classic/sdp_server.h"
 #include "classic/sdp_util.h"
+#include "gap.h"
 #include "hci_cmd.h"
 #include "l2cap.h"
 
@@ -60,18 +62,89 @@ typedef enum {
     GET_ATTRIBUTE_ID_HEADER_LENGTH,
     GET_ATTRIBUTE_ID,
     GET_ATTRIBUTE_VALUE_LENGTH,
-    GET_ATTRIBUTE_VALUE
+    GET_ATTRIBUTE_VALUE,
+    IGNORE_INVALID_DATA
 } sdp_parser_state_t;
 
 // Types SDP Client 
 typedef enum {
-    INIT, W4_CONNECT, W2_SEND, W4_RESPONSE, QUERY_COMPLETE
+    INIT, W4_CHANNEL, W4_CONNECT, W2_SEND, W4_RESPONSE, QUERY_COMPLETE, W2_DELIVER_CACHED_RESULT
 } sdp_client_state_t;
 
 static uint8_t sdp_client_des_attribute_id_list[] = {0x35, 0x05, 0x0A, 0x00, 0x00, 0xff, 0xff};  // Attribute: 0x0000 - 0xffff
 
+// max data in SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK: event length field is 8 bit, 9 bytes used by other fields
+#define SDP_PARSER_ATTRIBUTE_VALUE_CHUNK_MAX_SIZE 246
+
+#ifdef ENABLE_SDP_CLIENT_CACHE
+// number of cached query results
+#ifndef NVM_NUM_SDP_CLIENT_CACHE_ENTRIES
+#define NVM_NUM_SDP_CLIENT_CACHE_ENTRIES 4
+#endif
+
+// max size of attribute lists in a cached query result
+#ifndef SDP_CLIENT_CACHE_MAX_RESULT_SIZE
+#define SDP_CLIENT_CACHE_MAX_RESULT_SIZE 512
+#endif
+
+// service search pattern followed by attribute id list, fits UUID128 pattern with attribute range list
+#define SDP_CLIENT_CACHE_MAX_KEY_SIZE 40
+
+// stored in TLV, followed by attribute lists
+typedef struct {
+    bd_addr_t addr;
+    uint8_t   key_len;
+    uint8_t   key[SDP_CLIENT_CACHE_MAX_KEY_SIZE];
+    uint16_t  result_len;
+    uint32_t  seq_nr;
+} sdp_client_cache_entry_t;
+#endif
+
+// State SDP Parser
+typedef struct {
+    de_state_t         de_header_state;
+    sdp_parser_state_t state;
+    uint16_t attribute_id;
+    uint16_t attribute_bytes_received;
+    uint16_t attribute_bytes_delivered;
+    uint16_t list_offset;
+    uint16_t list_size;
+    uint16_t record_offset;
+    uint16_t record_size;
+    uint16_t attribute_value_size;
+    int      record_counter;
+    // query id, reported as channel in events
+    uint16_t query_id;
+    btstack_packet_handler_t callback;
+    bool     attribute_value_chunks;
+    uint8_t  attribute_value_header[5];
+} sdp_parser_t;
+
+// State SDP Client
+typedef struct {
+    sdp_client_state_t state;
+    bd_addr_t          remote_addr;
+    uint16_t           cid;
+    uint16_t           mtu;
+    const uint8_t *    service_search_pattern;
+    const uint8_t *    attribute_id_list;
+    uint16_t           transaction_id;
+    uint8_t            continuation_state[16];
+    uint8_t            continuation_state_len;
+    sdp_pdu_id_t       pdu_id;
+#ifdef ENABLE_SDP_EXTRA_QUERIES
+    uint32_t           service_record_handle;
+#endif
+#ifdef ENABLE_SDP_CLIENT_CACHE
+    btstack_timer_source_t cache_timer;
+    uint8_t            cache_index;
+#endif
+    sdp_parser_t       parser;
+} sdp_client_context_t;
+
 // Prototypes SDP Parser
 void sdp_parser_init(btstack_packet_handler_t callback);
+void sdp_parser_enable_attribute_value_chunks(void);
 void sdp_parser_handle_chunk(uint8_t * data, uint16_t size);
 void sdp_parser_handle_done(uint8_t status);
 void sdp_parser_init_service_attribute_search(void);
@@ -81,47 +154,39 @@ void sdp_parser_handle_service_search(uint8_t * data, uint16_t total_count, uint
 // Prototypes SDP Client
 void sdp_client_reset(void);
 void sdp_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
-static uint16_t sdp_client_setup_service_search_attribute_request(uint8_t * data);
+static uint16_t sdp_client_setup_service_search_attribute_request(sdp_client_context_t * context, uint8_t * data);
 #ifdef ENABLE_SDP_EXTRA_QUERIES
-static uint16_t sdp_client_setup_service_search_request(uint8_t * data);
-static uint16_t sdp_client_setup_service_attribute_request(uint8_t * data);
-static void     sdp_client_parse_service_search_response(uint8_t* packet, uint16_t size);
-static void     sdp_client_parse_service_attribute_response(uint8_t* packet, uint16_t size);
+static uint16_t sdp_client_setup_service_search_request(sdp_client_context_t * context, uint8_t * data);
+static uint16_t sdp_client_setup_service_attribute_request(sdp_client_context_t * context, uint8_t * data);
+static void     sdp_client_parse_service_search_response(sdp_client_context_t * context, uint8_t* packet, uint16_t size);
+static void     sdp_client_parse_service_attribute_response(sdp_client_context_t * context, uint8_t* packet, uint16_t size);
+#endif
+#ifdef ENABLE_SDP_CLIENT_CACHE
+static void     sdp_client_cache_record_start(sdp_client_context_t * context);
+static void     sdp_client_cache_record_data(sdp_client_context_t * context, const uint8_t * data, uint16_t len);
+static void     sdp_client_cache_handle_done(sdp_client_context_t * context, uint8_t status);
 #endif
 
-// State DES Parser
-static de_state_t des_parser_de_header_state;
+static sdp_client_context_t sdp_client_contexts[MAX_NR_SDP_CLIENT_CONTEXTS];
 
-// State SDP Parser
-static sdp_parser_state_t sdp_parser_state;
-static uint16_t sdp_parser_attribute_id = 0;
-static uint16_t sdp_parser_attribute_bytes_received;
-static uint16_t sdp_parser_attribute_bytes_delivered;
-static uint16_t sdp_parser_list_offset;
-static uint16_t sdp_parser_list_size;
-static uint16_t sdp_parser_record_offset;
-static uint16_t sdp_parser_record_size;
-static uint16_t sdp_parser_attribute_value_size;
-static int      sdp_parser_record_counter;
-static btstack_packet_handler_t sdp_parser_callback;
-
-// State SDP Client
-static uint16_t  sdp_client_mtu;
-static uint16_t  sdp_client_sdp_cid = 0x40;
-static const uint8_t * sdp_client_service_search_pattern;
-static const uint8_t * sdp_client_attribute_id_list;
-static uint16_t  sdp_client_transaction_id;
-static uint8_t   sdp_client_continuation_state[16];
-static uint8_t   sdp_client_continuation_state_len;
-static sdp_client_state_t sdp_client_state = INIT;
-static sdp_pdu_id_t sdp_client_pdu_id = SDP_Invalid;
+// parser used by sdp_parser_* functions: set on query start and while handling packets of a query
+static sdp_parser_t * sdp_parser_active = &sdp_client_contexts[0].parser;
 
 // Query registration
 static btstack_linked_list_t sdp_client_query_requests;
 
-#ifdef ENABLE_SDP_EXTRA_QUERIES
-static uint32_t sdp_client_service_record_handle;
-static uint32_t sdp_client_record_handle;
+#ifdef ENABLE_SDP_CLIENT_CACHE
+static const btstack_tlv_t *    sdp_client_cache_tlv_impl;
+static void *                   sdp_client_cache_tlv_context;
+static sdp_client_cache_entry_t sdp_client_cache_entries[NVM_NUM_SDP_CLIENT_CACHE_ENTRIES];
+static uint32_t                 sdp_client_cache_highest_seq_nr;
+static uint32_t                 sdp_client_cache_hits;
+static uint32_t                 sdp_client_cache_misses;
+// result of one query is recorded at a time
+static sdp_client_context_t *   sdp_client_cache_record_context;
+static uint16_t                 sdp_client_cache_record_len;
+static uint8_t                  sdp_client_cache_record_buffer[sizeof(sdp_client_cache_entry_t) + SDP_CLIENT_CACHE_MAX_RESULT_SIZE];
+static uint8_t                  sdp_client_cache_result_buffer[sizeof(sdp_client_cache_entry_t) + SDP_CLIENT_CACHE_MAX_RESULT_SIZE];
 #endif
 
 // DES Parser
@@ -163,102 +228,151 @@ int de_state_size(uint8_t eventByte, de_state_t *de_state){
 }
 
 // SDP Parser
-static void sdp_parser_emit_value_byte(uint8_t event_byte){
+static void sdp_parser_emit_value_byte(sdp_parser_t * parser, uint8_t event_byte){
     uint8_t event[11];
     event[0] = SDP_EVENT_QUERY_ATTRIBUTE_VALUE;
     event[1] = 9;
-    little_endian_store_16(event, 2, sdp_parser_record_counter);
-    little_endian_store_16(event, 4, sdp_parser_attribute_id);
-    little_endian_store_16(event, 6, sdp_parser_attribute_value_size);
-    little_endian_store_16(event, 8, sdp_parser_attribute_bytes_delivered);
+    little_endian_store_16(event, 2, parser->record_counter);
+    little_endian_store_16(event, 4, parser->attribute_id);
+    little_endian_store_16(event, 6, parser->attribute_value_size);
+    little_endian_store_16(event, 8, parser->attribute_bytes_delivered);
     event[10] = event_byte;
-    (*sdp_parser_callback)(HCI_EVENT_PACKET, 0, event, sizeof(event)); 
+    (*parser->callback)(HCI_EVENT_PACKET, parser->query_id, event, sizeof(event));
+}
+
+// emits data element header bytes not delivered yet followed by len bytes of data
+static void sdp_parser_emit_value_chunk(sdp_parser_t * parser, const uint8_t * data, uint16_t len){
+    uint8_t event[11 + SDP_PARSER_ATTRIBUTE_VALUE_CHUNK_MAX_SIZE];
+    uint16_t header_len = parser->attribute_bytes_received - len - parser->attribute_bytes_delivered;
+    uint16_t chunk_len  = header_len + len;
+    event[0] = SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK;
+    event[1] = (uint8_t) (9 + chunk_len);
+    little_endian_store_16(event, 2, parser->record_counter);
+    little_endian_store_16(event, 4, parser->attribute_id);
+    little_endian_store_16(event, 6, parser->attribute_value_size);
+    little_endian_store_16(event, 8, parser->attribute_bytes_delivered);
+    event[10] = (uint8_t) chunk_len;
+    (void)memcpy(&event[11], &parser->attribute_value_header[parser->attribute_bytes_delivered], header_len);
+    if (len > 0){
+        (void)memcpy(&event[11 + header_len], data, len);
+    }
+    (*parser->callback)(HCI_EVENT_PACKET, parser->query_id, event, 11 + chunk_len);
+    parser->attribute_bytes_delivered += chunk_len;
+}
+
+static void sdp_parser_handle_attribute_value_complete(sdp_parser_t * parser){
+    // log_debug("parser: Record offset %u, record size %u", record_offset, record_size);
+    if (parser->record_offset != parser->record_size){
+        parser->state = GET_ATTRIBUTE_ID_HEADER_LENGTH;
+        // log_debug("Get next attribute");
+        return;
+    }
+    parser->record_offset = 0;
+    // log_debug("parser: List offset %u, list size %u", list_offset, list_size);
+
+    if ((parser->list_size > 0) && (parser->list_offset != parser->list_size)){
+        parser->record_counter++;
+        parser->state = GET_RECORD_LENGTH;
+        log_debug("parser: END_OF_RECORD");
+        return;
+    }
+    parser->list_offset = 0;
+    de_state_init(&parser->de_header_state);
+    parser->state = GET_LIST_LENGTH;
+    parser->record_counter = 0;
+    log_debug("parser: END_OF_RECORD & DONE");
 }
 
-static void sdp_parser_process_byte(uint8_t eventByte){
+static void sdp_parser_process_byte(sdp_parser_t * parser, uint8_t eventByte){
+    uint32_t attribute_value_size;
+
     // count all bytes
-    sdp_parser_list_offset++;
-    sdp_parser_record_offset++;
+    parser->list_offset++;
+    parser->record_offset++;
 
     // log_info(" parse BYTE_RECEIVED %02x", eventByte);
-    switch(sdp_parser_state){
+    switch(parser->state){
         case GET_LIST_LENGTH:
-            if (!de_state_size(eventByte, &des_parser_de_header_state)) break;
-            sdp_parser_list_offset = des_parser_de_header_state.de_offset;
-            sdp_parser_list_size = des_parser_de_header_state.de_size;
+            if (!de_state_size(eventByte, &parser->de_header_state)) break;
+            parser->list_offset = parser->de_header_state.de_offset;
+            parser->list_size = parser->de_header_state.de_size;
             // log_info("parser: List offset %u, list size %u", list_offset, list_size);
             
-            sdp_parser_record_counter = 0;
-            sdp_parser_state = GET_RECORD_LENGTH;
+            parser->record_counter = 0;
+            parser->state = GET_RECORD_LENGTH;
             break;
 
         case GET_RECORD_LENGTH:
             // check size
-            if (!de_state_size(eventByte, &des_parser_de_header_state)) break;
+            if (!de_state_size(eventByte, &parser->de_header_state)) break;
             // log_info("parser: Record payload is %d bytes.", de_header_state.de_size);
-            sdp_parser_record_offset = des_parser_de_header_state.de_offset;
-            sdp_parser_record_size = des_parser_de_header_state.de_size;
-            sdp_parser_state = GET_ATTRIBUTE_ID_HEADER_LENGTH;
+            parser->record_offset = parser->de_header_state.de_offset;
+            parser->record_size = parser->de_header_state.de_size;
+            parser->state = GET_ATTRIBUTE_ID_HEADER_LENGTH;
             break;
 
         case GET_ATTRIBUTE_ID_HEADER_LENGTH:
-            if (!de_state_size(eventByte, &des_parser_de_header_state)) break;
-            sdp_parser_attribute_id = 0;
-            log_debug("ID data is stored in %d bytes.", (int) des_parser_de_header_state.de_size);
-            sdp_parser_state = GET_ATTRIBUTE_ID;
+            if (!de_state_size(eventByte, &parser->de_header_state)) break;
+            parser->attribute_id = 0;
+            log_debug("ID data is stored in %d bytes.", (int) parser->de_header_state.de_size);
+            parser->state = GET_ATTRIBUTE_ID;
             break;
         
         case GET_ATTRIBUTE_ID:
-            sdp_parser_attribute_id = (sdp_parser_attribute_id << 8) | eventByte;
-            des_parser_de_header_state.de_size--;
-            if (des_parser_de_header_state.de_size > 0) break;
-            log_debug("parser: Attribute ID: %04x.", sdp_parser_attribute_id);
-
-            sdp_parser_state = GET_ATTRIBUTE_VALUE_LENGTH;
-            sdp_parser_attribute_bytes_received  = 0;
-            sdp_parser_attribute_bytes_delivered = 0;
-            sdp_parser_attribute_value_size      = 0;
-            de_state_init(&des_parser_de_header_state);
+            parser->attribute_id = (parser->attribute_id << 8) | eventByte;
+            parser->de_header_state.de_size--;
+            if (parser->de_header_state.de_size > 0) break;
+            log_debug("parser: Attribute ID: %04x.", parser->attribute_id);
+
+            parser->state = GET_ATTRIBUTE_VALUE_LENGTH;
+            parser->attribute_bytes_received  = 0;
+            parser->attribute_bytes_delivered = 0;
+            parser->attribute_value_size      = 0;
+            de_state_init(&parser->de_header_state);
             break;
         
         case GET_ATTRIBUTE_VALUE_LENGTH:
-            sdp_parser_attribute_bytes_received++;
-            sdp_parser_emit_value_byte(eventByte);
-            sdp_parser_attribute_bytes_delivered++;
-            if (!de_state_size(eventByte, &des_parser_de_header_state)) break;
+            if (parser->attribute_value_chunks){
+                // collect data element header, delivered as first chunk
+                if (parser->attribute_bytes_received >= sizeof(parser->attribute_value_header)) break;
+                parser->attribute_value_header[parser->attribute_bytes_received] = eventByte;
+                parser->attribute_bytes_received++;
+            } else {
+                parser->attribute_bytes_received++;
+                sdp_parser_emit_value_byte(parser, eventByte);
+                parser->attribute_bytes_delivered++;
+            }
+            if (!de_state_size(eventByte, &parser->de_header_state)) break;
 
-            sdp_parser_attribute_value_size = des_parser_de_header_state.de_size + sdp_parser_attribute_bytes_received;
+            // attribute value incl. header has to fit into 16 bit, ignore rest of response otherwise
+            attribute_value_size = (uint32_t) parser->attribute_bytes_received + parser->de_header_state.de_size;
+            if ((parser->de_header_state.de_size > 0xffffu) || (attribute_value_size > 0xffffu)){
+                log_error("parser: attribute value size %u too large", (unsigned int) parser->de_header_state.de_size);
+                parser->state = IGNORE_INVALID_DATA;
+                break;
+            }
+            parser->attribute_value_size = (uint16_t) attribute_value_size;
+
+            // data element without payload, e.g. nil
+            if (parser->attribute_bytes_received == parser->attribute_value_size){
+                if (parser->attribute_value_chunks){
+                    sdp_parser_emit_value_chunk(parser, NULL, 0);
+                }
+                sdp_parser_handle_attribute_value_complete(parser);
+                break;
+            }
 
-            sdp_parser_state = GET_ATTRIBUTE_VALUE;
+            parser->state = GET_ATTRIBUTE_VALUE;
             break;
         
         case GET_ATTRIBUTE_VALUE: 
-            sdp_parser_attribute_bytes_received++;
-            sdp_parser_emit_value_byte(eventByte);
-            sdp_parser_attribute_bytes_delivered++;
+            parser->attribute_bytes_received++;
+            sdp_parser_emit_value_byte(parser, eventByte);
+            parser->attribute_bytes_delivered++;
             // log_debug("paser: attribute_bytes_received %u, attribute_value_size %u", attribute_bytes_received, attribute_value_size);
 
-            if (sdp_parser_attribute_bytes_received < sdp_parser_attribute_value_size) break;
-            // log_debug("parser: Record offset %u, record size %u", record_offset, record_size);
-            if (sdp_parser_record_offset != sdp_parser_record_size){
-                sdp_parser_state = GET_ATTRIBUTE_ID_HEADER_LENGTH;
-                // log_debug("Get next attribute");
-                break;
-            }
-            sdp_parser_record_offset = 0;
-            // log_debug("parser: List offset %u, list size %u", list_offset, list_size);
-            
-            if ((sdp_parser_list_size > 0) && (sdp_parser_list_offset != sdp_parser_list_size)){
-                sdp_parser_record_counter++;
-                sdp_parser_state = GET_RECORD_LENGTH;
-                log_debug("parser: END_OF_RECORD");
-                break;
-            }
-            sdp_parser_list_offset = 0;
-            de_state_init(&des_parser_de_header_state);
-            sdp_parser_state = GET_LIST_LENGTH;
-            sdp_parser_record_counter = 0;
-            log_debug("parser: END_OF_RECORD & DONE");
+            if (parser->attribute_bytes_received < parser->attribute_value_size) break;
+            sdp_parser_handle_attribute_value_complete(parser);
             break;
         default:
             break;
@@ -267,42 +381,49 @@ static void sdp_parser_process_byte(uint8_t eventByte){
 
 void sdp_parser_init(btstack_packet_handler_t callback){
     // init
-    sdp_parser_callback = callback;
-    de_state_init(&des_parser_de_header_state);
-    sdp_parser_state = GET_LIST_LENGTH;
-    sdp_parser_list_offset = 0;
-    sdp_parser_list_size = 0;
-    sdp_parser_record_offset = 0;
-    sdp_parser_record_counter = 0;
-    sdp_parser_record_size = 0;
-    sdp_parser_attribute_id = 0;
-    sdp_parser_attribute_bytes_received = 0;
-    sdp_parser_attribute_bytes_delivered = 0;
+    sdp_parser_t * parser = sdp_parser_active;
+    parser->callback = callback;
+    de_state_init(&parser->de_header_state);
+    parser->state = GET_LIST_LENGTH;
+    parser->list_offset = 0;
+    parser->list_size = 0;
+    parser->record_offset = 0;
+    parser->record_counter = 0;
+    parser->record_size = 0;
+    parser->attribute_id = 0;
+    parser->attribute_bytes_received = 0;
+    parser->attribute_bytes_delivered = 0;
+    parser->attribute_value_chunks = false;
 }
 
-static void sdp_parser_deinit(void) {
-    sdp_parser_callback = NULL;
-    sdp_parser_attribute_value_size = 0;
-    sdp_parser_record_counter = 0;
+void sdp_parser_enable_attribute_value_chunks(void){
+    sdp_parser_active->attribute_value_chunks = true;
 }
 
 void sdp_client_init(void){
 }
 
 void sdp_client_deinit(void){
-    sdp_parser_deinit();
-    sdp_client_state = INIT;
-    sdp_client_sdp_cid = 0x40;
-    sdp_client_service_search_pattern = NULL;
-    sdp_client_attribute_id_list = NULL;
-    sdp_client_transaction_id = 0;
-    sdp_client_continuation_state_len = 0;
-    sdp_client_state = INIT;
-    sdp_client_pdu_id = SDP_Invalid;
-#ifdef ENABLE_SDP_EXTRA_QUERIES
-    sdp_client_service_record_handle = 0;
-    sdp_client_record_handle = 0;
+    uint16_t i;
+#ifdef ENABLE_SDP_CLIENT_CACHE
+    for (i = 0; i < MAX_NR_SDP_CLIENT_CONTEXTS; i++){
+        if (sdp_client_contexts[i].state == W2_DELIVER_CACHED_RESULT){
+            btstack_run_loop_remove_timer(&sdp_client_contexts[i].cache_timer);
+        }
+    }
+    sdp_client_cache_tlv_impl = NULL;
+    sdp_client_cache_tlv_context = NULL;
+    sdp_client_cache_record_context = NULL;
+    sdp_client_cache_hits = 0;
+    sdp_client_cache_misses = 0;
 #endif
+    (void)memset(sdp_client_contexts, 0, sizeof(sdp_client_contexts));
+    for (i = 0; i < MAX_NR_SDP_CLIENT_CONTEXTS; i++){
+        sdp_client_contexts[i].state = INIT;
+        sdp_client_contexts[i].pdu_id = SDP_Invalid;
+        sdp_client_contexts[i].parser.query_id = i;
+    }
+    sdp_parser_active = &sdp_client_contexts[0].parser;
 }
 
 // for testing only
@@ -310,111 +431,232 @@ void sdp_client_reset(void){
     sdp_client_deinit();
 }
 
+// deliver contiguous part of attribute value, returns number of bytes consumed
+static uint16_t sdp_parser_process_attribute_value_span(sdp_parser_t * parser, const uint8_t * data, uint16_t size){
+    // data element header is delivered together with first chunk
+    uint16_t header_len = parser->attribute_bytes_received - parser->attribute_bytes_delivered;
+    if (parser->attribute_value_size <= parser->attribute_bytes_received){
+        log_error("parser: invalid attribute value size %u", parser->attribute_value_size);
+        parser->state = IGNORE_INVALID_DATA;
+        return size;
+    }
+    uint16_t len = (uint16_t) btstack_min(size, parser->attribute_value_size - parser->attribute_bytes_received);
+    len = (uint16_t) btstack_min(len, SDP_PARSER_ATTRIBUTE_VALUE_CHUNK_MAX_SIZE - header_len);
+
+    // count all bytes
+    parser->list_offset   += len;
+    parser->record_offset += len;
+    parser->attribute_bytes_received += len;
+    sdp_parser_emit_value_chunk(parser, data, len);
+
+    if (parser->attribute_bytes_received == parser->attribute_value_size){
+        sdp_parser_handle_attribute_value_complete(parser);
+    }
+    return len;
+}
+
 void sdp_parser_handle_chunk(uint8_t * data, uint16_t size){
-    int i;
-    for (i=0;i<size;i++){
-        sdp_parser_process_byte(data[i]);
+    sdp_parser_t * parser = sdp_parser_active;
+    uint16_t pos = 0;
+    while (pos < size){
+        if (parser->attribute_value_chunks && (parser->state == GET_ATTRIBUTE_VALUE)){
+            pos += sdp_parser_process_attribute_value_span(parser, &data[pos], size - pos);
+        } else {
+            sdp_parser_process_byte(parser, data[pos]);
+            pos++;
+        }
     }
 }
 
 #ifdef ENABLE_SDP_EXTRA_QUERIES
 void sdp_parser_init_service_attribute_search(void){
     // init
-    de_state_init(&des_parser_de_header_state);
-    sdp_parser_state = GET_RECORD_LENGTH;
-    sdp_parser_list_offset = 0;
-    sdp_parser_record_offset = 0;
-    sdp_parser_record_counter = 0;
+    sdp_parser_t * parser = sdp_parser_active;
+    de_state_init(&parser->de_header_state);
+    parser->state = GET_RECORD_LENGTH;
+    parser->list_offset = 0;
+    parser->record_offset = 0;
+    parser->record_counter = 0;
 }
 
 void sdp_parser_init_service_search(void){
-    sdp_parser_record_offset = 0;
+    sdp_parser_active->record_offset = 0;
 }
 
 void sdp_parser_handle_service_search(uint8_t * data, uint16_t total_count, uint16_t record_handle_count){
+    sdp_parser_t * parser = sdp_parser_active;
     int i;
     for (i=0;i<record_handle_count;i++){
-        sdp_client_record_handle = big_endian_read_32(data, i * 4);
-        sdp_parser_record_counter++;
+        uint32_t record_handle = big_endian_read_32(data, i * 4);
+        parser->record_counter++;
         uint8_t event[10];
         event[0] = SDP_EVENT_QUERY_SERVICE_RECORD_HANDLE;
         event[1] = 8;
         little_endian_store_16(event, 2, total_count);
-        little_endian_store_16(event, 4, sdp_parser_record_counter);
-        little_endian_store_32(event, 6, sdp_client_record_handle);
-        (*sdp_parser_callback)(HCI_EVENT_PACKET, 0, event, sizeof(event)); 
+        little_endian_store_16(event, 4, parser->record_counter);
+        little_endian_store_32(event, 6, record_handle);
+        (*parser->callback)(HCI_EVENT_PACKET, parser->query_id, event, sizeof(event));
     }        
 }
 #endif
 
 static void sdp_client_notify_callbacks(void){
-    if (sdp_client_ready() == false) {
-        return;
-    }
-    btstack_context_callback_registration_t * callback = (btstack_context_callback_registration_t*) btstack_linked_list_pop(&sdp_client_query_requests);
-    if (callback == NULL) {
-        return;
+    while (sdp_client_ready()) {
+        btstack_context_callback_registration_t * callback = (btstack_context_callback_registration_t*) btstack_linked_list_pop(&sdp_client_query_requests);
+        if (callback == NULL) {
+            return;
+        }
+        (*callback->callback)(callback->context);
     }
-    (*callback->callback)(callback->context);
 }
 
-void sdp_parser_handle_done(uint8_t status){
-    // reset state
-    sdp_client_state = INIT;
+static void sdp_client_handle_done(sdp_client_context_t * context, uint8_t status){
+    btstack_packet_handler_t callback = context->parser.callback;
+    uint16_t query_id = context->parser.query_id;
+
+#ifdef ENABLE_SDP_CLIENT_CACHE
+    sdp_client_cache_handle_done(context, status);
+#endif
+
+    // free context
+    context->state = INIT;
 
     // emit query complete event
     uint8_t event[3];
     event[0] = SDP_EVENT_QUERY_COMPLETE;
     event[1] = 1;
     event[2] = status;
-    (*sdp_parser_callback)(HCI_EVENT_PACKET, 0, event, sizeof(event)); 
+    (*callback)(HCI_EVENT_PACKET, query_id, event, sizeof(event));
 
     // trigger next query if pending
     sdp_client_notify_callbacks();
 }
 
+void sdp_parser_handle_done(uint8_t status){
+    sdp_client_handle_done(&sdp_client_contexts[sdp_parser_active->query_id], status);
+}
+
 // SDP Client
 
-// TODO: inline if not needed (des(des))
+static bool sdp_client_context_uses_channel(const sdp_client_context_t * context){
+    switch (context->state){
+        case W4_CONNECT:
+        case W2_SEND:
+        case W4_RESPONSE:
+        case QUERY_COMPLETE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static sdp_client_context_t * sdp_client_get_context_for_cid(uint16_t cid){
+    uint16_t i;
+    for (i = 0; i < MAX_NR_SDP_CLIENT_CONTEXTS; i++){
+        sdp_client_context_t * context = &sdp_client_contexts[i];
+        if (sdp_client_context_uses_channel(context) == false) continue;
+        if (context->cid == cid) return context;
+    }
+    return NULL;
+}
+
+// returns context that currently uses or sets up the L2CAP channel to remote
+static sdp_client_context_t * sdp_client_get_active_context_for_addr(const bd_addr_t addr){
+    uint16_t i;
+    for (i = 0; i < MAX_NR_SDP_CLIENT_CONTEXTS; i++){
+        sdp_client_context_t * context = &sdp_client_contexts[i];
+        if (sdp_client_context_uses_channel(context) == false) continue;
+        if (bd_addr_cmp(context->remote_addr, addr) == 0) return context;
+    }
+    return NULL;
+}
+
+static sdp_client_context_t * sdp_client_get_waiting_context_for_addr(const bd_addr_t addr){
+    uint16_t i;
+    for (i = 0; i < MAX_NR_SDP_CLIENT_CONTEXTS; i++){
+        sdp_client_context_t * context = &sdp_client_contexts[i];
+        if (context->state != W4_CHANNEL) continue;
+        if (bd_addr_cmp(context->remote_addr, addr) == 0) return context;
+    }
+    return NULL;
+}
+
+static uint8_t sdp_client_connect(sdp_client_context_t * context){
+    context->state = W4_CONNECT;
+    return l2cap_create_channel(sdp_client_packet_handler, context->remote_addr, BLUETOOTH_PSM_SDP, l2cap_max_mtu(), &context->cid);
+}
+
+// L2CAP channel to remote closed or connect failed: open new channel for next query waiting for it
+static void sdp_client_connect_waiting_context(const bd_addr_t addr){
+    while (true){
+        sdp_client_context_t * context = sdp_client_get_waiting_context_for_addr(addr);
+        if (context == NULL) return;
+        uint8_t status = sdp_client_connect(context);
+        if (status == ERROR_CODE_SUCCESS) return;
+        sdp_client_handle_done(context, status);
+    }
+}
 
-static void sdp_client_parse_attribute_lists(uint8_t* packet, uint16_t length){
+static void sdp_client_handle_query_complete(sdp_client_context_t * context){
+    // pass L2CAP channel on to next query for same remote
+    sdp_client_context_t * waiting_context = sdp_client_get_waiting_context_for_addr(context->remote_addr);
+    if (waiting_context != NULL){
+        log_debug("SDP Client Query DONE, reuse cid %x", context->cid);
+        waiting_context->cid = context->cid;
+        waiting_context->mtu = context->mtu;
+        waiting_context->state = W2_SEND;
+        sdp_client_handle_done(context, ERROR_CODE_SUCCESS);
+        l2cap_request_can_send_now_event(waiting_context->cid);
+        return;
+    }
+    log_debug("SDP Client Query DONE! ");
+    context->state = QUERY_COMPLETE;
+    l2cap_disconnect(context->cid);
+}
+
+static void sdp_client_parse_attribute_lists(sdp_client_context_t * context, uint8_t* packet, uint16_t length){
+#ifdef ENABLE_SDP_CLIENT_CACHE
+    sdp_client_cache_record_data(context, packet, length);
+#else
+    UNUSED(context);
+#endif
     sdp_parser_handle_chunk(packet, length);
 }
 
 
-static void sdp_client_send_request(uint16_t channel){
+static void sdp_client_send_request(sdp_client_context_t * context){
 
-    if (sdp_client_state != W2_SEND) return;
+    if (context->state != W2_SEND) return;
 
     l2cap_reserve_packet_buffer();
     uint8_t * data = l2cap_get_outgoing_buffer();
     uint16_t request_len = 0;
 
-    switch (sdp_client_pdu_id){
+    switch (context->pdu_id){
 #ifdef ENABLE_SDP_EXTRA_QUERIES
         case SDP_ServiceSearchResponse:
-            request_len = sdp_client_setup_service_search_request(data);
+            request_len = sdp_client_setup_service_search_request(context, data);
             break;
         case SDP_ServiceAttributeResponse:
-            request_len = sdp_client_setup_service_attribute_request(data);
+            request_len = sdp_client_setup_service_attribute_request(context, data);
             break;
 #endif
         case SDP_ServiceSearchAttributeResponse:
-            request_len = sdp_client_setup_service_search_attribute_request(data);
+            request_len = sdp_client_setup_service_search_attribute_request(context, data);
             break;
         default:
-            log_error("SDP Client sdp_client_send_request :: PDU ID invalid. %u", sdp_client_pdu_id);
+            log_error("SDP Client sdp_client_send_request :: PDU ID invalid. %u", context->pdu_id);
             return;
     }
 
     // prevent re-entrance
-    sdp_client_state = W4_RESPONSE;
-    sdp_client_pdu_id = SDP_Invalid;
-    l2cap_send_prepared(channel, request_len);
+    context->state = W4_RESPONSE;
+    context->pdu_id = SDP_Invalid;
+    l2cap_send_prepared(context->cid, request_len);
 }
 
 
-static void sdp_client_parse_service_search_attribute_response(uint8_t* packet, uint16_t size){
+static void sdp_client_parse_service_search_attribute_response(sdp_client_context_t * context, uint8_t* packet, uint16_t size){
 
     uint16_t offset = 3;
     if ((offset + 2 + 2) > size) return;  // parameterLength + attributeListByteCount
@@ -425,75 +667,81 @@ static void sdp_client_parse_service_search_attribute_response(uint8_t* packet,
     // AttributeListByteCount <= mtu
     uint16_t attributeListByteCount = big_endian_read_16(packet,offset);
     offset+=2;
-    if (attributeListByteCount > sdp_client_mtu){
+    if (attributeListByteCount > context->mtu){
         log_error("Error parsing ServiceSearchAttributeResponse: Number of bytes in found attribute list is larger then the MaximumAttributeByteCount.");
         return;
     }
 
     // AttributeLists
     if ((offset + attributeListByteCount) > size) return;
-    sdp_client_parse_attribute_lists(packet+offset, attributeListByteCount);
+    sdp_client_parse_attribute_lists(context, packet+offset, attributeListByteCount);
     offset+=attributeListByteCount;
 
     // continuation state len
     if ((offset + 1) > size) return;
-    sdp_client_continuation_state_len = packet[offset];
+    context->continuation_state_len = packet[offset];
     offset++;
-    if (sdp_client_continuation_state_len > 16){
-        sdp_client_continuation_state_len = 0;
+    if (context->continuation_state_len > 16){
+        context->continuation_state_len = 0;
         log_error("Error parsing ServiceSearchAttributeResponse: Number of bytes in continuation state exceedes 16.");
         return;
     }
 
     // continuation state
-    if ((offset + sdp_client_continuation_state_len) > size) return;
-    (void)memcpy(sdp_client_continuation_state, packet + offset, sdp_client_continuation_state_len);
+    if ((offset + context->continuation_state_len) > size) return;
+    (void)memcpy(context->continuation_state, packet + offset, context->continuation_state_len);
     // offset+=continuationStateLen;
 }
 
-void sdp_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
-    
-    // uint16_t handle;
-    if (packet_type == L2CAP_DATA_PACKET){
-        if (size < 3) return;
-        uint16_t responseTransactionID = big_endian_read_16(packet,1);
-        if (responseTransactionID != sdp_client_transaction_id){
-            log_error("Mismatching transaction ID, expected %u, found %u.", sdp_client_transaction_id, responseTransactionID);
-            return;
-        }
+static void sdp_client_handle_data_packet(sdp_client_context_t * context, uint8_t *packet, uint16_t size){
+    if (size < 3) return;
+    uint16_t responseTransactionID = big_endian_read_16(packet,1);
+    if (responseTransactionID != context->transaction_id){
+        log_error("Mismatching transaction ID, expected %u, found %u.", context->transaction_id, responseTransactionID);
+        return;
+    }
 
-        sdp_client_pdu_id = (sdp_pdu_id_t)packet[0];
-        switch (sdp_client_pdu_id){
-            case SDP_ErrorResponse:
-                log_error("Received error response with code %u, disconnecting", packet[2]);
-                l2cap_disconnect(sdp_client_sdp_cid);
-                return;
+    sdp_parser_active = &context->parser;
+    context->pdu_id = (sdp_pdu_id_t)packet[0];
+    switch (context->pdu_id){
+        case SDP_ErrorResponse:
+            log_error("Received error response with code %u, disconnecting", packet[2]);
+            l2cap_disconnect(context->cid);
+            return;
 #ifdef ENABLE_SDP_EXTRA_QUERIES
-            case SDP_ServiceSearchResponse:
-                sdp_client_parse_service_search_response(packet, size);
-                break;
-            case SDP_ServiceAttributeResponse:
-                sdp_client_parse_service_attribute_response(packet, size);
-                break;
+        case SDP_ServiceSearchResponse:
+            sdp_client_parse_service_search_response(context, packet, size);
+            break;
+        case SDP_ServiceAttributeResponse:
+            sdp_client_parse_service_attribute_response(context, packet, size);
+            break;
 #endif
-            case SDP_ServiceSearchAttributeResponse:
-                sdp_client_parse_service_search_attribute_response(packet, size);
-                break;
-            default:
-                log_error("PDU ID %u unexpected/invalid", sdp_client_pdu_id);
-                return;
-        }
-
-        // continuation set or DONE?
-        if (sdp_client_continuation_state_len == 0){
-            log_debug("SDP Client Query DONE! ");
-            sdp_client_state = QUERY_COMPLETE;
-            l2cap_disconnect(sdp_client_sdp_cid);
+        case SDP_ServiceSearchAttributeResponse:
+            sdp_client_parse_service_search_attribute_response(context, packet, size);
+            break;
+        default:
+            log_error("PDU ID %u unexpected/invalid", context->pdu_id);
             return;
-        }
-        // prepare next request and send
-        sdp_client_state = W2_SEND;
-        l2cap_request_can_send_now_event(sdp_client_sdp_cid);
+    }
+
+    // continuation set or DONE?
+    if (context->continuation_state_len == 0){
+        sdp_client_handle_query_complete(context);
+        return;
+    }
+    // prepare next request and send
+    context->state = W2_SEND;
+    l2cap_request_can_send_now_event(context->cid);
+}
+
+void sdp_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    sdp_client_context_t * context;
+    bd_addr_t addr;
+
+    if (packet_type == L2CAP_DATA_PACKET){
+        context = sdp_client_get_context_for_cid(channel);
+        if (context == NULL) return;
+        sdp_client_handle_data_packet(context, packet, size);
         return;
     }
     
@@ -501,35 +749,39 @@ void sdp_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
     
     switch(hci_event_packet_get_type(packet)){
         case L2CAP_EVENT_CHANNEL_OPENED:
-            if (sdp_client_state != W4_CONNECT) break;
+            context = sdp_client_get_context_for_cid(l2cap_event_channel_opened_get_local_cid(packet));
+            if (context == NULL) break;
+            if (context->state != W4_CONNECT) break;
             // data: event (8), len(8), status (8), address(48), handle (16), psm (16), local_cid(16), remote_cid (16), local_mtu(16), remote_mtu(16) 
             if (packet[2]) {
                 log_info("SDP Client Connection failed, status 0x%02x.", packet[2]);
-                sdp_parser_handle_done(packet[2]);
+                bd_addr_copy(addr, context->remote_addr);
+                sdp_client_handle_done(context, packet[2]);
+                sdp_client_connect_waiting_context(addr);
                 break;
             }
-            sdp_client_sdp_cid = channel;
-            sdp_client_mtu = little_endian_read_16(packet, 17);
+            context->mtu = little_endian_read_16(packet, 17);
             // handle = little_endian_read_16(packet, 9);
-            log_debug("SDP Client Connected, cid %x, mtu %u.", sdp_client_sdp_cid, sdp_client_mtu);
+            log_debug("SDP Client Connected, cid %x, mtu %u.", context->cid, context->mtu);
 
-            sdp_client_state = W2_SEND;
-            l2cap_request_can_send_now_event(sdp_client_sdp_cid);
+            context->state = W2_SEND;
+            l2cap_request_can_send_now_event(context->cid);
             break;
 
         case L2CAP_EVENT_CAN_SEND_NOW:
-            if(l2cap_event_can_send_now_get_local_cid(packet) == sdp_client_sdp_cid){
-                sdp_client_send_request(sdp_client_sdp_cid);
-            }
+            context = sdp_client_get_context_for_cid(l2cap_event_can_send_now_get_local_cid(packet));
+            if (context == NULL) break;
+            sdp_client_send_request(context);
             break;
         case L2CAP_EVENT_CHANNEL_CLOSED: {
-            if (sdp_client_sdp_cid != little_endian_read_16(packet, 2)) {
-                // log_info("Received L2CAP_EVENT_CHANNEL_CLOSED for cid %x, current cid %x\n",  little_endian_read_16(packet, 2),sdp_cid);
-                break;
-            }
+            context = sdp_client_get_context_for_cid(little_endian_read_16(packet, 2));
+            if (context == NULL) break;
             log_info("SDP Client disconnected.");
-            uint8_t status = (sdp_client_state == QUERY_COMPLETE) ? 0 : SDP_QUERY_INCOMPLETE;
-            sdp_parser_handle_done(status);
+            uint8_t status = (context->state == QUERY_COMPLETE) ? 0 : SDP_QUERY_INCOMPLETE;
+            bd_addr_copy(addr, context->remote_addr);
+            sdp_parser_active = &context->parser;
+            sdp_client_handle_done(context, status);
+            sdp_client_connect_waiting_context(addr);
             break;
         }
         default:
@@ -538,14 +790,14 @@ void sdp_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
 }
 
 
-static uint16_t sdp_client_setup_service_search_attribute_request(uint8_t * data){
+static uint16_t sdp_client_setup_service_search_attribute_request(sdp_client_context_t * context, uint8_t * data){
 
     uint16_t offset = 0;
-    sdp_client_transaction_id++;
+    context->transaction_id++;
     // uint8_t SDP_PDU_ID_t.SDP_ServiceSearchRequest;
     data[offset++] = SDP_ServiceSearchAttributeRequest;
     // uint16_t transactionID
-    big_endian_store_16(data, offset, sdp_client_transaction_id);
+    big_endian_store_16(data, offset, context->transaction_id);
     offset += 2;
 
     // param legnth
@@ -553,25 +805,25 @@ static uint16_t sdp_client_setup_service_search_attribute_request(uint8_t * data
 
     // parameters: 
     //     Service_search_pattern - DES (min 1 UUID, max 12)
-    uint16_t service_search_pattern_len = de_get_len(sdp_client_service_search_pattern);
-    (void)memcpy(data + offset, sdp_client_service_search_pattern,
+    uint16_t service_search_pattern_len = de_get_len(context->service_search_pattern);
+    (void)memcpy(data + offset, context->service_search_pattern,
                  service_search_pattern_len);
     offset += service_search_pattern_len;
 
     //     MaximumAttributeByteCount - uint16_t  0x0007 - 0xffff -> mtu
-    big_endian_store_16(data, offset, sdp_client_mtu);
+    big_endian_store_16(data, offset, context->mtu);
     offset += 2;
 
     //     AttibuteIDList  
-    uint16_t attribute_id_list_len = de_get_len(sdp_client_attribute_id_list);
-    (void)memcpy(data + offset, sdp_client_attribute_id_list, attribute_id_list_len);
+    uint16_t attribute_id_list_len = de_get_len(context->attribute_id_list);
+    (void)memcpy(data + offset, context->attribute_id_list, attribute_id_list_len);
     offset += attribute_id_list_len;
 
     //     ContinuationState - uint8_t number of cont. bytes N<=16 
-    data[offset++] = sdp_client_continuation_state_len;
+    data[offset++] = context->continuation_state_len;
     //                       - N-bytes previous response from server
-    (void)memcpy(data + offset, sdp_client_continuation_state, sdp_client_continuation_state_len);
-    offset += sdp_client_continuation_state_len;
+    (void)memcpy(data + offset, context->continuation_state, context->continuation_state_len);
+    offset += context->continuation_state_len;
 
     // uint16_t paramLength 
     big_endian_store_16(data, 3, offset - 5);
@@ -584,13 +836,13 @@ void sdp_client_parse_service_record_handle_list(uint8_t* packet, uint16_t total
     sdp_parser_handle_service_search(packet, total_count, current_count);
 }
 
-static uint16_t sdp_client_setup_service_search_request(uint8_t * data){
+static uint16_t sdp_client_setup_service_search_request(sdp_client_context_t * context, uint8_t * data){
     uint16_t offset = 0;
-    sdp_client_transaction_id++;
+    context->transaction_id++;
     // uint8_t SDP_PDU_ID_t.SDP_ServiceSearchRequest;
     data[offset++] = SDP_ServiceSearchRequest;
     // uint16_t transactionID
-    big_endian_store_16(data, offset, sdp_client_transaction_id);
+    big_endian_store_16(data, offset, context->transaction_id);
     offset += 2;
 
     // param legnth
@@ -598,20 +850,20 @@ static uint16_t sdp_client_setup_service_search_request(uint8_t * data){
 
     // parameters: 
     //     Service_search_pattern - DES (min 1 UUID, max 12)
-    uint16_t service_search_pattern_len = de_get_len(sdp_client_service_search_pattern);
-    (void)memcpy(data + offset, sdp_client_service_search_pattern,
+    uint16_t service_search_pattern_len = de_get_len(context->service_search_pattern);
+    (void)memcpy(data + offset, context->service_search_pattern,
                  service_search_pattern_len);
     offset += service_search_pattern_len;
 
     //     MaximumAttributeByteCount - uint16_t  0x0007 - 0xffff -> mtu
-    big_endian_store_16(data, offset, sdp_client_mtu);
+    big_endian_store_16(data, offset, context->mtu);
     offset += 2;
 
     //     ContinuationState - uint8_t number of cont. bytes N<=16 
-    data[offset++] = sdp_client_continuation_state_len;
+    data[offset++] = context->continuation_state_len;
     //                       - N-bytes previous response from server
-    (void)memcpy(data + offset, sdp_client_continuation_state, sdp_client_continuation_state_len);
-    offset += sdp_client_continuation_state_len;
+    (void)memcpy(data + offset, context->continuation_state, context->continuation_state_len);
+    offset += context->continuation_state_len;
 
     // uint16_t paramLength 
     big_endian_store_16(data, 3, offset - 5);
@@ -620,14 +872,14 @@ static uint16_t sdp_client_setup_service_search_request(uint8_t * data){
 }
 
 
-static uint16_t sdp_client_setup_service_attribute_request(uint8_t * data){
+static uint16_t sdp_client_setup_service_attribute_request(sdp_client_context_t * context, uint8_t * data){
 
     uint16_t offset = 0;
-    sdp_client_transaction_id++;
+    context->transaction_id++;
     // uint8_t SDP_PDU_ID_t.SDP_ServiceSearchRequest;
     data[offset++] = SDP_ServiceAttributeRequest;
     // uint16_t transactionID
-    big_endian_store_16(data, offset, sdp_client_transaction_id);
+    big_endian_store_16(data, offset, context->transaction_id);
     offset += 2;
 
     // param legnth
@@ -635,23 +887,23 @@ static uint16_t sdp_client_setup_service_attribute_request(uint8_t * data){
 
     // parameters: 
     //     ServiceRecordHandle
-    big_endian_store_32(data, offset, sdp_client_service_record_handle);
+    big_endian_store_32(data, offset, context->service_record_handle);
     offset += 4;
 
     //     MaximumAttributeByteCount - uint16_t  0x0007 - 0xffff -> mtu
-    big_endian_store_16(data, offset, sdp_client_mtu);
+    big_endian_store_16(data, offset, context->mtu);
     offset += 2;
 
     //     AttibuteIDList  
-    uint16_t attribute_id_list_len = de_get_len(sdp_client_attribute_id_list);
-    (void)memcpy(data + offset, sdp_client_attribute_id_list, attribute_id_list_len);
+    uint16_t attribute_id_list_len = de_get_len(context->attribute_id_list);
+    (void)memcpy(data + offset, context->attribute_id_list, attribute_id_list_len);
     offset += attribute_id_list_len;
 
     //     sdp_client_continuation_state - uint8_t number of cont. bytes N<=16
-    data[offset++] = sdp_client_continuation_state_len;
+    data[offset++] = context->continuation_state_len;
     //                       - N-bytes previous response from server
-    (void)memcpy(data + offset, sdp_client_continuation_state, sdp_client_continuation_state_len);
-    offset += sdp_client_continuation_state_len;
+    (void)memcpy(data + offset, context->continuation_state, context->continuation_state_len);
+    offset += context->continuation_state_len;
 
     // uint16_t paramLength 
     big_endian_store_16(data, 3, offset - 5);
@@ -659,7 +911,7 @@ static uint16_t sdp_client_setup_service_attribute_request(uint8_t * data){
     return offset;
 }
 
-static void sdp_client_parse_service_search_response(uint8_t* packet, uint16_t size){
+static void sdp_client_parse_service_search_response(sdp_client_context_t * context, uint8_t* packet, uint16_t size){
 
     uint16_t offset = 3;
     if (offset + 2 + 2 + 2 > size) return;  // parameterLength, totalServiceRecordCount, currentServiceRecordCount
@@ -683,19 +935,19 @@ static void sdp_client_parse_service_search_response(uint8_t* packet, uint16_t s
     offset+= currentServiceRecordCount * 4;
 
     if (offset + 1 > size) return;
-    sdp_client_continuation_state_len = packet[offset];
+    context->continuation_state_len = packet[offset];
     offset++;
-    if (sdp_client_continuation_state_len > 16){
-        sdp_client_continuation_state_len = 0;
+    if (context->continuation_state_len > 16){
+        context->continuation_state_len = 0;
         log_error("Error parsing ServiceSearchResponse: Number of bytes in continuation state exceedes 16.");
         return;
     }
-    if (offset + sdp_client_continuation_state_len > size) return;
-    (void)memcpy(sdp_client_continuation_state, packet + offset, sdp_client_continuation_state_len);
-    // offset+=sdp_client_continuation_state_len;
+    if (offset + context->continuation_state_len > size) return;
+    (void)memcpy(context->continuation_state, packet + offset, context->continuation_state_len);
+    // offset+=context->continuation_state_len;
 }
 
-static void sdp_client_parse_service_attribute_response(uint8_t* packet, uint16_t size){
+static void sdp_client_parse_service_attribute_response(sdp_client_context_t * context, uint8_t* packet, uint16_t size){
 
     uint16_t offset = 3;
     if (offset + 2 + 2 > size) return;  // parameterLength, attributeListByteCount
@@ -706,35 +958,49 @@ static void sdp_client_parse_service_attribute_response(uint8_t* packet, uint16_
     // AttributeListByteCount <= mtu
     uint16_t attributeListByteCount = big_endian_read_16(packet,offset);
     offset+=2;
-    if (attributeListByteCount > sdp_client_mtu){
+    if (attributeListByteCount > context->mtu){
         log_error("Error parsing ServiceSearchAttributeResponse: Number of bytes in found attribute list is larger then the MaximumAttributeByteCount.");
         return;
     }
 
     // AttributeLists
     if (offset+attributeListByteCount > size) return;
-    sdp_client_parse_attribute_lists(packet+offset, attributeListByteCount);
+    sdp_client_parse_attribute_lists(context, packet+offset, attributeListByteCount);
     offset+=attributeListByteCount;
 
-    // sdp_client_continuation_state_len
+    // context->continuation_state_len
     if (offset + 1 > size) return;
-    sdp_client_continuation_state_len = packet[offset];
+    context->continuation_state_len = packet[offset];
     offset++;
-    if (sdp_client_continuation_state_len > 16){
-        sdp_client_continuation_state_len = 0;
+    if (context->continuation_state_len > 16){
+        context->continuation_state_len = 0;
         log_error("Error parsing ServiceAttributeResponse: Number of bytes in continuation state exceedes 16.");
         return;
     }
-    if (offset + sdp_client_continuation_state_len > size) return;
-    (void)memcpy(sdp_client_continuation_state, packet + offset, sdp_client_continuation_state_len);
-    // offset+=sdp_client_continuation_state_len;
+    if (offset + context->continuation_state_len > size) return;
+    (void)memcpy(context->continuation_state, packet + offset, context->continuation_state_len);
+    // offset+=context->continuation_state_len;
 }
 #endif
 
 // Public API
 
+static sdp_client_context_t * sdp_client_get_free_context(void){
+    uint16_t i;
+    for (i = 0; i < MAX_NR_SDP_CLIENT_CONTEXTS; i++){
+        if (sdp_client_contexts[i].state == INIT) return &sdp_client_contexts[i];
+    }
+    return NULL;
+}
+
 bool sdp_client_ready(void){
-    return sdp_client_state == INIT;
+    return sdp_client_get_free_context() != NULL;
+}
+
+uint16_t sdp_client_next_query_id(void){
+    sdp_client_context_t * context = sdp_client_get_free_context();
+    btstack_assert(context != NULL);
+    return (uint16_t) (context - sdp_client_contexts);
 }
 
 uint8_t sdp_client_register_query_callback(btstack_context_callback_registration_t * callback_registration){
@@ -744,17 +1010,275 @@ uint8_t sdp_client_register_query_callback(btstack_context_callback_registration
     return ERROR_CODE_SUCCESS;
 }
 
-uint8_t sdp_client_query(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern, const uint8_t * des_attribute_id_list){
-    if (!sdp_client_ready()) return SDP_QUERY_BUSY;
+// allocates context, sets up parser and returns it as active parser
+static sdp_client_context_t * sdp_client_setup_context(btstack_packet_handler_t callback, bd_addr_t remote, sdp_pdu_id_t pdu_id){
+    sdp_client_context_t * context = sdp_client_get_free_context();
+    if (context == NULL) return NULL;
 
+    sdp_parser_active = &context->parser;
+    context->parser.query_id = (uint16_t) (context - sdp_client_contexts);
     sdp_parser_init(callback);
-    sdp_client_service_search_pattern = des_service_search_pattern;
-    sdp_client_attribute_id_list = des_attribute_id_list;
-    sdp_client_continuation_state_len = 0;
-    sdp_client_pdu_id = SDP_ServiceSearchAttributeResponse;
+    bd_addr_copy(context->remote_addr, remote);
+    context->continuation_state_len = 0;
+    context->pdu_id = pdu_id;
+    return context;
+}
+
+// starts query or waits for L2CAP channel if another query to the same remote is active
+static uint8_t sdp_client_start_query(sdp_client_context_t * context){
+    if (sdp_client_get_active_context_for_addr(context->remote_addr) != NULL){
+        log_info("SDP Client query %u waits for channel", context->parser.query_id);
+        context->state = W4_CHANNEL;
+        return ERROR_CODE_SUCCESS;
+    }
+    uint8_t status = sdp_client_connect(context);
+    if (status != ERROR_CODE_SUCCESS){
+        context->state = INIT;
+    }
+    return status;
+}
+
+#ifdef ENABLE_SDP_CLIENT_CACHE
+// SDP Client Cache
+
+static uint32_t sdp_client_cache_tag_for_index(uint8_t index){
+    return ('S' << 24u) | ('D' << 16u) | ('P' << 8u) | index;
+}
+
+static bool sdp_client_cache_remote_bonded(bd_addr_t addr){
+    link_key_t link_key;
+    link_key_type_t link_key_type;
+    return gap_get_link_key_for_bd_addr(addr, link_key, &link_key_type);
+}
+
+// key: service search pattern followed by attribute id list, returns 0 if it does not fit
+static uint8_t sdp_client_cache_setup_key(const sdp_client_context_t * context, uint8_t * key){
+    uint16_t service_search_pattern_len = de_get_len(context->service_search_pattern);
+    uint16_t attribute_id_list_len = de_get_len(context->attribute_id_list);
+    if ((service_search_pattern_len + attribute_id_list_len) > SDP_CLIENT_CACHE_MAX_KEY_SIZE) return 0;
+    (void)memcpy(key, context->service_search_pattern, service_search_pattern_len);
+    (void)memcpy(&key[service_search_pattern_len], context->attribute_id_list, attribute_id_list_len);
+    return (uint8_t) (service_search_pattern_len + attribute_id_list_len);
+}
+
+static int sdp_client_cache_find_entry(const bd_addr_t addr, const uint8_t * key, uint8_t key_len){
+    int index;
+    for (index = 0; index < NVM_NUM_SDP_CLIENT_CACHE_ENTRIES; index++){
+        const sdp_client_cache_entry_t * entry = &sdp_client_cache_entries[index];
+        if (entry->key_len != key_len) continue;
+        if (bd_addr_cmp(entry->addr, addr) != 0) continue;
+        if (memcmp(entry->key, key, key_len) != 0) continue;
+        return index;
+    }
+    return -1;
+}
+
+static void sdp_client_cache_delete_entry(uint8_t index){
+    sdp_client_cache_entries[index].key_len = 0;
+    sdp_client_cache_tlv_impl->delete_tag(sdp_client_cache_tlv_context, sdp_client_cache_tag_for_index(index));
+}
+
+// returns true if query is eligible for cache: TLV configured, key fits and remote bonded
+static bool sdp_client_cache_lookup(sdp_client_context_t * context, int * out_index){
+    *out_index = -1;
+    if (sdp_client_cache_tlv_impl == NULL) return false;
+    if (context->pdu_id != SDP_ServiceSearchAttributeResponse) return false;
+    uint8_t key[SDP_CLIENT_CACHE_MAX_KEY_SIZE];
+    uint8_t key_len = sdp_client_cache_setup_key(context, key);
+    if (key_len == 0) return false;
+    if (sdp_client_cache_remote_bonded(context->remote_addr) == false){
+        // unbonded, drop results
+        sdp_client_cache_remove(context->remote_addr);
+        return false;
+    }
+    *out_index = sdp_client_cache_find_entry(context->remote_addr, key, key_len);
+    return true;
+}
+
+static void sdp_client_cache_record_start(sdp_client_context_t * context){
+    if (sdp_client_cache_record_context != NULL) return;
+    sdp_client_cache_entry_t * entry = (sdp_client_cache_entry_t *) sdp_client_cache_record_buffer;
+    // entry is stored as is, don't leak data from previous entry via padding or unused key bytes
+    memset(entry, 0, sizeof(sdp_client_cache_entry_t));
+    bd_addr_copy(entry->addr, context->remote_addr);
+    entry->key_len = sdp_client_cache_setup_key(context, entry->key);
+    sdp_client_cache_record_context = context;
+    sdp_client_cache_record_len = 0;
+}
+
+static void sdp_client_cache_record_data(sdp_client_context_t * context, const uint8_t * data, uint16_t len){
+    if (sdp_client_cache_record_context != context) return;
+    if ((sdp_client_cache_record_len + len) > SDP_CLIENT_CACHE_MAX_RESULT_SIZE){
+        log_info("SDP Client Cache: result too large");
+        sdp_client_cache_record_context = NULL;
+        return;
+    }
+    (void)memcpy(&sdp_client_cache_record_buffer[sizeof(sdp_client_cache_entry_t) + sdp_client_cache_record_len], data, len);
+    sdp_client_cache_record_len += len;
+}
+
+static void sdp_client_cache_store(void){
+    sdp_client_cache_entry_t * entry = (sdp_client_cache_entry_t *) sdp_client_cache_record_buffer;
+    entry->result_len = sdp_client_cache_record_len;
+    entry->seq_nr = ++sdp_client_cache_highest_seq_nr;
+
+    // replace previous result, use free entry or oldest one
+    int index = sdp_client_cache_find_entry(entry->addr, entry->key, entry->key_len);
+    if (index < 0){
+        int i;
+        uint32_t lowest_seq_nr = 0xffffffffu;
+        for (i = 0; i < NVM_NUM_SDP_CLIENT_CACHE_ENTRIES; i++){
+            if (sdp_client_cache_entries[i].key_len == 0){
+                index = i;
+                break;
+            }
+            if (sdp_client_cache_entries[i].seq_nr < lowest_seq_nr){
+                lowest_seq_nr = sdp_client_cache_entries[i].seq_nr;
+                index = i;
+            }
+        }
+    }
+    log_info("SDP Client Cache: store %u bytes for %s in entry %u", entry->result_len, bd_addr_to_str(entry->addr), index);
+    int result = sdp_client_cache_tlv_impl->store_tag(sdp_client_cache_tlv_context, sdp_client_cache_tag_for_index((uint8_t) index),
+                                                      sdp_client_cache_record_buffer, (uint32_t) (sizeof(sdp_client_cache_entry_t) + sdp_client_cache_record_len));
+    if (result != 0){
+        sdp_client_cache_entries[index].key_len = 0;
+        return;
+    }
+    sdp_client_cache_entries[index] = *entry;
+}
+
+static void sdp_client_cache_handle_done(sdp_client_context_t * context, uint8_t status){
+    if (sdp_client_cache_tlv_impl == NULL) return;
+    if (status != ERROR_CODE_SUCCESS){
+        // query failed, remote might have changed
+        if (sdp_client_cache_record_context == context){
+            sdp_client_cache_record_context = NULL;
+        }
+        sdp_client_cache_remove(context->remote_addr);
+        return;
+    }
+    if (sdp_client_cache_record_context != context) return;
+    sdp_client_cache_record_context = NULL;
+    sdp_client_cache_store();
+}
+
+// returns length of result or zero if entry is not valid anymore
+static uint16_t sdp_client_cache_read_result(uint8_t index){
+    const sdp_client_cache_entry_t * entry = &sdp_client_cache_entries[index];
+    if (entry->key_len == 0) return 0;
+    uint32_t expected_len = sizeof(sdp_client_cache_entry_t) + entry->result_len;
+    int len = sdp_client_cache_tlv_impl->get_tag(sdp_client_cache_tlv_context, sdp_client_cache_tag_for_index(index),
+                                                 sdp_client_cache_result_buffer, sizeof(sdp_client_cache_result_buffer));
+    if ((uint32_t) len != expected_len) return 0;
+    return entry->result_len;
+}
+
+static void sdp_client_cache_handle_timer(btstack_timer_source_t * timer){
+    sdp_client_context_t * context = (sdp_client_context_t *) btstack_run_loop_get_timer_context(timer);
+    uint16_t result_len = sdp_client_cache_read_result(context->cache_index);
+    if (result_len == 0){
+        // entry removed in the meantime
+        sdp_client_cache_record_start(context);
+        uint8_t status = sdp_client_start_query(context);
+        if (status != ERROR_CODE_SUCCESS){
+            sdp_client_handle_done(context, status);
+        }
+        return;
+    }
+    log_info("SDP Client Cache: query %u answered from entry %u", context->parser.query_id, context->cache_index);
+    sdp_parser_active = &context->parser;
+    sdp_parser_handle_chunk(&sdp_client_cache_result_buffer[sizeof(sdp_client_cache_entry_t)], result_len);
+    sdp_client_handle_done(context, ERROR_CODE_SUCCESS);
+}
+
+// answers query from cache or starts it while recording the result
+static uint8_t sdp_client_cache_start_query(sdp_client_context_t * context){
+    int index;
+    if (sdp_client_cache_lookup(context, &index) == false){
+        return sdp_client_start_query(context);
+    }
+    if (index < 0){
+        sdp_client_cache_misses++;
+        sdp_client_cache_record_start(context);
+        return sdp_client_start_query(context);
+    }
+    sdp_client_cache_hits++;
+    // deliver result from run loop like the result of a remote query
+    context->state = W2_DELIVER_CACHED_RESULT;
+    context->cache_index = (uint8_t) index;
+    btstack_run_loop_set_timer_handler(&context->cache_timer, &sdp_client_cache_handle_timer);
+    btstack_run_loop_set_timer_context(&context->cache_timer, context);
+    btstack_run_loop_set_timer(&context->cache_timer, 0);
+    btstack_run_loop_add_timer(&context->cache_timer);
+    return ERROR_CODE_SUCCESS;
+}
+
+void sdp_client_cache_configure(const btstack_tlv_t * tlv_impl, void * tlv_context){
+    sdp_client_cache_tlv_impl = tlv_impl;
+    sdp_client_cache_tlv_context = tlv_context;
+    sdp_client_cache_highest_seq_nr = 0;
+    sdp_client_cache_record_context = NULL;
+    if (tlv_impl == NULL) return;
+
+    // load entries, results are read on use
+    int index;
+    for (index = 0; index < NVM_NUM_SDP_CLIENT_CACHE_ENTRIES; index++){
+        sdp_client_cache_entry_t * entry = &sdp_client_cache_entries[index];
+        int len = tlv_impl->get_tag(tlv_context, sdp_client_cache_tag_for_index((uint8_t) index), (uint8_t *) entry, sizeof(sdp_client_cache_entry_t));
+        if ((len != sizeof(sdp_client_cache_entry_t)) || (entry->key_len == 0) || (entry->key_len > SDP_CLIENT_CACHE_MAX_KEY_SIZE) ||
+            (entry->result_len > SDP_CLIENT_CACHE_MAX_RESULT_SIZE)){
+            entry->key_len = 0;
+            continue;
+        }
+        sdp_client_cache_highest_seq_nr = btstack_max(sdp_client_cache_highest_seq_nr, entry->seq_nr);
+    }
+}
+
+void sdp_client_cache_remove(bd_addr_t addr){
+    if (sdp_client_cache_tlv_impl == NULL) return;
+    // don't store result of running query
+    if ((sdp_client_cache_record_context != NULL) && (bd_addr_cmp(sdp_client_cache_record_context->remote_addr, addr) == 0)){
+        sdp_client_cache_record_context = NULL;
+    }
+    uint8_t index;
+    for (index = 0; index < NVM_NUM_SDP_CLIENT_CACHE_ENTRIES; index++){
+        if (sdp_client_cache_entries[index].key_len == 0) continue;
+        if (bd_addr_cmp(sdp_client_cache_entries[index].addr, addr) != 0) continue;
+        log_info("SDP Client Cache: remove entry %u for %s", index, bd_addr_to_str(addr));
+        sdp_client_cache_delete_entry(index);
+    }
+}
+
+void sdp_client_cache_get_statistics(uint32_t * hits, uint32_t * misses){
+    *hits = sdp_client_cache_hits;
+    *misses = sdp_client_cache_misses;
+}
+#endif
+
+static uint8_t sdp_client_query_internal(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern,
+                                         const uint8_t * des_attribute_id_list, bool attribute_value_chunks){
+    sdp_client_context_t * context = sdp_client_setup_context(callback, remote, SDP_ServiceSearchAttributeResponse);
+    if (context == NULL) return SDP_QUERY_BUSY;
+
+    if (attribute_value_chunks){
+        sdp_parser_enable_attribute_value_chunks();
+    }
+    context->service_search_pattern = des_service_search_pattern;
+    context->attribute_id_list = des_attribute_id_list;
+#ifdef ENABLE_SDP_CLIENT_CACHE
+    return sdp_client_cache_start_query(context);
+#else
+    return sdp_client_start_query(context);
+#endif
+}
 
-    sdp_client_state = W4_CONNECT;
-    return l2cap_create_channel(sdp_client_packet_handler, remote, BLUETOOTH_PSM_SDP, l2cap_max_mtu(), NULL);
+uint8_t sdp_client_query(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern, const uint8_t * des_attribute_id_list){
+    return sdp_client_query_internal(callback, remote, des_service_search_pattern, des_attribute_id_list, false);
+}
+
+uint8_t sdp_client_query_chunked(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern, const uint8_t * des_attribute_id_list){
+    return sdp_client_query_internal(callback, remote, des_service_search_pattern, des_attribute_id_list, true);
 }
 
 uint8_t sdp_client_query_uuid16(btstack_packet_handler_t callback, bd_addr_t remote, uint16_t uuid){
@@ -762,6 +1286,11 @@ uint8_t sdp_client_query_uuid16(btstack_packet_handler_t callback, bd_addr_t rem
     return sdp_client_query(callback, remote, sdp_service_search_pattern_for_uuid16(uuid), sdp_client_des_attribute_id_list);
 }
 
+uint8_t sdp_client_query_uuid16_chunked(btstack_packet_handler_t callback, bd_addr_t remote, uint16_t uuid){
+    if (!sdp_client_ready()) return SDP_QUERY_BUSY;
+    return sdp_client_query_chunked(callback, remote, sdp_service_search_pattern_for_uuid16(uuid), sdp_client_des_attribute_id_list);
+}
+
 uint8_t sdp_client_query_uuid128(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t* uuid){
     if (!sdp_client_ready()) return SDP_QUERY_BUSY;
     return sdp_client_query(callback, remote, sdp_service_search_pattern_for_uuid128(uuid), sdp_client_des_attribute_id_list);
@@ -769,30 +1298,21 @@ uint8_t sdp_client_query_uuid128(btstack_packet_handler_t callback, bd_addr_t re
 
 #ifdef ENABLE_SDP_EXTRA_QUERIES
 uint8_t sdp_client_service_attribute_search(btstack_packet_handler_t callback, bd_addr_t remote, uint32_t search_service_record_handle, const uint8_t * des_attribute_id_list){
-    if (!sdp_client_ready()) return SDP_QUERY_BUSY;
+    sdp_client_context_t * context = sdp_client_setup_context(callback, remote, SDP_ServiceAttributeResponse);
+    if (context == NULL) return SDP_QUERY_BUSY;
 
-    sdp_parser_init(callback);
-    sdp_client_service_record_handle = search_service_record_handle;
-    sdp_client_attribute_id_list = des_attribute_id_list;
-    sdp_client_continuation_state_len = 0;
-    sdp_client_pdu_id = SDP_ServiceAttributeResponse;
-
-    sdp_client_state = W4_CONNECT;
-    l2cap_create_channel(sdp_client_packet_handler, remote, BLUETOOTH_PSM_SDP, l2cap_max_mtu(), NULL);
+    context->service_record_handle = search_service_record_handle;
+    context->attribute_id_list = des_attribute_id_list;
+    (void) sdp_client_start_query(context);
     return 0;
 }
 
 uint8_t sdp_client_service_search(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern){
+    sdp_client_context_t * context = sdp_client_setup_context(callback, remote, SDP_ServiceSearchResponse);
+    if (context == NULL) return SDP_QUERY_BUSY;
 
-    if (!sdp_client_ready()) return SDP_QUERY_BUSY;
-
-    sdp_parser_init(callback);
-    sdp_client_service_search_pattern = des_service_search_pattern;
-    sdp_client_continuation_state_len = 0;
-    sdp_client_pdu_id = SDP_ServiceSearchResponse;
-
-    sdp_client_state = W4_CONNECT;
-    l2cap_create_channel(sdp_client_packet_handler, remote, BLUETOOTH_PSM_SDP, l2cap_max_mtu(), NULL);
+    context->service_search_pattern = des_service_search_pattern;
+    (void) sdp_client_start_query(context);
     return 0;
 }
 #endif
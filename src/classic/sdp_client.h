@@ -45,12 +45,18 @@
 
 #include "btstack_config.h"
 
+#include "btstack_tlv.h"
 #include "btstack_util.h"
 
 #if defined __cplusplus
 extern "C" {
 #endif
 
+// number of SDP queries that can run at the same time, queries to the same remote device share one L2CAP channel
+#ifndef MAX_NR_SDP_CLIENT_CONTEXTS
+#define MAX_NR_SDP_CLIENT_CONTEXTS 1
+#endif
+
 /* API_START */
 
 typedef struct de_state {
@@ -71,7 +77,7 @@ void sdp_client_init(void);
 /** 
  * @brief Checks if the SDP Client is ready
  * @deprecated Please use sdp_client_register_query_callback instead
- * @return true when no query is active
+ * @return true when another query can be started
  */
 bool sdp_client_ready(void);
 
@@ -85,6 +91,9 @@ uint8_t sdp_client_register_query_callback(btstack_context_callback_registration
 /** 
  * @brief Queries the SDP service of the remote device given a service search pattern and a list of attribute IDs. 
  * The remote data is handled by the SDP parser. The SDP parser delivers attribute values and done event via the callback.
+ * Up to MAX_NR_SDP_CLIENT_CONTEXTS queries run in parallel. Queries to the same remote device are executed one after
+ * the other over a shared L2CAP channel. The channel parameter of the events identifies the query.
+ * HFP, HID Host, AVDTP and GOEP Client keep their query state in globals and require MAX_NR_SDP_CLIENT_CONTEXTS = 1.
  * @param callback for attributes values and done event
  * @param remote address
  * @param des_service_search_pattern 
@@ -92,12 +101,29 @@ uint8_t sdp_client_register_query_callback(btstack_context_callback_registration
  */
 uint8_t sdp_client_query(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern, const uint8_t * des_attribute_id_list);
 
+/**
+ * @brief Queries the SDP service of the remote device given a service search pattern and a list of attribute IDs.
+ * Same as sdp_client_query, but attribute values are delivered as SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK events,
+ * each containing a contiguous part of the value, instead of one SDP_EVENT_QUERY_ATTRIBUTE_VALUE event per byte.
+ * @param callback for attributes value chunks and done event
+ * @param remote address
+ * @param des_service_search_pattern
+ * @param des_attribute_id_list
+ */
+uint8_t sdp_client_query_chunked(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern, const uint8_t * des_attribute_id_list);
+
 /*
  * @brief Searches SDP records on a remote device for all services with a given UUID.
  * @note calls sdp_client_query with service search pattern based on uuid16
  */
 uint8_t sdp_client_query_uuid16(btstack_packet_handler_t callback, bd_addr_t remote, uint16_t uuid16);
 
+/*
+ * @brief Searches SDP records on a remote device for all services with a given UUID.
+ * @note calls sdp_client_query_chunked with service search pattern based on uuid16
+ */
+uint8_t sdp_client_query_uuid16_chunked(btstack_packet_handler_t callback, bd_addr_t remote, uint16_t uuid16);
+
 /*
  * @brief Searches SDP records on a remote device for all services with a given UUID.
  * @note calls sdp_client_query with service search pattern based on uuid128
@@ -130,6 +156,31 @@ uint8_t sdp_client_service_search(btstack_packet_handler_t callback, bd_addr_t r
 void sdp_client_parse_service_record_handle_list(uint8_t* packet, uint16_t total_count, uint16_t current_count);
 #endif
 
+/**
+ * @brief Cache results of queries started with sdp_client_query or one of its variants for bonded devices in TLV.
+ * Later queries with the same service search pattern and attribute id list are answered from the cache.
+ * Results are removed when the device is not bonded anymore or a query to it fails. Requires ENABLE_SDP_CLIENT_CACHE
+ * @param tlv_impl or NULL to disable cache
+ * @param tlv_context
+ */
+void sdp_client_cache_configure(const btstack_tlv_t * tlv_impl, void * tlv_context);
+
+/**
+ * @brief Remove cached results for remote device, e.g. if a connection based on them failed.
+ * Called by HFP, HSP, A2DP and GOEP Client on failed connection setup and by gap_drop_link_key_for_bd_addr.
+ * Requires ENABLE_SDP_CLIENT_CACHE
+ * @param addr
+ */
+void sdp_client_cache_remove(bd_addr_t addr);
+
+/**
+ * @brief Get number of queries answered from cache and number of queries sent to remote that could have been cached.
+ * Requires ENABLE_SDP_CLIENT_CACHE
+ * @param hits
+ * @param misses
+ */
+void sdp_client_cache_get_statistics(uint32_t * hits, uint32_t * misses);
+
 /**
  * @brief De-Init SDP Client
  */
@@ -137,6 +188,13 @@ void sdp_client_deinit(void);
 
 /* API_END */
 
+/**
+ * @brief Get id of next query, reported as channel in the events of the query. Used by SDP Client RFCOMM
+ * @note only valid if sdp_client_ready()
+ * @return query id
+ */
+uint16_t sdp_client_next_query_id(void);
+
 #if defined __cplusplus
 }
 #endif
@@ -74,6 +74,10 @@
 #include "hci_dump.h"
 #include "ad_parser.h"
 
+#if defined(ENABLE_CLASSIC) && defined(ENABLE_SDP_CLIENT_CACHE)
+#include "classic/sdp_client.h"
+#endif
+
 #ifdef ENABLE_CONTROLLER_DUMP_PACKETS
 #include <stdio.h>  // sprintf
 #endif
@@ -238,6 +242,7 @@ static le_advertising_set_t * hci_advertising_set_for_handle(uint8_t advertising
 #endif /* ENABLE_LE_PERIPHERAL */
 #ifdef ENABLE_LE_ISOCHRONOUS_STREAMS
 static hci_iso_stream_t * hci_iso_stream_create(hci_iso_type_t iso_type, hci_iso_stream_state_t state, uint8_t group_id, uint8_t stream_id);
+static void hci_iso_stream_free(hci_iso_stream_t * iso_stream);
 static void hci_iso_stream_finalize(hci_iso_stream_t * iso_stream);
 static void hci_iso_stream_finalize_by_type_and_group_id(hci_iso_type_t iso_type, uint8_t group_id);
 static hci_iso_stream_t * hci_iso_stream_for_con_handle(hci_con_handle_t con_handle);
@@ -554,6 +559,10 @@ bool hci_authentication_active_for_handle(hci_con_handle_t handle){
 }
 
 void gap_drop_link_key_for_bd_addr(bd_addr_t addr){
+#ifdef ENABLE_SDP_CLIENT_CACHE
+    // cached SDP results are only valid while bonded
+    sdp_client_cache_remove(addr);
+#endif
     if (!hci_stack->link_key_db) return;
     log_info("gap_drop_link_key_for_bd_addr: %s", bd_addr_to_str(addr));
     hci_stack->link_key_db->delete_link_key(addr);
@@ -740,9 +749,78 @@ static int hci_can_send_comand_packet_transport(void){
     return 1;
 }
 
+// HCI Command flow control
+// - Num_HCI_Command_Packets in Command Complete/Status reports how many commands the Controller can accept
+// - commands sent after the event was generated are not accounted for, so the number of commands in flight is
+//   additionally limited by the largest credit seen so far (window), capped by MAX_NR_CONTROLLER_HCI_COMMANDS
+// - NOP and Command Complete/Status for a command that is not outstanding indicate that a completion was lost,
+//   outstanding commands are dropped and the credits reported by the Controller are used as is
+static void hci_command_credits_reset(void){
+    hci_stack->num_cmd_packets = 1; // assume that one cmd can be sent
+    hci_stack->num_cmd_packets_window = 1;
+    hci_stack->num_cmd_packets_outstanding = 0;
+}
+
+static void hci_command_outstanding_add(uint16_t opcode){
+    if (hci_stack->num_cmd_packets_outstanding >= MAX_NR_CONTROLLER_HCI_COMMANDS){
+        log_debug("Outstanding command queue full, opcode %04x not tracked", opcode);
+        return;
+    }
+    hci_stack->cmd_outstanding_opcodes[hci_stack->num_cmd_packets_outstanding++] = opcode;
+}
+
+static bool hci_command_outstanding_remove(uint16_t opcode){
+    uint8_t i;
+    for (i = 0; i < hci_stack->num_cmd_packets_outstanding; i++){
+        if (hci_stack->cmd_outstanding_opcodes[i] != opcode) continue;
+        hci_stack->num_cmd_packets_outstanding--;
+        for (; i < hci_stack->num_cmd_packets_outstanding; i++){
+            hci_stack->cmd_outstanding_opcodes[i] = hci_stack->cmd_outstanding_opcodes[i+1u];
+        }
+        return true;
+    }
+    return false;
+}
+
+static void hci_command_credits_update(uint16_t opcode, uint8_t num_hci_command_packets){
+    // NOP (opcode 0x0000) or unmatched completion: resync with Controller
+    bool matched = false;
+    if (opcode != 0u){
+        matched = hci_command_outstanding_remove(opcode);
+    }
+    if (!matched && (hci_stack->num_cmd_packets_outstanding > 0u)){
+        log_info("Opcode %04x not outstanding, drop %u outstanding commands", opcode, hci_stack->num_cmd_packets_outstanding);
+        hci_stack->num_cmd_packets_outstanding = 0;
+    }
+    uint8_t credits = (uint8_t) btstack_min(num_hci_command_packets, MAX_NR_CONTROLLER_HCI_COMMANDS);
+    if (credits > hci_stack->num_cmd_packets_window){
+        hci_stack->num_cmd_packets_window = credits;
+    }
+    uint8_t window_free = 0;
+    if (hci_stack->num_cmd_packets_window > hci_stack->num_cmd_packets_outstanding){
+        window_free = hci_stack->num_cmd_packets_window - hci_stack->num_cmd_packets_outstanding;
+    }
+    hci_stack->num_cmd_packets = (uint8_t) btstack_min(credits, window_free);
+}
+
+// HCI Reset and vendor-specific commands are not pipelined, as the latter might not complete with Command Complete/Status
+static bool hci_command_requires_serialization(uint16_t opcode){
+    if (opcode == HCI_OPCODE_HCI_RESET) return true;
+    return (opcode >> 10) == OGF_VENDOR;
+}
+
+static bool hci_command_pipelining_blocked(void){
+    if (hci_stack->num_cmd_packets_outstanding == 0u) return false;
+    // initialization, halting and sleep mode state machines wait for each command to complete
+    if (hci_stack->state != HCI_STATE_WORKING) return true;
+    uint16_t last_opcode = hci_stack->cmd_outstanding_opcodes[hci_stack->num_cmd_packets_outstanding - 1u];
+    return hci_command_requires_serialization(last_opcode);
+}
+
 // new functions replacing hci_can_send_packet_now[_using_packet_buffer]
 bool hci_can_send_command_packet_now(void){
     if (hci_can_send_comand_packet_transport() == 0) return false;
+    if (hci_command_pipelining_blocked()) return false;
     return hci_stack->num_cmd_packets > 0u;
 }
 
@@ -1131,6 +1209,86 @@ static uint8_t hci_send_iso_packet_fragments(void){
     return status;
 }
 
+// number of HCI ISO Data packets needed for ISO packet of given size incl. HCI header
+static uint8_t hci_iso_num_fragments(uint16_t size){
+    uint16_t max_iso_data_packet_length = hci_stack->le_iso_packets_length;
+    if ((size <= 4u) || (max_iso_data_packet_length == 0u)) return 1;
+    return (uint8_t) btstack_max(1u, (size - 4u + max_iso_data_packet_length - 1u) / max_iso_data_packet_length);
+}
+
+static bool hci_iso_controller_buffer_available(uint8_t num_fragments){
+    // no limit if Controller did not report ISO buffers
+    if (hci_stack->le_iso_packets_total_num == 0u) return true;
+    unsigned int num_packets_sent = 0;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->iso_streams);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        hci_iso_stream_t * iso_stream = (hci_iso_stream_t *) btstack_linked_list_iterator_next(&it);
+        num_packets_sent += iso_stream->num_packets_sent;
+    }
+    log_debug("ISO buffers: %u used of %u", num_packets_sent, hci_stack->le_iso_packets_total_num);
+    // allow SDU that needs more fragments than the Controller has buffers if all are free
+    if (num_packets_sent == 0u) return true;
+    return (num_packets_sent + num_fragments) <= hci_stack->le_iso_packets_total_num;
+}
+
+// SDUs sent or queued but not completed yet, reduced by SDUs that will be skipped
+static uint8_t hci_iso_stream_num_sdus_outstanding(const hci_iso_stream_t * iso_stream){
+    uint8_t num_fragments_per_sdu = btstack_max(1u, iso_stream->num_fragments_per_sdu);
+    uint16_t num_sdus_sent = (iso_stream->num_packets_sent + num_fragments_per_sdu - 1u) / num_fragments_per_sdu;
+    uint16_t num_sdus_outstanding = num_sdus_sent + iso_stream->tx_queue_count;
+    if (num_sdus_outstanding <= iso_stream->num_packets_to_skip) return 0;
+    return (uint8_t) (num_sdus_outstanding - iso_stream->num_packets_to_skip);
+}
+
+static void hci_iso_stream_tx_dequeue(hci_iso_stream_t * iso_stream){
+    btstack_assert(iso_stream->tx_queue_count > 0u);
+    btstack_linked_item_t * entry = btstack_linked_list_pop(&iso_stream->tx_queue);
+    btstack_linked_list_add(&hci_stack->iso_tx_pool_free, entry);
+    iso_stream->tx_queue_count--;
+}
+
+static void hci_iso_stream_tx_flush(hci_iso_stream_t * iso_stream){
+    while (iso_stream->tx_queue_count > 0u){
+        hci_iso_stream_tx_dequeue(iso_stream);
+    }
+}
+
+static void hci_iso_stream_tx_enqueue(hci_iso_stream_t * iso_stream, const uint8_t * packet, uint16_t size){
+    // queue is shared by all streams: if it's full, drop oldest SDU of this stream or the new one
+    if (btstack_linked_list_empty(&hci_stack->iso_tx_pool_free)){
+        iso_stream->num_sdus_dropped++;
+        if (iso_stream->tx_queue_count == 0u){
+            log_info("ISO tx queue full, drop SDU for con handle 0x%04x", iso_stream->cis_handle);
+            return;
+        }
+        log_info("ISO tx queue full, drop oldest SDU for con handle 0x%04x", iso_stream->cis_handle);
+        hci_iso_stream_tx_dequeue(iso_stream);
+    }
+    hci_iso_tx_packet_t * entry = (hci_iso_tx_packet_t *) btstack_linked_list_pop(&hci_stack->iso_tx_pool_free);
+    entry->sequence_nr = hci_stack->iso_tx_sequence_nr++;
+    entry->enqueued_ms = btstack_run_loop_get_time_ms();
+    entry->size = size;
+    (void)memcpy(entry->packet, packet, size);
+    btstack_linked_list_add_tail(&iso_stream->tx_queue, (btstack_linked_item_t *) entry);
+    iso_stream->tx_queue_count++;
+}
+
+// pre: packet buffer contains ISO packet for iso_stream
+static uint8_t hci_send_iso_packet_to_controller(hci_iso_stream_t * iso_stream, uint16_t size){
+    // track outgoing packet sent
+    log_debug("Outgoing ISO packet for con handle 0x%04x", iso_stream->cis_handle);
+    // each HCI ISO Data packet uses one Controller buffer
+    iso_stream->num_fragments_per_sdu = hci_iso_num_fragments(size);
+    iso_stream->num_packets_sent += iso_stream->num_fragments_per_sdu;
+
+    // setup data
+    hci_stack->iso_fragmentation_total_size = size;
+    hci_stack->iso_fragmentation_pos = 4;   // start of L2CAP packet
+
+    return hci_send_iso_packet_fragments();
+}
+
 uint8_t hci_send_iso_packet_buffer(uint16_t size){
     btstack_assert(hci_stack->hci_packet_buffer_reserved);
 
@@ -1142,26 +1300,31 @@ uint8_t hci_send_iso_packet_buffer(uint16_t size){
         return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
     }
 
-    // TODO: check for space on controller
-
     // skip iso packets if needed
     if (iso_stream->num_packets_to_skip > 0){
         iso_stream->num_packets_to_skip--;
+        iso_stream->num_sdus_late++;
         // pretend it was processed and trigger next one
         hci_release_packet_buffer();
         hci_iso_notify_can_send_now();
         return ERROR_CODE_SUCCESS;
     }
 
-    // track outgoing packet sent
-    log_info("Outgoing ISO packet for con handle 0x%04x", con_handle);
-    iso_stream->num_packets_sent++;
-
-    // setup data
-    hci_stack->iso_fragmentation_total_size = size;
-    hci_stack->iso_fragmentation_pos = 4;   // start of L2CAP packet
+    // send directly if Controller has room and no older SDUs are waiting for this stream
+    if ((iso_stream->tx_queue_count == 0u) && hci_iso_controller_buffer_available(hci_iso_num_fragments(size))){
+        return hci_send_iso_packet_to_controller(iso_stream, size);
+    }
 
-    return hci_send_iso_packet_fragments();
+    // otherwise, store SDU in stream queue and free packet buffer for other streams
+    if (size > sizeof(hci_stack->iso_tx_pool[0].packet)){
+        hci_release_packet_buffer();
+        hci_iso_notify_can_send_now();
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+    hci_iso_stream_tx_enqueue(iso_stream, hci_stack->hci_packet_buffer, size);
+    hci_release_packet_buffer();
+    hci_iso_notify_can_send_now();
+    return ERROR_CODE_SUCCESS;
 }
 #endif
 
@@ -1406,6 +1569,10 @@ uint16_t hci_max_acl_data_packet_length(void){
     return hci_stack->acl_data_packet_length;
 }
 
+uint8_t hci_max_acl_data_packets(void){
+    return hci_stack->acl_packets_total_num;
+}
+
 #ifdef ENABLE_CLASSIC
 bool hci_extended_sco_link_supported(void){
     // No. 31, byte 3, bit 7
@@ -1752,7 +1919,7 @@ static void hci_initialization_timeout_handler(btstack_timer_source_t * ds){
         case HCI_INIT_W4_SEND_RESET:
             log_info("Resend HCI Reset");
             hci_stack->substate = HCI_INIT_SEND_RESET;
-            hci_stack->num_cmd_packets = 1;
+            hci_command_credits_reset();
             hci_run();
             break;
         case HCI_INIT_W4_CUSTOM_INIT_CSR_WARM_BOOT_LINK_RESET:
@@ -1766,7 +1933,7 @@ static void hci_initialization_timeout_handler(btstack_timer_source_t * ds){
         case HCI_INIT_W4_CUSTOM_INIT_CSR_WARM_BOOT:
             log_info("Resend HCI Reset - CSR Warm Boot");
             hci_stack->substate = HCI_INIT_SEND_RESET_CSR_WARM_BOOT;
-            hci_stack->num_cmd_packets = 1;
+            hci_command_credits_reset();
             hci_run();
             break;
         case HCI_INIT_W4_SEND_BAUD_CHANGE:
@@ -2309,7 +2476,7 @@ static bool hci_initializing_event_handler_command_completed(const uint8_t * pac
         // TODO: track actual command
         command_completed = true;
         // Fix: no HCI Command Complete received, so num_cmd_packets not reset
-        hci_stack->num_cmd_packets = 1;
+        hci_command_credits_reset();
     }
 #endif
 
@@ -2683,10 +2850,10 @@ static void handle_command_complete_event(uint8_t * packet, uint16_t size){
     le_audio_cig_t * cig;
 #endif
 
-    // get num cmd packets - limit to 1 to reduce complexity
-    hci_stack->num_cmd_packets = packet[2] ? 1 : 0;
-
     uint16_t opcode = hci_event_command_complete_get_command_opcode(packet);
+
+    // update command credits and outstanding commands
+    hci_command_credits_update(opcode, hci_event_command_complete_get_num_hci_command_packets(packet));
     switch (opcode){
         case HCI_OPCODE_HCI_READ_LOCAL_NAME:
             if (packet[5]) break;
@@ -3010,7 +3177,6 @@ static void handle_command_complete_event(uint8_t * packet, uint16_t size){
                     status = packet[OFFSET_OF_DATA_IN_COMMAND_COMPLETE];
                     while (btstack_linked_list_iterator_has_next(&it)){
                         hci_iso_stream_t * iso_stream = (hci_iso_stream_t *) btstack_linked_list_iterator_next(&it);
-                        handle = iso_stream->cis_handle;
                         bool emit_cis_created = false;
                         switch (iso_stream->state){
                             case HCI_ISO_STREAM_STATE_W4_ISO_SETUP_INPUT:
@@ -3091,12 +3257,12 @@ static void handle_command_complete_event(uint8_t * packet, uint16_t size){
 static void handle_command_status_event(uint8_t * packet, uint16_t size) {
     UNUSED(size);
 
-    // get num cmd packets - limit to 1 to reduce complexity
-    hci_stack->num_cmd_packets = packet[3] ? 1 : 0;
-
     // get opcode and command status
     uint16_t opcode = hci_event_command_status_get_command_opcode(packet);
 
+    // update command credits and outstanding commands
+    hci_command_credits_update(opcode, hci_event_command_status_get_num_hci_command_packets(packet));
+
 #if defined(ENABLE_CLASSIC) || defined(ENABLE_LE_CENTRAL) || defined(ENABLE_LE_ISOCHRONOUS_STREAMS)
     uint8_t status = hci_event_command_status_get_status(packet);
 #endif
@@ -3472,8 +3638,8 @@ static void event_handler(uint8_t *packet, uint16_t size){
                                 big->num_completed_timestamp_current_ms = btstack_run_loop_get_time_ms();
                             }
                         }
-                        log_info("hci_number_completed_packet %u processed for handle %u, outstanding %u",
-                                 num_packets, handle, iso_stream->num_packets_sent);
+                        log_debug("hci_number_completed_packet %u processed for handle %u, outstanding %u",
+                                  num_packets, handle, iso_stream->num_packets_sent);
                         notify_iso = true;
                     }
                 }
@@ -4109,6 +4275,17 @@ static void event_handler(uint8_t *packet, uint16_t size){
                 case HCI_SUBEVENT_LE_ENHANCED_CONNECTION_COMPLETE_V2:
 					event_handle_le_connection_complete(packet);
                     break;
+#if defined(ENABLE_LE_PERIPHERAL) && defined(ENABLE_LE_EXTENDED_ADVERTISING)
+                case HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED:
+                    {
+                        // Controller stopped advertising set on connection, timeout, or max number of events
+                        le_advertising_set_t * advertising_set = hci_advertising_set_for_handle(hci_subevent_le_advertising_set_terminated_get_advertising_handle(packet));
+                        if (advertising_set != NULL){
+                            advertising_set->state &= ~(LE_ADVERTISEMENT_STATE_ACTIVE | LE_ADVERTISEMENT_STATE_ENABLED);
+                        }
+                    }
+                    break;
+#endif
 
                 // log_info("LE buffer size: %u, count %u", little_endian_read_16(packet,6), packet[8]);
                 case HCI_SUBEVENT_LE_CONNECTION_UPDATE_COMPLETE:
@@ -4174,6 +4351,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
                         // track SDU
                         iso_stream->max_sdu_c_to_p = hci_subevent_le_cis_established_get_max_pdu_c_to_p(packet);
                         iso_stream->max_sdu_p_to_c = hci_subevent_le_cis_established_get_max_pdu_p_to_c(packet);
+                        iso_stream->iso_interval = hci_subevent_le_cis_established_get_iso_interval(packet);
                         if (hci_stack->iso_active_operation_group_id == HCI_ISO_GROUP_ID_SINGLE_CIS){
                             // CIS Accept by Peripheral
                             if (status == ERROR_CODE_SUCCESS){
@@ -4244,6 +4422,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
                                     if ((iso_stream->state == HCI_ISO_STREAM_STATE_REQUESTED ) &&
                                         (iso_stream->group_id == big->big_handle)){
                                         iso_stream->cis_handle = bis_handle;
+                                        iso_stream->iso_interval = little_endian_read_16(packet, 18);
                                         iso_stream->state = HCI_ISO_STREAM_STATE_ESTABLISHED;
                                         break;
                                     }
@@ -4277,7 +4456,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
                             if (iso_stream->group_id == big->big_handle){
                                 log_info("BIG Terminated, big_handle 0x%02x, con handle 0x%04x", iso_stream->group_id, iso_stream->cis_handle);
                                 btstack_linked_list_iterator_remove(&it);
-                                btstack_memory_hci_iso_stream_free(iso_stream);
+                                hci_iso_stream_free(iso_stream);
                             }
                         }
                         btstack_linked_list_remove(&hci_stack->le_audio_bigs, (btstack_linked_item_t *) big);
@@ -4340,7 +4519,7 @@ static void event_handler(uint8_t *packet, uint16_t size){
             // To avoid getting stuck as num_cmds_packets is zero, reset it to 1 for controllers with this behaviour
             switch (hci_stack->manufacturer){
                 case BLUETOOTH_COMPANY_ID_CAMBRIDGE_SILICON_RADIO:
-                    hci_stack->num_cmd_packets = 1;
+                    hci_command_credits_reset();
                     break;
                 default:
                     break;
@@ -4735,6 +4914,10 @@ void hci_init(const hci_transport_t *transport, const void *config){
 
 #ifdef ENABLE_LE_ISOCHRONOUS_STREAMS
     hci_stack->iso_packets_to_queue = 1;
+    uint8_t i;
+    for (i=0;i<MAX_NR_HCI_ISO_TX_QUEUED_PACKETS;i++){
+        btstack_linked_list_add(&hci_stack->iso_tx_pool_free, (btstack_linked_item_t *) &hci_stack->iso_tx_pool[i]);
+    }
 #endif
 
 #ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
@@ -5027,7 +5210,7 @@ static int hci_power_control_wake(void){
 
 static void hci_power_enter_initializing_state(void){
     // set up state machine
-    hci_stack->num_cmd_packets = 1; // assume that one cmd can be sent
+    hci_command_credits_reset();
     hci_stack->hci_packet_buffer_reserved = false;
     hci_stack->state = HCI_STATE_INITIALIZING;
 
@@ -7455,10 +7638,14 @@ uint8_t hci_send_cmd_packet(uint8_t *packet, int size){
     }
 
     hci_stack->num_cmd_packets--;
+    hci_command_outstanding_add(opcode);
 
     hci_dump_packet(HCI_COMMAND_DATA_PACKET, 0, packet, size);
     int err = hci_stack->hci_transport->send_packet(HCI_COMMAND_DATA_PACKET, packet, size);
     if (err != 0){
+        // command did not reach the Controller, no completion expected
+        (void) hci_command_outstanding_remove(opcode);
+        hci_stack->num_cmd_packets++;
         return ERROR_CODE_HARDWARE_FAILURE;
     }
     return ERROR_CODE_SUCCESS;
@@ -9592,10 +9779,16 @@ static hci_iso_stream_t * hci_iso_stream_for_con_handle(hci_con_handle_t con_han
     return NULL;
 }
 
+static void hci_iso_stream_free(hci_iso_stream_t * iso_stream){
+    // return queued SDUs to shared pool
+    hci_iso_stream_tx_flush(iso_stream);
+    btstack_memory_hci_iso_stream_free(iso_stream);
+}
+
 static void hci_iso_stream_finalize(hci_iso_stream_t * iso_stream){
     log_info("hci_iso_stream_finalize con_handle 0x%04x, group_id 0x%02x", iso_stream->cis_handle, iso_stream->group_id);
     btstack_linked_list_remove(&hci_stack->iso_streams, (btstack_linked_item_t*) iso_stream);
-    btstack_memory_hci_iso_stream_free(iso_stream);
+    hci_iso_stream_free(iso_stream);
 }
 
 static void hci_iso_stream_finalize_by_type_and_group_id(hci_iso_type_t iso_type, uint8_t group_id) {
@@ -9606,7 +9799,7 @@ static void hci_iso_stream_finalize_by_type_and_group_id(hci_iso_type_t iso_type
         if ((iso_stream->group_id == group_id) &&
             (iso_stream->iso_type == iso_type)){
             btstack_linked_list_iterator_remove(&it);
-            btstack_memory_hci_iso_stream_free(iso_stream);
+            hci_iso_stream_free(iso_stream);
         }
     }
 }
@@ -9619,7 +9812,7 @@ static void hci_iso_stream_requested_finalize(uint8_t group_id) {
         if ((iso_stream->state == HCI_ISO_STREAM_STATE_REQUESTED ) &&
             (iso_stream->group_id == group_id)){
             btstack_linked_list_iterator_remove(&it);
-            btstack_memory_hci_iso_stream_free(iso_stream);
+            hci_iso_stream_free(iso_stream);
         }
     }
 }
@@ -9860,6 +10053,16 @@ void hci_set_num_iso_packets_to_queue(uint8_t num_packets){
     hci_stack->iso_packets_to_queue = num_packets;
 }
 
+uint8_t hci_iso_stream_get_tx_statistics(hci_con_handle_t con_handle, uint32_t * num_sdus_late, uint32_t * num_sdus_dropped){
+    hci_iso_stream_t * iso_stream = hci_iso_stream_for_con_handle(con_handle);
+    if (iso_stream == NULL){
+        return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    }
+    *num_sdus_late    = iso_stream->num_sdus_late;
+    *num_sdus_dropped = iso_stream->num_sdus_dropped;
+    return ERROR_CODE_SUCCESS;
+}
+
 static le_audio_cig_t * hci_cig_for_id(uint8_t cig_id){
     btstack_linked_list_iterator_t it;
     btstack_linked_list_iterator_init(&it, &hci_stack->le_audio_cigs);
@@ -9872,8 +10075,82 @@ static le_audio_cig_t * hci_cig_for_id(uint8_t cig_id){
     return NULL;
 }
 
+static uint32_t hci_iso_stream_sdu_interval_us(const hci_iso_stream_t * iso_stream){
+    uint32_t sdu_interval_us = 0;
+    if (iso_stream->iso_type == HCI_ISO_TYPE_BIS){
+        le_audio_big_t * big = hci_big_for_handle(iso_stream->group_id);
+        if (big != NULL){
+            sdu_interval_us = big->params->sdu_interval_us;
+        }
+    } else {
+        // only known for CIS created by us as Central
+        le_audio_cig_t * cig = hci_cig_for_id(iso_stream->group_id);
+        if (cig != NULL){
+            sdu_interval_us = cig->params->sdu_interval_c_to_p;
+        }
+    }
+    // e.g. CIS accepted as Peripheral: fall back to ISO interval
+    if (sdu_interval_us == 0u){
+        sdu_interval_us = iso_stream->iso_interval * 1250u;
+    }
+    return sdu_interval_us;
+}
+
+static hci_iso_stream_t * hci_iso_tx_next_stream(void){
+    // find stream with oldest queued SDU
+    hci_iso_stream_t * next_stream = NULL;
+    uint32_t next_sequence_nr = 0;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->iso_streams);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        hci_iso_stream_t * iso_stream = (hci_iso_stream_t *) btstack_linked_list_iterator_next(&it);
+        if (iso_stream->tx_queue_count == 0u) continue;
+        uint32_t sequence_nr = ((hci_iso_tx_packet_t *) iso_stream->tx_queue)->sequence_nr;
+        if ((next_stream == NULL) || ((int32_t)(sequence_nr - next_sequence_nr) < 0)){
+            next_stream = iso_stream;
+            next_sequence_nr = sequence_nr;
+        }
+    }
+    return next_stream;
+}
+
+static void hci_iso_tx_run(void){
+    while (true){
+        if (hci_stack->hci_packet_buffer_reserved) return;
+
+        hci_iso_stream_t * iso_stream = hci_iso_tx_next_stream();
+        if (iso_stream == NULL) return;
+        hci_iso_tx_packet_t * entry = (hci_iso_tx_packet_t *) iso_stream->tx_queue;
+
+        // drop SDU if it could not be sent within one SDU interval
+        uint32_t sdu_interval_ms = (hci_iso_stream_sdu_interval_us(iso_stream) + 999u) / 1000u;
+        if (sdu_interval_ms > 0u){
+            int32_t queued_ms = btstack_time_delta(btstack_run_loop_get_time_ms(), entry->enqueued_ms);
+            if (queued_ms > (int32_t) sdu_interval_ms){
+                log_info("ISO SDU for con handle 0x%04x late by %d ms, drop", iso_stream->cis_handle,
+                         (int) (queued_ms - (int32_t) sdu_interval_ms));
+                iso_stream->num_sdus_late++;
+                hci_iso_stream_tx_dequeue(iso_stream);
+                continue;
+            }
+        }
+
+        if (!hci_iso_controller_buffer_available(hci_iso_num_fragments(entry->size))) return;
+        if (!hci_transport_can_send_prepared_packet_now(HCI_ISO_DATA_PACKET)) return;
+
+        hci_reserve_packet_buffer();
+        uint16_t size = entry->size;
+        (void)memcpy(hci_stack->hci_packet_buffer, entry->packet, size);
+        hci_iso_stream_tx_dequeue(iso_stream);
+        hci_send_iso_packet_to_controller(iso_stream, size);
+    }
+}
+
 static void hci_iso_notify_can_send_now(void){
 
+    // send queued SDUs first
+    hci_iso_tx_run();
+
     // BIG
 
     btstack_linked_list_iterator_t it;
@@ -9913,15 +10190,22 @@ static void hci_iso_notify_can_send_now(void){
                 if (iso_stream == NULL) continue;
                 // handle case where individual ISO packet was sent too late:
                 // for each additionally queued packet, a new one needs to get skipped
+                uint8_t num_sdus_outstanding = hci_iso_stream_num_sdus_outstanding(iso_stream);
                 if (i==0){
-                    num_iso_queued_minimum = iso_stream->num_packets_sent;
-                } else if (iso_stream->num_packets_sent > num_iso_queued_minimum){
-                    uint8_t num_packets_to_skip = iso_stream->num_packets_sent - num_iso_queued_minimum;
+                    num_iso_queued_minimum = num_sdus_outstanding;
+                } else if (num_sdus_outstanding > num_iso_queued_minimum){
+                    uint8_t num_packets_to_skip = num_sdus_outstanding - num_iso_queued_minimum;
+                    // drop queued SDUs first
+                    while ((num_packets_to_skip > 0u) && (iso_stream->tx_queue_count > 0u)){
+                        hci_iso_stream_tx_dequeue(iso_stream);
+                        iso_stream->num_sdus_late++;
+                        num_packets_to_skip--;
+                    }
+                    // Controller buffers are only released by Number of Completed Packets
                     iso_stream->num_packets_to_skip += num_packets_to_skip;
-                    iso_stream->num_packets_sent    -= num_packets_to_skip;
                 }
                 // check if we can send now
-                if  ((iso_stream->num_packets_sent >= hci_stack->iso_packets_to_queue) || (iso_stream->emit_ready_to_send)){
+                if  ((hci_iso_stream_num_sdus_outstanding(iso_stream) >= hci_stack->iso_packets_to_queue) || (iso_stream->emit_ready_to_send)){
                     can_send = false;
                     break;
                 }
@@ -9959,7 +10243,7 @@ static void hci_iso_notify_can_send_now(void){
     while (btstack_linked_list_iterator_has_next(&it)) {
         hci_iso_stream_t *iso_stream = (hci_iso_stream_t *) btstack_linked_list_iterator_next(&it);
         if ((iso_stream->can_send_now_requested) &&
-            (iso_stream->num_packets_sent < hci_stack->iso_packets_to_queue)){
+            (hci_iso_stream_num_sdus_outstanding(iso_stream) < hci_stack->iso_packets_to_queue)){
             iso_stream->can_send_now_requested = false;
             hci_emit_cis_can_send_now(iso_stream->cis_handle);
         }
@@ -10279,4 +10563,9 @@ void hci_simulate_working_fuzz(void){
     hci_init_done();
     hci_stack->num_cmd_packets = 255;
 }
+
+void hci_set_acl_buffers_fuzz(uint16_t acl_data_packet_length, uint8_t acl_packets_total_num){
+    hci_stack->acl_data_packet_length = btstack_min(acl_data_packet_length, HCI_ACL_PAYLOAD_SIZE);
+    hci_stack->acl_packets_total_num  = acl_packets_total_num;
+}
 #endif
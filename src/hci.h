@@ -89,6 +89,11 @@ extern "C" {
 #define HCI_ISO_PAYLOAD_SIZE 310
 #endif
 
+// max number of outgoing ISO SDUs queued while the Controller has no free ISO buffers, shared by all streams
+#ifndef MAX_NR_HCI_ISO_TX_QUEUED_PACKETS
+#define MAX_NR_HCI_ISO_TX_QUEUED_PACKETS 4
+#endif
+
 // Max HCI Command LE payload size:
 // 64 from LE Generate DHKey command
 // 32 from LE Encrypt command
@@ -176,6 +181,11 @@ extern "C" {
 // Code+Len=2, Pkts+Opcode=3; total=5
 #define OFFSET_OF_DATA_IN_COMMAND_COMPLETE 5
 
+// max number of outstanding HCI Commands. Default 1 sends next command only after Command Complete/Status
+#ifndef MAX_NR_CONTROLLER_HCI_COMMANDS
+#define MAX_NR_CONTROLLER_HCI_COMMANDS 1
+#endif
+
 // ACL Packet
 #define READ_ACL_CONNECTION_HANDLE( buffer ) ( little_endian_read_16(buffer,0) & 0x0fff)
 #define READ_SCO_CONNECTION_HANDLE( buffer ) ( little_endian_read_16(buffer,0) & 0x0fff)
@@ -470,6 +480,13 @@ typedef struct sm_connection {
 #define ATT_REQUEST_BUFFER_SIZE HCI_ACL_PAYLOAD_SIZE
 #endif
 
+// coalesced notifications are queued per connection
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+#ifndef ATT_SERVER_NOTIFICATION_COALESCING_BUFFER_SIZE
+#define ATT_SERVER_NOTIFICATION_COALESCING_BUFFER_SIZE ATT_REQUEST_BUFFER_SIZE
+#endif
+#endif
+
 typedef enum {
     ATT_SERVER_IDLE,
     ATT_SERVER_REQUEST_RECEIVED,
@@ -478,9 +495,27 @@ typedef enum {
     ATT_SERVER_RESPONSE_PENDING,
 } att_server_state_t;
 
+// state of a single ATT Bearer
 typedef struct {
     att_server_state_t      state;
 
+#if defined(ENABLE_GATT_OVER_CLASSIC) || defined(ENABLE_GATT_OVER_EATT)
+    uint16_t                l2cap_cid;
+#endif
+
+#ifdef ENABLE_GATT_OVER_EATT
+    // only set for Enhanced ATT bearer, responses are sent from here
+    uint8_t *               eatt_send_buffer;
+#endif
+
+    uint16_t                request_size;
+    uint8_t                 request_buffer[ATT_REQUEST_BUFFER_SIZE];
+} att_server_bearer_t;
+
+typedef struct {
+    // unenhanced ATT Bearer
+    att_server_bearer_t     bearer;
+
     uint8_t                 peer_addr_type;
     bd_addr_t               peer_address;
 
@@ -494,13 +529,14 @@ typedef struct {
     btstack_linked_list_t   notification_requests;
     btstack_linked_list_t   indication_requests;
 
-#ifdef ENABLE_GATT_OVER_CLASSIC
-    uint16_t                l2cap_cid;
-#endif
-
-    uint16_t                request_size;
-    uint8_t                 request_buffer[ATT_REQUEST_BUFFER_SIZE];
+    // client has set Multiple Handle Value Notifications bit in Client Supported Features
+    bool                    multiple_notifications_supported;
 
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+    // queued Handle Length Value tuples
+    uint16_t                coalesced_notifications_len;
+    uint8_t                 coalesced_notifications[ATT_SERVER_NOTIFICATION_COALESCING_BUFFER_SIZE];
+#endif
 } att_server_t;
 
 #endif
@@ -705,6 +741,17 @@ typedef enum{
     HCI_ISO_STREAM_STATE_W4_ISO_SETUP_OUTPUT,
 } hci_iso_stream_state_t;
 
+typedef struct {
+    // linked list - assert: first field
+    btstack_linked_item_t item;
+    // global enqueue order, used to schedule SDUs across streams
+    uint32_t sequence_nr;
+    // time of enqueue, used to detect SDUs that missed their SDU interval
+    uint32_t enqueued_ms;
+    uint16_t size;
+    uint8_t  packet[HCI_ISO_HEADER_SIZE + HCI_ISO_PAYLOAD_SIZE];
+} hci_iso_tx_packet_t;
+
 typedef struct {
     // linked list - assert: first field
     btstack_linked_item_t    item;
@@ -733,12 +780,26 @@ typedef struct {
     uint16_t reassembly_pos;
     uint8_t  reassembly_buffer[HCI_ISO_PAYLOAD_SIZE];
 
-    // number packets sent to controller
+    // number of HCI ISO Data packets sent to controller and not completed yet
     uint8_t num_packets_sent;
 
+    // number of HCI ISO Data packets used for last SDU
+    uint8_t num_fragments_per_sdu;
+
     // packets to skip due to queuing them to late before
     uint8_t num_packets_to_skip;
 
+    // outgoing SDUs waiting for free Controller ISO buffers, entries taken from hci_stack->iso_tx_pool
+    btstack_linked_list_t tx_queue;
+    uint8_t tx_queue_count;
+
+    // ISO interval in 1.25 ms units, used if SDU interval is not known
+    uint16_t iso_interval;
+
+    // tx statistics
+    uint32_t num_sdus_late;
+    uint32_t num_sdus_dropped;
+
     // request to send
     bool can_send_now_requested;
 
@@ -1006,6 +1067,11 @@ typedef struct {
     bool      iso_fragmentation_tx_active;
 
     uint8_t   iso_packets_to_queue;
+    uint32_t  iso_tx_sequence_nr;
+
+    // queued outgoing SDUs for all streams
+    hci_iso_tx_packet_t   iso_tx_pool[MAX_NR_HCI_ISO_TX_QUEUED_PACKETS];
+    btstack_linked_list_t iso_tx_pool_free;
     // group id and type of active operation
     hci_iso_type_t iso_active_operation_type;
     uint8_t iso_active_operation_group_id;
@@ -1077,6 +1143,9 @@ typedef struct {
      
     /* host to controller flow control */
     uint8_t  num_cmd_packets;
+    uint8_t  num_cmd_packets_window;
+    uint8_t  num_cmd_packets_outstanding;
+    uint16_t cmd_outstanding_opcodes[MAX_NR_CONTROLLER_HCI_COMMANDS];
     uint8_t  acl_packets_total_num;
     uint16_t acl_data_packet_length;
     uint8_t  sco_packets_total_num;
@@ -1361,6 +1430,17 @@ uint16_t hci_get_sco_voice_setting(void);
  */
 void hci_set_num_iso_packets_to_queue(uint8_t num_packets);
 
+/**
+ * @brief Get transmit statistics for BIS/CIS
+ * @note SDUs are counted as late if they could not be sent within one SDU interval and as dropped if the
+ *       shared queue was full, see MAX_NR_HCI_ISO_TX_QUEUED_PACKETS
+ * @param con_handle of BIS or CIS
+ * @param num_sdus_late
+ * @param num_sdus_dropped
+ * @return status ERROR_CODE_SUCCESS or ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER
+ */
+uint8_t hci_iso_stream_get_tx_statistics(hci_con_handle_t con_handle, uint32_t * num_sdus_late, uint32_t * num_sdus_dropped);
+
 /**
  * @brief Set inquiry mode: standard, with RSSI, with RSSI + Extended Inquiry Results. Has to be called before power on.
  * @param inquriy_mode see bluetooth_defines.h
@@ -1570,6 +1650,11 @@ bool hci_authentication_active_for_handle(hci_con_handle_t handle);
  */
 uint16_t hci_max_acl_data_packet_length(void);
 
+/**
+ * Get number of ACL Classic data packets that can be buffered by Controller. Called by L2CAP
+ */
+uint8_t hci_max_acl_data_packets(void);
+
 /**
  * Get supported ACL packet types. Already flipped for create connection. Called by L2CAP
  */
@@ -1778,6 +1863,9 @@ void hci_free_connections_fuzz(void);
 // simulate stack bootup
 void hci_simulate_working_fuzz(void);
 
+// set Controller ACL buffer size and count, used for simulation
+void hci_set_acl_buffers_fuzz(uint16_t acl_data_packet_length, uint8_t acl_packets_total_num);
+
 
 #if defined __cplusplus
 }
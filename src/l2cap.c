@@ -121,9 +121,33 @@ typedef enum {
 // used to cache l2cap rejects, echo, and informational requests
 #define NR_PENDING_SIGNALING_RESPONSES 3
 
-// nr of credits provided to remote if credits fall below watermark
-#define L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_WATERMARK 5
-#define L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_INCREMENT 5
+// automatic credits: remote credits are refilled to the window if they fall below half of it
+// initial window covers number of SDUs with local MTU, window grows if remote uses it up faster than the interval
+#ifndef L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_NUM_SDUS
+#define L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_NUM_SDUS 2
+#endif
+#ifndef L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_MIN
+#define L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_MIN 10
+#endif
+#ifndef L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_MAX
+#define L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_MAX 256
+#endif
+#ifndef L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_INTERVAL_MS
+#define L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_INTERVAL_MS 100
+#endif
+
+// nr of buckets for channel lookup by local cid and by con handle + remote cid, power of two recommended
+#ifndef L2CAP_CHANNEL_LOOKUP_TABLE_SIZE
+#define L2CAP_CHANNEL_LOOKUP_TABLE_SIZE 16
+#endif
+
+// ERTM: max delay for acknowledgement of received I-Frames, if not sent earlier with outgoing I-Frame or after half the TxWindow
+#ifndef L2CAP_ERTM_ACK_TIMEOUT_MS
+#define L2CAP_ERTM_ACK_TIMEOUT_MS 20
+#endif
+
+// ERTM: Enhanced Control Field and FCS in I-Frames
+#define L2CAP_ERTM_FRAME_OVERHEAD 4
 
 // offsets for L2CAP SIGNALING COMMANDS
 #define L2CAP_SIGNALING_COMMAND_CODE_OFFSET   0
@@ -156,6 +180,8 @@ static void l2cap_run(void);
 static void l2cap_hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
 static void l2cap_acl_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size );
 static void l2cap_notify_channel_can_send(void);
+static void l2cap_send_queue_add(l2cap_fixed_channel_t * channel);
+static void l2cap_send_queue_remove(l2cap_fixed_channel_t * channel);
 static void l2cap_emit_can_send_now(btstack_packet_handler_t packet_handler, uint16_t channel);
 static uint8_t  l2cap_next_sig_id(void);
 static l2cap_fixed_channel_t * l2cap_fixed_channel_for_channel_id(uint16_t local_cid);
@@ -200,6 +226,7 @@ static void l2cap_free_channel_entry(l2cap_channel_t * channel);
 static void l2cap_ertm_notify_channel_can_send(l2cap_channel_t * channel);
 static void l2cap_ertm_monitor_timeout_callback(btstack_timer_source_t * ts);
 static void l2cap_ertm_retransmission_timeout_callback(btstack_timer_source_t * ts);
+static void l2cap_ertm_ack_timeout_callback(btstack_timer_source_t * ts);
 #endif
 #ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
 static int l2cap_ecbm_signaling_handler_dispatch(hci_con_handle_t handle, uint16_t signaling_cid, uint8_t * command, uint8_t sig_id);
@@ -233,9 +260,29 @@ static uint16_t l2cap_enhanced_mps_max;
 
 // single list of channels for connection-oriented channels (basic, ertm, cbm, ecbf) Classic Connectionless, ATT, and SM
 static btstack_linked_list_t l2cap_channels;
+
+// channels waiting to send, queued per link type as Controller buffers are shared per link type
+#define L2CAP_SEND_QUEUE_CLASSIC 0
+#define L2CAP_SEND_QUEUE_LE      1
+#define L2CAP_SEND_QUEUE_NUM     2
+
+typedef struct {
+    l2cap_fixed_channel_t * head;
+    l2cap_fixed_channel_t * tail;
+    uint16_t num_channels;
+} l2cap_send_queue_t;
+
+static l2cap_send_queue_t l2cap_send_queues[L2CAP_SEND_QUEUE_NUM];
+static uint32_t l2cap_can_send_now_num_wakeups;
+static uint32_t l2cap_can_send_now_num_sends;
 #ifdef L2CAP_USES_CHANNELS
 // next channel id for new connections
 static uint16_t  l2cap_local_source_cid;
+// connection-oriented channels hashed by local cid and by con handle + remote cid
+static l2cap_channel_t * l2cap_channels_by_local_cid[L2CAP_CHANNEL_LOOKUP_TABLE_SIZE];
+#ifdef L2CAP_USES_CREDIT_BASED_CHANNELS
+static l2cap_channel_t * l2cap_channels_by_remote_cid[L2CAP_CHANNEL_LOOKUP_TABLE_SIZE];
+#endif
 #endif
 // next signaling sequence number
 static uint8_t   l2cap_sig_seq_nr;
@@ -359,6 +406,40 @@ static void l2cap_ertm_stop_retransmission_timer(l2cap_channel_t * l2cap_channel
     btstack_run_loop_remove_timer(&l2cap_channel->retransmission_timer);
 }    
 
+static void l2cap_ertm_stop_ack_timer(l2cap_channel_t * l2cap_channel){
+    btstack_run_loop_remove_timer(&l2cap_channel->ack_timer);
+}
+
+// count received I-Frame, request RR after ack threshold, otherwise wait for outgoing I-Frame or ack timeout
+static void l2cap_ertm_acknowledge_information_frame(l2cap_channel_t * channel){
+    channel->num_received_frames_unacked++;
+    if (channel->num_received_frames_unacked >= channel->ack_threshold){
+        l2cap_ertm_stop_ack_timer(channel);
+        channel->send_supervisor_frame_receiver_ready = 1;
+        return;
+    }
+    // timer already running
+    if (channel->num_received_frames_unacked > 1) return;
+    btstack_run_loop_set_timer_handler(&channel->ack_timer, &l2cap_ertm_ack_timeout_callback);
+    btstack_run_loop_set_timer_context(&channel->ack_timer, channel);
+    btstack_run_loop_set_timer(&channel->ack_timer, L2CAP_ERTM_ACK_TIMEOUT_MS);
+    btstack_run_loop_add_timer(&channel->ack_timer);
+}
+
+// req_seq has been sent in I-Frame or S-Frame
+static void l2cap_ertm_received_frames_acknowledged(l2cap_channel_t * channel){
+    channel->num_received_frames_unacked = 0;
+    l2cap_ertm_stop_ack_timer(channel);
+}
+
+static void l2cap_ertm_ack_timeout_callback(btstack_timer_source_t * ts){
+    l2cap_channel_t * l2cap_channel = (l2cap_channel_t *) btstack_run_loop_get_timer_context(ts);
+    log_info("Ack timeout, %u I-Frames not acknowledged", l2cap_channel->num_received_frames_unacked);
+    if (l2cap_channel->num_received_frames_unacked == 0) return;
+    l2cap_channel->send_supervisor_frame_receiver_ready = 1;
+    l2cap_run();
+}
+
 static void l2cap_ertm_monitor_timeout_callback(btstack_timer_source_t * ts){
     log_info("Monitor timeout");
     l2cap_channel_t * l2cap_channel = (l2cap_channel_t *) btstack_run_loop_get_timer_context(ts);
@@ -417,8 +498,10 @@ static int l2cap_ertm_send_information_frame(l2cap_channel_t * channel, int inde
     log_info("I-Frame: control 0x%04x", control);
     little_endian_store_16(acl_buffer, 8, control);
     (void)memcpy(&acl_buffer[8 + 2],
-                 &channel->tx_packets_data[index * channel->local_mps],
+                 &channel->tx_packets_data[index * channel->remote_mps],
                  tx_state->len);
+    // received I-Frames acknowledged by req_seq
+    l2cap_ertm_received_frames_acknowledged(channel);
     // (re-)start retransmission timer on 
     l2cap_ertm_start_retransmission_timer(channel);
     // send
@@ -434,7 +517,7 @@ static void l2cap_ertm_store_fragment(l2cap_channel_t * channel, l2cap_segmentat
     tx_state->sar = sar;
     tx_state->retry_count = 0;
 
-    uint8_t * tx_packet = &channel->tx_packets_data[index * channel->local_mps];
+    uint8_t * tx_packet = &channel->tx_packets_data[index * channel->remote_mps];
     log_debug("index %u, local mps %u, remote mps %u, packet tx %p, len %u", index, channel->local_mps, channel->remote_mps, tx_packet, len);
     int pos = 0;
     if (sar == L2CAP_SEGMENTATION_AND_REASSEMBLY_START_OF_L2CAP_SDU){
@@ -498,6 +581,7 @@ static uint8_t l2cap_ertm_send(l2cap_channel_t * channel, const uint8_t * data,
     }
 
     // try to send
+    l2cap_send_queue_add((l2cap_fixed_channel_t *) channel);
     l2cap_notify_channel_can_send();
     return ERROR_CODE_SUCCESS;
 }
@@ -569,6 +653,7 @@ static int l2cap_ertm_send_supervisor_frame(l2cap_channel_t * channel, uint16_t
     uint8_t *acl_buffer = hci_get_outgoing_packet_buffer();
     log_info("S-Frame: control 0x%04x", control);
     little_endian_store_16(acl_buffer, 8, control);
+    l2cap_ertm_received_frames_acknowledged(channel);
     return l2cap_send_prepared(channel->local_cid, 2);
 }
 
@@ -602,6 +687,17 @@ static uint8_t l2cap_ertm_validate_local_config(l2cap_ertm_config_t * ertm_confi
     return result;
 }
 
+static uint16_t l2cap_ertm_max_mps(void){
+    return l2cap_max_mtu() - L2CAP_ERTM_FRAME_OVERHEAD;
+}
+
+// @return configured mps or 0 if not set or out of range
+static uint16_t l2cap_ertm_config_get_mps(const l2cap_ertm_config_t * ertm_config){
+    if (ertm_config->mps < L2CAP_MINIMAL_MTU) return 0;
+    if (ertm_config->mps > l2cap_ertm_max_mps()) return 0;
+    return ertm_config->mps;
+}
+
 static void l2cap_ertm_setup_buffers(l2cap_channel_t * channel, uint8_t * buffer, uint32_t size){
     btstack_assert( (((uintptr_t) buffer) & 0x0f) == 0);
 
@@ -612,6 +708,9 @@ static void l2cap_ertm_setup_buffers(l2cap_channel_t * channel, uint8_t * buffer
     channel->tx_packets_state = (l2cap_ertm_tx_packet_state_t *) (void *) &buffer[pos];
     pos += channel->num_tx_buffers * sizeof(l2cap_ertm_tx_packet_state_t);
 
+    // buffer might have been used by a previous channel
+    (void)memset(buffer, 0, pos);
+
     // setup reassembly buffer
     channel->reassembly_buffer = &buffer[pos];
     pos += channel->local_mtu;
@@ -622,7 +721,7 @@ static void l2cap_ertm_setup_buffers(l2cap_channel_t * channel, uint8_t * buffer
 
     // setup tx buffers
     channel->tx_packets_data = &buffer[pos];
-    pos += channel->num_rx_buffers * channel->remote_mps;
+    pos += channel->num_tx_buffers * channel->remote_mps;
 
     btstack_assert(pos <= size);
     UNUSED(pos);
@@ -639,6 +738,9 @@ static void l2cap_ertm_configure_channel(l2cap_channel_t * channel, l2cap_ertm_c
     channel->num_rx_buffers = ertm_config->num_rx_buffers;
     channel->num_tx_buffers = ertm_config->num_tx_buffers;
     channel->fcs_option = ertm_config->fcs_option;
+    channel->num_received_frames_unacked = 0;
+    // acknowledge each I-Frame until remote confirmed its TxWindow
+    channel->ack_threshold = 1;
 
     // align buffer to 16-byte boundary to assert l2cap_ertm_rx_packet_state_t is aligned
     int bytes_till_alignment = 16 - (((uintptr_t) buffer) & 0x0f);
@@ -650,9 +752,15 @@ static void l2cap_ertm_configure_channel(l2cap_channel_t * channel, l2cap_ertm_c
     uint32_t buffer_space = size - state_len - channel->local_mtu;
 
     // divide rest of data equally for initial config
-    uint16_t mps = buffer_space / (ertm_config->num_rx_buffers + ertm_config->num_tx_buffers);
-    channel->local_mps  = mps;
-    channel->remote_mps = mps;
+    uint32_t mps = buffer_space / (ertm_config->num_rx_buffers + ertm_config->num_tx_buffers);
+    uint16_t config_mps = l2cap_ertm_config_get_mps(ertm_config);
+    if (config_mps > 0){
+        mps = btstack_min(mps, config_mps);
+    }
+    // I-Frames have to fit into HCI ACL buffer
+    mps = btstack_min(mps, l2cap_ertm_max_mps());
+    channel->local_mps  = (uint16_t) mps;
+    channel->remote_mps = (uint16_t) mps;
     l2cap_ertm_setup_buffers(channel, buffer, size);
 
     log_info("Local MPS: %u", channel->local_mps);
@@ -705,6 +813,7 @@ uint8_t l2cap_ertm_create_channel(btstack_packet_handler_t packet_handler, bd_ad
 }
 
 static void l2cap_ertm_notify_channel_can_send(l2cap_channel_t * channel){
+    if (channel->waiting_for_can_send_now == 0) return;
     if (l2cap_ertm_can_store_packet_now(channel)){
         channel->waiting_for_can_send_now = 0;
         l2cap_emit_can_send_now(channel->packet_handler, channel->local_cid);
@@ -780,6 +889,55 @@ uint8_t l2cap_ertm_set_ready(uint16_t local_cid){
     return ERROR_CODE_SUCCESS;
 }
 
+uint32_t l2cap_ertm_get_buffer_size(const l2cap_ertm_config_t * ertm_config){
+    uint16_t mps = l2cap_ertm_config_get_mps(ertm_config);
+    if (mps == 0u){
+        mps = l2cap_ertm_max_mps();
+    }
+    // alignment, state and data for rx and tx buffers, reassembly buffer
+    uint32_t size = 16u;
+    size += ertm_config->num_rx_buffers * (sizeof(l2cap_ertm_rx_packet_state_t) + mps);
+    size += ertm_config->num_tx_buffers * (sizeof(l2cap_ertm_tx_packet_state_t) + mps);
+    size += ertm_config->local_mtu;
+    return size;
+}
+
+uint16_t l2cap_ertm_config_for_throughput(l2cap_ertm_config_t * ertm_config, uint16_t local_mtu, uint32_t size){
+    // I-Frame fits into single ACL packet of Controller
+    uint32_t mps = l2cap_ertm_max_mps();
+    uint16_t acl_data_packet_length = hci_max_acl_data_packet_length();
+    if (acl_data_packet_length > (L2CAP_HEADER_SIZE + L2CAP_ERTM_FRAME_OVERHEAD + L2CAP_MINIMAL_MTU)){
+        mps = btstack_min(mps, acl_data_packet_length - (L2CAP_HEADER_SIZE + L2CAP_ERTM_FRAME_OVERHEAD));
+    }
+
+    // TxWindow for I-Frames queued in Controller and I-Frames sent but not acknowledged yet
+    uint32_t num_buffers = 2u * hci_max_acl_data_packets();
+    if (num_buffers == 0u){
+        num_buffers = 4;
+    }
+    num_buffers = btstack_max(2, btstack_min(num_buffers, 63));
+
+    // reduce number of buffers down to 2, then MPS, to fit into buffer
+    uint32_t fixed_size = 16u + local_mtu;
+    if (size <= fixed_size) return 0;
+    uint32_t buffer_space = size - fixed_size;
+    const uint32_t state_len = sizeof(l2cap_ertm_rx_packet_state_t) + sizeof(l2cap_ertm_tx_packet_state_t);
+    num_buffers = btstack_min(num_buffers, buffer_space / (state_len + 2u * mps));
+    if (num_buffers < 2u){
+        num_buffers = 2;
+        if ((buffer_space / 2u) <= state_len) return 0;
+        mps = ((buffer_space / 2u) - state_len) / 2u;
+    }
+    if (mps < L2CAP_MINIMAL_MTU) return 0;
+
+    ertm_config->local_mtu      = local_mtu;
+    ertm_config->num_tx_buffers = (uint8_t) num_buffers;
+    ertm_config->num_rx_buffers = (uint8_t) num_buffers;
+    ertm_config->mps            = (uint16_t) mps;
+    log_info("ERTM config for throughput: %u buffers with MPS %u", (int) num_buffers, (int) mps);
+    return (uint16_t) mps;
+}
+
 // Process-ReqSeq
 static void l2cap_ertm_process_req_seq(l2cap_channel_t * l2cap_channel, uint8_t req_seq){
     int num_buffers_acked = 0;
@@ -806,15 +964,17 @@ static void l2cap_ertm_process_req_seq(l2cap_channel_t * l2cap_channel, uint8_t
         log_info("RR seq %u => packet with tx_seq %u done", req_seq, tx_state->tx_seq);
 
         l2cap_channel->tx_read_index++;
-        if (l2cap_channel->tx_read_index >= l2cap_channel->num_rx_buffers){
+        if (l2cap_channel->tx_read_index >= l2cap_channel->num_tx_buffers){
             l2cap_channel->tx_read_index = 0;
         }
     }
     if (num_buffers_acked){
         log_info("num_buffers_acked %u", num_buffers_acked);
-    l2cap_ertm_notify_channel_can_send(l2cap_channel);
-}     
-}     
+        // remote window has room for stored I-Frames
+        l2cap_call_notify_channel_in_run = true;
+        l2cap_ertm_notify_channel_can_send(l2cap_channel);
+    }
+}
 
 static l2cap_ertm_tx_packet_state_t * l2cap_ertm_get_tx_state(l2cap_channel_t * l2cap_channel, uint8_t tx_seq){
     int i;
@@ -831,7 +991,7 @@ static void l2cap_ertm_handle_out_of_sequence_sdu(l2cap_channel_t * l2cap_channe
     log_info("Store SDU with delta %u", delta);
     // get rx state for packet to store
     int index = l2cap_channel->rx_store_index + delta - 1;
-    if (index > l2cap_channel->num_rx_buffers){
+    if (index >= l2cap_channel->num_rx_buffers){
         index -= l2cap_channel->num_rx_buffers;
     }
     log_info("Index of packet to store %u", index);
@@ -841,10 +1001,15 @@ static void l2cap_ertm_handle_out_of_sequence_sdu(l2cap_channel_t * l2cap_channe
         log_error("Packet buffer already used");
         return;
     }
+    // SDU Length in start segment might exceed rx buffer
+    if (size > l2cap_channel->local_mps){
+        log_error("Packet larger than rx buffer");
+        return;
+    }
     rx_state->valid = 1;
     rx_state->sar = sar;
     rx_state->len = size;
-    uint8_t * rx_buffer = &l2cap_channel->rx_packets_data[index];
+    uint8_t * rx_buffer = &l2cap_channel->rx_packets_data[index * l2cap_channel->local_mps];
     (void)memcpy(rx_buffer, payload, size);
 }
 
@@ -987,6 +1152,15 @@ void l2cap_init(void){
  */
 void l2cap_deinit(void){
     l2cap_channels = NULL;
+    (void)memset(l2cap_send_queues, 0, sizeof(l2cap_send_queues));
+    l2cap_can_send_now_num_wakeups = 0;
+    l2cap_can_send_now_num_sends = 0;
+#ifdef L2CAP_USES_CHANNELS
+    (void)memset(l2cap_channels_by_local_cid, 0, sizeof(l2cap_channels_by_local_cid));
+#endif
+#ifdef L2CAP_USES_CREDIT_BASED_CHANNELS
+    (void)memset(l2cap_channels_by_remote_cid, 0, sizeof(l2cap_channels_by_remote_cid));
+#endif
     l2cap_signaling_responses_pending = 0;
 #ifdef ENABLE_CLASSIC
     l2cap_require_security_level2_for_outgoing_sdp = 0;
@@ -1034,6 +1208,7 @@ void l2cap_request_can_send_fix_channel_now_event(hci_con_handle_t con_handle, u
     l2cap_fixed_channel_t * channel = l2cap_fixed_channel_for_channel_id(channel_id);
     if (!channel) return;
     channel->waiting_for_can_send_now = 1;
+    l2cap_send_queue_add(channel);
     l2cap_notify_channel_can_send();
 }
 
@@ -1206,6 +1381,7 @@ static void l2cap_handle_channel_closed(l2cap_channel_t * channel){
 }
 #endif
 
+// used for fixed channels only, dynamic channels are looked up via l2cap_channels_by_local_cid
 static l2cap_fixed_channel_t * l2cap_channel_item_by_cid(uint16_t cid){
     btstack_linked_list_iterator_t it;    
     btstack_linked_list_iterator_init(&it, &l2cap_channels);
@@ -1239,12 +1415,36 @@ static int l2cap_is_dynamic_channel_type(l2cap_channel_type_t channel_type) {
 
 static l2cap_channel_t * l2cap_get_channel_for_local_cid(uint16_t local_cid){
     if (local_cid < 0x40u) return NULL;
-    return (l2cap_channel_t*) l2cap_channel_item_by_cid(local_cid);
+    l2cap_channel_t * channel = l2cap_channels_by_local_cid[local_cid % L2CAP_CHANNEL_LOOKUP_TABLE_SIZE];
+    while (channel != NULL){
+        if (channel->local_cid == local_cid) {
+            return channel;
+        }
+        channel = channel->next_for_local_cid;
+    }
+    return NULL;
+}
+
+static void l2cap_channel_lookup_add_local_cid(l2cap_channel_t * channel){
+    l2cap_channel_t ** bucket = &l2cap_channels_by_local_cid[channel->local_cid % L2CAP_CHANNEL_LOOKUP_TABLE_SIZE];
+    channel->next_for_local_cid = *bucket;
+    *bucket = channel;
+}
+
+static void l2cap_channel_lookup_remove_local_cid(l2cap_channel_t * channel){
+    l2cap_channel_t ** it = &l2cap_channels_by_local_cid[channel->local_cid % L2CAP_CHANNEL_LOOKUP_TABLE_SIZE];
+    while (*it != NULL){
+        if (*it == channel){
+            *it = channel->next_for_local_cid;
+            channel->next_for_local_cid = NULL;
+            return;
+        }
+        it = &(*it)->next_for_local_cid;
+    }
 }
 
 static l2cap_channel_t * l2cap_get_channel_for_local_cid_and_handle(uint16_t local_cid, hci_con_handle_t con_handle){
-    if (local_cid < 0x40u) return NULL;
-    l2cap_channel_t * l2cap_channel = (l2cap_channel_t*) l2cap_channel_item_by_cid(local_cid);
+    l2cap_channel_t * l2cap_channel = l2cap_get_channel_for_local_cid(local_cid);
     if (l2cap_channel == NULL)  return NULL;
     if (l2cap_channel->con_handle != con_handle) return NULL;
     return l2cap_channel;
@@ -1252,19 +1452,49 @@ static l2cap_channel_t * l2cap_get_channel_for_local_cid_and_handle(uint16_t loc
 #endif
 
 #ifdef L2CAP_USES_CREDIT_BASED_CHANNELS
+static uint16_t l2cap_channel_lookup_remote_bucket(hci_con_handle_t con_handle, uint16_t remote_cid){
+    return (uint16_t) ((con_handle ^ remote_cid) % L2CAP_CHANNEL_LOOKUP_TABLE_SIZE);
+}
+
 static l2cap_channel_t * l2cap_get_channel_for_remote_handle_and_cid(hci_con_handle_t con_handle, uint16_t remote_cid){
-    btstack_linked_list_iterator_t it;
-    btstack_linked_list_iterator_init(&it, &l2cap_channels);
-    while (btstack_linked_list_iterator_has_next(&it)){
-        l2cap_fixed_channel_t * channel = (l2cap_fixed_channel_t*) btstack_linked_list_iterator_next(&it);
-        if (!l2cap_is_dynamic_channel_type(channel->channel_type)) continue;
-        l2cap_channel_t * dynamic_channel = (l2cap_channel_t *) channel;
-        if (dynamic_channel->con_handle != con_handle) continue;
-        if (dynamic_channel->remote_cid != remote_cid) continue;
-        return dynamic_channel;
+    l2cap_channel_t * channel = l2cap_channels_by_remote_cid[l2cap_channel_lookup_remote_bucket(con_handle, remote_cid)];
+    while (channel != NULL){
+        if ((channel->con_handle == con_handle) && (channel->remote_cid == remote_cid)) {
+            return channel;
+        }
+        channel = channel->next_for_remote_cid;
     }
     return NULL;
 }
+
+static void l2cap_channel_lookup_remove_remote_cid(l2cap_channel_t * channel){
+    if (channel->remote_cid == 0u) return;
+    l2cap_channel_t ** it = &l2cap_channels_by_remote_cid[l2cap_channel_lookup_remote_bucket(channel->con_handle, channel->remote_cid)];
+    while (*it != NULL){
+        if (*it == channel){
+            *it = channel->next_for_remote_cid;
+            channel->next_for_remote_cid = NULL;
+            return;
+        }
+        it = &(*it)->next_for_remote_cid;
+    }
+}
+#endif
+
+#ifdef L2CAP_USES_CHANNELS
+// con handle has to be set before, remote cid is not changed afterwards
+static void l2cap_channel_set_remote_cid(l2cap_channel_t * channel, uint16_t remote_cid){
+#ifdef L2CAP_USES_CREDIT_BASED_CHANNELS
+    l2cap_channel_lookup_remove_remote_cid(channel);
+    channel->remote_cid = remote_cid;
+    if (remote_cid == 0u) return;
+    l2cap_channel_t ** bucket = &l2cap_channels_by_remote_cid[l2cap_channel_lookup_remote_bucket(channel->con_handle, remote_cid)];
+    channel->next_for_remote_cid = *bucket;
+    *bucket = channel;
+#else
+    channel->remote_cid = remote_cid;
+#endif
+}
 #endif
 
 #ifdef L2CAP_USES_CHANNELS
@@ -1280,6 +1510,7 @@ uint8_t l2cap_request_can_send_now_event(uint16_t local_cid){
                 return ERROR_CODE_SUCCESS;
             }
 #endif
+            l2cap_send_queue_add((l2cap_fixed_channel_t *) channel);
             l2cap_notify_channel_can_send();
             break;
 #ifdef ENABLE_L2CAP_LE_CREDIT_BASED_FLOW_CONTROL_MODE
@@ -2456,6 +2687,7 @@ static l2cap_channel_t * l2cap_create_channel_entry(btstack_packet_handler_t pac
     // 
     channel->local_cid = l2cap_next_local_cid();
     channel->con_handle = HCI_CON_HANDLE_INVALID;
+    l2cap_channel_lookup_add_local_cid(channel);
 
     // set initial state
     channel->state = L2CAP_STATE_WILL_SEND_CREATE_CONNECTION;
@@ -2475,6 +2707,12 @@ static void l2cap_free_channel_entry(l2cap_channel_t * channel){
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
     l2cap_ertm_stop_retransmission_timer(channel);
     l2cap_ertm_stop_monitor_timer(channel);
+    l2cap_ertm_stop_ack_timer(channel);
+#endif
+    l2cap_send_queue_remove((l2cap_fixed_channel_t *) channel);
+    l2cap_channel_lookup_remove_local_cid(channel);
+#ifdef L2CAP_USES_CREDIT_BASED_CHANNELS
+    l2cap_channel_lookup_remove_remote_cid(channel);
 #endif
     // free  memory
     btstack_memory_l2cap_channel_free(channel);
@@ -2686,31 +2924,179 @@ static void l2cap_channel_trigger_send(l2cap_channel_t * channel){
     }
 }
 
-static void l2cap_notify_channel_can_send(void){
+static l2cap_send_queue_t * l2cap_send_queue_for_channel(l2cap_fixed_channel_t * channel){
+    switch (channel->channel_type){
+        case L2CAP_CHANNEL_TYPE_FIXED_LE:
+        case L2CAP_CHANNEL_TYPE_CHANNEL_CBM:
+            return &l2cap_send_queues[L2CAP_SEND_QUEUE_LE];
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+        case L2CAP_CHANNEL_TYPE_CHANNEL_ECBM:
+            if (((l2cap_channel_t *) channel)->address_type == BD_ADDR_TYPE_ACL){
+                return &l2cap_send_queues[L2CAP_SEND_QUEUE_CLASSIC];
+            }
+            return &l2cap_send_queues[L2CAP_SEND_QUEUE_LE];
+#endif
+        default:
+            return &l2cap_send_queues[L2CAP_SEND_QUEUE_CLASSIC];
+    }
+}
+
+static void l2cap_send_queue_add(l2cap_fixed_channel_t * channel){
+    if (channel->queued_to_send != 0u) return;
+    l2cap_send_queue_t * queue = l2cap_send_queue_for_channel(channel);
+    channel->queued_to_send = 1;
+    channel->next_waiting_to_send = NULL;
+    if (queue->tail == NULL){
+        queue->head = channel;
+    } else {
+        queue->tail->next_waiting_to_send = channel;
+    }
+    queue->tail = channel;
+    queue->num_channels++;
+}
+
+static l2cap_fixed_channel_t * l2cap_send_queue_pop(l2cap_send_queue_t * queue){
+    l2cap_fixed_channel_t * channel = queue->head;
+    if (channel == NULL) return NULL;
+    queue->head = channel->next_waiting_to_send;
+    if (queue->head == NULL){
+        queue->tail = NULL;
+    }
+    queue->num_channels--;
+    channel->next_waiting_to_send = NULL;
+    channel->queued_to_send = 0;
+    return channel;
+}
+
+static void l2cap_send_queue_remove(l2cap_fixed_channel_t * channel){
+    if (channel->queued_to_send == 0u) return;
+    l2cap_send_queue_t * queue = l2cap_send_queue_for_channel(channel);
+    l2cap_fixed_channel_t * prev = NULL;
+    l2cap_fixed_channel_t * it = queue->head;
+    while (it != NULL){
+        if (it == channel){
+            if (prev == NULL){
+                queue->head = channel->next_waiting_to_send;
+            } else {
+                prev->next_waiting_to_send = channel->next_waiting_to_send;
+            }
+            if (queue->tail == channel){
+                queue->tail = prev;
+            }
+            queue->num_channels--;
+            break;
+        }
+        prev = it;
+        it = it->next_waiting_to_send;
+    }
+    channel->next_waiting_to_send = NULL;
+    channel->queued_to_send = 0;
+}
+
+// independent of Controller buffers, credits or ERTM window
+static bool l2cap_channel_has_data_to_send(l2cap_channel_t * channel){
+    switch (channel->channel_type){
+#ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
+        case L2CAP_CHANNEL_TYPE_CLASSIC:
+            if (channel->mode == L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION) {
+                return channel->unacked_frames < channel->num_stored_tx_frames;
+            }
+            return channel->waiting_for_can_send_now != 0u;
+#endif
+#ifdef L2CAP_USES_CREDIT_BASED_CHANNELS
+        case L2CAP_CHANNEL_TYPE_CHANNEL_CBM:
+        case L2CAP_CHANNEL_TYPE_CHANNEL_ECBM:
+            return channel->send_sdu_buffer != NULL;
+#endif
+        default:
+            return channel->waiting_for_can_send_now != 0u;
+    }
+}
+
+static bool l2cap_send_queue_can_send_now(uint8_t queue_index){
+    switch (queue_index){
+#ifdef ENABLE_CLASSIC
+        case L2CAP_SEND_QUEUE_CLASSIC:
+            return hci_can_send_acl_classic_packet_now();
+#endif
+#ifdef ENABLE_BLE
+        case L2CAP_SEND_QUEUE_LE:
+            return hci_can_send_acl_le_packet_now();
+#endif
+        default:
+            return false;
+    }
+}
+
+// channel in throughput mode stays at head of queue until last K-frame of current SDU
+static bool l2cap_channel_keeps_send_position(l2cap_channel_t * channel){
+    switch (channel->channel_type){
+#ifdef ENABLE_L2CAP_LE_CREDIT_BASED_FLOW_CONTROL_MODE
+        case L2CAP_CHANNEL_TYPE_CHANNEL_CBM:
+#endif
+#ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+        case L2CAP_CHANNEL_TYPE_CHANNEL_ECBM:
+#endif
+#ifdef L2CAP_USES_CREDIT_BASED_CHANNELS
+            if (!channel->throughput_mode) return false;
+            // SDU incl. SDU length field is sent in K-frames of up to remote MPS
+            return (channel->send_sdu_len + 2u - channel->send_sdu_pos) > channel->remote_mps;
+#endif
+        default:
+            return false;
+    }
+}
+
+static void l2cap_send_queue_process(uint8_t queue_index){
+    l2cap_send_queue_t * queue = &l2cap_send_queues[queue_index];
     bool done = false;
     while (!done){
         done = true;
-        btstack_linked_list_iterator_t it;
-        btstack_linked_list_iterator_init(&it, &l2cap_channels);
-        while (btstack_linked_list_iterator_has_next(&it)){
-            l2cap_channel_t * channel = (l2cap_channel_t *) btstack_linked_list_iterator_next(&it);
-            bool ready = l2cap_channel_ready_to_send(channel);
-            if (!ready) continue;
+        // check each waiting channel once per round
+        uint16_t num_channels = queue->num_channels;
+        while ((num_channels > 0u) && (queue->head != NULL)){
+            num_channels--;
+            l2cap_channel_t * channel = (l2cap_channel_t *) queue->head;
+            if (!l2cap_channel_has_data_to_send(channel)){
+                (void) l2cap_send_queue_pop(queue);
+                continue;
+            }
 
-            // requeue channel for fairness
-            btstack_linked_list_remove(&l2cap_channels, (btstack_linked_item_t *) channel);
-            btstack_linked_list_add_tail(&l2cap_channels, (btstack_linked_item_t *) channel);
+            l2cap_can_send_now_num_wakeups++;
+            if (!l2cap_channel_ready_to_send(channel)){
+                // Controller buffers full: keep position for next buffer
+                if (!l2cap_send_queue_can_send_now(queue_index)) return;
+                // waiting for credits, ERTM window, or channel open: check others first
+                (void) l2cap_send_queue_pop(queue);
+                l2cap_send_queue_add((l2cap_fixed_channel_t *) channel);
+                continue;
+            }
 
-            // trigger sending
+            // requeue channel for fairness before trigger sending, as channel might get freed in callback
+            // channel is dropped from queue later if it doesn't have more data
+            l2cap_can_send_now_num_sends++;
+            if (!l2cap_channel_keeps_send_position(channel)){
+                (void) l2cap_send_queue_pop(queue);
+                l2cap_send_queue_add((l2cap_fixed_channel_t *) channel);
+            }
             l2cap_channel_trigger_send(channel);
-
-            // exit inner loop as we just broke the iterator, but try again
             done = false;
-            break;
         }
     }
 }
 
+static void l2cap_notify_channel_can_send(void){
+    uint8_t queue_index;
+    for (queue_index = 0; queue_index < L2CAP_SEND_QUEUE_NUM; queue_index++){
+        l2cap_send_queue_process(queue_index);
+    }
+}
+
+void l2cap_get_can_send_now_statistics(uint32_t * num_wakeups, uint32_t * num_sends){
+    *num_wakeups = l2cap_can_send_now_num_wakeups;
+    *num_sends   = l2cap_can_send_now_num_sends;
+}
+
 #ifdef L2CAP_USES_CHANNELS
 
 uint8_t l2cap_disconnect(uint16_t local_cid){
@@ -3104,7 +3490,7 @@ static void l2cap_handle_connection_request(hci_con_handle_t handle, uint8_t sig
     }
 
     channel->con_handle = handle;
-    channel->remote_cid = source_cid;
+    l2cap_channel_set_remote_cid(channel, source_cid);
     channel->remote_sig_id = sig_id;
 
     // limit local mtu to max acl packet length - l2cap header
@@ -3220,11 +3606,12 @@ static void l2cap_signaling_handle_configure_request(l2cap_channel_t *channel, u
                         if (remote_mps < channel->remote_mps){
                             // get current tx storage
                             uint16_t num_bytes_per_tx_buffer_before = sizeof(l2cap_ertm_tx_packet_state_t) + channel->remote_mps;
-                            uint16_t tx_storage = channel->num_tx_buffers * num_bytes_per_tx_buffer_before;
+                            uint32_t tx_storage = channel->num_tx_buffers * num_bytes_per_tx_buffer_before;
 
                             channel->remote_mps = remote_mps;
                             uint16_t num_bytes_per_tx_buffer_now = sizeof(l2cap_ertm_tx_packet_state_t) + channel->remote_mps;
-                            channel->num_tx_buffers = tx_storage / num_bytes_per_tx_buffer_now;
+                            // stored frames are identified by 6-bit TxSeq
+                            channel->num_tx_buffers = (uint8_t) btstack_min(tx_storage / num_bytes_per_tx_buffer_now, 63);
                             uint32_t total_storage = (sizeof(l2cap_ertm_rx_packet_state_t) + channel->local_mps) * channel->num_rx_buffers + tx_storage + channel->local_mtu;
                             l2cap_ertm_setup_buffers(channel, (uint8_t *) channel->rx_packets_state, total_storage);
                         }
@@ -3307,6 +3694,11 @@ static void l2cap_signaling_handle_configure_response(l2cap_channel_t *channel,
         if (option_type == L2CAP_CONFIG_OPTION_TYPE_RETRANSMISSION_AND_FLOW_CONTROL && length == 9){
             switch (channel->mode){
                 case L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION:
+                    if (result == L2CAP_CONF_RESULT_SUCCESS){
+                        // TxWindow in response: I-Frames remote sends without acknowledgement. Acknowledge after half of it
+                        uint8_t remote_tx_window = btstack_min(command[pos+1], channel->num_rx_buffers);
+                        channel->ack_threshold = btstack_max(1, remote_tx_window / 2);
+                    }
                     if (channel->ertm_mandatory){
                         // ??
                     } else {
@@ -3386,7 +3778,7 @@ static void l2cap_signaling_handler_channel(l2cap_channel_t *channel, uint8_t *c
                     switch (result) {
                         case 0:
                             // successful connection
-                            channel->remote_cid = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET);
+                            l2cap_channel_set_remote_cid(channel, little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET));
                             channel->state = L2CAP_STATE_CONFIG;
                             channelStateVarSetFlag(channel, L2CAP_CHANNEL_STATE_VAR_SEND_CONF_REQ);
                             break;
@@ -3912,7 +4304,7 @@ static int l2cap_ecbm_signaling_handler_dispatch(hci_con_handle_t handle, uint16
                     channel->state_var |= L2CAP_CHANNEL_STATE_VAR_INCOMING;
                     channel->con_handle = connection->con_handle;
                     channel->remote_sig_id = sig_id;
-                    channel->remote_cid = source_cid;
+                    l2cap_channel_set_remote_cid(channel, source_cid);
                     channel->remote_mtu = remote_mtu;
                     channel->remote_mps = remote_mps;
                     channel->credits_outgoing = credits_outgoing;
@@ -3981,7 +4373,7 @@ static int l2cap_ecbm_signaling_handler_dispatch(hci_con_handle_t handle, uint16
                     uint16_t remote_cid = little_endian_read_16(command, 12 + channel->cid_index * sizeof(uint16_t));
                     if (remote_cid != 0) {
                         channel->state = L2CAP_STATE_OPEN;
-                        channel->remote_cid = remote_cid;
+                        l2cap_channel_set_remote_cid(channel, remote_cid);
                         channel->remote_mtu = new_mtu;
                         channel->remote_mps = new_mps;
                         channel->credits_outgoing = initial_credits;
@@ -4290,7 +4682,7 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
                 }
 
                 channel->con_handle = handle;
-                channel->remote_cid = source_cid;
+                l2cap_channel_set_remote_cid(channel, source_cid);
                 channel->remote_sig_id = sig_id; 
                 channel->remote_mtu = little_endian_read_16(command, 8);
                 channel->remote_mps = little_endian_read_16(command, 10);
@@ -4342,7 +4734,7 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
             }
 
             // success
-            channel->remote_cid = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 0);
+            l2cap_channel_set_remote_cid(channel, little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 0));
             channel->remote_mtu = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 2);
             channel->remote_mps = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 4);
             channel->credits_outgoing = little_endian_read_16(command, L2CAP_SIGNALING_COMMAND_DATA_OFFSET + 6);
@@ -4560,6 +4952,7 @@ static void l2cap_acl_classic_handler_for_channel(l2cap_channel_t * l2cap_channe
                 log_info("Received expected frame with TxSeq == ExpectedTxSeq == %02u", tx_seq);
                 l2cap_channel->expected_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel->expected_tx_seq);
                 l2cap_channel->req_seq         = l2cap_channel->expected_tx_seq;
+                l2cap_channel->retransmission_requested = 0;
 
                 // process SDU
                 l2cap_ertm_handle_in_sequence_sdu(l2cap_channel, sar, payload_data, payload_len);
@@ -4575,7 +4968,7 @@ static void l2cap_acl_classic_handler_for_channel(l2cap_channel_t * l2cap_channe
                     l2cap_channel->req_seq         = l2cap_channel->expected_tx_seq;
 
                     rx_state->valid = 0;
-                    l2cap_ertm_handle_in_sequence_sdu(l2cap_channel, rx_state->sar, &l2cap_channel->rx_packets_data[index], rx_state->len);
+                    l2cap_ertm_handle_in_sequence_sdu(l2cap_channel, rx_state->sar, &l2cap_channel->rx_packets_data[index * l2cap_channel->local_mps], rx_state->len);
 
                     // update rx store index
                     index++;
@@ -4585,20 +4978,28 @@ static void l2cap_acl_classic_handler_for_channel(l2cap_channel_t * l2cap_channe
                     l2cap_channel->rx_store_index = index;
                 }
 
-                //
-                l2cap_channel->send_supervisor_frame_receiver_ready = 1;
+                // acknowledge now or later
+                l2cap_ertm_acknowledge_information_frame(l2cap_channel);
 
             } else {
                 int delta = (tx_seq - l2cap_channel->expected_tx_seq) & 0x3f;
-                if (delta < 2){
+                if (delta >= l2cap_channel->num_rx_buffers){
+                    // TxSeq before ExpectedTxSeq, e.g. retransmission after REJ of an I-Frame we already stored
+                    log_info("Received duplicate frame TxSeq %u, expected %u -> drop", tx_seq, l2cap_channel->expected_tx_seq);
+                } else if (delta < 2){
                     // store segment
                     l2cap_ertm_handle_out_of_sequence_sdu(l2cap_channel, sar, delta, payload_data, payload_len);
 
-                    log_info("Received unexpected frame TxSeq %u but expected %u -> send S-SREJ", tx_seq, l2cap_channel->expected_tx_seq);
-                    l2cap_channel->send_supervisor_frame_selective_reject = 1;
-                } else {
+                    if (l2cap_channel->retransmission_requested == 0){
+                        log_info("Received unexpected frame TxSeq %u but expected %u -> send S-SREJ", tx_seq, l2cap_channel->expected_tx_seq);
+                        l2cap_channel->send_supervisor_frame_selective_reject = 1;
+                        l2cap_channel->retransmission_requested = 1;
+                    }
+                } else if (l2cap_channel->retransmission_requested == 0){
+                    // remote re-sends all I-Frames starting with ExpectedTxSeq, further I-Frames are dropped until then
                     log_info("Received unexpected frame TxSeq %u but expected %u -> send S-REJ", tx_seq, l2cap_channel->expected_tx_seq);
                     l2cap_channel->send_supervisor_frame_reject = 1;
+                    l2cap_channel->retransmission_requested = 1;
                 }
             }
         }
@@ -4914,6 +5315,7 @@ static uint8_t l2cap_credit_based_send_data(l2cap_channel_t * channel, const uin
     channel->send_sdu_len    = size;
     channel->send_sdu_pos    = 0;
 
+    l2cap_send_queue_add((l2cap_fixed_channel_t *) channel);
     l2cap_notify_channel_can_send();
     return ERROR_CODE_SUCCESS;
 }
@@ -4950,6 +5352,28 @@ static uint8_t l2cap_credit_based_provide_credits(uint16_t local_cid, uint16_t c
     return ERROR_CODE_SUCCESS;
 }
 
+static uint8_t l2cap_credit_based_set_throughput_mode(uint16_t local_cid, bool enabled){
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) {
+        return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    }
+    channel->throughput_mode = enabled;
+    return ERROR_CODE_SUCCESS;
+}
+
+static uint8_t l2cap_credit_based_set_receive_buffer(uint16_t local_cid, uint8_t * receive_sdu_buffer){
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) {
+        return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    }
+    // SDU reassembly in progress
+    if (channel->receive_sdu_len != 0u){
+        return ERROR_CODE_COMMAND_DISALLOWED;
+    }
+    channel->receive_sdu_buffer = receive_sdu_buffer;
+    return ERROR_CODE_SUCCESS;
+}
+
 static void l2cap_credit_based_send_credits(l2cap_channel_t *channel) {
     log_info("l2cap: sending %u credits", channel->new_credits_incoming);
     channel->local_sig_id = l2cap_next_sig_id();
@@ -4986,6 +5410,38 @@ static bool l2cap_credit_based_handle_credit_indication(hci_con_handle_t handle,
     return true;
 }
 
+static uint16_t l2cap_credit_based_automatic_credits_initial_window(l2cap_channel_t * channel){
+    // K-frames for NUM_SDUS SDUs of local MTU with our MPS
+    uint16_t local_mps = btstack_min(l2cap_max_le_mtu(), channel->local_mtu);
+    uint32_t num_pdus_per_sdu = (channel->local_mtu + 2u + local_mps - 1u) / local_mps;
+    uint32_t window = num_pdus_per_sdu * L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_NUM_SDUS;
+    window = btstack_max(window, L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_MIN);
+    window = btstack_min(window, L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_MAX);
+    return (uint16_t) window;
+}
+
+static void l2cap_credit_based_automatic_credits(l2cap_channel_t * channel){
+    if (channel->automatic_credits_window == 0u){
+        channel->automatic_credits_window = l2cap_credit_based_automatic_credits_initial_window(channel);
+        channel->automatic_credits_refill_ms = btstack_run_loop_get_time_ms();
+    }
+
+    // refill if remote used half of the window
+    uint32_t credits_remote = channel->credits_incoming + channel->new_credits_incoming;
+    if (credits_remote >= (channel->automatic_credits_window / 2u)) return;
+
+    // grow window if remote used it up within interval, as remote is likely to wait for credits
+    uint32_t now = btstack_run_loop_get_time_ms();
+    if ((now - channel->automatic_credits_refill_ms) < L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_INTERVAL_MS){
+        uint32_t window = channel->automatic_credits_window * 2u;
+        channel->automatic_credits_window = (uint16_t) btstack_min(window, L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_MAX);
+    }
+    channel->automatic_credits_refill_ms = now;
+    channel->new_credits_incoming = (uint16_t) (channel->automatic_credits_window - channel->credits_incoming);
+    log_debug("automatic credits for 0x%02x: window %u, new credits %u", channel->local_cid,
+              channel->automatic_credits_window, channel->new_credits_incoming);
+}
+
 static void l2cap_credit_based_handle_pdu(l2cap_channel_t * l2cap_channel, const uint8_t * packet, uint16_t size){
     // ignore empty packets
     if (size == COMPLETE_L2CAP_HEADER) return;
@@ -4999,8 +5455,8 @@ static void l2cap_credit_based_handle_pdu(l2cap_channel_t * l2cap_channel, const
     l2cap_channel->credits_incoming--;
 
     // automatic credits
-    if ((l2cap_channel->credits_incoming < L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_WATERMARK) && l2cap_channel->automatic_credits){
-        l2cap_channel->new_credits_incoming = L2CAP_CREDIT_BASED_FLOW_CONTROL_MODE_AUTOMATIC_CREDITS_INCREMENT;
+    if (l2cap_channel->automatic_credits){
+        l2cap_credit_based_automatic_credits(l2cap_channel);
     }
 
     // first fragment
@@ -5024,14 +5480,18 @@ static void l2cap_credit_based_handle_pdu(l2cap_channel_t * l2cap_channel, const
     // done?
     log_debug("le packet pos %u, len %u", l2cap_channel->receive_sdu_pos, l2cap_channel->receive_sdu_len);
     if (l2cap_channel->receive_sdu_pos >= l2cap_channel->receive_sdu_len){
-        l2cap_dispatch_to_channel(l2cap_channel, L2CAP_DATA_PACKET, l2cap_channel->receive_sdu_buffer, l2cap_channel->receive_sdu_len);
+        // reset before dispatch to allow to set receive buffer for next SDU in packet handler
+        uint16_t sdu_len = l2cap_channel->receive_sdu_len;
         l2cap_channel->receive_sdu_len = 0;
+        l2cap_dispatch_to_channel(l2cap_channel, L2CAP_DATA_PACKET, l2cap_channel->receive_sdu_buffer, sdu_len);
     }
 }
 
 static void l2cap_credit_based_notify_channel_can_send(l2cap_channel_t *channel){
     if (!channel->waiting_for_can_send_now) return;
     if (channel->send_sdu_buffer) return;
+    // channel is closing, l2cap_can_send_packet_now returns false
+    if (channel->state != L2CAP_STATE_OPEN) return;
     channel->waiting_for_can_send_now = 0;
     log_debug("le can send now, local_cid 0x%x", channel->local_cid);
     l2cap_emit_simple_event_with_cid(channel, L2CAP_EVENT_CAN_SEND_NOW);
@@ -5270,6 +5730,14 @@ uint8_t l2cap_cbm_create_channel(btstack_packet_handler_t packet_handler, hci_co
 uint8_t l2cap_cbm_provide_credits(uint16_t local_cid, uint16_t credits){
     return l2cap_credit_based_provide_credits(local_cid, credits);
 }
+
+uint8_t l2cap_cbm_set_throughput_mode(uint16_t local_cid, bool enabled){
+    return l2cap_credit_based_set_throughput_mode(local_cid, enabled);
+}
+
+uint8_t l2cap_cbm_set_receive_buffer(uint16_t local_cid, uint8_t * receive_sdu_buffer){
+    return l2cap_credit_based_set_receive_buffer(local_cid, receive_sdu_buffer);
+}
 #endif
 
 #ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
@@ -5496,6 +5964,14 @@ uint8_t l2cap_ecbm_reconfigure_channels(uint8_t num_cids, uint16_t * local_cids,
 uint8_t l2cap_ecbm_provide_credits(uint16_t local_cid, uint16_t credits){
     return l2cap_credit_based_provide_credits(local_cid, credits);
 }
+
+uint8_t l2cap_ecbm_set_throughput_mode(uint16_t local_cid, bool enabled){
+    return l2cap_credit_based_set_throughput_mode(local_cid, enabled);
+}
+
+uint8_t l2cap_ecbm_set_receive_buffer(uint16_t local_cid, uint8_t * receive_sdu_buffer){
+    return l2cap_credit_based_set_receive_buffer(local_cid, receive_sdu_buffer);
+}
 #endif
 
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
@@ -179,6 +179,10 @@ typedef struct {
     // Frame Check Sequence (FCS) Option
     uint8_t fcs_option;
 
+    // Max PDU payload Size (MPS) for rx and tx buffers, from L2CAP_MINIMAL_MTU up to HCI ACL payload minus ERTM overhead
+    // 0 or out of range: MPS is derived from available buffer space
+    uint16_t mps;
+
 } l2cap_ertm_config_t;
 
 // info regarding an actual channel
@@ -200,11 +204,15 @@ typedef struct l2cap_fixed_channel {
     // send request
     uint8_t waiting_for_can_send_now;
 
+    // queue of channels waiting to send per link type
+    struct l2cap_fixed_channel * next_waiting_to_send;
+    uint8_t queued_to_send;
+
     // -- end of shared prefix
 
 } l2cap_fixed_channel_t;
 
-typedef struct {
+typedef struct l2cap_channel {
     // linked list - assert: first field
     btstack_linked_item_t    item;
     
@@ -220,6 +228,10 @@ typedef struct {
     // send request
     uint8_t   waiting_for_can_send_now;
 
+    // queue of channels waiting to send per link type
+    struct l2cap_fixed_channel * next_waiting_to_send;
+    uint8_t   queued_to_send;
+
     // -- end of shared prefix
 
     // timer
@@ -238,7 +250,11 @@ typedef struct {
     uint8_t   local_sig_id;     // own signaling identifier
     
     uint16_t  remote_cid;
-    
+
+    // channel lookup by local cid and by con handle + remote cid
+    struct l2cap_channel * next_for_local_cid;
+    struct l2cap_channel * next_for_remote_cid;
+
     uint16_t  local_mtu;
     uint16_t  remote_mtu;
 
@@ -284,6 +300,13 @@ typedef struct {
     // automatic credits incoming
     bool automatic_credits;
 
+    // automatic credits: credits provided per refill and time of last refill
+    uint16_t automatic_credits_window;
+    uint32_t automatic_credits_refill_ms;
+
+    // send all K-frames of an SDU in one pass
+    bool throughput_mode;
+
 #ifdef ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
     uint8_t cid_index;
     uint8_t num_cids;
@@ -303,6 +326,9 @@ typedef struct {
     // monitor timer
     btstack_timer_source_t monitor_timer;
 
+    // acknowledgement timer
+    btstack_timer_source_t ack_timer;
+
     // local/remote config options
     uint16_t local_retransmission_timeout_ms;
     uint16_t local_monitor_timeout_ms;
@@ -361,6 +387,12 @@ typedef struct {
     // receiver: local busy condition
     uint8_t local_busy;
 
+    // receiver: number of in-sequence I-Frames received since last acknowledgement
+    uint8_t num_received_frames_unacked;
+
+    // receiver: send RR after this number of I-Frames, or when ack timer expires
+    uint8_t ack_threshold;
+
     // receiver: send RR frame with optional final flag set - flag
     uint8_t send_supervisor_frame_receiver_ready;
 
@@ -376,6 +408,9 @@ typedef struct {
     // receiver: send SREJ frame - flag
     uint8_t send_supervisor_frame_selective_reject;
 
+    // receiver: REJ or SREJ sent, ignore further unexpected I-Frames until expected I-Frame is received
+    uint8_t retransmission_requested;
+
     // set final bit after poll packet with poll bit was received
     uint8_t set_final_bit_after_packet_with_poll_bit_set;
 
@@ -397,7 +432,7 @@ typedef struct {
     // receiver: num_rx_buffers of size local_mps
     uint8_t * rx_packets_data;
 
-    // sender: num_tx_buffers of size local_mps
+    // sender: num_tx_buffers of size remote_mps
     uint8_t * tx_packets_data;
 
 #endif    
@@ -587,6 +622,15 @@ uint8_t l2cap_send_prepared(uint16_t local_cid, uint16_t len);
  */
 void l2cap_release_packet_buffer(void);
 
+/**
+ * @brief Get statistics for can send now handling
+ * @note Channels waiting to send are queued per link type and checked in round-robin order when buffers become
+ *       available. A wakeup is counted for each channel check, a send for each channel that could send.
+ * @param num_wakeups
+ * @param num_sends
+ */
+void l2cap_get_can_send_now_statistics(uint32_t * num_wakeups, uint32_t * num_sends);
+
 //
 // Connection-Oriented Channels in Enhanced Retransmission Mode - ERTM
 //
@@ -639,6 +683,26 @@ uint8_t l2cap_ertm_set_busy(uint16_t local_cid);
  */
 uint8_t l2cap_ertm_set_ready(uint16_t local_cid);
 
+/**
+ * @brief ERTM Get buffer size required for configuration
+ * @note if ertm_config->mps is 0 or out of range, buffers for the max MPS supported by the Controller are used
+ * @param ertm_config
+ * @return size in bytes for l2cap_ertm_create_channel and l2cap_ertm_accept_connection
+ */
+uint32_t l2cap_ertm_get_buffer_size(const l2cap_ertm_config_t * ertm_config);
+
+/**
+ * @brief ERTM Configure buffers for bulk transfers
+ * @note Uses MPS that fits into a single ACL packet of the Controller and as many tx/rx buffers as
+ *       needed to keep all Controller ACL buffers busy. ertm_mandatory, max_transmit, timeouts and
+ *       fcs_option are not modified.
+ * @param ertm_config
+ * @param local_mtu
+ * @param size of buffer provided to l2cap_ertm_create_channel or l2cap_ertm_accept_connection
+ * @return mps, or 0 if buffer is too small
+ */
+uint16_t l2cap_ertm_config_for_throughput(l2cap_ertm_config_t * ertm_config, uint16_t local_mtu, uint32_t size);
+
 
 //
 // L2CAP Connection-Oriented Channels in LE Credit-Based Flow-Control Mode - CBM
@@ -700,6 +764,24 @@ uint8_t l2cap_cbm_create_channel(btstack_packet_handler_t packet_handler, hci_co
  */
 uint8_t l2cap_cbm_provide_credits(uint16_t local_cid, uint16_t credits);
 
+/**
+ * @brief Enable throughput mode for channel in LE Credit-Based Flow-Control Mode
+ * @note In throughput mode, all K-frames of an SDU are sent in one pass as long as credits and Controller buffers are available
+ * @param local_cid             L2CAP Channel Identifier
+ * @param enabled
+ * @return status
+ */
+uint8_t l2cap_cbm_set_throughput_mode(uint16_t local_cid, bool enabled);
+
+/**
+ * @brief Set buffer for next incoming SDU for channel in LE Credit-Based Flow-Control Mode
+ * @note Can be called from the L2CAP_DATA_PACKET handler to receive the next SDU directly into application memory
+ * @param local_cid             L2CAP Channel Identifier
+ * @param receive_sdu_buffer    buffer of size MTU
+ * @return status
+ */
+uint8_t l2cap_cbm_set_receive_buffer(uint16_t local_cid, uint8_t * receive_sdu_buffer);
+
 //
 // L2CAP Connection-Oriented Channels in Enhanced Credit-Based Flow-Control Mode - ECBM
 //
@@ -783,6 +865,24 @@ uint8_t l2cap_ecbm_decline_channels(uint16_t local_cid, uint16_t result);
  */
 uint8_t l2cap_ecbm_provide_credits(uint16_t local_cid, uint16_t credits);
 
+/**
+ * @brief Enable throughput mode for channel in Enhanced Credit-Based Flow-Control Mode
+ * @note In throughput mode, all K-frames of an SDU are sent in one pass as long as credits and Controller buffers are available
+ * @param local_cid             L2CAP Channel Identifier
+ * @param enabled
+ * @return status
+ */
+uint8_t l2cap_ecbm_set_throughput_mode(uint16_t local_cid, bool enabled);
+
+/**
+ * @brief Set buffer for next incoming SDU for channel in Enhanced Credit-Based Flow-Control Mode
+ * @note Can be called from the L2CAP_DATA_PACKET handler to receive the next SDU directly into application memory
+ * @param local_cid             L2CAP Channel Identifier
+ * @param receive_sdu_buffer    buffer of size MTU
+ * @return status
+ */
+uint8_t l2cap_ecbm_set_receive_buffer(uint16_t local_cid, uint8_t * receive_sdu_buffer);
+
 /**
  * @brief Request emission of L2CAP_EVENT_ECBM_CAN_SEND_NOW as soon as possible
  * @note L2CAP_EVENT_ECBM_CAN_SEND_NOW might be emitted during call to this function
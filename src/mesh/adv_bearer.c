@@ -52,6 +52,12 @@
 #include "btstack_event.h"
 #include "gap.h"
 
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+#if !defined(ENABLE_LE_EXTENDED_ADVERTISING) || !defined(ENABLE_LE_PERIPHERAL)
+#error "ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING requires ENABLE_LE_EXTENDED_ADVERTISING and ENABLE_LE_PERIPHERAL"
+#endif
+#endif
+
 // issue: gap adv control in hci might be slow to update advertisements fast enough. for now add 10 ms extra to ADVERTISING_INTERVAL_CONNECTABLE_MIN_MS
 // todo: track adv enable/disable events before next step
 
@@ -63,6 +69,26 @@
 #define ADVERTISING_INTERVAL_NONCONNECTABLE_MIN 0xa0
 #define ADVERTISING_INTERVAL_NONCONNECTABLE_MIN_MS (ADVERTISING_INTERVAL_NONCONNECTABLE_MIN * 625 / 1000)
 
+// min advertising interval 20 ms for non-connectable advertisements with extended advertising commands
+#define ADVERTISING_INTERVAL_EXTENDED_NONCONNECTABLE_MIN_MS 20
+
+// number of adv bearer messages that can be queued
+#ifndef MESH_ADV_BEARER_QUEUE_SIZE
+#define MESH_ADV_BEARER_QUEUE_SIZE 4
+#endif
+
+// number of advertising sets used to send adv bearer messages in parallel
+#ifndef MESH_ADV_BEARER_NUM_ADVERTISING_SETS
+#define MESH_ADV_BEARER_NUM_ADVERTISING_SETS 2
+#endif
+
+// legacy advertising pdu types for extended advertising commands
+#define ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_IND           0x13
+#define ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_DIRECT_IND_LOW 0x15
+#define ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_DIRECT_IND    0x1d
+#define ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_SCAN_IND      0x12
+#define ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_NONCONN_IND   0x10
+
 // num adv bearer message types
 #define NUM_TYPES 3
 
@@ -79,9 +105,32 @@ typedef enum {
     STATE_GAP,
 } state_t;
 
+typedef struct {
+    uint8_t  data[31];
+    uint8_t  data_len;
+    uint8_t  count;
+    uint16_t interval_ms;
+} adv_bearer_message_t;
+
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+typedef struct {
+    le_advertising_set_t advertising_set;
+    uint8_t  advertising_handle;
+    bool     installed;
+    bool     active;
+    uint16_t interval_ms;
+    // adv data needs to stay valid until sent to controller
+    adv_bearer_message_t message;
+} adv_bearer_advertising_set_t;
+#endif
 
 // prototypes
 static void adv_bearer_run(void);
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+static void adv_bearer_extended_setup(void);
+static void adv_bearer_extended_handle_set_installed(uint8_t advertising_handle, uint8_t status);
+static void adv_bearer_extended_handle_set_terminated(uint8_t advertising_handle);
+#endif
 
 // globals
 
@@ -98,11 +147,10 @@ static int last_sender;
 static state_t    adv_bearer_state;
 static uint32_t   gap_adv_next_ms;
 
-// adv bearer packets
-static uint8_t   adv_bearer_buffer[31];
-static uint8_t   adv_bearer_buffer_length;
-static uint8_t   adv_bearer_count;
-static uint16_t  adv_bearer_interval;
+// adv bearer message queue
+static adv_bearer_message_t adv_bearer_queue[MESH_ADV_BEARER_QUEUE_SIZE];
+static uint8_t   adv_bearer_queue_head;
+static uint8_t   adv_bearer_queue_len;
 
 // gap advertising
 static int       gap_advertising_enabled;
@@ -117,6 +165,19 @@ static uint8_t   gap_filter_policy  = 0;
 
 static btstack_linked_list_t gap_connectable_advertisements;
 
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+// adv bearer messages are sent via dedicated advertising sets once installed
+static adv_bearer_advertising_set_t adv_bearer_advertising_sets[MESH_ADV_BEARER_NUM_ADVERTISING_SETS];
+static uint8_t   adv_bearer_advertising_sets_installed;
+
+// connectable advertisements use their own advertising set
+static adv_bearer_advertising_set_t gap_advertising_set;
+static bool      gap_advertising_set_params_changed;
+static btstack_timer_source_t gap_advertising_timer;
+static bool      gap_advertising_timer_active;
+static adv_bearer_connectable_advertisement_data_item_t * gap_advertising_current_item;
+#endif
+
 // dispatch advertising events
 static void adv_bearer_packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
     const uint8_t * data;
@@ -128,8 +189,22 @@ static void adv_bearer_packet_handler (uint8_t packet_type, uint16_t channel, ui
             switch(packet[0]){
                 case BTSTACK_EVENT_STATE:
                     if (btstack_event_state_get_state(packet) != HCI_STATE_WORKING) break;
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+                    adv_bearer_extended_setup();
+#endif
                     adv_bearer_run();
                     break;
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+                case HCI_EVENT_META_GAP:
+                    if (hci_event_gap_meta_get_subevent_code(packet) != GAP_SUBEVENT_ADVERTISING_SET_INSTALLED) break;
+                    adv_bearer_extended_handle_set_installed(gap_subevent_advertising_set_installed_get_advertisement_handle(packet),
+                                                             gap_subevent_advertising_set_installed_get_status(packet));
+                    break;
+                case HCI_EVENT_LE_META:
+                    if (hci_event_le_meta_get_subevent_code(packet) != HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED) break;
+                    adv_bearer_extended_handle_set_terminated(hci_subevent_le_advertising_set_terminated_get_advertising_handle(packet));
+                    break;
+#endif
                 case GAP_EVENT_ADVERTISING_REPORT:
                     // only non-connectable ind
                     if (gap_event_advertising_report_get_advertising_event_type(packet) != 0x03) break;
@@ -174,10 +249,34 @@ static void adv_bearer_packet_handler (uint8_t packet_type, uint16_t channel, ui
     }
 }
 
+// message queue
+static adv_bearer_message_t * adv_bearer_queue_peek(void){
+    if (adv_bearer_queue_len == 0) return NULL;
+    return &adv_bearer_queue[adv_bearer_queue_head];
+}
+
+static void adv_bearer_queue_pop(void){
+    adv_bearer_queue_head++;
+    if (adv_bearer_queue_head == MESH_ADV_BEARER_QUEUE_SIZE){
+        adv_bearer_queue_head = 0;
+    }
+    adv_bearer_queue_len--;
+}
+
+static adv_bearer_message_t * adv_bearer_queue_push(void){
+    if (adv_bearer_queue_len >= MESH_ADV_BEARER_QUEUE_SIZE) return NULL;
+    uint16_t index = adv_bearer_queue_head + adv_bearer_queue_len;
+    if (index >= MESH_ADV_BEARER_QUEUE_SIZE){
+        index -= MESH_ADV_BEARER_QUEUE_SIZE;
+    }
+    adv_bearer_queue_len++;
+    return &adv_bearer_queue[index];
+}
+
 // round-robin
 static void adv_bearer_emit_can_send_now(void){
 
-    if (adv_bearer_count > 0) return;
+    if (adv_bearer_queue_len >= MESH_ADV_BEARER_QUEUE_SIZE) return;
 
     int countdown = NUM_TYPES;
     while (countdown--) {
@@ -199,10 +298,231 @@ static void adv_bearer_emit_can_send_now(void){
     }
 }
 
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+
+static uint16_t adv_bearer_advertising_interval_for_ms(uint16_t interval_ms){
+    return (uint16_t) ((((uint32_t) interval_ms) * 1000u) / 625u);
+}
+
+static uint16_t adv_bearer_advertising_event_properties_for_adv_type(uint8_t adv_type){
+    switch (adv_type){
+        case 1:
+            return ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_DIRECT_IND;
+        case 2:
+            return ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_SCAN_IND;
+        case 3:
+            return ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_NONCONN_IND;
+        case 4:
+            return ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_DIRECT_IND_LOW;
+        default:
+            return ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_IND;
+    }
+}
+
+static void adv_bearer_extended_setup_parameters(le_extended_advertising_parameters_t * params, uint16_t event_properties,
+                                                 uint16_t interval_min, uint16_t interval_max, uint8_t channel_map){
+    uint8_t own_address_type;
+    bd_addr_t own_address;
+    // use own address type configured via gap_random_address_set_mode
+    gap_le_get_own_address(&own_address_type, own_address);
+    memset(params, 0, sizeof(le_extended_advertising_parameters_t));
+    params->advertising_event_properties = event_properties;
+    params->primary_advertising_interval_min = interval_min;
+    params->primary_advertising_interval_max = interval_max;
+    params->primary_advertising_channel_map = channel_map;
+    params->own_address_type = (bd_addr_type_t) own_address_type;
+    params->advertising_tx_power = 127;
+    params->primary_advertising_phy = 1;
+    params->secondary_advertising_phy = 1;
+}
+
+static void adv_bearer_extended_setup_gap_parameters(le_extended_advertising_parameters_t * params){
+    adv_bearer_extended_setup_parameters(params, adv_bearer_advertising_event_properties_for_adv_type(gap_adv_type),
+                                         gap_adv_int_min, gap_adv_int_max, gap_channel_map);
+    params->peer_address_type = (bd_addr_type_t) gap_direct_address_typ;
+    (void)memcpy(params->peer_address, gap_direct_address, 6);
+    params->advertising_filter_policy = gap_filter_policy;
+}
+
+static void adv_bearer_extended_setup(void){
+    le_extended_advertising_parameters_t params;
+    uint8_t i;
+    uint16_t interval = adv_bearer_advertising_interval_for_ms(ADVERTISING_INTERVAL_EXTENDED_NONCONNECTABLE_MIN_MS);
+    for (i=0;i<MESH_ADV_BEARER_NUM_ADVERTISING_SETS;i++){
+        adv_bearer_advertising_set_t * set = &adv_bearer_advertising_sets[i];
+        if (set->advertising_handle != 0) continue;
+        adv_bearer_extended_setup_parameters(&params, ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_NONCONN_IND, interval, interval, 0x07);
+        set->interval_ms = ADVERTISING_INTERVAL_EXTENDED_NONCONNECTABLE_MIN_MS;
+        uint8_t status = gap_extended_advertising_setup(&set->advertising_set, &params, &set->advertising_handle);
+        if (status != ERROR_CODE_SUCCESS){
+            log_info("cannot setup advertising set for adv bearer, status 0x%02x", status);
+            set->advertising_handle = 0;
+            return;
+        }
+    }
+    if (gap_advertising_set.advertising_handle == 0){
+        adv_bearer_extended_setup_gap_parameters(&params);
+        uint8_t status = gap_extended_advertising_setup(&gap_advertising_set.advertising_set, &params, &gap_advertising_set.advertising_handle);
+        if (status != ERROR_CODE_SUCCESS){
+            log_info("cannot setup advertising set for connectable advertisements, status 0x%02x", status);
+            gap_advertising_set.advertising_handle = 0;
+        }
+    }
+}
+
+static adv_bearer_advertising_set_t * adv_bearer_extended_set_for_handle(uint8_t advertising_handle){
+    if (advertising_handle == 0) return NULL;
+    uint8_t i;
+    for (i=0;i<MESH_ADV_BEARER_NUM_ADVERTISING_SETS;i++){
+        if (adv_bearer_advertising_sets[i].advertising_handle == advertising_handle){
+            return &adv_bearer_advertising_sets[i];
+        }
+    }
+    if (gap_advertising_set.advertising_handle == advertising_handle){
+        return &gap_advertising_set;
+    }
+    return NULL;
+}
+
+static void adv_bearer_extended_handle_set_installed(uint8_t advertising_handle, uint8_t status){
+    adv_bearer_advertising_set_t * set = adv_bearer_extended_set_for_handle(advertising_handle);
+    if (set == NULL) return;
+    if (status != ERROR_CODE_SUCCESS){
+        log_info("advertising set %u not installed, status 0x%02x", advertising_handle, status);
+        return;
+    }
+    set->installed = true;
+    if (set != &gap_advertising_set){
+        adv_bearer_advertising_sets_installed++;
+    }
+    adv_bearer_run();
+}
+
+static void adv_bearer_extended_handle_set_terminated(uint8_t advertising_handle){
+    adv_bearer_advertising_set_t * set = adv_bearer_extended_set_for_handle(advertising_handle);
+    if (set == NULL) return;
+    set->active = false;
+    if (set == &gap_advertising_set){
+        // stopped on connection, restart if still enabled
+        log_debug("connectable advertising set terminated");
+    } else {
+        log_debug("adv bearer message sent via set %u", advertising_handle);
+    }
+    adv_bearer_run();
+}
+
+static void adv_bearer_extended_gap_next_item(void){
+    adv_bearer_connectable_advertisement_data_item_t * item = (adv_bearer_connectable_advertisement_data_item_t *) btstack_linked_list_pop(&gap_connectable_advertisements);
+    if (item == NULL) return;
+    // queue again
+    btstack_linked_list_add_tail(&gap_connectable_advertisements, (void*) item);
+    if (item == gap_advertising_current_item) return;
+    gap_advertising_current_item = item;
+    log_debug("Update GAP ADV, %p", item);
+    gap_extended_advertising_set_adv_data(gap_advertising_set.advertising_handle, item->adv_length, item->adv_data);
+}
+
+static void adv_bearer_extended_gap_timeout_handler(btstack_timer_source_t * ts);
+
+static void adv_bearer_extended_gap_start_timer(void){
+    // rotate advertisements
+    if (btstack_linked_list_count(&gap_connectable_advertisements) < 2) return;
+    btstack_run_loop_set_timer_handler(&gap_advertising_timer, &adv_bearer_extended_gap_timeout_handler);
+    btstack_run_loop_set_timer(&gap_advertising_timer, btstack_max(gap_adv_int_ms, ADVERTISING_INTERVAL_CONNECTABLE_MIN_MS));
+    btstack_run_loop_add_timer(&gap_advertising_timer);
+    gap_advertising_timer_active = true;
+}
+
+static void adv_bearer_extended_gap_stop_timer(void){
+    if (gap_advertising_timer_active == false) return;
+    gap_advertising_timer_active = false;
+    btstack_run_loop_remove_timer(&gap_advertising_timer);
+}
+
+static void adv_bearer_extended_gap_timeout_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    gap_advertising_timer_active = false;
+    if (gap_advertising_set.active == false) return;
+    adv_bearer_extended_gap_next_item();
+    adv_bearer_extended_gap_start_timer();
+}
+
+static void adv_bearer_extended_run_gap(void){
+    if (gap_advertising_set.installed == false) return;
+
+    bool advertise = gap_advertising_enabled && (btstack_linked_list_empty(&gap_connectable_advertisements) == false);
+    if (advertise == false){
+        if (gap_advertising_set.active){
+            log_debug("Stop GAP ADV");
+            gap_advertising_set.active = false;
+            gap_advertising_current_item = NULL;
+            adv_bearer_extended_gap_stop_timer();
+            gap_extended_advertising_stop(gap_advertising_set.advertising_handle);
+        }
+        return;
+    }
+
+    if (gap_advertising_set_params_changed){
+        gap_advertising_set_params_changed = false;
+        le_extended_advertising_parameters_t params;
+        adv_bearer_extended_setup_gap_parameters(&params);
+        gap_extended_advertising_set_params(gap_advertising_set.advertising_handle, &params);
+    }
+
+    if (gap_advertising_set.active) return;
+
+    // start advertising, update data only when switching between items
+    log_debug("Start GAP ADV");
+    gap_advertising_current_item = NULL;
+    gap_advertising_set.active = true;
+    adv_bearer_extended_gap_next_item();
+    gap_extended_advertising_start(gap_advertising_set.advertising_handle, 0, 0);
+    adv_bearer_extended_gap_stop_timer();
+    adv_bearer_extended_gap_start_timer();
+}
+
+static void adv_bearer_extended_run_bearer(void){
+    bool message_sent = false;
+    uint8_t i;
+    for (i=0;i<MESH_ADV_BEARER_NUM_ADVERTISING_SETS;i++){
+        adv_bearer_advertising_set_t * set = &adv_bearer_advertising_sets[i];
+        if (set->installed == false) continue;
+        if (set->active) continue;
+
+        adv_bearer_message_t * message = adv_bearer_queue_peek();
+        if (message == NULL) break;
+        (void)memcpy(&set->message, message, sizeof(adv_bearer_message_t));
+        adv_bearer_queue_pop();
+
+        // only update params if interval changes
+        uint16_t interval_ms = btstack_max(set->message.interval_ms, ADVERTISING_INTERVAL_EXTENDED_NONCONNECTABLE_MIN_MS);
+        if (interval_ms != set->interval_ms){
+            le_extended_advertising_parameters_t params;
+            uint16_t interval = adv_bearer_advertising_interval_for_ms(interval_ms);
+            adv_bearer_extended_setup_parameters(&params, ADVERTISING_EVENT_PROPERTIES_LEGACY_ADV_NONCONN_IND, interval, interval, 0x07);
+            gap_extended_advertising_set_params(set->advertising_handle, &params);
+            set->interval_ms = interval_ms;
+        }
+
+        log_debug("Send ADV Bearer message via set %u, count %u", set->advertising_handle, set->message.count);
+        set->active = true;
+        gap_extended_advertising_set_adv_data(set->advertising_handle, set->message.data_len, set->message.data);
+        gap_extended_advertising_start(set->advertising_handle, 0, set->message.count);
+        message_sent = true;
+    }
+
+    // queue slot available
+    if (message_sent){
+        adv_bearer_emit_can_send_now();
+    }
+}
+#endif
+
 static void adv_bearer_timeout_handler(btstack_timer_source_t * ts){
     UNUSED(ts);
     adv_timer_active = 0;
     uint32_t now = btstack_run_loop_get_time_ms();
+    adv_bearer_message_t * message;
     switch (adv_bearer_state){
         case STATE_GAP:
             log_debug("Timeout (state gap)");
@@ -216,8 +536,10 @@ static void adv_bearer_timeout_handler(btstack_timer_source_t * ts){
         case STATE_BEARER:
             log_debug("Timeout (state bearer)");
             gap_advertisements_enable(0);
-            adv_bearer_count--;
-            if (adv_bearer_count == 0){
+            message = adv_bearer_queue_peek();
+            message->count--;
+            if (message->count == 0){
+                adv_bearer_queue_pop();
                 adv_bearer_emit_can_send_now();
             }
             adv_bearer_state = STATE_IDLE;
@@ -239,9 +561,25 @@ static void adv_bearer_set_timeout(uint32_t time_ms){
 static void adv_bearer_run(void){
 
     if (hci_get_state() != HCI_STATE_WORKING) return;
+
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+    // use advertising sets when installed and legacy advertising is done
+    if ((adv_bearer_advertising_sets_installed == MESH_ADV_BEARER_NUM_ADVERTISING_SETS) && gap_advertising_set.installed &&
+        (adv_bearer_state == STATE_IDLE)){
+        if (adv_timer_active){
+            adv_timer_active = 0;
+            btstack_run_loop_remove_timer(&adv_timer);
+        }
+        adv_bearer_extended_run_gap();
+        adv_bearer_extended_run_bearer();
+        return;
+    }
+#endif
+
     if (adv_timer_active) return;
     
     uint32_t now = btstack_run_loop_get_time_ms();
+    adv_bearer_message_t * message;
     switch (adv_bearer_state){
         case STATE_IDLE:
             if (gap_advertising_enabled){
@@ -264,13 +602,14 @@ static void adv_bearer_run(void){
                     }
                 }
             }
-            if (adv_bearer_count > 0){
+            message = adv_bearer_queue_peek();
+            if (message != NULL){
                 // schedule adv bearer message if enough time
                 // if ((gap_advertising_enabled) == 0 || ((int32_t)(gap_adv_next_ms - now) >= ADVERTISING_INTERVAL_NONCONNECTABLE_MIN_MS)){
                 log_debug("Send ADV Bearer message");
                 // configure LE advertisments: non-conn ind
                 gap_advertisements_set_params(ADVERTISING_INTERVAL_NONCONNECTABLE_MIN, ADVERTISING_INTERVAL_NONCONNECTABLE_MIN, 3, 0, null_addr, 0x07, 0);
-                gap_advertisements_set_data(adv_bearer_buffer_length, adv_bearer_buffer);
+                gap_advertisements_set_data(message->data_len, message->data);
                 gap_advertisements_enable(1);
                 adv_bearer_state = STATE_BEARER;
                 adv_bearer_set_timeout(ADVERTISING_INTERVAL_NONCONNECTABLE_MIN_MS);
@@ -289,17 +628,23 @@ static void adv_bearer_run(void){
 
 //
 static void adv_bearer_prepare_message(const uint8_t * data, uint16_t data_len, uint8_t type, uint8_t count, uint16_t interval){
-    btstack_assert(data_len <= (sizeof(adv_bearer_buffer)-2));
+    adv_bearer_message_t * message = adv_bearer_queue_push();
+    if (message == NULL){
+        // only send after MESH_SUBEVENT_CAN_SEND_NOW
+        log_error("adv bearer queue full, drop message type 0x%x", type);
+        return;
+    }
+    btstack_assert(data_len <= (sizeof(message->data)-2));
     log_debug("adv bearer message, type 0x%x\n", type);
     // prepare message
-    adv_bearer_buffer[0] = data_len+1;
-    adv_bearer_buffer[1] = type;
-    (void)memcpy(&adv_bearer_buffer[2], data, data_len);
-    adv_bearer_buffer_length = data_len + 2;
+    message->data[0] = data_len+1;
+    message->data[1] = type;
+    (void)memcpy(&message->data[2], data, data_len);
+    message->data_len = data_len + 2;
 
     // setup trasmission schedule
-    adv_bearer_count    = count;
-    adv_bearer_interval = interval;
+    message->count       = count;
+    message->interval_ms = interval;
 }
 
 //////
@@ -318,6 +663,29 @@ void adv_bearer_init(void){
     memset(null_addr, 0, 6);
 }
 
+void adv_bearer_deinit(void){
+    if (adv_timer_active){
+        btstack_run_loop_remove_timer(&adv_timer);
+    }
+    adv_timer_active = 0;
+    adv_bearer_state = STATE_IDLE;
+    adv_bearer_queue_head = 0;
+    adv_bearer_queue_len = 0;
+    last_sender = 0;
+    gap_advertising_enabled = 0;
+    gap_connectable_advertisements = NULL;
+    memset(client_callbacks, 0, sizeof(client_callbacks));
+    memset(request_can_send_now, 0, sizeof(request_can_send_now));
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+    adv_bearer_extended_gap_stop_timer();
+    memset(adv_bearer_advertising_sets, 0, sizeof(adv_bearer_advertising_sets));
+    memset(&gap_advertising_set, 0, sizeof(gap_advertising_set));
+    adv_bearer_advertising_sets_installed = 0;
+    gap_advertising_set_params_changed = false;
+    gap_advertising_current_item = NULL;
+#endif
+}
+
 // adv bearer packet handler regisration
 
 void adv_bearer_register_for_network_pdu(btstack_packet_handler_t packet_handler){
@@ -345,17 +713,14 @@ void adv_bearer_request_can_send_now_for_provisioning_pdu(void){
 // adv bearer send message
 
 void adv_bearer_send_network_pdu(const uint8_t * data, uint16_t data_len, uint8_t count, uint16_t interval){
-    btstack_assert(data_len <= (sizeof(adv_bearer_buffer)-2));
     adv_bearer_prepare_message(data, data_len, BLUETOOTH_DATA_TYPE_MESH_MESSAGE, count, interval);
     adv_bearer_run();
 }
 void adv_bearer_send_beacon(const uint8_t * data, uint16_t data_len){
-    btstack_assert(data_len <= (sizeof(adv_bearer_buffer)-2));
     adv_bearer_prepare_message(data, data_len, BLUETOOTH_DATA_TYPE_MESH_BEACON, 3, 100);
     adv_bearer_run();
 }
 void adv_bearer_send_provisioning_pdu(const uint8_t * data, uint16_t data_len){
-    btstack_assert(data_len <= (sizeof(adv_bearer_buffer)-2));
     adv_bearer_prepare_message(data, data_len, BLUETOOTH_DATA_TYPE_PB_ADV, 3, 100);
     adv_bearer_run();
 }
@@ -364,7 +729,14 @@ void adv_bearer_send_provisioning_pdu(const uint8_t * data, uint16_t data_len){
 
 void adv_bearer_advertisements_enable(int enabled){
     gap_advertising_enabled = enabled;
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+    if (!gap_advertising_enabled) {
+        adv_bearer_run();
+        return;
+    }
+#else
     if (!gap_advertising_enabled) return;
+#endif
 
     // start right away
     gap_adv_next_ms = btstack_run_loop_get_time_ms();
@@ -373,10 +745,25 @@ void adv_bearer_advertisements_enable(int enabled){
 
 void adv_bearer_advertisements_add_item(adv_bearer_connectable_advertisement_data_item_t * item){
     btstack_linked_list_add(&gap_connectable_advertisements, (void*) item);
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+    if (gap_advertising_set.active){
+        adv_bearer_extended_gap_stop_timer();
+        adv_bearer_extended_gap_start_timer();
+    }
+#endif
 }
 
 void adv_bearer_advertisements_remove_item(adv_bearer_connectable_advertisement_data_item_t * item){
     btstack_linked_list_remove(&gap_connectable_advertisements, (void*) item);
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+    if (item == gap_advertising_current_item){
+        gap_advertising_current_item = NULL;
+        if (gap_advertising_set.active){
+            adv_bearer_extended_gap_next_item();
+        }
+    }
+    adv_bearer_run();
+#endif
 }
 
 void adv_bearer_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int_max, uint8_t adv_type,
@@ -394,4 +781,9 @@ void adv_bearer_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int
     gap_filter_policy      = filter_policy; 
 
     log_info("GAP Adv interval %u ms", gap_adv_int_ms);
+
+#ifdef ENABLE_MESH_ADV_BEARER_EXTENDED_ADVERTISING
+    gap_advertising_set_params_changed = true;
+    adv_bearer_run();
+#endif
 }
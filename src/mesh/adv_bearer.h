@@ -59,6 +59,11 @@ typedef struct {
  */
 void adv_bearer_init(void);
 
+/**
+ * De-Initialize Advertising Bearer, e.g. for testing
+ */
+void adv_bearer_deinit(void);
+
 //
 // Mirror gap.h advertisement API for use with ADV Bearer
 //
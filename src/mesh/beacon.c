@@ -350,33 +350,39 @@ static void beacon_handle_beacon_packet(uint8_t packet_type, uint16_t channel, u
     }
 }
 
-static void beacon_adv_packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+// send a single beacon per can send now, request again if more are pending
+static void beacon_adv_handle_can_send_now(void){
+    bool beacon_sent = false;
+    if (beacon_send_device_beacon){
+        beacon_send_device_beacon = 0;
+        adv_bearer_send_beacon(mesh_beacon_data, mesh_beacon_len);
+        beacon_sent = true;
+    }
+    // secure beacon state machine
     mesh_subnet_iterator_t it;
+    mesh_subnet_iterator_init(&it);
+    while (mesh_subnet_iterator_has_more(&it)){
+        mesh_subnet_t * subnet = mesh_subnet_iterator_get_next(&it);
+        if (subnet->beacon_state != MESH_SECURE_NETWORK_BEACON_W2_SEND_ADV) continue;
+        if (beacon_sent){
+            adv_bearer_request_can_send_now_for_beacon();
+            return;
+        }
+        adv_bearer_send_beacon(mesh_beacon_data, mesh_beacon_len);
+        subnet->beacon_state = MESH_SECURE_NETWORK_BEACON_ADV_SENT;
+        beacon_sent = true;
+        mesh_secure_network_beacon_run(NULL);
+    }
+}
+
+static void beacon_adv_packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
     switch (packet_type){
         case HCI_EVENT_PACKET:
             switch(packet[0]){
                 case HCI_EVENT_MESH_META:
                     switch(packet[2]){
                         case MESH_SUBEVENT_CAN_SEND_NOW:
-                            if (beacon_send_device_beacon){
-                                beacon_send_device_beacon = 0;
-                                adv_bearer_send_beacon(mesh_beacon_data, mesh_beacon_len);
-                                break;
-                            }
-                            // secure beacon state machine
-                            mesh_subnet_iterator_init(&it);
-                            while (mesh_subnet_iterator_has_more(&it)){
-                                mesh_subnet_t * subnet = mesh_subnet_iterator_get_next(&it);
-                                switch (subnet->beacon_state){
-                                    case MESH_SECURE_NETWORK_BEACON_W2_SEND_ADV:
-                                        adv_bearer_send_beacon(mesh_beacon_data, mesh_beacon_len);
-                                        subnet->beacon_state = MESH_SECURE_NETWORK_BEACON_ADV_SENT;
-                                        mesh_secure_network_beacon_run(NULL);
-                                        break;
-                                    default:
-                                        break;
-                                }
-                            }
+                            beacon_adv_handle_can_send_now();
                             break;
                         default:
                             break;
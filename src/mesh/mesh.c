@@ -1067,6 +1067,7 @@ void mesh_node_reset(void){
     mesh_delete_virtual_addresses();
     mesh_delete_subscriptions();
     mesh_delete_publications();
+    mesh_seq_auth_delete();
     // also reset iv index + sequence number
     mesh_set_iv_index(0);
     mesh_sequence_number_set(0);
@@ -1138,6 +1139,9 @@ static int mesh_node_startup_from_tlv(void){
         // load model publications
         mesh_load_publications();
 
+        // load replay protection list
+        mesh_seq_auth_load();
+
 #if defined(ENABLE_MESH_ADV_BEARER) || defined(ENABLE_MESH_PB_ADV)
         // start sending Secure Network Beacon
         mesh_subnet_t * subnet = mesh_subnet_get_by_netkey_index(0);
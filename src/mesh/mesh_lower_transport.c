@@ -875,19 +875,19 @@ static void mesh_lower_transport_process_network_pdu(mesh_network_pdu_t *network
 void mesh_lower_transport_received_message(mesh_network_callback_type_t callback_type, mesh_network_pdu_t *network_pdu){
     mesh_peer_t * peer;
     uint16_t src;
-    uint16_t seq;
+    uint32_t seq;
+    uint32_t iv_index;
     switch (callback_type){
         case MESH_NETWORK_PDU_RECEIVED:
             src = mesh_network_src(network_pdu);
             seq = mesh_network_seq(network_pdu);
+            iv_index = mesh_network_iv_index(network_pdu);
             peer = mesh_peer_for_addr(src);
 #ifdef LOG_LOWER_TRANSPORT
-            printf("Transport: received message. SRC %x, SEQ %x\n", src, seq);
+            printf("Transport: received message. SRC %x, SEQ %x\n", src, (int) seq);
 #endif
-            // validate seq
-            if (peer && seq > peer->seq){
-                // track seq
-                peer->seq = seq;
+            // validate and track seq
+            if ((peer != NULL) && mesh_peer_validate_seq(peer, iv_index, seq)){
                 // process
                 mesh_lower_transport_process_network_pdu(network_pdu);
                 mesh_lower_transport_run();
@@ -1156,6 +1156,9 @@ uint32_t mesh_network_seq(mesh_network_pdu_t * network_pdu){
 uint16_t mesh_network_src(mesh_network_pdu_t * network_pdu){
     return big_endian_read_16(network_pdu->data, 5);
 }
+uint32_t mesh_network_iv_index(mesh_network_pdu_t * network_pdu){
+    return iv_index_for_pdu(network_pdu);
+}
 uint16_t mesh_network_dst(mesh_network_pdu_t * network_pdu){
     return big_endian_read_16(network_pdu->data, 7);
 }
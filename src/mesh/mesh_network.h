@@ -451,6 +451,7 @@ uint8_t   mesh_network_nid(mesh_network_pdu_t * network_pdu);
 uint8_t   mesh_network_ttl(mesh_network_pdu_t * network_pdu);
 uint32_t  mesh_network_seq(mesh_network_pdu_t * network_pdu);
 uint16_t  mesh_network_src(mesh_network_pdu_t * network_pdu);
+uint32_t  mesh_network_iv_index(mesh_network_pdu_t * network_pdu);
 uint16_t  mesh_network_dst(mesh_network_pdu_t * network_pdu);
 int       mesh_network_segmented(mesh_network_pdu_t * network_pdu);
 uint8_t   mesh_network_control_opcode(mesh_network_pdu_t * network_pdu);
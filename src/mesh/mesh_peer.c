@@ -35,42 +35,368 @@
  *
  */
 
+#define BTSTACK_FILE__ "mesh_peer.c"
+
 #include "mesh/mesh_peer.h"
 
+#include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "btstack_debug.h"
 #include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_tlv.h"
 #include "btstack_util.h"
 
 #include "mesh/beacon.h"
+#include "mesh/mesh_iv_index_seq_number.h"
 #include "mesh/mesh_upper_transport.h"
 
-#define MESH_NUM_PEERS 5
+// Replay Protection List
+//
+// Entries are found via hash buckets indexed by unicast address and kept in LRU order.
+// If the list is full, the least recently used entry that cannot be used to replay a message is replaced.
+// This is the case if its last IV index is older than the previous IV index, as the network layer only
+// accepts the current and the previous IV index. Entries with ongoing segmented reception are kept.
+// If no entry can be replaced, messages from new sources are dropped as required by the Mesh Profile.
+
+// max number of sources in replay protection list
+#ifndef MESH_REPLAY_PROTECTION_LIST_SIZE
+#define MESH_REPLAY_PROTECTION_LIST_SIZE 32
+#endif
+
+#if (MESH_REPLAY_PROTECTION_LIST_SIZE < 1) || (MESH_REPLAY_PROTECTION_LIST_SIZE > 0x7fff)
+#error "MESH_REPLAY_PROTECTION_LIST_SIZE must be between 1 and 32767"
+#endif
+
+// modified entries are stored in TLV after this timeout
+#ifndef MESH_REPLAY_PROTECTION_LIST_STORE_TIMEOUT_MS
+#define MESH_REPLAY_PROTECTION_LIST_STORE_TIMEOUT_MS 5000
+#endif
+
+#define MESH_PEER_INDEX_INVALID 0xffffu
+
+// entries are stored in groups to limit number of TLV tags
+#define MESH_PEER_ENTRIES_PER_TAG 8
+#define MESH_PEER_NUM_TAGS ((MESH_REPLAY_PROTECTION_LIST_SIZE + MESH_PEER_ENTRIES_PER_TAG - 1) / MESH_PEER_ENTRIES_PER_TAG)
+
+typedef struct {
+    uint32_t iv_index;
+    uint32_t seq;
+    uint32_t seq_auth;
+    uint16_t address;
+    uint16_t seq_zero;
+} mesh_persistent_peer_t;
+
+static mesh_peer_t mesh_peers[MESH_REPLAY_PROTECTION_LIST_SIZE];
+static uint16_t    mesh_peer_buckets[MESH_REPLAY_PROTECTION_LIST_SIZE];
+
+static uint16_t    mesh_peer_free_head;
+static uint16_t    mesh_peer_lru_head;
+static uint16_t    mesh_peer_lru_tail;
+static uint16_t    mesh_peer_num_entries;
+static bool        mesh_peer_list_initialized;
+
+// no entry can be replaced until IV index changes
+static bool        mesh_peer_replacement_blocked;
+static uint32_t    mesh_peer_replacement_blocked_iv_index;
 
-static mesh_peer_t mesh_peers[MESH_NUM_PEERS];
+// persistence
+static uint8_t     mesh_peer_dirty_tags[(MESH_PEER_NUM_TAGS + 7) / 8];
+static bool        mesh_peer_store_timer_active;
+static btstack_timer_source_t mesh_peer_store_timer;
+
+static uint32_t mesh_peer_tag_for_index(uint16_t tag_index){
+    return ((uint32_t) 'M' << 24) | ((uint32_t) 'R' << 16) | ((uint32_t) tag_index);
+}
+
+static uint16_t mesh_peer_bucket_for_addr(uint16_t address){
+    return address % MESH_REPLAY_PROTECTION_LIST_SIZE;
+}
+
+static void mesh_peer_store_timeout_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    mesh_peer_store_timer_active = false;
+    mesh_seq_auth_store();
+}
+
+static void mesh_peer_mark_dirty(uint16_t index){
+    uint16_t tag_index = index / MESH_PEER_ENTRIES_PER_TAG;
+    mesh_peer_dirty_tags[tag_index >> 3] |= 1u << (tag_index & 7u);
+    if (mesh_peer_store_timer_active) return;
+    mesh_peer_store_timer_active = true;
+    btstack_run_loop_set_timer(&mesh_peer_store_timer, MESH_REPLAY_PROTECTION_LIST_STORE_TIMEOUT_MS);
+    btstack_run_loop_set_timer_handler(&mesh_peer_store_timer, &mesh_peer_store_timeout_handler);
+    btstack_run_loop_add_timer(&mesh_peer_store_timer);
+}
+
+static void mesh_peer_lru_remove(uint16_t index){
+    mesh_peer_t * peer = &mesh_peers[index];
+    if (peer->lru_prev == MESH_PEER_INDEX_INVALID){
+        mesh_peer_lru_head = peer->lru_next;
+    } else {
+        mesh_peers[peer->lru_prev].lru_next = peer->lru_next;
+    }
+    if (peer->lru_next == MESH_PEER_INDEX_INVALID){
+        mesh_peer_lru_tail = peer->lru_prev;
+    } else {
+        mesh_peers[peer->lru_next].lru_prev = peer->lru_prev;
+    }
+}
+
+static void mesh_peer_lru_add_head(uint16_t index){
+    mesh_peer_t * peer = &mesh_peers[index];
+    peer->lru_prev = MESH_PEER_INDEX_INVALID;
+    peer->lru_next = mesh_peer_lru_head;
+    if (mesh_peer_lru_head == MESH_PEER_INDEX_INVALID){
+        mesh_peer_lru_tail = index;
+    } else {
+        mesh_peers[mesh_peer_lru_head].lru_prev = index;
+    }
+    mesh_peer_lru_head = index;
+}
+
+static void mesh_peer_hash_add(uint16_t index){
+    uint16_t bucket = mesh_peer_bucket_for_addr(mesh_peers[index].address);
+    mesh_peers[index].hash_next = mesh_peer_buckets[bucket];
+    mesh_peer_buckets[bucket] = index;
+}
+
+static void mesh_peer_hash_remove(uint16_t index){
+    uint16_t * link = &mesh_peer_buckets[mesh_peer_bucket_for_addr(mesh_peers[index].address)];
+    while (*link != index){
+        link = &mesh_peers[*link].hash_next;
+    }
+    *link = mesh_peers[index].hash_next;
+}
+
+static bool mesh_peer_replaceable(const mesh_peer_t * peer, uint32_t iv_index){
+    if (peer->message_pdu != NULL) return false;
+    // network layer does not accept IV index older than previous one
+    return (peer->iv_index + 1u) < iv_index;
+}
+
+static uint16_t mesh_peer_replace_lru(void){
+    uint32_t iv_index = mesh_get_iv_index();
+    if (mesh_peer_replacement_blocked && (mesh_peer_replacement_blocked_iv_index == iv_index)){
+        return MESH_PEER_INDEX_INVALID;
+    }
+    bool reception_ongoing = false;
+    uint16_t index = mesh_peer_lru_tail;
+    while (index != MESH_PEER_INDEX_INVALID){
+        mesh_peer_t * peer = &mesh_peers[index];
+        if (mesh_peer_replaceable(peer, iv_index)){
+            log_info("replace entry for %04x, iv index %08" PRIx32, peer->address, peer->iv_index);
+            mesh_peer_hash_remove(index);
+            mesh_peer_lru_remove(index);
+            return index;
+        }
+        if (peer->message_pdu != NULL){
+            reception_ongoing = true;
+        }
+        index = peer->lru_prev;
+    }
+    // entries only become replaceable on IV index change or when reception completes
+    if (reception_ongoing == false){
+        mesh_peer_replacement_blocked = true;
+        mesh_peer_replacement_blocked_iv_index = iv_index;
+    }
+    return MESH_PEER_INDEX_INVALID;
+}
+
+static void mesh_peer_list_init(void){
+    uint16_t i;
+    (void) memset(mesh_peers, 0, sizeof(mesh_peers));
+    for (i=0;i<MESH_REPLAY_PROTECTION_LIST_SIZE;i++){
+        mesh_peer_buckets[i] = MESH_PEER_INDEX_INVALID;
+        mesh_peers[i].hash_next = i + 1u;
+    }
+    mesh_peers[MESH_REPLAY_PROTECTION_LIST_SIZE - 1].hash_next = MESH_PEER_INDEX_INVALID;
+    mesh_peer_free_head = 0;
+    mesh_peer_lru_head = MESH_PEER_INDEX_INVALID;
+    mesh_peer_lru_tail = MESH_PEER_INDEX_INVALID;
+    mesh_peer_num_entries = 0;
+    mesh_peer_replacement_blocked = false;
+    mesh_peer_list_initialized = true;
+}
 
 void mesh_seq_auth_reset(void){
-    int i;
-    for(i=0;i<MESH_NUM_PEERS;i++){
-        memset(&mesh_peers[i], 0, sizeof(mesh_peer_t));
+    mesh_peer_list_init();
+    (void) memset(mesh_peer_dirty_tags, 0, sizeof(mesh_peer_dirty_tags));
+    if (mesh_peer_store_timer_active){
+        mesh_peer_store_timer_active = false;
+        btstack_run_loop_remove_timer(&mesh_peer_store_timer);
     }
 }
 
 mesh_peer_t * mesh_peer_for_addr(uint16_t address){
-    int i;
-    for (i=0;i<MESH_NUM_PEERS;i++){
-        if (mesh_peers[i].address == address){
-            return &mesh_peers[i];
+    if (mesh_peer_list_initialized == false){
+        mesh_peer_list_init();
+    }
+
+    uint16_t index = mesh_peer_buckets[mesh_peer_bucket_for_addr(address)];
+    while (index != MESH_PEER_INDEX_INVALID){
+        if (mesh_peers[index].address == address){
+            // move to front
+            if (index != mesh_peer_lru_head){
+                mesh_peer_lru_remove(index);
+                mesh_peer_lru_add_head(index);
+            }
+            return &mesh_peers[index];
+        }
+        index = mesh_peers[index].hash_next;
+    }
+
+    if (address == MESH_ADDRESS_UNSASSIGNED) return NULL;
+
+    // get free entry or replace least recently used one
+    index = mesh_peer_free_head;
+    if (index != MESH_PEER_INDEX_INVALID){
+        mesh_peer_free_head = mesh_peers[index].hash_next;
+        mesh_peer_num_entries++;
+    } else {
+        index = mesh_peer_replace_lru();
+        if (index == MESH_PEER_INDEX_INVALID){
+            log_info("replay protection list full, drop message from %04x", address);
+            return NULL;
+        }
+    }
+
+    mesh_peer_t * peer = &mesh_peers[index];
+    (void) memset(peer, 0, sizeof(mesh_peer_t));
+    peer->address = address;
+    mesh_peer_hash_add(index);
+    mesh_peer_lru_add_head(index);
+    mesh_peer_mark_dirty(index);
+    return peer;
+}
+
+int mesh_peer_validate_seq(mesh_peer_t * peer, uint32_t iv_index, uint32_t seq){
+    if (peer->seq_valid != 0){
+        if (iv_index < peer->iv_index) return 0;
+        if ((iv_index == peer->iv_index) && (seq <= peer->seq)) return 0;
+    }
+    if ((peer->seq_valid == 0) || (iv_index != peer->iv_index)){
+        // SeqAuth is relative to IV index
+        peer->seq_zero  = 0;
+        peer->seq_auth  = 0;
+        peer->block_ack = 0;
+    }
+    peer->iv_index  = iv_index;
+    peer->seq       = seq;
+    peer->seq_valid = 1;
+    mesh_peer_mark_dirty((uint16_t) (peer - mesh_peers));
+    return 1;
+}
+
+uint16_t mesh_peer_count(void){
+    return mesh_peer_num_entries;
+}
+
+void mesh_seq_auth_load(void){
+    const btstack_tlv_t * btstack_tlv_impl;
+    void * btstack_tlv_context;
+    mesh_persistent_peer_t data[MESH_PEER_ENTRIES_PER_TAG];
+
+    mesh_seq_auth_reset();
+
+    btstack_tlv_get_instance(&btstack_tlv_impl, &btstack_tlv_context);
+    if (btstack_tlv_impl == NULL) return;
+
+    uint16_t tag_index;
+    for (tag_index = 0; tag_index < MESH_PEER_NUM_TAGS; tag_index++){
+        int len = btstack_tlv_impl->get_tag(btstack_tlv_context, mesh_peer_tag_for_index(tag_index), (uint8_t *) data, sizeof(data));
+        if (len <= 0) continue;
+        // last tag may cover less entries than stored, e.g. after reducing MESH_REPLAY_PROTECTION_LIST_SIZE
+        uint16_t first_index = tag_index * MESH_PEER_ENTRIES_PER_TAG;
+        uint16_t num_entries = btstack_min(MESH_PEER_ENTRIES_PER_TAG, MESH_REPLAY_PROTECTION_LIST_SIZE - first_index);
+        num_entries = btstack_min(num_entries, (uint16_t) len / sizeof(mesh_persistent_peer_t));
+        uint16_t i;
+        for (i=0;i<num_entries;i++){
+            if ((data[i].address == MESH_ADDRESS_UNSASSIGNED) || (data[i].address >= 0x8000u)) continue;
+            // keep position to allow for partial updates
+            uint16_t index = first_index + i;
+            mesh_peer_t * peer = &mesh_peers[index];
+            peer->address   = data[i].address;
+            peer->iv_index  = data[i].iv_index;
+            peer->seq       = data[i].seq;
+            peer->seq_auth  = data[i].seq_auth;
+            peer->seq_zero  = data[i].seq_zero;
+            peer->seq_valid = 1;
         }
     }
-    for (i=0;i<MESH_NUM_PEERS;i++){
-        if (mesh_peers[i].address== MESH_ADDRESS_UNSASSIGNED){
-            memset(&mesh_peers[i], 0, sizeof(mesh_peer_t));
-            mesh_peers[i].address = address;
-            return &mesh_peers[i];
+
+    // setup free list, hash buckets and LRU list
+    mesh_peer_free_head = MESH_PEER_INDEX_INVALID;
+    uint16_t index = MESH_REPLAY_PROTECTION_LIST_SIZE;
+    while (index > 0){
+        index--;
+        if (mesh_peers[index].address == MESH_ADDRESS_UNSASSIGNED){
+            mesh_peers[index].hash_next = mesh_peer_free_head;
+            mesh_peer_free_head = index;
+        } else {
+            mesh_peer_hash_add(index);
+            mesh_peer_lru_add_head(index);
+            mesh_peer_num_entries++;
         }
     }
-    return NULL;
+    log_info("loaded %u replay protection list entries", mesh_peer_num_entries);
+}
+
+void mesh_seq_auth_store(void){
+    const btstack_tlv_t * btstack_tlv_impl;
+    void * btstack_tlv_context;
+    mesh_persistent_peer_t data[MESH_PEER_ENTRIES_PER_TAG];
+
+    btstack_tlv_get_instance(&btstack_tlv_impl, &btstack_tlv_context);
+
+    uint16_t tag_index;
+    for (tag_index = 0; tag_index < MESH_PEER_NUM_TAGS; tag_index++){
+        uint8_t mask = 1u << (tag_index & 7u);
+        if ((mesh_peer_dirty_tags[tag_index >> 3] & mask) == 0) continue;
+        mesh_peer_dirty_tags[tag_index >> 3] &= ~mask;
+        if (btstack_tlv_impl == NULL) continue;
+
+        uint16_t first_index = tag_index * MESH_PEER_ENTRIES_PER_TAG;
+        uint16_t num_entries = btstack_min(MESH_PEER_ENTRIES_PER_TAG, MESH_REPLAY_PROTECTION_LIST_SIZE - first_index);
+        uint16_t num_valid = 0;
+        uint16_t i;
+        (void) memset(data, 0, sizeof(data));
+        for (i=0;i<num_entries;i++){
+            const mesh_peer_t * peer = &mesh_peers[first_index + i];
+            if (peer->seq_valid == 0) continue;
+            data[i].address  = peer->address;
+            data[i].iv_index = peer->iv_index;
+            data[i].seq      = peer->seq;
+            data[i].seq_auth = peer->seq_auth;
+            data[i].seq_zero = peer->seq_zero;
+            num_valid++;
+        }
+        uint32_t tag = mesh_peer_tag_for_index(tag_index);
+        if (num_valid == 0){
+            btstack_tlv_impl->delete_tag(btstack_tlv_context, tag);
+        } else {
+            int result = btstack_tlv_impl->store_tag(btstack_tlv_context, tag, (uint8_t *) data, num_entries * sizeof(mesh_persistent_peer_t));
+            if (result != 0){
+                log_error("storing replay protection list failed");
+            }
+        }
+    }
+}
+
+void mesh_seq_auth_delete(void){
+    const btstack_tlv_t * btstack_tlv_impl;
+    void * btstack_tlv_context;
+
+    mesh_seq_auth_reset();
+
+    btstack_tlv_get_instance(&btstack_tlv_impl, &btstack_tlv_context);
+    if (btstack_tlv_impl == NULL) return;
+
+    uint16_t tag_index;
+    for (tag_index = 0; tag_index < MESH_PEER_NUM_TAGS; tag_index++){
+        btstack_tlv_impl->delete_tag(btstack_tlv_context, mesh_peer_tag_for_index(tag_index));
+    }
 }
@@ -38,6 +38,8 @@
 #ifndef __MESH_PEER_H
 #define __MESH_PEER_H
 
+#include "btstack_config.h"
+
 #include "mesh/mesh_network.h"
 
 #if defined __cplusplus
@@ -59,14 +61,38 @@ typedef struct {
     uint32_t seq_auth;
     // block ack
     uint32_t block_ack;
+
+    // IV index of last message
+    uint32_t iv_index;
+
+    // replay protection list internals
+    uint16_t hash_next;
+    uint16_t lru_prev;
+    uint16_t lru_next;
+    uint8_t  seq_valid;
 } mesh_peer_t;
 
-// get peer info for address
+// get peer info for address, adds new entry if needed. returns NULL if replay protection list is full
 mesh_peer_t * mesh_peer_for_addr(uint16_t address);
 
+// validate seq number of received network pdu against replay protection list and track it. returns 1 if valid
+int mesh_peer_validate_seq(mesh_peer_t * peer, uint32_t iv_index, uint32_t seq);
+
+// number of entries in replay protection list
+uint16_t mesh_peer_count(void);
+
 // reset seq auth == replay protection
 void mesh_seq_auth_reset(void);
 
+// load replay protection list from TLV
+void mesh_seq_auth_load(void);
+
+// store modified replay protection list entries in TLV, also done periodically
+void mesh_seq_auth_store(void);
+
+// reset replay protection list and delete it from TLV
+void mesh_seq_auth_delete(void);
+
 #if defined __cplusplus
 }
 #endif
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "a2dp_sink_jitter_buffer_test.cpp"
+
+// *****************************************************************************
+//
+// A2DP Sink Jitter Buffer Test: deterministic simulation of media packets
+// with jitter, packet loss and clock drift between source and playback
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth.h"
+#include "btstack_util.h"
+#include "classic/a2dp_sink_jitter_buffer.h"
+
+#define SAMPLE_RATE             44100
+#define NUM_CHANNELS            2
+#define SAMPLES_PER_FRAME       128
+#define FRAME_SIZE              16
+#define FRAMES_PER_PACKET       5
+#define PLAYBACK_BLOCK_SIZE     512
+#define MAX_FRAMES              120
+
+typedef struct {
+    bool     conceal;
+    uint32_t num_frames_decoded;
+    uint32_t num_frames_concealed;
+} test_codec_t;
+
+// fake codec: first byte of media frame is used as sample value
+static uint16_t test_decode(void * context, const uint8_t * frame, uint16_t frame_len, int16_t * pcm_buffer){
+    test_codec_t * codec = (test_codec_t *) context;
+    int16_t value;
+    if (frame == NULL){
+        if (codec->conceal == false) return 0;
+        codec->num_frames_concealed++;
+        value = -1;
+    } else {
+        CHECK_EQUAL(FRAME_SIZE, frame_len);
+        codec->num_frames_decoded++;
+        value = frame[0];
+    }
+    int i;
+    for (i = 0; i < SAMPLES_PER_FRAME * NUM_CHANNELS; i++){
+        pcm_buffer[i] = value;
+    }
+    return SAMPLES_PER_FRAME;
+}
+
+static uint32_t test_random_state;
+
+static uint32_t test_random(void){
+    test_random_state = test_random_state * 1664525u + 1013904223u;
+    return test_random_state >> 8;
+}
+
+typedef struct {
+    a2dp_sink_jitter_buffer_t jitter_buffer;
+    uint8_t      frame_storage[MAX_FRAMES * (FRAME_SIZE + 2)];
+    test_codec_t codec;
+    // simulation state
+    uint16_t     sequence_number;
+    uint8_t      frame_value;
+    uint64_t     next_send_us;
+    uint64_t     next_playback_us;
+    double       send_interval_us;
+    uint32_t     num_packets_sent;
+    uint32_t     num_playback_blocks;
+    uint64_t     last_arrival_us;
+    // results
+    uint16_t     level_min;
+    uint16_t     level_max;
+} test_stream_t;
+
+static void test_stream_init(test_stream_t * stream, double clock_skew){
+    memset(stream, 0, sizeof(test_stream_t));
+    uint8_t status = a2dp_sink_jitter_buffer_init(&stream->jitter_buffer, stream->frame_storage, sizeof(stream->frame_storage),
+                                                  SAMPLE_RATE, NUM_CHANNELS, SAMPLES_PER_FRAME, &test_decode, &stream->codec);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    // source clock runs faster for positive skew
+    stream->send_interval_us = (1000000.0 * FRAMES_PER_PACKET * SAMPLES_PER_FRAME) / (SAMPLE_RATE * (1.0 + clock_skew));
+    stream->level_min = 0xffff;
+}
+
+static void test_stream_send_packet(test_stream_t * stream, uint64_t now_us){
+    uint8_t frames[FRAMES_PER_PACKET * FRAME_SIZE];
+    int i;
+    for (i = 0; i < FRAMES_PER_PACKET; i++){
+        memset(&frames[i * FRAME_SIZE], stream->frame_value++, FRAME_SIZE);
+    }
+    uint8_t status = a2dp_sink_jitter_buffer_write_frames(&stream->jitter_buffer, (uint32_t) (now_us / 1000), stream->sequence_number++,
+                                                          frames, sizeof(frames), FRAMES_PER_PACKET);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+}
+
+// run simulation for duration, packets arrive in order with up to max_jitter_us delay, every loss_interval-th packet is lost
+static void test_stream_run(test_stream_t * stream, uint32_t duration_ms, uint32_t max_jitter_us, uint32_t loss_interval, uint32_t settle_ms){
+    const double playback_interval_us = (1000000.0 * PLAYBACK_BLOCK_SIZE) / SAMPLE_RATE;
+    int16_t  audio[PLAYBACK_BLOCK_SIZE * NUM_CHANNELS];
+    uint64_t end_us = stream->next_playback_us + (uint64_t) duration_ms * 1000;
+    uint64_t next_arrival_us = 0;
+    while (stream->next_playback_us < end_us){
+        if (next_arrival_us == 0){
+            uint64_t send_us = (uint64_t) (stream->num_packets_sent * stream->send_interval_us);
+            if (max_jitter_us > 0){
+                send_us += test_random() % max_jitter_us;
+            }
+            // in-order delivery
+            next_arrival_us = (send_us > stream->last_arrival_us) ? send_us : stream->last_arrival_us;
+        }
+        if (next_arrival_us <= stream->next_playback_us){
+            stream->num_packets_sent++;
+            stream->last_arrival_us = next_arrival_us;
+            if ((loss_interval != 0) && ((stream->num_packets_sent % loss_interval) == 0)){
+                // lost on air
+                stream->sequence_number++;
+                stream->frame_value += FRAMES_PER_PACKET;
+            } else {
+                test_stream_send_packet(stream, next_arrival_us);
+            }
+            next_arrival_us = 0;
+        } else {
+            a2dp_sink_jitter_buffer_read_audio(&stream->jitter_buffer, audio, PLAYBACK_BLOCK_SIZE);
+            stream->num_playback_blocks++;
+            stream->next_playback_us = (uint64_t) (stream->num_playback_blocks * playback_interval_us);
+            if (stream->next_playback_us >= (uint64_t) settle_ms * 1000){
+                uint16_t level = a2dp_sink_jitter_buffer_get_num_frames_buffered(&stream->jitter_buffer);
+                if (level < stream->level_min) stream->level_min = level;
+                if (level > stream->level_max) stream->level_max = level;
+            }
+        }
+    }
+}
+
+TEST_GROUP(A2DPSinkJitterBuffer){
+    test_stream_t stream;
+
+    void setup(void){
+        test_random_state = 0x12345678;
+    }
+};
+
+TEST(A2DPSinkJitterBuffer, InitInvalidParameters){
+    a2dp_sink_jitter_buffer_t * jitter_buffer = &stream.jitter_buffer;
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, a2dp_sink_jitter_buffer_init(jitter_buffer, stream.frame_storage, sizeof(stream.frame_storage),
+                                                                                        SAMPLE_RATE, 0, SAMPLES_PER_FRAME, &test_decode, NULL));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, a2dp_sink_jitter_buffer_init(jitter_buffer, stream.frame_storage, sizeof(stream.frame_storage),
+                                                                                        SAMPLE_RATE, 3, SAMPLES_PER_FRAME, &test_decode, NULL));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, a2dp_sink_jitter_buffer_init(jitter_buffer, stream.frame_storage, sizeof(stream.frame_storage),
+                                                                                        SAMPLE_RATE, NUM_CHANNELS, A2DP_SINK_JITTER_BUFFER_MAX_SAMPLES_PER_FRAME + 1, &test_decode, NULL));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, a2dp_sink_jitter_buffer_init(jitter_buffer, stream.frame_storage, sizeof(stream.frame_storage),
+                                                                                        0, NUM_CHANNELS, SAMPLES_PER_FRAME, &test_decode, NULL));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, a2dp_sink_jitter_buffer_init(jitter_buffer, stream.frame_storage, sizeof(stream.frame_storage),
+                                                                                        SAMPLE_RATE, NUM_CHANNELS, SAMPLES_PER_FRAME, NULL, NULL));
+}
+
+TEST(A2DPSinkJitterBuffer, WriteInvalidParameters){
+    test_stream_init(&stream, 0.0);
+    uint8_t frames[3 * FRAME_SIZE];
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, a2dp_sink_jitter_buffer_write_frames(&stream.jitter_buffer, 0, 0, frames, sizeof(frames), 0));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, a2dp_sink_jitter_buffer_write_frames(&stream.jitter_buffer, 0, 0, frames, sizeof(frames) - 1, 3));
+    CHECK_EQUAL(0, a2dp_sink_jitter_buffer_get_num_frames_buffered(&stream.jitter_buffer));
+}
+
+TEST(A2DPSinkJitterBuffer, SilenceUntilStarted){
+    test_stream_init(&stream, 0.0);
+    int16_t audio[PLAYBACK_BLOCK_SIZE * NUM_CHANNELS];
+    test_stream_send_packet(&stream, 0);
+    CHECK_FALSE(a2dp_sink_jitter_buffer_is_playing(&stream.jitter_buffer));
+    memset(audio, 0x55, sizeof(audio));
+    a2dp_sink_jitter_buffer_read_audio(&stream.jitter_buffer, audio, PLAYBACK_BLOCK_SIZE);
+    int i;
+    for (i = 0; i < PLAYBACK_BLOCK_SIZE * NUM_CHANNELS; i++){
+        CHECK_EQUAL(0, audio[i]);
+    }
+    CHECK_EQUAL(0, stream.codec.num_frames_decoded);
+    CHECK_EQUAL(FRAMES_PER_PACKET, a2dp_sink_jitter_buffer_get_num_frames_buffered(&stream.jitter_buffer));
+}
+
+TEST(A2DPSinkJitterBuffer, StartAtMinLatency){
+    test_stream_init(&stream, 0.0);
+    a2dp_sink_jitter_buffer_set_latency(&stream.jitter_buffer, 100, 150);
+    // 100 ms = 34 frames = 7 packets
+    int i;
+    for (i = 0; i < 6; i++){
+        test_stream_send_packet(&stream, 0);
+        CHECK_FALSE(a2dp_sink_jitter_buffer_is_playing(&stream.jitter_buffer));
+    }
+    test_stream_send_packet(&stream, 0);
+    CHECK_TRUE(a2dp_sink_jitter_buffer_is_playing(&stream.jitter_buffer));
+}
+
+TEST(A2DPSinkJitterBuffer, NoClockSkew){
+    test_stream_init(&stream, 0.0);
+    test_stream_run(&stream, 60000, 20000, 0, 2000);
+    const a2dp_sink_jitter_buffer_statistics_t * statistics = a2dp_sink_jitter_buffer_get_statistics(&stream.jitter_buffer);
+    CHECK_EQUAL(0, statistics->underruns);
+    CHECK_EQUAL(0, statistics->overruns);
+    CHECK_EQUAL(0, statistics->frames_lost);
+    CHECK(stream.level_min > 40);
+    CHECK(stream.level_max < 90);
+}
+
+TEST(A2DPSinkJitterBuffer, SourceClockFaster){
+    test_stream_init(&stream, 0.003);
+    test_stream_run(&stream, 120000, 20000, 0, 2000);
+    const a2dp_sink_jitter_buffer_statistics_t * statistics = a2dp_sink_jitter_buffer_get_statistics(&stream.jitter_buffer);
+    CHECK_EQUAL(0, statistics->underruns);
+    CHECK_EQUAL(0, statistics->overruns);
+    CHECK(stream.level_min > 40);
+    CHECK(stream.level_max < 90);
+}
+
+TEST(A2DPSinkJitterBuffer, SourceClockSlower){
+    test_stream_init(&stream, -0.003);
+    test_stream_run(&stream, 120000, 20000, 0, 2000);
+    const a2dp_sink_jitter_buffer_statistics_t * statistics = a2dp_sink_jitter_buffer_get_statistics(&stream.jitter_buffer);
+    CHECK_EQUAL(0, statistics->underruns);
+    CHECK_EQUAL(0, statistics->overruns);
+    CHECK(stream.level_min > 40);
+    CHECK(stream.level_max < 90);
+}
+
+TEST(A2DPSinkJitterBuffer, ConcealLostPacketsFallback){
+    test_stream_init(&stream, 0.0);
+    test_stream_run(&stream, 10000, 10000, 20, 2000);
+    const a2dp_sink_jitter_buffer_statistics_t * statistics = a2dp_sink_jitter_buffer_get_statistics(&stream.jitter_buffer);
+    CHECK(statistics->frames_lost > 0);
+    CHECK(statistics->frames_concealed > 0);
+    CHECK_EQUAL(0, stream.codec.num_frames_concealed);
+    CHECK_EQUAL(0, statistics->underruns);
+}
+
+TEST(A2DPSinkJitterBuffer, ConcealLostPacketsCodec){
+    test_stream_init(&stream, 0.0);
+    stream.codec.conceal = true;
+    test_stream_run(&stream, 10000, 10000, 20, 2000);
+    const a2dp_sink_jitter_buffer_statistics_t * statistics = a2dp_sink_jitter_buffer_get_statistics(&stream.jitter_buffer);
+    CHECK(statistics->frames_lost > 0);
+    CHECK_EQUAL(statistics->frames_concealed, stream.codec.num_frames_concealed);
+    CHECK_EQUAL(0, statistics->underruns);
+}
+
+TEST(A2DPSinkJitterBuffer, FallbackConcealmentAttenuates){
+    test_stream_init(&stream, 0.0);
+    a2dp_sink_jitter_buffer_set_latency(&stream.jitter_buffer, 10, 20);
+    uint8_t frame[FRAME_SIZE];
+    memset(frame, 0x40, sizeof(frame));
+    // 10 ms = 3 frames: 0x40, lost, lost
+    a2dp_sink_jitter_buffer_write_frames(&stream.jitter_buffer, 0, 0, frame, sizeof(frame), 1);
+    a2dp_sink_jitter_buffer_write_frames(&stream.jitter_buffer, 0, 1, frame, sizeof(frame), 1);
+    a2dp_sink_jitter_buffer_write_frames(&stream.jitter_buffer, 0, 2, frame, sizeof(frame), 1);
+    a2dp_sink_jitter_buffer_write_frames(&stream.jitter_buffer, 0, 5, frame, sizeof(frame), 1);
+    CHECK_TRUE(a2dp_sink_jitter_buffer_is_playing(&stream.jitter_buffer));
+    CHECK_EQUAL(6, a2dp_sink_jitter_buffer_get_num_frames_buffered(&stream.jitter_buffer));
+    int16_t audio[6 * SAMPLES_PER_FRAME * NUM_CHANNELS];
+    a2dp_sink_jitter_buffer_read_audio(&stream.jitter_buffer, audio, 6 * SAMPLES_PER_FRAME);
+    CHECK_EQUAL(0x40, audio[2 * SAMPLES_PER_FRAME * NUM_CHANNELS]);
+    CHECK_EQUAL(0x20, audio[3 * SAMPLES_PER_FRAME * NUM_CHANNELS]);
+    CHECK_EQUAL(0x10, audio[4 * SAMPLES_PER_FRAME * NUM_CHANNELS]);
+    CHECK_EQUAL(2, a2dp_sink_jitter_buffer_get_statistics(&stream.jitter_buffer)->frames_concealed);
+}
+
+TEST(A2DPSinkJitterBuffer, OverrunDropsOldestFrames){
+    test_stream_init(&stream, 0.0);
+    int i;
+    for (i = 0; i < (MAX_FRAMES / FRAMES_PER_PACKET) + 4; i++){
+        test_stream_send_packet(&stream, 0);
+    }
+    const a2dp_sink_jitter_buffer_statistics_t * statistics = a2dp_sink_jitter_buffer_get_statistics(&stream.jitter_buffer);
+    CHECK_EQUAL(MAX_FRAMES, a2dp_sink_jitter_buffer_get_num_frames_buffered(&stream.jitter_buffer));
+    CHECK_EQUAL(4 * FRAMES_PER_PACKET, statistics->overruns);
+    CHECK_EQUAL(4 * FRAMES_PER_PACKET, statistics->frames_dropped);
+    // oldest frames have been dropped
+    int16_t audio[SAMPLES_PER_FRAME * NUM_CHANNELS];
+    a2dp_sink_jitter_buffer_read_audio(&stream.jitter_buffer, audio, SAMPLES_PER_FRAME);
+    CHECK_EQUAL(4 * FRAMES_PER_PACKET, audio[0]);
+}
+
+TEST(A2DPSinkJitterBuffer, UnderrunRebuffers){
+    test_stream_init(&stream, 0.0);
+    test_stream_run(&stream, 2000, 0, 0, 0);
+    CHECK_TRUE(a2dp_sink_jitter_buffer_is_playing(&stream.jitter_buffer));
+    // source stops sending
+    int16_t audio[PLAYBACK_BLOCK_SIZE * NUM_CHANNELS];
+    int i;
+    for (i = 0; i < 50; i++){
+        a2dp_sink_jitter_buffer_read_audio(&stream.jitter_buffer, audio, PLAYBACK_BLOCK_SIZE);
+    }
+    CHECK_FALSE(a2dp_sink_jitter_buffer_is_playing(&stream.jitter_buffer));
+    CHECK_EQUAL(1, a2dp_sink_jitter_buffer_get_statistics(&stream.jitter_buffer)->underruns);
+    CHECK_EQUAL(0, a2dp_sink_jitter_buffer_get_num_frames_buffered(&stream.jitter_buffer));
+}
+
+TEST(A2DPSinkJitterBuffer, IndependentStreams){
+    static test_stream_t stream_b;
+    test_stream_init(&stream, 0.002);
+    test_stream_init(&stream_b, -0.002);
+    stream_b.frame_value = 100;
+    int i;
+    for (i = 0; i < 30; i++){
+        test_stream_run(&stream, 1000, 15000, 0, 2000);
+        test_stream_run(&stream_b, 1000, 15000, 0, 2000);
+    }
+    CHECK_EQUAL(0, a2dp_sink_jitter_buffer_get_statistics(&stream.jitter_buffer)->underruns);
+    CHECK_EQUAL(0, a2dp_sink_jitter_buffer_get_statistics(&stream_b.jitter_buffer)->underruns);
+    CHECK(stream.codec.num_frames_decoded > 0);
+    CHECK(stream_b.codec.num_frames_decoded > 0);
+    CHECK(stream.level_max < 90);
+    CHECK(stream_b.level_min > 30);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -98,8 +98,8 @@ static int att_write_callback(hci_con_handle_t con_handle, uint16_t attribute_ha
 	}
 }
 
-static uint16_t att_read_multiple_request(uint16_t num_value_handles, uint16_t * value_handles){
-    att_request[0] = ATT_READ_MULTIPLE_REQUEST;
+static uint16_t att_read_multiple_request_with_opcode(uint8_t request_type, uint16_t num_value_handles, uint16_t * value_handles){
+    att_request[0] = request_type;
     int i;
     int offset = 1;
     for (i=0;i<num_value_handles;i++){
@@ -109,6 +109,10 @@ static uint16_t att_read_multiple_request(uint16_t num_value_handles, uint16_t *
 	return offset;
 }
 
+static uint16_t att_read_multiple_request(uint16_t num_value_handles, uint16_t * value_handles){
+	return att_read_multiple_request_with_opcode(ATT_READ_MULTIPLE_REQUEST, num_value_handles, value_handles);
+}
+
 static uint16_t att_write_request(uint16_t request_type, uint16_t attribute_handle, uint16_t value_length, const uint8_t * value){
     att_request[0] = request_type;
     little_endian_store_16(att_request, 1, attribute_handle);
@@ -323,6 +327,72 @@ TEST(AttDb, handle_read_multiple_request){
 #endif
 }
 
+TEST(AttDb, handle_read_multiple_variable_request){
+	uint16_t value_handles[2];
+	uint16_t num_value_handles;
+
+	// less then two values
+	num_value_handles = 1;
+	value_handles[0] = 0x1;
+	{
+		att_request_len = att_read_multiple_request_with_opcode(ATT_READ_MULTIPLE_VARIABLE_REQ, num_value_handles, value_handles);
+		att_response_len = att_handle_request(&att_connection, (uint8_t *) att_request, att_request_len, att_response);
+		const uint8_t expected_response[] = {ATT_ERROR_RESPONSE, ATT_READ_MULTIPLE_VARIABLE_REQ, 0, 0, ATT_ERROR_INVALID_PDU};
+		CHECK_EQUAL(sizeof(expected_response), att_response_len);
+		MEMCMP_EQUAL(expected_response, att_response, att_response_len);
+	}
+
+	// handle read not permitted
+	num_value_handles = 2;
+	value_handles[0] = 0x05;
+	value_handles[1] = 0x06;
+	{
+		att_request_len = att_read_multiple_request_with_opcode(ATT_READ_MULTIPLE_VARIABLE_REQ, num_value_handles, value_handles);
+		att_response_len = att_handle_request(&att_connection, (uint8_t *) att_request, att_request_len, att_response);
+		const uint8_t expected_response[] = {ATT_ERROR_RESPONSE, ATT_READ_MULTIPLE_VARIABLE_REQ, (uint8_t) value_handles[1], 0, ATT_ERROR_READ_NOT_PERMITTED};
+		CHECK_EQUAL(sizeof(expected_response), att_response_len);
+		MEMCMP_EQUAL(expected_response, att_response, att_response_len);
+	}
+
+	// static read, each value prefixed by its length
+	num_value_handles = 2;
+	value_handles[0] = 0x03;
+	value_handles[1] = 0x05;
+	{
+		read_callback_mode = READ_CALLBACK_MODE_RETURN_ONE_BYTE;
+
+		att_request_len = att_read_multiple_request_with_opcode(ATT_READ_MULTIPLE_VARIABLE_REQ, num_value_handles, value_handles);
+		CHECK_EQUAL(1 + 2 * num_value_handles, att_request_len);
+		att_response_len = att_handle_request(&att_connection, (uint8_t *) att_request, att_request_len, att_response);
+		const uint8_t expected_response[] = {ATT_READ_MULTIPLE_VARIABLE_RSP, 0x01, 0x00, 0x64, 0x05, 0x00, 0x10, 0x06, 0x00, 0x1B, 0x2A};
+		CHECK_EQUAL(sizeof(expected_response), att_response_len);
+		MEMCMP_EQUAL(expected_response, att_response, att_response_len);
+
+		read_callback_mode = READ_CALLBACK_MODE_RETURN_DEFAULT;
+	}
+}
+
+TEST(AttDb, prepare_handle_value_multiple_notification){
+	const uint16_t attribute_handles[] = { 0x0003, 0x0005 };
+	const uint8_t value_a[] = { 0x11 };
+	const uint8_t value_b[] = { 0x21, 0x22 };
+	const uint8_t * values_data[] = { value_a, value_b };
+	const uint16_t values_len[] = { sizeof(value_a), sizeof(value_b) };
+
+	att_response_len = att_prepare_handle_value_multiple_notification(&att_connection, 2, attribute_handles, values_data, values_len, att_response);
+	const uint8_t expected_response[] = {ATT_MULTIPLE_HANDLE_VALUE_NTF, 0x03, 0x00, 0x01, 0x00, 0x11, 0x05, 0x00, 0x02, 0x00, 0x21, 0x22};
+	CHECK_EQUAL(sizeof(expected_response), att_response_len);
+	MEMCMP_EQUAL(expected_response, att_response, att_response_len);
+
+	// only complete tuples that fit into MTU are added
+	uint16_t mtu = att_connection.mtu;
+	att_connection.mtu = 10;
+	att_response_len = att_prepare_handle_value_multiple_notification(&att_connection, 2, attribute_handles, values_data, values_len, att_response);
+	CHECK_EQUAL(6, att_response_len);
+	MEMCMP_EQUAL(expected_response, att_response, att_response_len);
+	att_connection.mtu = mtu;
+}
+
 TEST(AttDb, handle_write_request){
 	uint16_t attribute_handle = 0x03;
 
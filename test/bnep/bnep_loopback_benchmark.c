@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "bnep_loopback_benchmark.c"
+
+// *****************************************************************************
+//
+// BNEP loopback benchmark: forwards Ethernet frames from a socket pair standing
+// in for the TAP interface via the POSIX network interface and BNEP over a
+// simulated L2CAP channel, whose remote echoes all frames back to the network
+// interface, and reports the throughput for BTSTACK_NETWORK_POSIX_QUEUE_SIZE
+//
+// *****************************************************************************
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bluetooth_psm.h"
+#include "bluetooth_sdp.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_network.h"
+#include "btstack_network_posix.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "classic/bnep.h"
+#include "l2cap_loopback.h"
+
+#define NUM_FRAMES          100000
+#define FRAME_PAYLOAD_LEN   1500
+#define ETHERNET_HEADER_LEN 14
+#define ETHERTYPE_IPV4      0x0800
+
+static uint16_t bnep_cid;
+static int      tap_peer_fd;
+static btstack_data_source_t tap_peer_data_source;
+
+static const uint8_t * network_packet;
+static uint16_t        network_packet_len;
+
+static uint8_t  frame[ETHERNET_HEADER_LEN + FRAME_PAYLOAD_LEN];
+static int      frames_written;
+static int      frames_received;
+static uint64_t start_us;
+
+static uint64_t time_us(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000u) + ((uint64_t) now.tv_nsec / 1000u);
+}
+
+static void tap_peer_process(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type){
+    switch (callback_type){
+        case DATA_SOURCE_CALLBACK_WRITE:
+            while (frames_written < NUM_FRAMES){
+                big_endian_store_16(frame, ETHERNET_HEADER_LEN, (uint16_t) frames_written);
+                if (write(ds->source.fd, frame, sizeof(frame)) != (ssize_t) sizeof(frame)) break;
+                frames_written++;
+            }
+            if (frames_written == NUM_FRAMES){
+                btstack_run_loop_disable_data_source_callbacks(ds, DATA_SOURCE_CALLBACK_WRITE);
+            }
+            break;
+        case DATA_SOURCE_CALLBACK_READ:
+            while (true){
+                uint8_t buffer[BNEP_MTU_MIN];
+                ssize_t len = read(ds->source.fd, buffer, sizeof(buffer));
+                if (len <= 0) break;
+                if ((len != (ssize_t) sizeof(frame)) || (big_endian_read_16(buffer, ETHERNET_HEADER_LEN) != (uint16_t) frames_received)){
+                    printf("Unexpected frame #%u, len %u\n", frames_received, (unsigned int) len);
+                    exit(EXIT_FAILURE);
+                }
+                frames_received++;
+            }
+            if (frames_received == NUM_FRAMES){
+                btstack_run_loop_trigger_exit();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void start_benchmark(void){
+    memcpy(&frame[0], loopback_remote_addr, 6);
+    memcpy(&frame[6], loopback_local_addr, 6);
+    big_endian_store_16(frame, 12, ETHERTYPE_IPV4);
+    memset(&frame[ETHERNET_HEADER_LEN], 0x55, FRAME_PAYLOAD_LEN);
+
+    start_us = time_us();
+    btstack_run_loop_set_data_source_fd(&tap_peer_data_source, tap_peer_fd);
+    btstack_run_loop_set_data_source_handler(&tap_peer_data_source, &tap_peer_process);
+    btstack_run_loop_add_data_source(&tap_peer_data_source);
+    btstack_run_loop_enable_data_source_callbacks(&tap_peer_data_source, DATA_SOURCE_CALLBACK_READ | DATA_SOURCE_CALLBACK_WRITE);
+}
+
+static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    switch (packet_type){
+        case HCI_EVENT_PACKET:
+            switch (hci_event_packet_get_type(packet)){
+                case BNEP_EVENT_CHANNEL_OPENED:
+                    if (bnep_event_channel_opened_get_status(packet) != ERROR_CODE_SUCCESS){
+                        printf("BNEP connection failed\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    bnep_cid = bnep_event_channel_opened_get_bnep_cid(packet);
+                    start_benchmark();
+                    break;
+                case BNEP_EVENT_CAN_SEND_NOW:
+                    if (network_packet_len == 0) break;
+                    bnep_send(bnep_cid, (uint8_t *) network_packet, network_packet_len);
+                    network_packet_len = 0;
+                    btstack_network_packet_sent();
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case BNEP_DATA_PACKET:
+            btstack_network_process_packet(packet, size);
+            break;
+        default:
+            break;
+    }
+}
+
+static void network_send_packet_callback(const uint8_t * packet, uint16_t size){
+    network_packet = packet;
+    network_packet_len = size;
+    bnep_request_can_send_now_event(bnep_cid);
+}
+
+int main(void){
+
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    loopback_init();
+    bnep_init();
+
+    // socket pair instead of TAP device
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0){
+        printf("socketpair failed\n");
+        return EXIT_FAILURE;
+    }
+    tap_peer_fd = fds[1];
+    fcntl(tap_peer_fd, F_SETFL, fcntl(tap_peer_fd, F_GETFL, 0) | O_NONBLOCK);
+    btstack_network_init(&network_send_packet_callback);
+    if (btstack_network_posix_up_with_fd(fds[0]) != 0){
+        return EXIT_FAILURE;
+    }
+
+    bd_addr_t remote_addr;
+    memcpy(remote_addr, loopback_remote_addr, 6);
+    bnep_connect(&packet_handler, remote_addr, BLUETOOTH_PSM_BNEP, BLUETOOTH_SERVICE_CLASS_PANU, BLUETOOTH_SERVICE_CLASS_NAP);
+
+    btstack_run_loop_execute();
+
+    uint64_t duration_us = time_us() - start_us;
+    double seconds = (double) duration_us / 1000000.0;
+    double megabytes = ((double) NUM_FRAMES * sizeof(frame)) / (1024.0 * 1024.0);
+    printf("Queue size %2u: %u frames of %u bytes echoed in %6.3f s, %8.1f frames/s, %6.1f MB/s\n",
+           (unsigned int) BTSTACK_NETWORK_POSIX_QUEUE_SIZE, NUM_FRAMES, (unsigned int) sizeof(frame),
+           seconds, (double) NUM_FRAMES / seconds, megabytes / seconds);
+
+    btstack_network_down();
+    close(tap_peer_fd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,301 @@
+// *****************************************************************************
+//
+// test BNEP header compression and forwarding of Ethernet frames between
+// POSIX network interface and BNEP over simulated L2CAP loopback channel
+//
+// *****************************************************************************
+
+#include "btstack_config.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bluetooth_psm.h"
+#include "bluetooth_sdp.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_network.h"
+#include "btstack_network_posix.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "classic/bnep.h"
+#include "l2cap_loopback.h"
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#define ETHERNET_HEADER_LEN   14
+#define ETHERTYPE_IPV4        0x0800
+#define FRAME_PAYLOAD_LEN     100
+#define NUM_LOOPBACK_FRAMES   50
+#define RUN_LOOP_TIMEOUT_MS   1000
+
+static const bd_addr_t other_addr = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x03 };
+
+static uint16_t bnep_cid;
+static bool     bnep_channel_open;
+static int      tap_peer_fd;
+
+static btstack_timer_source_t run_loop_exit_timer;
+
+// frame delivered by network interface
+static const uint8_t * network_packet;
+static uint16_t        network_packet_len;
+static int             network_num_packets;
+static uint16_t        network_next_seq_nr;
+static bool            network_forward_to_bnep;
+
+// frames received from network interface
+static btstack_data_source_t tap_peer_data_source;
+static int                   tap_peer_num_frames;
+static uint16_t              tap_peer_next_seq_nr;
+
+static uint16_t setup_frame(uint8_t * frame, const bd_addr_t addr_dest, const bd_addr_t addr_source, uint16_t seq_nr, uint16_t payload_len){
+    memcpy(&frame[0], addr_dest, 6);
+    memcpy(&frame[6], addr_source, 6);
+    big_endian_store_16(frame, 12, ETHERTYPE_IPV4);
+    uint16_t i;
+    for (i=0;i<payload_len;i++){
+        frame[ETHERNET_HEADER_LEN + i] = (uint8_t) (seq_nr + i);
+    }
+    big_endian_store_16(frame, ETHERNET_HEADER_LEN, seq_nr);
+    return ETHERNET_HEADER_LEN + payload_len;
+}
+
+static void check_payload(const uint8_t * payload, uint16_t payload_len, uint16_t seq_nr){
+    CHECK_EQUAL(FRAME_PAYLOAD_LEN, payload_len);
+    CHECK_EQUAL(seq_nr, big_endian_read_16(payload, 0));
+    uint16_t i;
+    for (i=2;i<payload_len;i++){
+        CHECK_EQUAL((uint8_t) (seq_nr + i), payload[i]);
+    }
+}
+
+static void tap_peer_send_frames(int num_frames){
+    uint8_t frame[ETHERNET_HEADER_LEN + FRAME_PAYLOAD_LEN];
+    int i;
+    for (i=0;i<num_frames;i++){
+        uint16_t len = setup_frame(frame, loopback_remote_addr, loopback_local_addr, (uint16_t) i, FRAME_PAYLOAD_LEN);
+        CHECK_EQUAL(len, write(tap_peer_fd, frame, len));
+    }
+}
+
+static void tap_peer_process(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type){
+    UNUSED(callback_type);
+    uint8_t frame[BNEP_MTU_MIN];
+    ssize_t len = read(ds->source.fd, frame, sizeof(frame));
+    if (len <= 0) return;
+    // echo from remote is addressed to us
+    CHECK_EQUAL(0, memcmp(&frame[0], loopback_local_addr, 6));
+    CHECK_EQUAL(0, memcmp(&frame[6], loopback_remote_addr, 6));
+    check_payload(&frame[ETHERNET_HEADER_LEN], (uint16_t) (len - ETHERNET_HEADER_LEN), tap_peer_next_seq_nr);
+    tap_peer_next_seq_nr++;
+    tap_peer_num_frames++;
+    if (tap_peer_num_frames == NUM_LOOPBACK_FRAMES){
+        btstack_run_loop_trigger_exit();
+    }
+}
+
+static void run_loop_exit_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    btstack_run_loop_trigger_exit();
+}
+
+static void run_loop_for_ms(uint32_t timeout_ms){
+    btstack_run_loop_set_timer_handler(&run_loop_exit_timer, &run_loop_exit_timer_handler);
+    btstack_run_loop_set_timer(&run_loop_exit_timer, timeout_ms);
+    btstack_run_loop_add_timer(&run_loop_exit_timer);
+    btstack_run_loop_execute();
+    btstack_run_loop_remove_timer(&run_loop_exit_timer);
+}
+
+static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    switch (packet_type){
+        case HCI_EVENT_PACKET:
+            switch (hci_event_packet_get_type(packet)){
+                case BNEP_EVENT_CHANNEL_OPENED:
+                    CHECK_EQUAL(ERROR_CODE_SUCCESS, bnep_event_channel_opened_get_status(packet));
+                    bnep_cid = bnep_event_channel_opened_get_bnep_cid(packet);
+                    bnep_channel_open = true;
+                    btstack_run_loop_trigger_exit();
+                    break;
+                case BNEP_EVENT_CAN_SEND_NOW:
+                    if (network_packet_len == 0) break;
+                    CHECK_EQUAL(0, bnep_send(bnep_cid, (uint8_t *) network_packet, network_packet_len));
+                    network_packet_len = 0;
+                    btstack_network_packet_sent();
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case BNEP_DATA_PACKET:
+            btstack_network_process_packet(packet, size);
+            break;
+        default:
+            break;
+    }
+}
+
+static void network_send_packet_callback(const uint8_t * packet, uint16_t size){
+    CHECK_EQUAL(network_next_seq_nr, big_endian_read_16(packet, ETHERNET_HEADER_LEN));
+    network_next_seq_nr++;
+    network_num_packets++;
+    network_packet = packet;
+    network_packet_len = size;
+    if (network_forward_to_bnep){
+        bnep_request_can_send_now_event(bnep_cid);
+    }
+}
+
+TEST_GROUP(BNEP){
+    void setup(void){
+        bnep_cid = 0;
+        bnep_channel_open = false;
+        network_packet_len = 0;
+        network_num_packets = 0;
+        network_next_seq_nr = 0;
+        network_forward_to_bnep = false;
+        tap_peer_num_frames = 0;
+        tap_peer_next_seq_nr = 0;
+
+        btstack_memory_init();
+        btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+        loopback_init();
+        bnep_init();
+
+        // socket pair instead of TAP device
+        int fds[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds));
+        tap_peer_fd = fds[1];
+        btstack_network_init(&network_send_packet_callback);
+        CHECK_EQUAL(0, btstack_network_posix_up_with_fd(fds[0]));
+
+        bd_addr_t remote_addr;
+        memcpy(remote_addr, loopback_remote_addr, 6);
+        CHECK_EQUAL(0, bnep_connect(&packet_handler, remote_addr, BLUETOOTH_PSM_BNEP, BLUETOOTH_SERVICE_CLASS_PANU, BLUETOOTH_SERVICE_CLASS_NAP));
+        run_loop_for_ms(RUN_LOOP_TIMEOUT_MS);
+        CHECK(bnep_channel_open);
+    }
+    void teardown(void){
+        btstack_network_down();
+        close(tap_peer_fd);
+        bnep_deinit();
+        btstack_memory_deinit();
+        btstack_run_loop_deinit();
+    }
+};
+
+TEST(BNEP, CompressedEthernet){
+    uint8_t frame[ETHERNET_HEADER_LEN + FRAME_PAYLOAD_LEN];
+    uint16_t len = setup_frame(frame, loopback_remote_addr, loopback_local_addr, 0, FRAME_PAYLOAD_LEN);
+    CHECK_EQUAL(0, bnep_send(bnep_cid, frame, len));
+    const uint8_t * packet = loopback_get_last_packet();
+    CHECK_EQUAL(3 + FRAME_PAYLOAD_LEN, loopback_get_last_packet_len());
+    CHECK_EQUAL(0x02, packet[0]);
+    CHECK_EQUAL(ETHERTYPE_IPV4, big_endian_read_16(packet, 1));
+    check_payload(&packet[3], FRAME_PAYLOAD_LEN, 0);
+}
+
+TEST(BNEP, GeneralEthernet){
+    uint8_t frame[ETHERNET_HEADER_LEN + FRAME_PAYLOAD_LEN];
+    uint16_t len = setup_frame(frame, other_addr, other_addr, 0, FRAME_PAYLOAD_LEN);
+    CHECK_EQUAL(0, bnep_send(bnep_cid, frame, len));
+    const uint8_t * packet = loopback_get_last_packet();
+    CHECK_EQUAL(1 + len, loopback_get_last_packet_len());
+    CHECK_EQUAL(0x00, packet[0]);
+    MEMCMP_EQUAL(frame, &packet[1], len);
+}
+
+TEST(BNEP, CompressedEthernetSourceOnly){
+    uint8_t frame[ETHERNET_HEADER_LEN + FRAME_PAYLOAD_LEN];
+    uint16_t len = setup_frame(frame, loopback_remote_addr, other_addr, 0, FRAME_PAYLOAD_LEN);
+    CHECK_EQUAL(0, bnep_send(bnep_cid, frame, len));
+    const uint8_t * packet = loopback_get_last_packet();
+    CHECK_EQUAL(9 + FRAME_PAYLOAD_LEN, loopback_get_last_packet_len());
+    CHECK_EQUAL(0x03, packet[0]);
+    MEMCMP_EQUAL(other_addr, &packet[1], 6);
+    check_payload(&packet[9], FRAME_PAYLOAD_LEN, 0);
+}
+
+TEST(BNEP, CompressedEthernetDestOnly){
+    uint8_t frame[ETHERNET_HEADER_LEN + FRAME_PAYLOAD_LEN];
+    uint16_t len = setup_frame(frame, other_addr, loopback_local_addr, 0, FRAME_PAYLOAD_LEN);
+    CHECK_EQUAL(0, bnep_send(bnep_cid, frame, len));
+    const uint8_t * packet = loopback_get_last_packet();
+    CHECK_EQUAL(9 + FRAME_PAYLOAD_LEN, loopback_get_last_packet_len());
+    CHECK_EQUAL(0x04, packet[0]);
+    MEMCMP_EQUAL(other_addr, &packet[1], 6);
+    check_payload(&packet[9], FRAME_PAYLOAD_LEN, 0);
+}
+
+TEST(BNEP, FrameTooLarge){
+    static uint8_t frame[ETHERNET_HEADER_LEN + BNEP_MTU_MIN];
+    uint16_t len = setup_frame(frame, loopback_remote_addr, loopback_local_addr, 0, BNEP_MTU_MIN - 15 + 1);
+    CHECK_EQUAL(BNEP_DATA_LEN_EXCEEDS_MTU, bnep_send(bnep_cid, frame, len));
+    CHECK(loopback_packet_buffer_reserved() == false);
+    uint32_t num_packets_sent = loopback_get_num_packets_sent();
+    len = setup_frame(frame, loopback_remote_addr, loopback_local_addr, 0, FRAME_PAYLOAD_LEN);
+    CHECK_EQUAL(0, bnep_send(bnep_cid, frame, len));
+    CHECK_EQUAL(num_packets_sent + 1, loopback_get_num_packets_sent());
+}
+
+TEST(BNEP, FrameQueue){
+    tap_peer_send_frames(3);
+    run_loop_for_ms(10);
+    // next frame is only delivered after previous one was sent
+    CHECK_EQUAL(1, network_num_packets);
+    btstack_network_packet_sent();
+    CHECK_EQUAL(2, network_num_packets);
+    btstack_network_packet_sent();
+    CHECK_EQUAL(3, network_num_packets);
+    btstack_network_packet_sent();
+    CHECK_EQUAL(3, network_num_packets);
+}
+
+TEST(BNEP, BackPressure){
+    const int num_frames = BTSTACK_NETWORK_POSIX_QUEUE_SIZE + 2;
+    tap_peer_send_frames(num_frames);
+    run_loop_for_ms(10);
+    CHECK_EQUAL(1, network_num_packets);
+    // all queued frames are delivered without reading from network interface
+    int i;
+    for (i=1;i<BTSTACK_NETWORK_POSIX_QUEUE_SIZE;i++){
+        btstack_network_packet_sent();
+    }
+    CHECK_EQUAL(BTSTACK_NETWORK_POSIX_QUEUE_SIZE, network_num_packets);
+    btstack_network_packet_sent();
+    CHECK_EQUAL(BTSTACK_NETWORK_POSIX_QUEUE_SIZE, network_num_packets);
+    // remaining frames were left in network interface
+    run_loop_for_ms(10);
+    CHECK_EQUAL(BTSTACK_NETWORK_POSIX_QUEUE_SIZE + 1, network_num_packets);
+    btstack_network_packet_sent();
+    CHECK_EQUAL(num_frames, network_num_packets);
+}
+
+TEST(BNEP, Loopback){
+    network_forward_to_bnep = true;
+    btstack_run_loop_set_data_source_fd(&tap_peer_data_source, tap_peer_fd);
+    btstack_run_loop_set_data_source_handler(&tap_peer_data_source, &tap_peer_process);
+    btstack_run_loop_add_data_source(&tap_peer_data_source);
+    btstack_run_loop_enable_data_source_callbacks(&tap_peer_data_source, DATA_SOURCE_CALLBACK_READ);
+
+    uint32_t num_packets_sent = loopback_get_num_packets_sent();
+    tap_peer_send_frames(NUM_LOOPBACK_FRAMES);
+    run_loop_for_ms(RUN_LOOP_TIMEOUT_MS);
+    btstack_run_loop_remove_data_source(&tap_peer_data_source);
+
+    CHECK_EQUAL(NUM_LOOPBACK_FRAMES, network_num_packets);
+    CHECK_EQUAL(NUM_LOOPBACK_FRAMES, tap_peer_num_frames);
+    CHECK_EQUAL(num_packets_sent + NUM_LOOPBACK_FRAMES, loopback_get_num_packets_sent());
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
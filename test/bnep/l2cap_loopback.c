@@ -0,0 +1,234 @@
+// *****************************************************************************
+//
+// simulated L2CAP channel to a remote BNEP device that echoes all Ethernet frames
+//
+// Outgoing packets occupy one of LOOPBACK_NUM_ACL_PACKETS slots until they are
+// processed by the remote from a run loop timer. The remote accepts the BNEP
+// setup request and sends every BNEP Ethernet packet back unmodified.
+//
+// *****************************************************************************
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bluetooth_psm.h"
+#include "btstack_defines.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "l2cap.h"
+#include "l2cap_loopback.h"
+
+#define LOOPBACK_L2CAP_CID      0x40
+#define LOOPBACK_CON_HANDLE     0x01
+#define LOOPBACK_MTU            BNEP_MTU_MIN
+
+// room for ACL and L2CAP header and HCI_INCOMING_PRE_BUFFER_SIZE in front of incoming packets
+#define LOOPBACK_PRE_BUFFER     16
+
+// BNEP constants as defined in bnep.c
+#define BNEP_PKT_TYPE_CONTROL                       0x01
+#define BNEP_CONTROL_TYPE_SETUP_CONNECTION_REQUEST  0x01
+#define BNEP_CONTROL_TYPE_SETUP_CONNECTION_RESPONSE 0x02
+
+const bd_addr_t loopback_local_addr  = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+const bd_addr_t loopback_remote_addr = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+static btstack_packet_handler_t loopback_packet_handler;
+static btstack_timer_source_t   loopback_timer;
+static bool                     loopback_timer_active;
+static bool                     loopback_can_send_now_requested;
+
+static uint8_t  loopback_outgoing_buffer[LOOPBACK_MTU];
+static bool     loopback_outgoing_reserved;
+
+static uint8_t  loopback_packets[LOOPBACK_NUM_ACL_PACKETS][LOOPBACK_PRE_BUFFER + LOOPBACK_MTU];
+static uint16_t loopback_packet_lengths[LOOPBACK_NUM_ACL_PACKETS];
+static uint16_t loopback_packets_head;
+static uint16_t loopback_packets_count;
+
+static uint8_t  loopback_last_packet[LOOPBACK_MTU];
+static uint16_t loopback_last_packet_len;
+static uint32_t loopback_num_packets_sent;
+
+static void loopback_emit_can_send_now(void){
+    while (loopback_can_send_now_requested && l2cap_can_send_packet_now(LOOPBACK_L2CAP_CID)){
+        loopback_can_send_now_requested = false;
+        uint8_t event[4];
+        event[0] = L2CAP_EVENT_CAN_SEND_NOW;
+        event[1] = 2;
+        little_endian_store_16(event, 2, LOOPBACK_L2CAP_CID);
+        (*loopback_packet_handler)(HCI_EVENT_PACKET, 0, event, sizeof(event));
+    }
+}
+
+static void loopback_remote_process_packet(uint8_t * packet, uint16_t len){
+    if ((len >= 2) && (packet[0] == BNEP_PKT_TYPE_CONTROL)){
+        if (packet[1] != BNEP_CONTROL_TYPE_SETUP_CONNECTION_REQUEST) return;
+        // accept connection
+        packet[1] = BNEP_CONTROL_TYPE_SETUP_CONNECTION_RESPONSE;
+        big_endian_store_16(packet, 2, 0);
+        len = 4;
+    }
+    // echo
+    (*loopback_packet_handler)(L2CAP_DATA_PACKET, LOOPBACK_L2CAP_CID, packet, len);
+}
+
+static void loopback_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    loopback_timer_active = false;
+
+    // remote processes all packets sent so far, which completes them
+    uint16_t num_packets = loopback_packets_count;
+    while (num_packets > 0){
+        uint16_t index = loopback_packets_head;
+        loopback_packets_head = (loopback_packets_head + 1) % LOOPBACK_NUM_ACL_PACKETS;
+        loopback_packets_count--;
+        num_packets--;
+        loopback_remote_process_packet(&loopback_packets[index][LOOPBACK_PRE_BUFFER], loopback_packet_lengths[index]);
+    }
+
+    loopback_emit_can_send_now();
+}
+
+static void loopback_trigger(void){
+    if (loopback_timer_active) return;
+    loopback_timer_active = true;
+    btstack_run_loop_set_timer_handler(&loopback_timer, &loopback_timer_handler);
+    btstack_run_loop_set_timer(&loopback_timer, 0);
+    btstack_run_loop_add_timer(&loopback_timer);
+}
+
+void loopback_init(void){
+    loopback_packet_handler = NULL;
+    loopback_timer_active = false;
+    loopback_can_send_now_requested = false;
+    loopback_outgoing_reserved = false;
+    loopback_packets_head = 0;
+    loopback_packets_count = 0;
+    loopback_last_packet_len = 0;
+    loopback_num_packets_sent = 0;
+}
+
+bool loopback_packet_buffer_reserved(void){
+    return loopback_outgoing_reserved;
+}
+
+const uint8_t * loopback_get_last_packet(void){
+    return loopback_last_packet;
+}
+
+uint16_t loopback_get_last_packet_len(void){
+    return loopback_last_packet_len;
+}
+
+uint32_t loopback_get_num_packets_sent(void){
+    return loopback_num_packets_sent;
+}
+
+// GAP
+void gap_local_bd_addr(bd_addr_t address_buffer){
+    memcpy(address_buffer, loopback_local_addr, 6);
+}
+
+gap_security_level_t gap_get_security_level(void){
+    return LEVEL_0;
+}
+
+// L2CAP
+uint16_t l2cap_max_mtu(void){
+    return LOOPBACK_MTU;
+}
+
+uint8_t l2cap_create_channel(btstack_packet_handler_t packet_handler, bd_addr_t address, uint16_t psm, uint16_t mtu, uint16_t * out_local_cid){
+    UNUSED(psm);
+    UNUSED(mtu);
+    loopback_packet_handler = packet_handler;
+    if (out_local_cid != NULL){
+        *out_local_cid = LOOPBACK_L2CAP_CID;
+    }
+
+    uint8_t event[21];
+    memset(event, 0, sizeof(event));
+    event[0] = L2CAP_EVENT_CHANNEL_OPENED;
+    event[1] = sizeof(event) - 2;
+    event[2] = ERROR_CODE_SUCCESS;
+    reverse_bd_addr(address, &event[3]);
+    little_endian_store_16(event,  9, LOOPBACK_CON_HANDLE);
+    little_endian_store_16(event, 11, BLUETOOTH_PSM_BNEP);
+    little_endian_store_16(event, 13, LOOPBACK_L2CAP_CID);
+    little_endian_store_16(event, 15, LOOPBACK_L2CAP_CID);
+    little_endian_store_16(event, 17, LOOPBACK_MTU);
+    little_endian_store_16(event, 19, LOOPBACK_MTU);
+    (*loopback_packet_handler)(HCI_EVENT_PACKET, 0, event, sizeof(event));
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_disconnect(uint16_t local_cid){
+    UNUSED(local_cid);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_register_service(btstack_packet_handler_t packet_handler, uint16_t psm, uint16_t mtu, gap_security_level_t security_level){
+    UNUSED(psm);
+    UNUSED(mtu);
+    UNUSED(security_level);
+    loopback_packet_handler = packet_handler;
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t l2cap_unregister_service(uint16_t psm){
+    UNUSED(psm);
+    return ERROR_CODE_SUCCESS;
+}
+
+void l2cap_accept_connection(uint16_t local_cid){
+    UNUSED(local_cid);
+}
+
+void l2cap_decline_connection(uint16_t local_cid){
+    UNUSED(local_cid);
+}
+
+bool l2cap_can_send_packet_now(uint16_t local_cid){
+    UNUSED(local_cid);
+    return (loopback_outgoing_reserved == false) && (loopback_packets_count < LOOPBACK_NUM_ACL_PACKETS);
+}
+
+uint8_t l2cap_request_can_send_now_event(uint16_t local_cid){
+    UNUSED(local_cid);
+    loopback_can_send_now_requested = true;
+    loopback_trigger();
+    return ERROR_CODE_SUCCESS;
+}
+
+bool l2cap_reserve_packet_buffer(void){
+    if (loopback_outgoing_reserved) return false;
+    loopback_outgoing_reserved = true;
+    return true;
+}
+
+uint8_t * l2cap_get_outgoing_buffer(void){
+    return loopback_outgoing_buffer;
+}
+
+uint8_t l2cap_send_prepared(uint16_t local_cid, uint16_t len){
+    UNUSED(local_cid);
+    loopback_outgoing_reserved = false;
+    if (loopback_packets_count == LOOPBACK_NUM_ACL_PACKETS){
+        return BTSTACK_ACL_BUFFERS_FULL;
+    }
+
+    memcpy(loopback_last_packet, loopback_outgoing_buffer, len);
+    loopback_last_packet_len = len;
+    loopback_num_packets_sent++;
+
+    uint16_t index = (loopback_packets_head + loopback_packets_count) % LOOPBACK_NUM_ACL_PACKETS;
+    memcpy(&loopback_packets[index][LOOPBACK_PRE_BUFFER], loopback_outgoing_buffer, len);
+    loopback_packet_lengths[index] = len;
+    loopback_packets_count++;
+    loopback_trigger();
+    return ERROR_CODE_SUCCESS;
+}
@@ -0,0 +1,40 @@
+// *****************************************************************************
+//
+// simulated L2CAP channel to a remote BNEP device that echoes all Ethernet frames
+//
+// *****************************************************************************
+
+#ifndef L2CAP_LOOPBACK_H
+#define L2CAP_LOOPBACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bluetooth.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+// outgoing L2CAP packets in flight, completed by run loop timer
+#define LOOPBACK_NUM_ACL_PACKETS 4
+
+extern const bd_addr_t loopback_local_addr;
+extern const bd_addr_t loopback_remote_addr;
+
+void     loopback_init(void);
+
+// L2CAP outgoing buffer is reserved but not sent
+bool     loopback_packet_buffer_reserved(void);
+
+// last BNEP packet sent
+const uint8_t * loopback_get_last_packet(void);
+uint16_t loopback_get_last_packet_len(void);
+
+uint32_t loopback_get_num_packets_sent(void);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif
@@ -35,5 +35,6 @@
 #define HCI_INCOMING_PRE_BUFFER_SIZE 6
 #define NVM_NUM_DEVICE_DB_ENTRIES 4
 #define NVM_NUM_LINK_KEYS 2
+#define NVM_NUM_SDP_CLIENT_CACHE_ENTRIES 4
 
 #endif
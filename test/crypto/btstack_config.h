@@ -18,6 +18,7 @@
 #define ENABLE_LE_SIGNED_WRITE
 #define ENABLE_LOG_ERROR
 #define ENABLE_LOG_INFO
+#define ENABLE_MICRO_ECC_P256
 #define ENABLE_PRINTF_HEXDUMP
 #define ENABLE_SOFTWARE_AES128
 
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "ecc_worker_benchmark.c"
+
+// *****************************************************************************
+//
+// ECC worker benchmark: runs LE Secure Connections key generation and DHKey
+// calculation on the POSIX run loop with and without worker thread and reports
+// the worst-case run loop blocking
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_crypto.h"
+#include "btstack_crypto_worker_posix.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_posix.h"
+#include "btstack_util.h"
+#include "uECC.h"
+
+#define NUM_PAIRINGS      20
+#define TICK_INTERVAL_MS  1
+#define PAIRING_PAUSE_MS  5
+
+static btstack_crypto_ecc_p256_t ecc_request;
+static btstack_timer_source_t    tick_timer;
+static btstack_timer_source_t    pairing_timer;
+
+static uint8_t local_public_key[64];
+static uint8_t peer_public_key[64];
+static uint8_t dhkey[32];
+
+static int      pairings_completed;
+static uint64_t tick_last_us;
+static uint64_t tick_max_gap_us;
+static uint64_t pairing_start_us;
+static uint64_t pairing_total_us;
+static uint64_t call_max_us;
+
+static uint64_t time_us(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000u) + ((uint64_t) now.tv_nsec / 1000u);
+}
+
+static int benchmark_rng(uint8_t * dest, unsigned size){
+    unsigned int i;
+    for (i=0;i<size;i++){
+        dest[i] = (uint8_t) (rand() & 0xff);
+    }
+    return 1;
+}
+
+static void tick_update(void){
+    uint64_t now = time_us();
+    uint64_t gap = now - tick_last_us;
+    if (gap > tick_max_gap_us){
+        tick_max_gap_us = gap;
+    }
+    tick_last_us = now;
+}
+
+static void tick_handler(btstack_timer_source_t * ts){
+    tick_update();
+    btstack_run_loop_set_timer(ts, TICK_INTERVAL_MS);
+    btstack_run_loop_add_timer(ts);
+}
+
+typedef struct {
+    const char *                     name;
+    const btstack_crypto_worker_t *  worker;
+} benchmark_config_t;
+
+static benchmark_config_t benchmark_configs[2];
+static int benchmark_index;
+
+static void pairing_start(void);
+
+static void benchmark_start(void){
+    const benchmark_config_t * config = &benchmark_configs[benchmark_index];
+    btstack_crypto_ecc_p256_set_worker(config->worker);
+    pairings_completed = 0;
+    pairing_total_us = 0;
+    tick_max_gap_us = 0;
+    tick_last_us = time_us();
+    call_max_us = 0;
+    pairing_start();
+}
+
+static void benchmark_report(void){
+    tick_update();
+    const benchmark_config_t * config = &benchmark_configs[benchmark_index];
+    printf("%-10s: %u pairings, avg. %6u us per pairing, worst-case crypto call %6u us, worst-case interval of %u ms tick %6u us\n",
+           config->name, NUM_PAIRINGS, (unsigned int) (pairing_total_us / NUM_PAIRINGS), (unsigned int) call_max_us,
+           TICK_INTERVAL_MS, (unsigned int) tick_max_gap_us);
+}
+
+static void dhkey_calculated(void * arg){
+    UNUSED(arg);
+    pairing_total_us += time_us() - pairing_start_us;
+    pairings_completed++;
+    if (pairings_completed < NUM_PAIRINGS){
+        // next pairing after a short pause, allowing the run loop to process the tick
+        btstack_run_loop_set_timer(&pairing_timer, PAIRING_PAUSE_MS);
+        btstack_run_loop_add_timer(&pairing_timer);
+        return;
+    }
+    benchmark_report();
+    benchmark_index++;
+    if (benchmark_index < (int) (sizeof(benchmark_configs) / sizeof(benchmark_config_t))){
+        benchmark_start();
+    } else {
+        btstack_run_loop_remove_timer(&tick_timer);
+        btstack_run_loop_trigger_exit();
+    }
+}
+
+static void call_update(uint64_t call_start_us){
+    uint64_t duration = time_us() - call_start_us;
+    if (duration > call_max_us){
+        call_max_us = duration;
+    }
+}
+
+static void key_generated(void * arg){
+    UNUSED(arg);
+    uint64_t call_start_us = time_us();
+    btstack_crypto_ecc_p256_calculate_dhkey(&ecc_request, peer_public_key, dhkey, &dhkey_calculated, NULL);
+    call_update(call_start_us);
+}
+
+static void pairing_start(void){
+    pairing_start_us = time_us();
+    btstack_crypto_ecc_p256_generate_key(&ecc_request, local_public_key, &key_generated, NULL);
+    call_update(pairing_start_us);
+}
+
+static void pairing_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    pairing_start();
+}
+
+static void start_timer_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    benchmark_start();
+}
+
+int main(void){
+
+    // peer key pair
+    uint8_t peer_private_key[32];
+    uECC_set_rng(&benchmark_rng);
+    uECC_make_key(peer_public_key, peer_private_key);
+
+    // run pairings on run loop first, then on worker thread
+    benchmark_configs[0].name   = "run loop";
+    benchmark_configs[0].worker = NULL;
+    benchmark_configs[1].name   = "worker";
+    benchmark_configs[1].worker = btstack_crypto_worker_posix_get_instance();
+
+    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    btstack_crypto_init();
+    tick_last_us = time_us();
+
+    static btstack_timer_source_t start_timer;
+    btstack_run_loop_set_timer_handler(&tick_timer, &tick_handler);
+    btstack_run_loop_set_timer(&tick_timer, TICK_INTERVAL_MS);
+    btstack_run_loop_add_timer(&tick_timer);
+    btstack_run_loop_set_timer_handler(&pairing_timer, &pairing_timer_handler);
+    btstack_run_loop_set_timer_handler(&start_timer, &start_timer_handler);
+    btstack_run_loop_set_timer(&start_timer, 10);
+    btstack_run_loop_add_timer(&start_timer);
+
+    btstack_run_loop_execute();
+    return 0;
+}
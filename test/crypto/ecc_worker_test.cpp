@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+// *****************************************************************************
+//
+// test ECC P-256 key generation and DHKey calculation on worker
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_crypto.h"
+#include "btstack_util.h"
+#include "uECC.h"
+
+// worker stub, work items are executed by test
+static btstack_context_callback_registration_t * worker_work;
+static btstack_context_callback_registration_t * worker_done;
+
+static void worker_stub_execute(btstack_context_callback_registration_t * work, btstack_context_callback_registration_t * done){
+    CHECK(worker_work == NULL);
+    worker_work = work;
+    worker_done = done;
+}
+
+static const btstack_crypto_worker_t worker_stub = {
+    &worker_stub_execute
+};
+
+static bool worker_run(void){
+    if (worker_work == NULL) return false;
+    btstack_context_callback_registration_t * work = worker_work;
+    btstack_context_callback_registration_t * done = worker_done;
+    worker_work = NULL;
+    (*work->callback)(work->context);
+    (*done->callback)(done->context);
+    return true;
+}
+
+static int test_rng(uint8_t * dest, unsigned size){
+    unsigned int i;
+    for (i=0;i<size;i++){
+        dest[i] = (uint8_t) (rand() & 0xff);
+    }
+    return 1;
+}
+
+static bool key_generated;
+static void key_generated_callback(void * arg){
+    UNUSED(arg);
+    key_generated = true;
+}
+
+static bool dhkey_calculated;
+static void dhkey_calculated_callback(void * arg){
+    UNUSED(arg);
+    dhkey_calculated = true;
+}
+
+static bool aes128_done;
+static void aes128_done_callback(void * arg){
+    UNUSED(arg);
+    aes128_done = true;
+}
+
+static btstack_crypto_ecc_p256_t ecc_request;
+static btstack_crypto_aes128_t   aes128_request;
+
+TEST_GROUP(ECC_WORKER){
+    void setup(void){
+        worker_work = NULL;
+        key_generated = false;
+        dhkey_calculated = false;
+        aes128_done = false;
+        btstack_crypto_reset();
+        btstack_crypto_ecc_p256_set_worker(&worker_stub);
+    }
+    void teardown(void){
+        btstack_crypto_ecc_p256_set_worker(NULL);
+    }
+};
+
+TEST(ECC_WORKER, GenerateKeyAndDHKey){
+    uint8_t local_public_key[64];
+    uint8_t peer_public_key[64];
+    uint8_t peer_private_key[32];
+    uint8_t dhkey[32];
+    uint8_t dhkey_expected[32];
+
+    // key generation is executed on worker after random data was collected
+    btstack_crypto_ecc_p256_generate_key(&ecc_request, local_public_key, &key_generated_callback, NULL);
+    CHECK_FALSE(key_generated);
+    CHECK_TRUE(worker_run());
+    CHECK_TRUE(key_generated);
+
+    // peer key pair
+    // RNG stays set, micro-ecc also uses it for uECC_shared_secret
+    uECC_set_rng(&test_rng);
+    CHECK_EQUAL(1, uECC_make_key(peer_public_key, peer_private_key));
+    CHECK_EQUAL(1, uECC_shared_secret(local_public_key, peer_private_key, dhkey_expected));
+
+    // worker stays free for dhkey
+    CHECK_FALSE(worker_run());
+    CHECK_TRUE(btstack_crypto_idle());
+
+    // dhkey is calculated on worker, other operations continue meanwhile
+    btstack_crypto_ecc_p256_calculate_dhkey(&ecc_request, peer_public_key, dhkey, &dhkey_calculated_callback, NULL);
+    CHECK_FALSE(dhkey_calculated);
+    uint8_t key[16] = { 0 };
+    uint8_t plaintext[16] = { 0 };
+    uint8_t ciphertext[16];
+    btstack_crypto_aes128_encrypt(&aes128_request, key, plaintext, ciphertext, &aes128_done_callback, NULL);
+    CHECK_TRUE(aes128_done);
+    CHECK_FALSE(dhkey_calculated);
+    CHECK_TRUE(worker_run());
+    CHECK_TRUE(dhkey_calculated);
+    MEMCMP_EQUAL(dhkey_expected, dhkey, 32);
+
+    // next key pair is pre-generated in the background after dhkey
+    CHECK_TRUE(worker_run());
+    CHECK_TRUE(btstack_crypto_idle());
+
+    // new key pair is provided right away from pre-generated one
+    uint8_t previous_public_key[64];
+    memcpy(previous_public_key, local_public_key, 64);
+    key_generated = false;
+    btstack_crypto_ecc_p256_generate_key(&ecc_request, local_public_key, &key_generated_callback, NULL);
+    CHECK_TRUE(key_generated);
+    CHECK(memcmp(previous_public_key, local_public_key, 64) != 0);
+
+    // and used for dhkey
+    CHECK_EQUAL(1, uECC_shared_secret(local_public_key, peer_private_key, dhkey_expected));
+    dhkey_calculated = false;
+    btstack_crypto_ecc_p256_calculate_dhkey(&ecc_request, peer_public_key, dhkey, &dhkey_calculated_callback, NULL);
+    // dhkey is not delayed by pre-generation of the next key pair
+    CHECK_TRUE(worker_run());
+    CHECK_TRUE(dhkey_calculated);
+    MEMCMP_EQUAL(dhkey_expected, dhkey, 32);
+    CHECK_TRUE(worker_run());
+    CHECK_FALSE(worker_run());
+}
+
+TEST(ECC_WORKER, ResetWhileWorkerActive){
+    uint8_t local_public_key[64];
+    btstack_crypto_ecc_p256_generate_key(&ecc_request, local_public_key, &key_generated_callback, NULL);
+    btstack_crypto_reset();
+    CHECK_FALSE(btstack_crypto_idle());
+    // result of key generation started before reset is ignored
+    CHECK_TRUE(worker_run());
+    CHECK_FALSE(key_generated);
+    CHECK_TRUE(btstack_crypto_idle());
+    // key is generated again for new request
+    btstack_crypto_ecc_p256_generate_key(&ecc_request, local_public_key, &key_generated_callback, NULL);
+    CHECK_FALSE(key_generated);
+    CHECK_TRUE(worker_run());
+    CHECK_TRUE(key_generated);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -40,6 +40,18 @@ static void aes128_report_result(void){
 	mock_simulate_hci_event(&le_enc_result[0], sizeof(le_enc_result));
 }
 
+static void rand_report_result(void){
+	// deterministic pseudo-random data
+	static uint32_t rand_state = 0x12345678;
+	uint8_t le_rand_result[14] = { 0x0e, 0x0c, 0x01, 0x18, 0x20, 0x00 };
+	int i;
+	for (i=0;i<8;i++){
+		rand_state = rand_state * 1103515245u + 12345u;
+		le_rand_result[6+i] = (uint8_t) (rand_state >> 16);
+	}
+	mock_simulate_hci_event(&le_rand_result[0], sizeof(le_rand_result));
+}
+
 uint8_t hci_send_cmd(const hci_cmd_t *cmd, ...){
     va_list argptr;
     va_start(argptr, cmd);
@@ -58,6 +70,9 @@ uint8_t hci_send_cmd(const hci_cmd_t *cmd, ...){
 	    aes128_calc_cyphertext(key, plaintext, aes128_cyphertext);
 	    aes128_report_result();
 	}
+	if (cmd->opcode == hci_le_rand.opcode){
+		rand_report_result();
+	}
 	return ERROR_CODE_SUCCESS;
 }
 
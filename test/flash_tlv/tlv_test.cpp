@@ -305,6 +305,123 @@ TEST(BSTACK_TLV, TestFullBankPlusMigrate){
     CHECK_EQUAL(8 + 2 * (TAG_OVERHEAD + sizeof(blob)), btstack_tlv_context.write_offset);
 }
 
+// count flash reads issued by btstack_tlv_flash_bank
+#define HAL_FLASH_BANK_MEMORY_LARGE_STORAGE_SIZE 1024
+static uint8_t hal_flash_bank_memory_large_storage[HAL_FLASH_BANK_MEMORY_LARGE_STORAGE_SIZE];
+static const hal_flash_bank_t * hal_flash_bank_memory_impl;
+static hal_flash_bank_t hal_flash_bank_counting_impl;
+static int hal_flash_bank_num_reads;
+
+static void hal_flash_bank_counting_read(void * context, int bank, uint32_t offset, uint8_t * buffer, uint32_t size){
+	hal_flash_bank_num_reads++;
+	hal_flash_bank_memory_impl->read(context, bank, offset, buffer, size);
+}
+
+TEST_GROUP(BSTACK_TLV_INDEX){
+	hal_flash_bank_memory_t  hal_flash_bank_context;
+	const btstack_tlv_t *    btstack_tlv_impl;
+	btstack_tlv_flash_bank_t btstack_tlv_context;
+
+	void setup(void){
+		hal_flash_bank_memory_impl = hal_flash_bank_memory_init_instance(&hal_flash_bank_context, hal_flash_bank_memory_large_storage, HAL_FLASH_BANK_MEMORY_LARGE_STORAGE_SIZE);
+		hal_flash_bank_counting_impl = *hal_flash_bank_memory_impl;
+		hal_flash_bank_counting_impl.read = &hal_flash_bank_counting_read;
+		hal_flash_bank_num_reads = 0;
+	}
+
+	void init_tlv(void){
+		btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, &hal_flash_bank_counting_impl, &hal_flash_bank_context);
+	}
+
+	void store_tags(uint32_t num_tags, uint8_t value){
+		uint32_t i;
+		for (i=0;i<num_tags;i++){
+			uint8_t buffer = (uint8_t) (value + i);
+			btstack_tlv_impl->store_tag(&btstack_tlv_context, 'tg00' + i, &buffer, 1);
+		}
+	}
+
+	void check_tags(uint32_t num_tags, uint8_t value){
+		uint32_t i;
+		for (i=0;i<num_tags;i++){
+			uint8_t buffer = 0;
+			CHECK_EQUAL(1, btstack_tlv_impl->get_tag(&btstack_tlv_context, 'tg00' + i, &buffer, 1));
+			CHECK_EQUAL((uint8_t) (value + i), buffer);
+		}
+	}
+};
+
+TEST(BSTACK_TLV_INDEX, ReadsPerOperation){
+	const uint32_t num_tags = 20;
+	init_tlv();
+	store_tags(num_tags, 0);
+
+	// re-init builds index from flash
+	init_tlv();
+	CHECK_TRUE(btstack_tlv_context.index_valid);
+	CHECK_EQUAL(num_tags, btstack_tlv_context.index_count);
+
+	// get: entry header + value
+	hal_flash_bank_num_reads = 0;
+	check_tags(num_tags, 0);
+	CHECK_EQUAL(2 * num_tags, hal_flash_bank_num_reads);
+
+	// get missing tag: no flash access
+	hal_flash_bank_num_reads = 0;
+	CHECK_EQUAL(0, btstack_tlv_impl->get_tag(&btstack_tlv_context, 'miss', NULL, 0));
+	CHECK_EQUAL(0, hal_flash_bank_num_reads);
+
+	// store and delete don't scan the bank
+	hal_flash_bank_num_reads = 0;
+	store_tags(num_tags, 100);
+#ifndef ENABLE_TLV_FLASH_WRITE_ONCE
+	btstack_tlv_impl->delete_tag(&btstack_tlv_context, 'tg00');
+#endif
+	CHECK_EQUAL(0, hal_flash_bank_num_reads);
+#ifndef ENABLE_TLV_FLASH_WRITE_ONCE
+	CHECK_EQUAL(0, btstack_tlv_impl->get_tag(&btstack_tlv_context, 'tg00', NULL, 0));
+	CHECK_EQUAL(num_tags - 1, btstack_tlv_context.index_count);
+	btstack_tlv_impl->store_tag(&btstack_tlv_context, 'tg00', (const uint8_t *) "\x64", 1);
+#endif
+	check_tags(num_tags, 100);
+
+	// index is consistent with flash after reboot
+	init_tlv();
+	check_tags(num_tags, 100);
+}
+
+TEST(BSTACK_TLV_INDEX, Migrate){
+	const uint32_t num_tags = 10;
+	init_tlv();
+	// keep re-writing until bank was switched twice
+	uint8_t value = 0;
+	while (btstack_tlv_context.current_bank == 0){
+		store_tags(num_tags, value++);
+	}
+	while (btstack_tlv_context.current_bank == 1){
+		store_tags(num_tags, value++);
+	}
+	CHECK_TRUE(btstack_tlv_context.index_valid);
+	CHECK_EQUAL(num_tags, btstack_tlv_context.index_count);
+	store_tags(num_tags, value);
+	check_tags(num_tags, value);
+	init_tlv();
+	check_tags(num_tags, value);
+}
+
+TEST(BSTACK_TLV_INDEX, IndexFull){
+	const uint32_t num_tags = BTSTACK_TLV_FLASH_BANK_INDEX_SIZE + 4;
+	init_tlv();
+	store_tags(num_tags, 0);
+	CHECK_FALSE(btstack_tlv_context.index_valid);
+	check_tags(num_tags, 0);
+	store_tags(num_tags, 50);
+	check_tags(num_tags, 50);
+	init_tlv();
+	CHECK_FALSE(btstack_tlv_context.index_valid);
+	check_tags(num_tags, 50);
+}
+
 //
 TEST_GROUP(LINK_KEY_DB){
 	const hal_flash_bank_t * hal_flash_bank_impl;
@@ -387,6 +504,26 @@ TEST(LINK_KEY_DB, KeyReplacement){
     CHECK_EQUAL_ARRAY(link_key1, test_link_key, 16);
 }
 
+TEST(LINK_KEY_DB, SkipUnchangedKey){
+	link_key_t test_link_key;
+    link_key_type_t test_link_key_type;
+    uint32_t num_writes;
+    uint32_t num_writes_saved;
+
+	btstack_link_key_db->put_link_key(addr1, link_key1, link_key_type);
+	btstack_link_key_db->put_link_key(addr1, link_key1, link_key_type);
+	btstack_link_key_db->put_link_key(addr1, link_key2, link_key_type);
+	btstack_link_key_db_tlv_get_write_statistics(&num_writes, &num_writes_saved);
+    CHECK_EQUAL(2, num_writes);
+    CHECK_EQUAL(1, num_writes_saved);
+
+    // reload from TLV
+	btstack_link_key_db = btstack_link_key_db_tlv_get_instance(btstack_tlv_impl, &btstack_tlv_context);
+    CHECK(btstack_link_key_db->get_link_key(addr1, test_link_key, &test_link_key_type) == 1);
+    CHECK_EQUAL_ARRAY(link_key2, test_link_key, 16);
+    CHECK(btstack_link_key_db->get_link_key(addr2, test_link_key, &test_link_key_type) == 0);
+}
+
 int main (int argc, const char * argv[]){
     // log into file using HCI_DUMP_PACKETLOGGER format
 #ifdef ENABLE_TLV_FLASH_WRITE_ONCE
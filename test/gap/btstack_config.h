@@ -14,6 +14,7 @@
 // BTstack features that can be enabled
 #define ENABLE_BLE
 #define ENABLE_LE_CENTRAL
+#define ENABLE_LE_ISOCHRONOUS_STREAMS
 #define ENABLE_LE_PERIPHERAL
 #define ENABLE_LE_SIGNED_WRITE
 #define ENABLE_LOG_ERROR
@@ -24,6 +25,7 @@
 // BTstack configuration. buffers, sizes, ...
 #define HCI_ACL_PAYLOAD_SIZE 1024
 #define HCI_INCOMING_PRE_BUFFER_SIZE 6
+#define MAX_NR_CONTROLLER_HCI_COMMANDS 4
 #define NVM_NUM_DEVICE_DB_ENTRIES 4
 #define NVM_NUM_LINK_KEYS 2
 
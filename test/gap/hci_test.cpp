@@ -29,6 +29,13 @@ typedef struct {
 static uint16_t transport_count_packets;
 static hci_packet_t transport_packets[MAX_HCI_PACKETS];
 
+static btstack_run_loop_t test_run_loop;
+static uint32_t test_time_ms;
+
+static uint32_t test_get_time_ms(void){
+    return test_time_ms;
+}
+
 static  void (*packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
 
 static const uint8_t packet_sent_event[] = { HCI_EVENT_TRANSPORT_PACKET_SENT, 0};
@@ -37,18 +44,25 @@ static int hci_transport_test_set_baudrate(uint32_t baudrate){
     return 0;
 }
 
+static bool transport_send_active;
+
 static int hci_transport_test_can_send_now(uint8_t packet_type){
-    return 1;
+    return transport_send_active ? 0 : 1;
 }
 
+static bool transport_send_fails;
+
 static int hci_transport_test_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (transport_send_fails) return -1;
     btstack_assert(transport_count_packets < MAX_HCI_PACKETS);
     memcpy(transport_packets[transport_count_packets].buffer, packet, size);
     transport_packets[transport_count_packets].type = packet_type;
     transport_packets[transport_count_packets].size = size;
     transport_count_packets++;
-    // notify upper stack that it can send again
+    // notify upper stack that it can send again, busy until then as an asynchronous transport
+    transport_send_active = true;
     packet_handler(HCI_EVENT_PACKET, (uint8_t *) &packet_sent_event[0], sizeof(packet_sent_event));
+    transport_send_active = false;
     return 0;
 }
 
@@ -380,7 +394,349 @@ TEST(HCI, GetRole){
     gap_get_role(5);
 }
 
+static void hci_test_emit_command_complete(uint16_t opcode, uint8_t num_hci_command_packets){
+    uint8_t event[] = { HCI_EVENT_COMMAND_COMPLETE, 4, num_hci_command_packets, 0, 0, ERROR_CODE_SUCCESS};
+    little_endian_store_16(event, 3, opcode);
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void hci_test_emit_command_status(uint16_t opcode, uint8_t num_hci_command_packets){
+    uint8_t event[] = { HCI_EVENT_COMMAND_STATUS, 4, ERROR_CODE_SUCCESS, num_hci_command_packets, 0, 0};
+    little_endian_store_16(event, 4, opcode);
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static uint8_t hci_test_send_commands(const hci_cmd_t * cmd, uint8_t num_commands){
+    uint8_t num_sent = 0;
+    while ((num_sent < num_commands) && hci_can_send_command_packet_now()){
+        uint8_t status = hci_send_cmd(cmd);
+        if (status != ERROR_CODE_SUCCESS) break;
+        num_sent++;
+    }
+    return num_sent;
+}
+
+// Mock Controller that provides multiple command credits, see MAX_NR_CONTROLLER_HCI_COMMANDS in btstack_config.h
+TEST_GROUP(HCI_COMMAND_PIPELINING){
+    void setup(void){
+        transport_count_packets = 0;
+        transport_send_fails = false;
+        next_hci_packet = 0;
+        hci_init(&hci_transport_test, NULL);
+        hci_simulate_working_fuzz();
+        // provide initial credits
+        hci_test_emit_command_complete(0x0000, 1);
+        transport_count_packets = 0;
+    }
+    void teardown(void){
+        hci_deinit();
+    }
+};
+
+TEST(HCI_COMMAND_PIPELINING, SingleCredit){
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_rand, 3));
+    CHECK_FALSE(hci_can_send_command_packet_now());
+    hci_test_emit_command_complete(HCI_OPCODE_HCI_LE_RAND, 1);
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_rand, 3));
+    CHECK_EQUAL(2, transport_count_packets);
+}
+
+TEST(HCI_COMMAND_PIPELINING, MultipleCredits){
+    hci_test_emit_command_complete(0x0000, 3);
+    CHECK_EQUAL(3, hci_test_send_commands(&hci_le_rand, 5));
+    CHECK_FALSE(hci_can_send_command_packet_now());
+    CHECK_EQUAL(3, transport_count_packets);
+    CHECK_HCI_COMMAND(&hci_le_rand);
+    CHECK_HCI_COMMAND(&hci_le_rand);
+    CHECK_HCI_COMMAND(&hci_le_rand);
+
+    // first command completes, Controller can accept one more
+    hci_test_emit_command_complete(HCI_OPCODE_HCI_LE_RAND, 1);
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_rand, 5));
+
+    // remaining commands complete, all credits available again
+    hci_test_emit_command_complete(HCI_OPCODE_HCI_LE_RAND, 3);
+    hci_test_emit_command_complete(HCI_OPCODE_HCI_LE_RAND, 3);
+    hci_test_emit_command_complete(HCI_OPCODE_HCI_LE_RAND, 3);
+    CHECK_EQUAL(3, hci_test_send_commands(&hci_le_rand, 5));
+    CHECK_EQUAL(7, transport_count_packets);
+}
+
+TEST(HCI_COMMAND_PIPELINING, CreditsLimitedByConfig){
+    hci_test_emit_command_complete(0x0000, 10);
+    CHECK_EQUAL(MAX_NR_CONTROLLER_HCI_COMMANDS, hci_test_send_commands(&hci_le_rand, 10));
+    CHECK_FALSE(hci_can_send_command_packet_now());
+}
+
+TEST(HCI_COMMAND_PIPELINING, CreditsLimitedByOutstandingCommands){
+    hci_test_emit_command_complete(0x0000, 3);
+    CHECK_EQUAL(3, hci_test_send_commands(&hci_le_rand, 3));
+    // stale credit report generated before the Controller received the last command
+    hci_test_emit_command_complete(HCI_OPCODE_HCI_LE_RAND, 3);
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_rand, 3));
+}
+
+TEST(HCI_COMMAND_PIPELINING, CommandStatus){
+    hci_test_emit_command_complete(0x0000, 2);
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_rand, 1));
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_read_local_supported_features, 1));
+    CHECK_FALSE(hci_can_send_command_packet_now());
+    // command status for second command frees one slot
+    hci_test_emit_command_status(HCI_OPCODE_HCI_LE_READ_LOCAL_SUPPORTED_FEATURES, 1);
+    CHECK_TRUE(hci_can_send_command_packet_now());
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_read_local_supported_features, 2));
+    CHECK_FALSE(hci_can_send_command_packet_now());
+}
+
+TEST(HCI_COMMAND_PIPELINING, NoCredits){
+    hci_test_emit_command_complete(0x0000, 0);
+    CHECK_FALSE(hci_can_send_command_packet_now());
+    CHECK_EQUAL(0, hci_test_send_commands(&hci_le_rand, 1));
+    hci_test_emit_command_complete(0x0000, 2);
+    CHECK_EQUAL(2, hci_test_send_commands(&hci_le_rand, 3));
+}
+
+TEST(HCI_COMMAND_PIPELINING, VendorCommandNotPipelined){
+    const hci_cmd_t hci_vendor_test = { HCI_OPCODE(OGF_VENDOR, 0x01), "" };
+    hci_test_emit_command_complete(0x0000, 4);
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_rand, 1));
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_vendor_test, 1));
+    CHECK_FALSE(hci_can_send_command_packet_now());
+    hci_test_emit_command_complete(hci_vendor_test.opcode, 4);
+    CHECK_TRUE(hci_can_send_command_packet_now());
+    CHECK_EQUAL(2, hci_test_send_commands(&hci_le_rand, 2));
+}
+
+TEST(HCI_COMMAND_PIPELINING, LostCompletionResyncOnNop){
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_rand, 1));
+    CHECK_FALSE(hci_can_send_command_packet_now());
+    // Command Complete for LE Rand lost, Controller reports free slot with NOP
+    hci_test_emit_command_complete(0x0000, 1);
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_rand, 1));
+}
+
+TEST(HCI_COMMAND_PIPELINING, LostCompletionResyncOnUnmatchedCompletion){
+    hci_test_emit_command_complete(0x0000, 2);
+    CHECK_EQUAL(2, hci_test_send_commands(&hci_le_rand, 2));
+    CHECK_FALSE(hci_can_send_command_packet_now());
+    // completion for a command that is not outstanding, e.g. sent before the window was tracked
+    hci_test_emit_command_complete(HCI_OPCODE_HCI_LE_READ_LOCAL_SUPPORTED_FEATURES, 2);
+    CHECK_EQUAL(2, hci_test_send_commands(&hci_le_rand, 2));
+}
+
+TEST(HCI_COMMAND_PIPELINING, SendFailureReleasesCredit){
+    transport_send_fails = true;
+    CHECK_EQUAL(ERROR_CODE_HARDWARE_FAILURE, hci_send_cmd(&hci_le_rand));
+    CHECK_TRUE(hci_can_send_command_packet_now());
+    transport_send_fails = false;
+    CHECK_EQUAL(1, hci_test_send_commands(&hci_le_rand, 2));
+    CHECK_EQUAL(1, transport_count_packets);
+    // completion for command that was sent frees the slot
+    hci_test_emit_command_complete(HCI_OPCODE_HCI_LE_RAND, 1);
+    CHECK_TRUE(hci_can_send_command_packet_now());
+}
+
+// Mock Controller with ISO buffers and two CIS accepted as Peripheral
+#define ISO_TEST_CIS_A 0x0100
+#define ISO_TEST_CIS_B 0x0101
+
+static void hci_test_emit_le_read_buffer_size_v2(uint8_t num_iso_buffers){
+    uint8_t event[] = { HCI_EVENT_COMMAND_COMPLETE, 10, 1, 0, 0, ERROR_CODE_SUCCESS, 0xfb, 0, 4, 100, 0, 0};
+    little_endian_store_16(event, 3, HCI_OPCODE_HCI_LE_READ_BUFFER_SIZE_V2);
+    event[11] = num_iso_buffers;
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void hci_test_setup_cis(hci_con_handle_t cis_handle, uint16_t iso_interval){
+    // CIS Request
+    uint8_t request[] = { HCI_EVENT_LE_META, 7, HCI_SUBEVENT_LE_CIS_REQUEST, 0, 0, 0, 0, 1, 0};
+    little_endian_store_16(request, 3, 0x0001);
+    little_endian_store_16(request, 5, cis_handle);
+    request[8] = (uint8_t) (cis_handle & 0xff);
+    packet_handler(HCI_EVENT_PACKET, request, sizeof(request));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_cis_accept(cis_handle));
+    hci_test_emit_command_status(HCI_OPCODE_HCI_LE_ACCEPT_CIS_REQUEST, 1);
+    // CIS Established, peripheral sends data
+    uint8_t established[31];
+    memset(established, 0, sizeof(established));
+    established[0] = HCI_EVENT_LE_META;
+    established[1] = sizeof(established) - 2;
+    established[2] = HCI_SUBEVENT_LE_CIS_ESTABLISHED;
+    established[3] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(established, 4, cis_handle);
+    little_endian_store_16(established, 27, 40);
+    little_endian_store_16(established, 29, iso_interval);
+    packet_handler(HCI_EVENT_PACKET, established, sizeof(established));
+    hci_test_emit_command_complete(HCI_OPCODE_HCI_LE_SETUP_ISO_DATA_PATH, 1);
+}
+
+static uint8_t hci_test_send_iso_sdu_with_len(hci_con_handle_t cis_handle, uint8_t sdu_id, uint16_t sdu_len){
+    CHECK_TRUE(hci_reserve_packet_buffer());
+    uint8_t * buffer = hci_get_outgoing_packet_buffer();
+    little_endian_store_16(buffer, 0, cis_handle);
+    little_endian_store_16(buffer, 2, 4 + sdu_len);
+    little_endian_store_16(buffer, 4, sdu_id);
+    little_endian_store_16(buffer, 6, sdu_len);
+    memset(&buffer[8], sdu_id, sdu_len);
+    return hci_send_iso_packet_buffer(8 + sdu_len);
+}
+
+static uint8_t hci_test_send_iso_sdu(hci_con_handle_t cis_handle, uint8_t sdu_id){
+    return hci_test_send_iso_sdu_with_len(cis_handle, sdu_id, 1);
+}
+
+static void hci_test_emit_iso_completed(hci_con_handle_t cis_handle){
+    uint8_t event[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 1, 0};
+    little_endian_store_16(event, 3, cis_handle);
+    packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// check next ISO packet sent to Controller
+static void CHECK_ISO_SDU(hci_con_handle_t expected_cis_handle, uint8_t expected_sdu_id){
+    while ((next_hci_packet < transport_count_packets) && (transport_packets[next_hci_packet].type != HCI_ISO_DATA_PACKET)){
+        next_hci_packet++;
+    }
+    CHECK(next_hci_packet < transport_count_packets);
+    const uint8_t * packet = transport_packets[next_hci_packet].buffer;
+    next_hci_packet++;
+    CHECK_EQUAL(expected_cis_handle, little_endian_read_16(packet, 0) & 0x0fff);
+    CHECK_EQUAL(expected_sdu_id, packet[8]);
+}
+
+static void CHECK_NO_ISO_SDU(void){
+    while (next_hci_packet < transport_count_packets){
+        CHECK(transport_packets[next_hci_packet].type != HCI_ISO_DATA_PACKET);
+        next_hci_packet++;
+    }
+}
+
+TEST_GROUP(HCI_ISO){
+    void setup(void){
+        transport_count_packets = 0;
+        transport_send_fails = false;
+        next_hci_packet = 0;
+        hci_init(&hci_transport_test, NULL);
+        hci_simulate_working_fuzz();
+        hci_test_emit_command_complete(0x0000, 1);
+    }
+    void teardown(void){
+        hci_deinit();
+    }
+    void setup_streams(uint8_t num_iso_buffers, uint16_t iso_interval){
+        hci_test_emit_le_read_buffer_size_v2(num_iso_buffers);
+        hci_test_setup_cis(ISO_TEST_CIS_A, iso_interval);
+        hci_test_setup_cis(ISO_TEST_CIS_B, iso_interval);
+        transport_count_packets = 0;
+        next_hci_packet = 0;
+    }
+};
+
+TEST(HCI_ISO, CreditAccounting){
+    setup_streams(2, 0x0c80);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 1));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_B, 1));
+    CHECK_ISO_SDU(ISO_TEST_CIS_A, 1);
+    CHECK_ISO_SDU(ISO_TEST_CIS_B, 1);
+    // no Controller buffer left, SDU gets queued
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 2));
+    CHECK_NO_ISO_SDU();
+    // completed packet on other stream frees buffer for queued SDU
+    hci_test_emit_iso_completed(ISO_TEST_CIS_B);
+    CHECK_ISO_SDU(ISO_TEST_CIS_A, 2);
+    // stream B may send directly after completion on stream A
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_B, 2));
+    CHECK_NO_ISO_SDU();
+    hci_test_emit_iso_completed(ISO_TEST_CIS_A);
+    CHECK_ISO_SDU(ISO_TEST_CIS_B, 2);
+    hci_test_emit_iso_completed(ISO_TEST_CIS_A);
+    hci_test_emit_iso_completed(ISO_TEST_CIS_B);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 3));
+    CHECK_ISO_SDU(ISO_TEST_CIS_A, 3);
+}
+
+TEST(HCI_ISO, CreditAccountingFragmentedSdu){
+    // SDU with 150 bytes needs two HCI ISO Data packets of max. 100 bytes
+    setup_streams(2, 0x0c80);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu_with_len(ISO_TEST_CIS_A, 1, 150));
+    CHECK_ISO_SDU(ISO_TEST_CIS_A, 1);
+    CHECK_EQUAL(ISO_TEST_CIS_A, little_endian_read_16(transport_packets[next_hci_packet].buffer, 0) & 0x0fff);
+    next_hci_packet++;
+    // both Controller buffers used by one SDU
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_B, 1));
+    CHECK_NO_ISO_SDU();
+    hci_test_emit_iso_completed(ISO_TEST_CIS_A);
+    CHECK_ISO_SDU(ISO_TEST_CIS_B, 1);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_B, 2));
+    CHECK_NO_ISO_SDU();
+    hci_test_emit_iso_completed(ISO_TEST_CIS_A);
+    CHECK_ISO_SDU(ISO_TEST_CIS_B, 2);
+}
+
+TEST(HCI_ISO, OldestFirstAcrossStreams){
+    setup_streams(1, 0x0c80);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 1));
+    CHECK_ISO_SDU(ISO_TEST_CIS_A, 1);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_B, 1));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 2));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_B, 2));
+    CHECK_NO_ISO_SDU();
+    hci_test_emit_iso_completed(ISO_TEST_CIS_A);
+    CHECK_ISO_SDU(ISO_TEST_CIS_B, 1);
+    CHECK_NO_ISO_SDU();
+    hci_test_emit_iso_completed(ISO_TEST_CIS_B);
+    CHECK_ISO_SDU(ISO_TEST_CIS_A, 2);
+    CHECK_NO_ISO_SDU();
+    hci_test_emit_iso_completed(ISO_TEST_CIS_A);
+    CHECK_ISO_SDU(ISO_TEST_CIS_B, 2);
+    CHECK_NO_ISO_SDU();
+}
+
+TEST(HCI_ISO, SharedQueueFull){
+    setup_streams(1, 0x0c80);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 1));
+    CHECK_ISO_SDU(ISO_TEST_CIS_A, 1);
+    uint8_t i;
+    for (i=0;i<MAX_NR_HCI_ISO_TX_QUEUED_PACKETS;i++){
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 2 + i));
+    }
+    uint32_t num_sdus_late;
+    uint32_t num_sdus_dropped;
+    // queue full and no SDU queued for stream B: new SDU is dropped
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_B, 1));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_iso_stream_get_tx_statistics(ISO_TEST_CIS_B, &num_sdus_late, &num_sdus_dropped));
+    CHECK_EQUAL(1, num_sdus_dropped);
+    // queue full: oldest SDU of stream A is dropped
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 10));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_iso_stream_get_tx_statistics(ISO_TEST_CIS_A, &num_sdus_late, &num_sdus_dropped));
+    CHECK_EQUAL(1, num_sdus_dropped);
+    CHECK_NO_ISO_SDU();
+    hci_test_emit_iso_completed(ISO_TEST_CIS_A);
+    CHECK_ISO_SDU(ISO_TEST_CIS_A, 3);
+}
+
+TEST(HCI_ISO, LateSduDroppedAfterIsoInterval){
+    // CIS accepted as Peripheral: SDU interval unknown, ISO interval 10 ms used instead
+    setup_streams(1, 8);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 1));
+    CHECK_ISO_SDU(ISO_TEST_CIS_A, 1);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 2));
+    test_time_ms += 30;
+    hci_test_emit_iso_completed(ISO_TEST_CIS_A);
+    CHECK_NO_ISO_SDU();
+    uint32_t num_sdus_late;
+    uint32_t num_sdus_dropped;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_iso_stream_get_tx_statistics(ISO_TEST_CIS_A, &num_sdus_late, &num_sdus_dropped));
+    CHECK_EQUAL(1, num_sdus_late);
+    CHECK_EQUAL(0, num_sdus_dropped);
+    // Controller buffer is free again
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, hci_test_send_iso_sdu(ISO_TEST_CIS_A, 3));
+    CHECK_ISO_SDU(ISO_TEST_CIS_A, 3);
+}
+
 int main (int argc, const char * argv[]){
-    btstack_run_loop_init(btstack_run_loop_posix_get_instance());
+    // posix run loop with mocked time
+    test_run_loop = *btstack_run_loop_posix_get_instance();
+    test_run_loop.get_time_ms = &test_get_time_ms;
+    btstack_run_loop_init(&test_run_loop);
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
@@ -19,12 +20,15 @@
 #include "btstack_memory.h"
 #include "hci.h"
 #include "hci_dump.h"
+#include "btstack_event.h"
 #include "ble/gatt_client.h"
 #include "ble/att_db.h"
 #include "profile.h"
 #include "expected_results.h"
 
 extern "C" void hci_setup_le_connection(uint16_t con_handle);
+extern "C" void mock_simulate_att_notification(uint16_t con_handle, uint16_t value_handle, const uint8_t * value, uint16_t value_len);
+extern "C" void mock_simulate_att_multiple_notification(uint16_t con_handle, const uint8_t * tuples, uint16_t tuples_len);
 
 static uint16_t gatt_client_handle = 0x40;
 static int gatt_query_complete = 0;
@@ -1134,6 +1138,40 @@ TEST(GATTClient, gatt_client_read_multiple_characteristic_values){
     CHECK_EQUAL(GATT_CLIENT_IN_WRONG_STATE, status);
 }
 
+TEST(GATTClient, gatt_client_read_multiple_variable_characteristic_values){
+	test = READ_CHARACTERISTIC_VALUE;
+	reset_query_state();
+	status = gatt_client_discover_primary_services_by_uuid16(handle_ble_client_event, gatt_client_handle, service_uuid16);
+	CHECK_EQUAL(0, status);
+	CHECK_EQUAL(1, gatt_query_complete);
+	CHECK_EQUAL(1, result_counter);
+
+	reset_query_state();
+	status = gatt_client_discover_characteristics_for_service_by_uuid16(handle_ble_client_event, gatt_client_handle, &services[0], 0xF100);
+	CHECK_EQUAL(0, status);
+	CHECK_EQUAL(1, gatt_query_complete);
+	CHECK_EQUAL(1, result_counter);
+
+	uint16_t value_handles[] = {characteristics[0].value_handle, characteristics[0].value_handle};
+
+	// one value query result per handle, plus two read callbacks per handle in the server
+	reset_query_state();
+	status = gatt_client_read_multiple_variable_characteristic_values(handle_ble_client_event, gatt_client_handle, 2, value_handles);
+	CHECK_EQUAL(0, status);
+	CHECK_EQUAL(1, gatt_query_complete);
+	CHECK_EQUAL(6, result_counter);
+
+	reset_query_state();
+	// invalid con handle
+	status = gatt_client_read_multiple_variable_characteristic_values(handle_ble_client_event, HCI_CON_HANDLE_INVALID, 2, value_handles);
+	CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, status);
+
+	reset_query_state();
+	set_wrong_gatt_client_state();
+	status = gatt_client_read_multiple_variable_characteristic_values(handle_ble_client_event, gatt_client_handle, 2, value_handles);
+	CHECK_EQUAL(GATT_CLIENT_IN_WRONG_STATE, status);
+}
+
 TEST(GATTClient, gatt_client_write_value_of_characteristic_without_response){
 	reset_query_state();
 	status = gatt_client_discover_primary_services_by_uuid16(handle_ble_client_event, gatt_client_handle, service_uuid16);
@@ -1194,6 +1232,155 @@ TEST(GATTClient, register_for_notification){
 	gatt_client_stop_listening_for_characteristic_value_updates(&notification);
 }
 
+#define NOTIFICATION_BENCHMARK_NUM_LISTENERS      1000
+#define NOTIFICATION_BENCHMARK_NUM_VALUE_HANDLES   50
+#define NOTIFICATION_BENCHMARK_NUM_ROUNDS          20
+
+static gatt_client_notification_t notification_listeners[NOTIFICATION_BENCHMARK_NUM_LISTENERS];
+static uint32_t notifications_received;
+static uint16_t notification_last_value_handle;
+
+static void handle_notification_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+	if (packet_type != HCI_EVENT_PACKET) return;
+	if (hci_event_packet_get_type(packet) != GATT_EVENT_NOTIFICATION) return;
+	notifications_received++;
+	notification_last_value_handle = gatt_event_notification_get_value_handle(packet);
+}
+
+static uint32_t time_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t) (ts.tv_sec * 1000000000ul + ts.tv_nsec);
+}
+
+TEST(GATTClient, notification_listeners_many_registrations){
+	// listeners for 20 connections with 50 value handles each, first connection is the one of the mock
+	gatt_client_characteristic_t characteristic;
+	memset(&characteristic, 0, sizeof(characteristic));
+	uint16_t i;
+	for (i=0;i<NOTIFICATION_BENCHMARK_NUM_LISTENERS;i++){
+		hci_con_handle_t con_handle = gatt_client_handle + (i / NOTIFICATION_BENCHMARK_NUM_VALUE_HANDLES);
+		characteristic.value_handle = 0x100 + (i % NOTIFICATION_BENCHMARK_NUM_VALUE_HANDLES);
+		gatt_client_listen_for_characteristic_value_updates(&notification_listeners[i], &handle_notification_event, con_handle, &characteristic);
+	}
+	const uint8_t value[] = { 0x01, 0x02 };
+
+	// exact match
+	notifications_received = 0;
+	mock_simulate_att_notification(gatt_client_handle, 0x105, value, sizeof(value));
+	CHECK_EQUAL(1, notifications_received);
+	CHECK_EQUAL(0x105, notification_last_value_handle);
+
+	// no listener for value handle
+	notifications_received = 0;
+	mock_simulate_att_notification(gatt_client_handle, 0x200, value, sizeof(value));
+	CHECK_EQUAL(0, notifications_received);
+
+	// wildcard listeners for all value handles of connection and for all connections get all notifications
+	gatt_client_notification_t listener_any_value_handle;
+	gatt_client_notification_t listener_any_connection;
+	gatt_client_listen_for_characteristic_value_updates(&listener_any_value_handle, &handle_notification_event, gatt_client_handle, NULL);
+	gatt_client_listen_for_characteristic_value_updates(&listener_any_connection, &handle_notification_event, GATT_CLIENT_ANY_CONNECTION, NULL);
+	notifications_received = 0;
+	mock_simulate_att_notification(gatt_client_handle, 0x105, value, sizeof(value));
+	CHECK_EQUAL(3, notifications_received);
+	notifications_received = 0;
+	mock_simulate_att_notification(gatt_client_handle, 0x200, value, sizeof(value));
+	CHECK_EQUAL(2, notifications_received);
+	gatt_client_stop_listening_for_characteristic_value_updates(&listener_any_value_handle);
+	gatt_client_stop_listening_for_characteristic_value_updates(&listener_any_connection);
+
+	// measure time per notification
+	notifications_received = 0;
+	uint16_t round;
+	uint32_t start_ns = time_ns();
+	for (round=0;round<NOTIFICATION_BENCHMARK_NUM_ROUNDS;round++){
+		for (i=0;i<NOTIFICATION_BENCHMARK_NUM_VALUE_HANDLES;i++){
+			mock_simulate_att_notification(gatt_client_handle, 0x100 + i, value, sizeof(value));
+		}
+	}
+	uint32_t notification_ns = (time_ns() - start_ns) / (NOTIFICATION_BENCHMARK_NUM_ROUNDS * NOTIFICATION_BENCHMARK_NUM_VALUE_HANDLES);
+	CHECK_EQUAL(NOTIFICATION_BENCHMARK_NUM_ROUNDS * NOTIFICATION_BENCHMARK_NUM_VALUE_HANDLES, notifications_received);
+	printf("GATT Client with %u listeners: %u ns per notification\n", NOTIFICATION_BENCHMARK_NUM_LISTENERS, (int) notification_ns);
+
+	// stop listening
+	for (i=0;i<NOTIFICATION_BENCHMARK_NUM_LISTENERS;i++){
+		gatt_client_stop_listening_for_characteristic_value_updates(&notification_listeners[i]);
+	}
+	notifications_received = 0;
+	mock_simulate_att_notification(gatt_client_handle, 0x105, value, sizeof(value));
+	CHECK_EQUAL(0, notifications_received);
+}
+
+#define MULTIPLE_NOTIFICATION_MAX_VALUES 4
+
+static uint16_t multiple_notification_value_handles[MULTIPLE_NOTIFICATION_MAX_VALUES];
+static uint8_t  multiple_notification_values[MULTIPLE_NOTIFICATION_MAX_VALUES][4];
+static uint16_t multiple_notification_values_len[MULTIPLE_NOTIFICATION_MAX_VALUES];
+static uint8_t  multiple_notification_count;
+
+static void handle_multiple_notification_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+	if (packet_type != HCI_EVENT_PACKET) return;
+	if (hci_event_packet_get_type(packet) != GATT_EVENT_NOTIFICATION) return;
+	if (multiple_notification_count >= MULTIPLE_NOTIFICATION_MAX_VALUES) return;
+	uint16_t value_len = gatt_event_notification_get_value_length(packet);
+	multiple_notification_value_handles[multiple_notification_count] = gatt_event_notification_get_value_handle(packet);
+	multiple_notification_values_len[multiple_notification_count] = value_len;
+	memcpy(multiple_notification_values[multiple_notification_count], gatt_event_notification_get_value(packet), btstack_min(value_len, 4));
+	multiple_notification_count++;
+}
+
+TEST(GATTClient, multiple_notification_demux){
+	gatt_client_characteristic_t characteristic;
+	memset(&characteristic, 0, sizeof(characteristic));
+	gatt_client_notification_t listener_a;
+	gatt_client_notification_t listener_b;
+	characteristic.value_handle = 0x0105;
+	gatt_client_listen_for_characteristic_value_updates(&listener_a, &handle_multiple_notification_event, gatt_client_handle, &characteristic);
+	characteristic.value_handle = 0x0107;
+	gatt_client_listen_for_characteristic_value_updates(&listener_b, &handle_multiple_notification_event, gatt_client_handle, &characteristic);
+
+	// three Handle Length Value tuples, one without listener
+	const uint8_t tuples[] = {
+		0x05, 0x01, 0x02, 0x00, 0xa1, 0xa2,
+		0x06, 0x01, 0x01, 0x00, 0xb1,
+		0x07, 0x01, 0x03, 0x00, 0xc1, 0xc2, 0xc3,
+	};
+	multiple_notification_count = 0;
+	mock_simulate_att_multiple_notification(gatt_client_handle, tuples, sizeof(tuples));
+	CHECK_EQUAL(2, multiple_notification_count);
+	CHECK_EQUAL(0x0105, multiple_notification_value_handles[0]);
+	CHECK_EQUAL(2, multiple_notification_values_len[0]);
+	MEMCMP_EQUAL(&tuples[4], multiple_notification_values[0], 2);
+	CHECK_EQUAL(0x0107, multiple_notification_value_handles[1]);
+	CHECK_EQUAL(3, multiple_notification_values_len[1]);
+	MEMCMP_EQUAL(&tuples[15], multiple_notification_values[1], 3);
+
+	// truncated value of last tuple is dropped, complete tuples are reported
+	const uint8_t tuples_truncated_value[] = {
+		0x05, 0x01, 0x01, 0x00, 0xa1,
+		0x07, 0x01, 0x04, 0x00, 0xc1, 0xc2,
+	};
+	multiple_notification_count = 0;
+	mock_simulate_att_multiple_notification(gatt_client_handle, tuples_truncated_value, sizeof(tuples_truncated_value));
+	CHECK_EQUAL(1, multiple_notification_count);
+	CHECK_EQUAL(0x0105, multiple_notification_value_handles[0]);
+	CHECK_EQUAL(1, multiple_notification_values_len[0]);
+
+	// truncated Handle Length header is ignored
+	const uint8_t tuples_truncated_header[] = {
+		0x07, 0x01, 0x01, 0x00, 0xc1,
+		0x05, 0x01, 0x01,
+	};
+	multiple_notification_count = 0;
+	mock_simulate_att_multiple_notification(gatt_client_handle, tuples_truncated_header, sizeof(tuples_truncated_header));
+	CHECK_EQUAL(1, multiple_notification_count);
+	CHECK_EQUAL(0x0107, multiple_notification_value_handles[0]);
+
+	gatt_client_stop_listening_for_characteristic_value_updates(&listener_a);
+	gatt_client_stop_listening_for_characteristic_value_updates(&listener_b);
+}
+
 TEST(GATTClient, gatt_client_signed_write_without_response){
 	reset_query_state();
 	status = gatt_client_discover_primary_services_by_uuid16(handle_ble_client_event, gatt_client_handle, service_uuid16);
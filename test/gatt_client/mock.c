@@ -44,6 +44,27 @@ void mock_simulate_connected(void){
 	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
 }
 
+void mock_simulate_att_notification(uint16_t con_handle, uint16_t value_handle, const uint8_t * value, uint16_t value_len){
+	// notification is reported in-place, provide pre-buffer
+	uint8_t buffer[PREBUFFER_SIZE + TEST_MAX_MTU];
+	uint8_t * packet = &buffer[PREBUFFER_SIZE];
+	if (value_len > (TEST_MAX_MTU - 3)) return;
+	packet[0] = ATT_HANDLE_VALUE_NOTIFICATION;
+	little_endian_store_16(packet, 1, value_handle);
+	memcpy(&packet[3], value, value_len);
+	att_packet_handler(ATT_DATA_PACKET, con_handle, packet, 3 + value_len);
+}
+
+void mock_simulate_att_multiple_notification(uint16_t con_handle, const uint8_t * tuples, uint16_t tuples_len){
+	// notifications are reported in-place, provide pre-buffer
+	uint8_t buffer[PREBUFFER_SIZE + TEST_MAX_MTU];
+	uint8_t * packet = &buffer[PREBUFFER_SIZE];
+	if (tuples_len > (TEST_MAX_MTU - 1)) return;
+	packet[0] = ATT_MULTIPLE_HANDLE_VALUE_NTF;
+	memcpy(&packet[1], tuples, tuples_len);
+	att_packet_handler(ATT_DATA_PACKET, con_handle, packet, 1 + tuples_len);
+}
+
 void mock_simulate_scan_response(void){
 	uint8_t packet[] = {GAP_EVENT_ADVERTISING_REPORT, 0x13, 0xE2, 0x01, 0x34, 0xB1, 0xF7, 0xD1, 0x77, 0x9B, 0xCC, 0x09, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
 	registered_hci_event_handler(HCI_EVENT_PACKET, 0, (uint8_t *)&packet, sizeof(packet));
@@ -0,0 +1,34 @@
+//
+// btstack_config.h for GATT over Enhanced ATT tests, LE only
+//
+
+#ifndef BTSTACK_CONFIG_H
+#define BTSTACK_CONFIG_H
+
+// Port related features
+#define HAVE_MALLOC
+#define HAVE_POSIX_FILE_IO
+#define HAVE_POSIX_TIME
+
+// BTstack features that can be enabled
+#define ENABLE_BLE
+#define ENABLE_LE_CENTRAL
+#define ENABLE_LE_PERIPHERAL
+#define ENABLE_LE_SIGNED_WRITE
+#define ENABLE_LOG_ERROR
+#define ENABLE_LOG_INFO
+#define ENABLE_PRINTF_HEXDUMP
+#define ENABLE_L2CAP_LE_CREDIT_BASED_FLOW_CONTROL_MODE
+#define ENABLE_L2CAP_ENHANCED_CREDIT_BASED_FLOW_CONTROL_MODE
+#define ENABLE_GATT_OVER_EATT
+
+// for ready-to-use hci channels
+#define FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
+
+// BTstack configuration. buffers, sizes, ...
+#define HCI_ACL_PAYLOAD_SIZE 300
+#define HCI_INCOMING_PRE_BUFFER_SIZE 4
+
+#define MAX_NR_LE_DEVICE_DB_ENTRIES 4
+
+#endif
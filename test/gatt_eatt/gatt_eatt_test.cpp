@@ -0,0 +1,592 @@
+// *****************************************************************************
+//
+// test GATT over Enhanced ATT bearers: ATT Server and GATT Client over L2CAP ECBM on PSM 0x0027
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "ble/att_db.h"
+#include "ble/att_server.h"
+#include "ble/gatt_client.h"
+#include "ble/le_device_db.h"
+#include "bluetooth_gatt.h"
+#include "bluetooth_psm.h"
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop_embedded.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "hci_dump_posix_stdout.h"
+#include "hci_transport.h"
+#include "l2cap.h"
+#include "profile.h"
+
+// hal_cpu
+#include "hal_cpu.h"
+void hal_cpu_disable_irqs(void){}
+void hal_cpu_enable_irqs(void){}
+void hal_cpu_enable_irqs_and_sleep(void){}
+
+// mock_sm.c
+#include "ble/sm.h"
+void sm_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    UNUSED(callback_handler);
+}
+void sm_request_pairing(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+}
+int sm_le_device_index(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+    return -1;
+}
+int sm_cmac_ready(void){
+    return 1;
+}
+void sm_cmac_signed_write_start(const sm_key_t key, uint8_t opcode, uint16_t attribute_handle, uint16_t message_len, const uint8_t * message, uint32_t sign_counter, void (*done_handler)(uint8_t * hash)){
+    (void) key;
+    UNUSED(opcode);
+    UNUSED(attribute_handle);
+    UNUSED(message_len);
+    UNUSED(message);
+    UNUSED(sign_counter);
+    UNUSED(done_handler);
+}
+irk_lookup_state_t sm_identity_resolving_state(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+    return IRK_LOOKUP_SUCCEEDED;
+}
+int gap_reconnect_security_setup_active(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+    return 0;
+}
+
+#define HCI_CON_HANDLE_TEST_LE 0x0005
+#define TEST_REMOTE_CID_1      0x0041
+#define TEST_REMOTE_CID_2      0x0042
+#define TEST_REMOTE_MTU        100
+#define TEST_REMOTE_MPS        250
+#define TEST_REMOTE_CREDITS    10
+#define TEST_MAX_PACKETS       32
+
+// L2CAP LE signaling codes
+#define SIG_DISCONNECTION_REQUEST               0x06
+#define SIG_DISCONNECTION_RESPONSE              0x07
+#define SIG_CREDIT_BASED_CONNECTION_REQUEST     0x17
+#define SIG_CREDIT_BASED_CONNECTION_RESPONSE    0x18
+#define SIG_CREDIT_BASED_RECONFIGURE_REQUEST    0x19
+#define SIG_CREDIT_BASED_RECONFIGURE_RESPONSE   0x1a
+
+// mock_hci_transport.c - collect all outgoing packets
+static uint8_t  outgoing_packets[TEST_MAX_PACKETS][HCI_ACL_PAYLOAD_SIZE + 4];
+static uint16_t outgoing_packet_sizes[TEST_MAX_PACKETS];
+static uint16_t outgoing_packets_count;
+static uint16_t outgoing_packets_processed;
+
+static void (*mock_hci_transport_packet_handler)(uint8_t packet_type, uint8_t * packet, uint16_t size);
+static void mock_hci_transport_register_packet_handler(void (*packet_handler)(uint8_t packet_type, uint8_t * packet, uint16_t size)){
+    mock_hci_transport_packet_handler = packet_handler;
+}
+static int mock_hci_transport_send_packet(uint8_t packet_type, uint8_t *packet, int size){
+    if (packet_type != HCI_ACL_DATA_PACKET) return 0;
+    btstack_assert(outgoing_packets_count < TEST_MAX_PACKETS);
+    btstack_assert(size <= (int) sizeof(outgoing_packets[0]));
+    memcpy(outgoing_packets[outgoing_packets_count], packet, size);
+    outgoing_packet_sizes[outgoing_packets_count] = (uint16_t) size;
+    outgoing_packets_count++;
+    return 0;
+}
+static const hci_transport_t * mock_hci_transport_mock_get_instance(void){
+    static hci_transport_t mock_hci_transport = {
+        /*  .transport.name                          = */  "mock",
+        /*  .transport.init                          = */  NULL,
+        /*  .transport.open                          = */  NULL,
+        /*  .transport.close                         = */  NULL,
+        /*  .transport.register_packet_handler       = */  &mock_hci_transport_register_packet_handler,
+        /*  .transport.can_send_packet_now           = */  NULL,
+        /*  .transport.send_packet                   = */  &mock_hci_transport_send_packet,
+        /*  .transport.set_baudrate                  = */  NULL,
+    };
+    return &mock_hci_transport;
+}
+
+// send L2CAP PDU from peer
+static void peer_send_l2cap(uint16_t cid, const uint8_t * payload, uint16_t len){
+    uint8_t packet[HCI_ACL_PAYLOAD_SIZE + 4];
+    btstack_assert((len + 8u) <= sizeof(packet));
+    little_endian_store_16(packet, 0, HCI_CON_HANDLE_TEST_LE | 0x2000);
+    little_endian_store_16(packet, 2, len + 4);
+    little_endian_store_16(packet, 4, len);
+    little_endian_store_16(packet, 6, cid);
+    memcpy(&packet[8], payload, len);
+    (*mock_hci_transport_packet_handler)(HCI_ACL_DATA_PACKET, packet, len + 8);
+}
+
+static void peer_send_signaling(uint8_t code, uint8_t sig_id, const uint8_t * data, uint16_t len){
+    uint8_t pdu[32];
+    btstack_assert((len + 4u) <= sizeof(pdu));
+    pdu[0] = code;
+    pdu[1] = sig_id;
+    little_endian_store_16(pdu, 2, len);
+    memcpy(&pdu[4], data, len);
+    peer_send_l2cap(L2CAP_CID_SIGNALING_LE, pdu, len + 4);
+}
+
+// send single K-Frame with complete SDU
+static void peer_send_sdu(uint16_t local_cid, const uint8_t * sdu, uint16_t len){
+    uint8_t pdu[TEST_REMOTE_MPS + 2];
+    btstack_assert((len + 2u) <= sizeof(pdu));
+    little_endian_store_16(pdu, 0, len);
+    memcpy(&pdu[2], sdu, len);
+    peer_send_l2cap(local_cid, pdu, len + 2);
+}
+
+static void peer_send_att(const uint8_t * pdu, uint16_t len){
+    peer_send_l2cap(L2CAP_CID_ATTRIBUTE_PROTOCOL, pdu, len);
+}
+
+// get next unprocessed outgoing L2CAP PDU, returns NULL if none
+static const uint8_t * next_outgoing_pdu(uint16_t * out_cid, uint16_t * out_len){
+    if (outgoing_packets_processed >= outgoing_packets_count) return NULL;
+    const uint8_t * packet = outgoing_packets[outgoing_packets_processed++];
+    *out_cid = little_endian_read_16(packet, 6);
+    *out_len = little_endian_read_16(packet, 4);
+    return &packet[8];
+}
+
+// get next outgoing L2CAP PDU for cid, skipping other ones
+static const uint8_t * next_outgoing_pdu_for_cid(uint16_t cid, uint16_t * out_len){
+    while (true){
+        uint16_t pdu_cid;
+        const uint8_t * pdu = next_outgoing_pdu(&pdu_cid, out_len);
+        if (pdu == NULL) return NULL;
+        if (pdu_cid == cid) return pdu;
+    }
+}
+
+static const uint8_t * next_outgoing_signaling(uint8_t code){
+    while (true){
+        uint16_t len;
+        const uint8_t * pdu = next_outgoing_pdu_for_cid(L2CAP_CID_SIGNALING_LE, &len);
+        if (pdu == NULL) return NULL;
+        if (pdu[0] == code) return pdu;
+    }
+}
+
+// get next outgoing SDU for remote cid, expects single K-Frame
+static const uint8_t * next_outgoing_sdu(uint16_t remote_cid, uint16_t * out_len){
+    uint16_t pdu_len;
+    const uint8_t * pdu = next_outgoing_pdu_for_cid(remote_cid, &pdu_len);
+    if (pdu == NULL) return NULL;
+    *out_len = little_endian_read_16(pdu, 0);
+    CHECK_EQUAL(pdu_len - 2, *out_len);
+    return &pdu[2];
+}
+
+static void setup_le_connection_encrypted(void){
+    hci_setup_test_connections_fuzz();
+    hci_connection_t * hci_connection = hci_connection_for_handle(HCI_CON_HANDLE_TEST_LE);
+    hci_connection->sm_connection.sm_actual_encryption_key_size = 16;
+}
+
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static void dummy_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(packet_type);
+    UNUSED(channel);
+    UNUSED(packet);
+    UNUSED(size);
+}
+
+static void stack_setup(void){
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_embedded_get_instance());
+    hci_init(mock_hci_transport_mock_get_instance(), NULL);
+    hci_event_callback_registration.callback = &dummy_event_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    l2cap_init();
+    le_device_db_init();
+    hci_dump_init(hci_dump_posix_stdout_get_instance());
+    outgoing_packets_count = 0;
+    outgoing_packets_processed = 0;
+}
+
+static void stack_teardown(void){
+    l2cap_deinit();
+    hci_deinit();
+    btstack_memory_deinit();
+    btstack_run_loop_deinit();
+}
+
+// ATT Server
+
+static uint8_t att_server_eatt_storage[2 * (sizeof(att_server_bearer_t) + 128 + (2 * HCI_ACL_PAYLOAD_SIZE))];
+
+TEST_GROUP(ATT_SERVER_EATT){
+    uint16_t local_cids[2];
+
+    void setup(void){
+        stack_setup();
+        att_server_init(profile_data, NULL, NULL);
+        uint8_t status = att_server_eatt_init(2, att_server_eatt_storage, sizeof(att_server_eatt_storage));
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+        setup_le_connection_encrypted();
+        memset(local_cids, 0, sizeof(local_cids));
+    }
+    void teardown(void){
+        att_server_deinit();
+        stack_teardown();
+    }
+
+    // peer requests num_channels bearers starting with TEST_REMOTE_CID_1, returns result and stores local cids
+    uint16_t peer_connect(uint8_t sig_id, uint8_t num_channels){
+        uint8_t data[8 + 2 * 2];
+        little_endian_store_16(data, 0, BLUETOOTH_PSM_EATT);
+        little_endian_store_16(data, 2, TEST_REMOTE_MTU);
+        little_endian_store_16(data, 4, TEST_REMOTE_MPS);
+        little_endian_store_16(data, 6, TEST_REMOTE_CREDITS);
+        uint8_t i;
+        for (i=0;i<num_channels;i++){
+            little_endian_store_16(data, 8 + (2 * i), TEST_REMOTE_CID_1 + i);
+        }
+        peer_send_signaling(SIG_CREDIT_BASED_CONNECTION_REQUEST, sig_id, data, 8 + (2 * num_channels));
+
+        const uint8_t * response = next_outgoing_signaling(SIG_CREDIT_BASED_CONNECTION_RESPONSE);
+        CHECK(response != NULL);
+        CHECK_EQUAL(sig_id, response[1]);
+        CHECK_EQUAL(8 + (2 * num_channels), little_endian_read_16(response, 2));
+        for (i=0;i<num_channels;i++){
+            local_cids[i] = little_endian_read_16(response, 12 + (2 * i));
+        }
+        return little_endian_read_16(response, 10);
+    }
+
+    // read value of FFF1 on bearer and return length of value in response
+    uint16_t read_long_value(uint16_t local_cid, uint16_t remote_cid){
+        uint8_t read_request[] = { ATT_READ_REQUEST, 0, 0 };
+        little_endian_store_16(read_request, 1, ATT_CHARACTERISTIC_FFF1_01_VALUE_HANDLE);
+        peer_send_sdu(local_cid, read_request, sizeof(read_request));
+        uint16_t len;
+        const uint8_t * response = next_outgoing_sdu(remote_cid, &len);
+        CHECK(response != NULL);
+        CHECK_EQUAL(ATT_READ_RESPONSE, response[0]);
+        MEMCMP_EQUAL("abcdefghij", &response[1], 10);
+        return len - 1;
+    }
+};
+
+TEST(ATT_SERVER_EATT, Connect){
+    CHECK_EQUAL(0, peer_connect(1, 2));
+    CHECK(local_cids[0] != 0);
+    CHECK(local_cids[1] != 0);
+
+    // ATT MTU is limited by remote MTU, requests are answered on the bearer they were received on
+    CHECK_EQUAL(TEST_REMOTE_MTU - 1, read_long_value(local_cids[0], TEST_REMOTE_CID_1));
+    CHECK_EQUAL(TEST_REMOTE_MTU - 1, read_long_value(local_cids[1], TEST_REMOTE_CID_2));
+}
+
+TEST(ATT_SERVER_EATT, ConnectInsufficientResources){
+    CHECK_EQUAL(0, peer_connect(1, 2));
+    // all bearers in use
+    CHECK(peer_connect(2, 1) != 0);
+    CHECK_EQUAL(0, local_cids[0]);
+}
+
+TEST(ATT_SERVER_EATT, ConnectRequiresEncryption){
+    hci_connection_for_handle(HCI_CON_HANDLE_TEST_LE)->sm_connection.sm_actual_encryption_key_size = 0;
+    CHECK(peer_connect(1, 2) != 0);
+}
+
+TEST(ATT_SERVER_EATT, Reconfigure){
+    CHECK_EQUAL(0, peer_connect(1, 2));
+    CHECK_EQUAL(TEST_REMOTE_MTU - 1, read_long_value(local_cids[0], TEST_REMOTE_CID_1));
+
+    // peer increases MTU of both bearers
+    uint8_t data[8];
+    little_endian_store_16(data, 0, 200);
+    little_endian_store_16(data, 2, TEST_REMOTE_MPS);
+    little_endian_store_16(data, 4, TEST_REMOTE_CID_1);
+    little_endian_store_16(data, 6, TEST_REMOTE_CID_2);
+    peer_send_signaling(SIG_CREDIT_BASED_RECONFIGURE_REQUEST, 2, data, sizeof(data));
+    const uint8_t * response = next_outgoing_signaling(SIG_CREDIT_BASED_RECONFIGURE_RESPONSE);
+    CHECK(response != NULL);
+    CHECK_EQUAL(0, little_endian_read_16(response, 4));
+
+    // complete value fits into response now
+    CHECK_EQUAL(160, read_long_value(local_cids[0], TEST_REMOTE_CID_1));
+    CHECK_EQUAL(160, read_long_value(local_cids[1], TEST_REMOTE_CID_2));
+}
+
+TEST(ATT_SERVER_EATT, Disconnect){
+    CHECK_EQUAL(0, peer_connect(1, 2));
+
+    // peer closes first bearer
+    uint8_t data[4];
+    little_endian_store_16(data, 0, local_cids[0]);
+    little_endian_store_16(data, 2, TEST_REMOTE_CID_1);
+    peer_send_signaling(SIG_DISCONNECTION_REQUEST, 2, data, sizeof(data));
+    CHECK(next_outgoing_signaling(SIG_DISCONNECTION_RESPONSE) != NULL);
+
+    // remaining bearer still works
+    uint16_t remaining_cid = local_cids[1];
+    CHECK_EQUAL(TEST_REMOTE_MTU - 1, read_long_value(remaining_cid, TEST_REMOTE_CID_2));
+
+    // freed bearer can be used again
+    CHECK_EQUAL(0, peer_connect(3, 1));
+    CHECK(local_cids[0] != 0);
+}
+
+TEST(ATT_SERVER_EATT, SignedWriteRejected){
+    CHECK_EQUAL(0, peer_connect(1, 2));
+
+    // Signed Write Command is dropped, next request gets processed
+    uint8_t signed_write[3 + 1 + 12];
+    memset(signed_write, 0, sizeof(signed_write));
+    signed_write[0] = ATT_SIGNED_WRITE_COMMAND;
+    little_endian_store_16(signed_write, 1, ATT_CHARACTERISTIC_FFF1_01_VALUE_HANDLE);
+    peer_send_sdu(local_cids[0], signed_write, sizeof(signed_write));
+    CHECK_EQUAL(TEST_REMOTE_MTU - 1, read_long_value(local_cids[0], TEST_REMOTE_CID_1));
+}
+
+// GATT Client
+
+#define TEST_SERVER_SUPPORTED_FEATURES_HANDLE 0x0010
+#define TEST_CLIENT_SUPPORTED_FEATURES_HANDLE 0x0013
+#define TEST_VALUE_HANDLE                     0x0020
+
+static uint8_t gatt_client_eatt_storage[2 * (sizeof(gatt_client_t) + 16 + (2 * 150))];
+static uint8_t  eatt_connected_status;
+static uint8_t  eatt_connected_num_bearers;
+static uint16_t value_length;
+static uint8_t  query_complete_status;
+static bool     query_complete;
+
+static void gatt_client_eatt_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case GATT_EVENT_EATT_CONNECTED:
+            eatt_connected_status = gatt_event_eatt_connected_get_status(packet);
+            eatt_connected_num_bearers = gatt_event_eatt_connected_get_num_bearers(packet);
+            break;
+        case GATT_EVENT_CHARACTERISTIC_VALUE_QUERY_RESULT:
+            value_length = gatt_event_characteristic_value_query_result_get_value_length(packet);
+            break;
+        case GATT_EVENT_QUERY_COMPLETE:
+            query_complete_status = gatt_event_query_complete_get_att_status(packet);
+            query_complete = true;
+            break;
+        default:
+            break;
+    }
+}
+
+// minimal ATT Server on unenhanced bearer providing Server and Client Supported Features
+static void peer_handle_att_requests(void){
+    while (outgoing_packets_processed < outgoing_packets_count){
+        // stop at first packet not for the unenhanced bearer, e.g. the L2CAP connection request
+        if (little_endian_read_16(outgoing_packets[outgoing_packets_processed], 6) != L2CAP_CID_ATTRIBUTE_PROTOCOL) return;
+        uint16_t len;
+        const uint8_t * request = next_outgoing_pdu_for_cid(L2CAP_CID_ATTRIBUTE_PROTOCOL, &len);
+        uint8_t response[12];
+        uint16_t response_len = 0;
+        uint16_t start_handle;
+        switch (request[0]){
+            case ATT_EXCHANGE_MTU_REQUEST:
+                response[0] = ATT_EXCHANGE_MTU_RESPONSE;
+                little_endian_store_16(response, 1, ATT_DEFAULT_MTU);
+                response_len = 3;
+                break;
+            case ATT_READ_BY_TYPE_REQUEST:
+                start_handle = little_endian_read_16(request, 1);
+                if ((start_handle == 1) && (little_endian_read_16(request, 5) == ORG_BLUETOOTH_CHARACTERISTIC_SERVER_SUPPORTED_FEATURES)){
+                    // EATT supported
+                    response[0] = ATT_READ_BY_TYPE_RESPONSE;
+                    response[1] = 3;
+                    little_endian_store_16(response, 2, TEST_SERVER_SUPPORTED_FEATURES_HANDLE);
+                    response[4] = 0x01;
+                    response_len = 5;
+                } else if ((start_handle == 1) && (little_endian_read_16(request, 5) == GATT_CHARACTERISTICS_UUID)){
+                    // Client Supported Features characteristic
+                    response[0] = ATT_READ_BY_TYPE_RESPONSE;
+                    response[1] = 7;
+                    little_endian_store_16(response, 2, TEST_CLIENT_SUPPORTED_FEATURES_HANDLE - 1);
+                    response[4] = ATT_PROPERTY_READ | ATT_PROPERTY_WRITE;
+                    little_endian_store_16(response, 5, TEST_CLIENT_SUPPORTED_FEATURES_HANDLE);
+                    little_endian_store_16(response, 7, ORG_BLUETOOTH_CHARACTERISTIC_CLIENT_SUPPORTED_FEATURES);
+                    response_len = 9;
+                } else {
+                    response[0] = ATT_ERROR_RESPONSE;
+                    response[1] = request[0];
+                    little_endian_store_16(response, 2, start_handle);
+                    response[4] = ATT_ERROR_ATTRIBUTE_NOT_FOUND;
+                    response_len = 5;
+                }
+                break;
+            case ATT_WRITE_REQUEST:
+                CHECK_EQUAL(TEST_CLIENT_SUPPORTED_FEATURES_HANDLE, little_endian_read_16(request, 1));
+                response[0] = ATT_WRITE_RESPONSE;
+                response_len = 1;
+                break;
+            default:
+                FAIL("unexpected ATT request");
+                break;
+        }
+        peer_send_att(response, response_len);
+    }
+}
+
+TEST_GROUP(GATT_CLIENT_EATT){
+    uint16_t local_cids[2];
+
+    void setup(void){
+        stack_setup();
+        att_server_init(profile_data, NULL, NULL);
+        gatt_client_init();
+        setup_le_connection_encrypted();
+        eatt_connected_status = 0xff;
+        eatt_connected_num_bearers = 0;
+        value_length = 0;
+        query_complete = false;
+        query_complete_status = 0xff;
+        memset(local_cids, 0, sizeof(local_cids));
+    }
+    void teardown(void){
+        att_server_deinit();
+        stack_teardown();
+    }
+
+    gatt_client_t * eatt_client(uint8_t index){
+        gatt_client_t * gatt_client;
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, gatt_client_get_client(HCI_CON_HANDLE_TEST_LE, &gatt_client));
+        btstack_linked_item_t * it = gatt_client->eatt_clients;
+        while ((it != NULL) && (index > 0)){
+            it = it->next;
+            index--;
+        }
+        return (gatt_client_t *) it;
+    }
+
+    void connect(void){
+        uint8_t status = gatt_client_le_enhanced_connect(&gatt_client_eatt_handler, HCI_CON_HANDLE_TEST_LE, 2,
+                                                         gatt_client_eatt_storage, sizeof(gatt_client_eatt_storage));
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+        peer_handle_att_requests();
+
+        // L2CAP ECBM connection request for two bearers on EATT PSM
+        const uint8_t * request = next_outgoing_signaling(SIG_CREDIT_BASED_CONNECTION_REQUEST);
+        CHECK(request != NULL);
+        CHECK_EQUAL(BLUETOOTH_PSM_EATT, little_endian_read_16(request, 4));
+        CHECK_EQUAL(8 + (2 * 2), little_endian_read_16(request, 2));
+        local_cids[0] = little_endian_read_16(request, 12);
+        local_cids[1] = little_endian_read_16(request, 14);
+
+        uint8_t data[8 + 2 * 2];
+        little_endian_store_16(data, 0, TEST_REMOTE_MTU);
+        little_endian_store_16(data, 2, TEST_REMOTE_MPS);
+        little_endian_store_16(data, 4, TEST_REMOTE_CREDITS);
+        little_endian_store_16(data, 6, 0);
+        little_endian_store_16(data, 8, TEST_REMOTE_CID_1);
+        little_endian_store_16(data, 10, TEST_REMOTE_CID_2);
+        peer_send_signaling(SIG_CREDIT_BASED_CONNECTION_RESPONSE, request[1], data, sizeof(data));
+    }
+};
+
+TEST(GATT_CLIENT_EATT, Connect){
+    connect();
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, eatt_connected_status);
+    CHECK_EQUAL(2, eatt_connected_num_bearers);
+    CHECK_EQUAL(TEST_REMOTE_MTU, eatt_client(0)->mtu);
+    CHECK_EQUAL(TEST_REMOTE_MTU, eatt_client(1)->mtu);
+
+    // query is sent over Enhanced ATT bearer
+    uint8_t status = gatt_client_read_value_of_characteristic_using_value_handle(&gatt_client_eatt_handler, HCI_CON_HANDLE_TEST_LE, TEST_VALUE_HANDLE);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    uint16_t len;
+    const uint8_t * request = next_outgoing_sdu(TEST_REMOTE_CID_1, &len);
+    CHECK(request != NULL);
+    CHECK_EQUAL(3, len);
+    CHECK_EQUAL(ATT_READ_REQUEST, request[0]);
+    CHECK_EQUAL(TEST_VALUE_HANDLE, little_endian_read_16(request, 1));
+
+    const uint8_t response[] = { ATT_READ_RESPONSE, 1, 2, 3, 4 };
+    peer_send_sdu(local_cids[0], response, sizeof(response));
+    CHECK_EQUAL(4, value_length);
+    CHECK_EQUAL(true, query_complete);
+    CHECK_EQUAL(ATT_ERROR_SUCCESS, query_complete_status);
+}
+
+TEST(GATT_CLIENT_EATT, ConnectRefused){
+    uint8_t status = gatt_client_le_enhanced_connect(&gatt_client_eatt_handler, HCI_CON_HANDLE_TEST_LE, 2,
+                                                     gatt_client_eatt_storage, sizeof(gatt_client_eatt_storage));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    peer_handle_att_requests();
+    const uint8_t * request = next_outgoing_signaling(SIG_CREDIT_BASED_CONNECTION_REQUEST);
+    CHECK(request != NULL);
+
+    // all connections refused - insufficient resources
+    uint8_t data[8 + 2 * 2];
+    memset(data, 0, sizeof(data));
+    little_endian_store_16(data, 6, 0x0004);
+    peer_send_signaling(SIG_CREDIT_BASED_CONNECTION_RESPONSE, request[1], data, sizeof(data));
+    CHECK(eatt_connected_status != ERROR_CODE_SUCCESS);
+    CHECK(eatt_client(0) == NULL);
+}
+
+TEST(GATT_CLIENT_EATT, Reconfigure){
+    connect();
+    CHECK_EQUAL(TEST_REMOTE_MTU, eatt_client(0)->mtu);
+
+    // server increases MTU, ATT MTU is limited by our receive buffer
+    uint8_t data[8];
+    little_endian_store_16(data, 0, 200);
+    little_endian_store_16(data, 2, TEST_REMOTE_MPS);
+    little_endian_store_16(data, 4, TEST_REMOTE_CID_1);
+    little_endian_store_16(data, 6, TEST_REMOTE_CID_2);
+    peer_send_signaling(SIG_CREDIT_BASED_RECONFIGURE_REQUEST, 3, data, sizeof(data));
+    const uint8_t * response = next_outgoing_signaling(SIG_CREDIT_BASED_RECONFIGURE_RESPONSE);
+    CHECK(response != NULL);
+    CHECK_EQUAL(0, little_endian_read_16(response, 4));
+
+    CHECK_EQUAL(eatt_client(0)->eatt_local_mtu, eatt_client(0)->mtu);
+    CHECK_EQUAL(eatt_client(1)->eatt_local_mtu, eatt_client(1)->mtu);
+    CHECK(eatt_client(0)->mtu > TEST_REMOTE_MTU);
+}
+
+TEST(GATT_CLIENT_EATT, Disconnect){
+    connect();
+
+    // start query on first bearer
+    uint8_t status = gatt_client_read_value_of_characteristic_using_value_handle(&gatt_client_eatt_handler, HCI_CON_HANDLE_TEST_LE, TEST_VALUE_HANDLE);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+
+    // server closes first bearer, pending query fails
+    uint8_t data[4];
+    little_endian_store_16(data, 0, local_cids[0]);
+    little_endian_store_16(data, 2, TEST_REMOTE_CID_1);
+    peer_send_signaling(SIG_DISCONNECTION_REQUEST, 4, data, sizeof(data));
+    CHECK(next_outgoing_signaling(SIG_DISCONNECTION_RESPONSE) != NULL);
+    CHECK_EQUAL(true, query_complete);
+    CHECK_EQUAL(ATT_ERROR_HCI_DISCONNECT_RECEIVED, query_complete_status);
+
+    // next query uses remaining bearer
+    CHECK(eatt_client(0) != NULL);
+    CHECK(eatt_client(1) == NULL);
+    CHECK_EQUAL(local_cids[1], eatt_client(0)->eatt_cid);
+    query_complete = false;
+    status = gatt_client_read_value_of_characteristic_using_value_handle(&gatt_client_eatt_handler, HCI_CON_HANDLE_TEST_LE, TEST_VALUE_HANDLE);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    uint16_t len;
+    CHECK(next_outgoing_sdu(TEST_REMOTE_CID_2, &len) != NULL);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -13,6 +13,7 @@
 
 // BTstack features that can be enabled
 #define ENABLE_ATT_DELAYED_RESPONSE
+#define ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
 #define ENABLE_BLE
 #define ENABLE_CLASSIC
 #define ENABLE_MICRO_ECC_FOR_LE_SECURE_CONNECTIONS
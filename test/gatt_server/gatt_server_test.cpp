@@ -36,6 +36,8 @@ extern "C" void mock_call_att_packet_handler(uint8_t packet_type, uint16_t chann
 extern "C" void mock_l2cap_set_max_mtu(uint16_t mtu);
 extern "C" void hci_setup_classic_connection(uint16_t con_handle);
 extern "C" void set_cmac_ready(int ready);
+extern "C" uint16_t mock_l2cap_get_sent_packets(void);
+extern "C" const uint8_t * mock_l2cap_get_last_sent_packet(uint16_t * len);
 
 static uint8_t att_request[255];
 static uint16_t att_write_request(uint16_t request_type, uint16_t attribute_handle, uint16_t value_length, const uint8_t * value){
@@ -125,6 +127,8 @@ TEST_GROUP(ATT_SERVER){
         att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_CGM_SESSION_RUN_TIME, ATT_PROPERTY_WRITE_WITHOUT_RESPONSE | ATT_PROPERTY_DYNAMIC | ATT_PROPERTY_NOTIFY, ATT_SECURITY_NONE, ATT_SECURITY_NONE, &battery_level, 1);
         // 0x2A5C
         att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_CSC_FEATURE, ATT_PROPERTY_AUTHENTICATED_SIGNED_WRITE | ATT_PROPERTY_DYNAMIC, ATT_SECURITY_NONE, ATT_SECURITY_NONE, &battery_level, 1);
+        // 0x2B29
+        att_db_util_add_characteristic_uuid16(ORG_BLUETOOTH_CHARACTERISTIC_CLIENT_SUPPORTED_FEATURES, ATT_PROPERTY_WRITE | ATT_PROPERTY_DYNAMIC, ATT_SECURITY_NONE, ATT_SECURITY_NONE, &battery_level, 1);
         // setup ATT server
         att_server_init(att_db_util_get_address(), att_read_callback, att_write_callback);
     }
@@ -217,6 +221,121 @@ TEST(ATT_SERVER, att_server_notify){
     CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
 }
 
+TEST(ATT_SERVER, att_server_notify_coalesced){
+    static uint8_t value[] = {0x55, 0x66};
+    uint16_t value_handle_a = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL_STATE);
+    uint16_t value_handle_b = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_POWER_STATE);
+    uint16_t len;
+    const uint8_t * packet;
+    uint8_t status;
+
+    // invalid connection handle
+    status = att_server_notify_coalesced(0x50, value_handle_a, &value[0], 1);
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, status);
+
+    // client did not enable Multiple Handle Value Notifications: values are sent individually
+    l2cap_can_send_fixed_channel_packet_now_set_status(0);
+    status = att_server_notify_coalesced(att_con_handle, value_handle_a, &value[0], 1);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    status = att_server_notify_coalesced(att_con_handle, value_handle_b, &value[0], 2);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(0, mock_l2cap_get_sent_packets());
+    l2cap_can_send_fixed_channel_packet_now_set_status(1);
+    att_server_request_can_send_now_event(att_con_handle);
+    CHECK_EQUAL(2, mock_l2cap_get_sent_packets());
+    packet = mock_l2cap_get_last_sent_packet(&len);
+    const uint8_t expected_notification[] = { ATT_HANDLE_VALUE_NOTIFICATION, (uint8_t) value_handle_b, (uint8_t) (value_handle_b >> 8), 0x55, 0x66};
+    CHECK_EQUAL(sizeof(expected_notification), len);
+    MEMCMP_EQUAL(expected_notification, packet, len);
+
+    // client enables Multiple Handle Value Notifications in Client Supported Features
+    uint16_t client_supported_features_handle = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_CLIENT_SUPPORTED_FEATURES);
+    uint8_t client_supported_features[] = { 0x04 };
+    uint16_t att_request_len = att_write_request(ATT_WRITE_REQUEST, client_supported_features_handle, sizeof(client_supported_features), client_supported_features);
+    mock_call_att_server_packet_handler(ATT_DATA_PACKET, att_con_handle, &att_request[0], att_request_len);
+    CHECK_EQUAL(3, mock_l2cap_get_sent_packets());
+
+    // pending values are coalesced, newer value replaces pending value for same handle
+    l2cap_can_send_fixed_channel_packet_now_set_status(0);
+    status = att_server_notify_coalesced(att_con_handle, value_handle_a, &value[0], 2);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    status = att_server_notify_coalesced(att_con_handle, value_handle_b, &value[0], 1);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    status = att_server_notify_coalesced(att_con_handle, value_handle_a, &value[1], 1);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    l2cap_can_send_fixed_channel_packet_now_set_status(1);
+    att_server_request_can_send_now_event(att_con_handle);
+    CHECK_EQUAL(4, mock_l2cap_get_sent_packets());
+    packet = mock_l2cap_get_last_sent_packet(&len);
+    const uint8_t expected_multiple_notification[] = { ATT_MULTIPLE_HANDLE_VALUE_NTF,
+        (uint8_t) value_handle_b, (uint8_t) (value_handle_b >> 8), 0x01, 0x00, 0x55,
+        (uint8_t) value_handle_a, (uint8_t) (value_handle_a >> 8), 0x01, 0x00, 0x66};
+    CHECK_EQUAL(sizeof(expected_multiple_notification), len);
+    MEMCMP_EQUAL(expected_multiple_notification, packet, len);
+
+    // tuples exceeding the ATT MTU are sent in the next PDU
+    uint8_t long_value[16];
+    memset(long_value, 0x77, sizeof(long_value));
+    l2cap_can_send_fixed_channel_packet_now_set_status(0);
+    status = att_server_notify_coalesced(att_con_handle, value_handle_a, long_value, sizeof(long_value));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    status = att_server_notify_coalesced(att_con_handle, value_handle_b, long_value, sizeof(long_value));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    l2cap_can_send_fixed_channel_packet_now_set_status(1);
+    att_server_request_can_send_now_event(att_con_handle);
+    CHECK_EQUAL(6, mock_l2cap_get_sent_packets());
+    packet = mock_l2cap_get_last_sent_packet(&len);
+    CHECK_EQUAL(3 + sizeof(long_value), len);
+    CHECK_EQUAL(ATT_HANDLE_VALUE_NOTIFICATION, packet[0]);
+    CHECK_EQUAL(value_handle_b, little_endian_read_16(packet, 1));
+
+    // queue is full
+    l2cap_can_send_fixed_channel_packet_now_set_status(0);
+    uint16_t attribute_handle = 0x100;
+    do {
+        status = att_server_notify_coalesced(att_con_handle, attribute_handle++, long_value, sizeof(long_value));
+    } while (status == ERROR_CODE_SUCCESS);
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, status);
+    l2cap_can_send_fixed_channel_packet_now_set_status(1);
+}
+
+TEST(ATT_SERVER, att_server_multiple_notify){
+    static const uint8_t value_a[] = {0x55};
+    static const uint8_t value_b[] = {0x66, 0x77};
+    uint16_t attribute_handles[2];
+    const uint8_t * values_data[2] = { value_a, value_b };
+    uint16_t values_len[2] = { sizeof(value_a), sizeof(value_b) };
+    attribute_handles[0] = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_LEVEL_STATE);
+    attribute_handles[1] = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_BATTERY_POWER_STATE);
+    uint16_t len;
+    const uint8_t * packet;
+    uint8_t status;
+
+    // client did not enable Multiple Handle Value Notifications: values are sent with Handle Value Notifications
+    status = att_server_multiple_notify(att_con_handle, 2, attribute_handles, values_data, values_len);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    att_server_request_can_send_now_event(att_con_handle);
+    CHECK_EQUAL(2, mock_l2cap_get_sent_packets());
+    packet = mock_l2cap_get_last_sent_packet(&len);
+    CHECK_EQUAL(3 + sizeof(value_b), len);
+    CHECK_EQUAL(ATT_HANDLE_VALUE_NOTIFICATION, packet[0]);
+    CHECK_EQUAL(attribute_handles[1], little_endian_read_16(packet, 1));
+
+    // client enables Multiple Handle Value Notifications in Client Supported Features
+    uint16_t client_supported_features_handle = gatt_server_get_value_handle_for_characteristic_with_uuid16(0, 0xffff, ORG_BLUETOOTH_CHARACTERISTIC_CLIENT_SUPPORTED_FEATURES);
+    uint8_t client_supported_features[] = { 0x04 };
+    uint16_t att_request_len = att_write_request(ATT_WRITE_REQUEST, client_supported_features_handle, sizeof(client_supported_features), client_supported_features);
+    mock_call_att_server_packet_handler(ATT_DATA_PACKET, att_con_handle, &att_request[0], att_request_len);
+    CHECK_EQUAL(3, mock_l2cap_get_sent_packets());
+
+    status = att_server_multiple_notify(att_con_handle, 2, attribute_handles, values_data, values_len);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(4, mock_l2cap_get_sent_packets());
+    packet = mock_l2cap_get_last_sent_packet(&len);
+    CHECK_EQUAL(1 + 4 + sizeof(value_a) + 4 + sizeof(value_b), len);
+    CHECK_EQUAL(ATT_MULTIPLE_HANDLE_VALUE_NTF, packet[0]);
+}
+
 TEST(ATT_SERVER, att_server_get_mtu){
     // invalid connection handle
     uint8_t mtu = att_server_get_mtu(0x50);
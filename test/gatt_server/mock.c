@@ -20,6 +20,9 @@ static void (*registered_hci_event_handler) (uint8_t packet_type, uint16_t chann
 static btstack_linked_list_t     connections;
 static uint16_t max_mtu = 23;
 static uint8_t  l2cap_stack_buffer[HCI_INCOMING_PRE_BUFFER_SIZE + 8 + ATT_DEFAULT_MTU];	// pre buffer + HCI Header + L2CAP header
+static uint8_t  mock_l2cap_sent_packet[ATT_DEFAULT_MTU];
+static uint16_t mock_l2cap_sent_packet_len;
+static uint16_t mock_l2cap_sent_packets;
 static uint16_t gatt_client_handle = 0x40;
 static hci_connection_t hci_connection;
 
@@ -103,6 +106,11 @@ void hci_deinit(void){
     hci_connection.att_server.ir_le_device_db_index = 0;
     hci_connection.att_server.notification_requests = NULL;
     hci_connection.att_server.indication_requests = NULL;
+#ifdef ENABLE_ATT_SERVER_NOTIFICATION_COALESCING
+    hci_connection.att_server.multiple_notifications_supported = false;
+    hci_connection.att_server.coalesced_notifications_len = 0;
+#endif
+    mock_l2cap_sent_packets = 0;
     connections = NULL;
 }
 
@@ -172,7 +180,19 @@ void l2cap_request_can_send_fix_channel_now_event(uint16_t handle, uint16_t chan
     att_server_packet_handler(HCI_EVENT_PACKET, 0, (uint8_t*)event, sizeof(event));
 }
 
+uint16_t mock_l2cap_get_sent_packets(void){
+	return mock_l2cap_sent_packets;
+}
+
+const uint8_t * mock_l2cap_get_last_sent_packet(uint16_t * len){
+	*len = mock_l2cap_sent_packet_len;
+	return mock_l2cap_sent_packet;
+}
+
 uint8_t l2cap_send_prepared_connectionless(uint16_t handle, uint16_t cid, uint16_t len){
+	mock_l2cap_sent_packet_len = btstack_min(len, sizeof(mock_l2cap_sent_packet));
+	memcpy(mock_l2cap_sent_packet, l2cap_get_outgoing_buffer(), mock_l2cap_sent_packet_len);
+	mock_l2cap_sent_packets++;
 	att_connection_t att_connection;
     hci_setup_le_connection(handle);
 	uint8_t response[max_mtu];
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -79,7 +80,7 @@ static void btstack_cvsd_plc_mark_bad_frame(btstack_cvsd_plc_state_t * state, in
     }
 }
 
-static int phase = 0;
+static unsigned int phase = 0;
 static void create_sine_wave_int16_data(int num_samples, int16_t * data){
     int i;
     for (i=0; i < num_samples; i++){
@@ -320,7 +321,7 @@ TEST(CVSD_PLC, CountEqBytes){
     name = (char *)"out";
     x0  = CVSD_LHIST;
     x1  = x0 + CVSD_FS - 1;
-    fprintf_array_int16(oct_file, name, CVSD_FS, plc_state.hist+x0);
+    fprintf_array_int16(oct_file, name, CVSD_FS, out);
     fprintf(oct_file, "plot(b(%d:%d), %s, 'cd'); \n", x0, x1, name);
     
     // shift the history buffer 
@@ -358,6 +359,69 @@ TEST(CVSD_PLC, CountEqBytes){
 //     process_wav_file_with_plc("results/fanfare_mono_with_bad_frames.wav", "results/fanfare_mono_with_bad_frames_after_plc.wav");
 // }
 
+// reference pattern matching: float normalized cross-correlation for every candidate
+static float reference_cross_correlation(int16_t *x, int16_t *y){
+    float num = 0;
+    float x2 = 0;
+    float y2 = 0;
+    int   m;
+    for (m=0;m<CVSD_M;m++){
+        num+=((float)x[m])*y[m];
+        x2+=((float)x[m])*x[m];
+        y2+=((float)y[m])*y[m];
+    }
+    return num/sqrtf(x2*y2);
+}
+
+static int reference_pattern_match(int16_t *y){
+    float maxCn = -999999.0;
+    int   bestmatch = 0;
+    int   n;
+    for (n=0;n<CVSD_N;n++){
+        float Cn = reference_cross_correlation(&y[CVSD_LHIST-CVSD_M], &y[n]);
+        if (Cn>maxCn){
+            bestmatch=n;
+            maxCn = Cn;
+        }
+    }
+    return bestmatch;
+}
+
+static void check_pattern_match(int16_t * y){
+    int bestlag_reference = reference_pattern_match(y);
+    int bestlag = btstack_cvsd_plc_pattern_match(y);
+    if (bestlag == bestlag_reference) return;
+    float correlation_reference = reference_cross_correlation(&y[CVSD_LHIST-CVSD_M], &y[bestlag_reference]);
+    float correlation = reference_cross_correlation(&y[CVSD_LHIST-CVSD_M], &y[bestlag]);
+    CHECK(fabsf(correlation_reference - correlation) < 1e-5f);
+}
+
+TEST(CVSD_PLC, PatternMatchFanfare){
+    static int16_t samples[40200];
+    CHECK_EQUAL(0, wav_reader_open("data/fanfare_test-8khz.wav"));
+    int num_samples = 0;
+    while (wav_reader_read_int16(audio_samples_per_frame, &samples[num_samples]) == 0){
+        num_samples += audio_samples_per_frame;
+        if ((num_samples + audio_samples_per_frame) > (int) (sizeof(samples) / sizeof(int16_t))) break;
+    }
+    wav_reader_close();
+    int offset;
+    for (offset = 0; (offset + CVSD_LHIST) <= num_samples; offset += CVSD_FS){
+        check_pattern_match(&samples[offset]);
+    }
+}
+
+TEST(CVSD_PLC, PatternMatchClipped){
+    int16_t hist[CVSD_LHIST];
+    int i;
+    for (i = 0; i < CVSD_LHIST; i++){
+        hist[i] = ((i / 5) & 1) ? 32767 : -32768;
+    }
+    check_pattern_match(hist);
+    // first candidate in phase with the template
+    CHECK_EQUAL((CVSD_LHIST - CVSD_M) % 10, btstack_cvsd_plc_pattern_match(hist));
+}
+
 TEST(CVSD_PLC, TestSineWave){
     int corruption_step = 600;
     create_sine_wav("results/sine_test.wav");
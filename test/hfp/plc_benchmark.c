@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "plc_benchmark.c"
+
+// *****************************************************************************
+//
+// PLC pattern matching benchmark: compares CVSD and mSBC pattern matching with
+// the reference float implementation on the test vectors and reports speed
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_cvsd_plc.h"
+#include "btstack_sbc_plc.h"
+#include "wav_util.h"
+
+#define MAX_NUM_SAMPLES 250000
+#define ITERATIONS      5
+
+static int16_t samples[MAX_NUM_SAMPLES];
+
+typedef int (*pattern_match_t)(int16_t * y);
+
+typedef struct {
+    const char *    name;
+    const char *    wav_file;
+    int             frame_size;
+    int             window_length;
+    int             template_length;
+    int             history_length;
+    pattern_match_t pattern_match;
+} benchmark_config_t;
+
+// reference: float normalized cross-correlation as in the PLC algorithm description
+static float sqrt3(const float x){
+    union {
+        int i;
+        float x;
+    } u;
+    u.x = x;
+    u.i = (1<<29) + (u.i >> 1) - (1<<22);
+    u.x =       u.x + (x/u.x);
+    u.x = (0.25f*u.x) + (x/u.x);
+    return u.x;
+}
+
+static float reference_cross_correlation(const int16_t *x, const int16_t *y, int template_length){
+    float num = 0;
+    float x2 = 0;
+    float y2 = 0;
+    int   m;
+    for (m=0;m<template_length;m++){
+        num+=((float)x[m])*y[m];
+        x2+=((float)x[m])*x[m];
+        y2+=((float)y[m])*y[m];
+    }
+    return num/sqrt3(x2*y2);
+}
+
+static int reference_pattern_match(const benchmark_config_t * config, const int16_t *y){
+    float maxCn = -999999.0;
+    int   bestmatch = 0;
+    int   n;
+    for (n=0;n<config->window_length;n++){
+        float Cn = reference_cross_correlation(&y[config->history_length - config->template_length], &y[n], config->template_length);
+        if (Cn>maxCn){
+            bestmatch=n;
+            maxCn = Cn;
+        }
+    }
+    return bestmatch;
+}
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static int read_wav_file(const char * wav_file){
+    if (wav_reader_open(wav_file) != 0){
+        printf("Could not open %s\n", wav_file);
+        return 0;
+    }
+    int num_samples = 0;
+    while ((num_samples + 60) <= MAX_NUM_SAMPLES){
+        if (wav_reader_read_int16(60, &samples[num_samples]) != 0) break;
+        num_samples += 60;
+    }
+    wav_reader_close();
+    return num_samples;
+}
+
+static void benchmark(const benchmark_config_t * config){
+    int num_samples = read_wav_file(config->wav_file);
+    if (num_samples < config->history_length) return;
+
+    // history at every frame boundary
+    int num_histories = ((num_samples - config->history_length) / config->frame_size) + 1;
+    int num_mismatches = 0;
+    float max_correlation_difference = 0;
+    int i;
+    for (i = 0; i < num_histories; i++){
+        int16_t * y = &samples[i * config->frame_size];
+        int bestlag_reference = reference_pattern_match(config, y);
+        int bestlag = (*config->pattern_match)(y);
+        if (bestlag != bestlag_reference){
+            const int16_t * x = &y[config->history_length - config->template_length];
+            float difference = reference_cross_correlation(x, &y[bestlag_reference], config->template_length)
+                             - reference_cross_correlation(x, &y[bestlag], config->template_length);
+            if (difference > max_correlation_difference){
+                max_correlation_difference = difference;
+            }
+            num_mismatches++;
+        }
+    }
+
+    volatile int sink = 0;
+    double start = now_seconds();
+    int iteration;
+    for (iteration = 0; iteration < ITERATIONS; iteration++){
+        for (i = 0; i < num_histories; i++){
+            sink += reference_pattern_match(config, &samples[i * config->frame_size]);
+        }
+    }
+    double duration_reference = now_seconds() - start;
+
+    start = now_seconds();
+    for (iteration = 0; iteration < ITERATIONS; iteration++){
+        for (i = 0; i < num_histories; i++){
+            sink += (*config->pattern_match)(&samples[i * config->frame_size]);
+        }
+    }
+    double duration = now_seconds() - start;
+    (void) sink;
+
+    double calls = (double) num_histories * ITERATIONS;
+    printf("%-5s %-36s: %5u frames, %3u different best lags (max correlation difference %.2e), reference %6.2f us, optimized %6.2f us, speedup %.1fx\n",
+           config->name, config->wav_file, num_histories, num_mismatches, max_correlation_difference,
+           duration_reference * 1e6 / calls, duration * 1e6 / calls, duration_reference / duration);
+}
+
+static const benchmark_config_t configs[] = {
+    { "CVSD", "data/fanfare_test-8khz.wav",     CVSD_FS, CVSD_N, CVSD_M, CVSD_LHIST, &btstack_cvsd_plc_pattern_match },
+    { "CVSD", "data/sco_input-16bit.wav",       CVSD_FS, CVSD_N, CVSD_M, CVSD_LHIST, &btstack_cvsd_plc_pattern_match },
+    { "mSBC", "../sbc/data/fanfare-mono.wav",   SBC_FS,  SBC_N,  SBC_M,  SBC_LHIST,  &btstack_sbc_plc_pattern_match },
+    { "mSBC", "../sbc/data/sine-mono.wav",      SBC_FS,  SBC_N,  SBC_M,  SBC_LHIST,  &btstack_sbc_plc_pattern_match },
+};
+
+int main(int argc, const char * argv[]){
+    (void) argc;
+    (void) argv;
+    unsigned int i;
+    for (i = 0; i < sizeof(configs) / sizeof(configs[0]); i++){
+        benchmark(&configs[i]);
+    }
+    return 0;
+}
@@ -15,6 +15,7 @@
 #include "CppUTest/CommandLineTestRunner.h"
 
 #include "btstack_hid_parser.h"
+#include "bluetooth.h"
 #include "hci_dump_posix_fs.h"
 
 const uint8_t mouse_descriptor_without_report_id[] = {
@@ -344,6 +345,173 @@ TEST(HID, GetReportSize){
     CHECK_EQUAL(8, report_size);
 }
 
+// compiled report layout
+
+#define TEST_MAX_REPORTS 4
+#define TEST_MAX_FIELDS 32
+
+static btstack_hid_report_layout_t  hid_report_layout;
+static btstack_hid_report_info_t    hid_report_layout_reports[TEST_MAX_REPORTS];
+static btstack_hid_report_field_t   hid_report_layout_fields[TEST_MAX_FIELDS];
+
+// compare fields provided by report iterator with single-pass parser
+static void expect_same_fields(const uint8_t * hid_descriptor, uint16_t hid_descriptor_len, hid_report_type_t report_type, const uint8_t * report, uint16_t report_len){
+    btstack_hid_report_layout_init(&hid_report_layout, hid_report_layout_reports, TEST_MAX_REPORTS, hid_report_layout_fields, TEST_MAX_FIELDS);
+    uint8_t status = btstack_hid_report_layout_compile(&hid_report_layout, hid_descriptor_len, hid_descriptor);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+
+    btstack_hid_parser_t parser;
+    btstack_hid_parser_init(&parser, hid_descriptor, hid_descriptor_len, report_type, report, report_len);
+    btstack_hid_report_iterator_t iterator;
+    btstack_hid_report_iterator_init(&iterator, &hid_report_layout, report_type, report, report_len);
+    int num_fields = 0;
+    while (btstack_hid_parser_has_more(&parser)){
+        CHECK_TRUE(btstack_hid_report_iterator_has_more(&iterator));
+        uint16_t expected_usage_page;
+        uint16_t expected_usage;
+        int32_t  expected_value;
+        btstack_hid_parser_get_field(&parser, &expected_usage_page, &expected_usage, &expected_value);
+        uint16_t usage_page;
+        uint16_t usage;
+        int32_t  value;
+        btstack_hid_report_iterator_get_field(&iterator, &usage_page, &usage, &value);
+        CHECK_EQUAL(expected_usage_page, usage_page);
+        CHECK_EQUAL(expected_usage, usage);
+        CHECK_EQUAL(expected_value, value);
+        num_fields++;
+    }
+    CHECK_FALSE(btstack_hid_report_iterator_has_more(&iterator));
+    CHECK_TRUE(num_fields > 0);
+}
+
+TEST_GROUP(HID_REPORT_LAYOUT){
+    void setup(void){
+    }
+};
+
+TEST(HID_REPORT_LAYOUT, MouseWithoutReportID){
+    expect_same_fields(mouse_descriptor_without_report_id, sizeof(mouse_descriptor_without_report_id), HID_REPORT_TYPE_INPUT, mouse_report_without_id_positive_xy, sizeof(mouse_report_without_id_positive_xy));
+    expect_same_fields(mouse_descriptor_without_report_id, sizeof(mouse_descriptor_without_report_id), HID_REPORT_TYPE_INPUT, mouse_report_without_id_negative_xy, sizeof(mouse_report_without_id_negative_xy));
+    CHECK_EQUAL(1, hid_report_layout.reports_count);
+    CHECK_EQUAL(5, hid_report_layout.fields_count);
+    CHECK_FALSE(hid_report_layout.report_id_declared);
+}
+
+TEST(HID_REPORT_LAYOUT, MouseWithReportID){
+    expect_same_fields(mouse_descriptor_with_report_id, sizeof(mouse_descriptor_with_report_id), HID_REPORT_TYPE_INPUT, mouse_report_with_id_1, sizeof(mouse_report_with_id_1));
+    CHECK_TRUE(hid_report_layout.report_id_declared);
+}
+
+TEST(HID_REPORT_LAYOUT, BootKeyboard){
+    expect_same_fields(hid_descriptor_keyboard_boot_mode, sizeof(hid_descriptor_keyboard_boot_mode), HID_REPORT_TYPE_INPUT, keyboard_report1, sizeof(keyboard_report1));
+    // input and output report
+    CHECK_EQUAL(2, hid_report_layout.reports_count);
+    const btstack_hid_report_info_t * report = btstack_hid_report_layout_get_report(&hid_report_layout, 0, HID_REPORT_TYPE_OUTPUT);
+    CHECK_TRUE(report != NULL);
+    CHECK_EQUAL(5, report->fields_count);
+    CHECK_EQUAL(8, report->size_in_bits);
+}
+
+TEST(HID_REPORT_LAYOUT, Combo){
+    expect_same_fields(combo_descriptor_with_report_ids, sizeof(combo_descriptor_with_report_ids), HID_REPORT_TYPE_INPUT, combo_report1, sizeof(combo_report1));
+    expect_same_fields(combo_descriptor_with_report_ids, sizeof(combo_descriptor_with_report_ids), HID_REPORT_TYPE_INPUT, combo_report2, sizeof(combo_report2));
+    CHECK_EQUAL(3, hid_report_layout.reports_count);
+    CHECK_EQUAL(HID_REPORT_ID_VALID,   btstack_hid_report_layout_id_valid(&hid_report_layout, 2));
+    CHECK_EQUAL(HID_REPORT_ID_INVALID, btstack_hid_report_layout_id_valid(&hid_report_layout, 3));
+}
+
+TEST(HID_REPORT_LAYOUT, ShortReport){
+    btstack_hid_report_layout_init(&hid_report_layout, hid_report_layout_reports, TEST_MAX_REPORTS, hid_report_layout_fields, TEST_MAX_FIELDS);
+    btstack_hid_report_layout_compile(&hid_report_layout, sizeof(mouse_descriptor_without_report_id), mouse_descriptor_without_report_id);
+    btstack_hid_report_iterator_t iterator;
+    btstack_hid_report_iterator_init(&iterator, &hid_report_layout, HID_REPORT_TYPE_INPUT, mouse_report_without_id_positive_xy, 2);
+    int num_fields = 0;
+    while (btstack_hid_report_iterator_has_more(&iterator)){
+        uint16_t usage_page;
+        uint16_t usage;
+        int32_t  value;
+        btstack_hid_report_iterator_get_field(&iterator, &usage_page, &usage, &value);
+        num_fields++;
+    }
+    // buttons and X
+    CHECK_EQUAL(4, num_fields);
+}
+
+TEST(HID_REPORT_LAYOUT, UnknownReport){
+    btstack_hid_report_layout_init(&hid_report_layout, hid_report_layout_reports, TEST_MAX_REPORTS, hid_report_layout_fields, TEST_MAX_FIELDS);
+    btstack_hid_report_layout_compile(&hid_report_layout, sizeof(combo_descriptor_with_report_ids), combo_descriptor_with_report_ids);
+    const uint8_t report[] = { 0x05, 0x00, 0x00 };
+    btstack_hid_report_iterator_t iterator;
+    btstack_hid_report_iterator_init(&iterator, &hid_report_layout, HID_REPORT_TYPE_INPUT, report, sizeof(report));
+    CHECK_FALSE(btstack_hid_report_iterator_has_more(&iterator));
+}
+
+TEST(HID_REPORT_LAYOUT, GetReportSize){
+    // report sizes only, without field table
+    btstack_hid_report_layout_init(&hid_report_layout, hid_report_layout_reports, TEST_MAX_REPORTS, NULL, 0);
+    uint8_t status = btstack_hid_report_layout_compile(&hid_report_layout, sizeof(combo_descriptor_with_report_ids), combo_descriptor_with_report_ids);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(3, btstack_hid_report_layout_get_report_size(&hid_report_layout, 1, HID_REPORT_TYPE_INPUT));
+    CHECK_EQUAL(8, btstack_hid_report_layout_get_report_size(&hid_report_layout, 2, HID_REPORT_TYPE_INPUT));
+    CHECK_EQUAL(1, btstack_hid_report_layout_get_report_size(&hid_report_layout, 2, HID_REPORT_TYPE_OUTPUT));
+    CHECK_EQUAL(0, btstack_hid_report_layout_get_report_size(&hid_report_layout, 2, HID_REPORT_TYPE_FEATURE));
+
+    status = btstack_hid_report_layout_compile(&hid_report_layout, sizeof(hid_descriptor_keyboard_boot_mode), hid_descriptor_keyboard_boot_mode);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+    CHECK_EQUAL(1, btstack_hid_report_layout_get_report_size(&hid_report_layout, 0, HID_REPORT_TYPE_OUTPUT));
+    CHECK_EQUAL(8, btstack_hid_report_layout_get_report_size(&hid_report_layout, 0, HID_REPORT_TYPE_INPUT));
+    CHECK_EQUAL(HID_REPORT_ID_UNDECLARED, btstack_hid_report_layout_id_valid(&hid_report_layout, 0));
+}
+
+TEST(HID_REPORT_LAYOUT, CapacityExceeded){
+    btstack_hid_report_layout_init(&hid_report_layout, hid_report_layout_reports, 2, hid_report_layout_fields, TEST_MAX_FIELDS);
+    uint8_t status = btstack_hid_report_layout_compile(&hid_report_layout, sizeof(combo_descriptor_with_report_ids), combo_descriptor_with_report_ids);
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, status);
+
+    btstack_hid_report_layout_init(&hid_report_layout, hid_report_layout_reports, TEST_MAX_REPORTS, hid_report_layout_fields, 10);
+    status = btstack_hid_report_layout_compile(&hid_report_layout, sizeof(combo_descriptor_with_report_ids), combo_descriptor_with_report_ids);
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, status);
+}
+
+TEST(HID_REPORT_LAYOUT, OversizedDescriptor){
+    // Report Size 1, Report Count 255, followed by Input items: 258 items exceed 0xffff fields and bits
+    static uint8_t oversized_descriptor[8 + 2 * 258];
+    const uint8_t header[] = { 0x05, 0x01, 0x09, 0x30, 0x75, 0x01, 0x95, 0xff };
+    memcpy(oversized_descriptor, header, sizeof(header));
+    uint16_t pos = sizeof(header);
+    while (pos < sizeof(oversized_descriptor)){
+        oversized_descriptor[pos++] = 0x81;
+        oversized_descriptor[pos++] = 0x02;
+    }
+
+    btstack_hid_report_layout_init(&hid_report_layout, hid_report_layout_reports, TEST_MAX_REPORTS, hid_report_layout_fields, TEST_MAX_FIELDS);
+    uint8_t status = btstack_hid_report_layout_compile(&hid_report_layout, sizeof(oversized_descriptor), oversized_descriptor);
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, status);
+
+    // report sizes only
+    btstack_hid_report_layout_init(&hid_report_layout, hid_report_layout_reports, TEST_MAX_REPORTS, NULL, 0);
+    status = btstack_hid_report_layout_compile(&hid_report_layout, sizeof(oversized_descriptor), oversized_descriptor);
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, status);
+
+    // 257 items fit into 16 bit but not into field table
+    btstack_hid_report_layout_init(&hid_report_layout, hid_report_layout_reports, TEST_MAX_REPORTS, hid_report_layout_fields, TEST_MAX_FIELDS);
+    status = btstack_hid_report_layout_compile(&hid_report_layout, sizeof(oversized_descriptor) - 2, oversized_descriptor);
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, status);
+}
+
+TEST(HID_REPORT_LAYOUT, FieldLargerThan32Bits){
+    btstack_hid_report_field_t field;
+    memset(&field, 0, sizeof(field));
+    field.bit_offset = 4;
+    field.bit_size   = 200;
+    uint8_t report[32];
+    uint16_t i;
+    for (i=0; i < sizeof(report); i++){
+        report[i] = (uint8_t) (0x10u + i);
+    }
+    // lower 32 bits starting at bit 4
+    CHECK_EQUAL((int32_t) 0x41312111, btstack_hid_report_field_get_value(&field, report, sizeof(report)));
+}
 
 int main (int argc, const char * argv[]){
     // log into file using HCI_DUMP_PACKETLOGGER format
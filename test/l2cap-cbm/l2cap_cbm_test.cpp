@@ -20,6 +20,8 @@ const hci_transport_t * mock_hci_transport_mock_get_instance(void);
 static uint8_t  mock_hci_transport_outgoing_packet_buffer[HCI_ACL_PAYLOAD_SIZE];
 static uint16_t mock_hci_transport_outgoing_packet_size;
 static uint8_t  mock_hci_transport_outgoing_packet_type;
+static uint16_t mock_hci_transport_outgoing_cids[16];
+static uint16_t mock_hci_transport_outgoing_num_packets;
 
 static void (*mock_hci_transport_packet_handler)(uint8_t packet_type, uint8_t * packet, uint16_t size);
 static void mock_hci_transport_register_packet_handler(void (*packet_handler)(uint8_t packet_type, uint8_t * packet, uint16_t size)){
@@ -29,6 +31,10 @@ static int mock_hci_transport_send_packet(uint8_t packet_type, uint8_t *packet,
     mock_hci_transport_outgoing_packet_type = packet_type;
     mock_hci_transport_outgoing_packet_size = size;
     memcpy(mock_hci_transport_outgoing_packet_buffer, packet, size);
+    // log destination cid of acl packets
+    if ((packet_type == HCI_ACL_DATA_PACKET) && (mock_hci_transport_outgoing_num_packets < 16)){
+        mock_hci_transport_outgoing_cids[mock_hci_transport_outgoing_num_packets++] = little_endian_read_16(packet, 6);
+    }
     return 0;
 }
 const hci_transport_t * mock_hci_transport_mock_get_instance(void){
@@ -51,6 +57,7 @@ void mock_hci_transport_receive_packet(uint8_t packet_type, const uint8_t * pack
 //
 
 #include <stdint.h>
+#include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -76,6 +83,10 @@ static uint16_t initial_credits = L2CAP_LE_AUTOMATIC_CREDITS;
 static uint8_t data_channel_buffer[TEST_PACKET_SIZE];
 static uint16_t l2cap_cid;
 static bool l2cap_channel_opened;
+static uint16_t l2cap_channels_opened;
+static uint32_t l2cap_data_packets_received[256];
+static uint8_t * l2cap_next_receive_buffer;
+static uint8_t   l2cap_set_receive_buffer_status;
 static btstack_packet_callback_registration_t l2cap_event_callback_registration;
 
 const uint8_t le_data_channel_conn_request_1[] = {
@@ -137,11 +148,19 @@ static void l2cap_channel_packet_handler(uint8_t packet_type, uint16_t channel,
                     break;
                 case L2CAP_EVENT_CBM_CHANNEL_OPENED:
                     l2cap_channel_opened = true;
+                    l2cap_channels_opened++;
                     break;
                 default:
                     break;
             }
             break;
+        case L2CAP_DATA_PACKET:
+            l2cap_data_packets_received[channel & 0xff]++;
+            if (l2cap_next_receive_buffer != NULL){
+                l2cap_set_receive_buffer_status = l2cap_cbm_set_receive_buffer(channel, l2cap_next_receive_buffer);
+                l2cap_next_receive_buffer = NULL;
+            }
+            break;
         default:
             break;
     }
@@ -160,6 +179,11 @@ TEST_GROUP(L2CAP_CHANNELS){
         l2cap_register_fixed_channel(&l2cap_channel_packet_handler, L2CAP_CID_ATTRIBUTE_PROTOCOL);
         hci_dump_init(hci_dump_posix_stdout_get_instance());
         l2cap_channel_opened = false;
+        l2cap_channels_opened = 0;
+        initial_credits = L2CAP_LE_AUTOMATIC_CREDITS;
+        memset(l2cap_data_packets_received, 0, sizeof(l2cap_data_packets_received));
+        l2cap_next_receive_buffer = NULL;
+        mock_hci_transport_outgoing_num_packets = 0;
     }
     void teardown(void){
         l2cap_remove_event_handler(&l2cap_event_callback_registration);
@@ -292,6 +316,301 @@ TEST(L2CAP_CHANNELS, incoming_decline){
     // TODO: verify data
 }
 
+static void mock_hci_emit_number_of_completed_packets(hci_con_handle_t con_handle, uint16_t num_packets){
+    uint8_t event[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 1, 0 };
+    little_endian_store_16(event, 3, con_handle);
+    little_endian_store_16(event, 5, num_packets);
+    mock_hci_transport_receive_packet(HCI_EVENT_PACKET, (const uint8_t *) event, sizeof(event));
+}
+
+static void le_data_channel_setup_conn_request(uint8_t * packet, uint8_t sig_id, uint16_t source_cid, uint16_t credits){
+    (void)memcpy(packet, le_data_channel_conn_request_1, sizeof(le_data_channel_conn_request_1));
+    packet[9] = sig_id;
+    little_endian_store_16(packet, 14, source_cid);
+    // mps fits into HCI_ACL_PAYLOAD_SIZE
+    little_endian_store_16(packet, 18, 40);
+    little_endian_store_16(packet, 20, credits);
+}
+
+static void le_data_channel_setup_credits(uint8_t * packet, uint8_t sig_id, uint16_t source_cid){
+    const uint8_t credits[] = { 0x05, 0x20, 0x0c, 0x00, 0x08, 0x00, 0x05, 0x00, 0x16, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0x00 };
+    (void)memcpy(packet, credits, sizeof(credits));
+    packet[9] = sig_id;
+    little_endian_store_16(packet, 12, source_cid);
+}
+
+static void le_data_channel_setup_data(uint8_t * packet, uint16_t local_cid){
+    const uint8_t data[] = { 0x05, 0x20, 0x0b, 0x00, 0x07, 0x00, 0x00, 0x00, 0x05, 0x00, 0x68, 0x65, 0x6c, 0x6c, 0x6f };
+    (void)memcpy(packet, data, sizeof(data));
+    little_endian_store_16(packet, 6, local_cid);
+}
+
+static uint32_t time_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) (ts.tv_sec * 1000000000ul + ts.tv_nsec);
+}
+
+#define BENCHMARK_NUM_CHANNELS 240
+#define BENCHMARK_NUM_ROUNDS   100
+
+TEST(L2CAP_CHANNELS, channel_lookup_many_channels){
+    // channel lookup by local cid and by con handle + remote cid, measure time per incoming pdu
+    uint8_t packet[32];
+    uint16_t i;
+    hci_dump_enable_packet_log(false);
+    hci_dump_enable_log_level(HCI_DUMP_LOG_LEVEL_INFO, 0);
+    hci_setup_test_connections_fuzz();
+    initial_credits = 1000;
+    l2cap_cbm_register_service(&l2cap_channel_packet_handler, TEST_PSM, LEVEL_0);
+    l2cap_channel_accept_incoming = true;
+    for (i=0;i<BENCHMARK_NUM_CHANNELS;i++){
+        le_data_channel_setup_conn_request(packet, (uint8_t) (1 + (i % 254)), 0x40 + i, 0);
+        mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, sizeof(le_data_channel_conn_request_1));
+        mock_hci_emit_number_of_completed_packets(HCI_CON_HANDLE_TEST_LE, 1);
+    }
+    CHECK_EQUAL(BENCHMARK_NUM_CHANNELS, l2cap_channels_opened);
+
+    // channels use local cids 0x41.. and remote cids 0x40.., credits are routed by remote cid
+    for (i=0;i<BENCHMARK_NUM_CHANNELS;i+=2){
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_send(0x41 + i, (const uint8_t *) "hello", 5));
+    }
+    for (i=0;i<BENCHMARK_NUM_CHANNELS;i+=2){
+        mock_hci_transport_outgoing_packet_size = 0;
+        le_data_channel_setup_credits(packet, (uint8_t) (1 + (i % 254)), 0x40 + i);
+        mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, 16);
+        CHECK_EQUAL(15, mock_hci_transport_outgoing_packet_size);
+        CHECK_EQUAL(0x40 + i, little_endian_read_16(mock_hci_transport_outgoing_packet_buffer, 6));
+        mock_hci_emit_number_of_completed_packets(HCI_CON_HANDLE_TEST_LE, 1);
+    }
+
+    // data is routed by local cid
+    uint16_t round;
+    uint32_t start_ns = time_ns();
+    for (round=0;round<BENCHMARK_NUM_ROUNDS;round++){
+        for (i=0;i<BENCHMARK_NUM_CHANNELS;i++){
+            le_data_channel_setup_data(packet, 0x41 + i);
+            mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, 15);
+        }
+    }
+    uint32_t pdu_ns = (time_ns() - start_ns) / (BENCHMARK_NUM_ROUNDS * BENCHMARK_NUM_CHANNELS);
+    for (i=0;i<BENCHMARK_NUM_CHANNELS;i++){
+        CHECK_EQUAL(BENCHMARK_NUM_ROUNDS, l2cap_data_packets_received[(0x41 + i) & 0xff]);
+    }
+
+    // api calls by local cid
+    uint32_t num_can_send = 0;
+    start_ns = time_ns();
+    for (round=0;round<BENCHMARK_NUM_ROUNDS;round++){
+        for (i=0;i<BENCHMARK_NUM_CHANNELS;i++){
+            if (l2cap_can_send_packet_now(0x41 + i)){
+                num_can_send++;
+            }
+        }
+    }
+    uint32_t lookup_ns = (time_ns() - start_ns) / (BENCHMARK_NUM_ROUNDS * BENCHMARK_NUM_CHANNELS);
+    CHECK_EQUAL(BENCHMARK_NUM_ROUNDS * BENCHMARK_NUM_CHANNELS, num_can_send);
+
+    printf("L2CAP with %u channels: %u ns per incoming pdu, %u ns per local cid lookup\n",
+           BENCHMARK_NUM_CHANNELS, (int) pdu_ns, (int) lookup_ns);
+    hci_dump_enable_packet_log(true);
+    hci_dump_enable_log_level(HCI_DUMP_LOG_LEVEL_INFO, 1);
+}
+
+#define CAN_SEND_NOW_NUM_CHANNELS 64
+
+TEST(L2CAP_CHANNELS, can_send_now_round_robin){
+    // channels waiting for Controller buffers are served in round-robin order, one channel per freed buffer
+    uint8_t packet[32];
+    uint16_t i;
+    hci_dump_enable_packet_log(false);
+    hci_dump_enable_log_level(HCI_DUMP_LOG_LEVEL_INFO, 0);
+    hci_setup_test_connections_fuzz();
+    initial_credits = 1000;
+    l2cap_cbm_register_service(&l2cap_channel_packet_handler, TEST_PSM, LEVEL_0);
+    l2cap_channel_accept_incoming = true;
+    for (i=0;i<CAN_SEND_NOW_NUM_CHANNELS;i++){
+        le_data_channel_setup_conn_request(packet, (uint8_t) (1 + i), 0x40 + i, 10);
+        mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, sizeof(le_data_channel_conn_request_1));
+        mock_hci_emit_number_of_completed_packets(HCI_CON_HANDLE_TEST_LE, 1);
+    }
+    CHECK_EQUAL(CAN_SEND_NOW_NUM_CHANNELS, l2cap_channels_opened);
+
+    // use up all Controller buffers
+    uint16_t num_buffers = 0;
+    while (hci_can_send_acl_le_packet_now()){
+        l2cap_send_connectionless(HCI_CON_HANDLE_TEST_LE, L2CAP_CID_ATTRIBUTE_PROTOCOL, packet, 5);
+        num_buffers++;
+    }
+    CHECK(num_buffers > 0);
+
+    // SDU is sent in 3 PDUs with mps 40
+    for (i=0;i<CAN_SEND_NOW_NUM_CHANNELS;i++){
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_send(0x41 + i, data_channel_buffer, sizeof(data_channel_buffer)));
+    }
+
+    uint32_t num_wakeups_before;
+    uint32_t num_sends_before;
+    l2cap_get_can_send_now_statistics(&num_wakeups_before, &num_sends_before);
+
+    uint16_t round;
+    for (round=0;round<3;round++){
+        for (i=0;i<CAN_SEND_NOW_NUM_CHANNELS;i++){
+            mock_hci_transport_outgoing_packet_size = 0;
+            mock_hci_emit_number_of_completed_packets(HCI_CON_HANDLE_TEST_LE, 1);
+            CHECK(mock_hci_transport_outgoing_packet_size > 0);
+            CHECK_EQUAL(0x40 + i, little_endian_read_16(mock_hci_transport_outgoing_packet_buffer, 6));
+        }
+    }
+
+    // each freed buffer checks the channel that can send and the next one waiting for a buffer, independent of number of channels
+    uint32_t num_wakeups;
+    uint32_t num_sends;
+    l2cap_get_can_send_now_statistics(&num_wakeups, &num_sends);
+    CHECK_EQUAL(3 * CAN_SEND_NOW_NUM_CHANNELS, num_sends - num_sends_before);
+    CHECK(num_wakeups - num_wakeups_before <= 4 * (num_sends - num_sends_before));
+    printf("L2CAP with %u channels waiting: %u wakeups for %u sends\n", CAN_SEND_NOW_NUM_CHANNELS,
+           (int) (num_wakeups - num_wakeups_before), (int) (num_sends - num_sends_before));
+    hci_dump_enable_packet_log(true);
+    hci_dump_enable_log_level(HCI_DUMP_LOG_LEVEL_INFO, 1);
+}
+
+TEST(L2CAP_CHANNELS, automatic_credits_window){
+    // automatic credits are refilled once half of the window is used, window grows if remote uses it up quickly
+    uint8_t packet[32];
+    hci_dump_enable_packet_log(false);
+    hci_dump_enable_log_level(HCI_DUMP_LOG_LEVEL_INFO, 0);
+    hci_setup_test_connections_fuzz();
+    l2cap_cbm_register_service(&l2cap_channel_packet_handler, TEST_PSM, LEVEL_0);
+    l2cap_channel_accept_incoming = true;
+    le_data_channel_setup_conn_request(packet, 1, 0x40, 10);
+    mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, sizeof(le_data_channel_conn_request_1));
+    mock_hci_emit_number_of_completed_packets(HCI_CON_HANDLE_TEST_LE, 1);
+    CHECK(l2cap_channel_opened);
+
+    // remote uses up initial credits and all credits provided afterwards
+    uint16_t credits_granted[8];
+    uint16_t num_credit_indications = 0;
+    uint32_t credits_remote = L2CAP_LE_AUTOMATIC_CREDITS;
+    uint32_t num_pdus = 0;
+    le_data_channel_setup_data(packet, 0x41);
+    while ((num_credit_indications < 8) && (credits_remote > 0)){
+        mock_hci_transport_outgoing_packet_size = 0;
+        mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, 15);
+        credits_remote--;
+        num_pdus++;
+        if (mock_hci_transport_outgoing_packet_size == 0) continue;
+        // flow control credit indication on le signaling channel
+        CHECK_EQUAL(L2CAP_CID_SIGNALING_LE, little_endian_read_16(mock_hci_transport_outgoing_packet_buffer, 6));
+        CHECK_EQUAL(L2CAP_FLOW_CONTROL_CREDIT_INDICATION, mock_hci_transport_outgoing_packet_buffer[8]);
+        CHECK_EQUAL(0x41, little_endian_read_16(mock_hci_transport_outgoing_packet_buffer, 12));
+        uint16_t credits = little_endian_read_16(mock_hci_transport_outgoing_packet_buffer, 14);
+        credits_granted[num_credit_indications++] = credits;
+        credits_remote += credits;
+        mock_hci_emit_number_of_completed_packets(HCI_CON_HANDLE_TEST_LE, 1);
+    }
+    CHECK_EQUAL(8, num_credit_indications);
+    CHECK_EQUAL(num_pdus, l2cap_data_packets_received[0x41]);
+
+    // time doesn't advance in test, window doubles until max, then half of max window is refilled
+    uint16_t i;
+    for (i=1;i<4;i++){
+        CHECK(credits_granted[i] > credits_granted[i-1]);
+    }
+    CHECK(credits_granted[0] >= 5);
+    CHECK(credits_granted[3] > (credits_granted[0] * 4));
+    CHECK_EQUAL(credits_granted[6], credits_granted[7]);
+    CHECK(credits_granted[7] <= 256);
+    printf("L2CAP automatic credits: %u, %u, %u, %u, %u, %u, %u, %u\n", credits_granted[0], credits_granted[1], credits_granted[2],
+           credits_granted[3], credits_granted[4], credits_granted[5], credits_granted[6], credits_granted[7]);
+    hci_dump_enable_packet_log(true);
+    hci_dump_enable_log_level(HCI_DUMP_LOG_LEVEL_INFO, 1);
+}
+
+static void throughput_mode_send_two_sdus(bool throughput_mode){
+    uint8_t packet[32];
+    hci_setup_test_connections_fuzz();
+    initial_credits = 10;
+    l2cap_cbm_register_service(&l2cap_channel_packet_handler, TEST_PSM, LEVEL_0);
+    l2cap_channel_accept_incoming = true;
+    uint16_t i;
+    for (i=0;i<2;i++){
+        le_data_channel_setup_conn_request(packet, (uint8_t) (1 + i), 0x40 + i, 10);
+        mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, sizeof(le_data_channel_conn_request_1));
+        mock_hci_emit_number_of_completed_packets(HCI_CON_HANDLE_TEST_LE, 1);
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_cbm_set_throughput_mode(0x41 + i, throughput_mode));
+    }
+    CHECK_EQUAL(2, l2cap_channels_opened);
+
+    // use up all Controller buffers
+    uint16_t num_buffers = 0;
+    while (hci_can_send_acl_le_packet_now()){
+        l2cap_send_connectionless(HCI_CON_HANDLE_TEST_LE, L2CAP_CID_ATTRIBUTE_PROTOCOL, packet, 5);
+        num_buffers++;
+    }
+    CHECK(num_buffers >= 6);
+
+    // SDU is sent in 3 PDUs with mps 40, free buffers for both SDUs at once
+    for (i=0;i<2;i++){
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_send(0x41 + i, data_channel_buffer, sizeof(data_channel_buffer)));
+    }
+    mock_hci_transport_outgoing_num_packets = 0;
+    mock_hci_emit_number_of_completed_packets(HCI_CON_HANDLE_TEST_LE, 6);
+    CHECK_EQUAL(6, mock_hci_transport_outgoing_num_packets);
+}
+
+TEST(L2CAP_CHANNELS, throughput_mode_disabled){
+    // channels take turns
+    throughput_mode_send_two_sdus(false);
+    const uint16_t expected_cids[] = { 0x40, 0x41, 0x40, 0x41, 0x40, 0x41 };
+    MEMCMP_EQUAL(expected_cids, mock_hci_transport_outgoing_cids, sizeof(expected_cids));
+}
+
+TEST(L2CAP_CHANNELS, throughput_mode_enabled){
+    // all K-frames of an SDU are sent in one pass
+    throughput_mode_send_two_sdus(true);
+    const uint16_t expected_cids[] = { 0x40, 0x40, 0x40, 0x41, 0x41, 0x41 };
+    MEMCMP_EQUAL(expected_cids, mock_hci_transport_outgoing_cids, sizeof(expected_cids));
+}
+
+TEST(L2CAP_CHANNELS, set_receive_buffer){
+    uint8_t packet[32];
+    uint8_t next_receive_buffer[TEST_PACKET_SIZE];
+    hci_setup_test_connections_fuzz();
+    l2cap_cbm_register_service(&l2cap_channel_packet_handler, TEST_PSM, LEVEL_0);
+    l2cap_channel_accept_incoming = true;
+    le_data_channel_setup_conn_request(packet, 1, 0x40, 10);
+    mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, sizeof(le_data_channel_conn_request_1));
+    CHECK(l2cap_channel_opened);
+    CHECK_EQUAL(L2CAP_LOCAL_CID_DOES_NOT_EXIST, l2cap_cbm_set_receive_buffer(0x42, next_receive_buffer));
+    memset(data_channel_buffer, 0, sizeof(data_channel_buffer));
+    memset(next_receive_buffer, 0, sizeof(next_receive_buffer));
+
+    // first SDU is received into buffer provided on accept, next buffer is set in packet handler
+    l2cap_next_receive_buffer = next_receive_buffer;
+    l2cap_set_receive_buffer_status = ERROR_CODE_UNSPECIFIED_ERROR;
+    le_data_channel_setup_data(packet, 0x41);
+    mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, 15);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_set_receive_buffer_status);
+    MEMCMP_EQUAL("hello", data_channel_buffer, 5);
+
+    // second SDU with 10 bytes is received into next buffer
+    little_endian_store_16(packet, 8, 10);
+    mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, 15);
+    MEMCMP_EQUAL("hello", next_receive_buffer, 5);
+    CHECK_EQUAL(1, l2cap_data_packets_received[0x41]);
+
+    // buffer cannot be changed during reassembly, second K-frame completes SDU
+    CHECK_EQUAL(ERROR_CODE_COMMAND_DISALLOWED, l2cap_cbm_set_receive_buffer(0x41, data_channel_buffer));
+    packet[2] = 9;
+    packet[4] = 5;
+    memmove(&packet[8], &packet[10], 5);
+    mock_hci_transport_receive_packet(HCI_ACL_DATA_PACKET, (const uint8_t *) packet, 13);
+    CHECK_EQUAL(2, l2cap_data_packets_received[0x41]);
+    MEMCMP_EQUAL("hello", &next_receive_buffer[5], 5);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, l2cap_cbm_set_receive_buffer(0x41, data_channel_buffer));
+}
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
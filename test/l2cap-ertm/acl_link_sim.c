@@ -0,0 +1,1019 @@
+// *****************************************************************************
+//
+// simulated BR/EDR ACL link to a remote L2CAP ERTM device with virtual time
+//
+// The baseband is modeled as a sequence of exchanges: in each exchange, the
+// local Controller sends its next queued ACL packet (or a POLL) and the remote
+// answers with its next ACL fragment (or a NULL). Each packet occupies 1, 3 or
+// 5 slots depending on its size (3-DH1/3-DH3/3-DH5). With packet_error_rate, a
+// packet is lost and retransmitted in the next exchange. Number of Completed
+// Packets is reported at the end of the exchange that delivered the packet.
+// Packets between host and Controller are delayed by host_latency_us on both
+// sides, the remote needs twice this time to respond.
+//
+// The remote L2CAP implements ERTM like common stacks do: it acknowledges
+// received I-frames after 3/4 of the TX Window confirmed by the peer or after SIM_ACK_TIMEOUT_MS,
+// piggybacks acknowledgements on its I-frames, retransmits after REJ/SREJ and
+// polls after its retransmission timeout. All data follows a fixed pattern.
+//
+// *****************************************************************************
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "acl_link_sim.h"
+#include "bluetooth.h"
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_run_loop_embedded.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_transport.h"
+#include "l2cap.h"
+#include "l2cap_signaling.h"
+
+#define SIM_CON_HANDLE               0x0003
+#define SIM_REMOTE_CID               0x0040
+#define SIM_MAX_ACL_BUFFERS          64
+#define SIM_MAX_SIGNALING_PDUS       4
+#define SIM_MAX_DELAYED_PACKETS      128
+#define SIM_MAX_PDU_LEN              (HCI_ACL_PAYLOAD_SIZE + 16)
+
+// remote host keeps a few ACL packets queued in its Controller
+#define SIM_REMOTE_QUEUE_LEN         8
+#define SIM_ACK_TIMEOUT_MS           200
+#define SIM_RETRANSMISSION_TIMEOUT_MS 2000
+
+// give up after 10 minutes of virtual time
+#define SIM_TIMEOUT_MS               600000
+
+// ERTM control field
+#define SIM_SAR_UNSEGMENTED          0
+#define SIM_SAR_START                1
+#define SIM_SAR_END                  2
+#define SIM_SAR_CONTINUATION         3
+#define SIM_S_RR                     0
+#define SIM_S_REJ                    1
+#define SIM_S_RNR                    2
+#define SIM_S_SREJ                   3
+
+// signaling
+#define SIM_INFO_TYPE_EXTENDED_FEATURES             2
+#define SIM_INFO_TYPE_FIXED_CHANNELS                3
+#define SIM_OPTION_MTU                              1
+#define SIM_OPTION_RETRANSMISSION_AND_FLOW_CONTROL  4
+#define SIM_OPTION_FRAME_CHECK_SEQUENCE             5
+
+typedef struct {
+    uint16_t len;
+    uint8_t  data[4 + HCI_ACL_PAYLOAD_SIZE];
+} sim_acl_packet_t;
+
+typedef struct {
+    uint16_t len;
+    uint8_t  data[SIM_MAX_PDU_LEN];
+} sim_pdu_t;
+
+typedef struct {
+    uint64_t time_us;
+    uint8_t  packet_type;
+    uint16_t len;
+    uint8_t  data[HCI_INCOMING_PRE_BUFFER_SIZE + 4 + HCI_ACL_PAYLOAD_SIZE];
+} sim_delayed_packet_t;
+
+typedef struct {
+    sim_delayed_packet_t packets[SIM_MAX_DELAYED_PACKETS];
+    uint16_t head;
+    uint16_t count;
+} sim_delay_queue_t;
+
+typedef struct {
+    uint8_t  sar;
+    uint16_t len;
+    bool     sent;
+    uint8_t  payload[SIM_MAX_PDU_LEN];
+} sim_frame_t;
+
+static acl_link_sim_config_t sim_config;
+static acl_link_sim_stats_t  sim_stats;
+static uint64_t              sim_time_us;
+
+// local HCI
+static void (*sim_hci_packet_handler)(uint8_t packet_type, uint8_t * packet, uint16_t size);
+static sim_acl_packet_t sim_local_queue[SIM_MAX_ACL_BUFFERS];
+static uint8_t          sim_local_queue_head;
+static uint8_t          sim_local_queue_count;
+
+// packets on the way: local host to Controller, local Controller to host, remote Controller to host
+static sim_delay_queue_t sim_local_tx_delay;
+static sim_delay_queue_t sim_local_rx_delay;
+static sim_delay_queue_t sim_remote_rx_delay;
+
+// current exchange
+static bool     sim_exchange_active;
+static uint64_t sim_exchange_end_us;
+static bool     sim_exchange_local_packet;
+static bool     sim_exchange_local_lost;
+static uint16_t sim_exchange_remote_len;
+static bool     sim_exchange_remote_lost;
+
+// remote: outgoing PDU in fragmentation
+static sim_pdu_t sim_remote_pdu;
+static uint16_t  sim_remote_pdu_pos;
+static bool      sim_remote_pdu_dropped;
+static uint8_t   sim_remote_fragment[4 + HCI_ACL_PAYLOAD_SIZE];
+
+// remote: incoming PDU reassembly
+static sim_pdu_t sim_remote_rx_pdu;
+
+// remote: signaling
+static sim_pdu_t sim_remote_signaling[SIM_MAX_SIGNALING_PDUS];
+static uint8_t   sim_remote_signaling_count;
+static uint8_t   sim_remote_sig_id;
+static uint16_t  sim_remote_local_cid;
+static uint16_t  sim_remote_peer_mtu;
+static uint16_t  sim_remote_peer_mps;
+static uint8_t   sim_remote_peer_tx_window;
+static uint8_t   sim_remote_ack_window;
+
+// remote: ERTM receiver
+static uint8_t   sim_remote_expected_tx_seq;
+static uint8_t   sim_remote_last_acked_seq;
+static bool      sim_remote_rej_sent;
+static bool      sim_remote_send_s_frame;
+static uint8_t   sim_remote_s_frame_type;
+static bool      sim_remote_s_frame_poll;
+static bool      sim_remote_s_frame_final;
+static uint64_t  sim_remote_ack_deadline_us;
+static uint16_t  sim_remote_rx_sdu_len;
+static uint16_t  sim_remote_rx_sdu_pos;
+static uint32_t  sim_remote_rx_bytes;
+
+// remote: ERTM sender
+static sim_frame_t sim_remote_frames[64];
+static uint8_t   sim_remote_next_tx_seq;
+static uint8_t   sim_remote_expected_ack_seq;
+static uint8_t   sim_remote_send_queue[64];
+static uint8_t   sim_remote_send_queue_count;
+static bool      sim_remote_peer_busy;
+static bool      sim_remote_wait_for_final;
+static uint64_t  sim_remote_rtx_deadline_us;
+static uint32_t  sim_remote_tx_remaining;
+static uint32_t  sim_remote_tx_offset;
+static uint16_t  sim_remote_tx_sdu_len;
+static uint16_t  sim_remote_tx_sdu_pos;
+static uint32_t  sim_remote_new_i_frames;
+
+// local application
+static uint16_t  sim_local_cid;
+static uint16_t  sim_local_remote_mtu;
+static uint8_t   sim_local_open_status;
+static bool      sim_local_channel_opened;
+static uint32_t  sim_local_tx_remaining;
+static uint32_t  sim_local_tx_offset;
+static uint32_t  sim_local_rx_bytes;
+static bool      sim_data_valid;
+static uint8_t   sim_local_sdu[0xffff];
+
+// CRC-16 with polynomial 0x8005, as used for L2CAP FCS
+static uint16_t sim_crc16(const uint8_t * data, uint16_t len){
+    uint16_t crc = 0;
+    uint16_t i;
+    for (i = 0; i < len; i++){
+        crc ^= data[i];
+        uint8_t bit;
+        for (bit = 0; bit < 8; bit++){
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static uint8_t sim_pattern(uint32_t offset){
+    return (uint8_t) (offset + (offset >> 8));
+}
+
+static uint8_t sim_slots_for_len(uint16_t len){
+    if (len <= 83)  return 1;
+    if (len <= 552) return 3;
+    return 5;
+}
+
+static bool sim_packet_lost(void){
+    if (sim_config.packet_error_rate == 0) return false;
+    return (uint8_t) (rand() % 100) < sim_config.packet_error_rate;
+}
+
+static uint8_t sim_seq_delta(uint8_t a, uint8_t b){
+    return (uint8_t) ((a - b) & 0x3f);
+}
+
+static void sim_delay_queue_add(sim_delay_queue_t * queue, uint32_t delay_us, uint8_t packet_type, const uint8_t * data, uint16_t len){
+    btstack_assert(queue->count < SIM_MAX_DELAYED_PACKETS);
+    btstack_assert(len <= (sizeof(queue->packets[0].data) - HCI_INCOMING_PRE_BUFFER_SIZE));
+    sim_delayed_packet_t * packet = &queue->packets[(queue->head + queue->count) % SIM_MAX_DELAYED_PACKETS];
+    packet->time_us = sim_time_us + delay_us;
+    packet->packet_type = packet_type;
+    packet->len = len;
+    memcpy(&packet->data[HCI_INCOMING_PRE_BUFFER_SIZE], data, len);
+    queue->count++;
+}
+
+static sim_delayed_packet_t * sim_delay_queue_get_due(sim_delay_queue_t * queue){
+    if (queue->count == 0) return NULL;
+    sim_delayed_packet_t * packet = &queue->packets[queue->head];
+    if (packet->time_us > sim_time_us) return NULL;
+    queue->head = (queue->head + 1) % SIM_MAX_DELAYED_PACKETS;
+    queue->count--;
+    return packet;
+}
+
+static uint64_t sim_delay_queue_next_time(const sim_delay_queue_t * queue){
+    if (queue->count == 0) return UINT64_MAX;
+    return queue->packets[queue->head].time_us;
+}
+
+// hal_time_ms.h
+uint32_t hal_time_ms(void){
+    return (uint32_t) (sim_time_us / 1000);
+}
+
+// hal_cpu.h
+void hal_cpu_disable_irqs(void){
+}
+void hal_cpu_enable_irqs(void){
+}
+void hal_cpu_enable_irqs_and_sleep(void){
+}
+
+// HCI Transport
+static void sim_hci_transport_register_packet_handler(void (*packet_handler)(uint8_t packet_type, uint8_t * packet, uint16_t size)){
+    sim_hci_packet_handler = packet_handler;
+}
+
+static int sim_hci_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_ACL_DATA_PACKET) return 0;
+    sim_delay_queue_add(&sim_local_tx_delay, sim_config.host_latency_us, packet_type, packet, (uint16_t) size);
+    return 0;
+}
+
+static void sim_controller_queue_acl_packet(const uint8_t * packet, uint16_t size){
+    btstack_assert(sim_local_queue_count < SIM_MAX_ACL_BUFFERS);
+    btstack_assert(size <= sizeof(sim_local_queue[0].data));
+    sim_acl_packet_t * acl_packet = &sim_local_queue[(sim_local_queue_head + sim_local_queue_count) % SIM_MAX_ACL_BUFFERS];
+    acl_packet->len = size;
+    memcpy(acl_packet->data, packet, size);
+    sim_local_queue_count++;
+}
+
+static const hci_transport_t * sim_hci_transport_get_instance(void){
+    static hci_transport_t sim_hci_transport = {
+        /*  .transport.name                          = */  "sim",
+        /*  .transport.init                          = */  NULL,
+        /*  .transport.open                          = */  NULL,
+        /*  .transport.close                         = */  NULL,
+        /*  .transport.register_packet_handler       = */  &sim_hci_transport_register_packet_handler,
+        /*  .transport.can_send_packet_now           = */  NULL,
+        /*  .transport.send_packet                   = */  &sim_hci_transport_send_packet,
+        /*  .transport.set_baudrate                  = */  NULL,
+        /*  .transport.reset_link                    = */  NULL,
+        /*  .transport.set_sco_config                = */  NULL,
+    };
+    return &sim_hci_transport;
+}
+
+static void sim_hci_emit_number_of_completed_packets(void){
+    uint8_t event[7];
+    event[0] = HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS;
+    event[1] = 5;
+    event[2] = 1;
+    little_endian_store_16(event, 3, SIM_CON_HANDLE);
+    little_endian_store_16(event, 5, 1);
+    sim_delay_queue_add(&sim_local_rx_delay, sim_config.host_latency_us, HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// remote: outgoing PDUs
+static void sim_remote_signaling_send(const uint8_t * data, uint16_t len){
+    btstack_assert(sim_remote_signaling_count < SIM_MAX_SIGNALING_PDUS);
+    sim_pdu_t * pdu = &sim_remote_signaling[sim_remote_signaling_count++];
+    little_endian_store_16(pdu->data, 0, len);
+    little_endian_store_16(pdu->data, 2, L2CAP_CID_SIGNALING);
+    memcpy(&pdu->data[4], data, len);
+    pdu->len = 4 + len;
+}
+
+static void sim_remote_build_ertm_pdu(uint16_t control, const uint8_t * payload, uint16_t payload_len){
+    uint16_t len = 2 + payload_len + 2;
+    little_endian_store_16(sim_remote_pdu.data, 0, len);
+    little_endian_store_16(sim_remote_pdu.data, 2, sim_remote_local_cid);
+    little_endian_store_16(sim_remote_pdu.data, 4, control);
+    memcpy(&sim_remote_pdu.data[6], payload, payload_len);
+    uint16_t fcs = sim_crc16(sim_remote_pdu.data, 4 + 2 + payload_len);
+    little_endian_store_16(sim_remote_pdu.data, 6 + payload_len, fcs);
+    sim_remote_pdu.len = 4 + len;
+}
+
+static void sim_remote_acknowledged(void){
+    sim_remote_last_acked_seq = sim_remote_expected_tx_seq;
+    sim_remote_ack_deadline_us = 0;
+}
+
+static void sim_remote_restart_retransmission_timer(void){
+    sim_remote_rtx_deadline_us = sim_time_us + (uint64_t) SIM_RETRANSMISSION_TIMEOUT_MS * 1000;
+}
+
+static void sim_remote_fill_tx_window(void){
+    uint8_t tx_window = sim_remote_peer_tx_window;
+    while (sim_remote_tx_remaining > 0){
+        if (sim_seq_delta(sim_remote_next_tx_seq, sim_remote_expected_ack_seq) >= tx_window) break;
+        if (sim_remote_send_queue_count >= SIM_REMOTE_QUEUE_LEN) break;
+        // segment SDU of peer MTU into PDUs of MPS
+        uint16_t mps = btstack_min(sim_remote_peer_mps, sim_config.remote_mps);
+        sim_frame_t * frame = &sim_remote_frames[sim_remote_next_tx_seq];
+        uint16_t pos = 0;
+        if (sim_remote_tx_sdu_pos == 0){
+            sim_remote_tx_sdu_len = (uint16_t) btstack_min(sim_remote_peer_mtu, sim_remote_tx_remaining);
+            if (sim_remote_tx_sdu_len <= mps){
+                frame->sar = SIM_SAR_UNSEGMENTED;
+            } else {
+                frame->sar = SIM_SAR_START;
+                little_endian_store_16(frame->payload, 0, sim_remote_tx_sdu_len);
+                pos = 2;
+            }
+        } else if ((sim_remote_tx_sdu_len - sim_remote_tx_sdu_pos) <= mps){
+            frame->sar = SIM_SAR_END;
+        } else {
+            frame->sar = SIM_SAR_CONTINUATION;
+        }
+        uint16_t data_len = btstack_min(mps - pos, sim_remote_tx_sdu_len - sim_remote_tx_sdu_pos);
+        uint16_t i;
+        for (i = 0; i < data_len; i++){
+            frame->payload[pos + i] = sim_pattern(sim_remote_tx_offset + i);
+        }
+        frame->len = pos + data_len;
+        frame->sent = false;
+        sim_remote_tx_offset    += data_len;
+        sim_remote_tx_remaining -= data_len;
+        sim_remote_tx_sdu_pos   += data_len;
+        if (sim_remote_tx_sdu_pos == sim_remote_tx_sdu_len){
+            sim_remote_tx_sdu_pos = 0;
+        }
+        sim_remote_send_queue[sim_remote_send_queue_count++] = sim_remote_next_tx_seq;
+        sim_remote_next_tx_seq = (sim_remote_next_tx_seq + 1) & 0x3f;
+    }
+}
+
+static void sim_remote_retransmit_from(uint8_t tx_seq){
+    sim_remote_send_queue_count = 0;
+    while (tx_seq != sim_remote_next_tx_seq){
+        sim_remote_send_queue[sim_remote_send_queue_count++] = tx_seq;
+        tx_seq = (tx_seq + 1) & 0x3f;
+    }
+}
+
+static void sim_remote_retransmit_single(uint8_t tx_seq){
+    uint8_t i;
+    for (i = 0; i < sim_remote_send_queue_count; i++){
+        if (sim_remote_send_queue[i] == tx_seq) return;
+    }
+    memmove(&sim_remote_send_queue[1], &sim_remote_send_queue[0], sim_remote_send_queue_count);
+    sim_remote_send_queue[0] = tx_seq;
+    sim_remote_send_queue_count++;
+}
+
+static void sim_remote_process_req_seq(uint8_t req_seq){
+    if (sim_seq_delta(req_seq, sim_remote_expected_ack_seq) > sim_seq_delta(sim_remote_next_tx_seq, sim_remote_expected_ack_seq)) return;
+    if (req_seq == sim_remote_expected_ack_seq) return;
+    sim_remote_expected_ack_seq = req_seq;
+    if (sim_remote_expected_ack_seq == sim_remote_next_tx_seq){
+        sim_remote_rtx_deadline_us = 0;
+    } else {
+        sim_remote_restart_retransmission_timer();
+    }
+}
+
+// select next PDU: signaling, S-frame, I-frame
+static bool sim_remote_next_pdu(void){
+    sim_remote_pdu_dropped = false;
+    if (sim_remote_signaling_count > 0){
+        sim_remote_pdu = sim_remote_signaling[0];
+        sim_remote_signaling_count--;
+        memmove(&sim_remote_signaling[0], &sim_remote_signaling[1], sim_remote_signaling_count * sizeof(sim_pdu_t));
+        return true;
+    }
+    if (sim_remote_local_cid == 0) return false;
+    if (sim_remote_send_s_frame){
+        sim_remote_send_s_frame = false;
+        uint16_t control = (sim_remote_expected_tx_seq << 8) | (sim_remote_s_frame_final ? 0x80 : 0) |
+                           (sim_remote_s_frame_poll ? 0x10 : 0) | (sim_remote_s_frame_type << 2) | 1;
+        sim_remote_s_frame_final = false;
+        sim_remote_s_frame_poll  = false;
+        sim_remote_build_ertm_pdu(control, NULL, 0);
+        sim_remote_acknowledged();
+        sim_stats.remote_s_frames++;
+        return true;
+    }
+    sim_remote_fill_tx_window();
+    if (sim_remote_peer_busy || sim_remote_wait_for_final) return false;
+    if (sim_remote_send_queue_count == 0) return false;
+    uint8_t tx_seq = sim_remote_send_queue[0];
+    sim_remote_send_queue_count--;
+    memmove(&sim_remote_send_queue[0], &sim_remote_send_queue[1], sim_remote_send_queue_count);
+    sim_frame_t * frame = &sim_remote_frames[tx_seq];
+    uint16_t control = (frame->sar << 14) | (sim_remote_expected_tx_seq << 8) | (tx_seq << 1);
+    sim_remote_build_ertm_pdu(control, frame->payload, frame->len);
+    sim_remote_acknowledged();
+    sim_stats.remote_i_frames++;
+    if (frame->sent){
+        sim_stats.remote_retransmissions++;
+    } else {
+        frame->sent = true;
+        sim_remote_new_i_frames++;
+        if ((sim_config.remote_drop_interval > 0) && ((sim_remote_new_i_frames % sim_config.remote_drop_interval) == 0)){
+            sim_remote_pdu_dropped = true;
+        }
+    }
+    if (sim_remote_rtx_deadline_us == 0){
+        sim_remote_restart_retransmission_timer();
+    }
+    return true;
+}
+
+// get next ACL fragment of remote, returns len of ACL payload or 0
+static uint16_t sim_remote_next_fragment(void){
+    if (sim_remote_pdu_pos >= sim_remote_pdu.len){
+        sim_remote_pdu_pos = 0;
+        sim_remote_pdu.len = 0;
+        if (!sim_remote_next_pdu()) return 0;
+    }
+    uint16_t len = btstack_min(sim_config.acl_data_packet_length, sim_remote_pdu.len - sim_remote_pdu_pos);
+    uint16_t flags = (sim_remote_pdu_pos == 0) ? 0x2000 : 0x1000;
+    little_endian_store_16(sim_remote_fragment, 0, SIM_CON_HANDLE | flags);
+    little_endian_store_16(sim_remote_fragment, 2, len);
+    memcpy(&sim_remote_fragment[4], &sim_remote_pdu.data[sim_remote_pdu_pos], len);
+    return len;
+}
+
+// remote: incoming PDUs
+static void sim_remote_handle_signaling(const uint8_t * command, uint16_t len){
+    if (len < 4) return;
+    uint8_t code = command[0];
+    uint8_t sig_id = command[1];
+    const uint8_t * data = &command[4];
+    uint16_t data_len = little_endian_read_16(command, 2);
+    uint8_t response[64];
+    uint16_t pos;
+    switch (code){
+        case INFORMATION_REQUEST: {
+            uint16_t info_type = little_endian_read_16(data, 0);
+            response[0] = INFORMATION_RESPONSE;
+            response[1] = sig_id;
+            little_endian_store_16(response, 4, info_type);
+            little_endian_store_16(response, 6, 0);
+            pos = 8;
+            if (info_type == SIM_INFO_TYPE_EXTENDED_FEATURES){
+                // ERTM and FCS Option
+                little_endian_store_32(response, pos, 0x28);
+                pos += 4;
+            } else if (info_type == SIM_INFO_TYPE_FIXED_CHANNELS){
+                memset(&response[pos], 0, 8);
+                response[pos] = 0x02;
+                pos += 8;
+            } else {
+                little_endian_store_16(response, 6, 1);
+            }
+            little_endian_store_16(response, 2, pos - 4);
+            sim_remote_signaling_send(response, pos);
+            break;
+        }
+        case CONNECTION_REQUEST:
+            sim_remote_local_cid = little_endian_read_16(data, 2);
+            response[0] = CONNECTION_RESPONSE;
+            response[1] = sig_id;
+            little_endian_store_16(response, 2, 8);
+            little_endian_store_16(response, 4, SIM_REMOTE_CID);
+            little_endian_store_16(response, 6, sim_remote_local_cid);
+            little_endian_store_16(response, 8, 0);
+            little_endian_store_16(response, 10, 0);
+            sim_remote_signaling_send(response, 12);
+            // configure request: MTU, Retransmission and Flow Control, FCS
+            response[0] = CONFIGURE_REQUEST;
+            response[1] = ++sim_remote_sig_id;
+            little_endian_store_16(response, 4, sim_remote_local_cid);
+            little_endian_store_16(response, 6, 0);
+            pos = 8;
+            response[pos++] = SIM_OPTION_MTU;
+            response[pos++] = 2;
+            little_endian_store_16(response, pos, sim_config.remote_mtu);
+            pos += 2;
+            response[pos++] = SIM_OPTION_RETRANSMISSION_AND_FLOW_CONTROL;
+            response[pos++] = 9;
+            response[pos++] = L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION;
+            response[pos++] = sim_config.remote_tx_window;
+            response[pos++] = 3;
+            little_endian_store_16(response, pos, SIM_RETRANSMISSION_TIMEOUT_MS);
+            pos += 2;
+            little_endian_store_16(response, pos, 12000);
+            pos += 2;
+            little_endian_store_16(response, pos, sim_config.remote_mps);
+            pos += 2;
+            response[pos++] = SIM_OPTION_FRAME_CHECK_SEQUENCE;
+            response[pos++] = 1;
+            response[pos++] = 1;
+            little_endian_store_16(response, 2, pos - 4);
+            sim_remote_signaling_send(response, pos);
+            break;
+        case CONFIGURE_REQUEST:
+            pos = 4;
+            while ((pos + 2) <= data_len){
+                uint8_t option_type = data[pos] & 0x7f;
+                uint8_t option_len  = data[pos + 1];
+                const uint8_t * option = &data[pos + 2];
+                if (option_type == SIM_OPTION_MTU){
+                    sim_remote_peer_mtu = little_endian_read_16(option, 0);
+                }
+                if (option_type == SIM_OPTION_RETRANSMISSION_AND_FLOW_CONTROL){
+                    sim_remote_peer_tx_window = btstack_min(option[1], sim_config.remote_tx_window);
+                    sim_remote_peer_mps = little_endian_read_16(option, 7);
+                }
+                pos += 2 + option_len;
+            }
+            response[0] = CONFIGURE_RESPONSE;
+            response[1] = sig_id;
+            little_endian_store_16(response, 4, sim_remote_local_cid);
+            little_endian_store_16(response, 6, 0);
+            little_endian_store_16(response, 8, 0);
+            pos = 10;
+            // confirm mode and announce number of I-frames sent without acknowledgement
+            response[pos++] = SIM_OPTION_RETRANSMISSION_AND_FLOW_CONTROL;
+            response[pos++] = 9;
+            response[pos++] = L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION;
+            response[pos++] = sim_remote_peer_tx_window;
+            response[pos++] = 3;
+            little_endian_store_16(response, pos, SIM_RETRANSMISSION_TIMEOUT_MS);
+            pos += 2;
+            little_endian_store_16(response, pos, 12000);
+            pos += 2;
+            little_endian_store_16(response, pos, btstack_min(sim_remote_peer_mps, sim_config.remote_mps));
+            pos += 2;
+            little_endian_store_16(response, 2, pos - 4);
+            sim_remote_signaling_send(response, pos);
+            break;
+        case CONFIGURE_RESPONSE:
+            // acknowledge at least as often as the peer sends I-frames without acknowledgement
+            pos = 6;
+            while ((pos + 2) <= data_len){
+                uint8_t option_type = data[pos] & 0x7f;
+                uint8_t option_len  = data[pos + 1];
+                if (option_type == SIM_OPTION_RETRANSMISSION_AND_FLOW_CONTROL){
+                    sim_remote_ack_window = btstack_min(sim_remote_ack_window, data[pos + 3]);
+                }
+                pos += 2 + option_len;
+            }
+            break;
+        case DISCONNECTION_REQUEST:
+            response[0] = DISCONNECTION_RESPONSE;
+            response[1] = sig_id;
+            little_endian_store_16(response, 2, 4);
+            memcpy(&response[4], data, 4);
+            sim_remote_signaling_send(response, 8);
+            sim_remote_local_cid = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+static void sim_remote_handle_sdu_data(uint8_t sar, const uint8_t * payload, uint16_t len){
+    uint16_t pos = 0;
+    switch (sar){
+        case SIM_SAR_UNSEGMENTED:
+            sim_remote_rx_sdu_len = len;
+            sim_remote_rx_sdu_pos = 0;
+            break;
+        case SIM_SAR_START:
+            sim_remote_rx_sdu_len = little_endian_read_16(payload, 0);
+            sim_remote_rx_sdu_pos = 0;
+            pos = 2;
+            break;
+        default:
+            break;
+    }
+    for (; pos < len; pos++){
+        if (payload[pos] != sim_pattern(sim_remote_rx_bytes)){
+            sim_data_valid = false;
+        }
+        sim_remote_rx_bytes++;
+        sim_remote_rx_sdu_pos++;
+    }
+    if (sim_remote_rx_sdu_pos > sim_remote_rx_sdu_len){
+        sim_data_valid = false;
+    }
+    if (((sar == SIM_SAR_UNSEGMENTED) || (sar == SIM_SAR_END)) && (sim_remote_rx_sdu_pos != sim_remote_rx_sdu_len)){
+        sim_data_valid = false;
+    }
+}
+
+static void sim_remote_send_s_frame_next(uint8_t type, bool poll, bool final){
+    sim_remote_send_s_frame = true;
+    sim_remote_s_frame_type = type;
+    sim_remote_s_frame_poll |= poll;
+    sim_remote_s_frame_final |= final;
+}
+
+static void sim_remote_handle_ertm(const uint8_t * pdu, uint16_t len){
+    if (len < 4) return;
+    uint16_t fcs = little_endian_read_16(pdu, 4 + len - 2);
+    if (fcs != sim_crc16(pdu, 4 + len - 2)){
+        sim_data_valid = false;
+        return;
+    }
+    uint16_t control = little_endian_read_16(pdu, 4);
+    uint8_t  req_seq = (control >> 8) & 0x3f;
+    bool     final   = (control & 0x80) != 0;
+    if (control & 1){
+        // S-frame
+        sim_stats.local_s_frames++;
+        uint8_t s    = (control >> 2) & 0x03;
+        bool    poll = (control & 0x10) != 0;
+        if (s == SIM_S_SREJ){
+            sim_remote_retransmit_single(req_seq);
+            return;
+        }
+        sim_remote_process_req_seq(req_seq);
+        sim_remote_peer_busy = (s == SIM_S_RNR);
+        if ((s == SIM_S_REJ) || (final && sim_remote_wait_for_final)){
+            sim_remote_retransmit_from(req_seq);
+        }
+        if (final){
+            sim_remote_wait_for_final = false;
+        }
+        if (poll){
+            sim_remote_send_s_frame_next(SIM_S_RR, false, true);
+        }
+        return;
+    }
+
+    // I-frame
+    sim_stats.local_i_frames++;
+    sim_remote_process_req_seq(req_seq);
+    if (final && sim_remote_wait_for_final){
+        sim_remote_wait_for_final = false;
+        sim_remote_retransmit_from(req_seq);
+    }
+    uint8_t tx_seq = (control >> 1) & 0x3f;
+    if (tx_seq != sim_remote_expected_tx_seq){
+        if (!sim_remote_rej_sent){
+            sim_remote_rej_sent = true;
+            sim_remote_send_s_frame_next(SIM_S_REJ, false, false);
+        }
+        return;
+    }
+    sim_remote_rej_sent = false;
+    sim_remote_expected_tx_seq = (sim_remote_expected_tx_seq + 1) & 0x3f;
+    sim_remote_handle_sdu_data(control >> 14, &pdu[6], len - 4);
+
+    // acknowledge after 3/4 of TX Window or on timeout
+    uint8_t threshold = btstack_max(1, (sim_remote_ack_window * 3) / 4);
+    if (sim_seq_delta(sim_remote_expected_tx_seq, sim_remote_last_acked_seq) >= threshold){
+        sim_remote_send_s_frame_next(SIM_S_RR, false, false);
+    } else if (sim_remote_ack_deadline_us == 0){
+        sim_remote_ack_deadline_us = sim_time_us + (uint64_t) SIM_ACK_TIMEOUT_MS * 1000;
+    }
+}
+
+static void sim_remote_handle_acl(const uint8_t * packet, uint16_t size){
+    uint16_t flags = little_endian_read_16(packet, 0) & 0x3000;
+    uint16_t len   = size - 4;
+    if (flags != 0x1000){
+        sim_remote_rx_pdu.len = 0;
+    }
+    btstack_assert((sim_remote_rx_pdu.len + len) <= SIM_MAX_PDU_LEN);
+    memcpy(&sim_remote_rx_pdu.data[sim_remote_rx_pdu.len], &packet[4], len);
+    sim_remote_rx_pdu.len += len;
+    if (sim_remote_rx_pdu.len < 4) return;
+    uint16_t l2cap_len = little_endian_read_16(sim_remote_rx_pdu.data, 0);
+    if (sim_remote_rx_pdu.len < (4 + l2cap_len)) return;
+    uint16_t cid = little_endian_read_16(sim_remote_rx_pdu.data, 2);
+    if (cid == L2CAP_CID_SIGNALING){
+        sim_remote_handle_signaling(&sim_remote_rx_pdu.data[4], l2cap_len);
+    } else if (cid == SIM_REMOTE_CID){
+        sim_remote_handle_ertm(sim_remote_rx_pdu.data, l2cap_len);
+    }
+    sim_remote_rx_pdu.len = 0;
+}
+
+static void sim_remote_ack_timeout(void){
+    sim_remote_ack_deadline_us = 0;
+    if (sim_remote_expected_tx_seq != sim_remote_last_acked_seq){
+        sim_remote_send_s_frame_next(SIM_S_RR, false, false);
+    }
+}
+
+static void sim_remote_retransmission_timeout(void){
+    // poll peer for its receive state, retransmit after final
+    sim_remote_wait_for_final = true;
+    sim_remote_send_s_frame_next(SIM_S_RR, true, false);
+    sim_remote_restart_retransmission_timer();
+}
+
+// baseband
+static bool sim_exchange_start(void){
+    uint8_t slots_local = 1;
+    sim_exchange_local_packet = sim_local_queue_count > 0;
+    if (sim_exchange_local_packet){
+        slots_local = sim_slots_for_len(sim_local_queue[sim_local_queue_head].len - 4);
+        sim_exchange_local_lost = sim_packet_lost();
+    }
+    uint8_t slots_remote = 1;
+    if (sim_exchange_remote_len == 0){
+        sim_exchange_remote_len = sim_remote_next_fragment();
+    }
+    if (sim_exchange_remote_len > 0){
+        slots_remote = sim_slots_for_len(sim_exchange_remote_len);
+        sim_exchange_remote_lost = sim_packet_lost();
+    }
+    if (!sim_exchange_local_packet && (sim_exchange_remote_len == 0)) return false;
+    uint32_t duration_us = (slots_local + slots_remote) * ACL_LINK_SIM_SLOT_US;
+    if (sim_exchange_local_packet){
+        sim_stats.local_tx_us += slots_local * ACL_LINK_SIM_SLOT_US;
+    }
+    sim_exchange_end_us = sim_time_us + duration_us;
+    sim_exchange_active = true;
+    return true;
+}
+
+static void sim_exchange_complete(void){
+    sim_exchange_active = false;
+
+    // local ACL packet received by remote
+    if (sim_exchange_local_packet){
+        sim_stats.local_acl_packets++;
+        if (!sim_exchange_local_lost){
+            sim_acl_packet_t * acl_packet = &sim_local_queue[sim_local_queue_head];
+            sim_local_queue_head = (sim_local_queue_head + 1) % SIM_MAX_ACL_BUFFERS;
+            sim_local_queue_count--;
+            sim_delay_queue_add(&sim_remote_rx_delay, 2 * sim_config.host_latency_us, HCI_ACL_DATA_PACKET, acl_packet->data, acl_packet->len);
+            sim_hci_emit_number_of_completed_packets();
+        }
+    }
+
+    // remote ACL packet received by local
+    if (sim_exchange_remote_len > 0){
+        sim_stats.remote_acl_packets++;
+        if (!sim_exchange_remote_lost){
+            uint16_t len = sim_exchange_remote_len;
+            sim_remote_pdu_pos += len;
+            sim_exchange_remote_len = 0;
+            if (!sim_remote_pdu_dropped){
+                sim_delay_queue_add(&sim_local_rx_delay, sim_config.host_latency_us, HCI_ACL_DATA_PACKET, sim_remote_fragment, 4 + len);
+            }
+        }
+    }
+}
+
+static void sim_process_delayed_packets(void){
+    sim_delayed_packet_t * packet;
+    while ((packet = sim_delay_queue_get_due(&sim_local_tx_delay)) != NULL){
+        sim_controller_queue_acl_packet(&packet->data[HCI_INCOMING_PRE_BUFFER_SIZE], packet->len);
+    }
+    while ((packet = sim_delay_queue_get_due(&sim_remote_rx_delay)) != NULL){
+        sim_remote_handle_acl(&packet->data[HCI_INCOMING_PRE_BUFFER_SIZE], packet->len);
+    }
+    while ((packet = sim_delay_queue_get_due(&sim_local_rx_delay)) != NULL){
+        (*sim_hci_packet_handler)(packet->packet_type, &packet->data[HCI_INCOMING_PRE_BUFFER_SIZE], packet->len);
+    }
+}
+
+// run until condition is met, returns false on timeout or if link and timers are idle
+static bool sim_run_until(bool (*done)(void)){
+    uint64_t deadline_us = sim_time_us + (uint64_t) SIM_TIMEOUT_MS * 1000;
+    while (true){
+        sim_process_delayed_packets();
+        btstack_run_loop_embedded_execute_once();
+        if ((*done)()) return true;
+        if (!sim_exchange_active){
+            (void) sim_exchange_start();
+        }
+        uint64_t next_us = UINT64_MAX;
+        if (sim_exchange_active){
+            next_us = sim_exchange_end_us;
+        }
+        uint32_t now_ms = hal_time_ms();
+        int32_t time_until_timeout_ms = btstack_run_loop_base_get_time_until_timeout(now_ms);
+        if (time_until_timeout_ms >= 0){
+            next_us = btstack_min(next_us, (uint64_t) (now_ms + time_until_timeout_ms) * 1000);
+        }
+        if (sim_remote_ack_deadline_us > 0){
+            next_us = btstack_min(next_us, sim_remote_ack_deadline_us);
+        }
+        if (sim_remote_rtx_deadline_us > 0){
+            next_us = btstack_min(next_us, sim_remote_rtx_deadline_us);
+        }
+        next_us = btstack_min(next_us, sim_delay_queue_next_time(&sim_local_tx_delay));
+        next_us = btstack_min(next_us, sim_delay_queue_next_time(&sim_local_rx_delay));
+        next_us = btstack_min(next_us, sim_delay_queue_next_time(&sim_remote_rx_delay));
+        if (next_us == UINT64_MAX) return false;
+        if (next_us > deadline_us)  return false;
+        if (next_us > sim_time_us){
+            sim_time_us = next_us;
+        }
+        if (sim_exchange_active && (sim_exchange_end_us <= sim_time_us)){
+            sim_exchange_complete();
+        }
+        if ((sim_remote_ack_deadline_us > 0) && (sim_remote_ack_deadline_us <= sim_time_us)){
+            sim_remote_ack_timeout();
+        }
+        if ((sim_remote_rtx_deadline_us > 0) && (sim_remote_rtx_deadline_us <= sim_time_us)){
+            sim_remote_retransmission_timeout();
+        }
+    }
+}
+
+// local application
+static void sim_local_send_next(void){
+    while (sim_local_tx_remaining > 0){
+        if (!l2cap_can_send_packet_now(sim_local_cid)){
+            l2cap_request_can_send_now_event(sim_local_cid);
+            return;
+        }
+        uint16_t len = (uint16_t) btstack_min(sim_local_remote_mtu, sim_local_tx_remaining);
+        uint16_t i;
+        for (i = 0; i < len; i++){
+            sim_local_sdu[i] = sim_pattern(sim_local_tx_offset + i);
+        }
+        uint8_t status = l2cap_send(sim_local_cid, sim_local_sdu, len);
+        if (status != ERROR_CODE_SUCCESS){
+            sim_data_valid = false;
+            return;
+        }
+        sim_local_tx_offset    += len;
+        sim_local_tx_remaining -= len;
+    }
+}
+
+static void sim_local_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t * packet, uint16_t size){
+    uint16_t i;
+    switch (packet_type){
+        case L2CAP_DATA_PACKET:
+            if (channel != sim_local_cid) break;
+            for (i = 0; i < size; i++){
+                if (packet[i] != sim_pattern(sim_local_rx_bytes + i)){
+                    sim_data_valid = false;
+                }
+            }
+            sim_local_rx_bytes += size;
+            break;
+        case HCI_EVENT_PACKET:
+            switch (hci_event_packet_get_type(packet)){
+                case L2CAP_EVENT_CHANNEL_OPENED:
+                    sim_local_channel_opened = true;
+                    sim_local_open_status = l2cap_event_channel_opened_get_status(packet);
+                    sim_local_remote_mtu  = l2cap_event_channel_opened_get_remote_mtu(packet);
+                    break;
+                case L2CAP_EVENT_CAN_SEND_NOW:
+                    sim_local_send_next();
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static bool sim_local_channel_open_done(void){
+    return sim_local_channel_opened;
+}
+
+static uint32_t sim_transfer_target;
+
+static bool sim_upload_done(void){
+    return sim_remote_rx_bytes >= sim_transfer_target;
+}
+
+static bool sim_download_done(void){
+    return sim_local_rx_bytes >= sim_transfer_target;
+}
+
+void acl_link_sim_init(const acl_link_sim_config_t * config){
+    sim_config = *config;
+    btstack_assert(sim_config.acl_packets_total_num <= SIM_MAX_ACL_BUFFERS);
+    btstack_assert(sim_config.remote_mps <= HCI_ACL_PAYLOAD_SIZE);
+    srand(0x1234);
+
+    sim_time_us = 0;
+    sim_local_queue_head  = 0;
+    sim_local_queue_count = 0;
+    memset(&sim_local_tx_delay,  0, sizeof(sim_local_tx_delay));
+    memset(&sim_local_rx_delay,  0, sizeof(sim_local_rx_delay));
+    memset(&sim_remote_rx_delay, 0, sizeof(sim_remote_rx_delay));
+    sim_exchange_active = false;
+    sim_exchange_remote_len = 0;
+    memset(&sim_remote_pdu, 0, sizeof(sim_remote_pdu));
+    sim_remote_pdu_pos = 0;
+    sim_remote_rx_pdu.len = 0;
+    sim_remote_signaling_count = 0;
+    sim_remote_sig_id = 0;
+    sim_remote_local_cid = 0;
+    sim_remote_peer_mtu = L2CAP_DEFAULT_MTU;
+    sim_remote_peer_mps = sim_config.remote_mps;
+    sim_remote_peer_tx_window = 1;
+    sim_remote_ack_window = sim_config.remote_tx_window;
+    sim_remote_expected_tx_seq = 0;
+    sim_remote_last_acked_seq = 0;
+    sim_remote_rej_sent = false;
+    sim_remote_send_s_frame = false;
+    sim_remote_s_frame_poll = false;
+    sim_remote_s_frame_final = false;
+    sim_remote_ack_deadline_us = 0;
+    sim_remote_rx_sdu_len = 0;
+    sim_remote_rx_sdu_pos = 0;
+    sim_remote_rx_bytes = 0;
+    sim_remote_next_tx_seq = 0;
+    sim_remote_expected_ack_seq = 0;
+    sim_remote_send_queue_count = 0;
+    sim_remote_peer_busy = false;
+    sim_remote_wait_for_final = false;
+    sim_remote_rtx_deadline_us = 0;
+    sim_remote_tx_remaining = 0;
+    sim_remote_tx_offset = 0;
+    sim_remote_tx_sdu_pos = 0;
+    sim_remote_new_i_frames = 0;
+    sim_local_cid = 0;
+    sim_local_channel_opened = false;
+    sim_local_tx_remaining = 0;
+    sim_local_tx_offset = 0;
+    sim_local_rx_bytes = 0;
+    sim_data_valid = true;
+    memset(&sim_stats, 0, sizeof(sim_stats));
+
+    btstack_memory_init();
+    btstack_run_loop_init(btstack_run_loop_embedded_get_instance());
+    hci_init(sim_hci_transport_get_instance(), NULL);
+    l2cap_init();
+    gap_set_security_level(LEVEL_0);
+    hci_setup_test_connections_fuzz();
+    hci_set_acl_buffers_fuzz(sim_config.acl_data_packet_length, sim_config.acl_packets_total_num);
+}
+
+void acl_link_sim_deinit(void){
+    l2cap_deinit();
+    hci_deinit();
+    btstack_memory_deinit();
+    btstack_run_loop_deinit();
+}
+
+uint8_t acl_link_sim_connect(l2cap_ertm_config_t * ertm_config, uint8_t * buffer, uint32_t size){
+    bd_addr_t address = { 0x66, 0x55, 0x44, 0x33, 0x00, 0x03 };
+    uint8_t status = l2cap_ertm_create_channel(&sim_local_packet_handler, address, ACL_LINK_SIM_PSM, ertm_config, buffer, size, &sim_local_cid);
+    if (status != ERROR_CODE_SUCCESS) return status;
+    if (!sim_run_until(&sim_local_channel_open_done)) return ERROR_CODE_CONNECTION_TIMEOUT;
+    return sim_local_open_status;
+}
+
+uint16_t acl_link_sim_get_local_cid(void){
+    return sim_local_cid;
+}
+
+uint16_t acl_link_sim_get_remote_mtu(void){
+    return sim_local_remote_mtu;
+}
+
+uint32_t acl_link_sim_send(uint32_t num_bytes){
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    uint64_t start_us = sim_time_us;
+    sim_transfer_target = sim_remote_rx_bytes + num_bytes;
+    sim_local_tx_remaining = num_bytes;
+    sim_local_send_next();
+    if (!sim_run_until(&sim_upload_done)) return 0;
+    return (uint32_t) ((sim_time_us - start_us + 999) / 1000);
+}
+
+uint32_t acl_link_sim_receive(uint32_t num_bytes){
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    uint64_t start_us = sim_time_us;
+    sim_transfer_target = sim_local_rx_bytes + num_bytes;
+    sim_remote_tx_remaining = num_bytes;
+    if (!sim_run_until(&sim_download_done)) return 0;
+    return (uint32_t) ((sim_time_us - start_us + 999) / 1000);
+}
+
+bool acl_link_sim_data_valid(void){
+    return sim_data_valid;
+}
+
+const acl_link_sim_stats_t * acl_link_sim_get_stats(void){
+    return &sim_stats;
+}
+
+uint32_t acl_link_sim_get_time_ms(void){
+    return hal_time_ms();
+}
@@ -0,0 +1,84 @@
+// *****************************************************************************
+//
+// simulated BR/EDR ACL link to a remote L2CAP ERTM device with virtual time
+//
+// *****************************************************************************
+
+#ifndef ACL_LINK_SIM_H
+#define ACL_LINK_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "l2cap.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#define ACL_LINK_SIM_PSM        0x1001
+
+// baseband slot
+#define ACL_LINK_SIM_SLOT_US    625
+
+typedef struct {
+    // Controller: max ACL data packet length and number of ACL buffers
+    uint16_t acl_data_packet_length;
+    uint8_t  acl_packets_total_num;
+    // baseband packets lost and retransmitted by the Controllers, in percent
+    uint8_t  packet_error_rate;
+    // one-way latency between host and Controller, incl. HCI transport and host processing
+    uint16_t host_latency_us;
+    // remote L2CAP: MTU, MPS and TX Window, i.e. number of I-frames it receives or sends without acknowledgement
+    uint16_t remote_mtu;
+    uint16_t remote_mps;
+    uint8_t  remote_tx_window;
+    // I-frames sent by remote that get lost, e.g. on flush timeout. 0 = none, n = every n-th I-frame
+    uint16_t remote_drop_interval;
+} acl_link_sim_config_t;
+
+typedef struct {
+    // L2CAP frames received by remote and sent by remote
+    uint32_t local_i_frames;
+    uint32_t local_s_frames;
+    uint32_t remote_i_frames;
+    uint32_t remote_s_frames;
+    uint32_t remote_retransmissions;
+    // ACL packets sent over the air, incl. baseband retransmissions
+    uint32_t local_acl_packets;
+    uint32_t remote_acl_packets;
+    // time the link carried ACL packets from local
+    uint32_t local_tx_us;
+} acl_link_sim_stats_t;
+
+// setup HCI with ACL connection, L2CAP, and remote
+void     acl_link_sim_init(const acl_link_sim_config_t * config);
+void     acl_link_sim_deinit(void);
+
+// create ERTM channel to remote, returns status from L2CAP_EVENT_CHANNEL_OPENED
+uint8_t  acl_link_sim_connect(l2cap_ertm_config_t * ertm_config, uint8_t * buffer, uint32_t size);
+
+uint16_t acl_link_sim_get_local_cid(void);
+
+// remote MTU as reported in L2CAP_EVENT_CHANNEL_OPENED
+uint16_t acl_link_sim_get_remote_mtu(void);
+
+// send num_bytes in SDUs of remote MTU to remote, returns duration in ms, 0 on timeout
+uint32_t acl_link_sim_send(uint32_t num_bytes);
+
+// remote sends num_bytes in SDUs of local MTU, returns duration in ms, 0 on timeout
+uint32_t acl_link_sim_receive(uint32_t num_bytes);
+
+// all data received in order and unmodified
+bool     acl_link_sim_data_valid(void);
+
+// stats since start of last transfer
+const acl_link_sim_stats_t * acl_link_sim_get_stats(void);
+
+uint32_t acl_link_sim_get_time_ms(void);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif
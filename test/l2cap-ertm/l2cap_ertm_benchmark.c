@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "l2cap_ertm_benchmark.c"
+
+// *****************************************************************************
+//
+// L2CAP ERTM benchmark: sends and receives 1 MB over a simulated BR/EDR ACL link
+// with the default GOEP Client ERTM configuration and with the configuration from
+// l2cap_ertm_config_for_throughput, and reports simulated throughput and host time
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_util.h"
+#include "l2cap.h"
+#include "acl_link_sim.h"
+
+#define TRANSFER_LEN   1000000
+#define LOCAL_MTU      1000
+#define TUNED_BUFFER   30000
+
+static uint8_t ertm_buffer[TUNED_BUFFER];
+
+static const l2cap_ertm_config_t goep_ertm_config = {
+    1,      // ertm mandatory
+    2,      // max transmit
+    2000,   // retransmission timeout
+    12000,  // monitor timeout
+    512,    // local mtu
+    2,      // num tx buffers
+    2,      // num rx buffers
+    1,      // fcs
+    0,      // mps
+};
+
+static uint64_t time_ns(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000u) + (uint64_t) now.tv_nsec;
+}
+
+static void report(const char * name, const char * direction, uint32_t duration_ms, uint32_t i_frames, uint32_t s_frames, uint64_t duration_ns){
+    if (duration_ms == 0u){
+        printf("%s %s: transfer failed\n", name, direction);
+        exit(EXIT_FAILURE);
+    }
+    if (!acl_link_sim_data_valid()){
+        printf("%s %s: data corrupted\n", name, direction);
+        exit(EXIT_FAILURE);
+    }
+    printf("%-24s %-8s: %6u ms simulated, %4u kB/s, %5u I-Frames, %5u S-Frames, %5.2f ns/byte host\n",
+           name, direction, (unsigned int) duration_ms, (unsigned int) (TRANSFER_LEN / duration_ms),
+           (unsigned int) i_frames, (unsigned int) s_frames, (double) duration_ns / TRANSFER_LEN);
+}
+
+static void benchmark(const char * name, const acl_link_sim_config_t * link_config, bool tuned){
+    acl_link_sim_init(link_config);
+
+    l2cap_ertm_config_t ertm_config = goep_ertm_config;
+    uint32_t buffer_size = 1000;
+    if (tuned){
+        l2cap_ertm_config_for_throughput(&ertm_config, LOCAL_MTU, sizeof(ertm_buffer));
+        buffer_size = l2cap_ertm_get_buffer_size(&ertm_config);
+    }
+    if (acl_link_sim_connect(&ertm_config, ertm_buffer, buffer_size) != ERROR_CODE_SUCCESS){
+        printf("%s: connect failed\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t start_ns = time_ns();
+    uint32_t duration_ms = acl_link_sim_send(TRANSFER_LEN);
+    const acl_link_sim_stats_t * stats = acl_link_sim_get_stats();
+    report(name, "upload", duration_ms, stats->local_i_frames, stats->remote_s_frames, time_ns() - start_ns);
+
+    start_ns = time_ns();
+    duration_ms = acl_link_sim_receive(TRANSFER_LEN);
+    report(name, "download", duration_ms, stats->remote_i_frames, stats->local_s_frames, time_ns() - start_ns);
+
+    acl_link_sim_deinit();
+}
+
+int main(void){
+    acl_link_sim_config_t link_config;
+    memset(&link_config, 0, sizeof(link_config));
+    link_config.acl_data_packet_length = 1021;
+    link_config.acl_packets_total_num  = 8;
+    link_config.host_latency_us = 5000;
+    link_config.remote_mtu = 1000;
+    link_config.remote_mps = 1000;
+    link_config.remote_tx_window = 63;
+
+    printf("ACL link: %u x %u bytes Controller buffers, %u us host latency, remote MTU %u, %u bytes per transfer\n",
+           link_config.acl_packets_total_num, link_config.acl_data_packet_length, link_config.host_latency_us,
+           link_config.remote_mtu, TRANSFER_LEN);
+    benchmark("GOEP default (1000 B)", &link_config, false);
+    benchmark("Tuned (30000 B)", &link_config, true);
+
+    link_config.packet_error_rate = 10;
+    benchmark("GOEP default, PER 10%", &link_config, false);
+    benchmark("Tuned, PER 10%", &link_config, true);
+    return 0;
+}
@@ -0,0 +1,307 @@
+// *****************************************************************************
+//
+// test L2CAP ERTM configuration helpers and bulk transfers over simulated ACL link
+//
+// *****************************************************************************
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bluetooth.h"
+#include "l2cap.h"
+#include "acl_link_sim.h"
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#define TEST_TRANSFER_LEN     100000
+#define TEST_LOCAL_MTU        1000
+
+// 3-DH5 packet and POLL/NULL
+#define TEST_US_PER_FRAME     (6 * ACL_LINK_SIM_SLOT_US)
+
+static uint8_t ertm_buffer[64000];
+
+// GOEP Client defaults
+static const l2cap_ertm_config_t goep_ertm_config = {
+    1,      // ertm mandatory
+    2,      // max transmit
+    2000,   // retransmission timeout
+    12000,  // monitor timeout
+    512,    // local mtu
+    2,      // num tx buffers
+    2,      // num rx buffers
+    1,      // fcs
+    0,      // mps
+};
+
+static acl_link_sim_config_t link_config;
+
+static void init_link(void){
+    acl_link_sim_init(&link_config);
+}
+
+static l2cap_ertm_config_t tuned_config(uint32_t size){
+    l2cap_ertm_config_t ertm_config = goep_ertm_config;
+    CHECK(l2cap_ertm_config_for_throughput(&ertm_config, TEST_LOCAL_MTU, size) > 0);
+    return ertm_config;
+}
+
+static void connect(l2cap_ertm_config_t * ertm_config, uint32_t size){
+    CHECK(size <= sizeof(ertm_buffer));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, acl_link_sim_connect(ertm_config, ertm_buffer, size));
+}
+
+static uint32_t upload(void){
+    uint32_t duration_ms = acl_link_sim_send(TEST_TRANSFER_LEN);
+    CHECK(duration_ms > 0);
+    CHECK(acl_link_sim_data_valid());
+    return duration_ms;
+}
+
+static uint32_t download(void){
+    uint32_t duration_ms = acl_link_sim_receive(TEST_TRANSFER_LEN);
+    CHECK(duration_ms > 0);
+    CHECK(acl_link_sim_data_valid());
+    return duration_ms;
+}
+
+static uint32_t transfer_time_ms(uint32_t num_frames){
+    return (num_frames * TEST_US_PER_FRAME) / 1000;
+}
+
+TEST_GROUP(L2CAPERTMConfig){
+    void setup(void){
+        memset(&link_config, 0, sizeof(link_config));
+        link_config.acl_data_packet_length = 1021;
+        link_config.acl_packets_total_num  = 8;
+        link_config.remote_mtu = 1000;
+        link_config.remote_mps = 1000;
+        link_config.remote_tx_window = 63;
+    }
+    void teardown(void){
+        acl_link_sim_deinit();
+    }
+};
+
+TEST(L2CAPERTMConfig, BufferSize){
+    init_link();
+    l2cap_ertm_config_t ertm_config = goep_ertm_config;
+    ertm_config.mps = 100;
+    uint32_t size = l2cap_ertm_get_buffer_size(&ertm_config);
+    CHECK(size >= (16 + 4 * 100 + 512));
+    ertm_config.num_tx_buffers++;
+    CHECK(l2cap_ertm_get_buffer_size(&ertm_config) >= size + 100);
+}
+
+TEST(L2CAPERTMConfig, BufferSizeDefaultMps){
+    init_link();
+    l2cap_ertm_config_t ertm_config = goep_ertm_config;
+    ertm_config.mps = 0;
+    uint32_t size = l2cap_ertm_get_buffer_size(&ertm_config);
+    CHECK(size >= (16 + 4 * (1021 - 8) + 512));
+    // out of range values use default
+    ertm_config.mps = L2CAP_MINIMAL_MTU - 1;
+    CHECK_EQUAL(size, l2cap_ertm_get_buffer_size(&ertm_config));
+    ertm_config.mps = 0xffff;
+    CHECK_EQUAL(size, l2cap_ertm_get_buffer_size(&ertm_config));
+}
+
+TEST(L2CAPERTMConfig, ThroughputUsesControllerBuffers){
+    init_link();
+    l2cap_ertm_config_t ertm_config = goep_ertm_config;
+    // I-Frame incl. L2CAP header, control and FCS fits into ACL packet
+    CHECK_EQUAL(1021 - 8, l2cap_ertm_config_for_throughput(&ertm_config, TEST_LOCAL_MTU, sizeof(ertm_buffer)));
+    CHECK_EQUAL(1021 - 8, ertm_config.mps);
+    CHECK_EQUAL(TEST_LOCAL_MTU, ertm_config.local_mtu);
+    CHECK_EQUAL(2 * 8, ertm_config.num_tx_buffers);
+    CHECK_EQUAL(2 * 8, ertm_config.num_rx_buffers);
+    CHECK(l2cap_ertm_get_buffer_size(&ertm_config) <= sizeof(ertm_buffer));
+    // other fields unchanged
+    CHECK_EQUAL(goep_ertm_config.retransmission_timeout_ms, ertm_config.retransmission_timeout_ms);
+    CHECK_EQUAL(goep_ertm_config.fcs_option, ertm_config.fcs_option);
+}
+
+TEST(L2CAPERTMConfig, ThroughputSmallAclBuffers){
+    link_config.acl_data_packet_length = 339;
+    link_config.acl_packets_total_num  = 2;
+    init_link();
+    l2cap_ertm_config_t ertm_config = goep_ertm_config;
+    CHECK_EQUAL(339 - 8, l2cap_ertm_config_for_throughput(&ertm_config, TEST_LOCAL_MTU, sizeof(ertm_buffer)));
+    CHECK_EQUAL(4, ertm_config.num_tx_buffers);
+}
+
+TEST(L2CAPERTMConfig, ThroughputFitsIntoBuffer){
+    init_link();
+    const uint32_t size = 30000;
+    l2cap_ertm_config_t ertm_config = tuned_config(size);
+    CHECK(ertm_config.num_tx_buffers < 16);
+    CHECK_EQUAL(1021 - 8, ertm_config.mps);
+    CHECK(l2cap_ertm_get_buffer_size(&ertm_config) <= size);
+    ertm_config.num_tx_buffers++;
+    ertm_config.num_rx_buffers++;
+    CHECK(l2cap_ertm_get_buffer_size(&ertm_config) > size);
+}
+
+TEST(L2CAPERTMConfig, ThroughputSmallBuffer){
+    init_link();
+    // two buffers with reduced MPS
+    l2cap_ertm_config_t ertm_config = goep_ertm_config;
+    uint16_t mps = l2cap_ertm_config_for_throughput(&ertm_config, 500, 1000);
+    CHECK(mps >= L2CAP_MINIMAL_MTU);
+    CHECK(mps < 500);
+    CHECK_EQUAL(2, ertm_config.num_tx_buffers);
+    CHECK(l2cap_ertm_get_buffer_size(&ertm_config) <= 1000);
+
+    // too small, config unchanged
+    ertm_config = goep_ertm_config;
+    CHECK_EQUAL(0, l2cap_ertm_config_for_throughput(&ertm_config, 500, 600));
+    CHECK_EQUAL(goep_ertm_config.local_mtu, ertm_config.local_mtu);
+    CHECK_EQUAL(goep_ertm_config.num_tx_buffers, ertm_config.num_tx_buffers);
+    CHECK_EQUAL(goep_ertm_config.num_rx_buffers, ertm_config.num_rx_buffers);
+    CHECK_EQUAL(goep_ertm_config.mps, ertm_config.mps);
+}
+
+TEST_GROUP(L2CAPERTMTransfer){
+    void setup(void){
+        memset(&link_config, 0, sizeof(link_config));
+        link_config.acl_data_packet_length = 1021;
+        link_config.acl_packets_total_num  = 8;
+        link_config.host_latency_us = 5000;
+        link_config.remote_mtu = 1000;
+        link_config.remote_mps = 1000;
+        link_config.remote_tx_window = 63;
+    }
+    void teardown(void){
+        acl_link_sim_deinit();
+    }
+};
+
+TEST(L2CAPERTMTransfer, UploadTuned){
+    init_link();
+    l2cap_ertm_config_t ertm_config = tuned_config(30000);
+    connect(&ertm_config, 30000);
+    CHECK_EQUAL(1000, acl_link_sim_get_remote_mtu());
+    uint32_t duration_ms = upload();
+    const acl_link_sim_stats_t * stats = acl_link_sim_get_stats();
+    CHECK_EQUAL(TEST_TRANSFER_LEN / 1000, stats->local_i_frames);
+    CHECK(stats->remote_s_frames < (stats->local_i_frames / 4));
+    CHECK(duration_ms < (transfer_time_ms(stats->local_i_frames) * 3) / 2);
+}
+
+TEST(L2CAPERTMTransfer, DownloadTunedWithDelayedAcks){
+    init_link();
+    l2cap_ertm_config_t ertm_config = tuned_config(30000);
+    connect(&ertm_config, 30000);
+    uint32_t duration_ms = download();
+    const acl_link_sim_stats_t * stats = acl_link_sim_get_stats();
+    // remote sends SDUs of local MTU in single I-Frames
+    CHECK_EQUAL(TEST_TRANSFER_LEN / TEST_LOCAL_MTU, stats->remote_i_frames);
+    CHECK(stats->local_s_frames < (stats->remote_i_frames / 4));
+    CHECK(duration_ms < (transfer_time_ms(stats->remote_i_frames) * 3) / 2);
+}
+
+TEST(L2CAPERTMTransfer, TunedFasterThanDefault){
+    init_link();
+    l2cap_ertm_config_t ertm_config = goep_ertm_config;
+    connect(&ertm_config, 1000);
+    uint32_t default_upload_ms = upload();
+    uint32_t default_download_ms = download();
+    acl_link_sim_deinit();
+
+    init_link();
+    ertm_config = tuned_config(30000);
+    connect(&ertm_config, 30000);
+    uint32_t tuned_upload_ms = upload();
+    uint32_t tuned_download_ms = download();
+
+    CHECK(tuned_upload_ms * 4 < default_upload_ms);
+    CHECK(tuned_download_ms * 4 < default_download_ms);
+}
+
+TEST(L2CAPERTMTransfer, MoreTxThanRxBuffers){
+    init_link();
+    l2cap_ertm_config_t ertm_config = goep_ertm_config;
+    ertm_config.local_mtu = TEST_LOCAL_MTU;
+    ertm_config.num_tx_buffers = 8;
+    ertm_config.num_rx_buffers = 4;
+    ertm_config.mps = 1000;
+    uint32_t size = l2cap_ertm_get_buffer_size(&ertm_config);
+    connect(&ertm_config, size);
+    upload();
+    download();
+}
+
+TEST(L2CAPERTMTransfer, MoreRxThanTxBuffers){
+    init_link();
+    l2cap_ertm_config_t ertm_config = goep_ertm_config;
+    ertm_config.local_mtu = TEST_LOCAL_MTU;
+    ertm_config.num_tx_buffers = 4;
+    ertm_config.num_rx_buffers = 8;
+    ertm_config.mps = 1000;
+    uint32_t size = l2cap_ertm_get_buffer_size(&ertm_config);
+    connect(&ertm_config, size);
+    upload();
+    download();
+}
+
+TEST(L2CAPERTMTransfer, RemoteMpsSmallerThanLocal){
+    link_config.remote_mps = 300;
+    init_link();
+    l2cap_ertm_config_t ertm_config = tuned_config(30000);
+    connect(&ertm_config, 30000);
+    upload();
+    const acl_link_sim_stats_t * stats = acl_link_sim_get_stats();
+    // SDUs of 1000 bytes with SDU Length need 4 I-Frames each
+    CHECK_EQUAL(4 * (TEST_TRANSFER_LEN / 1000), stats->local_i_frames);
+    download();
+}
+
+TEST(L2CAPERTMTransfer, RemoteSmallTxWindow){
+    link_config.remote_tx_window = 2;
+    init_link();
+    l2cap_ertm_config_t ertm_config = tuned_config(30000);
+    connect(&ertm_config, 30000);
+    upload();
+    download();
+}
+
+TEST(L2CAPERTMTransfer, RecoverFromLostIFrames){
+    link_config.remote_drop_interval = 7;
+    init_link();
+    l2cap_ertm_config_t ertm_config = tuned_config(30000);
+    connect(&ertm_config, 30000);
+    download();
+    // single REJ per lost I-Frame, duplicates are ignored
+    const acl_link_sim_stats_t * stats = acl_link_sim_get_stats();
+    CHECK(stats->remote_i_frames < 2 * (TEST_TRANSFER_LEN / TEST_LOCAL_MTU));
+}
+
+TEST(L2CAPERTMTransfer, LossyLink){
+    link_config.packet_error_rate = 10;
+    init_link();
+    l2cap_ertm_config_t ertm_config = tuned_config(30000);
+    connect(&ertm_config, 30000);
+    upload();
+    download();
+    const acl_link_sim_stats_t * stats = acl_link_sim_get_stats();
+    CHECK(stats->remote_acl_packets > stats->remote_i_frames);
+}
+
+TEST(L2CAPERTMTransfer, BufferUsedBefore){
+    link_config.remote_drop_interval = 3;
+    init_link();
+    // buffer content is not used as rx/tx state
+    memset(ertm_buffer, 0xff, sizeof(ertm_buffer));
+    l2cap_ertm_config_t ertm_config = tuned_config(30000);
+    connect(&ertm_config, 30000);
+    upload();
+    download();
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -390,6 +390,78 @@ TEST(LE_DEVICE_DB_TLV, le_device_db_local_counter){
     CHECK_EQUAL(expected_counter, 10);
 }
 
+TEST(LE_DEVICE_DB_TLV, le_device_db_counter_write_back){
+    bd_addr_t addr;
+    sm_key_t  sm_key;
+    uint32_t num_writes;
+    uint32_t num_writes_saved;
+    set_addr_and_sm_key(0x10, addr, sm_key);
+    int le_db_index = le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, addr, sm_key);
+
+    uint32_t counter;
+    for (counter = 1; counter <= 100; counter++){
+        le_device_db_local_counter_set(le_db_index, counter);
+        le_device_db_remote_counter_set(le_db_index, counter);
+    }
+    CHECK_EQUAL(100, le_device_db_local_counter_get(le_db_index));
+    CHECK_EQUAL(100, le_device_db_remote_counter_get(le_db_index));
+
+    // add + local counter at 1, 17, .. 97 + remote counter at 16, 32, .. 96
+    le_device_db_tlv_get_write_statistics(&num_writes, &num_writes_saved);
+    CHECK_EQUAL(1 + 7 + 6, num_writes);
+    CHECK_EQUAL(200 - 13, num_writes_saved);
+
+    // reset without flush: local counter is not re-used, remote counter lags behind
+    le_device_db_tlv_configure(btstack_tlv_impl, &btstack_tlv_context);
+    CHECK_TRUE(le_device_db_local_counter_get(le_db_index) >= 100);
+    CHECK_EQUAL(96, le_device_db_remote_counter_get(le_db_index));
+
+    // flush writes pending updates
+    le_device_db_local_counter_set(le_db_index, 200);
+    le_device_db_remote_counter_set(le_db_index, 100);
+    le_device_db_tlv_flush();
+    le_device_db_tlv_configure(btstack_tlv_impl, &btstack_tlv_context);
+    CHECK_TRUE(le_device_db_local_counter_get(le_db_index) >= 200);
+    CHECK_EQUAL(100, le_device_db_remote_counter_get(le_db_index));
+}
+
+TEST(LE_DEVICE_DB_TLV, le_device_db_counter_reset){
+    bd_addr_t addr;
+    sm_key_t  sm_key;
+    set_addr_and_sm_key(0x10, addr, sm_key);
+    int le_db_index = le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, addr, sm_key);
+
+    // reset of remote counter is written immediately
+    le_device_db_remote_counter_set(le_db_index, 50);
+    le_device_db_remote_counter_set(le_db_index, 0);
+    le_device_db_tlv_configure(btstack_tlv_impl, &btstack_tlv_context);
+    CHECK_EQUAL(0, le_device_db_remote_counter_get(le_db_index));
+}
+
+TEST(LE_DEVICE_DB_TLV, le_device_db_cache_eviction){
+    bd_addr_t addr;
+    sm_key_t  sm_key;
+    int le_db_index[NVM_NUM_DEVICE_DB_ENTRIES];
+    int i;
+    for (i=0;i<NVM_NUM_DEVICE_DB_ENTRIES;i++){
+        set_addr_and_sm_key(0x10 + i, addr, sm_key);
+        le_db_index[i] = le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, addr, sm_key);
+    }
+    // pending updates get written when entry is evicted from cache
+    for (i=0;i<NVM_NUM_DEVICE_DB_ENTRIES;i++){
+        le_device_db_remote_counter_set(le_db_index[i], 1);
+        le_device_db_remote_counter_set(le_db_index[i], 2 + i);
+    }
+    for (i=0;i<NVM_NUM_DEVICE_DB_ENTRIES;i++){
+        CHECK_EQUAL(2 + i, le_device_db_remote_counter_get(le_db_index[i]));
+    }
+    le_device_db_tlv_flush();
+    le_device_db_tlv_configure(btstack_tlv_impl, &btstack_tlv_context);
+    for (i=0;i<NVM_NUM_DEVICE_DB_ENTRIES;i++){
+        CHECK_EQUAL(2 + i, le_device_db_remote_counter_get(le_db_index[i]));
+    }
+}
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+// ADV Bearer with simulated Controller
+//
+// Controller supporting extended advertising reports installed advertising sets, legacy Controller does not.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ble/core.h"
+#include "bluetooth_data_types.h"
+#include "btstack_debug.h"
+#include "btstack_event.h"
+#include "btstack_run_loop.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "hci_dump_posix_fs.h"
+#include "mesh/adv_bearer.h"
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+// min advertising interval of legacy connectable / extended non-connectable advertisements
+#define ADVERTISING_INTERVAL_EXTENDED_MIN_MS 20
+
+// advDelay is 0..10 ms
+#define ADVERTISING_DELAY_AVERAGE_MS 5
+
+#define HCI_COMMAND_DURATION_MS 1
+
+#define MAX_NUM_SETS 4
+
+// Limit Reached, reported when num extended advertising events have been sent
+#define ERROR_CODE_LIMIT_REACHED 0x43
+
+// simulated time
+static uint32_t sim_time_ms;
+
+static uint32_t sim_get_time_ms(void){
+    return sim_time_ms;
+}
+
+static void sim_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = sim_time_ms + timeout_in_ms;
+}
+
+static const btstack_run_loop_t sim_run_loop = {
+    &btstack_run_loop_base_init,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    &sim_set_timer,
+    &btstack_run_loop_base_add_timer,
+    &btstack_run_loop_base_remove_timer,
+    NULL,
+    &btstack_run_loop_base_dump_timer,
+    &sim_get_time_ms,
+    NULL,
+    NULL,
+    NULL,
+};
+
+static void sim_run_until(uint32_t end_ms){
+    while (true){
+        int32_t delta = btstack_run_loop_base_get_time_until_timeout(sim_time_ms);
+        if (delta < 0) break;
+        if ((int32_t)(end_ms - (sim_time_ms + delta)) < 0) break;
+        sim_time_ms += delta;
+        btstack_run_loop_base_process_timers(sim_time_ms);
+    }
+    sim_time_ms = end_ms;
+}
+
+// HCI
+static btstack_packet_handler_t hci_event_handler;
+
+extern "C" void hci_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    hci_event_handler = callback_handler->callback;
+}
+extern "C" HCI_STATE hci_get_state(void){
+    return HCI_STATE_WORKING;
+}
+
+static uint8_t sim_own_address_type;
+
+extern "C" void gap_le_get_own_address(uint8_t * addr_type, bd_addr_t addr){
+    *addr_type = sim_own_address_type;
+    memset(addr, 0, 6);
+}
+
+static void sim_emit_event(uint8_t * event, uint16_t size){
+    (*hci_event_handler)(HCI_EVENT_PACKET, 0, event, size);
+}
+
+// legacy advertising
+static uint8_t  legacy_adv_type;
+static uint8_t  legacy_adv_data[31];
+static uint8_t  legacy_adv_data_len;
+static bool     legacy_enabled;
+static uint32_t legacy_num_nonconn_enables;
+static uint32_t legacy_num_set_params;
+
+extern "C" void gap_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int_max, uint8_t adv_type,
+                                              uint8_t direct_address_typ, bd_addr_t direct_address, uint8_t channel_map, uint8_t filter_policy){
+    UNUSED(adv_int_min);
+    UNUSED(adv_int_max);
+    UNUSED(direct_address_typ);
+    (void) direct_address;
+    UNUSED(channel_map);
+    UNUSED(filter_policy);
+    legacy_adv_type = adv_type;
+    legacy_num_set_params++;
+}
+extern "C" void gap_advertisements_set_data(uint8_t advertising_data_length, uint8_t * advertising_data){
+    legacy_adv_data_len = advertising_data_length;
+    memcpy(legacy_adv_data, advertising_data, advertising_data_length);
+}
+extern "C" void gap_advertisements_enable(int enabled){
+    if (enabled && (legacy_adv_type == 3)){
+        legacy_num_nonconn_enables++;
+    }
+    legacy_enabled = enabled != 0;
+}
+
+// extended advertising
+typedef struct {
+    le_advertising_set_t * storage;
+    le_extended_advertising_parameters_t params;
+    uint8_t  adv_data[31];
+    uint16_t adv_data_len;
+    bool     enabled;
+    uint8_t  max_events;
+    uint32_t num_set_params;
+    uint32_t num_set_data;
+    uint32_t num_starts;
+    btstack_timer_source_t terminate_timer;
+} sim_advertising_set_t;
+
+static bool extended_advertising_supported;
+static sim_advertising_set_t sim_sets[MAX_NUM_SETS];
+static uint8_t sim_num_sets;
+static btstack_timer_source_t sim_installed_timer;
+static uint32_t sim_num_messages_sent;
+
+static sim_advertising_set_t * sim_set_for_handle(uint8_t advertising_handle){
+    if ((advertising_handle == 0) || (advertising_handle > sim_num_sets)) return NULL;
+    return &sim_sets[advertising_handle - 1];
+}
+
+static void sim_installed_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    uint8_t handle;
+    for (handle = 1; handle <= sim_num_sets; handle++){
+        uint8_t event[] = { HCI_EVENT_META_GAP, 4, GAP_SUBEVENT_ADVERTISING_SET_INSTALLED, handle, ERROR_CODE_SUCCESS, 0 };
+        sim_emit_event(event, sizeof(event));
+    }
+}
+
+static void sim_terminate_handler(btstack_timer_source_t * ts){
+    sim_advertising_set_t * set = (sim_advertising_set_t *) ts->context;
+    uint8_t handle = (uint8_t) (1 + (set - sim_sets));
+    set->enabled = false;
+    if (set->params.advertising_event_properties == 0x10){
+        sim_num_messages_sent++;
+    }
+    uint8_t event[] = { HCI_EVENT_LE_META, 5, HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED, ERROR_CODE_LIMIT_REACHED, handle, 0, 0, set->max_events };
+    sim_emit_event(event, sizeof(event));
+}
+
+extern "C" uint8_t gap_extended_advertising_setup(le_advertising_set_t * storage, const le_extended_advertising_parameters_t * advertising_parameters, uint8_t * out_advertising_handle){
+    if (sim_num_sets == MAX_NUM_SETS) return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    sim_advertising_set_t * set = &sim_sets[sim_num_sets++];
+    set->storage = storage;
+    set->params = *advertising_parameters;
+    *out_advertising_handle = sim_num_sets;
+    // report all sets as installed after command round trips
+    if (extended_advertising_supported){
+        btstack_run_loop_remove_timer(&sim_installed_timer);
+        btstack_run_loop_set_timer_handler(&sim_installed_timer, &sim_installed_handler);
+        btstack_run_loop_set_timer(&sim_installed_timer, HCI_COMMAND_DURATION_MS * sim_num_sets);
+        btstack_run_loop_add_timer(&sim_installed_timer);
+    }
+    return ERROR_CODE_SUCCESS;
+}
+extern "C" uint8_t gap_extended_advertising_set_params(uint8_t advertising_handle, const le_extended_advertising_parameters_t * advertising_parameters){
+    sim_advertising_set_t * set = sim_set_for_handle(advertising_handle);
+    if (set == NULL) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    set->params = *advertising_parameters;
+    set->num_set_params++;
+    return ERROR_CODE_SUCCESS;
+}
+extern "C" uint8_t gap_extended_advertising_set_adv_data(uint8_t advertising_handle, uint16_t advertising_data_length, const uint8_t * advertising_data){
+    sim_advertising_set_t * set = sim_set_for_handle(advertising_handle);
+    if (set == NULL) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    memcpy(set->adv_data, advertising_data, advertising_data_length);
+    set->adv_data_len = advertising_data_length;
+    set->num_set_data++;
+    return ERROR_CODE_SUCCESS;
+}
+extern "C" uint8_t gap_extended_advertising_start(uint8_t advertising_handle, uint16_t timeout, uint8_t num_extended_advertising_events){
+    UNUSED(timeout);
+    sim_advertising_set_t * set = sim_set_for_handle(advertising_handle);
+    if (set == NULL) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    CHECK(set->enabled == false);
+    set->enabled = true;
+    set->max_events = num_extended_advertising_events;
+    set->num_starts++;
+    if (num_extended_advertising_events > 0){
+        uint32_t interval_ms = (set->params.primary_advertising_interval_min * 625u) / 1000u;
+        uint32_t duration_ms = 2 * HCI_COMMAND_DURATION_MS + (num_extended_advertising_events * (interval_ms + ADVERTISING_DELAY_AVERAGE_MS));
+        btstack_run_loop_set_timer_handler(&set->terminate_timer, &sim_terminate_handler);
+        btstack_run_loop_set_timer_context(&set->terminate_timer, set);
+        btstack_run_loop_set_timer(&set->terminate_timer, duration_ms);
+        btstack_run_loop_add_timer(&set->terminate_timer);
+    }
+    return ERROR_CODE_SUCCESS;
+}
+extern "C" uint8_t gap_extended_advertising_stop(uint8_t advertising_handle){
+    sim_advertising_set_t * set = sim_set_for_handle(advertising_handle);
+    if (set == NULL) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    set->enabled = false;
+    btstack_run_loop_remove_timer(&set->terminate_timer);
+    return ERROR_CODE_SUCCESS;
+}
+
+static void sim_connect(uint8_t advertising_handle){
+    sim_advertising_set_t * set = sim_set_for_handle(advertising_handle);
+    set->enabled = false;
+    uint8_t event[] = { HCI_EVENT_LE_META, 5, HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED, ERROR_CODE_SUCCESS, advertising_handle, 0x40, 0x00, 0 };
+    sim_emit_event(event, sizeof(event));
+}
+
+// mesh network layer sending as fast as possible
+static uint32_t network_pdus_sent;
+static uint8_t  network_pdu_count = 3;
+static uint16_t network_pdu_interval_ms = 20;
+static bool     network_pdu_streaming;
+
+static void network_pdu_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != HCI_EVENT_MESH_META) return;
+    if (hci_event_mesh_meta_get_subevent_code(packet) != MESH_SUBEVENT_CAN_SEND_NOW) return;
+    uint8_t network_pdu[29];
+    memset(network_pdu, 0, sizeof(network_pdu));
+    big_endian_store_32(network_pdu, 0, network_pdus_sent);
+    network_pdus_sent++;
+    adv_bearer_send_network_pdu(network_pdu, sizeof(network_pdu), network_pdu_count, network_pdu_interval_ms);
+    if (network_pdu_streaming){
+        adv_bearer_request_can_send_now_for_network_pdu();
+    }
+}
+
+static adv_bearer_connectable_advertisement_data_item_t proxy_item_a;
+static adv_bearer_connectable_advertisement_data_item_t proxy_item_b;
+
+static void sim_setup(bool extended){
+    adv_bearer_deinit();
+    btstack_run_loop_deinit();
+    btstack_run_loop_init(&sim_run_loop);
+    sim_time_ms = 0;
+    memset(sim_sets, 0, sizeof(sim_sets));
+    sim_num_sets = 0;
+    sim_num_messages_sent = 0;
+    extended_advertising_supported = extended;
+    legacy_num_nonconn_enables = 0;
+    legacy_num_set_params = 0;
+    legacy_enabled = false;
+    network_pdus_sent = 0;
+    network_pdu_count = 3;
+    network_pdu_interval_ms = 20;
+    network_pdu_streaming = false;
+
+    adv_bearer_init();
+    adv_bearer_register_for_network_pdu(&network_pdu_handler);
+    uint8_t event[] = { BTSTACK_EVENT_STATE, 1, HCI_STATE_WORKING };
+    sim_emit_event(event, sizeof(event));
+    sim_run_until(100);
+}
+
+static uint32_t sim_benchmark(bool extended, uint32_t duration_ms){
+    sim_setup(extended);
+    network_pdu_streaming = true;
+    adv_bearer_request_can_send_now_for_network_pdu();
+    uint32_t start_ms = sim_time_ms;
+    uint32_t start_pdus = network_pdus_sent;
+    sim_run_until(start_ms + duration_ms);
+    network_pdu_streaming = false;
+    return ((network_pdus_sent - start_pdus) * 1000u) / duration_ms;
+}
+
+TEST_GROUP(AdvBearer){
+    void setup(void){
+        sim_setup(true);
+    }
+};
+
+TEST(AdvBearer, LegacyController){
+    sim_setup(false);
+    adv_bearer_request_can_send_now_for_network_pdu();
+    CHECK_EQUAL(1, network_pdus_sent);
+    // queued messages are sent one after the other
+    adv_bearer_request_can_send_now_for_network_pdu();
+    CHECK_EQUAL(2, network_pdus_sent);
+    sim_run_until(sim_time_ms + 1000);
+    CHECK_EQUAL(6, legacy_num_nonconn_enables);
+    CHECK_EQUAL(BLUETOOTH_DATA_TYPE_MESH_MESSAGE, legacy_adv_data[1]);
+    CHECK_EQUAL(31, legacy_adv_data_len);
+    CHECK_EQUAL(false, legacy_enabled);
+}
+
+TEST(AdvBearer, SetsInstalled){
+    CHECK_EQUAL(3, sim_num_sets);
+    CHECK_EQUAL(0x10, sim_sets[0].params.advertising_event_properties);
+    CHECK_EQUAL(0x10, sim_sets[1].params.advertising_event_properties);
+    CHECK_EQUAL(0x13, sim_sets[2].params.advertising_event_properties);
+}
+
+TEST(AdvBearer, NetworkPdu){
+    adv_bearer_request_can_send_now_for_network_pdu();
+    CHECK_EQUAL(1, network_pdus_sent);
+    CHECK_EQUAL(true, sim_sets[0].enabled);
+    CHECK_EQUAL(3, sim_sets[0].max_events);
+    CHECK_EQUAL(31, sim_sets[0].adv_data_len);
+    CHECK_EQUAL(30, sim_sets[0].adv_data[0]);
+    CHECK_EQUAL(BLUETOOTH_DATA_TYPE_MESH_MESSAGE, sim_sets[0].adv_data[1]);
+    // no params update for min interval, no legacy advertising
+    CHECK_EQUAL(0, sim_sets[0].num_set_params);
+    CHECK_EQUAL(0, legacy_num_set_params);
+    sim_run_until(sim_time_ms + 1000);
+    CHECK_EQUAL(false, sim_sets[0].enabled);
+    CHECK_EQUAL(1, sim_num_messages_sent);
+}
+
+TEST(AdvBearer, ParallelSetsAndQueue){
+    uint8_t i;
+    for (i=0;i<10;i++){
+        adv_bearer_request_can_send_now_for_network_pdu();
+    }
+    // two sets active, queue full
+    CHECK_EQUAL(6, network_pdus_sent);
+    CHECK_EQUAL(true, sim_sets[0].enabled);
+    CHECK_EQUAL(true, sim_sets[1].enabled);
+    CHECK_EQUAL(0, big_endian_read_32(sim_sets[0].adv_data, 2));
+    CHECK_EQUAL(1, big_endian_read_32(sim_sets[1].adv_data, 2));
+    // pending request served after queue drained
+    sim_run_until(sim_time_ms + 1000);
+    CHECK_EQUAL(7, network_pdus_sent);
+    CHECK_EQUAL(7, sim_num_messages_sent);
+}
+
+TEST(AdvBearer, QueueFullDropsMessage){
+    uint8_t network_pdu[29];
+    uint8_t i;
+    memset(network_pdu, 0, sizeof(network_pdu));
+    for (i=0;i<7;i++){
+        big_endian_store_32(network_pdu, 0, i);
+        adv_bearer_send_network_pdu(network_pdu, sizeof(network_pdu), 3, 20);
+    }
+    // two sets active, four messages queued, last one dropped
+    sim_run_until(sim_time_ms + 1000);
+    CHECK_EQUAL(6, sim_num_messages_sent);
+}
+
+TEST(AdvBearer, OwnAddressType){
+    sim_own_address_type = BD_ADDR_TYPE_LE_RANDOM;
+    sim_setup(true);
+    sim_own_address_type = BD_ADDR_TYPE_LE_PUBLIC;
+    CHECK_EQUAL(3, sim_num_sets);
+    CHECK_EQUAL(BD_ADDR_TYPE_LE_RANDOM, sim_sets[0].params.own_address_type);
+    CHECK_EQUAL(BD_ADDR_TYPE_LE_RANDOM, sim_sets[2].params.own_address_type);
+}
+
+TEST(AdvBearer, IntervalChange){
+    network_pdu_interval_ms = 100;
+    adv_bearer_request_can_send_now_for_network_pdu();
+    CHECK_EQUAL(1, sim_sets[0].num_set_params);
+    CHECK_EQUAL(160, sim_sets[0].params.primary_advertising_interval_min);
+    sim_run_until(sim_time_ms + 1000);
+    adv_bearer_request_can_send_now_for_network_pdu();
+    CHECK_EQUAL(1, sim_sets[0].num_set_params);
+}
+
+TEST(AdvBearer, ConnectableAdvertisements){
+    proxy_item_a.adv_length = 3;
+    memcpy(proxy_item_a.adv_data, "\x02\x01\x06", 3);
+    proxy_item_b.adv_length = 4;
+    memcpy(proxy_item_b.adv_data, "\x03\x03\x28\x18", 4);
+    adv_bearer_advertisements_set_params(0x100, 0x100, 0, 0, NULL, 0x07, 0);
+    adv_bearer_advertisements_add_item(&proxy_item_a);
+    adv_bearer_advertisements_enable(1);
+    sim_advertising_set_t * proxy_set = &sim_sets[2];
+    CHECK_EQUAL(true, proxy_set->enabled);
+    CHECK_EQUAL(0, proxy_set->max_events);
+    CHECK_EQUAL(0x100, proxy_set->params.primary_advertising_interval_min);
+    CHECK_EQUAL(3, proxy_set->adv_data_len);
+
+    // rotate items by updating data only
+    adv_bearer_advertisements_add_item(&proxy_item_b);
+    sim_run_until(sim_time_ms + 1600);
+    CHECK(proxy_set->num_set_data >= 9);
+    CHECK_EQUAL(1, proxy_set->num_starts);
+    CHECK_EQUAL(1, proxy_set->num_set_params);
+
+    // network pdus are sent in parallel
+    adv_bearer_request_can_send_now_for_network_pdu();
+    CHECK_EQUAL(true, sim_sets[0].enabled);
+    CHECK_EQUAL(true, proxy_set->enabled);
+
+    // restart after connection
+    sim_connect(3);
+    CHECK_EQUAL(true, proxy_set->enabled);
+    CHECK_EQUAL(2, proxy_set->num_starts);
+
+    // stop
+    adv_bearer_advertisements_remove_item(&proxy_item_a);
+    CHECK_EQUAL(4, proxy_set->adv_data_len);
+    adv_bearer_advertisements_remove_item(&proxy_item_b);
+    CHECK_EQUAL(false, proxy_set->enabled);
+    sim_run_until(sim_time_ms + 1000);
+    CHECK_EQUAL(false, proxy_set->enabled);
+}
+
+TEST(AdvBearer, Benchmark){
+    uint32_t legacy_rate   = sim_benchmark(false, 60000);
+    uint32_t extended_rate = sim_benchmark(true,  60000);
+    printf("ADV Bearer, network pdus with 3 transmissions: legacy %u msg/s, extended advertising %u msg/s\n",
+           (int) legacy_rate, (int) extended_rate);
+    CHECK(legacy_rate > 0);
+    CHECK(extended_rate > (4 * legacy_rate));
+}
+
+int main (int argc, const char * argv[]){
+    // log into file using HCI_DUMP_PACKETLOGGER format
+    const char * log_path = "hci_dump.pklg";
+    hci_dump_posix_fs_open(log_path, HCI_DUMP_PACKETLOGGER);
+    hci_dump_init(hci_dump_posix_fs_get_instance());
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
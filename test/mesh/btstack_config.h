@@ -42,6 +42,7 @@
 
 // allow for one NetKey update
 #define MAX_NR_MESH_NETWORK_KEYS      (MAX_NR_MESH_SUBNETS+1)
+#define MESH_REPLAY_PROTECTION_LIST_SIZE 2048
 
 #define NVM_NUM_LINK_KEYS 2
 
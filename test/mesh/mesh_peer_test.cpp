@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_run_loop.h"
+#include "btstack_tlv.h"
+#include "hci_dump.h"
+#include "hci_dump_posix_fs.h"
+#include "mesh/mesh_iv_index_seq_number.h"
+#include "mesh/mesh_peer.h"
+#include "mock_btstack_tlv.h"
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+// run loop mock
+static btstack_timer_source_t * store_timer;
+
+extern "C" void btstack_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout){
+    UNUSED(ts);
+    UNUSED(timeout);
+}
+extern "C" void btstack_run_loop_set_timer_handler(btstack_timer_source_t * ts, void (*fn)(btstack_timer_source_t * ts)){
+    ts->process = fn;
+}
+extern "C" void btstack_run_loop_add_timer(btstack_timer_source_t * ts){
+    store_timer = ts;
+}
+extern "C" int btstack_run_loop_remove_timer(btstack_timer_source_t * ts){
+    if (store_timer == ts){
+        store_timer = NULL;
+    }
+    return 1;
+}
+
+static void fire_store_timer(void){
+    CHECK(store_timer != NULL);
+    btstack_timer_source_t * ts = store_timer;
+    store_timer = NULL;
+    ts->process(ts);
+}
+
+static uint32_t time_us(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) ((now.tv_sec * 1000000) + (now.tv_nsec / 1000));
+}
+
+#define NUM_SOURCES      MESH_REPLAY_PROTECTION_LIST_SIZE
+#define NUM_MESSAGES     200000
+
+// reference: linear scan as used before
+static uint16_t linear_addresses[NUM_SOURCES];
+static uint32_t linear_seq[NUM_SOURCES];
+
+static int linear_validate(uint16_t address, uint32_t seq){
+    int i;
+    for (i=0;i<NUM_SOURCES;i++){
+        if (linear_addresses[i] == address) break;
+    }
+    if (i == NUM_SOURCES) return 0;
+    if (seq <= linear_seq[i]) return 0;
+    linear_seq[i] = seq;
+    return 1;
+}
+
+// spread addresses over unicast range
+static uint16_t address_for_source(uint32_t source){
+    return (uint16_t) (1 + ((source * 7u) % 0x7ffe));
+}
+
+static mesh_segmented_pdu_t dummy_segmented_pdu;
+
+TEST_GROUP(MeshPeer){
+    mock_btstack_tlv_t tlv_context;
+    const btstack_tlv_t * tlv_impl;
+
+    void setup(void){
+        tlv_impl = mock_btstack_tlv_init_instance(&tlv_context);
+        btstack_tlv_set_instance(tlv_impl, &tlv_context);
+        store_timer = NULL;
+        mesh_set_iv_index(0x1000);
+        mesh_seq_auth_delete();
+    }
+    void teardown(void){
+        mesh_seq_auth_reset();
+        btstack_tlv_set_instance(NULL, NULL);
+        mock_btstack_tlv_deinit(&tlv_context);
+    }
+
+    void fill_list(uint32_t iv_index){
+        uint32_t i;
+        for (i=0;i<NUM_SOURCES;i++){
+            mesh_peer_t * peer = mesh_peer_for_addr(address_for_source(i));
+            CHECK(peer != NULL);
+            CHECK_EQUAL(1, mesh_peer_validate_seq(peer, iv_index, 1));
+        }
+        CHECK_EQUAL(NUM_SOURCES, mesh_peer_count());
+    }
+};
+
+TEST(MeshPeer, LookupSameEntry){
+    mesh_peer_t * peer_a = mesh_peer_for_addr(0x0001);
+    mesh_peer_t * peer_b = mesh_peer_for_addr(0x0002);
+    CHECK(peer_a != NULL);
+    CHECK(peer_b != NULL);
+    CHECK(peer_a != peer_b);
+    CHECK_EQUAL(0x0001, peer_a->address);
+    POINTERS_EQUAL(peer_a, mesh_peer_for_addr(0x0001));
+    CHECK_EQUAL(2, mesh_peer_count());
+}
+
+TEST(MeshPeer, UnassignedAddress){
+    POINTERS_EQUAL(NULL, mesh_peer_for_addr(0x0000));
+    CHECK_EQUAL(0, mesh_peer_count());
+}
+
+TEST(MeshPeer, CollidingAddresses){
+    mesh_peer_t * peer_a = mesh_peer_for_addr(0x0010);
+    mesh_peer_t * peer_b = mesh_peer_for_addr(0x0010 + MESH_REPLAY_PROTECTION_LIST_SIZE);
+    mesh_peer_t * peer_c = mesh_peer_for_addr(0x0010 + 2 * MESH_REPLAY_PROTECTION_LIST_SIZE);
+    CHECK(peer_a != peer_b);
+    CHECK(peer_b != peer_c);
+    POINTERS_EQUAL(peer_a, mesh_peer_for_addr(0x0010));
+    POINTERS_EQUAL(peer_b, mesh_peer_for_addr(0x0010 + MESH_REPLAY_PROTECTION_LIST_SIZE));
+    POINTERS_EQUAL(peer_c, mesh_peer_for_addr(0x0010 + 2 * MESH_REPLAY_PROTECTION_LIST_SIZE));
+}
+
+TEST(MeshPeer, ValidateSeq){
+    mesh_peer_t * peer = mesh_peer_for_addr(0x0001);
+    // first message from new source is accepted, also with seq 0
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x1000, 0));
+    CHECK_EQUAL(0, mesh_peer_validate_seq(peer, 0x1000, 0));
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x1000, 10));
+    CHECK_EQUAL(0, mesh_peer_validate_seq(peer, 0x1000, 10));
+    CHECK_EQUAL(0, mesh_peer_validate_seq(peer, 0x1000, 9));
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x1000, 0xffffff));
+}
+
+TEST(MeshPeer, ValidateSeqIvIndex){
+    mesh_peer_t * peer = mesh_peer_for_addr(0x0001);
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x0fff, 1000));
+    peer->seq_auth = 990;
+    peer->seq_zero = 990;
+    // new IV index, seq restarts
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x1000, 5));
+    CHECK_EQUAL(0, peer->seq_auth);
+    CHECK_EQUAL(0, peer->seq_zero);
+    // old IV index rejected
+    CHECK_EQUAL(0, mesh_peer_validate_seq(peer, 0x0fff, 2000));
+}
+
+TEST(MeshPeer, ThousandsOfSources){
+    fill_list(0x1000);
+    uint32_t i;
+    for (i=0;i<NUM_SOURCES;i++){
+        uint16_t address = address_for_source(i);
+        mesh_peer_t * peer = mesh_peer_for_addr(address);
+        CHECK(peer != NULL);
+        CHECK_EQUAL(address, peer->address);
+        CHECK_EQUAL(0, mesh_peer_validate_seq(peer, 0x1000, 1));
+    }
+    CHECK_EQUAL(NUM_SOURCES, mesh_peer_count());
+}
+
+TEST(MeshPeer, FullListDropsNewSource){
+    fill_list(0x1000);
+    // all entries could be used for replay with current IV index
+    POINTERS_EQUAL(NULL, mesh_peer_for_addr(0x7fff));
+    // previous IV index is still accepted by network layer
+    mesh_set_iv_index(0x1001);
+    POINTERS_EQUAL(NULL, mesh_peer_for_addr(0x7fff));
+}
+
+TEST(MeshPeer, FullListReplacesStaleEntry){
+    fill_list(0x1000);
+    // source 1 is least recently used
+    uint32_t i;
+    for (i=0;i<NUM_SOURCES;i++){
+        if (i == 1) continue;
+        mesh_peer_for_addr(address_for_source(i));
+    }
+    mesh_set_iv_index(0x1002);
+    mesh_peer_t * peer = mesh_peer_for_addr(0x7fff);
+    CHECK(peer != NULL);
+    CHECK_EQUAL(0x7fff, peer->address);
+    CHECK_EQUAL(0, peer->seq_valid);
+    CHECK_EQUAL(NUM_SOURCES, mesh_peer_count());
+    // least recently used entry got replaced
+    mesh_peer_t * replaced = mesh_peer_for_addr(address_for_source(1));
+    CHECK(replaced != NULL);
+    CHECK_EQUAL(0, replaced->seq_valid);
+    POINTERS_EQUAL(peer, mesh_peer_for_addr(0x7fff));
+}
+
+TEST(MeshPeer, FullListKeepsOngoingReception){
+    fill_list(0x1000);
+    uint32_t i;
+    for (i=0;i<NUM_SOURCES;i++){
+        mesh_peer_t * peer = mesh_peer_for_addr(address_for_source(i));
+        // all but last one receive segmented message
+        if (i == (NUM_SOURCES - 1)) continue;
+        peer->message_pdu = &dummy_segmented_pdu;
+    }
+    mesh_set_iv_index(0x1002);
+    mesh_peer_t * peer = mesh_peer_for_addr(0x7fff);
+    CHECK(peer != NULL);
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x1002, 1));
+    POINTERS_EQUAL(NULL, mesh_peer_for_addr(0x7ffe));
+    // reception completes
+    mesh_peer_for_addr(address_for_source(0))->message_pdu = NULL;
+    peer = mesh_peer_for_addr(0x7ffe);
+    CHECK(peer != NULL);
+    CHECK_EQUAL(0x7ffe, peer->address);
+}
+
+TEST(MeshPeer, PersistSeqAuth){
+    mesh_peer_t * peer = mesh_peer_for_addr(0x0042);
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x1000, 0x123456));
+    peer->seq_auth = 0x123450;
+    peer->seq_zero = 0x1450;
+    peer = mesh_peer_for_addr(0x0043);
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x1000, 7));
+    fire_store_timer();
+    POINTERS_EQUAL(NULL, store_timer);
+
+    // power cycle
+    mesh_seq_auth_reset();
+    CHECK_EQUAL(0, mesh_peer_count());
+    mesh_seq_auth_load();
+    CHECK_EQUAL(2, mesh_peer_count());
+
+    peer = mesh_peer_for_addr(0x0042);
+    CHECK_EQUAL(0x123456, peer->seq);
+    CHECK_EQUAL(0x123450, peer->seq_auth);
+    CHECK_EQUAL(0x1450,   peer->seq_zero);
+    CHECK_EQUAL(0x1000,   peer->iv_index);
+    CHECK_EQUAL(0, mesh_peer_validate_seq(peer, 0x1000, 0x123456));
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x1000, 0x123457));
+    peer = mesh_peer_for_addr(0x0043);
+    CHECK_EQUAL(0, mesh_peer_validate_seq(peer, 0x1000, 7));
+    CHECK_EQUAL(2, mesh_peer_count());
+}
+
+TEST(MeshPeer, PersistThousandsOfSources){
+    fill_list(0x1000);
+    mesh_seq_auth_store();
+    mesh_seq_auth_reset();
+    mesh_seq_auth_load();
+    CHECK_EQUAL(NUM_SOURCES, mesh_peer_count());
+    uint32_t i;
+    for (i=0;i<NUM_SOURCES;i++){
+        mesh_peer_t * peer = mesh_peer_for_addr(address_for_source(i));
+        CHECK_EQUAL(0, mesh_peer_validate_seq(peer, 0x1000, 1));
+    }
+    // new entries after load
+    mesh_set_iv_index(0x1002);
+    CHECK(mesh_peer_for_addr(0x7fff) != NULL);
+}
+
+TEST(MeshPeer, Delete){
+    mesh_peer_t * peer = mesh_peer_for_addr(0x0042);
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x1000, 100));
+    mesh_seq_auth_store();
+    mesh_seq_auth_delete();
+    POINTERS_EQUAL(NULL, store_timer);
+    mesh_seq_auth_load();
+    CHECK_EQUAL(0, mesh_peer_count());
+    peer = mesh_peer_for_addr(0x0042);
+    CHECK_EQUAL(1, mesh_peer_validate_seq(peer, 0x1000, 100));
+}
+
+TEST(MeshPeer, BenchmarkLookup){
+    uint32_t i;
+    fill_list(0x1000);
+    for (i=0;i<NUM_SOURCES;i++){
+        linear_addresses[i] = address_for_source(i);
+        linear_seq[i] = 1;
+    }
+
+    // received messages from random sources
+    uint32_t random = 0x12345678;
+    uint32_t start = time_us();
+    uint32_t valid = 0;
+    for (i=0;i<NUM_MESSAGES;i++){
+        random = (random * 1664525u) + 1013904223u;
+        mesh_peer_t * peer = mesh_peer_for_addr(address_for_source((random >> 8) % NUM_SOURCES));
+        valid += mesh_peer_validate_seq(peer, 0x1000, 2 + i);
+    }
+    uint32_t hashed_us = time_us() - start;
+    CHECK_EQUAL(NUM_MESSAGES, valid);
+
+    random = 0x12345678;
+    start = time_us();
+    valid = 0;
+    for (i=0;i<NUM_MESSAGES;i++){
+        random = (random * 1664525u) + 1013904223u;
+        valid += linear_validate(address_for_source((random >> 8) % NUM_SOURCES), 2 + i);
+    }
+    uint32_t linear_us = time_us() - start;
+    CHECK_EQUAL(NUM_MESSAGES, valid);
+
+    printf("Replay protection list with %u sources: %u ns per message, linear scan: %u ns per message\n",
+           (int) NUM_SOURCES, (int) ((hashed_us * 1000u) / NUM_MESSAGES), (int) ((linear_us * 1000u) / NUM_MESSAGES));
+    CHECK(hashed_us < linear_us);
+}
+
+int main (int argc, const char * argv[]){
+    // log into file using HCI_DUMP_PACKETLOGGER format
+    const char * log_path = "hci_dump.pklg";
+    hci_dump_posix_fs_open(log_path, HCI_DUMP_PACKETLOGGER);
+    hci_dump_init(hci_dump_posix_fs_get_instance());
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
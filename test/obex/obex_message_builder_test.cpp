@@ -124,6 +124,20 @@ TEST(OBEX_MESSAGE_BUILDER, CreateGetAddHeader){
     validate_success(expected_message, expected_message[2], actual_status);
 }
 
+TEST(OBEX_MESSAGE_BUILDER, CreateGetAddSrmpWait){
+    uint8_t  expected_message[] = {OBEX_OPCODE_GET | OBEX_OPCODE_FINAL_BIT_MASK, 0, 0, OBEX_HEADER_CONNECTION_ID, 0, 0, 0, 0,
+        OBEX_HEADER_SINGLE_RESPONSE_MODE, OBEX_SRM_ENABLE, OBEX_HEADER_SINGLE_RESPONSE_MODE_PARAMETER, OBEX_SRMP_WAIT};
+    expected_message[2] = sizeof(expected_message);
+    big_endian_store_32(expected_message, 4, connection_id);
+
+    uint8_t actual_status = obex_message_builder_request_create_get(actual_message, actual_message_len, connection_id);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, actual_status);
+    actual_status = obex_message_builder_header_add_srm_enable(actual_message, actual_message_len);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, actual_status);
+    actual_status = obex_message_builder_header_add_srmp_wait(actual_message, actual_message_len);
+    validate_success(expected_message, expected_message[2], actual_status);
+}
+
 TEST(OBEX_MESSAGE_BUILDER, CreateConnectWithHeaderTarget){
     uint8_t  expected_message[] = {OBEX_OPCODE_CONNECT, 0, 0, obex_version_number, flags, 0, 0, 
         // service UUID
@@ -0,0 +1,528 @@
+// *****************************************************************************
+//
+// simulated GOEP client connection to a remote PSE with virtual time
+//
+// Requests and responses are serialized per direction with GOEP_SIM_US_PER_BYTE
+// and arrive GOEP_SIM_LATENCY_MS later. The PSE replays the configured object
+// in OBEX packets of GOEP_SIM_OBEX_PACKET_LEN. With Single Response Mode, it
+// sends the next response as soon as the previous one was transmitted, unless
+// the client or the PSE itself requested to wait via SRMP header.
+//
+// *****************************************************************************
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btstack_debug.h"
+#include "btstack_defines.h"
+#include "btstack_util.h"
+#include "classic/goep_client.h"
+#include "classic/obex.h"
+#include "classic/obex_message_builder.h"
+#include "classic/obex_parser.h"
+#include "goep_sim.h"
+
+#define SIM_MAX_EVENTS       16
+#define SIM_GOEP_CID         1
+#define SIM_CON_HANDLE       0x0001
+#define SIM_CONNECTION_ID    0x1234
+
+typedef enum {
+    SIM_EVENT_CONNECTION_OPENED,
+    SIM_EVENT_CAN_SEND_NOW,
+    SIM_EVENT_REQUEST,
+    SIM_EVENT_RESPONSE,
+    SIM_EVENT_SEND_NEXT_RESPONSE,
+    SIM_EVENT_CONNECTION_CLOSED,
+} sim_event_type_t;
+
+typedef struct {
+    bool     active;
+    uint64_t time_us;
+    uint32_t seq;
+    sim_event_type_t type;
+    uint16_t len;
+    uint8_t  data[GOEP_SIM_OBEX_PACKET_LEN];
+} sim_event_t;
+
+typedef enum {
+    SIM_DIRECTION_TO_REMOTE = 0,
+    SIM_DIRECTION_FROM_REMOTE,
+} sim_direction_t;
+
+static uint64_t      sim_time_us;
+static uint32_t      sim_event_seq;
+static sim_event_t   sim_events[SIM_MAX_EVENTS];
+static uint64_t      sim_link_free_us[2];
+
+// local GOEP client
+static btstack_packet_handler_t sim_client_handler;
+static bd_addr_t     sim_client_addr;
+static uint8_t       sim_client_buffer[GOEP_SIM_OBEX_PACKET_LEN];
+static uint32_t      sim_client_connection_id;
+static bool          sim_client_can_send_now_requested;
+
+// remote PSE
+static bool          sim_srm_supported;
+static uint16_t      sim_num_srmp_wait_responses;
+static const uint8_t * sim_object_data;
+static uint32_t      sim_object_len;
+static uint16_t      sim_phonebook_size;
+
+static obex_parser_t sim_request_parser;
+static uint8_t       sim_request_srm;
+static uint8_t       sim_request_srmp;
+static bool          sim_request_max_list_count_zero;
+
+static bool          sim_get_active;
+static bool          sim_srm_active;
+static bool          sim_client_waiting;
+static uint32_t      sim_object_pos;
+static uint16_t      sim_srmp_wait_remaining;
+static uint32_t      sim_num_get_responses;
+static bool          sim_abort_received;
+
+// stats
+static uint32_t      sim_num_get_requests;
+static uint32_t      sim_num_srmp_wait_requests;
+static uint32_t      sim_num_responses;
+
+static sim_event_t * sim_schedule(sim_event_type_t type, uint64_t time_us){
+    int i;
+    for (i=0;i<SIM_MAX_EVENTS;i++){
+        sim_event_t * event = &sim_events[i];
+        if (event->active) continue;
+        event->active  = true;
+        event->time_us = time_us;
+        event->seq     = sim_event_seq++;
+        event->type    = type;
+        event->len     = 0;
+        return event;
+    }
+    btstack_assert(false);
+    return NULL;
+}
+
+static void sim_cancel(sim_event_type_t type){
+    int i;
+    for (i=0;i<SIM_MAX_EVENTS;i++){
+        if (sim_events[i].active && (sim_events[i].type == type)){
+            sim_events[i].active = false;
+        }
+    }
+}
+
+// transmit packet over link, returns time of arrival
+static uint64_t sim_transmit(sim_direction_t direction, uint16_t len){
+    uint64_t start_us = sim_time_us;
+    if (sim_link_free_us[direction] > start_us){
+        start_us = sim_link_free_us[direction];
+    }
+    sim_link_free_us[direction] = start_us + ((uint64_t) len * GOEP_SIM_US_PER_BYTE);
+    return sim_link_free_us[direction] + (GOEP_SIM_LATENCY_MS * 1000);
+}
+
+static void sim_emit_goep_event(uint8_t subevent, uint8_t status){
+    uint8_t event[15];
+    int pos = 0;
+    event[pos++] = HCI_EVENT_GOEP_META;
+    pos++;  // skip len
+    event[pos++] = subevent;
+    little_endian_store_16(event, pos, SIM_GOEP_CID);
+    pos += 2;
+    if (subevent == GOEP_SUBEVENT_CONNECTION_OPENED){
+        event[pos++] = status;
+        (void)memcpy(&event[pos], sim_client_addr, 6);
+        pos += 6;
+        little_endian_store_16(event, pos, SIM_CON_HANDLE);
+        pos += 2;
+        event[pos++] = 0;
+    }
+    event[1] = pos - 2;
+    (*sim_client_handler)(HCI_EVENT_PACKET, SIM_GOEP_CID, event, pos);
+}
+
+// remote PSE
+static void sim_remote_send(const uint8_t * response){
+    uint16_t len = big_endian_read_16(response, 1);
+    sim_event_t * event = sim_schedule(SIM_EVENT_RESPONSE, sim_transmit(SIM_DIRECTION_FROM_REMOTE, len));
+    (void)memcpy(event->data, response, len);
+    event->len = len;
+    sim_num_responses++;
+}
+
+static void sim_remote_send_general(uint8_t response_code){
+    uint8_t response[3];
+    obex_message_builder_response_create_general(response, sizeof(response), response_code);
+    sim_remote_send(response);
+}
+
+static void sim_remote_send_phonebook_size(void){
+    uint8_t response[16];
+    uint8_t application_parameters[4];
+    application_parameters[0] = PBAP_APPLICATION_PARAMETER_PHONEBOOK_SIZE;
+    application_parameters[1] = 2;
+    big_endian_store_16(application_parameters, 2, sim_phonebook_size);
+    obex_message_builder_response_create_general(response, sizeof(response), OBEX_RESP_SUCCESS);
+    obex_message_builder_header_add_application_parameters(response, sizeof(response), application_parameters, sizeof(application_parameters));
+    sim_remote_send(response);
+}
+
+static void sim_remote_send_next_get_response(void){
+    uint8_t response[GOEP_SIM_OBEX_PACKET_LEN];
+    obex_message_builder_response_create_general(response, sizeof(response), OBEX_RESP_CONTINUE);
+    if (sim_srm_active && (sim_num_get_responses == 0)){
+        obex_message_builder_header_add_srm_enable(response, sizeof(response));
+    }
+    bool remote_waiting = sim_srm_active && (sim_srmp_wait_remaining > 0);
+    if (remote_waiting){
+        obex_message_builder_header_add_byte(response, sizeof(response), OBEX_HEADER_SINGLE_RESPONSE_MODE_PARAMETER, OBEX_SRMP_WAIT);
+        sim_srmp_wait_remaining--;
+    }
+
+    uint32_t remaining = sim_object_len - sim_object_pos;
+    uint16_t available = sizeof(response) - big_endian_read_16(response, 1) - 3;
+    uint16_t chunk_len = (uint16_t) btstack_min(remaining, available);
+    bool final = chunk_len == remaining;
+    obex_message_builder_header_add_variable(response, sizeof(response), final ? OBEX_HEADER_END_OF_BODY : OBEX_HEADER_BODY,
+                                             &sim_object_data[sim_object_pos], chunk_len);
+    if (final){
+        obex_message_builder_response_update_code(response, sizeof(response), OBEX_RESP_SUCCESS);
+    }
+    sim_object_pos += chunk_len;
+    sim_num_get_responses++;
+    sim_remote_send(response);
+
+    if (final){
+        sim_get_active = false;
+        return;
+    }
+    if (sim_srm_active && !sim_client_waiting && !remote_waiting){
+        // keep link busy
+        sim_schedule(SIM_EVENT_SEND_NEXT_RESPONSE, sim_link_free_us[SIM_DIRECTION_FROM_REMOTE]);
+    }
+}
+
+static void sim_remote_request_callback(void * user_data, uint8_t header_id, uint16_t total_len, uint16_t data_offset, const uint8_t * data_buffer, uint16_t data_len){
+    UNUSED(user_data);
+    switch (header_id){
+        case OBEX_HEADER_SINGLE_RESPONSE_MODE:
+            obex_parser_header_store(&sim_request_srm, 1, total_len, data_offset, data_buffer, data_len);
+            break;
+        case OBEX_HEADER_SINGLE_RESPONSE_MODE_PARAMETER:
+            obex_parser_header_store(&sim_request_srmp, 1, total_len, data_offset, data_buffer, data_len);
+            break;
+        case OBEX_HEADER_APPLICATION_PARAMETERS:
+            // PBAP client sends max list count as only parameter of size request in a single chunk
+            if ((data_offset == 0) && (data_len >= 4) && (data_buffer[0] == PBAP_APPLICATION_PARAMETER_MAX_LIST_COUNT)){
+                sim_request_max_list_count_zero = big_endian_read_16(data_buffer, 2) == 0;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void sim_remote_handle_get(void){
+    sim_num_get_requests++;
+    if (sim_request_srmp == OBEX_SRMP_WAIT){
+        sim_num_srmp_wait_requests++;
+    }
+    if (sim_get_active == false){
+        if (sim_request_max_list_count_zero){
+            sim_remote_send_phonebook_size();
+            return;
+        }
+        sim_get_active = true;
+        sim_srm_active = sim_srm_supported && (sim_request_srm == OBEX_SRM_ENABLE);
+        sim_srmp_wait_remaining = sim_num_srmp_wait_responses;
+        sim_object_pos = 0;
+        sim_num_get_responses = 0;
+    }
+    sim_client_waiting = sim_request_srmp == OBEX_SRMP_WAIT;
+    sim_remote_send_next_get_response();
+}
+
+static void sim_remote_handle_request(const uint8_t * request, uint16_t len){
+    uint8_t response[16];
+    sim_request_srm = OBEX_SRM_DISABLE;
+    sim_request_srmp = OBEX_SRMP_NEXT;
+    sim_request_max_list_count_zero = false;
+    obex_parser_init_for_request(&sim_request_parser, &sim_remote_request_callback, NULL);
+    obex_parser_object_state_t state = obex_parser_process_data(&sim_request_parser, request, len);
+    btstack_assert(state == OBEX_PARSER_OBJECT_STATE_COMPLETE);
+    UNUSED(state);
+
+    switch (request[0]){
+        case OBEX_OPCODE_CONNECT:
+            obex_message_builder_response_create_connect(response, sizeof(response), OBEX_VERSION, 0, GOEP_SIM_OBEX_PACKET_LEN, SIM_CONNECTION_ID);
+            sim_remote_send(response);
+            break;
+        case OBEX_OPCODE_GET | OBEX_OPCODE_FINAL_BIT_MASK:
+            sim_remote_handle_get();
+            break;
+        case OBEX_OPCODE_ABORT:
+            sim_abort_received = true;
+            sim_get_active = false;
+            sim_cancel(SIM_EVENT_SEND_NEXT_RESPONSE);
+            sim_remote_send_general(OBEX_RESP_SUCCESS);
+            break;
+        default:
+            sim_remote_send_general(OBEX_RESP_SUCCESS);
+            break;
+    }
+}
+
+static void sim_deliver(sim_event_t * event){
+    switch (event->type){
+        case SIM_EVENT_CONNECTION_OPENED:
+            sim_emit_goep_event(GOEP_SUBEVENT_CONNECTION_OPENED, ERROR_CODE_SUCCESS);
+            break;
+        case SIM_EVENT_CAN_SEND_NOW:
+            sim_client_can_send_now_requested = false;
+            sim_emit_goep_event(GOEP_SUBEVENT_CAN_SEND_NOW, 0);
+            break;
+        case SIM_EVENT_REQUEST:
+            sim_remote_handle_request(event->data, event->len);
+            break;
+        case SIM_EVENT_RESPONSE:
+            (*sim_client_handler)(GOEP_DATA_PACKET, SIM_GOEP_CID, event->data, event->len);
+            break;
+        case SIM_EVENT_SEND_NEXT_RESPONSE:
+            if (sim_get_active){
+                sim_remote_send_next_get_response();
+            }
+            break;
+        case SIM_EVENT_CONNECTION_CLOSED:
+            sim_emit_goep_event(GOEP_SUBEVENT_CONNECTION_CLOSED, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+void goep_sim_run(void){
+    while (true){
+        sim_event_t * next = NULL;
+        int i;
+        for (i=0;i<SIM_MAX_EVENTS;i++){
+            sim_event_t * event = &sim_events[i];
+            if (!event->active) continue;
+            if ((next == NULL) || (event->time_us < next->time_us) || ((event->time_us == next->time_us) && (event->seq < next->seq))){
+                next = event;
+            }
+        }
+        if (next == NULL) return;
+        // copy event as handlers schedule new events
+        sim_event_t current = *next;
+        next->active = false;
+        sim_time_us = current.time_us;
+        sim_deliver(&current);
+    }
+}
+
+void goep_sim_init(void){
+    memset(sim_events, 0, sizeof(sim_events));
+    memset(sim_link_free_us, 0, sizeof(sim_link_free_us));
+    sim_time_us = 0;
+    sim_event_seq = 0;
+    sim_client_handler = NULL;
+    sim_client_connection_id = OBEX_CONNECTION_ID_INVALID;
+    sim_client_can_send_now_requested = false;
+    sim_srm_supported = false;
+    sim_num_srmp_wait_responses = 0;
+    sim_object_data = NULL;
+    sim_object_len = 0;
+    sim_phonebook_size = 0;
+    sim_get_active = false;
+    sim_srm_active = false;
+    sim_client_waiting = false;
+    sim_abort_received = false;
+    sim_num_get_requests = 0;
+    sim_num_srmp_wait_requests = 0;
+    sim_num_responses = 0;
+}
+
+void goep_sim_set_srm_supported(bool srm_supported){
+    sim_srm_supported = srm_supported;
+}
+
+void goep_sim_set_num_srmp_wait_responses(uint16_t num_responses){
+    sim_num_srmp_wait_responses = num_responses;
+}
+
+void goep_sim_set_object(const uint8_t * data, uint32_t len){
+    sim_object_data = data;
+    sim_object_len = len;
+}
+
+void goep_sim_set_phonebook_size(uint16_t phonebook_size){
+    sim_phonebook_size = phonebook_size;
+}
+
+uint32_t goep_sim_create_phonebook(uint8_t * buffer, uint32_t buffer_size, uint16_t num_entries){
+    uint32_t pos = 0;
+    uint16_t i;
+    for (i=0;i<num_entries;i++){
+        int len = snprintf((char *) &buffer[pos], buffer_size - pos,
+                           "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Contact %04u\r\nN:%04u;Contact;;;\r\n"
+                           "TEL;TYPE=CELL:+49 170 %07u\r\nEMAIL;TYPE=INTERNET:contact%04u@example.com\r\n"
+                           "X-IRMC-CALL-DATETIME;MISSED:20240101T%02u%02u00\r\nEND:VCARD\r\n",
+                           i, i, 1000000u + i, i, (i / 60) % 24, i % 60);
+        btstack_assert((len > 0) && ((uint32_t) len < (buffer_size - pos)));
+        pos += (uint32_t) len;
+    }
+    return pos;
+}
+
+uint32_t goep_sim_create_vcard_listing(uint8_t * buffer, uint32_t buffer_size, uint16_t num_entries){
+    uint32_t pos = 0;
+    pos += snprintf((char *) &buffer[pos], buffer_size - pos, "<?xml version=\"1.0\"?>\n<vCard-listing version=\"1.0\">\n");
+    uint16_t i;
+    for (i=0;i<num_entries;i++){
+        pos += snprintf((char *) &buffer[pos], buffer_size - pos, "<card handle=\"%u.vcf\" name=\"Contact %04u\"/>\n", i, i);
+    }
+    pos += snprintf((char *) &buffer[pos], buffer_size - pos, "</vCard-listing>\n");
+    btstack_assert(pos < buffer_size);
+    return pos;
+}
+
+uint32_t goep_sim_get_time_ms(void){
+    return (uint32_t) (sim_time_us / 1000);
+}
+
+uint32_t goep_sim_get_num_get_requests(void){
+    return sim_num_get_requests;
+}
+
+uint32_t goep_sim_get_num_srmp_wait_requests(void){
+    return sim_num_srmp_wait_requests;
+}
+
+uint32_t goep_sim_get_num_responses(void){
+    return sim_num_responses;
+}
+
+bool goep_sim_get_srm_active(void){
+    return sim_srm_active;
+}
+
+bool goep_sim_get_abort_received(void){
+    return sim_abort_received;
+}
+
+// simulated GOEP Client
+uint8_t goep_client_create_connection(btstack_packet_handler_t handler, bd_addr_t addr, uint16_t uuid, uint16_t * out_cid){
+    UNUSED(uuid);
+    sim_client_handler = handler;
+    (void)memcpy(sim_client_addr, addr, 6);
+    *out_cid = SIM_GOEP_CID;
+    sim_schedule(SIM_EVENT_CONNECTION_OPENED, sim_time_us + (GOEP_SIM_CONNECT_MS * 1000));
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t goep_client_disconnect(uint16_t goep_cid){
+    UNUSED(goep_cid);
+    sim_schedule(SIM_EVENT_CONNECTION_CLOSED, sim_time_us + (GOEP_SIM_LATENCY_MS * 1000));
+    return ERROR_CODE_SUCCESS;
+}
+
+void goep_client_request_can_send_now(uint16_t goep_cid){
+    UNUSED(goep_cid);
+    if (sim_client_can_send_now_requested) return;
+    sim_client_can_send_now_requested = true;
+    sim_schedule(SIM_EVENT_CAN_SEND_NOW, sim_time_us);
+}
+
+uint32_t goep_client_get_pbap_supported_features(uint16_t goep_cid){
+    UNUSED(goep_cid);
+    return PBAP_FEATURES_NOT_PRESENT;
+}
+
+bool goep_client_version_20_or_higher(uint16_t goep_cid){
+    UNUSED(goep_cid);
+    return sim_srm_supported;
+}
+
+void goep_client_set_connection_id(uint16_t goep_cid, uint32_t connection_id){
+    UNUSED(goep_cid);
+    sim_client_connection_id = connection_id;
+}
+
+void goep_client_request_create_connect(uint16_t goep_cid, uint8_t obex_version_number, uint8_t flags, uint16_t maximum_obex_packet_length){
+    UNUSED(goep_cid);
+    obex_message_builder_request_create_connect(sim_client_buffer, sizeof(sim_client_buffer), obex_version_number, flags, maximum_obex_packet_length);
+}
+
+void goep_client_request_create_get(uint16_t goep_cid){
+    UNUSED(goep_cid);
+    obex_message_builder_request_create_get(sim_client_buffer, sizeof(sim_client_buffer), sim_client_connection_id);
+}
+
+void goep_client_request_create_set_path(uint16_t goep_cid, uint8_t flags){
+    UNUSED(goep_cid);
+    obex_message_builder_request_create_set_path(sim_client_buffer, sizeof(sim_client_buffer), flags, sim_client_connection_id);
+}
+
+void goep_client_request_create_abort(uint16_t goep_cid){
+    UNUSED(goep_cid);
+    obex_message_builder_request_create_abort(sim_client_buffer, sizeof(sim_client_buffer), sim_client_connection_id);
+}
+
+void goep_client_request_create_disconnect(uint16_t goep_cid){
+    UNUSED(goep_cid);
+    obex_message_builder_request_create_disconnect(sim_client_buffer, sizeof(sim_client_buffer), sim_client_connection_id);
+}
+
+void goep_client_header_add_srm_enable(uint16_t goep_cid){
+    UNUSED(goep_cid);
+    obex_message_builder_header_add_srm_enable(sim_client_buffer, sizeof(sim_client_buffer));
+}
+
+void goep_client_header_add_srmp_wait(uint16_t goep_cid){
+    UNUSED(goep_cid);
+    obex_message_builder_header_add_srmp_wait(sim_client_buffer, sizeof(sim_client_buffer));
+}
+
+void goep_client_header_add_target(uint16_t goep_cid, const uint8_t * target, uint16_t length){
+    UNUSED(goep_cid);
+    obex_message_builder_header_add_target(sim_client_buffer, sizeof(sim_client_buffer), target, length);
+}
+
+void goep_client_header_add_application_parameters(uint16_t goep_cid, const uint8_t * data, uint16_t length){
+    UNUSED(goep_cid);
+    obex_message_builder_header_add_application_parameters(sim_client_buffer, sizeof(sim_client_buffer), data, length);
+}
+
+void goep_client_header_add_challenge_response(uint16_t goep_cid, const uint8_t * data, uint16_t length){
+    UNUSED(goep_cid);
+    obex_message_builder_header_add_challenge_response(sim_client_buffer, sizeof(sim_client_buffer), data, length);
+}
+
+void goep_client_header_add_name(uint16_t goep_cid, const char * name){
+    UNUSED(goep_cid);
+    obex_message_builder_header_add_name(sim_client_buffer, sizeof(sim_client_buffer), name);
+}
+
+void goep_client_header_add_name_prefix(uint16_t goep_cid, const char * name, uint16_t name_len){
+    UNUSED(goep_cid);
+    obex_message_builder_header_add_name_prefix(sim_client_buffer, sizeof(sim_client_buffer), name, name_len);
+}
+
+void goep_client_header_add_type(uint16_t goep_cid, const char * type){
+    UNUSED(goep_cid);
+    obex_message_builder_header_add_type(sim_client_buffer, sizeof(sim_client_buffer), type);
+}
+
+int goep_client_execute(uint16_t goep_cid){
+    UNUSED(goep_cid);
+    uint16_t len = big_endian_read_16(sim_client_buffer, 1);
+    sim_event_t * event = sim_schedule(SIM_EVENT_REQUEST, sim_transmit(SIM_DIRECTION_TO_REMOTE, len));
+    (void)memcpy(event->data, sim_client_buffer, len);
+    event->len = len;
+    return ERROR_CODE_SUCCESS;
+}
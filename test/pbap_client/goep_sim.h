@@ -0,0 +1,60 @@
+// *****************************************************************************
+//
+// simulated GOEP client connection to a remote PSE with virtual time
+//
+// *****************************************************************************
+
+#ifndef GOEP_SIM_H
+#define GOEP_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+// max OBEX packet length of PSE
+#define GOEP_SIM_OBEX_PACKET_LEN   1000
+
+// simulated link: one-way latency including processing on the remote and transmission time per byte
+#define GOEP_SIM_LATENCY_MS        15
+#define GOEP_SIM_US_PER_BYTE       8
+
+#define GOEP_SIM_CONNECT_MS        100
+
+void     goep_sim_init(void);
+
+// PSE supports GOEP 2.0 and accepts Single Response Mode
+void     goep_sim_set_srm_supported(bool srm_supported);
+
+// PSE asks the client to send a GET request for each of the first responses with SRMP Wait
+void     goep_sim_set_num_srmp_wait_responses(uint16_t num_responses);
+
+// object sent in response to GET requests, not copied
+void     goep_sim_set_object(const uint8_t * data, uint32_t len);
+
+// returned for GET requests with max list count zero
+void     goep_sim_set_phonebook_size(uint16_t phonebook_size);
+
+// phone book with vCard 3.0 entries as sent by a phone, returns length
+uint32_t goep_sim_create_phonebook(uint8_t * buffer, uint32_t buffer_size, uint16_t num_entries);
+
+// vCard listing with num_entries cards, returns length
+uint32_t goep_sim_create_vcard_listing(uint8_t * buffer, uint32_t buffer_size, uint16_t num_entries);
+
+// process events until queue is empty
+void     goep_sim_run(void);
+
+uint32_t goep_sim_get_time_ms(void);
+uint32_t goep_sim_get_num_get_requests(void);
+uint32_t goep_sim_get_num_srmp_wait_requests(void);
+uint32_t goep_sim_get_num_responses(void);
+bool     goep_sim_get_srm_active(void);
+bool     goep_sim_get_abort_received(void);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif
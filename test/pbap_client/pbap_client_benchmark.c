@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define BTSTACK_FILE__ "pbap_client_benchmark.c"
+
+// *****************************************************************************
+//
+// PBAP Client benchmark: replays a phone book with 5000 vCards over simulated
+// GOEP with request/response per packet, Single Response Mode (SRM) and SRM with
+// flow control, and reports simulated transfer time and host time per byte
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_event.h"
+#include "btstack_util.h"
+#include "classic/pbap_client.h"
+#include "goep_sim.h"
+
+#define NUM_ENTRIES 5000
+
+static uint8_t  phonebook[NUM_ENTRIES * 250];
+static uint32_t phonebook_len;
+
+static bd_addr_t remote_addr = { 0x00, 0x1b, 0xdc, 0x00, 0x00, 0x01 };
+static uint16_t  pbap_cid;
+static bool      flow_control;
+static bool      complete;
+static uint8_t   status;
+static uint32_t  received_len;
+static uint32_t  received_packets;
+static uint32_t  checksum;
+
+static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    uint16_t i;
+    switch (packet_type){
+        case PBAP_DATA_PACKET:
+            // consume data in place
+            for (i=0;i<size;i++){
+                checksum += packet[i];
+            }
+            received_len += size;
+            received_packets++;
+            if (flow_control){
+                pbap_next_packet(pbap_cid);
+            }
+            break;
+        case HCI_EVENT_PACKET:
+            if (hci_event_packet_get_type(packet) != HCI_EVENT_PBAP_META) break;
+            switch (hci_event_pbap_meta_get_subevent_code(packet)){
+                case PBAP_SUBEVENT_CONNECTION_OPENED:
+                    status = pbap_subevent_connection_opened_get_status(packet);
+                    break;
+                case PBAP_SUBEVENT_OPERATION_COMPLETED:
+                    complete = true;
+                    status = pbap_subevent_operation_completed_get_status(packet);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static uint64_t time_ns(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000u) + (uint64_t) now.tv_nsec;
+}
+
+static void benchmark(const char * name, bool srm, bool use_flow_control){
+    goep_sim_init();
+    goep_sim_set_srm_supported(srm);
+    goep_sim_set_object(phonebook, phonebook_len);
+    pbap_client_init();
+    pbap_connect(&packet_handler, remote_addr, &pbap_cid);
+    goep_sim_run();
+    if (status != ERROR_CODE_SUCCESS){
+        printf("%s: connect failed\n", name);
+        exit(EXIT_FAILURE);
+    }
+    pbap_set_flow_control_mode(pbap_cid, use_flow_control ? 1 : 0);
+    flow_control = use_flow_control;
+    complete = false;
+    received_len = 0;
+    received_packets = 0;
+    checksum = 0;
+
+    uint32_t start_ms = goep_sim_get_time_ms();
+    uint64_t start_ns = time_ns();
+    pbap_pull_phonebook(pbap_cid, "telecom/pb.vcf");
+    goep_sim_run();
+    uint64_t duration_ns = time_ns() - start_ns;
+    uint32_t duration_ms = goep_sim_get_time_ms() - start_ms;
+
+    if (!complete || (status != ERROR_CODE_SUCCESS) || (received_len != phonebook_len)){
+        printf("%s: transfer failed\n", name);
+        exit(EXIT_FAILURE);
+    }
+    printf("%-20s: %u bytes in %4u packets, %4u requests, %6u ms simulated, %3u kB/s, %5.2f ns/byte host (checksum %08x)\n",
+           name, (unsigned int) received_len, (unsigned int) received_packets, (unsigned int) goep_sim_get_num_get_requests(),
+           (unsigned int) duration_ms, (unsigned int) (received_len / duration_ms),
+           (double) duration_ns / received_len, (unsigned int) checksum);
+    pbap_client_deinit();
+}
+
+int main(void){
+    phonebook_len = goep_sim_create_phonebook(phonebook, sizeof(phonebook), NUM_ENTRIES);
+    printf("Phone book with %u vCards, link latency %u ms, %u us per byte, OBEX packet %u bytes\n",
+           NUM_ENTRIES, GOEP_SIM_LATENCY_MS, GOEP_SIM_US_PER_BYTE, GOEP_SIM_OBEX_PACKET_LEN);
+    benchmark("Request/Response", false, false);
+    benchmark("SRM", true, false);
+    benchmark("SRM + flow control", true, true);
+    return 0;
+}
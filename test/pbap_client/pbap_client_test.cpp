@@ -0,0 +1,261 @@
+// *****************************************************************************
+//
+// test PBAP Client GET operations with and without Single Response Mode over simulated GOEP
+//
+// *****************************************************************************
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bluetooth.h"
+#include "btstack_event.h"
+#include "classic/obex.h"
+#include "classic/pbap_client.h"
+#include "goep_sim.h"
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#define TEST_NUM_ENTRIES  200
+
+static bd_addr_t  remote_addr = { 0x00, 0x1b, 0xdc, 0x00, 0x00, 0x01 };
+static uint16_t   pbap_cid;
+
+static uint8_t    test_object[TEST_NUM_ENTRIES * 200];
+static uint32_t   test_object_len;
+
+static uint8_t    received_data[sizeof(test_object)];
+static uint32_t   received_len;
+static uint32_t   received_packets;
+static bool       flow_control_pending;
+static bool       abort_after_first_packet;
+static uint8_t    connection_status;
+static bool       operation_complete;
+static uint8_t    operation_status;
+static uint16_t   phonebook_size;
+static uint16_t   num_card_results;
+static char       last_card_name[PBAP_MAX_NAME_LEN + 1];
+
+static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    switch (packet_type){
+        case PBAP_DATA_PACKET:
+            CHECK(received_len + size <= sizeof(received_data));
+            memcpy(&received_data[received_len], packet, size);
+            received_len += size;
+            received_packets++;
+            flow_control_pending = true;
+            if (abort_after_first_packet){
+                abort_after_first_packet = false;
+                CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_abort(pbap_cid));
+            }
+            break;
+        case HCI_EVENT_PACKET:
+            if (hci_event_packet_get_type(packet) != HCI_EVENT_PBAP_META) break;
+            switch (hci_event_pbap_meta_get_subevent_code(packet)){
+                case PBAP_SUBEVENT_CONNECTION_OPENED:
+                    connection_status = pbap_subevent_connection_opened_get_status(packet);
+                    break;
+                case PBAP_SUBEVENT_OPERATION_COMPLETED:
+                    operation_complete = true;
+                    operation_status = pbap_subevent_operation_completed_get_status(packet);
+                    break;
+                case PBAP_SUBEVENT_PHONEBOOK_SIZE:
+                    operation_complete = true;
+                    operation_status = pbap_subevent_phonebook_size_get_status(packet);
+                    phonebook_size = pbap_subevent_phonebook_size_get_phonebook_size(packet);
+                    break;
+                case PBAP_SUBEVENT_CARD_RESULT:
+                    num_card_results++;
+                    memset(last_card_name, 0, sizeof(last_card_name));
+                    memcpy(last_card_name, pbap_subevent_card_result_get_name(packet), pbap_subevent_card_result_get_name_len(packet));
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void connect(void){
+    connection_status = 0xff;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_connect(&packet_handler, remote_addr, &pbap_cid));
+    goep_sim_run();
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, connection_status);
+}
+
+static void start_operation(void){
+    received_len = 0;
+    received_packets = 0;
+    flow_control_pending = false;
+    operation_complete = false;
+    operation_status = 0xff;
+}
+
+// returns duration of operation in ms
+static uint32_t pull_phonebook(void){
+    start_operation();
+    uint32_t start_ms = goep_sim_get_time_ms();
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_pull_phonebook(pbap_cid, "telecom/pb.vcf"));
+    goep_sim_run();
+    CHECK(operation_complete);
+    return goep_sim_get_time_ms() - start_ms;
+}
+
+static void check_phonebook_received(void){
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, operation_status);
+    CHECK_EQUAL(test_object_len, received_len);
+    MEMCMP_EQUAL(test_object, received_data, test_object_len);
+}
+
+static uint32_t num_packets_for_object(void){
+    // packet contains response code, length and body header
+    const uint32_t max_body_len = GOEP_SIM_OBEX_PACKET_LEN - 6;
+    return (test_object_len + max_body_len - 1) / max_body_len;
+}
+
+TEST_GROUP(PBAPClient){
+    void setup(void){
+        goep_sim_init();
+        pbap_client_init();
+        test_object_len = goep_sim_create_phonebook(test_object, sizeof(test_object), TEST_NUM_ENTRIES);
+        goep_sim_set_object(test_object, test_object_len);
+        abort_after_first_packet = false;
+        num_card_results = 0;
+    }
+    void teardown(void){
+        pbap_client_deinit();
+    }
+};
+
+TEST(PBAPClient, PullPhonebookWithoutSrm){
+    connect();
+    uint32_t duration_ms = pull_phonebook();
+    check_phonebook_received();
+
+    // one request/response round trip per packet
+    uint32_t num_packets = num_packets_for_object();
+    CHECK_EQUAL(num_packets, goep_sim_get_num_get_requests());
+    CHECK(goep_sim_get_srm_active() == false);
+    CHECK(duration_ms >= num_packets * 2 * GOEP_SIM_LATENCY_MS);
+}
+
+TEST(PBAPClient, PullPhonebookWithSrm){
+    goep_sim_set_srm_supported(true);
+    connect();
+    uint32_t duration_ms = pull_phonebook();
+    check_phonebook_received();
+
+    // single request, link busy with responses afterwards
+    CHECK_EQUAL(1, goep_sim_get_num_get_requests());
+    CHECK(goep_sim_get_srm_active());
+    uint32_t transfer_ms = (test_object_len * GOEP_SIM_US_PER_BYTE) / 1000;
+    CHECK(duration_ms <= transfer_ms + 2 * GOEP_SIM_LATENCY_MS + 10);
+
+    printf("Pull %u vCards (%u bytes): SRM %u ms, %u packets\n", TEST_NUM_ENTRIES, (unsigned int) test_object_len,
+           (unsigned int) duration_ms, (unsigned int) received_packets);
+}
+
+TEST(PBAPClient, PullPhonebookWithSrmpWaitFromPse){
+    const uint16_t num_wait_responses = 3;
+    goep_sim_set_srm_supported(true);
+    goep_sim_set_num_srmp_wait_responses(num_wait_responses);
+    connect();
+    pull_phonebook();
+    check_phonebook_received();
+
+    // client sends GET request for each response with SRMP Wait
+    CHECK_EQUAL(1 + num_wait_responses, goep_sim_get_num_get_requests());
+    CHECK_EQUAL(0, goep_sim_get_num_srmp_wait_requests());
+}
+
+TEST(PBAPClient, PullPhonebookFlowControlWithSrm){
+    goep_sim_set_srm_supported(true);
+    connect();
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_set_flow_control_mode(pbap_cid, 1));
+    start_operation();
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_pull_phonebook(pbap_cid, "telecom/pb.vcf"));
+    goep_sim_run();
+    while (!operation_complete){
+        // PSE waits until next packet is requested
+        CHECK(flow_control_pending);
+        CHECK_EQUAL(received_packets, goep_sim_get_num_get_requests());
+        flow_control_pending = false;
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_next_packet(pbap_cid));
+        goep_sim_run();
+    }
+    check_phonebook_received();
+    CHECK(goep_sim_get_srm_active());
+    CHECK_EQUAL(num_packets_for_object(), goep_sim_get_num_get_requests());
+    CHECK_EQUAL(goep_sim_get_num_get_requests(), goep_sim_get_num_srmp_wait_requests());
+}
+
+TEST(PBAPClient, FlowControlAfterSrmOperation){
+    goep_sim_set_srm_supported(true);
+    connect();
+    pull_phonebook();
+    check_phonebook_received();
+
+    // SRM state of previous operation does not affect the next one
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_set_flow_control_mode(pbap_cid, 1));
+    start_operation();
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_pull_phonebook(pbap_cid, "telecom/pb.vcf"));
+    goep_sim_run();
+    while (!operation_complete){
+        CHECK(flow_control_pending);
+        flow_control_pending = false;
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_next_packet(pbap_cid));
+        goep_sim_run();
+    }
+    check_phonebook_received();
+}
+
+TEST(PBAPClient, AbortWithSrm){
+    goep_sim_set_srm_supported(true);
+    connect();
+    abort_after_first_packet = true;
+    pull_phonebook();
+    CHECK_EQUAL(OBEX_ABORTED, operation_status);
+    CHECK(goep_sim_get_abort_received());
+    CHECK(received_len < test_object_len);
+
+    // next operation works
+    pull_phonebook();
+    check_phonebook_received();
+}
+
+TEST(PBAPClient, GetPhonebookSizeWithSrm){
+    goep_sim_set_srm_supported(true);
+    goep_sim_set_phonebook_size(TEST_NUM_ENTRIES);
+    connect();
+    start_operation();
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_get_phonebook_size(pbap_cid, "telecom/pb.vcf"));
+    goep_sim_run();
+    CHECK(operation_complete);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, operation_status);
+    CHECK_EQUAL(TEST_NUM_ENTRIES, phonebook_size);
+}
+
+TEST(PBAPClient, PullVCardListingWithSrm){
+    test_object_len = goep_sim_create_vcard_listing(test_object, sizeof(test_object), TEST_NUM_ENTRIES);
+    goep_sim_set_object(test_object, test_object_len);
+    goep_sim_set_srm_supported(true);
+    connect();
+    start_operation();
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, pbap_pull_vcard_listing(pbap_cid, "telecom/pb"));
+    goep_sim_run();
+    CHECK(operation_complete);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, operation_status);
+    CHECK_EQUAL(TEST_NUM_ENTRIES, num_card_results);
+    STRCMP_EQUAL("Contact 0199", last_card_name);
+    CHECK_EQUAL(1, goep_sim_get_num_get_requests());
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "btstack_resample_benchmark.c"
+
+// *****************************************************************************
+//
+// Resampler benchmark: THD+N of sine input and processing speed of linear and
+// polyphase resampler for drift compensation and 44.1 <-> 48 kHz conversion
+//
+// *****************************************************************************
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "btstack_resample.h"
+#include "btstack_resample_polyphase.h"
+
+#define NUM_CHANNELS     2
+#define NUM_FRAMES       48000
+#define BLOCK_SIZE       128
+#define SPEED_ITERATIONS 50
+
+static int16_t input[NUM_FRAMES * NUM_CHANNELS];
+static int16_t output[NUM_FRAMES * 2 * NUM_CHANNELS];
+
+static btstack_resample_polyphase_filter_t filter;
+static btstack_resample_polyphase_t resample_polyphase;
+static btstack_resample_t resample_linear;
+
+typedef struct {
+    const char * name;
+    uint8_t      num_taps;  // 0 = linear
+    uint32_t     input_sample_rate;
+    uint32_t     output_sample_rate;
+    uint32_t     factor;
+} benchmark_config_t;
+
+static const benchmark_config_t configs[] = {
+    { "drift +0.4%  linear",      0, 44100, 44100, 0x10100 },
+    { "drift +0.4%  8 taps",      8, 44100, 44100, 0x10100 },
+    { "drift +0.4% 16 taps",     16, 44100, 44100, 0x10100 },
+    { "drift +0.4% 32 taps",     32, 44100, 44100, 0x10100 },
+    { "drift +0.4% 64 taps",     64, 44100, 44100, 0x10100 },
+    { "44.1 -> 48   linear",      0, 44100, 48000, 0x10000 },
+    { "44.1 -> 48  16 taps",     16, 44100, 48000, 0x10000 },
+    { "44.1 -> 48  32 taps",     32, 44100, 48000, 0x10000 },
+    { "44.1 -> 48  64 taps",     64, 44100, 48000, 0x10000 },
+    { "48 -> 44.1  16 taps",     16, 48000, 44100, 0x10000 },
+    { "48 -> 44.1  32 taps",     32, 48000, 44100, 0x10000 },
+    { "48 -> 44.1  64 taps",     64, 48000, 44100, 0x10000 },
+};
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static void setup(const benchmark_config_t * config){
+    if (config->num_taps == 0){
+        btstack_resample_init(&resample_linear, NUM_CHANNELS);
+        // linear resampler only supports factor, approximate sample rate ratio
+        uint32_t factor = (uint32_t)(((uint64_t) config->input_sample_rate << 16) / config->output_sample_rate);
+        btstack_resample_set_factor(&resample_linear, (uint32_t)(((uint64_t) factor * config->factor) >> 16));
+    } else {
+        btstack_resample_polyphase_filter_init(&filter, config->num_taps, config->input_sample_rate, config->output_sample_rate);
+        btstack_resample_polyphase_init(&resample_polyphase, &filter, NUM_CHANNELS, config->input_sample_rate, config->output_sample_rate);
+        btstack_resample_polyphase_set_factor(&resample_polyphase, config->factor);
+    }
+}
+
+static uint32_t process(const benchmark_config_t * config){
+    uint32_t num_output_frames = 0;
+    uint32_t offset;
+    for (offset = 0; offset < NUM_FRAMES; offset += BLOCK_SIZE){
+        if (config->num_taps == 0){
+            num_output_frames += btstack_resample_block(&resample_linear, &input[offset * NUM_CHANNELS], BLOCK_SIZE,
+                                                        &output[num_output_frames * NUM_CHANNELS]);
+        } else {
+            num_output_frames += btstack_resample_polyphase_block(&resample_polyphase, &input[offset * NUM_CHANNELS], BLOCK_SIZE,
+                                                                  &output[num_output_frames * NUM_CHANNELS]);
+        }
+    }
+    return num_output_frames;
+}
+
+// THD+N in dB relative to best-fit sine of given normalized frequency
+static double thd_n_db(const int16_t * buffer, uint32_t num_frames, double frequency_normalized){
+    double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+    uint32_t i;
+    for (i = 0; i < num_frames; i++){
+        double s = sin(2.0 * M_PI * frequency_normalized * i);
+        double c = cos(2.0 * M_PI * frequency_normalized * i);
+        double y = buffer[i * NUM_CHANNELS];
+        ss += s * s; sc += s * c; cc += c * c; ys += y * s; yc += y * c;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det;
+    double b = (yc * ss - ys * sc) / det;
+    double signal = 0, noise = 0;
+    for (i = 0; i < num_frames; i++){
+        double fit = a * sin(2.0 * M_PI * frequency_normalized * i) + b * cos(2.0 * M_PI * frequency_normalized * i);
+        double error = buffer[i * NUM_CHANNELS] - fit;
+        signal += fit * fit;
+        noise  += error * error;
+    }
+    return 10.0 * log10(noise / signal);
+}
+
+static double measure_thd_n(const benchmark_config_t * config, double frequency){
+    uint32_t i;
+    for (i = 0; i < NUM_FRAMES; i++){
+        int16_t sample = (int16_t) lround(16000.0 * sin(2.0 * M_PI * frequency * i / config->input_sample_rate));
+        input[i * NUM_CHANNELS]     = sample;
+        input[i * NUM_CHANNELS + 1] = sample;
+    }
+    setup(config);
+    uint32_t num_output_frames = process(config);
+    // output frequency considering sample rate ratio and drift factor
+    double step = ((double) config->input_sample_rate / config->output_sample_rate) * config->factor / 65536.0;
+    double frequency_output = frequency * step / config->input_sample_rate;
+    const uint32_t skip = 128;
+    return thd_n_db(&output[skip * NUM_CHANNELS], num_output_frames - skip, frequency_output);
+}
+
+static double measure_speed(const benchmark_config_t * config){
+    setup(config);
+    double start = now_seconds();
+    int i;
+    for (i = 0; i < SPEED_ITERATIONS; i++){
+        process(config);
+    }
+    double duration = now_seconds() - start;
+    // input frames per second, in multiples of real-time
+    return ((double) NUM_FRAMES * SPEED_ITERATIONS / config->input_sample_rate) / duration;
+}
+
+int main(int argc, const char * argv[]){
+    (void) argc;
+    (void) argv;
+#if defined(__SSE2__)
+    printf("kernel: SSE2\n");
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    printf("kernel: NEON\n");
+#else
+    printf("kernel: scalar\n");
+#endif
+    printf("%-22s | THD+N 1 kHz | THD+N 10 kHz | THD+N 18 kHz | speed (x real-time, stereo)\n", "config");
+    unsigned int i;
+    for (i = 0; i < sizeof(configs) / sizeof(configs[0]); i++){
+        const benchmark_config_t * config = &configs[i];
+        double thd_n_1k  = measure_thd_n(config, 1000.0);
+        double thd_n_10k = measure_thd_n(config, 10000.0);
+        double thd_n_18k = measure_thd_n(config, 18000.0);
+        double speed     = measure_speed(config);
+        printf("%-22s | %8.1f dB | %9.1f dB | %9.1f dB | %8.0f\n", config->name, thd_n_1k, thd_n_10k, thd_n_18k, speed);
+    }
+    return 0;
+}
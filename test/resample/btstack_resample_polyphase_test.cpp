@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2024 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL BLUEKITCHEN
+ * GMBH OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+
+#define BTSTACK_FILE__ "btstack_resample_polyphase_test.cpp"
+
+// *****************************************************************************
+//
+// Polyphase resampler test: sample rate conversion, drift factor and
+// distortion of sine input
+//
+// *****************************************************************************
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth.h"
+#include "btstack_resample.h"
+#include "btstack_resample_polyphase.h"
+#include "btstack_util.h"
+
+#define MAX_FRAMES 50000
+
+static btstack_resample_polyphase_filter_t filter;
+static btstack_resample_polyphase_t resample;
+static int16_t input[MAX_FRAMES * 2];
+static int16_t output[MAX_FRAMES * 3];
+
+static void generate_sine(int16_t * buffer, uint32_t num_frames, uint8_t num_channels, uint8_t channel, double frequency_normalized, double amplitude){
+    uint32_t i;
+    for (i = 0; i < num_frames; i++){
+        buffer[i * num_channels + channel] = (int16_t) lround(amplitude * sin(2.0 * M_PI * frequency_normalized * i));
+    }
+}
+
+// THD+N in dB relative to best-fit sine of given normalized frequency
+static double thd_n_db(const int16_t * buffer, uint32_t num_frames, uint8_t num_channels, uint8_t channel, double frequency_normalized){
+    double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+    uint32_t i;
+    for (i = 0; i < num_frames; i++){
+        double s = sin(2.0 * M_PI * frequency_normalized * i);
+        double c = cos(2.0 * M_PI * frequency_normalized * i);
+        double y = buffer[i * num_channels + channel];
+        ss += s * s; sc += s * c; cc += c * c; ys += y * s; yc += y * c;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det;
+    double b = (yc * ss - ys * sc) / det;
+    double signal = 0, noise = 0;
+    for (i = 0; i < num_frames; i++){
+        double fit = a * sin(2.0 * M_PI * frequency_normalized * i) + b * cos(2.0 * M_PI * frequency_normalized * i);
+        double error = buffer[i * num_channels + channel] - fit;
+        signal += fit * fit;
+        noise  += error * error;
+    }
+    return 10.0 * log10(noise / signal);
+}
+
+TEST_GROUP(ResamplePolyphase){
+    void setup(void){
+        memset(input, 0, sizeof(input));
+        memset(output, 0, sizeof(output));
+    }
+};
+
+TEST(ResamplePolyphase, FilterInitInvalidParameters){
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, btstack_resample_polyphase_filter_init(&filter, 0, 44100, 48000));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, btstack_resample_polyphase_filter_init(&filter, 12, 44100, 48000));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, btstack_resample_polyphase_filter_init(&filter, BTSTACK_RESAMPLE_POLYPHASE_MAX_TAPS + 8, 44100, 48000));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, btstack_resample_polyphase_filter_init(&filter, 16, 0, 48000));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, btstack_resample_polyphase_filter_init(&filter, 16, 44100, 48000));
+}
+
+TEST(ResamplePolyphase, InitInvalidParameters){
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, btstack_resample_polyphase_filter_init(&filter, 16, 44100, 48000));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, btstack_resample_polyphase_init(&resample, &filter, 0, 44100, 48000));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, btstack_resample_polyphase_init(&resample, &filter, 3, 44100, 48000));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, btstack_resample_polyphase_init(&resample, &filter, 2, 48000, 8000));
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, btstack_resample_polyphase_init(&resample, &filter, 2, 44100, 48000));
+}
+
+TEST(ResamplePolyphase, FilterUnityGain){
+    btstack_resample_polyphase_filter_init(&filter, 32, 44100, 48000);
+    int phase;
+    for (phase = 0; phase <= BTSTACK_RESAMPLE_POLYPHASE_NUM_PHASES; phase++){
+        int32_t sum = 0;
+        int j;
+        for (j = 0; j < 32; j++){
+            sum += filter.coefficients[phase][j];
+        }
+        CHECK_EQUAL(1 << 15, sum);
+    }
+}
+
+TEST(ResamplePolyphase, ConstantInput){
+    btstack_resample_polyphase_filter_init(&filter, 32, 44100, 48000);
+    btstack_resample_polyphase_init(&resample, &filter, 2, 44100, 48000);
+    int i;
+    for (i = 0; i < 1000; i++){
+        input[2 * i]     = 10000;
+        input[2 * i + 1] = -20000;
+    }
+    uint32_t num_output_frames = btstack_resample_polyphase_block(&resample, input, 1000, output);
+    CHECK(num_output_frames <= btstack_resample_polyphase_get_max_output_frames(&resample, 1000));
+    // skip filter startup
+    for (i = 32; i < (int) num_output_frames; i++){
+        CHECK_EQUAL(10000,  output[2 * i]);
+        CHECK_EQUAL(-20000, output[2 * i + 1]);
+    }
+}
+
+TEST(ResamplePolyphase, NumOutputFrames){
+    btstack_resample_polyphase_filter_init(&filter, 16, 44100, 48000);
+    btstack_resample_polyphase_init(&resample, &filter, 1, 44100, 48000);
+    uint32_t num_output_frames = 0;
+    int i;
+    // 10 seconds in blocks of 128 frames
+    for (i = 0; i < 3445; i++){
+        uint32_t max_output_frames = btstack_resample_polyphase_get_max_output_frames(&resample, 128);
+        uint32_t block_output_frames = btstack_resample_polyphase_block(&resample, input, 128, output);
+        CHECK(block_output_frames <= max_output_frames);
+        num_output_frames += block_output_frames;
+    }
+    // 3445 * 128 = 440960 input frames, output delayed by 8 frames
+    uint32_t expected = (uint32_t)(((440960.0 - 8) * 48000.0) / 44100.0);
+    CHECK(num_output_frames >= (expected - 1));
+    CHECK(num_output_frames <= (expected + 1));
+}
+
+TEST(ResamplePolyphase, DriftFactor){
+    btstack_resample_polyphase_filter_init(&filter, 16, 48000, 48000);
+    btstack_resample_polyphase_init(&resample, &filter, 2, 48000, 48000);
+    btstack_resample_polyphase_set_factor(&resample, 0x10100);
+    uint32_t num_output_frames = btstack_resample_polyphase_block(&resample, input, 10000, output);
+    uint32_t expected = (uint32_t)(((10000.0 - 8) * 0x10000) / 0x10100);
+    CHECK(num_output_frames >= (expected - 1));
+    CHECK(num_output_frames <= (expected + 1));
+    btstack_resample_polyphase_set_factor(&resample, 0xff00);
+    num_output_frames = btstack_resample_polyphase_block(&resample, input, 10000, output);
+    CHECK(num_output_frames > 10000);
+    CHECK(num_output_frames <= btstack_resample_polyphase_get_max_output_frames(&resample, 10000));
+}
+
+TEST(ResamplePolyphase, DriftFactorClamped){
+    btstack_resample_polyphase_filter_init(&filter, 16, 48000, 48000);
+    btstack_resample_polyphase_init(&resample, &filter, 1, 48000, 48000);
+    btstack_resample_polyphase_set_factor(&resample, 0);
+    uint32_t max_output_frames = btstack_resample_polyphase_get_max_output_frames(&resample, 1000);
+    CHECK(max_output_frames <= 2001);
+    uint32_t num_output_frames = btstack_resample_polyphase_block(&resample, input, 1000, output);
+    CHECK(num_output_frames <= max_output_frames);
+    btstack_resample_polyphase_set_factor(&resample, 0xffffffff);
+    num_output_frames = btstack_resample_polyphase_block(&resample, input, 1000, output);
+    CHECK(num_output_frames >= 490);
+    CHECK(num_output_frames <= 510);
+}
+
+TEST(ResamplePolyphase, BlockSizeIndependent){
+    static int16_t output_blocks[MAX_FRAMES * 3];
+    btstack_resample_polyphase_filter_init(&filter, 32, 44100, 48000);
+    generate_sine(input, 20000, 2, 0, 1000.0 / 44100.0, 16000);
+    generate_sine(input, 20000, 2, 1, 3000.0 / 44100.0, 8000);
+
+    btstack_resample_polyphase_init(&resample, &filter, 2, 44100, 48000);
+    uint32_t num_output_frames = btstack_resample_polyphase_block(&resample, input, 20000, output);
+
+    btstack_resample_polyphase_init(&resample, &filter, 2, 44100, 48000);
+    uint32_t num_output_frames_blocks = 0;
+    uint32_t offset = 0;
+    uint32_t block_size = 1;
+    while (offset < 20000){
+        uint32_t num_frames = btstack_min(block_size, 20000 - offset);
+        num_output_frames_blocks += btstack_resample_polyphase_block(&resample, &input[2 * offset], num_frames, &output_blocks[2 * num_output_frames_blocks]);
+        offset += num_frames;
+        block_size = ((block_size * 7) + 3) % 300;
+    }
+    CHECK_EQUAL(num_output_frames, num_output_frames_blocks);
+    MEMCMP_EQUAL(output, output_blocks, num_output_frames * 4);
+}
+
+TEST(ResamplePolyphase, ChannelsIndependent){
+    btstack_resample_polyphase_filter_init(&filter, 16, 48000, 44100);
+    btstack_resample_polyphase_init(&resample, &filter, 2, 48000, 44100);
+    generate_sine(input, 10000, 2, 0, 1000.0 / 48000.0, 30000);
+    uint32_t num_output_frames = btstack_resample_polyphase_block(&resample, input, 10000, output);
+    uint32_t i;
+    for (i = 0; i < num_output_frames; i++){
+        CHECK_EQUAL(0, output[2 * i + 1]);
+    }
+}
+
+TEST(ResamplePolyphase, DistortionUpsampling){
+    btstack_resample_polyphase_filter_init(&filter, 32, 44100, 48000);
+    btstack_resample_polyphase_init(&resample, &filter, 1, 44100, 48000);
+    generate_sine(input, 44100, 1, 0, 1000.0 / 44100.0, 16000);
+    uint32_t num_output_frames = btstack_resample_polyphase_block(&resample, input, 44100, output);
+    // skip filter startup
+    double thd_n = thd_n_db(&output[64], num_output_frames - 64, 1, 0, 1000.0 / 48000.0);
+    CHECK(thd_n < -80.0);
+}
+
+TEST(ResamplePolyphase, DistortionDrift){
+    btstack_resample_t linear;
+    btstack_resample_init(&linear, 1);
+    btstack_resample_set_factor(&linear, 0x10020);
+    btstack_resample_polyphase_filter_init(&filter, 16, 44100, 44100);
+    btstack_resample_polyphase_init(&resample, &filter, 1, 44100, 44100);
+    btstack_resample_polyphase_set_factor(&resample, 0x10020);
+
+    double frequency = (5000.0 / 44100.0) * 0x10020 / 0x10000;
+    generate_sine(input, 44100, 1, 0, 5000.0 / 44100.0, 16000);
+    uint32_t num_output_frames = btstack_resample_polyphase_block(&resample, input, 44100, output);
+    double thd_n_polyphase = thd_n_db(&output[64], num_output_frames - 64, 1, 0, frequency);
+
+    uint32_t offset;
+    num_output_frames = 0;
+    for (offset = 0; offset < 44100; offset += 128){
+        num_output_frames += btstack_resample_block(&linear, &input[offset], 128, &output[num_output_frames]);
+    }
+    double thd_n_linear = thd_n_db(&output[64], num_output_frames - 64, 1, 0, frequency);
+
+    CHECK(thd_n_polyphase < -80.0);
+    CHECK(thd_n_polyphase < (thd_n_linear - 40.0));
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
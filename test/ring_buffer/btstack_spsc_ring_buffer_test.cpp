@@ -0,0 +1,154 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+#include "btstack_spsc_ring_buffer.h"
+#include "btstack_util.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+static uint8_t storage[20];    // only 16 bytes usable
+
+uint32_t btstack_min(uint32_t a, uint32_t b){
+    return a < b ? a : b;
+}
+
+TEST_GROUP(SPSCRingBuffer){
+    btstack_spsc_ring_buffer_t ring_buffer;
+
+    void setup(void){
+        memset(storage, 0, sizeof(storage));
+        btstack_spsc_ring_buffer_init(&ring_buffer, storage, sizeof(storage));
+    }
+};
+
+TEST(SPSCRingBuffer, EmptyBuffer){
+    CHECK_EQUAL(16, btstack_spsc_ring_buffer_size(&ring_buffer));
+    CHECK_EQUAL(0,  btstack_spsc_ring_buffer_bytes_available(&ring_buffer));
+    CHECK_EQUAL(16, btstack_spsc_ring_buffer_bytes_free(&ring_buffer));
+}
+
+TEST(SPSCRingBuffer, WriteFullBuffer){
+    uint8_t test_write_data[16];
+    uint8_t test_read_data[16];
+    uint32_t i;
+    for (i=0;i<sizeof(test_write_data);i++){
+        test_write_data[i] = (uint8_t) i;
+    }
+    CHECK_EQUAL(0, btstack_spsc_ring_buffer_write(&ring_buffer, test_write_data, sizeof(test_write_data)));
+    CHECK_EQUAL(16, btstack_spsc_ring_buffer_bytes_available(&ring_buffer));
+    CHECK_EQUAL(0,  btstack_spsc_ring_buffer_bytes_free(&ring_buffer));
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, btstack_spsc_ring_buffer_write(&ring_buffer, test_write_data, 1));
+
+    uint32_t number_of_bytes_read = 0;
+    btstack_spsc_ring_buffer_read(&ring_buffer, test_read_data, sizeof(test_read_data), &number_of_bytes_read);
+    CHECK_EQUAL(16, number_of_bytes_read);
+    MEMCMP_EQUAL(test_write_data, test_read_data, sizeof(test_write_data));
+    CHECK_EQUAL(0, btstack_spsc_ring_buffer_bytes_available(&ring_buffer));
+}
+
+TEST(SPSCRingBuffer, ReadWriteWrapAround){
+    uint8_t test_write_data[] = {1,2,3,4,5,6,7};
+    uint8_t test_read_data[sizeof(test_write_data)];
+    int i;
+    for (i=0;i<30;i++){
+        CHECK_EQUAL(0, btstack_spsc_ring_buffer_write(&ring_buffer, test_write_data, sizeof(test_write_data)));
+        CHECK_EQUAL(sizeof(test_write_data), btstack_spsc_ring_buffer_bytes_available(&ring_buffer));
+
+        memset(test_read_data, 0, sizeof(test_read_data));
+        uint32_t number_of_bytes_read = 0;
+        btstack_spsc_ring_buffer_read(&ring_buffer, test_read_data, sizeof(test_read_data), &number_of_bytes_read);
+        CHECK_EQUAL(sizeof(test_write_data), number_of_bytes_read);
+        MEMCMP_EQUAL(test_write_data, test_read_data, sizeof(test_write_data));
+    }
+}
+
+TEST(SPSCRingBuffer, ReserveCommitPeekConsume){
+    uint32_t span_length;
+
+    // reserve full storage
+    uint8_t * write_span = btstack_spsc_ring_buffer_reserve(&ring_buffer, &span_length);
+    POINTERS_EQUAL(&storage[0], write_span);
+    CHECK_EQUAL(16, span_length);
+    memset(write_span, 0x55, 10);
+    btstack_spsc_ring_buffer_commit(&ring_buffer, 10);
+
+    // peek returns committed data only
+    const uint8_t * read_span = btstack_spsc_ring_buffer_peek(&ring_buffer, &span_length);
+    POINTERS_EQUAL(&storage[0], read_span);
+    CHECK_EQUAL(10, span_length);
+    btstack_spsc_ring_buffer_consume(&ring_buffer, 8);
+
+    // write span is limited by end of storage
+    write_span = btstack_spsc_ring_buffer_reserve(&ring_buffer, &span_length);
+    POINTERS_EQUAL(&storage[10], write_span);
+    CHECK_EQUAL(6, span_length);
+    btstack_spsc_ring_buffer_commit(&ring_buffer, 6);
+
+    // wrapped write span is limited by read position
+    write_span = btstack_spsc_ring_buffer_reserve(&ring_buffer, &span_length);
+    POINTERS_EQUAL(&storage[0], write_span);
+    CHECK_EQUAL(8, span_length);
+
+    // read span is limited by end of storage
+    read_span = btstack_spsc_ring_buffer_peek(&ring_buffer, &span_length);
+    POINTERS_EQUAL(&storage[8], read_span);
+    CHECK_EQUAL(8, span_length);
+}
+
+TEST(SPSCRingBuffer, NoStorage){
+    btstack_spsc_ring_buffer_init(&ring_buffer, storage, 0);
+    uint8_t data = 0;
+    CHECK_EQUAL(0, btstack_spsc_ring_buffer_bytes_free(&ring_buffer));
+    CHECK_EQUAL(ERROR_CODE_MEMORY_CAPACITY_EXCEEDED, btstack_spsc_ring_buffer_write(&ring_buffer, &data, 1));
+}
+
+// producer thread writes a byte sequence in odd-sized chunks, consumer verifies it
+#define NUM_STRESS_BYTES 100000
+
+static void * stress_producer(void * context){
+    btstack_spsc_ring_buffer_t * ring_buffer = (btstack_spsc_ring_buffer_t *) context;
+    uint32_t sequence = 0;
+    while (sequence < NUM_STRESS_BYTES){
+        uint32_t span_length;
+        uint8_t * span = btstack_spsc_ring_buffer_reserve(ring_buffer, &span_length);
+        span_length = btstack_min(btstack_min(span_length, 7), NUM_STRESS_BYTES - sequence);
+        if (span_length == 0){
+            sched_yield();
+            continue;
+        }
+        uint32_t i;
+        for (i=0;i<span_length;i++){
+            span[i] = (uint8_t) sequence++;
+        }
+        btstack_spsc_ring_buffer_commit(ring_buffer, span_length);
+    }
+    return NULL;
+}
+
+TEST(SPSCRingBuffer, ProducerConsumerThreads){
+    pthread_t producer;
+    pthread_create(&producer, NULL, &stress_producer, &ring_buffer);
+    uint32_t sequence = 0;
+    bool sequence_ok = true;
+    while (sequence < NUM_STRESS_BYTES){
+        uint8_t data[5];
+        uint32_t number_of_bytes_read;
+        btstack_spsc_ring_buffer_read(&ring_buffer, data, sizeof(data), &number_of_bytes_read);
+        if (number_of_bytes_read == 0){
+            sched_yield();
+        }
+        uint32_t i;
+        for (i=0;i<number_of_bytes_read;i++){
+            if (data[i] != (uint8_t) sequence++){
+                sequence_ok = false;
+            }
+        }
+    }
+    pthread_join(producer, NULL);
+    CHECK_TRUE(sequence_ok);
+    CHECK_EQUAL(0, btstack_spsc_ring_buffer_bytes_available(&ring_buffer));
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -172,6 +172,10 @@ TEST_GROUP(SDPClient){
         record_id = -1;
         sdp_parser_init(&handle_sdp_parser_event);
     }
+    void teardown(void){
+        free(attribute_value);
+        attribute_value = NULL;
+    }
 };
 
 
@@ -192,6 +196,106 @@ TEST(SDPClient, QueryWithMacOSXData){
 }
 
 
+// attribute values as received via SDP_EVENT_QUERY_ATTRIBUTE_VALUE or SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK
+typedef struct {
+    uint16_t record_id;
+    uint16_t attribute_id;
+    uint16_t data_offset;
+    uint8_t  data;
+} value_byte_t;
+
+static value_byte_t value_bytes[2][sizeof(sdp_test_record_list)];
+static int          value_bytes_count[2];
+static int          value_events_count[2];
+
+static void handle_sdp_parser_value_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    value_byte_t * value_byte;
+    int i;
+    switch (packet[0]){
+        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE:
+            value_events_count[0]++;
+            value_byte = &value_bytes[0][value_bytes_count[0]++];
+            value_byte->record_id        = sdp_event_query_attribute_byte_get_record_id(packet);
+            value_byte->attribute_id     = sdp_event_query_attribute_byte_get_attribute_id(packet);
+            value_byte->data_offset      = sdp_event_query_attribute_byte_get_data_offset(packet);
+            value_byte->data             = sdp_event_query_attribute_byte_get_data(packet);
+            break;
+        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE_CHUNK:
+            value_events_count[1]++;
+            CHECK_EQUAL(11 + sdp_event_query_attribute_value_chunk_get_data_len(packet), size);
+            CHECK(sdp_event_query_attribute_value_chunk_get_data_offset(packet) + sdp_event_query_attribute_value_chunk_get_data_len(packet) <=
+                  sdp_event_query_attribute_value_chunk_get_attribute_length(packet));
+            for (i=0;i<sdp_event_query_attribute_value_chunk_get_data_len(packet);i++){
+                value_byte = &value_bytes[1][value_bytes_count[1]++];
+                value_byte->record_id        = sdp_event_query_attribute_value_chunk_get_record_id(packet);
+                value_byte->attribute_id     = sdp_event_query_attribute_value_chunk_get_attribute_id(packet);
+                value_byte->data_offset      = sdp_event_query_attribute_value_chunk_get_data_offset(packet) + i;
+                value_byte->data             = sdp_event_query_attribute_value_chunk_get_data(packet)[i];
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+TEST(SDPClient, QueryWithMacOSXDataChunked){
+    memset(value_bytes, 0, sizeof(value_bytes));
+    memset(value_bytes_count, 0, sizeof(value_bytes_count));
+    memset(value_events_count, 0, sizeof(value_events_count));
+
+    // per byte
+    sdp_parser_init(&handle_sdp_parser_value_event);
+    sdp_parser_handle_chunk(sdp_test_record_list, de_get_len(sdp_test_record_list));
+
+    // chunked, data split into two responses
+    uint16_t split = 500;
+    sdp_parser_init(&handle_sdp_parser_value_event);
+    sdp_parser_enable_attribute_value_chunks();
+    sdp_parser_handle_chunk(sdp_test_record_list, split);
+    sdp_parser_handle_chunk(&sdp_test_record_list[split], de_get_len(sdp_test_record_list) - split);
+
+    CHECK_EQUAL(value_bytes_count[0], value_bytes_count[1]);
+    MEMCMP_EQUAL(value_bytes[0], value_bytes[1], sizeof(value_byte_t) * value_bytes_count[0]);
+    CHECK(value_events_count[1] < (value_events_count[0] / 4));
+}
+
+TEST(SDPClient, QueryWithEmptyAttributeValueChunked){
+    // record with nil attribute value followed by uint16 attribute
+    uint8_t record_list[] = { 0x35, 0x0c, 0x35, 0x0a, 0x09, 0x01, 0x00, 0x00, 0x09, 0x01, 0x01, 0x09, 0x12, 0x34 };
+    memset(value_bytes, 0, sizeof(value_bytes));
+    memset(value_bytes_count, 0, sizeof(value_bytes_count));
+    memset(value_events_count, 0, sizeof(value_events_count));
+
+    sdp_parser_init(&handle_sdp_parser_value_event);
+    sdp_parser_enable_attribute_value_chunks();
+    sdp_parser_handle_chunk(record_list, sizeof(record_list));
+
+    CHECK_EQUAL(2, value_events_count[1]);
+    CHECK_EQUAL(4, value_bytes_count[1]);
+    CHECK_EQUAL(0x0100, value_bytes[1][0].attribute_id);
+    CHECK_EQUAL(0x0101, value_bytes[1][1].attribute_id);
+    CHECK_EQUAL(0x34, value_bytes[1][3].data);
+}
+
+TEST(SDPClient, QueryWithOversizedAttributeValue){
+    // attribute value with DES header 36 ff ff does not fit into 16 bit incl. header
+    uint8_t record_list[] = { 0x35, 0x0a, 0x35, 0x08, 0x09, 0x01, 0x00, 0x36, 0xff, 0xff, 0x01, 0x02 };
+    memset(value_bytes, 0, sizeof(value_bytes));
+    memset(value_bytes_count, 0, sizeof(value_bytes_count));
+    memset(value_events_count, 0, sizeof(value_events_count));
+
+    // per byte, only header is delivered
+    sdp_parser_init(&handle_sdp_parser_value_event);
+    sdp_parser_handle_chunk(record_list, sizeof(record_list));
+    CHECK_EQUAL(3, value_events_count[0]);
+
+    // chunked, nothing is delivered
+    sdp_parser_init(&handle_sdp_parser_value_event);
+    sdp_parser_enable_attribute_value_chunks();
+    sdp_parser_handle_chunk(record_list, sizeof(record_list));
+    CHECK_EQUAL(0, value_events_count[1]);
+}
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
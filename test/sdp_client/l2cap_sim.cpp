@@ -0,0 +1,308 @@
+// *****************************************************************************
+//
+// simulated L2CAP, remote SDP server and run loop timers with virtual time
+//
+// *****************************************************************************
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bluetooth_psm.h"
+#include "bluetooth_sdp.h"
+#include "btstack_event.h"
+#include "btstack_run_loop.h"
+#include "l2cap.h"
+#include "l2cap_sim.h"
+#include "classic/sdp_util.h"
+
+#include "CppUTest/TestHarness.h"
+
+#define SIM_MAX_CHANNELS   8
+#define SIM_MAX_EVENTS     32
+#define SIM_MTU            672
+
+// SPP record with ServiceRecordHandle, ServiceClassIDList and ProtocolDescriptorList, RFCOMM channel at offset 36
+static const uint8_t sdp_test_record_list[] = {
+    0x35, 0x23, 0x35, 0x21,
+    0x09, 0x00, 0x00, 0x0A, 0x00, 0x01, 0x00, 0x01,
+    0x09, 0x00, 0x01, 0x35, 0x03, 0x19, 0x11, 0x01,
+    0x09, 0x00, 0x04, 0x35, 0x0C, 0x35, 0x03, 0x19, 0x01, 0x00, 0x35, 0x05, 0x19, 0x00, 0x03, 0x08, 0x00,
+};
+#define SDP_TEST_RECORD_LIST_RFCOMM_CHANNEL_OFFSET 36
+#define SDP_TEST_RECORD_LIST_SPLIT 16
+
+typedef enum {
+    SIM_EVENT_CHANNEL_OPENED,
+    SIM_EVENT_CAN_SEND_NOW,
+    SIM_EVENT_DATA,
+    SIM_EVENT_CHANNEL_CLOSED,
+    SIM_EVENT_TIMER,
+} sim_event_type_t;
+
+typedef struct {
+    bool     active;
+    uint32_t time_ms;
+    uint32_t seq;
+    uint16_t cid;
+    sim_event_type_t type;
+    btstack_timer_source_t * timer;
+    uint8_t  data[64];
+    uint16_t len;
+} sim_event_t;
+
+typedef struct {
+    bool      used;
+    bd_addr_t addr;
+    btstack_packet_handler_t handler;
+} sim_channel_t;
+
+static uint32_t      sim_time_ms;
+static uint32_t      sim_event_seq;
+static sim_event_t   sim_events[SIM_MAX_EVENTS];
+static sim_channel_t sim_channels[SIM_MAX_CHANNELS];
+static uint8_t       sim_outgoing_buffer[SIM_MTU];
+static int           sim_nr_connects;
+static int           sim_nr_disconnects;
+static int           sim_nr_requests;
+static uint8_t       sim_connect_status;
+
+static uint16_t sim_cid_for_index(int index){
+    return (uint16_t) (0x40 + index);
+}
+
+static sim_channel_t * sim_channel_for_cid(uint16_t cid){
+    int index = cid - 0x40;
+    if ((index < 0) || (index >= SIM_MAX_CHANNELS)) return NULL;
+    return &sim_channels[index];
+}
+
+static sim_event_t * sim_schedule(uint16_t cid, sim_event_type_t type, uint32_t delay_ms){
+    int i;
+    for (i=0;i<SIM_MAX_EVENTS;i++){
+        sim_event_t * event = &sim_events[i];
+        if (event->active) continue;
+        memset(event, 0, sizeof(sim_event_t));
+        event->active  = true;
+        event->time_ms = sim_time_ms + delay_ms;
+        event->seq     = sim_event_seq++;
+        event->cid     = cid;
+        event->type    = type;
+        return event;
+    }
+    FAIL("event queue full");
+    return NULL;
+}
+
+// remote SDP server: answers ServiceSearchAttributeRequest in two parts, RFCOMM channel depends on address
+static void sim_remote_handle_request(sim_channel_t * channel, uint16_t cid, const uint8_t * request, uint16_t len){
+    CHECK_EQUAL(SDP_ServiceSearchAttributeRequest, request[0]);
+    uint16_t transaction_id = big_endian_read_16(request, 1);
+    bool continuation = request[len - 1] != 0;
+
+    uint8_t record_list[sizeof(sdp_test_record_list)];
+    memcpy(record_list, sdp_test_record_list, sizeof(record_list));
+    record_list[SDP_TEST_RECORD_LIST_RFCOMM_CHANNEL_OFFSET] = channel->addr[5];
+
+    const uint8_t * part = continuation ? &record_list[SDP_TEST_RECORD_LIST_SPLIT] : record_list;
+    uint16_t part_len = continuation ? (sizeof(record_list) - SDP_TEST_RECORD_LIST_SPLIT) : SDP_TEST_RECORD_LIST_SPLIT;
+
+    sim_event_t * event = sim_schedule(cid, SIM_EVENT_DATA, SIM_RESPONSE_MS);
+    uint8_t * response = event->data;
+    uint16_t pos = 0;
+    response[pos++] = SDP_ServiceSearchAttributeResponse;
+    big_endian_store_16(response, pos, transaction_id);
+    pos += 2;
+    pos += 2;   // parameter length
+    big_endian_store_16(response, pos, part_len);
+    pos += 2;
+    memcpy(&response[pos], part, part_len);
+    pos += part_len;
+    if (continuation){
+        response[pos++] = 0;
+    } else {
+        response[pos++] = 1;
+        response[pos++] = 0x01;
+    }
+    big_endian_store_16(response, 3, pos - 5);
+    event->len = pos;
+}
+
+static void sim_deliver(sim_event_t * event){
+    sim_channel_t * channel = sim_channel_for_cid(event->cid);
+    uint8_t packet[32];
+    memset(packet, 0, sizeof(packet));
+    switch (event->type){
+        case SIM_EVENT_CHANNEL_OPENED:
+            packet[0] = L2CAP_EVENT_CHANNEL_OPENED;
+            packet[1] = 24;
+            packet[2] = event->data[0];
+            reverse_bd_addr(channel->addr, &packet[3]);
+            little_endian_store_16(packet, 11, BLUETOOTH_PSM_SDP);
+            little_endian_store_16(packet, 13, event->cid);
+            little_endian_store_16(packet, 17, SIM_MTU);
+            little_endian_store_16(packet, 19, SIM_MTU);
+            if (event->data[0] != ERROR_CODE_SUCCESS){
+                channel->used = false;
+            }
+            (*channel->handler)(HCI_EVENT_PACKET, event->cid, packet, 26);
+            break;
+        case SIM_EVENT_CAN_SEND_NOW:
+            packet[0] = L2CAP_EVENT_CAN_SEND_NOW;
+            packet[1] = 2;
+            little_endian_store_16(packet, 2, event->cid);
+            (*channel->handler)(HCI_EVENT_PACKET, event->cid, packet, 4);
+            break;
+        case SIM_EVENT_DATA:
+            (*channel->handler)(L2CAP_DATA_PACKET, event->cid, event->data, event->len);
+            break;
+        case SIM_EVENT_CHANNEL_CLOSED:
+            channel->used = false;
+            packet[0] = L2CAP_EVENT_CHANNEL_CLOSED;
+            packet[1] = 2;
+            little_endian_store_16(packet, 2, event->cid);
+            (*channel->handler)(HCI_EVENT_PACKET, event->cid, packet, 4);
+            break;
+        case SIM_EVENT_TIMER:
+            (*event->timer->process)(event->timer);
+            break;
+        default:
+            break;
+    }
+}
+
+void sim_run(void){
+    while (true){
+        sim_event_t * next = NULL;
+        int i;
+        for (i=0;i<SIM_MAX_EVENTS;i++){
+            sim_event_t * event = &sim_events[i];
+            if (!event->active) continue;
+            if ((next == NULL) || (event->time_ms < next->time_ms) || ((event->time_ms == next->time_ms) && (event->seq < next->seq))){
+                next = event;
+            }
+        }
+        if (next == NULL) return;
+        sim_event_t current = *next;
+        next->active = false;
+        sim_time_ms = current.time_ms;
+        sim_deliver(&current);
+    }
+}
+
+// simulated L2CAP
+extern "C" uint8_t l2cap_create_channel(btstack_packet_handler_t handler, bd_addr_t address, uint16_t psm, uint16_t mtu, uint16_t * out_local_cid){
+    CHECK_EQUAL(BLUETOOTH_PSM_SDP, psm);
+    UNUSED(mtu);
+    int i;
+    for (i=0;i<SIM_MAX_CHANNELS;i++){
+        sim_channel_t * channel = &sim_channels[i];
+        if (channel->used) continue;
+        channel->used = true;
+        channel->handler = handler;
+        memcpy(channel->addr, address, 6);
+        *out_local_cid = sim_cid_for_index(i);
+        sim_nr_connects++;
+        sim_event_t * event = sim_schedule(*out_local_cid, SIM_EVENT_CHANNEL_OPENED, SIM_CONNECT_MS);
+        event->data[0] = sim_connect_status;
+        return ERROR_CODE_SUCCESS;
+    }
+    return BTSTACK_MEMORY_ALLOC_FAILED;
+}
+
+extern "C" uint8_t l2cap_disconnect(uint16_t local_cid){
+    sim_nr_disconnects++;
+    sim_schedule(local_cid, SIM_EVENT_CHANNEL_CLOSED, SIM_DISCONNECT_MS);
+    return ERROR_CODE_SUCCESS;
+}
+
+extern "C" uint8_t l2cap_request_can_send_now_event(uint16_t local_cid){
+    sim_schedule(local_cid, SIM_EVENT_CAN_SEND_NOW, 0);
+    return ERROR_CODE_SUCCESS;
+}
+
+extern "C" bool l2cap_reserve_packet_buffer(void){
+    return true;
+}
+
+extern "C" uint8_t * l2cap_get_outgoing_buffer(void){
+    return sim_outgoing_buffer;
+}
+
+extern "C" uint8_t l2cap_send_prepared(uint16_t local_cid, uint16_t len){
+    sim_channel_t * channel = sim_channel_for_cid(local_cid);
+    CHECK(channel != NULL);
+    CHECK(channel->used);
+    sim_nr_requests++;
+    sim_remote_handle_request(channel, local_cid, sim_outgoing_buffer, len);
+    return ERROR_CODE_SUCCESS;
+}
+
+extern "C" uint16_t l2cap_max_mtu(void){
+    return SIM_MTU;
+}
+
+// simulated run loop timers
+extern "C" void btstack_run_loop_set_timer(btstack_timer_source_t * timer, uint32_t timeout_in_ms){
+    timer->timeout = timeout_in_ms;
+}
+
+extern "C" void btstack_run_loop_set_timer_handler(btstack_timer_source_t * timer, void (*process)(btstack_timer_source_t * _timer)){
+    timer->process = process;
+}
+
+extern "C" void btstack_run_loop_set_timer_context(btstack_timer_source_t * timer, void * context){
+    timer->context = context;
+}
+
+extern "C" void * btstack_run_loop_get_timer_context(btstack_timer_source_t * timer){
+    return timer->context;
+}
+
+extern "C" void btstack_run_loop_add_timer(btstack_timer_source_t * timer){
+    sim_event_t * event = sim_schedule(0, SIM_EVENT_TIMER, timer->timeout);
+    event->timer = timer;
+}
+
+extern "C" int btstack_run_loop_remove_timer(btstack_timer_source_t * timer){
+    int i;
+    for (i=0;i<SIM_MAX_EVENTS;i++){
+        if (sim_events[i].active && (sim_events[i].timer == timer)){
+            sim_events[i].active = false;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void sim_init(void){
+    memset(sim_events, 0, sizeof(sim_events));
+    memset(sim_channels, 0, sizeof(sim_channels));
+    sim_time_ms = 0;
+    sim_event_seq = 0;
+    sim_nr_connects = 0;
+    sim_nr_disconnects = 0;
+    sim_nr_requests = 0;
+    sim_connect_status = ERROR_CODE_SUCCESS;
+}
+
+uint32_t sim_get_time_ms(void){
+    return sim_time_ms;
+}
+
+int sim_get_num_connects(void){
+    return sim_nr_connects;
+}
+
+int sim_get_num_disconnects(void){
+    return sim_nr_disconnects;
+}
+
+int sim_get_num_requests(void){
+    return sim_nr_requests;
+}
+
+void sim_set_connect_status(uint8_t status){
+    sim_connect_status = status;
+}
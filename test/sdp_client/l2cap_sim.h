@@ -0,0 +1,35 @@
+// *****************************************************************************
+//
+// simulated L2CAP, remote SDP server and run loop timers with virtual time
+//
+// *****************************************************************************
+
+#ifndef L2CAP_SIM_H
+#define L2CAP_SIM_H
+
+#include <stdint.h>
+
+// simulated latencies in ms
+#define SIM_CONNECT_MS     50
+#define SIM_RESPONSE_MS    20
+#define SIM_DISCONNECT_MS  10
+
+// single query: connect, two request/response round trips (continuation), disconnect
+#define SIM_QUERY_MS (SIM_CONNECT_MS + 2 * SIM_RESPONSE_MS + SIM_DISCONNECT_MS)
+
+// remote devices provide an SPP record with the last byte of their address as RFCOMM channel
+
+void     sim_init(void);
+
+// process events until queue is empty
+void     sim_run(void);
+
+uint32_t sim_get_time_ms(void);
+int      sim_get_num_connects(void);
+int      sim_get_num_disconnects(void);
+int      sim_get_num_requests(void);
+
+// status of following connection attempts
+void     sim_set_connect_status(uint8_t status);
+
+#endif
@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 void sdp_parser_init(btstack_packet_handler_t callback);
+void sdp_parser_enable_attribute_value_chunks(void);
 void sdp_parser_handle_chunk(uint8_t * data, uint16_t size);
 void sdp_parser_init_service_attribute_search(void);
 void sdp_parser_init_service_search(void);
@@ -0,0 +1,209 @@
+// *****************************************************************************
+//
+// test parallel SDP queries over simulated L2CAP with connect, response and disconnect latency
+//
+// *****************************************************************************
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bluetooth_sdp.h"
+#include "btstack_event.h"
+#include "l2cap.h"
+#include "classic/sdp_client.h"
+#include "classic/sdp_client_rfcomm.h"
+#include "classic/sdp_util.h"
+#include "l2cap_sim.h"
+#include "mock.h"
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#define SIM_MAX_QUERIES    8
+
+typedef struct {
+    bool      started;
+    bool      complete;
+    uint16_t  query_id;
+    uint8_t   status;
+    uint8_t   rfcomm_channel;
+    uint32_t  complete_ms;
+    bd_addr_t addr;
+} sim_query_t;
+
+static sim_query_t   sim_queries[SIM_MAX_QUERIES];
+static int           sim_nr_queries;
+static bool          sim_sequential;
+static int           sim_nr_queries_pending;
+
+// application
+static void start_query(int index);
+
+static void handle_query_rfcomm_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(packet_type);
+    UNUSED(size);
+    CHECK(channel < MAX_NR_SDP_CLIENT_CONTEXTS);
+
+    // channel is query id
+    sim_query_t * query = NULL;
+    int i;
+    for (i=0;i<sim_nr_queries;i++){
+        if (!sim_queries[i].started || sim_queries[i].complete) continue;
+        if (sim_queries[i].query_id == channel){
+            query = &sim_queries[i];
+            break;
+        }
+    }
+    CHECK(query != NULL);
+
+    switch (hci_event_packet_get_type(packet)){
+        case SDP_EVENT_QUERY_RFCOMM_SERVICE:
+            query->rfcomm_channel = sdp_event_query_rfcomm_service_get_rfcomm_channel(packet);
+            break;
+        case SDP_EVENT_QUERY_COMPLETE:
+            query->complete = true;
+            query->status = sdp_event_query_complete_get_status(packet);
+            query->complete_ms = sim_get_time_ms();
+            if (sim_sequential && ((query - sim_queries) + 1 < sim_nr_queries)){
+                start_query((int) (query - sim_queries) + 1);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void start_query(int index){
+    sim_query_t * query = &sim_queries[index];
+    query->query_id = sdp_client_next_query_id();
+    query->started = true;
+    uint8_t status = sdp_client_query_rfcomm_channel_and_name_for_uuid(&handle_query_rfcomm_event, query->addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, status);
+}
+
+static void setup_queries(int num_queries, int num_remotes){
+    int i;
+    for (i=0;i<num_queries;i++){
+        bd_addr_t addr = { 0x00, 0x1b, 0xdc, 0x00, 0x00, 0x00 };
+        // last byte of address is used as RFCOMM channel by simulated remote
+        addr[5] = (uint8_t) (1 + (i % num_remotes));
+        memcpy(sim_queries[i].addr, addr, 6);
+    }
+    sim_nr_queries = num_queries;
+}
+
+static void check_queries(void){
+    int i;
+    for (i=0;i<sim_nr_queries;i++){
+        CHECK(sim_queries[i].complete);
+        CHECK_EQUAL(ERROR_CODE_SUCCESS, sim_queries[i].status);
+        CHECK_EQUAL(sim_queries[i].addr[5], sim_queries[i].rfcomm_channel);
+    }
+}
+
+static uint32_t run_queries(int num_queries, int num_remotes, bool sequential){
+    setup_queries(num_queries, num_remotes);
+    sim_sequential = sequential;
+    if (sequential){
+        start_query(0);
+    } else {
+        int i;
+        for (i=0;i<num_queries;i++){
+            start_query(i);
+        }
+    }
+    sim_run();
+    check_queries();
+    return sim_get_time_ms();
+}
+
+static void handle_query_request(void * context){
+    UNUSED(context);
+    sim_nr_queries_pending--;
+    start_query(sim_nr_queries - 1 - sim_nr_queries_pending);
+}
+
+TEST_GROUP(SDPClientParallel){
+    void setup(void){
+        sdp_client_reset();
+        sim_init();
+        memset(sim_queries, 0, sizeof(sim_queries));
+        sim_nr_queries = 0;
+        sim_nr_queries_pending = 0;
+    }
+};
+
+TEST(SDPClientParallel, SingleQuery){
+    uint32_t duration_ms = run_queries(1, 1, false);
+    CHECK_EQUAL(SIM_QUERY_MS, duration_ms);
+    CHECK_EQUAL(1, sim_get_num_connects());
+}
+
+TEST(SDPClientParallel, DistinctRemotes){
+    const int num_queries = MAX_NR_SDP_CLIENT_CONTEXTS;
+    uint32_t parallel_ms = run_queries(num_queries, num_queries, false);
+    CHECK_EQUAL(num_queries, sim_get_num_connects());
+
+    setup();
+    uint32_t sequential_ms = run_queries(num_queries, num_queries, true);
+
+    printf("%u queries to distinct remotes: parallel %u ms, sequential %u ms\n",
+           (unsigned int) num_queries, (unsigned int) parallel_ms, (unsigned int) sequential_ms);
+    CHECK_EQUAL(SIM_QUERY_MS, parallel_ms);
+    CHECK_EQUAL(num_queries * SIM_QUERY_MS, sequential_ms);
+}
+
+TEST(SDPClientParallel, SameRemoteSharesChannel){
+    const int num_queries = 3;
+    uint32_t shared_ms = run_queries(num_queries, 1, false);
+    CHECK_EQUAL(1, sim_get_num_connects());
+    CHECK_EQUAL(1, sim_get_num_disconnects());
+
+    setup();
+    uint32_t sequential_ms = run_queries(num_queries, 1, true);
+    CHECK_EQUAL(num_queries, sim_get_num_connects());
+
+    printf("%u queries to same remote: shared channel %u ms, sequential %u ms\n",
+           (unsigned int) num_queries, (unsigned int) shared_ms, (unsigned int) sequential_ms);
+    CHECK_EQUAL(SIM_CONNECT_MS + num_queries * 2 * SIM_RESPONSE_MS + SIM_DISCONNECT_MS, shared_ms);
+    CHECK_EQUAL(num_queries * SIM_QUERY_MS, sequential_ms);
+}
+
+TEST(SDPClientParallel, MixedRemotes){
+    const int num_queries = MAX_NR_SDP_CLIENT_CONTEXTS;
+    uint32_t duration_ms = run_queries(num_queries, 2, false);
+    CHECK_EQUAL(2, sim_get_num_connects());
+    CHECK_EQUAL(SIM_CONNECT_MS + 2 * 2 * SIM_RESPONSE_MS + SIM_DISCONNECT_MS, duration_ms);
+}
+
+TEST(SDPClientParallel, BusyUntilContextFree){
+    const int num_queries = MAX_NR_SDP_CLIENT_CONTEXTS + 1;
+    setup_queries(num_queries, num_queries);
+    int i;
+    for (i=0;i<MAX_NR_SDP_CLIENT_CONTEXTS;i++){
+        start_query(i);
+    }
+    CHECK(sdp_client_ready() == false);
+    CHECK_EQUAL(SDP_QUERY_BUSY, sdp_client_query_rfcomm_channel_and_name_for_uuid(&handle_query_rfcomm_event, sim_queries[num_queries-1].addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT));
+
+    // last query starts as soon as the first one completes
+    btstack_context_callback_registration_t request;
+    memset(&request, 0, sizeof(request));
+    request.callback = &handle_query_request;
+    sim_nr_queries_pending = 1;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, sdp_client_register_query_callback(&request));
+    CHECK_EQUAL(1, sim_nr_queries_pending);
+
+    sim_run();
+    check_queries();
+    CHECK_EQUAL(0, sim_nr_queries_pending);
+    CHECK_EQUAL(2 * SIM_QUERY_MS, sim_get_time_ms());
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
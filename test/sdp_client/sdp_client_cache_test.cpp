@@ -0,0 +1,244 @@
+// *****************************************************************************
+//
+// test SDP Client cache for bonded devices over simulated L2CAP
+//
+// *****************************************************************************
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bluetooth_sdp.h"
+#include "btstack_event.h"
+#include "btstack_tlv_flash_bank.h"
+#include "gap.h"
+#include "hal_flash_bank_memory.h"
+#include "classic/sdp_client.h"
+#include "classic/sdp_client_rfcomm.h"
+#include "l2cap_sim.h"
+#include "mock.h"
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#define HAL_FLASH_BANK_MEMORY_STORAGE_SIZE 4096
+static uint8_t hal_flash_bank_memory_storage[HAL_FLASH_BANK_MEMORY_STORAGE_SIZE];
+
+static bool     remote_bonded;
+static bool     query_complete;
+static uint8_t  query_status;
+static uint8_t  query_rfcomm_channel;
+
+static bd_addr_t remote_addr = { 0x00, 0x1b, 0xdc, 0x00, 0x00, 0x05 };
+
+extern "C" bool gap_get_link_key_for_bd_addr(bd_addr_t addr, link_key_t link_key, link_key_type_t * type){
+    (void) addr;
+    memset(link_key, 0, 16);
+    *type = AUTHENTICATED_COMBINATION_KEY_GENERATED_FROM_P256;
+    return remote_bonded;
+}
+
+static void handle_query_rfcomm_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(packet_type);
+    UNUSED(channel);
+    UNUSED(size);
+    switch (hci_event_packet_get_type(packet)){
+        case SDP_EVENT_QUERY_RFCOMM_SERVICE:
+            query_rfcomm_channel = sdp_event_query_rfcomm_service_get_rfcomm_channel(packet);
+            break;
+        case SDP_EVENT_QUERY_COMPLETE:
+            query_complete = true;
+            query_status = sdp_event_query_complete_get_status(packet);
+            break;
+        default:
+            break;
+    }
+}
+
+// returns duration of query
+static uint32_t run_query(const bd_addr_t addr, uint16_t uuid16){
+    bd_addr_t query_addr;
+    memcpy(query_addr, addr, 6);
+    query_complete = false;
+    query_status = 0xff;
+    query_rfcomm_channel = 0;
+    uint32_t start_ms = sim_get_time_ms();
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, sdp_client_query_rfcomm_channel_and_name_for_uuid(&handle_query_rfcomm_event, query_addr, uuid16));
+    // result is not delivered before query returns
+    CHECK(query_complete == false);
+    sim_run();
+    CHECK(query_complete);
+    return sim_get_time_ms() - start_ms;
+}
+
+static void check_statistics(uint32_t expected_hits, uint32_t expected_misses){
+    uint32_t hits;
+    uint32_t misses;
+    sdp_client_cache_get_statistics(&hits, &misses);
+    CHECK_EQUAL(expected_hits, hits);
+    CHECK_EQUAL(expected_misses, misses);
+}
+
+TEST_GROUP(SDPClientCache){
+    const hal_flash_bank_t * hal_flash_bank_impl;
+    hal_flash_bank_memory_t  hal_flash_bank_context;
+    const btstack_tlv_t *    btstack_tlv_impl;
+    btstack_tlv_flash_bank_t btstack_tlv_context;
+
+    void setup(void){
+        memset(hal_flash_bank_memory_storage, 0xff, HAL_FLASH_BANK_MEMORY_STORAGE_SIZE);
+        hal_flash_bank_impl = hal_flash_bank_memory_init_instance(&hal_flash_bank_context, hal_flash_bank_memory_storage, HAL_FLASH_BANK_MEMORY_STORAGE_SIZE);
+        btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+        sdp_client_reset();
+        sdp_client_cache_configure(btstack_tlv_impl, &btstack_tlv_context);
+        sim_init();
+        remote_bonded = true;
+    }
+};
+
+TEST(SDPClientCache, MissThenHit){
+    uint32_t duration_ms = run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(SIM_QUERY_MS, duration_ms);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, query_status);
+    CHECK_EQUAL(remote_addr[5], query_rfcomm_channel);
+
+    duration_ms = run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(0, duration_ms);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, query_status);
+    CHECK_EQUAL(remote_addr[5], query_rfcomm_channel);
+    CHECK_EQUAL(1, sim_get_num_connects());
+    CHECK_EQUAL(2, sim_get_num_requests());
+    check_statistics(1, 1);
+}
+
+TEST(SDPClientCache, KeyedBySearchPattern){
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_HANDSFREE);
+    CHECK_EQUAL(2, sim_get_num_connects());
+    check_statistics(0, 2);
+}
+
+TEST(SDPClientCache, KeyedByAddress){
+    bd_addr_t other_addr = { 0x00, 0x1b, 0xdc, 0x00, 0x00, 0x07 };
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    (void) run_query(other_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(other_addr[5], query_rfcomm_channel);
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(remote_addr[5], query_rfcomm_channel);
+    CHECK_EQUAL(2, sim_get_num_connects());
+    check_statistics(1, 2);
+}
+
+TEST(SDPClientCache, NotBonded){
+    remote_bonded = false;
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(2, sim_get_num_connects());
+    check_statistics(0, 0);
+}
+
+TEST(SDPClientCache, Unbonded){
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    remote_bonded = false;
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    // bonded again: previous result was dropped
+    remote_bonded = true;
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(3, sim_get_num_connects());
+    check_statistics(0, 2);
+}
+
+TEST(SDPClientCache, QueryFailure){
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    sim_set_connect_status(ERROR_CODE_PAGE_TIMEOUT);
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_HANDSFREE);
+    CHECK_EQUAL(ERROR_CODE_PAGE_TIMEOUT, query_status);
+    // results for remote were dropped
+    sim_set_connect_status(ERROR_CODE_SUCCESS);
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(remote_addr[5], query_rfcomm_channel);
+    CHECK_EQUAL(3, sim_get_num_connects());
+    check_statistics(0, 3);
+}
+
+TEST(SDPClientCache, Remove){
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    sdp_client_cache_remove(remote_addr);
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(2, sim_get_num_connects());
+}
+
+TEST(SDPClientCache, RemovedBeforeDelivery){
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    bd_addr_t query_addr;
+    memcpy(query_addr, remote_addr, 6);
+    query_complete = false;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, sdp_client_query_rfcomm_channel_and_name_for_uuid(&handle_query_rfcomm_event, query_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT));
+    sdp_client_cache_remove(remote_addr);
+    sim_run();
+    CHECK(query_complete);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, query_status);
+    CHECK_EQUAL(remote_addr[5], query_rfcomm_channel);
+    CHECK_EQUAL(2, sim_get_num_connects());
+}
+
+TEST(SDPClientCache, Persistent){
+    (void) run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    // restart with same flash content
+    btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+    sdp_client_reset();
+    sdp_client_cache_configure(btstack_tlv_impl, &btstack_tlv_context);
+    uint32_t duration_ms = run_query(remote_addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(0, duration_ms);
+    CHECK_EQUAL(remote_addr[5], query_rfcomm_channel);
+    CHECK_EQUAL(1, sim_get_num_connects());
+}
+
+TEST(SDPClientCache, ReplaceOldest){
+    int i;
+    bd_addr_t addr;
+    memcpy(addr, remote_addr, 6);
+    for (i=0;i<=NVM_NUM_SDP_CLIENT_CACHE_ENTRIES;i++){
+        addr[5] = (uint8_t) (1 + i);
+        (void) run_query(addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    }
+    // first remote was replaced
+    addr[5] = 1;
+    (void) run_query(addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    // last remote is still cached
+    addr[5] = NVM_NUM_SDP_CLIENT_CACHE_ENTRIES + 1;
+    (void) run_query(addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+    CHECK_EQUAL(addr[5], query_rfcomm_channel);
+    check_statistics(1, NVM_NUM_SDP_CLIENT_CACHE_ENTRIES + 2);
+}
+
+TEST(SDPClientCache, Reconnects){
+    // profiles reconnect to bonded devices, e.g. HFP + A2DP after power cycle
+    const int num_devices = 3;
+    const int num_reconnects = 10;
+    uint32_t total_ms = 0;
+    int i;
+    bd_addr_t addr;
+    memcpy(addr, remote_addr, 6);
+    for (i=0;i<num_devices * num_reconnects;i++){
+        addr[5] = (uint8_t) (1 + (i % num_devices));
+        total_ms += run_query(addr, BLUETOOTH_SERVICE_CLASS_SERIAL_PORT);
+        CHECK_EQUAL(addr[5], query_rfcomm_channel);
+    }
+    uint32_t hits;
+    uint32_t misses;
+    sdp_client_cache_get_statistics(&hits, &misses);
+    uint32_t uncached_ms = (hits + misses) * SIM_QUERY_MS;
+    printf("%u queries to %u bonded devices: hit rate %u%%, %u ms instead of %u ms, saved %u ms\n",
+           (unsigned int) (hits + misses), (unsigned int) num_devices, (unsigned int) (hits * 100 / (hits + misses)),
+           (unsigned int) total_ms, (unsigned int) uncached_ms, (unsigned int) (uncached_ms - total_ms));
+    CHECK_EQUAL(num_devices, misses);
+    CHECK_EQUAL(num_devices * SIM_QUERY_MS, total_ms);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -111,6 +111,13 @@ TEST_GROUP(SDPClient){
         service_index = 0;
         sdp_client_reset(); // avoid "not ready" warning
     }
+    void teardown(void){
+        int i;
+        for (i=0; i<service_index; i++){
+            free(service_name[i]);
+            service_name[i] = NULL;
+        }
+    }
 };
 
 
@@ -31,6 +31,7 @@
 #define HCI_INCOMING_PRE_BUFFER_SIZE 4
 
 #define MAX_NR_LE_DEVICE_DB_ENTRIES 4
+#define MAX_NR_SM_SETUP_CONTEXTS 4
 
 #define NVM_NUM_LINK_KEYS 2
 
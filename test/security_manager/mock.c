@@ -18,13 +18,31 @@ static uint16_t packet_buffer_len = 0;
 
 static uint8_t aes128_cyphertext[16];
 
-static hci_connection_t  the_connection;
+#define MOCK_MAX_NR_CONNECTIONS 4
+
+static hci_connection_t  mock_connections[MOCK_MAX_NR_CONNECTIONS];
+static int               mock_num_connections;
+static hci_connection_t * the_connection = &mock_connections[0];
 static btstack_linked_list_t     connections;
 static btstack_linked_list_t     event_packet_handlers;
 
+static uint16_t ltk_reply_count;
+static hci_con_handle_t ltk_reply_handles[MOCK_MAX_NR_CONNECTIONS];
+
 void mock_init(void){
-	the_connection.item.next = NULL;
-	connections = (btstack_linked_item_t*) &the_connection;
+	memset(mock_connections, 0, sizeof(mock_connections));
+	mock_num_connections = 1;
+	the_connection->con_handle = 0x40;
+	connections = (btstack_linked_item_t*) the_connection;
+	ltk_reply_count = 0;
+}
+
+uint16_t mock_ltk_reply_count(void){
+	return ltk_reply_count;
+}
+
+hci_con_handle_t mock_ltk_reply_handle(uint16_t index){
+	return ltk_reply_handles[index];
 }
 
 uint8_t * mock_packet_buffer(void){
@@ -118,6 +136,22 @@ void mock_simulate_connected(void){
 	mock_simulate_hci_event((uint8_t *)&packet, sizeof(packet));
 }
 
+// additional peripheral connection with given handle, the first connection uses handle 0x40
+void mock_simulate_connected_with_handle(hci_con_handle_t con_handle){
+	hci_connection_t * hci_connection = the_connection;
+	if (con_handle != the_connection->con_handle){
+		if (mock_num_connections >= MOCK_MAX_NR_CONNECTIONS) return;
+		hci_connection = &mock_connections[mock_num_connections++];
+		hci_connection->con_handle = con_handle;
+		btstack_linked_list_add_tail(&connections, (btstack_linked_item_t *) hci_connection);
+	}
+    uint8_t packet[] = { 0x3e, 0x13, 0x01, 0x00, 0x40, 0x00, 0x01, 0x01, 0x18, 0x12, 0x5e, 0x68, 0xc9, 0x73, 0x18, 0x00, 0x00, 0x00, 0x48, 0x00, 0x05};
+	little_endian_store_16(packet, 4, con_handle);
+	// use different public address for each connection
+	packet[8] = (uint8_t) con_handle;
+	mock_simulate_hci_event((uint8_t *)&packet, sizeof(packet));
+}
+
 void att_init_connection(att_connection_t * att_connection){
     att_connection->mtu = 23;
     att_connection->encryption_key_size = 0;
@@ -143,10 +177,14 @@ bool hci_can_send_packet_now_using_packet_buffer(uint8_t packet_type){
 }
 
 hci_connection_t * hci_connection_for_bd_addr_and_type(const bd_addr_t addr, bd_addr_type_t addr_type){
-	return &the_connection;
+	return the_connection;
 }
 hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
-	return &the_connection;
+	int i;
+	for (i=0;i<mock_num_connections;i++){
+		if (mock_connections[i].con_handle == con_handle) return &mock_connections[i];
+	}
+	return NULL;
 }
 void hci_connections_get_iterator(btstack_linked_list_iterator_t *it){
     btstack_linked_list_iterator_init(it, &connections);
@@ -203,6 +241,14 @@ uint8_t hci_send_cmd(const hci_cmd_t *cmd, ...){
 	dump_packet(HCI_COMMAND_DATA_PACKET, packet_buffer, len);
 	packet_buffer_len = len;
 
+	// track le ltk request replies
+	if (cmd->opcode == hci_le_long_term_key_request_reply.opcode){
+		if (ltk_reply_count < MOCK_MAX_NR_CONNECTIONS){
+			ltk_reply_handles[ltk_reply_count] = little_endian_read_16(packet_buffer, 3);
+		}
+		ltk_reply_count++;
+	}
+
 	// track le encrypt and le rand
 	if (cmd->opcode ==  hci_le_encrypt.opcode){
 	    uint8_t * key_flipped = &packet_buffer[3];
@@ -117,6 +117,9 @@ extern "C" {
     void mock_simulate_sm_data_packet(uint8_t * packet, uint16_t size);
     void mock_simulate_command_complete(const hci_cmd_t *cmd);
     void mock_simulate_connected(void);
+    void mock_simulate_connected_with_handle(hci_con_handle_t con_handle);
+    uint16_t mock_ltk_reply_count(void);
+    hci_con_handle_t mock_ltk_reply_handle(uint16_t index);
     uint8_t * mock_packet_buffer(void);
     uint16_t mock_packet_buffer_len(void);
     void mock_clear_packet_buffer(void);
@@ -412,6 +415,76 @@ TEST(SecurityManager, MainTest){
     CHECK_ACL_PACKET(test_acl_packet_22);
 }
 
+static void simulate_ec_key_generation(void){
+    // new ECC Key requires random data, unless it was already generated by a previous test
+    uint8_t * command = mock_packet_buffer();
+    while (little_endian_read_16(command, 0) == hci_le_rand.opcode){
+        mock_clear_packet_buffer();
+        uint8_t rand_sc_1_data_event[] = { 0x0e, 0x0c, 0x01, 0x18, 0x20, 0x00, 0x2f, 0x04, 0x82, 0x84, 0x72, 0x46, 0x9c, 0x93 };
+        mock_simulate_hci_event(&rand_sc_1_data_event[0], sizeof(rand_sc_1_data_event));
+    }
+}
+
+static void process_run_loop(void){
+    int i;
+    for (i=0;i<20;i++){
+        btstack_run_loop_embedded_execute_once();
+    }
+}
+
+#define NUM_BONDED_CONNECTIONS 4
+
+TEST(SecurityManager, ConcurrentBondRestoration){
+
+    mock_init();
+    mock_simulate_hci_state_working();
+    simulate_ec_key_generation();
+    mock_clear_packet_buffer();
+
+    // connect bonded centrals
+    hci_con_handle_t con_handles[NUM_BONDED_CONNECTIONS];
+    int i;
+    for (i=0;i<NUM_BONDED_CONNECTIONS;i++){
+        con_handles[i] = 0x40 + i;
+        mock_simulate_connected_with_handle(con_handles[i]);
+    }
+    process_run_loop();
+
+    // all centrals request encryption with legacy ediv/rand at the same time
+    for (i=0;i<NUM_BONDED_CONNECTIONS;i++){
+        uint8_t le_ltk_request[] = { 0x3e, 0x0d, 0x05, 0x40, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x34, 0x12 };
+        little_endian_store_16(le_ltk_request, 3, con_handles[i]);
+        mock_simulate_hci_event(&le_ltk_request[0], sizeof(le_ltk_request));
+    }
+
+    // each round trip, the controller reports encryption change for all connections with a LTK reply
+    int round_trips = 0;
+    uint16_t replies_handled = 0;
+    while (replies_handled < NUM_BONDED_CONNECTIONS){
+        // collect all LTK replies the stack can send before the next encryption change
+        uint16_t replies_sent;
+        do {
+            replies_sent = mock_ltk_reply_count();
+            process_run_loop();
+            mock_clear_packet_buffer();
+            mock_simulate_command_complete(&hci_le_long_term_key_request_reply);
+        } while (mock_ltk_reply_count() != replies_sent);
+        CHECK(replies_sent > replies_handled);
+        round_trips++;
+        for (;replies_handled < replies_sent; replies_handled++){
+            uint8_t encryption_change_event[] = { 0x08, 0x04, 0x00, 0x40, 0x00, 0x01 };
+            little_endian_store_16(encryption_change_event, 3, mock_ltk_reply_handle(replies_handled));
+            mock_simulate_hci_event(&encryption_change_event[0], sizeof(encryption_change_event));
+        }
+    }
+    printf("%u bond restorations took %u round trips with %u setup contexts\n", NUM_BONDED_CONNECTIONS, round_trips, MAX_NR_SM_SETUP_CONTEXTS);
+
+    // every connection got its LTK reply exactly once
+    CHECK_EQUAL(NUM_BONDED_CONNECTIONS, mock_ltk_reply_count());
+    int expected_round_trips = (NUM_BONDED_CONNECTIONS + MAX_NR_SM_SETUP_CONTEXTS - 1) / MAX_NR_SM_SETUP_CONTEXTS;
+    CHECK_EQUAL(expected_round_trips, round_trips);
+}
+
 int main (int argc, const char * argv[]){
     // log into file using HCI_DUMP_PACKETLOGGER format
     const char * log_path = "hci_dump.pklg";